@@ -0,0 +1,69 @@
+#version 430 core
+
+// Downsample of the bloom chain into a level half the size of its source,
+// with the 13 tap filter of Call of Duty: Advanced Warfare. Four overlapping
+// 2x2 boxes around the center and one box in the middle are averaged, each
+// read with bilinear filtering, which keeps aliasing from shimmering as the
+// camera moves.
+
+uniform sampler2D u_source;
+// Maps fragment coordinates of the level onto source texture coordinates
+uniform vec2 u_texCoordScale;
+uniform vec2 u_texelSize;
+// Samples are clamped half a texel inside the source rectangle
+uniform vec2 u_maxTexCoord;
+// Weigh boxes by inverse luma, so that single pixels of very bright light
+// do not flicker as they move between pixels
+uniform bool u_karisAverage;
+
+layout (location = 0) out vec4 o_color;
+
+// Sample at given offset in source texels
+vec3 sampleSource(vec2 texCoord, vec2 offset)
+{
+    return textureLod(u_source,
+                      min(texCoord + offset * u_texelSize, u_maxTexCoord),
+                      0.0).rgb;
+}
+
+float getBoxWeight(vec3 box)
+{
+    return u_karisAverage
+             ? 1.0 / (1.0 + dot(box, vec3(0.2126, 0.7152, 0.0722)))
+             : 1.0;
+}
+
+void main()
+{
+    vec2 texCoord = gl_FragCoord.xy * u_texCoordScale;
+    vec3 a = sampleSource(texCoord, vec2(-2.0, 2.0));
+    vec3 b = sampleSource(texCoord, vec2(0.0, 2.0));
+    vec3 c = sampleSource(texCoord, vec2(2.0, 2.0));
+    vec3 d = sampleSource(texCoord, vec2(-2.0, 0.0));
+    vec3 e = sampleSource(texCoord, vec2(0.0, 0.0));
+    vec3 f = sampleSource(texCoord, vec2(2.0, 0.0));
+    vec3 g = sampleSource(texCoord, vec2(-2.0, -2.0));
+    vec3 h = sampleSource(texCoord, vec2(0.0, -2.0));
+    vec3 i = sampleSource(texCoord, vec2(2.0, -2.0));
+    vec3 j = sampleSource(texCoord, vec2(-1.0, 1.0));
+    vec3 k = sampleSource(texCoord, vec2(1.0, 1.0));
+    vec3 l = sampleSource(texCoord, vec2(-1.0, -1.0));
+    vec3 m = sampleSource(texCoord, vec2(1.0, -1.0));
+
+    // Middle box counts half, corner boxes an eighth each
+    vec3 boxes[5] = vec3[5]((j + k + l + m) * 0.25,
+                            (a + b + d + e) * 0.25,
+                            (b + c + e + f) * 0.25,
+                            (d + e + g + h) * 0.25,
+                            (e + f + h + i) * 0.25);
+    float boxWeights[5] = float[5](0.5, 0.125, 0.125, 0.125, 0.125);
+    vec3 color = vec3(0.0);
+    float weightSum = 0.0;
+    for (int box = 0; box < 5; ++box)
+    {
+        float weight = boxWeights[box] * getBoxWeight(boxes[box]);
+        color += boxes[box] * weight;
+        weightSum += weight;
+    }
+    o_color = vec4(color / weightSum, 1.0);
+}
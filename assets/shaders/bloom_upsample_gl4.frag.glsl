@@ -0,0 +1,38 @@
+#version 430 core
+
+// Upsample of the bloom chain, blurring a level with a 3x3 tent filter while
+// drawing it onto the level twice its size, where it is added by blending.
+
+uniform sampler2D u_source;
+// Maps fragment coordinates of the larger level onto source texture
+// coordinates
+uniform vec2 u_texCoordScale;
+uniform vec2 u_texelSize;
+// Samples are clamped half a texel inside the source rectangle
+uniform vec2 u_maxTexCoord;
+
+layout (location = 0) out vec4 o_color;
+
+// Sample at given offset in source texels
+vec3 sampleSource(vec2 texCoord, vec2 offset)
+{
+    return textureLod(u_source,
+                      min(texCoord + offset * u_texelSize, u_maxTexCoord),
+                      0.0).rgb;
+}
+
+void main()
+{
+    vec2 texCoord = gl_FragCoord.xy * u_texCoordScale;
+    vec3 color = sampleSource(texCoord, vec2(0.0, 0.0)) * 4.0;
+    color += (sampleSource(texCoord, vec2(0.0, 1.0))
+              + sampleSource(texCoord, vec2(-1.0, 0.0))
+              + sampleSource(texCoord, vec2(1.0, 0.0))
+              + sampleSource(texCoord, vec2(0.0, -1.0)))
+           * 2.0;
+    color += sampleSource(texCoord, vec2(-1.0, 1.0))
+           + sampleSource(texCoord, vec2(1.0, 1.0))
+           + sampleSource(texCoord, vec2(-1.0, -1.0))
+           + sampleSource(texCoord, vec2(1.0, -1.0));
+    o_color = vec4(color / 16.0, 1.0);
+}
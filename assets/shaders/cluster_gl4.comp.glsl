@@ -0,0 +1,112 @@
+#version 430 core
+
+// Assignment of lights to clusters of the view frustum, one invocation per
+// cluster. Lights are loaded into shared memory in batches, transformed into
+// view space once per work group instead of once per cluster.
+layout (local_size_x = 64) in;
+
+// Grid size matches LightClusters of the renderer
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+const uint CLUSTER_COUNT = CLUSTER_GRID.x * CLUSTER_GRID.y * CLUSTER_GRID.z;
+const uint MAX_LIGHTS_PER_CLUSTER = 64;
+const uint CLUSTER_STRIDE = 1 + MAX_LIGHTS_PER_CLUSTER;
+const uint BATCH_SIZE = gl_WorkGroupSize.x;
+
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 colorCosOuter;
+    vec4 directionCosInner;
+};
+
+// Leading members of the per-frame data of model shaders
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    // Light structure of model shaders, padded to four components
+    vec4 u_lightDirection;
+    uint u_selectedObjectId;
+    uint u_shadowsEnabled;
+    uint u_lightCount;
+};
+
+layout (std430, binding = 4) readonly buffer LightBuffer
+{
+    PointLight u_lights[];
+};
+
+// Light count of each cluster followed by indices of its lights
+layout (std430, binding = 5) writeonly buffer ClusterBuffer
+{
+    uint u_clusterLights[];
+};
+
+// View space centers and radii of the current batch
+shared vec4 s_lights[BATCH_SIZE];
+
+void main()
+{
+    uint clusterIndex = gl_GlobalInvocationID.x;
+    uvec3 cluster = uvec3(clusterIndex % CLUSTER_GRID.x,
+                          clusterIndex / CLUSTER_GRID.x % CLUSTER_GRID.y,
+                          clusterIndex / (CLUSTER_GRID.x * CLUSTER_GRID.y));
+
+    // Frustum recovered from the perspective projection. Slices get
+    // exponentially thicker with depth.
+    vec2 tanHalfFov = vec2(1.0 / u_projection[0][0], 1.0 / u_projection[1][1]);
+    float nearPlane = u_projection[3][2] / (u_projection[2][2] - 1.0);
+    float farPlane = u_projection[3][2] / (u_projection[2][2] + 1.0);
+    float sliceNear = nearPlane * pow(farPlane / nearPlane,
+                                      float(cluster.z) / CLUSTER_GRID.z);
+    float sliceFar = nearPlane * pow(farPlane / nearPlane,
+                                     float(cluster.z + 1) / CLUSTER_GRID.z);
+
+    // Bounding box of the cluster in view space, covering the tile at both
+    // depths of the slice
+    vec2 tileMin = (vec2(cluster.xy) / vec2(CLUSTER_GRID.xy) * 2.0 - 1.0)
+                 * tanHalfFov;
+    vec2 tileMax = (vec2(cluster.xy + 1) / vec2(CLUSTER_GRID.xy) * 2.0 - 1.0)
+                 * tanHalfFov;
+    vec3 boxMin = vec3(min(tileMin * sliceNear, tileMin * sliceFar),
+                       -sliceFar);
+    vec3 boxMax = vec3(max(tileMax * sliceNear, tileMax * sliceFar),
+                       -sliceNear);
+
+    // Every invocation takes part in loading batches, including those past
+    // the last cluster, as barriers have to be reached by the whole group
+    uint base = clusterIndex * CLUSTER_STRIDE;
+    uint count = 0;
+    for (uint batch = 0; batch < u_lightCount; batch += BATCH_SIZE)
+    {
+        uint lightIndex = batch + gl_LocalInvocationIndex;
+        if (lightIndex < u_lightCount)
+        {
+            vec4 light = u_lights[lightIndex].positionRadius;
+            s_lights[gl_LocalInvocationIndex]
+                = vec4((u_view * vec4(light.xyz, 1.0)).xyz, light.w);
+        }
+        barrier();
+
+        uint batchSize = min(BATCH_SIZE, u_lightCount - batch);
+        for (uint i = 0; i < batchSize; ++i)
+        {
+            vec4 light = s_lights[i];
+            vec3 offset = clamp(light.xyz, boxMin, boxMax) - light.xyz;
+            if (dot(offset, offset) <= light.w * light.w
+                && count < MAX_LIGHTS_PER_CLUSTER
+                && clusterIndex < CLUSTER_COUNT)
+            {
+                u_clusterLights[base + 1 + count] = batch + i;
+                ++count;
+            }
+        }
+        barrier();
+    }
+    if (clusterIndex < CLUSTER_COUNT)
+    {
+        u_clusterLights[base] = count;
+    }
+}
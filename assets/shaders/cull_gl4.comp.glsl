@@ -0,0 +1,146 @@
+#version 430 core
+
+// Frustum and occlusion culling of indirect draw commands, compacting visible
+// commands into the draw buffer. One invocation per command.
+layout (local_size_x = 64) in;
+
+struct DrawData
+{
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+    DrawData u_draws[];
+};
+
+layout (std430, binding = 1) readonly buffer InputCommandBuffer
+{
+    DrawCommand u_inputCommands[];
+};
+
+// Cleared to zero before dispatch, so that commands past the visible ones
+// draw nothing when the whole buffer is submitted
+layout (std430, binding = 2) writeonly buffer OutputCommandBuffer
+{
+    DrawCommand u_outputCommands[];
+};
+
+layout (std430, binding = 3) buffer DrawCountBuffer
+{
+    uint u_drawCount;
+};
+
+uniform int u_commandCount;
+// Draw data holds view independent transforms, so that it only changes when
+// objects move
+uniform mat4 u_viewProjection;
+// Commands of sub-meshes of the same object are numbered one after the other
+// by base instance, sharing its draw data
+uniform int u_drawsPerObject;
+uniform bool u_occlusionEnabled;
+// Farthest depth of each texel of the previous frame, halving resolution on
+// each level starting from half of viewport resolution
+uniform sampler2D u_hiZ;
+uniform int u_hiZLevelCount;
+uniform int u_viewportWidth;
+uniform int u_viewportHeight;
+
+// Arena vertex positions are quantized relative to the bounding box of the
+// mesh, and model matrix includes their dequantization. Bounding box of every
+// mesh is the unit cube in arena vertex space.
+bool isVisible(mat4 mvp)
+{
+    vec3 ndcMin = vec3(1.0);
+    vec3 ndcMax = vec3(-1.0);
+    // Corners outside of each clip plane, frustum culled when all of them are
+    // outside of the same plane
+    int outsideLeft = 0;
+    int outsideRight = 0;
+    int outsideBottom = 0;
+    int outsideTop = 0;
+    int outsideNear = 0;
+    int outsideFar = 0;
+    bool crossesNearPlane = false;
+    for (int i = 0; i < 8; ++i)
+    {
+        vec4 corner = vec4(float(i & 1), float((i >> 1) & 1),
+                           float((i >> 2) & 1), 1.0);
+        vec4 clip = mvp * corner;
+        outsideLeft += int(clip.x < -clip.w);
+        outsideRight += int(clip.x > clip.w);
+        outsideBottom += int(clip.y < -clip.w);
+        outsideTop += int(clip.y > clip.w);
+        outsideNear += int(clip.z < -clip.w);
+        outsideFar += int(clip.z > clip.w);
+        if (clip.w <= 0.0)
+        {
+            crossesNearPlane = true;
+            continue;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+    if (outsideLeft == 8 || outsideRight == 8 || outsideBottom == 8
+        || outsideTop == 8 || outsideNear == 8 || outsideFar == 8)
+    {
+        return false;
+    }
+
+    // Projection of boxes reaching behind the camera is unbounded
+    if (!u_occlusionEnabled || crossesNearPlane)
+    {
+        return true;
+    }
+
+    // Pick the level where the screen rectangle of the box spans at most two
+    // texels per axis, so that four fetches cover it
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 viewportSize = vec2(u_viewportWidth, u_viewportHeight);
+    ivec2 texelMin = ivec2(uvMin * viewportSize) / 2;
+    ivec2 texelMax = ivec2(uvMax * viewportSize) / 2;
+    ivec2 extent = texelMax - texelMin + 1;
+    int level = int(ceil(log2(float(max(extent.x, extent.y)))));
+    level = clamp(level, 0, u_hiZLevelCount - 1);
+
+    ivec2 levelSize = textureSize(u_hiZ, level);
+    // Last texel of a level covers remainder of odd sized previous level
+    ivec2 levelMin = min(texelMin >> level, levelSize - 1);
+    ivec2 levelMax = min(texelMax >> level, levelSize - 1);
+    float occluderDepth = max(
+        max(texelFetch(u_hiZ, levelMin, level).r,
+            texelFetch(u_hiZ, ivec2(levelMax.x, levelMin.y), level).r),
+        max(texelFetch(u_hiZ, ivec2(levelMin.x, levelMax.y), level).r,
+            texelFetch(u_hiZ, levelMax, level).r));
+    float nearestDepth = ndcMin.z * 0.5 + 0.5;
+    return nearestDepth <= occluderDepth;
+}
+
+void main()
+{
+    int commandIndex = int(gl_GlobalInvocationID.x);
+    if (commandIndex >= u_commandCount)
+    {
+        return;
+    }
+
+    DrawCommand command = u_inputCommands[commandIndex];
+    uint object = command.baseInstance / uint(u_drawsPerObject);
+    if (isVisible(u_viewProjection * u_draws[object].model))
+    {
+        uint outputIndex = atomicAdd(u_drawCount, 1u);
+        u_outputCommands[outputIndex] = command;
+    }
+}
@@ -0,0 +1,7 @@
+#version 430 core
+
+// Depth prepass writes depth only. Color writes are disabled during the pass,
+// so nothing is shaded and no output is declared.
+void main()
+{
+}
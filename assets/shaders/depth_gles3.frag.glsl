@@ -0,0 +1,8 @@
+#version 300 es
+precision mediump float;
+
+// Depth prepass writes depth only. Color writes are disabled during the pass,
+// so nothing is shaded and no output is declared.
+void main()
+{
+}
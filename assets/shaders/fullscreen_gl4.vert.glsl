@@ -0,0 +1,11 @@
+#version 430 core
+
+// Fullscreen triangle generated from vertex index without vertex buffers, for
+// passes computing every pixel of their target in the fragment shader
+
+void main()
+{
+    // Vertices (-1, -1), (3, -1) and (-1, 3) cover the whole viewport
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,37 @@
+#version 430 core
+
+// Single level of hierarchical depth pyramid, storing the farthest depth of
+// the texels of the previous level covered by each texel
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// Depth buffer copy for the first level, previous pyramid level otherwise
+uniform sampler2D u_source;
+uniform int u_sourceLevel;
+layout (r32f, binding = 0) writeonly uniform image2D u_destination;
+
+void main()
+{
+    ivec2 destinationSize = imageSize(u_destination);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, destinationSize)))
+    {
+        return;
+    }
+
+    // Last texels of odd sized sources are covered by the last destination
+    // texel, so that no source texel is left out
+    ivec2 sourceSize = textureSize(u_source, u_sourceLevel);
+    ivec2 extent = ivec2(2)
+                 + ivec2(equal(texel, destinationSize - 1)) * (sourceSize & 1);
+    float depth = 0.0;
+    for (int y = 0; y < extent.y; ++y)
+    {
+        for (int x = 0; x < extent.x; ++x)
+        {
+            ivec2 sourceTexel = min(texel * 2 + ivec2(x, y), sourceSize - 1);
+            depth = max(depth,
+                        texelFetch(u_source, sourceTexel, u_sourceLevel).r);
+        }
+    }
+    imageStore(u_destination, texel, vec4(depth));
+}
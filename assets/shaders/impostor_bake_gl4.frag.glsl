@@ -0,0 +1,19 @@
+#version 430 core
+
+layout (location = 0) in vec3 v_normal;
+
+// Base color of the material of the sub-mesh
+uniform vec3 u_color;
+
+// Background of the atlas is cleared to zero, so that coverage in alpha
+// premultiplies both outputs when frames are filtered
+layout (location = 0) out vec4 o_color;
+// Model space normal, with depth in alpha running linearly from the near to
+// the far side of the bounding sphere
+layout (location = 1) out vec4 o_normalDepth;
+
+void main()
+{
+    o_color = vec4(u_color, 1.0);
+    o_normalDepth = vec4(normalize(v_normal) * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -0,0 +1,20 @@
+#version 430 core
+
+// Model drawn into a frame of an impostor atlas, seen orthographically from
+// the direction of the frame
+layout (location = 0) in vec3 a_position;
+layout (location = 1) in vec3 a_normal;
+
+// Dequantization of packed vertex positions, identity otherwise
+uniform mat4 u_model;
+uniform mat4 u_viewProjection;
+
+layout (location = 0) out vec3 v_normal;
+
+void main()
+{
+    gl_Position = u_viewProjection * u_model * vec4(a_position, 1.0);
+    // Normals are stored in model space, and turned into world space by the
+    // world matrix of each copy while drawing
+    v_normal = a_normal;
+}
@@ -0,0 +1,122 @@
+#version 430 core
+
+layout (location = 0) in vec4 v_frameUv01;
+layout (location = 1) in vec4 v_frameUv23;
+layout (location = 2) flat in vec4 v_frameOrigin01;
+layout (location = 3) flat in vec4 v_frameOrigin23;
+layout (location = 4) flat in vec4 v_frameWeights;
+layout (location = 5) in vec3 v_fragPos;
+layout (location = 6) flat in vec3 v_depthAxis;
+layout (location = 7) flat in mat3 v_normalMatrix;
+layout (location = 10) flat in uint v_objectId;
+
+// Matches frame grid of ImpostorAtlas
+const float FRAME_GRID_SIZE = 8.0;
+const float FRAME_SIZE = 128.0;
+const int SHADOW_CASCADE_COUNT = 4;
+const vec3 SELECTION_COLOR = vec3(1.0, 0.6, 0.1);
+
+struct Light
+{
+    vec3 direction;
+};
+
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    uint u_selectedObjectId;
+    uint u_shadowsEnabled;
+    uint u_lightCount;
+    uint u_ambientOcclusionEnabled;
+    mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    vec4 u_shadowSplitDepths;
+    vec4 u_clusterScale;
+    mat4 u_eyeViewProjections[2];
+};
+
+// Base color and coverage, premultiplied
+uniform sampler2D u_colorAtlas;
+// Model space normal and depth through the bounding sphere, premultiplied
+uniform sampler2D u_normalDepthAtlas;
+// Model color tinting the atlas
+uniform vec3 u_color;
+
+layout (location = 0) out vec4 o_FragColor;
+// Written only while picking attaches an object identifier buffer, dropped
+// otherwise
+layout (location = 1) out uint o_objectId;
+
+// Texture coordinates kept half a texel inside the frame, so that filtering
+// does not reach into neighboring frames
+vec2 atlasUv(vec2 origin, vec2 uv)
+{
+    const float halfTexel = 0.5 / FRAME_SIZE;
+    return (origin + clamp(uv, halfTexel, 1.0 - halfTexel)) / FRAME_GRID_SIZE;
+}
+
+void sampleFrame(vec2 origin,
+                 vec2 uv,
+                 float weight,
+                 inout vec4 color,
+                 inout vec4 normalDepth)
+{
+    vec2 coordinates = atlasUv(origin, uv);
+    color += weight * texture(u_colorAtlas, coordinates);
+    normalDepth += weight * texture(u_normalDepthAtlas, coordinates);
+}
+
+void main()
+{
+    vec4 color = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    sampleFrame(v_frameOrigin01.xy,
+                v_frameUv01.xy,
+                v_frameWeights.x,
+                color,
+                normalDepth);
+    sampleFrame(v_frameOrigin01.zw,
+                v_frameUv01.zw,
+                v_frameWeights.y,
+                color,
+                normalDepth);
+    sampleFrame(v_frameOrigin23.xy,
+                v_frameUv23.xy,
+                v_frameWeights.z,
+                color,
+                normalDepth);
+    sampleFrame(v_frameOrigin23.zw,
+                v_frameUv23.zw,
+                v_frameWeights.w,
+                color,
+                normalDepth);
+    // Alpha tested instead of blended, so that impostors are drawn with
+    // opaque geometry
+    if (color.a < 0.5)
+    {
+        discard;
+    }
+    vec3 albedo = color.rgb / color.a;
+    vec3 norm = normalize(v_normalMatrix
+                          * (normalDepth.rgb / color.a * 2.0 - 1.0));
+    // Baked depth runs from the near side of the sphere at zero to the far
+    // side at one
+    float depth = normalDepth.a / color.a;
+    vec3 fragPos = v_fragPos + v_depthAxis * (1.0 - 2.0 * depth);
+    vec4 clipPos = u_viewProjection * vec4(fragPos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+
+    // Ambient and directional light only
+    vec3 baseColor = u_color * albedo;
+    vec3 lightDir = normalize(-u_light.direction);
+    vec3 result = (0.2 + max(dot(norm, lightDir), 0.0)) * baseColor;
+    if (v_objectId == u_selectedObjectId)
+    {
+        result = mix(result, SELECTION_COLOR, 0.5);
+    }
+    o_FragColor = vec4(result, 1.0);
+    o_objectId = v_objectId;
+}
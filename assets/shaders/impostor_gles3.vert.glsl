@@ -0,0 +1,143 @@
+#version 300 es
+precision highp float;
+
+// Per-instance world matrix, bound the same way as for the instanced model
+// shader. Quad corners come from the vertex index, without vertex attributes.
+layout (location = 3) in mat4 a_worldMatrix;
+
+// Matches frame grid of ImpostorAtlas
+const float FRAME_GRID_SIZE = 8.0;
+const int SHADOW_CASCADE_COUNT = 4;
+
+struct Light
+{
+    vec3 direction;
+};
+
+// Shared with the model shader, only camera data is read
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    uint u_selectedObjectId;
+    uint u_shadowsEnabled;
+    uint u_lightCount;
+    uint u_ambientOcclusionEnabled;
+    mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    vec4 u_shadowSplitDepths;
+    vec4 u_clusterScale;
+    mat4 u_eyeViewProjections[2];
+};
+
+// Bounding sphere of the model in model space, center in xyz and radius in w
+uniform vec4 u_boundingSphere;
+// Texture coordinates of the fragment within each of the four blended frames
+out vec4 v_frameUv01;
+out vec4 v_frameUv23;
+// Grid positions of the four frames
+flat out vec4 v_frameOrigin01;
+flat out vec4 v_frameOrigin23;
+flat out vec4 v_frameWeights;
+// Point on the quad, through the center of the bounding sphere
+out vec3 v_fragPos;
+// Offset toward the camera of the nearest point of the bounding sphere
+flat out vec3 v_depthAxis;
+flat out mat3 v_normalMatrix;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Octahedral coordinates in [-1, 1] range of a unit direction, up axis at the
+// center and the lower hemisphere folded over the corners
+vec2 octahedralEncode(vec3 direction)
+{
+    vec2 p = direction.xz
+           / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    if (direction.y < 0.0)
+    {
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    }
+    return p;
+}
+
+// Inverse of octahedralEncode, matching directions frames are baked from
+vec3 octahedralDecode(vec2 p)
+{
+    vec3 direction = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (direction.y < 0.0)
+    {
+        direction.xz = (1.0 - abs(p.yx)) * signNotZero(p);
+    }
+    return normalize(direction);
+}
+
+// Right and up axes of the orthographic view looking against direction,
+// matching the up vector frames are baked with
+void frameAxes(vec3 direction, out vec3 right, out vec3 up)
+{
+    vec3 reference = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0)
+                                              : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(reference, direction));
+    up = cross(direction, right);
+}
+
+// Position of model space offset from the sphere center within frame
+vec2 frameUv(vec2 frame, vec3 offset)
+{
+    vec3 right;
+    vec3 up;
+    frameAxes(octahedralDecode((frame + 0.5) / FRAME_GRID_SIZE * 2.0 - 1.0),
+              right,
+              up);
+    return vec2(dot(offset, right), dot(offset, up)) / u_boundingSphere.w
+         * 0.5
+         + 0.5;
+}
+
+void main()
+{
+    vec3 center = vec3(a_worldMatrix * vec4(u_boundingSphere.xyz, 1.0));
+    // World matrices consist of rotation, translation and uniform scale
+    float scale = length(a_worldMatrix[0].xyz);
+    mat3 rotation = mat3(a_worldMatrix) / scale;
+
+    // Orthographic projections see every copy from the same direction
+    vec3 toCamera = u_projection[3][3] == 1.0
+                      ? vec3(u_view[0][2], u_view[1][2], u_view[2][2])
+                      : u_viewPos - center;
+    vec3 worldDirection = normalize(toCamera);
+    vec3 direction = normalize(transpose(rotation) * worldDirection);
+
+    // Four frames around the direction, weighted bilinearly
+    vec2 grid = (octahedralEncode(direction) * 0.5 + 0.5) * FRAME_GRID_SIZE
+              - 0.5;
+    vec2 base = clamp(floor(grid), vec2(0.0), vec2(FRAME_GRID_SIZE - 2.0));
+    vec2 blend = clamp(grid - base, 0.0, 1.0);
+
+    // Quad faces the camera, oriented like the frames around it
+    vec3 right;
+    vec3 up;
+    frameAxes(direction, right, up);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 offset = (right * corner.x + up * corner.y) * u_boundingSphere.w;
+
+    v_frameUv01 = vec4(frameUv(base, offset),
+                       frameUv(base + vec2(1.0, 0.0), offset));
+    v_frameUv23 = vec4(frameUv(base + vec2(0.0, 1.0), offset),
+                       frameUv(base + vec2(1.0), offset));
+    v_frameOrigin01 = vec4(base, base + vec2(1.0, 0.0));
+    v_frameOrigin23 = vec4(base + vec2(0.0, 1.0), base + vec2(1.0));
+    v_frameWeights = vec4((1.0 - blend.x) * (1.0 - blend.y),
+                          blend.x * (1.0 - blend.y),
+                          (1.0 - blend.x) * blend.y,
+                          blend.x * blend.y);
+    v_fragPos = center + rotation * offset * scale;
+    v_depthAxis = worldDirection * u_boundingSphere.w * scale;
+    v_normalMatrix = rotation;
+    gl_Position = u_viewProjection * vec4(v_fragPos, 1.0);
+}
@@ -0,0 +1,106 @@
+#version 430 core
+
+// Decode packed vertices or indices compressed by meshcodec straight into
+// buffers of the geometry arena. One work group per block, one invocation per
+// element. Each channel of a block is stored as its minimum followed by the
+// bit-packed differences of the elements from it.
+layout (local_size_x = 64) in;
+
+const uint BLOCK_SIZE = 64u;
+const uint VERTEX_CHANNEL_COUNT = 9u;
+const uint SNORM10_OFFSET = 0x200u;
+const uint SNORM2_OFFSET = 0x2u;
+const uint SNORM10_MASK = 0x3FFu;
+
+layout (std430, binding = 0) readonly buffer EncodedBuffer
+{
+    uint u_encoded[];
+};
+
+// Vertices are written as four words each, matching PackedVertex
+layout (std430, binding = 1) writeonly buffer DecodedBuffer
+{
+    uint u_decoded[];
+};
+
+// Word offset of the stream in the encoded buffer, starting with the block
+// offsets relative to it
+uniform int u_streamOffset;
+uniform int u_elementCount;
+// Block of the first work group, as dispatches are limited in size
+uniform int u_firstBlock;
+// Word offset of the first element in the decoded buffer
+uniform int u_decodedOffset;
+// Packed vertices when set, indices otherwise
+uniform bool u_vertices;
+
+uint blockOffset;
+uint channelCount;
+
+uint readChannel(uint channel, uint lane)
+{
+    uint widthsOffset = blockOffset + channelCount;
+    uint wordOffset = widthsOffset + (channelCount + 3u) / 4u;
+    for (uint previous = 0u; previous < channel; ++previous)
+    {
+        wordOffset += 2u
+                    * bitfieldExtract(u_encoded[widthsOffset + previous / 4u],
+                                      int(previous % 4u) * 8,
+                                      8);
+    }
+    uint width = bitfieldExtract(u_encoded[widthsOffset + channel / 4u],
+                                 int(channel % 4u) * 8,
+                                 8);
+    uint minimum = u_encoded[blockOffset + channel];
+    if (width == 0u)
+    {
+        return minimum;
+    }
+    uint bitOffset = lane * width;
+    uint word = wordOffset + bitOffset / 32u;
+    uint shift = bitOffset % 32u;
+    uint difference = u_encoded[word] >> shift;
+    if (shift + width > 32u)
+    {
+        difference |= u_encoded[word + 1u] << (32u - shift);
+    }
+    if (width < 32u)
+    {
+        difference &= (1u << width) - 1u;
+    }
+    return minimum + difference;
+}
+
+void main()
+{
+    uint block = uint(u_firstBlock) + gl_WorkGroupID.x;
+    uint lane = gl_LocalInvocationID.x;
+    uint element = block * BLOCK_SIZE + lane;
+    if (element >= uint(u_elementCount))
+    {
+        return;
+    }
+    uint streamOffset = uint(u_streamOffset);
+    blockOffset = streamOffset + u_encoded[streamOffset + block];
+    uint decodedOffset = uint(u_decodedOffset);
+
+    if (!u_vertices)
+    {
+        channelCount = 1u;
+        u_decoded[decodedOffset + element] = readChannel(0u, lane);
+        return;
+    }
+    channelCount = VERTEX_CHANNEL_COUNT;
+    uint base = decodedOffset + element * 4u;
+    u_decoded[base] = readChannel(0u, lane) | (readChannel(1u, lane) << 16);
+    // Fourth position component is padding
+    u_decoded[base + 1u] = readChannel(2u, lane);
+    u_decoded[base + 2u]
+        = ((readChannel(3u, lane) ^ SNORM10_OFFSET) & SNORM10_MASK)
+        | (((readChannel(4u, lane) ^ SNORM10_OFFSET) & SNORM10_MASK) << 10)
+        | (((readChannel(5u, lane) ^ SNORM10_OFFSET) & SNORM10_MASK) << 20)
+        | ((readChannel(6u, lane) ^ SNORM2_OFFSET) << 30);
+    // Half float texture coordinates
+    u_decoded[base + 3u]
+        = readChannel(7u, lane) | (readChannel(8u, lane) << 16);
+}
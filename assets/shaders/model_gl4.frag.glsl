@@ -1,64 +1,322 @@
 #version 430 core
 
-in vec3 v_fragPos;
-in vec3 v_normal;
+layout (location = 0) in vec3 v_fragPos;
+layout (location = 1) in vec3 v_normal;
+layout (location = 2) flat in uint v_objectId;
+// Model color tinted by the base color of the material of the sub-mesh
+layout (location = 4) flat in vec3 v_color;
+// Tinted further by the base color texture of the material, if any
+layout (location = 5) in vec2 v_texCoord;
+layout (location = 6) flat in int v_textureLayer;
+#ifdef WIREFRAME_ENABLED
+// Barycentric coordinates added by the wireframe geometry shader, interpolated
+// in screen space so that edge width does not depend on depth
+layout (location = 3) noperspective in vec3 v_barycentric;
+#endif
+
+// Matches cascade count of the shadow map of the renderer
+const int SHADOW_CASCADE_COUNT = 4;
+// Matches cluster grid of the light clusters of the renderer
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+const uint CLUSTER_STRIDE = 65u;
+const vec3 SELECTION_COLOR = vec3(1.0, 0.6, 0.1);
+const vec3 WIREFRAME_COLOR = vec3(0.05);
+// Edge width in pixels
+const float WIREFRAME_WIDTH = 1.5;
+
+#ifdef OVERDRAW_ENABLED
+// Red added by each shaded fragment in the overdraw view, counted into layers
+// by the heatmap of the tonemapping shader
+const float OVERDRAW_INCREMENT = 1.0 / 32.0;
+#endif
 
 struct Light
 {
     vec3 direction; // Light direction vector is determined from origin (0,0,0)
 };
 
-uniform vec3 u_color;
-uniform Light u_light;
-uniform vec3 u_viewPos;
+// Per-frame data shared by every draw, uploaded once per frame. Layout
+// matches FrameUniforms of the renderer.
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    // Object highlighted as selected, zero when none is
+    uint u_selectedObjectId;
+    // Zero while shadows are disabled and the shadow map is not sampled
+    uint u_shadowsEnabled;
+    // Point and spot lights assigned to clusters
+    uint u_lightCount;
+    // Zero while ambient occlusion is disabled and not sampled
+    uint u_ambientOcclusionEnabled;
+    // Transformations from world space into clip space of each cascade
+    mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    // View space depth at which each cascade ends
+    vec4 u_shadowSplitDepths;
+    // Scale and bias turning fragment coordinates and logarithm of view
+    // depth into cluster coordinates
+    vec4 u_clusterScale;
+    // View projection of each eye drawn by single-pass stereo
+    mat4 u_eyeViewProjections[2];
+};
 
-layout (location = 0) out vec4 o_FragColor;
+// Per-object data of the draw. Layout matches ObjectUniforms of the renderer.
+layout (std140) uniform ObjectData
+{
+    mat4 u_model;
+    mat4 u_mvp;
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    uint u_objectId;
+    float u_transparency;
+    int u_textureLayer;
+};
+
+// Cascades of the shadow map in layers, compared against reference depth by
+// the texture unit
+uniform sampler2DArrayShadow u_shadowMap;
+// Ambient occlusion of the scene at full resolution, computed after the depth
+// prepass
+uniform sampler2D u_ambientOcclusion;
+// Base color textures of the materials of the model in layers
+uniform sampler2DArray u_materialTextures;
+
+struct PointLight
+{
+    vec4 positionRadius;
+    // Cosine of the outer angle of spot light cones in w
+    vec4 colorCosOuter;
+    // Cosine of the angle where spot lights start fading out in w
+    vec4 directionCosInner;
+};
+
+// Point and spot lights, and light count of each cluster followed by the
+// indices of its lights, filled by the light assignment compute shader
+layout (std430, binding = 4) readonly buffer LightBuffer
+{
+    PointLight u_pointLights[];
+};
+
+layout (std430, binding = 5) readonly buffer ClusterBuffer
+{
+    uint u_clusterLights[];
+};
 
-subroutine vec3 CreateDiffuse(vec3 norm, vec3 lightDir);
-subroutine uniform CreateDiffuse createDiffuse;
+layout (location = 0) out vec4 o_FragColor;
+// Written only while picking attaches an object identifier buffer, dropped
+// otherwise
+layout (location = 1) out uint o_objectId;
+// Sum of weights of transparent surfaces, written only by the transparency
+// pass
+layout (location = 2) out float o_weight;
 
-subroutine vec3 CreateSpecular(vec3 norm, vec3 lightDir);
-subroutine uniform CreateSpecular createSpecular;
+// Lighting terms are selected by defines prepended to the source when the
+// shader variant is compiled, so that no branching happens per fragment:
+//
+// DIFFUSE_ENABLED
+// SPECULAR_ENABLED
+//
+// WIREFRAME_ENABLED overlays triangle edges on the shaded surface.
+// Material color tinted by the base color texture. Every model binds a texture
+// array, so the texture is sampled in uniform control flow and only left out
+// afterwards for untextured materials.
+vec3 createBaseColor()
+{
+    vec3 texel = texture(u_materialTextures,
+                         vec3(v_texCoord, float(max(v_textureLayer, 0))))
+                     .rgb;
+    return v_textureLayer >= 0 ? v_color * texel : v_color;
+}
 
-subroutine(CreateDiffuse)
-vec3 DiffuseEnabled(vec3 norm, vec3 lightDir)
+vec3 createDiffuse(vec3 norm, vec3 lightDir, vec3 baseColor)
 {
+#ifdef DIFFUSE_ENABLED
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * u_color;
+    vec3 diffuse = diff * baseColor;
     return diffuse;
+#else
+    return vec3(0.0);
+#endif
 }
 
-subroutine(CreateSpecular)
-vec3 SpecularEnabled(vec3 norm, vec3 lightDir)
+vec3 createSpecular(vec3 norm, vec3 lightDir, vec3 baseColor)
 {
+#ifdef SPECULAR_ENABLED
     vec3 viewDir = normalize(u_viewPos - v_fragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
-    vec3 specular = 1.0 * spec * u_color;
+    vec3 specular = 1.0 * spec * baseColor;
     return specular;
+#else
+    return vec3(0.0);
+#endif
 }
 
-subroutine(CreateDiffuse, CreateSpecular)
-vec3 Disabled(vec3 norm, vec3 lightDir)
+float createShadow(float viewDepth)
 {
-    return vec3(0.0);
+    if (u_shadowsEnabled == 0u)
+    {
+        return 1.0;
+    }
+    // Nearest cascade whose slice of the view frustum contains the fragment
+    int cascade = int(dot(vec4(greaterThan(vec4(viewDepth),
+                                           u_shadowSplitDepths)),
+                          vec4(1.0)));
+    if (cascade >= SHADOW_CASCADE_COUNT)
+    {
+        return 1.0;
+    }
+    // Projection of the light is orthographic, leaving w at one
+    vec3 shadowCoord
+        = (u_lightViewProjections[cascade] * vec4(v_fragPos, 1.0)).xyz * 0.5
+        + 0.5;
+    if (shadowCoord.z > 1.0)
+    {
+        return 1.0;
+    }
+    // Each fetch already filters four texels after comparison. Four fetches
+    // half a texel apart widen the filter to soften edges further.
+    vec2 texelSize = 1.0 / vec2(textureSize(u_shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texelSize;
+        lit += texture(u_shadowMap,
+                       vec4(shadowCoord.xy + offset,
+                            float(cascade),
+                            shadowCoord.z));
+    }
+    return lit * 0.25;
+}
+
+// Sum of point and spot lights listed by the cluster of the fragment. Only
+// lights whose sphere of influence reaches the cluster are visited.
+vec3 createPointLights(vec3 norm, float viewDepth)
+{
+    if (u_lightCount == 0u)
+    {
+        return vec3(0.0);
+    }
+    // Slices get exponentially thicker with view depth
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * u_clusterScale.xy),
+                     CLUSTER_GRID.xy - 1u);
+    uint slice
+        = min(uint(max(log(viewDepth) * u_clusterScale.z + u_clusterScale.w,
+                       0.0)),
+              CLUSTER_GRID.z - 1u);
+    uint cluster = tile.x
+                 + CLUSTER_GRID.x * (tile.y + CLUSTER_GRID.y * slice);
+    uint base = cluster * CLUSTER_STRIDE;
+    uint count = u_clusterLights[base];
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < count; ++i)
+    {
+        PointLight light = u_pointLights[u_clusterLights[base + 1u + i]];
+        vec4 positionRadius = light.positionRadius;
+        vec4 colorCosOuter = light.colorCosOuter;
+        vec4 directionCosInner = light.directionCosInner;
+        vec3 toLight = positionRadius.xyz - v_fragPos;
+        float distanceSquared = dot(toLight, toLight);
+        vec3 lightDir = toLight * inversesqrt(max(distanceSquared, 1e-8));
+        // Inverse square falloff windowed to reach zero at the radius
+        float ratio = distanceSquared / (positionRadius.w * positionRadius.w);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (distanceSquared + 1.0);
+        // Lights shining in all directions have cone cosines below -1
+        attenuation *= smoothstep(colorCosOuter.w,
+                                  directionCosInner.w,
+                                  dot(-lightDir, directionCosInner.xyz));
+        result += colorCosOuter.rgb * attenuation
+                * (createDiffuse(norm, lightDir)
+                   + createSpecular(norm, lightDir));
+    }
+    return result;
 }
 
+// Weight of a transparent surface of given opacity in weighted blended
+// order-independent transparency, favoring surfaces near the camera. Bounded,
+// so that a few layers of bright surfaces still fit half float accumulation.
+float transparencyWeight(float alpha, float viewDepth)
+{
+    return alpha
+         * clamp(10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0)
+                         + pow(viewDepth / 200.0, 6.0)),
+                 1e-2,
+                 3e2);
+}
+
+#ifdef WIREFRAME_ENABLED
+vec3 applyWireframe(vec3 color, vec3 barycentric)
+{
+    // Screen space rate of change turns barycentric coordinates into pixel
+    // distances from the opposite edges. Lines fade out over the last pixel
+    // for antialiasing.
+    vec3 edgeDistance = barycentric / fwidth(barycentric);
+    float nearestEdge = min(min(edgeDistance.x, edgeDistance.y),
+                            edgeDistance.z);
+    float coverage = 1.0 - smoothstep(WIREFRAME_WIDTH - 1.0,
+                                      WIREFRAME_WIDTH,
+                                      nearestEdge);
+    return mix(color, WIREFRAME_COLOR, coverage);
+}
+#endif
+
 void main()
 {
-    // Ambient
+#ifdef OVERDRAW_ENABLED
+    // Layers of fragments covering the pixel add up by additive blending
+    o_FragColor = vec4(OVERDRAW_INCREMENT, 0.0, 0.0, 1.0);
+    o_objectId = v_objectId;
+#else
+    // Ambient, darkened in creases and corners by ambient occlusion
     float ambientStrength = 0.2;
-    vec3 ambient = ambientStrength * u_color;
+    float ambientOcclusion = 1.0;
+    if (u_ambientOcclusionEnabled != 0u)
+    {
+        ambientOcclusion
+            = texelFetch(u_ambientOcclusion, ivec2(gl_FragCoord.xy), 0).r;
+    }
+    vec3 baseColor = createBaseColor();
+    vec3 ambient = ambientStrength * ambientOcclusion * baseColor;
 
     vec3 norm = normalize(v_normal);
     vec3 lightDir = normalize(-u_light.direction);
 
     // Diffuse
-    vec3 diffuse = createDiffuse(norm, lightDir);
+    vec3 diffuse = createDiffuse(norm, lightDir, baseColor);
 
     // Specular
-    vec3 specular = createSpecular(norm, lightDir);
+    vec3 specular = createSpecular(norm, lightDir, baseColor);
+
+    float viewDepth = -(u_view * vec4(v_fragPos, 1.0)).z;
+
+    // Shadowed fragments keep ambient light only
+    float shadow = createShadow(viewDepth);
 
-    vec3 result = ambient + diffuse + specular;
+    vec3 result = ambient + shadow * (diffuse + specular)
+                + createPointLights(norm, viewDepth);
+    if (v_objectId == u_selectedObjectId)
+    {
+        result = mix(result, SELECTION_COLOR, 0.5);
+    }
+#ifdef WIREFRAME_ENABLED
+    result = applyWireframe(result, v_barycentric);
+#endif
+    o_objectId = v_objectId;
+    if (u_transparency > 0.0)
+    {
+        // Transparent surfaces are accumulated in any order. Weighted color
+        // adds up in RGB, while alpha multiplies into the fraction of the
+        // background still revealed.
+        float alpha = 1.0 - u_transparency;
+        float weight = transparencyWeight(alpha, viewDepth);
+        o_FragColor = vec4(result * weight, alpha);
+        o_weight = weight;
+        return;
+    }
     o_FragColor = vec4(result, 1.0);
+#endif
 }
@@ -2,23 +2,57 @@
 
 layout (location = 0) in vec3 a_position;
 layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_texCoord;
 
-uniform mat4 u_model;
-uniform mat4 u_mvp;
-// Normal matrix is used for correctly transform the input vertex normals to
-// for to world space. A normal matrix is the transpose of the
-// inverse of the upper-left 3x3 portion of the model matrix.
-//
-// normalMatrix = mat3(transpose(inverse(modelMatrix)))
-//
-uniform mat3 u_normalMatrix;
+// Per-object data, written into the next slot of a ring buffer for each
+// draw. Layout matches ObjectUniforms of the renderer.
+layout (std140) uniform ObjectData
+{
+    // Packed vertex positions arrive normalized relative to the bounding box
+    // of the mesh. Model matrix and MVP matrix include their dequantization.
+    mat4 u_model;
+    mat4 u_mvp;
+    // Normal matrix is used for correctly transform the input vertex normals
+    // to world space. A normal matrix is the transpose of the inverse of the
+    // upper-left 3x3 portion of the model matrix, stored with padded columns.
+    //
+    // normalMatrix = mat3(transpose(inverse(modelMatrix)))
+    //
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    // Identifier of the object written into the object identifier attachment
+    // for picking, or of the first copy when drawing several
+    uint u_objectId;
+    // Fraction of light passing through surfaces of transparent materials,
+    // zero for opaque ones
+    float u_transparency;
+    // Layer of the base color texture of the material in the texture array
+    // of the model, negative for untextured materials
+    int u_textureLayer;
+};
+
+// Outputs are matched to fragment shader inputs by location, so that the
+// wireframe geometry shader in between can pass them on under other names
+layout (location = 0) out vec3 v_fragPos;
+layout (location = 1) out vec3 v_normal;
+layout (location = 2) flat out uint v_objectId;
+// Location 3 is taken by barycentric coordinates of the wireframe geometry
+// shader
+layout (location = 4) flat out vec3 v_color;
+layout (location = 5) out vec2 v_texCoord;
+layout (location = 6) flat out int v_textureLayer;
 
-out vec3 v_fragPos;
-out vec3 v_normal;
+// Depth prepass and color pass share this shader in separate programs, whose
+// depths have to match exactly to pass the equal depth test
+invariant gl_Position;
 
 void main()
 {
     gl_Position = u_mvp * vec4(a_position, 1.0);
     v_fragPos = vec3(u_model * vec4(a_position, 1.0));
-    v_normal = u_normalMatrix * a_normal;
+    v_normal = mat3(u_normalMatrix) * a_normal;
+    v_objectId = u_objectId;
+    v_color = u_color;
+    v_texCoord = a_texCoord;
+    v_textureLayer = u_textureLayer;
 }
@@ -3,56 +3,309 @@ precision mediump float;
 
 in vec3 v_fragPos;
 in vec3 v_normal;
+// Sampling the base color texture of the material, if any
+in vec2 v_texCoord;
+#ifdef WIREFRAME_ENABLED
+// Barycentric coordinates of the vertex within its triangle
+in highp vec3 v_barycentric;
+#endif
+
+// Matches cascade count of the shadow map of the renderer
+const int SHADOW_CASCADE_COUNT = 4;
+// Matches cluster grid of the light clusters of the renderer
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+const uint CLUSTER_STRIDE = 65u;
+const vec3 WIREFRAME_COLOR = vec3(0.05);
+// Edge width in pixels
+const float WIREFRAME_WIDTH = 1.5;
+
+#ifdef OVERDRAW_ENABLED
+// Red added by each shaded fragment in the overdraw view, counted into layers
+// by the heatmap of the tonemapping shader
+const float OVERDRAW_INCREMENT = 1.0 / 32.0;
+#endif
 
 struct Light
 {
     vec3 direction; // Light direction vector is determined from origin (0,0,0)
 };
 
-struct AdsProperties
+// Per-frame data shared by every draw, uploaded once per frame. Layout
+// matches FrameUniforms of the renderer.
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    highp uint u_selectedObjectId;
+    // Zero while shadows are disabled and the shadow map is not sampled
+    highp uint u_shadowsEnabled;
+    // Point and spot lights assigned to clusters
+    highp uint u_lightCount;
+    // Zero while ambient occlusion is disabled and not sampled
+    highp uint u_ambientOcclusionEnabled;
+    // Transformations from world space into clip space of each cascade
+    highp mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    // View space depth at which each cascade ends
+    highp vec4 u_shadowSplitDepths;
+    // Scale and bias turning fragment coordinates and logarithm of view
+    // depth into cluster coordinates
+    highp vec4 u_clusterScale;
+    // View projection of each eye drawn by single-pass stereo
+    highp mat4 u_eyeViewProjections[2];
+};
+
+// Per-object data, written into the next slot of a ring buffer for each
+// draw. Layout matches ObjectUniforms of the renderer.
+layout (std140) uniform ObjectData
 {
-    int diffuseEnabled;
-    int specularEnabled;
+    // Packed vertex positions arrive normalized relative to the bounding box
+    // of the mesh. Model matrix and MVP matrix include their dequantization.
+    mat4 u_model;
+    mat4 u_mvp;
+    // Normal matrix is used for correctly transform the input vertex normals
+    // to world space. A normal matrix is the transpose of the inverse of the
+    // upper-left 3x3 portion of the model matrix, stored with padded columns.
+    //
+    // normalMatrix = mat3(transpose(inverse(modelMatrix)))
+    //
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    // Object identifier of picking, which is not available in OpenGL ES 3.0,
+    // only keeping the layout of ObjectUniforms
+    highp uint u_objectId;
+    // Fraction of light passing through surfaces of transparent materials,
+    // zero for opaque ones
+    highp float u_transparency;
+    // Layer of the base color texture of the material in the texture array
+    // of the model, negative for untextured materials
+    highp int u_textureLayer;
 };
 
-uniform vec3 u_color;
-uniform Light u_light;
-uniform vec3 u_viewPos;
-uniform AdsProperties u_adsProps;
+// Cascades of the shadow map in layers, compared against reference depth by
+// the texture unit
+uniform mediump sampler2DArrayShadow u_shadowMap;
+// Ambient occlusion of the scene at full resolution, computed after the depth
+// prepass
+uniform mediump sampler2D u_ambientOcclusion;
+// Base color textures of the materials of the model in layers
+uniform mediump sampler2DArray u_materialTextures;
+
+// Point and spot lights as rows of three texels, holding position and radius,
+// color and cosine of the outer angle of spot light cones, and direction and
+// cosine of the angle where spot lights start fading out
+uniform highp sampler2D u_lights;
+// Light count of each cluster followed by the indices of its lights. Rows hold
+// the lists of a row of tiles in a slice.
+uniform highp usampler2D u_clusterLights;
 
 layout (location = 0) out vec4 o_FragColor;
+// Sum of weights of transparent surfaces, written only by the transparency
+// pass
+layout (location = 2) out float o_weight;
 
-vec3 createDiffuse(vec3 norm, vec3 lightDir)
+// Lighting terms are selected by defines prepended to the source when the
+// shader variant is compiled, so that no branching happens per fragment:
+//
+// DIFFUSE_ENABLED
+// SPECULAR_ENABLED
+//
+// WIREFRAME_ENABLED overlays triangle edges on the shaded surface.
+// Material color tinted by the base color texture. Every model binds a texture
+// array, so the texture is sampled in uniform control flow and only left out
+// afterwards for untextured materials.
+vec3 createBaseColor()
 {
+    vec3 texel = texture(u_materialTextures,
+                         vec3(v_texCoord, float(max(u_textureLayer, 0))))
+                     .rgb;
+    return u_textureLayer >= 0 ? u_color * texel : u_color;
+}
+
+vec3 createDiffuse(vec3 norm, vec3 lightDir, vec3 baseColor)
+{
+#ifdef DIFFUSE_ENABLED
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * u_color;
+    vec3 diffuse = diff * baseColor;
     return diffuse;
+#else
+    return vec3(0.0);
+#endif
 }
 
-vec3 createSpecular(vec3 norm, vec3 lightDir)
+vec3 createSpecular(vec3 norm, vec3 lightDir, vec3 baseColor)
 {
+#ifdef SPECULAR_ENABLED
     vec3 viewDir = normalize(u_viewPos - v_fragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
-    vec3 specular = 1.0 * spec * u_color;
+    vec3 specular = 1.0 * spec * baseColor;
     return specular;
+#else
+    return vec3(0.0);
+#endif
+}
+
+float createShadow(highp float viewDepth)
+{
+    if (u_shadowsEnabled == 0u)
+    {
+        return 1.0;
+    }
+    // Nearest cascade whose slice of the view frustum contains the fragment
+    int cascade = int(dot(vec4(greaterThan(vec4(viewDepth),
+                                           u_shadowSplitDepths)),
+                          vec4(1.0)));
+    if (cascade >= SHADOW_CASCADE_COUNT)
+    {
+        return 1.0;
+    }
+    // Projection of the light is orthographic, leaving w at one
+    vec3 shadowCoord
+        = (u_lightViewProjections[cascade] * vec4(v_fragPos, 1.0)).xyz * 0.5
+        + 0.5;
+    if (shadowCoord.z > 1.0)
+    {
+        return 1.0;
+    }
+    // Each fetch already filters four texels after comparison. Four fetches
+    // half a texel apart widen the filter to soften edges further.
+    vec2 texelSize = 1.0 / vec2(textureSize(u_shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texelSize;
+        lit += texture(u_shadowMap,
+                       vec4(shadowCoord.xy + offset,
+                            float(cascade),
+                            shadowCoord.z));
+    }
+    return lit * 0.25;
 }
 
+// Sum of point and spot lights listed by the cluster of the fragment. Only
+// lights whose sphere of influence reaches the cluster are visited.
+vec3 createPointLights(vec3 norm, highp float viewDepth)
+{
+    if (u_lightCount == 0u)
+    {
+        return vec3(0.0);
+    }
+    // Slices get exponentially thicker with view depth
+    highp uvec2 tile = min(uvec2(gl_FragCoord.xy * u_clusterScale.xy),
+                           CLUSTER_GRID.xy - 1u);
+    highp uint slice
+        = min(uint(max(log(viewDepth) * u_clusterScale.z + u_clusterScale.w,
+                       0.0)),
+              CLUSTER_GRID.z - 1u);
+    ivec2 listCoord = ivec2(tile.x * CLUSTER_STRIDE,
+                            tile.y + CLUSTER_GRID.y * slice);
+    highp uint count = texelFetch(u_clusterLights, listCoord, 0).r;
+    vec3 result = vec3(0.0);
+    for (highp uint i = 0u; i < count; ++i)
+    {
+        highp int index = int(texelFetch(u_clusterLights,
+                                         listCoord + ivec2(1u + i, 0),
+                                         0).r);
+        highp vec4 positionRadius = texelFetch(u_lights, ivec2(0, index), 0);
+        vec4 colorCosOuter = texelFetch(u_lights, ivec2(1, index), 0);
+        vec4 directionCosInner = texelFetch(u_lights, ivec2(2, index), 0);
+        highp vec3 toLight = positionRadius.xyz - v_fragPos;
+        highp float distanceSquared = dot(toLight, toLight);
+        vec3 lightDir = toLight * inversesqrt(max(distanceSquared, 1e-8));
+        // Inverse square falloff windowed to reach zero at the radius
+        highp float ratio = distanceSquared
+                          / (positionRadius.w * positionRadius.w);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (distanceSquared + 1.0);
+        // Lights shining in all directions have cone cosines below -1
+        attenuation *= smoothstep(colorCosOuter.w,
+                                  directionCosInner.w,
+                                  dot(-lightDir, directionCosInner.xyz));
+        result += colorCosOuter.rgb * attenuation
+                * (createDiffuse(norm, lightDir)
+                   + createSpecular(norm, lightDir));
+    }
+    return result;
+}
+
+// Weight of a transparent surface of given opacity in weighted blended
+// order-independent transparency, favoring surfaces near the camera. Bounded,
+// so that a few layers of bright surfaces still fit half float accumulation.
+highp float transparencyWeight(highp float alpha, highp float viewDepth)
+{
+    return alpha
+         * clamp(10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0)
+                         + pow(viewDepth / 200.0, 6.0)),
+                 1e-2,
+                 3e2);
+}
+
+#ifdef WIREFRAME_ENABLED
+vec3 applyWireframe(vec3 color, highp vec3 barycentric)
+{
+    // Screen space rate of change turns barycentric coordinates into pixel
+    // distances from the opposite edges. Lines fade out over the last pixel
+    // for antialiasing.
+    highp vec3 edgeDistance = barycentric / fwidth(barycentric);
+    float nearestEdge = min(min(edgeDistance.x, edgeDistance.y),
+                            edgeDistance.z);
+    float coverage = 1.0 - smoothstep(WIREFRAME_WIDTH - 1.0,
+                                      WIREFRAME_WIDTH,
+                                      nearestEdge);
+    return mix(color, WIREFRAME_COLOR, coverage);
+}
+#endif
+
 void main()
 {
-    // Ambient
+#ifdef OVERDRAW_ENABLED
+    // Layers of fragments covering the pixel add up by additive blending
+    o_FragColor = vec4(OVERDRAW_INCREMENT, 0.0, 0.0, 1.0);
+#else
+    // Ambient, darkened in creases and corners by ambient occlusion
     float ambientStrength = 0.2;
-    vec3 ambient = ambientStrength * u_color;
+    float ambientOcclusion = 1.0;
+    if (u_ambientOcclusionEnabled != 0u)
+    {
+        ambientOcclusion
+            = texelFetch(u_ambientOcclusion, ivec2(gl_FragCoord.xy), 0).r;
+    }
+    vec3 baseColor = createBaseColor();
+    vec3 ambient = ambientStrength * ambientOcclusion * baseColor;
 
     vec3 norm = normalize(v_normal);
     vec3 lightDir = normalize(-u_light.direction);
 
     // Diffuse
-    vec3 diffuse = (u_adsProps.diffuseEnabled == 1) ? createDiffuse(norm, lightDir) : vec3(0.0);
+    vec3 diffuse = createDiffuse(norm, lightDir, baseColor);
 
     // Specular
-    vec3 specular = (u_adsProps.specularEnabled == 1) ? createSpecular(norm, lightDir) : vec3(0.0);
+    vec3 specular = createSpecular(norm, lightDir, baseColor);
+
+    highp float viewDepth = -(u_view * vec4(v_fragPos, 1.0)).z;
+
+    // Shadowed fragments keep ambient light only
+    float shadow = createShadow(viewDepth);
 
-    vec3 result = ambient + diffuse + specular;
+    vec3 result = ambient + shadow * (diffuse + specular)
+                + createPointLights(norm, viewDepth);
+#ifdef WIREFRAME_ENABLED
+    result = applyWireframe(result, v_barycentric);
+#endif
+    if (u_transparency > 0.0)
+    {
+        // Transparent surfaces are accumulated in any order. Weighted color
+        // adds up in RGB, while alpha multiplies into the fraction of the
+        // background still revealed.
+        highp float alpha = 1.0 - u_transparency;
+        highp float weight = transparencyWeight(alpha, viewDepth);
+        o_FragColor = vec4(result * weight, alpha);
+        o_weight = weight;
+        return;
+    }
     o_FragColor = vec4(result, 1.0);
+#endif
 }
@@ -3,23 +3,56 @@ precision mediump float;
 
 layout (location = 0) in vec3 a_position;
 layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_texCoord;
 
-uniform mat4 u_model;
-uniform mat4 u_mvp;
-// Normal matrix is used for correctly transform the input vertex normals to
-// for to world space. A normal matrix is the transpose of the
-// inverse of the upper-left 3x3 portion of the model matrix.
-//
-// normalMatrix = mat3(transpose(inverse(modelMatrix)))
-//
-uniform mat3 u_normalMatrix;
+// Per-object data, written into the next slot of a ring buffer for each
+// draw. Layout matches ObjectUniforms of the renderer.
+layout (std140) uniform ObjectData
+{
+    // Packed vertex positions arrive normalized relative to the bounding box
+    // of the mesh. Model matrix and MVP matrix include their dequantization.
+    mat4 u_model;
+    mat4 u_mvp;
+    // Normal matrix is used for correctly transform the input vertex normals
+    // to world space. A normal matrix is the transpose of the inverse of the
+    // upper-left 3x3 portion of the model matrix, stored with padded columns.
+    //
+    // normalMatrix = mat3(transpose(inverse(modelMatrix)))
+    //
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    // Object identifier of picking, which is not available in OpenGL ES 3.0,
+    // only keeping the layout of ObjectUniforms
+    highp uint u_objectId;
+    // Fraction of light passing through surfaces of transparent materials,
+    // zero for opaque ones
+    highp float u_transparency;
+    // Layer of the base color texture of the material in the texture array
+    // of the model, negative for untextured materials
+    highp int u_textureLayer;
+};
 
 out vec3 v_fragPos;
 out vec3 v_normal;
+out vec2 v_texCoord;
+#ifdef WIREFRAME_ENABLED
+out highp vec3 v_barycentric;
+#endif
+
+// Depth prepass and color pass share this shader in separate programs, whose
+// depths have to match exactly to pass the equal depth test
+invariant gl_Position;
 
 void main()
 {
     gl_Position = u_mvp * vec4(a_position, 1.0);
     v_fragPos = vec3(u_model * vec4(a_position, 1.0));
-    v_normal = u_normalMatrix * a_normal;
+    v_normal = mat3(u_normalMatrix) * a_normal;
+    v_texCoord = a_texCoord;
+#ifdef WIREFRAME_ENABLED
+    // Wireframe draws are not indexed, every triangle has its own three
+    // vertices one after the other
+    int corner = gl_VertexID % 3;
+    v_barycentric = vec3(corner == 0, corner == 1, corner == 2);
+#endif
 }
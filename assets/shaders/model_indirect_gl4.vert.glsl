@@ -0,0 +1,103 @@
+#version 430 core
+
+layout (location = 0) in vec3 a_position;
+layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_texCoord;
+// Index of the draw command, numbering sub-meshes of each object one after
+// the other. gl_DrawID requires OpenGL 4.6 or ARB_shader_draw_parameters, so
+// the index is stored as the base instance of the draw command instead,
+// fetching it from a per-instance attribute of consecutive integers.
+layout (location = 3) in uint a_drawId;
+
+// Packed vertex positions arrive normalized relative to the bounding box of
+// the mesh. Model matrix includes their dequantization. Normal matrix is
+// stored with padded columns, matching std430 layout of mat4. Transforms are
+// independent of the view, so that they are only uploaded when copies move.
+struct DrawData
+{
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+    DrawData u_draws[];
+};
+
+// Base color of the material of each sub-mesh of the model in rgb and its
+// texture layer in w, negative for untextured materials, shared by every copy
+layout (std430, binding = 6) readonly buffer MaterialTableBuffer
+{
+    uint u_submeshCount;
+    vec4 u_materials[];
+};
+
+const int SHADOW_CASCADE_COUNT = 4;
+
+struct Light
+{
+    vec3 direction;
+};
+
+// Uniform blocks are shared with the model shader. Only the view projection
+// is read from per-frame data, and only the color and the object identifier
+// of the first copy from per-object data, transforms are per draw.
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    uint u_selectedObjectId;
+    uint u_shadowsEnabled;
+    uint u_lightCount;
+    uint u_ambientOcclusionEnabled;
+    mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    vec4 u_shadowSplitDepths;
+    vec4 u_clusterScale;
+    // View projection of each eye drawn by single-pass stereo
+    mat4 u_eyeViewProjections[2];
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 u_model;
+    mat4 u_mvp;
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    uint u_objectId;
+    float u_transparency;
+    int u_textureLayer;
+};
+
+// Outputs are matched to fragment shader inputs by location, so that the
+// wireframe geometry shader in between can pass them on under other names
+layout (location = 0) out vec3 v_fragPos;
+layout (location = 1) out vec3 v_normal;
+layout (location = 2) flat out uint v_objectId;
+// Location 3 is taken by barycentric coordinates of the wireframe geometry
+// shader
+layout (location = 4) flat out vec3 v_color;
+layout (location = 5) out vec2 v_texCoord;
+layout (location = 6) flat out int v_textureLayer;
+
+// Depth prepass and color pass share this shader in separate programs, whose
+// depths have to match exactly to pass the equal depth test
+invariant gl_Position;
+
+void main()
+{
+    uint object = a_drawId / u_submeshCount;
+    DrawData draw = u_draws[object];
+    vec4 worldPos = draw.model * vec4(a_position, 1.0);
+    gl_Position = u_viewProjection * worldPos;
+    v_fragPos = vec3(worldPos);
+    v_normal = mat3(draw.normalMatrix) * a_normal;
+    // Per-draw data is indexed by copy, so the index numbers copies as well
+    v_objectId = u_objectId + object;
+    vec4 material = u_materials[a_drawId % u_submeshCount];
+    v_color = u_color * material.rgb;
+    v_texCoord = a_texCoord;
+    v_textureLayer = int(material.w);
+}
@@ -0,0 +1,91 @@
+#version 430 core
+#ifdef MULTIVIEW_ENABLED
+// Single-pass stereo draws each instance into both layers of the target, with
+// the view projection of the layer selected by view index
+#extension GL_OVR_multiview2 : require
+layout (num_views = 2) in;
+#endif
+
+layout (location = 0) in vec3 a_position;
+layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_texCoord;
+// Per-instance world matrix. Matrix attributes occupy one location per
+// column, so locations 3 to 6 are taken.
+//
+// World matrices are expected to consist of rotation, translation and uniform
+// scale, which keep normals perpendicular to the surface when applied as-is,
+// without a separate normal matrix.
+layout (location = 3) in mat4 a_worldMatrix;
+// Index of the instance among all copies, including those culled before
+// drawing, which are left out of instance numbering.
+layout (location = 7) in uint a_copyIndex;
+
+const int SHADOW_CASCADE_COUNT = 4;
+
+struct Light
+{
+    vec3 direction;
+};
+
+// Uniform blocks are shared with the model shader. Per-object matrices apply
+// to all instances, with model matrix holding the transformation
+// dequantizing packed vertex positions, which is identity otherwise.
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    uint u_selectedObjectId;
+    uint u_shadowsEnabled;
+    uint u_lightCount;
+    uint u_ambientOcclusionEnabled;
+    mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    vec4 u_shadowSplitDepths;
+    vec4 u_clusterScale;
+    // View projection of each eye drawn by single-pass stereo
+    mat4 u_eyeViewProjections[2];
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 u_model;
+    mat4 u_mvp;
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    uint u_objectId;
+    float u_transparency;
+    int u_textureLayer;
+};
+
+// Outputs are matched to fragment shader inputs by location, so that the
+// wireframe geometry shader in between can pass them on under other names
+layout (location = 0) out vec3 v_fragPos;
+layout (location = 1) out vec3 v_normal;
+layout (location = 2) flat out uint v_objectId;
+// Location 3 is taken by barycentric coordinates of the wireframe geometry
+// shader
+layout (location = 4) flat out vec3 v_color;
+layout (location = 5) out vec2 v_texCoord;
+layout (location = 6) flat out int v_textureLayer;
+
+// Depth prepass and color pass share this shader in separate programs, whose
+// depths have to match exactly to pass the equal depth test
+invariant gl_Position;
+
+void main()
+{
+    vec4 worldPos = a_worldMatrix * u_model * vec4(a_position, 1.0);
+#ifdef MULTIVIEW_ENABLED
+    gl_Position = u_eyeViewProjections[int(gl_ViewID_OVR)] * worldPos;
+#else
+    gl_Position = u_viewProjection * worldPos;
+#endif
+    v_fragPos = vec3(worldPos);
+    v_normal = mat3(a_worldMatrix) * a_normal;
+    v_objectId = u_objectId + a_copyIndex;
+    v_color = u_color;
+    v_texCoord = a_texCoord;
+    v_textureLayer = u_textureLayer;
+}
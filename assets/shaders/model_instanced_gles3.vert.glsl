@@ -0,0 +1,88 @@
+#version 300 es
+#ifdef MULTIVIEW_ENABLED
+// Single-pass stereo draws each instance into both layers of the target, with
+// the view projection of the layer selected by view index
+#extension GL_OVR_multiview2 : require
+layout (num_views = 2) in;
+#endif
+precision mediump float;
+
+layout (location = 0) in vec3 a_position;
+layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_texCoord;
+// Per-instance world matrix. Matrix attributes occupy one location per
+// column, so locations 3 to 6 are taken.
+//
+// World matrices are expected to consist of rotation, translation and uniform
+// scale, which keep normals perpendicular to the surface when applied as-is,
+// without a separate normal matrix.
+layout (location = 3) in mat4 a_worldMatrix;
+
+const int SHADOW_CASCADE_COUNT = 4;
+
+struct Light
+{
+    vec3 direction;
+};
+
+// Uniform blocks are shared with the model shader. Per-object matrices apply
+// to all instances, with model matrix holding the transformation
+// dequantizing packed vertex positions, which is identity otherwise.
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+    mat4 u_view;
+    mat4 u_viewProjection;
+    vec3 u_viewPos;
+    Light u_light;
+    highp uint u_selectedObjectId;
+    highp uint u_shadowsEnabled;
+    highp uint u_lightCount;
+    highp uint u_ambientOcclusionEnabled;
+    highp mat4 u_lightViewProjections[SHADOW_CASCADE_COUNT];
+    highp vec4 u_shadowSplitDepths;
+    highp vec4 u_clusterScale;
+    // View projection of each eye drawn by single-pass stereo
+    highp mat4 u_eyeViewProjections[2];
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 u_model;
+    mat4 u_mvp;
+    mat4 u_normalMatrix;
+    vec3 u_color;
+    highp uint u_objectId;
+    highp float u_transparency;
+    highp int u_textureLayer;
+};
+
+out vec3 v_fragPos;
+out vec3 v_normal;
+out vec2 v_texCoord;
+#ifdef WIREFRAME_ENABLED
+out highp vec3 v_barycentric;
+#endif
+
+// Depth prepass and color pass share this shader in separate programs, whose
+// depths have to match exactly to pass the equal depth test
+invariant gl_Position;
+
+void main()
+{
+    vec4 worldPos = a_worldMatrix * u_model * vec4(a_position, 1.0);
+#ifdef MULTIVIEW_ENABLED
+    gl_Position = u_eyeViewProjections[int(gl_ViewID_OVR)] * worldPos;
+#else
+    gl_Position = u_viewProjection * worldPos;
+#endif
+    v_fragPos = vec3(worldPos);
+    v_normal = mat3(a_worldMatrix) * a_normal;
+    v_texCoord = a_texCoord;
+#ifdef WIREFRAME_ENABLED
+    // Wireframe draws are not indexed, every triangle has its own three
+    // vertices one after the other
+    int corner = gl_VertexID % 3;
+    v_barycentric = vec3(corner == 0, corner == 1, corner == 2);
+#endif
+}
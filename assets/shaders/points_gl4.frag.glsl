@@ -0,0 +1,13 @@
+#version 430 core
+
+layout (location = 0) flat in vec3 v_color;
+
+layout (location = 0) out vec4 o_FragColor;
+// Points can not be picked, written as no object
+layout (location = 1) out uint o_objectId;
+
+void main()
+{
+    o_FragColor = vec4(v_color, 1.0);
+    o_objectId = 0u;
+}
@@ -0,0 +1,26 @@
+#version 430 core
+
+// Point cloud drawn as point primitives, where compute rasterization is not
+// available. Points are quantized into two words: X in the low and Y in the
+// high half of the first, Z in the low half and RGB565 color in the high half
+// of the second. Layout matches PointCloudData of the renderer.
+layout (location = 0) in uvec2 a_point;
+
+// Includes dequantization of positions
+uniform mat4 u_modelViewProjection;
+
+layout (location = 0) flat out vec3 v_color;
+
+vec3 unpackColor(uint color)
+{
+    return vec3((color >> 11) & 31u, (color >> 5) & 63u, color & 31u)
+         / vec3(31.0, 63.0, 31.0);
+}
+
+void main()
+{
+    vec3 position = vec3(a_point.x & 0xFFFFu, a_point.x >> 16,
+                         a_point.y & 0xFFFFu);
+    v_color = unpackColor(a_point.y >> 16);
+    gl_Position = u_modelViewProjection * vec4(position, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 300 es
+precision mediump float;
+
+flat in vec3 v_color;
+
+layout (location = 0) out vec4 o_FragColor;
+
+void main()
+{
+    o_FragColor = vec4(v_color, 1.0);
+}
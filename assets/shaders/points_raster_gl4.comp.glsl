@@ -0,0 +1,57 @@
+#version 430 core
+#extension GL_ARB_gpu_shader_int64 : require
+#extension GL_NV_shader_atomic_int64 : require
+
+// Rasterization of a point cloud, one invocation per point. Each point is
+// projected into a single pixel, and kept there when it is nearer than any
+// point rasterized into the pixel before, by an atomic minimum on depth in
+// the high and color in the low bits of the pixel.
+layout (local_size_x = 256) in;
+
+// Points are quantized into two words: X in the low and Y in the high half of
+// the first, Z in the low half and RGB565 color in the high half of the
+// second. Layout matches PointCloudData of the renderer.
+layout (std430, binding = 1) readonly buffer PointBuffer
+{
+    uvec2 points[];
+};
+
+// Rows of the scene, empty pixels holding the largest value
+layout (std430, binding = 2) buffer PixelBuffer
+{
+    uint64_t pixels[];
+};
+
+// Includes dequantization of positions
+uniform mat4 u_modelViewProjection;
+// Points of the dispatched range
+uniform int u_pointCount;
+uniform int u_sceneWidth;
+uniform int u_sceneHeight;
+
+void main()
+{
+    // Large dispatches are spread over a 2D grid of work groups
+    uint index = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x)
+               * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+    if (index >= uint(u_pointCount))
+    {
+        return;
+    }
+    uvec2 point = points[index];
+    vec3 position = vec3(point.x & 0xFFFFu, point.x >> 16, point.y & 0xFFFFu);
+    vec4 clipPos = u_modelViewProjection * vec4(position, 1.0);
+    if (clipPos.w <= 0.0 || any(greaterThan(abs(clipPos.xyz), vec3(clipPos.w))))
+    {
+        return;
+    }
+    vec3 ndc = clipPos.xyz / clipPos.w;
+    ivec2 sceneSize = ivec2(u_sceneWidth, u_sceneHeight);
+    ivec2 pixel = min(ivec2((ndc.xy * 0.5 + 0.5) * vec2(sceneSize)),
+                      sceneSize - 1);
+    // Positive floats order like their bits
+    float depth = ndc.z * 0.5 + 0.5;
+    uint64_t value = (uint64_t(floatBitsToUint(depth)) << 32)
+                   | uint64_t(point.y >> 16);
+    atomicMin(pixels[pixel.y * u_sceneWidth + pixel.x], value);
+}
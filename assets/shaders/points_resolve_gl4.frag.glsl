@@ -0,0 +1,37 @@
+#version 430 core
+#extension GL_ARB_gpu_shader_int64 : require
+
+// Resolve of rasterized points into color and depth of the scene. Pixels are
+// cleared for the next frame as they are read.
+
+const uint64_t EMPTY_PIXEL = 0xFFFFFFFFFFFFFFFFul;
+
+layout (std430, binding = 2) buffer PixelBuffer
+{
+    uint64_t pixels[];
+};
+
+uniform int u_sceneWidth;
+
+layout (location = 0) out vec4 o_FragColor;
+// Points can not be picked, written as no object
+layout (location = 1) out uint o_objectId;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    int index = pixel.y * u_sceneWidth + pixel.x;
+    uint64_t value = pixels[index];
+    if (value == EMPTY_PIXEL)
+    {
+        discard;
+    }
+    pixels[index] = EMPTY_PIXEL;
+
+    uint color = uint(value) & 0xFFFFu;
+    o_FragColor = vec4(vec3((color >> 11) & 31u, (color >> 5) & 63u,
+                            color & 31u) / vec3(31.0, 63.0, 31.0),
+                       1.0);
+    gl_FragDepth = uintBitsToFloat(uint(value >> 32));
+    o_objectId = 0u;
+}
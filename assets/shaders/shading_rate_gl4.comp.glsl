@@ -0,0 +1,113 @@
+#version 430 core
+
+// Shading rate of each tile of the scene as a palette index of the shading
+// rate image, one invocation per tile
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// Palette of ShadingRateImage of the renderer
+const uint FULL_RATE = 0u;
+const uint RATE_2X2 = 1u;
+const uint RATE_4X4 = 2u;
+// Modes of ShadingRateImage
+const int MODE_FOVEATED = 1;
+// Fractions of the distance from focus to the farthest corner of the view,
+// beyond which tiles are shaded at coarser rates
+const float FOVEA_RADIUS = 0.45;
+const float PERIPHERY_RADIUS = 0.75;
+// Largest perceived luminance difference between neighbouring samples of a
+// tile still considered flat at each rate
+const float CONTRAST_4X4 = 0.02;
+const float CONTRAST_2X2 = 0.08;
+// Samples per tile along each axis
+const int SAMPLE_GRID = 4;
+
+// Scene of the previous frame in content adaptive mode
+uniform sampler2D u_scene;
+uniform int u_sceneWidth;
+uniform int u_sceneHeight;
+uniform int u_tileWidth;
+uniform int u_tileHeight;
+uniform int u_mode;
+// Center and half diagonal of the camera view in pixels
+uniform vec2 u_focus;
+uniform float u_focusRadius;
+layout (r8ui, binding = 0) writeonly uniform uimage2D u_rates;
+
+// Luminance compressed like tonemapping does, so that contrast of bright
+// regions is not overestimated
+float perceivedLuminance(ivec2 pixel)
+{
+    vec3 color = texelFetch(u_scene, pixel, 0).rgb;
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return luminance / (1.0 + luminance);
+}
+
+uint foveatedRate(ivec2 tile, ivec2 tileSize)
+{
+    vec2 center = (vec2(tile) + 0.5) * vec2(tileSize);
+    float distance = length(center - u_focus) / u_focusRadius;
+    if (distance < FOVEA_RADIUS)
+    {
+        return FULL_RATE;
+    }
+    return distance < PERIPHERY_RADIUS ? RATE_2X2 : RATE_4X4;
+}
+
+uint contentAdaptiveRate(ivec2 tile, ivec2 tileSize, ivec2 sceneSize)
+{
+    // Samples are spread evenly over the tile, comparing each with its right
+    // and upper neighbours
+    ivec2 origin = tile * tileSize;
+    ivec2 spacing = max(tileSize / SAMPLE_GRID, ivec2(1));
+    float samples[SAMPLE_GRID][SAMPLE_GRID];
+    for (int y = 0; y < SAMPLE_GRID; ++y)
+    {
+        for (int x = 0; x < SAMPLE_GRID; ++x)
+        {
+            ivec2 pixel = min(origin + ivec2(x, y) * spacing, sceneSize - 1);
+            samples[y][x] = perceivedLuminance(pixel);
+        }
+    }
+    float contrast = 0.0;
+    for (int y = 0; y < SAMPLE_GRID; ++y)
+    {
+        for (int x = 0; x < SAMPLE_GRID; ++x)
+        {
+            if (x + 1 < SAMPLE_GRID)
+            {
+                contrast = max(contrast,
+                               abs(samples[y][x] - samples[y][x + 1]));
+            }
+            if (y + 1 < SAMPLE_GRID)
+            {
+                contrast = max(contrast,
+                               abs(samples[y][x] - samples[y + 1][x]));
+            }
+        }
+    }
+    if (contrast < CONTRAST_4X4)
+    {
+        return RATE_4X4;
+    }
+    return contrast < CONTRAST_2X2 ? RATE_2X2 : FULL_RATE;
+}
+
+void main()
+{
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(tile, imageSize(u_rates))))
+    {
+        return;
+    }
+    // Tiles outside of the scene are not drawn into
+    ivec2 tileSize = ivec2(u_tileWidth, u_tileHeight);
+    ivec2 sceneSize = ivec2(u_sceneWidth, u_sceneHeight);
+    uint rate = RATE_4X4;
+    if (all(lessThan(tile * tileSize, sceneSize)))
+    {
+        rate = u_mode == MODE_FOVEATED
+                 ? foveatedRate(tile, tileSize)
+                 : contentAdaptiveRate(tile, tileSize, sceneSize);
+    }
+    imageStore(u_rates, tile, uvec4(rate));
+}
@@ -0,0 +1,63 @@
+#version 430 core
+
+// Pages of the virtual texture of the skybox seen by each pixel, drawn at a
+// fraction of the scene resolution and read back to request missing pages.
+// Level is written plus one, leaving zero for pixels requesting nothing.
+
+// Page size matches the page file of the virtual texture
+const int PAGE_SIZE = 128;
+
+in vec3 v_texCoords;
+
+uniform int u_faceSize;
+uniform int u_levelCount;
+// Logarithm of the scene resolution divided by feedback resolution, as rays
+// of neighboring feedback pixels are further apart than of scene pixels
+uniform float u_lodBias;
+
+layout (location = 0) out vec4 o_page;
+
+// Matches face selection of the virtual skybox shader
+int cubeFace(vec3 direction, out vec2 faceCoords)
+{
+    vec3 magnitude = abs(direction);
+    int face;
+    vec2 coords;
+    float majorAxis;
+    if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z)
+    {
+        majorAxis = magnitude.x;
+        face = direction.x > 0.0 ? 0 : 1;
+        coords = vec2(direction.x > 0.0 ? -direction.z : direction.z,
+                      -direction.y);
+    }
+    else if (magnitude.y >= magnitude.z)
+    {
+        majorAxis = magnitude.y;
+        face = direction.y > 0.0 ? 2 : 3;
+        coords = vec2(direction.x,
+                      direction.y > 0.0 ? direction.z : -direction.z);
+    }
+    else
+    {
+        majorAxis = magnitude.z;
+        face = direction.z > 0.0 ? 4 : 5;
+        coords = vec2(direction.z > 0.0 ? direction.x : -direction.x,
+                      -direction.y);
+    }
+    faceCoords = clamp(coords / majorAxis * 0.5 + 0.5, 0.0, 0.99999);
+    return face;
+}
+
+void main()
+{
+    vec2 faceCoords;
+    int face = cubeFace(v_texCoords, faceCoords);
+    vec3 ray = normalize(v_texCoords);
+    float angle = max(length(dFdx(ray)), length(dFdy(ray)));
+    float lod = log2(max(angle * float(u_faceSize) * 0.5, 1.0)) + u_lodBias;
+    int level = clamp(int(lod), 0, u_levelCount - 1);
+    int pagesPerSide = (u_faceSize / PAGE_SIZE) >> level;
+    ivec2 page = ivec2(faceCoords * float(pagesPerSide));
+    o_page = vec4(vec2(page), float(face), float(level + 1)) / 255.0;
+}
@@ -5,8 +5,12 @@ in vec3 v_texCoords;
 uniform samplerCube u_skyboxTexture;
 
 layout (location = 0) out vec4 v_fragColor;
+// Background is not an object. Identifier buffer would be left undefined
+// where the skybox is drawn without writing it.
+layout (location = 1) out uint o_objectId;
 
 void main()
 {
     v_fragColor = texture(u_skyboxTexture, v_texCoords);
+    o_objectId = 0u;
 }
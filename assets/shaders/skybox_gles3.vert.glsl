@@ -1,15 +1,22 @@
 #version 300 es
 precision mediump float;
 
-layout (location = 0) in vec3 a_position;
+// Fullscreen triangle generated from vertex index without vertex buffers
 
-uniform mat4 u_projectionView;
+uniform mat4 u_inverseProjectionView;
 
 out vec3 v_texCoords;
 
 void main()
 {
-    vec4 pos = u_projectionView * vec4(a_position, 1.0);
-    gl_Position = pos.xyww;
-    v_texCoords = a_position;
+    // Vertices (-1, -1), (3, -1) and (-1, 3) cover the whole viewport
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    // Placed on the far plane, so that only pixels not covered by models pass
+    // depth test
+    vec4 farPoint = vec4(position, 1.0, 1.0);
+    gl_Position = farPoint;
+    // Point on far plane is unprojected with positive W, so its coordinates
+    // point along the view ray. Undivided coordinates are linear across the
+    // screen and interpolate correctly.
+    v_texCoords = (u_inverseProjectionView * farPoint).xyz;
 }
@@ -0,0 +1,90 @@
+#version 430 core
+
+// Skybox sampled from a virtual texture. Entries of the page table point to
+// the slot of the physical page cache holding the page seen by the pixel, or
+// its closest resident ancestor. Pages are filtered bilinearly within their
+// border, without blending between levels.
+
+// Page layout matches the page file of the virtual texture
+const float PAGE_SIZE = 128.0;
+const float PAGE_BORDER = 4.0;
+const float SLOT_SIZE = PAGE_SIZE + 2.0 * PAGE_BORDER;
+const float SLOTS_PER_SIDE = 16.0;
+
+in vec3 v_texCoords;
+
+// Slot column, slot row and level of the resident page in each entry
+uniform sampler2DArray u_pageTable;
+uniform sampler2D u_physicalPages;
+uniform int u_faceSize;
+uniform int u_levelCount;
+
+layout (location = 0) out vec4 v_fragColor;
+// Background is not an object. Identifier buffer would be left undefined
+// where the skybox is drawn without writing it.
+layout (location = 1) out uint o_objectId;
+
+// Face and coordinates within the face of a direction, following face
+// selection of cube maps, so that faces are laid out like in a cube-map
+int cubeFace(vec3 direction, out vec2 faceCoords)
+{
+    vec3 magnitude = abs(direction);
+    int face;
+    vec2 coords;
+    float majorAxis;
+    if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z)
+    {
+        majorAxis = magnitude.x;
+        face = direction.x > 0.0 ? 0 : 1;
+        coords = vec2(direction.x > 0.0 ? -direction.z : direction.z,
+                      -direction.y);
+    }
+    else if (magnitude.y >= magnitude.z)
+    {
+        majorAxis = magnitude.y;
+        face = direction.y > 0.0 ? 2 : 3;
+        coords = vec2(direction.x,
+                      direction.y > 0.0 ? direction.z : -direction.z);
+    }
+    else
+    {
+        majorAxis = magnitude.z;
+        face = direction.z > 0.0 ? 4 : 5;
+        coords = vec2(direction.z > 0.0 ? direction.x : -direction.x,
+                      -direction.y);
+    }
+    faceCoords = clamp(coords / majorAxis * 0.5 + 0.5, 0.0, 0.99999);
+    return face;
+}
+
+// Mip level of the texels covered by the pixel, from the angle between view
+// rays of neighboring pixels. Unlike face coordinates, directions do not
+// jump at face edges. A face spans two units at unit distance, so a radian
+// covers half of the face size.
+float mipLevel(vec3 direction)
+{
+    vec3 ray = normalize(direction);
+    float angle = max(length(dFdx(ray)), length(dFdy(ray)));
+    return log2(max(angle * float(u_faceSize) * 0.5, 1.0));
+}
+
+void main()
+{
+    vec2 faceCoords;
+    int face = cubeFace(v_texCoords, faceCoords);
+    int level = min(int(mipLevel(v_texCoords)), u_levelCount - 1);
+    int pagesPerSide = (u_faceSize / int(PAGE_SIZE)) >> level;
+    ivec2 page = ivec2(faceCoords * float(pagesPerSide));
+    vec3 entry = round(texelFetch(u_pageTable, ivec3(page, face), level).xyz
+                       * 255.0);
+
+    // Resident page of a coarser level covers the pixel as well, at its own
+    // position within that page
+    float residentPages = float((u_faceSize / int(PAGE_SIZE)) >> int(entry.z));
+    vec2 pageCoords = fract(faceCoords * residentPages);
+    vec2 texel = entry.xy * SLOT_SIZE + PAGE_BORDER + pageCoords * PAGE_SIZE;
+    v_fragColor = textureLod(u_physicalPages,
+                             texel / (SLOTS_PER_SIDE * SLOT_SIZE),
+                             0.0);
+    o_objectId = 0u;
+}
@@ -0,0 +1,61 @@
+#version 300 es
+// Depth is reconstructed into positions, which needs full precision
+precision highp float;
+
+// One direction of separable Gaussian blur of half resolution occlusion.
+// Samples are weighed down by their difference in view depth from the center,
+// so that occlusion does not bleed across edges.
+
+const int BLUR_RADIUS = 4;
+const float SIGMA = 2.0;
+// Relative depth difference at which samples stop contributing is the
+// inverse of this
+const float DEPTH_SHARPNESS = 16.0;
+
+// Leading members of the per-frame data of model shaders
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+};
+
+// Copy of scene depth at full resolution
+uniform highp sampler2D u_depth;
+uniform mediump sampler2D u_occlusion;
+// Size of the scene in full resolution pixels
+uniform int u_sceneWidth;
+uniform int u_sceneHeight;
+uniform bool u_horizontal;
+
+layout (location = 0) out float o_occlusion;
+
+// View depth of half resolution pixel, taken at the full resolution pixel it
+// was computed for
+float getViewDepth(ivec2 halfPixel)
+{
+    ivec2 pixel = min(halfPixel * 2, ivec2(u_sceneWidth, u_sceneHeight) - 1);
+    float ndcDepth = texelFetch(u_depth, pixel, 0).r * 2.0 - 1.0;
+    return u_projection[3][2] / (ndcDepth + u_projection[2][2]);
+}
+
+void main()
+{
+    ivec2 lastHalfPixel = (ivec2(u_sceneWidth, u_sceneHeight) + 1) / 2 - 1;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 direction = u_horizontal ? ivec2(1, 0) : ivec2(0, 1);
+    float centerDepth = getViewDepth(pixel);
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = -BLUR_RADIUS; i <= BLUR_RADIUS; ++i)
+    {
+        ivec2 samplePixel
+            = clamp(pixel + direction * i, ivec2(0), lastHalfPixel);
+        float depthDifference
+            = abs(getViewDepth(samplePixel) - centerDepth) / centerDepth;
+        float weight = exp(-float(i * i) / (2.0 * SIGMA * SIGMA))
+                     * max(1.0 - depthDifference * DEPTH_SHARPNESS, 0.0);
+        sum += texelFetch(u_occlusion, samplePixel, 0).r * weight;
+        weightSum += weight;
+    }
+    // Center sample always has full weight
+    o_occlusion = sum / weightSum;
+}
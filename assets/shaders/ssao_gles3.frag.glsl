@@ -0,0 +1,95 @@
+#version 300 es
+// Depth is reconstructed into positions, which needs full precision
+precision highp float;
+
+// Ambient occlusion of a half resolution pixel, estimated from the depth
+// buffer alone. Depth samples around the pixel within a fixed radius in view
+// space are tested against the hemisphere above its surface, each occluding
+// it by the cosine of its angle from the normal.
+
+const int SAMPLE_COUNT = 12;
+// Radius of the hemisphere in view space units
+const float RADIUS = 0.5;
+const float INTENSITY = 1.5;
+// Cosine ignored per sample, so that faceted or depth quantized surfaces do
+// not occlude themselves
+const float ANGLE_BIAS = 0.1;
+const float GOLDEN_ANGLE = 2.39996323;
+
+// Leading members of the per-frame data of model shaders
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+};
+
+// Copy of scene depth at full resolution
+uniform highp sampler2D u_depth;
+// Size of the scene in full resolution pixels
+uniform int u_sceneWidth;
+uniform int u_sceneHeight;
+
+layout (location = 0) out float o_occlusion;
+
+// View space position of full resolution pixel, reconstructed from its depth
+// with the perspective projection
+vec3 getViewPosition(ivec2 pixel)
+{
+    float ndcDepth = texelFetch(u_depth, pixel, 0).r * 2.0 - 1.0;
+    float viewDepth = u_projection[3][2] / (ndcDepth + u_projection[2][2]);
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(u_sceneWidth, u_sceneHeight) * 2.0
+             - 1.0;
+    return vec3(ndc / vec2(u_projection[0][0], u_projection[1][1])
+                    * viewDepth,
+                -viewDepth);
+}
+
+void main()
+{
+    ivec2 lastPixel = ivec2(u_sceneWidth, u_sceneHeight) - 1;
+    // Each half resolution pixel stands for the bottom-left pixel of its 2x2
+    // quad at full resolution
+    ivec2 pixel = min(ivec2(gl_FragCoord.xy) * 2, lastPixel);
+    vec3 position = getViewPosition(pixel);
+
+    // Normal from differences to neighbors, taking the neighbor closer in
+    // depth along each axis, so that normals do not bend over edges
+    vec3 right = getViewPosition(min(pixel + ivec2(1, 0), lastPixel))
+               - position;
+    vec3 left = position - getViewPosition(max(pixel - ivec2(1, 0), 0));
+    vec3 up = getViewPosition(min(pixel + ivec2(0, 1), lastPixel)) - position;
+    vec3 down = position - getViewPosition(max(pixel - ivec2(0, 1), 0));
+    vec3 normal = normalize(cross(abs(right.z) < abs(left.z) ? right : left,
+                                  abs(up.z) < abs(down.z) ? up : down));
+
+    // Samples spiral out to the radius projected onto the screen, with the
+    // spiral turned per pixel by interleaved gradient noise. Banding of the
+    // few samples turns into noise, which the blur removes.
+    float screenRadius = RADIUS * u_projection[1][1] * 0.5
+                       * float(u_sceneHeight) / -position.z;
+    float rotation = 6.28318531
+                   * fract(52.9829189
+                           * fract(dot(gl_FragCoord.xy,
+                                       vec2(0.06711056, 0.00583715))));
+    float occlusion = 0.0;
+    for (int i = 0; i < SAMPLE_COUNT; ++i)
+    {
+        float angle = float(i) * GOLDEN_ANGLE + rotation;
+        float sampleDistance
+            = (float(i) + 0.5) / float(SAMPLE_COUNT) * screenRadius;
+        vec2 offset = vec2(cos(angle), sin(angle)) * sampleDistance;
+        ivec2 samplePixel = clamp(pixel + ivec2(offset), ivec2(0), lastPixel);
+        vec3 toSample = getViewPosition(samplePixel) - position;
+        float distanceSquared = dot(toSample, toSample);
+        // Occluders fade out towards the radius, so that distant geometry in
+        // front does not darken the pixel
+        float falloff = max(1.0 - distanceSquared / (RADIUS * RADIUS), 0.0);
+        occlusion += max(dot(toSample, normal)
+                             * inversesqrt(distanceSquared + 1e-6)
+                             - ANGLE_BIAS,
+                         0.0)
+                   * falloff;
+    }
+    o_occlusion = clamp(1.0 - INTENSITY * occlusion / float(SAMPLE_COUNT),
+                        0.0,
+                        1.0);
+}
@@ -0,0 +1,54 @@
+#version 300 es
+// Depth is reconstructed into positions, which needs full precision
+precision highp float;
+
+// Depth-aware upsampling of half resolution occlusion. Bilinear weights of
+// the four nearest half resolution pixels are scaled down by their difference
+// in view depth, so that pixels on edges take occlusion from their own side.
+
+// Leading members of the per-frame data of model shaders
+layout (std140) uniform FrameData
+{
+    mat4 u_projection;
+};
+
+// Copy of scene depth at full resolution
+uniform highp sampler2D u_depth;
+uniform mediump sampler2D u_occlusion;
+// Size of the scene in full resolution pixels
+uniform int u_sceneWidth;
+uniform int u_sceneHeight;
+
+layout (location = 0) out float o_occlusion;
+
+float getViewDepth(ivec2 pixel)
+{
+    float ndcDepth = texelFetch(u_depth, pixel, 0).r * 2.0 - 1.0;
+    return u_projection[3][2] / (ndcDepth + u_projection[2][2]);
+}
+
+void main()
+{
+    ivec2 lastPixel = ivec2(u_sceneWidth, u_sceneHeight) - 1;
+    ivec2 lastHalfPixel = (lastPixel + 2) / 2 - 1;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = getViewDepth(pixel);
+    // Half resolution pixels stand for the even full resolution pixels, so
+    // odd pixels lie halfway to the next one
+    ivec2 basePixel = pixel / 2;
+    vec2 fraction = vec2(pixel - basePixel * 2) * 0.5;
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 halfPixel = min(basePixel + offset, lastHalfPixel);
+        vec2 bilinear = mix(1.0 - fraction, fraction, vec2(offset));
+        float depthDifference
+            = abs(getViewDepth(min(halfPixel * 2, lastPixel)) - depth) / depth;
+        float weight = bilinear.x * bilinear.y / (depthDifference + 1e-3);
+        sum += texelFetch(u_occlusion, halfPixel, 0).r * weight;
+        weightSum += weight;
+    }
+    o_occlusion = sum / max(weightSum, 1e-6);
+}
@@ -0,0 +1,25 @@
+#version 430 core
+
+// Composes both eyes of single-pass stereo side by side into the scene, left
+// eye on the left half. Eyes are layers of the stereo target, each the size of
+// half the scene, so pixels map one to one.
+
+uniform sampler2DArray u_color;
+uniform sampler2DArray u_depth;
+// Width of each eye in pixels
+uniform int u_eyeWidth;
+
+layout (location = 0) out vec4 o_FragColor;
+// Picking is not supported in stereo, eyes are written as no object
+layout (location = 1) out uint o_objectId;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    int eye = pixel.x >= u_eyeWidth ? 1 : 0;
+    ivec3 texel = ivec3(pixel.x - eye * u_eyeWidth, pixel.y, eye);
+    o_FragColor = texelFetch(u_color, texel, 0);
+    // Depth is kept for the skybox drawn afterwards
+    gl_FragDepth = texelFetch(u_depth, texel, 0).r;
+    o_objectId = 0u;
+}
@@ -0,0 +1,87 @@
+#version 430 core
+
+// Temporal upscaling into the history at window resolution. The scene pixel
+// whose jittered sample falls nearest to each window pixel is blended into
+// the reprojected history, weighed by how close the sample is to the window
+// pixel center.
+
+// Blend factors of current samples right at the window pixel center and far
+// away from it
+const float MAX_BLEND = 0.2;
+const float MIN_BLEND = 0.02;
+// Falloff of sample weight with squared distance in window pixels
+const float SAMPLE_SHARPNESS = 2.0;
+
+uniform sampler2D u_scene;
+uniform sampler2D u_depth;
+uniform sampler2D u_history;
+// Size of the scene in scene pixels, and scene pixels per window pixel
+uniform vec2 u_sceneSize;
+uniform vec2 u_sceneScale;
+// Subpixel offset the scene was drawn with, in scene pixels
+uniform vec2 u_jitter;
+// Clip space of the current view into that of the previous one, both
+// without jitter
+uniform mat4 u_reprojection;
+uniform bool u_historyValid;
+
+layout (location = 0) out vec4 o_color;
+
+vec3 fetchScene(ivec2 pixel)
+{
+    ivec2 lastPixel = ivec2(u_sceneSize) - 1;
+    return texelFetch(u_scene, clamp(pixel, ivec2(0), lastPixel), 0).rgb;
+}
+
+void main()
+{
+    // Content at unjittered position p is drawn at p + jitter, so the scene
+    // pixel sampling nearest to the window pixel center is the one at the
+    // center shifted by jitter
+    vec2 scenePosition = gl_FragCoord.xy * u_sceneScale;
+    ivec2 scenePixel = clamp(ivec2(floor(scenePosition + u_jitter)),
+                             ivec2(0),
+                             ivec2(u_sceneSize) - 1);
+    vec2 sampleOffset = (vec2(scenePixel) + 0.5 - u_jitter - scenePosition)
+                      / u_sceneScale;
+    float sampleWeight
+        = exp(-SAMPLE_SHARPNESS * dot(sampleOffset, sampleOffset));
+
+    // Color range of the neighborhood, which history is clamped into
+    vec3 current = fetchScene(scenePixel);
+    vec3 neighborhoodMin = current;
+    vec3 neighborhoodMax = current;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            vec3 neighbor = fetchScene(scenePixel + ivec2(x, y));
+            neighborhoodMin = min(neighborhoodMin, neighbor);
+            neighborhoodMax = max(neighborhoodMax, neighbor);
+        }
+    }
+
+    // Window pixel center at the depth of the scene pixel, moved to where
+    // the previous frame saw it
+    float depth = texelFetch(u_depth, scenePixel, 0).r;
+    vec2 windowSize = u_sceneSize / u_sceneScale;
+    vec4 clipPosition = vec4(gl_FragCoord.xy / windowSize * 2.0 - 1.0,
+                             depth * 2.0 - 1.0,
+                             1.0);
+    vec4 previousClipPosition = u_reprojection * clipPosition;
+    vec2 historyTexCoord
+        = previousClipPosition.xy / previousClipPosition.w * 0.5 + 0.5;
+
+    // History is discarded when it was never drawn, or the surface was
+    // outside of the previous view
+    float blend = mix(MIN_BLEND, MAX_BLEND, sampleWeight);
+    if (!u_historyValid || any(lessThan(historyTexCoord, vec2(0.0)))
+        || any(greaterThan(historyTexCoord, vec2(1.0))))
+    {
+        blend = 1.0;
+    }
+    vec3 history = clamp(textureLod(u_history, historyTexCoord, 0.0).rgb,
+                         neighborhoodMin,
+                         neighborhoodMax);
+    o_color = vec4(mix(history, current, blend), 1.0);
+}
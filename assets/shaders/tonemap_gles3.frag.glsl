@@ -0,0 +1,160 @@
+#version 300 es
+// Texture coordinates need full precision at window resolution
+precision highp float;
+
+// Final pass of the frame, upscaling the high dynamic range scene into the
+// window. Bloom is mixed into the scene, which is scaled by exposure and
+// tonemapped into displayable range with the ACES filmic curve. With
+// FXAA_ENABLED, edges are smoothed in the same pass with fast approximate
+// antialiasing, which detects edges from the luma of tonemapped color. With
+// HEATMAP_ENABLED, the scene holds layers counted by the overdraw view of
+// model shaders instead, shown as a heatmap without bloom or antialiasing.
+
+#ifdef FXAA_ENABLED
+// Contrast below which pixels are left alone, relative to the brightest
+// neighbor and absolute for dark areas
+const float EDGE_THRESHOLD = 1.0 / 8.0;
+const float EDGE_THRESHOLD_MIN = 1.0 / 16.0;
+// Keeps the edge direction from growing without bound on faint edges
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+// Length of the edge search in texels
+const float SPAN_MAX = 8.0;
+#endif
+
+#ifdef HEATMAP_ENABLED
+// Matches the increment of the overdraw view of model shaders
+const float OVERDRAW_INCREMENT = 1.0 / 32.0;
+// Layers shown in the hottest color
+const float MAX_HEAT_LAYERS = 8.0;
+#endif
+
+uniform sampler2D u_scene;
+// Maps window fragment coordinates onto scene texture coordinates
+uniform vec2 u_texCoordScale;
+uniform vec2 u_texelSize;
+// Samples are clamped half a texel inside the scene rectangle
+uniform vec2 u_maxTexCoord;
+uniform float u_exposure;
+#ifdef BLOOM_ENABLED
+// Largest level of the bloom chain, covering the scene at half size
+uniform sampler2D u_bloom;
+// Maps scene texture coordinates onto bloom texture coordinates
+uniform vec2 u_bloomTexCoordScale;
+uniform vec2 u_bloomMaxTexCoord;
+// Fraction of light replaced by its bloom
+uniform float u_bloomIntensity;
+#endif
+
+layout (location = 0) out vec4 o_color;
+
+// Fitted approximation of the ACES reference rendering and output transforms
+// by Krzysztof Narkowicz
+vec3 tonemapAces(vec3 color)
+{
+    return clamp((color * (2.51 * color + 0.03))
+                     / (color * (2.43 * color + 0.59) + 0.14),
+                 0.0,
+                 1.0);
+}
+
+#ifdef HEATMAP_ENABLED
+// Black where nothing was drawn, blue for a single layer, through green to
+// red for the most layers
+vec3 heatColor(float layers)
+{
+    if (layers < 0.5)
+    {
+        return vec3(0.0);
+    }
+    float heat = clamp((layers - 1.0) / (MAX_HEAT_LAYERS - 1.0), 0.0, 1.0);
+    return heat < 0.5
+             ? mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), heat * 2.0)
+             : mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), heat * 2.0 - 1.0);
+}
+#endif
+
+// Tonemapped color of the scene with bloom at given scene texture coordinate
+vec3 sampleScene(vec2 texCoord)
+{
+    texCoord = min(texCoord, u_maxTexCoord);
+    vec3 color = textureLod(u_scene, texCoord, 0.0).rgb;
+#ifdef HEATMAP_ENABLED
+    // Fixed point scenes round layers to the nearest representable value
+    return heatColor(round(color.r / OVERDRAW_INCREMENT));
+#else
+#ifdef BLOOM_ENABLED
+    vec3 bloom = textureLod(u_bloom,
+                            min(texCoord * u_bloomTexCoordScale,
+                                u_bloomMaxTexCoord),
+                            0.0).rgb;
+    color = mix(color, bloom, u_bloomIntensity);
+#endif
+    return tonemapAces(color * u_exposure);
+#endif
+}
+
+#ifdef FXAA_ENABLED
+float getLuma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+// Luma of neighbor at given offset in texels
+float sampleLuma(vec2 texCoord, vec2 offset)
+{
+    return getLuma(sampleScene(texCoord + offset * u_texelSize));
+}
+
+// Pixels whose neighborhood has enough luma contrast are on an edge, and are
+// blended with samples taken along the edge, estimated from the luma
+// gradient of the four diagonal neighbors
+vec3 antialias(vec2 texCoord)
+{
+    vec3 colorM = sampleScene(texCoord);
+    float lumaM = getLuma(colorM);
+    float lumaNW = sampleLuma(texCoord, vec2(-1.0, 1.0));
+    float lumaNE = sampleLuma(texCoord, vec2(1.0, 1.0));
+    float lumaSW = sampleLuma(texCoord, vec2(-1.0, -1.0));
+    float lumaSE = sampleLuma(texCoord, vec2(1.0, -1.0));
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+    {
+        return colorM;
+    }
+
+    // Edge runs perpendicular to the luma gradient. Direction is scaled so
+    // that its shorter component spans a texel.
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)),
+                          (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE)
+                                    * (0.25 * REDUCE_MUL),
+                                REDUCE_MIN);
+    float inverseDirectionMin
+        = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * inverseDirectionMin, -SPAN_MAX, SPAN_MAX)
+              * u_texelSize;
+
+    // Two samples close to the pixel, and two more further along the edge
+    // unless they cross into another edge and leave the local luma range
+    vec3 colorA
+        = 0.5 * (sampleScene(texCoord + direction * (1.0 / 3.0 - 0.5))
+                 + sampleScene(texCoord + direction * (2.0 / 3.0 - 0.5)));
+    vec3 colorB = colorA * 0.5
+                + 0.25 * (sampleScene(texCoord - direction * 0.5)
+                          + sampleScene(texCoord + direction * 0.5));
+    float lumaB = getLuma(colorB);
+    return lumaB < lumaMin || lumaB > lumaMax ? colorA : colorB;
+}
+#endif
+
+void main()
+{
+    vec2 texCoord = gl_FragCoord.xy * u_texCoordScale;
+#ifdef FXAA_ENABLED
+    o_color = vec4(antialias(texCoord), 1.0);
+#else
+    o_color = vec4(sampleScene(texCoord), 1.0);
+#endif
+}
@@ -0,0 +1,43 @@
+#version 430 core
+
+// Scatter transforms of moved copies uploaded as a compact list into the
+// resident transforms of all copies. One invocation per moved copy.
+layout (local_size_x = 64) in;
+
+// Packed vertex positions arrive normalized relative to the bounding box of
+// the mesh, and model matrix includes their dequantization. Normal matrix is
+// stored with padded columns, matching std430 layout of mat4.
+struct DrawData
+{
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+struct ScatteredDrawData
+{
+    DrawData draw;
+    uint copy;
+};
+
+layout (std430, binding = 0) readonly buffer ScatteredBuffer
+{
+    ScatteredDrawData u_scattered[];
+};
+
+layout (std430, binding = 1) writeonly buffer DrawDataBuffer
+{
+    DrawData u_draws[];
+};
+
+uniform int u_scatterCount;
+
+void main()
+{
+    int index = int(gl_GlobalInvocationID.x);
+    if (index >= u_scatterCount)
+    {
+        return;
+    }
+    ScatteredDrawData scattered = u_scattered[index];
+    u_draws[scattered.copy] = scattered.draw;
+}
@@ -0,0 +1,30 @@
+#version 300 es
+precision mediump float;
+
+// Blends transparent surfaces accumulated by weighted blended
+// order-independent transparency over the scene. Accumulation is sized like
+// the scene target, so pixels map one to one.
+
+// Weighted color sum in RGB, and fraction of the background still revealed
+// through all surfaces in alpha
+uniform mediump sampler2D u_accumulation;
+// Sum of weights
+uniform mediump sampler2D u_weight;
+
+layout (location = 0) out vec4 o_FragColor;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(u_accumulation, pixel, 0);
+    float revealage = accumulation.a;
+    // No transparent surface covers the pixel
+    if (revealage >= 1.0)
+    {
+        discard;
+    }
+    float weight = texelFetch(u_weight, pixel, 0).r;
+    // Weighted average color of the surfaces covers the background by the
+    // fraction they do not reveal
+    o_FragColor = vec4(accumulation.rgb / max(weight, 1e-4), 1.0 - revealage);
+}
@@ -0,0 +1,15 @@
+#version 430 core
+
+// Composites UI cached by an earlier frame over the window. Color is
+// premultiplied by alpha, as left by blending of UI drawn into a transparent
+// target, and the overlay is the size of the window, so pixels map one to
+// one.
+
+uniform sampler2D u_overlay;
+
+layout (location = 0) out vec4 o_color;
+
+void main()
+{
+    o_color = texelFetch(u_overlay, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,44 @@
+#version 430 core
+
+// Passes triangles of any model vertex shader through unchanged, adding
+// barycentric coordinates for the fragment shader to find edges by. Shading
+// and wireframe overlay are drawn in a single pass.
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+layout (location = 0) in vec3 v_fragPos[];
+layout (location = 1) in vec3 v_normal[];
+layout (location = 2) flat in uint v_objectId[];
+layout (location = 4) flat in vec3 v_color[];
+layout (location = 5) in vec2 v_texCoord[];
+layout (location = 6) flat in int v_textureLayer[];
+
+layout (location = 0) out vec3 g_fragPos;
+layout (location = 1) out vec3 g_normal;
+layout (location = 2) flat out uint g_objectId;
+layout (location = 3) noperspective out vec3 g_barycentric;
+layout (location = 4) flat out vec3 g_color;
+layout (location = 5) out vec2 g_texCoord;
+layout (location = 6) flat out int g_textureLayer;
+
+// Positions are copied from the vertex shader as they are, so that depths
+// still match the depth prepass, which is drawn without this shader
+invariant gl_Position;
+
+void main()
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        gl_Position = gl_in[i].gl_Position;
+        g_fragPos = v_fragPos[i];
+        g_normal = v_normal[i];
+        g_objectId = v_objectId[i];
+        g_color = v_color[i];
+        g_texCoord = v_texCoord[i];
+        g_textureLayer = v_textureLayer[i];
+        g_barycentric = vec3(0.0);
+        g_barycentric[i] = 1.0;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,350 @@
+// Offline asset baker, converting source assets into the formats the
+// application reads at runtime ahead of time, instead of on first launch.
+//
+//   3DRendererAssetBaker <source directory> <output directory>
+//
+// Every asset is copied to the output directory, and models are imported
+// through the same code as by the application, leaving the mesh cache, the
+// cluster page file and the progressive file of the browser build next to
+// them. Files are baked in parallel on every hardware thread. Hashes of
+// source contents are recorded in a manifest next to the output directory,
+// so that later runs only bake files whose contents changed, and delete
+// outputs of removed files.
+//
+// Caches are validated at runtime against size and modification time of the
+// model file they were imported from, so the output directory has to be
+// copied with modification times preserved.
+
+#include "clusterpages.h"
+#include "mappedfile.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "model.h"
+#include "progressivemesh.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include "assimp/Importer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Bump when formats written by the baker or the import options change, so
+/// that every file is baked again.
+constexpr std::uint64_t BAKE_VERSION = 1;
+/// Files written next to assets by the application and by the baker, left
+/// out when found among sources the application was run on.
+constexpr std::array<std::string_view, 6> GENERATED_EXTENSIONS{".meshcache",
+                                                               ".pagecache",
+                                                               ".progressive",
+                                                               ".texcache",
+                                                               ".vtex",
+                                                               ".tmp"};
+
+/// Source file to bake, identified by its path relative to the source
+/// directory.
+struct Asset
+{
+    fs::path relativePath;
+    bool model;
+    std::uint64_t hash;
+};
+
+/// 64-bit FNV-1a hash of file contents, continuing from the bake version.
+/// Empty files cannot be mapped and hash to the version alone.
+std::optional<std::uint64_t> hashFile(const fs::path& path)
+{
+    std::uint64_t hash = 14695981039346656037U ^ BAKE_VERSION;
+    hash *= 1099511628211U;
+    std::error_code error;
+    if (fs::file_size(path, error) == 0 && !error)
+    {
+        return hash;
+    }
+    const std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file)
+    {
+        utils::logWarning("unable to read ", path);
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < file->size(); ++i)
+    {
+        hash ^= static_cast<std::uint8_t>(file->data()[i]);
+        hash *= 1099511628211U;
+    }
+    return hash;
+}
+
+fs::path manifestPath(const fs::path& outputDirectory)
+{
+    fs::path path = outputDirectory;
+    path += ".manifest";
+    return path;
+}
+
+/// Hashes of sources baked by the previous run, keyed by relative path. Each
+/// line holds a hash in hexadecimal followed by the path.
+std::unordered_map<std::string, std::uint64_t> readManifest(
+    const fs::path& path)
+{
+    std::unordered_map<std::string, std::uint64_t> hashes;
+    std::ifstream file{path};
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t separator = line.find(' ');
+        if (separator == std::string::npos)
+        {
+            continue;
+        }
+        hashes.emplace(line.substr(separator + 1),
+                       std::strtoull(line.c_str(), nullptr, 16));
+    }
+    return hashes;
+}
+
+bool writeManifest(const fs::path& path, const std::vector<Asset>& assets)
+{
+    std::ofstream file{path, std::ios::trunc};
+    for (const Asset& asset : assets)
+    {
+        file << std::hex << asset.hash << ' '
+             << asset.relativePath.generic_string() << '\n';
+    }
+    if (!file)
+    {
+        utils::logWarning("unable to write manifest ", path);
+        return false;
+    }
+    return true;
+}
+
+/// Remove outputs of a source that was removed or changed, including files
+/// derived from it.
+void removeOutputs(const fs::path& outputPath)
+{
+    std::error_code error;
+    fs::remove(outputPath, error);
+    fs::remove(meshcache::cachePath(outputPath), error);
+    fs::remove(meshcache::pageCachePath(outputPath), error);
+    fs::remove(progressivemesh::progressivePath(outputPath), error);
+}
+
+/// Copy of source keeping its modification time, so that rebaking unchanged
+/// contents would produce caches stamped the same way.
+bool copySource(const fs::path& sourcePath, const fs::path& outputPath)
+{
+    std::error_code error;
+    fs::create_directories(outputPath.parent_path(), error);
+    fs::copy_file(sourcePath,
+                  outputPath,
+                  fs::copy_options::overwrite_existing,
+                  error);
+    if (error)
+    {
+        utils::logWarning("unable to copy ",
+                          sourcePath,
+                          ": ",
+                          error.message());
+        return false;
+    }
+    const fs::file_time_type modifiedTime
+        = fs::last_write_time(sourcePath, error);
+    if (!error)
+    {
+        fs::last_write_time(outputPath, modifiedTime, error);
+    }
+    return true;
+}
+
+/// Write the runtime formats of a model copied to the output directory.
+bool bakeModel(const fs::path& path, ThreadPool& threadPool)
+{
+    // Progressive files are built from discrete level of detail chains
+    // instead of cluster hierarchies, like by the --progressive option of the
+    // application. Imported first, so that the mesh cache is left with
+    // default options read by the application.
+    ImportOptions progressiveOptions = ImportOptions::createDefault();
+    progressiveOptions.buildClusterLod = false;
+    const std::optional<MeshData> progressiveMesh
+        = Model::loadMeshData(path, progressiveOptions, &threadPool);
+    if (!progressiveMesh
+        || !progressivemesh::write(progressiveMesh.value(),
+                                   progressivemesh::progressivePath(path)))
+    {
+        return false;
+    }
+
+    const ImportOptions options = ImportOptions::createDefault();
+    const std::optional<MeshData> meshData
+        = Model::loadMeshData(path, options, &threadPool);
+    if (!meshData)
+    {
+        return false;
+    }
+    // Meshes that cannot be split into pages are uploaded whole when
+    // streamed, and have no page file
+    Bounds bounds{};
+    std::vector<clusterpages::ClusterPage> pages;
+    std::vector<clusterpages::PagedMeshlet> meshlets;
+    std::vector<std::byte> payload;
+    return !clusterpages::build(meshData.value(),
+                                bounds,
+                                pages,
+                                meshlets,
+                                payload)
+        || meshcache::storePages(path,
+                                 options,
+                                 bounds,
+                                 pages,
+                                 meshlets,
+                                 payload);
+}
+
+/// Sources under the directory, with models recognized by the extensions
+/// the importer supports.
+std::optional<std::vector<Asset>> collectAssets(const fs::path& directory)
+{
+    std::error_code error;
+    fs::recursive_directory_iterator iterator{directory, error};
+    if (error)
+    {
+        utils::logWarning("unable to read directory ",
+                          directory,
+                          ": ",
+                          error.message());
+        return std::nullopt;
+    }
+    const Assimp::Importer importer;
+    std::vector<Asset> assets;
+    for (const fs::directory_entry& entry : iterator)
+    {
+        if (!entry.is_regular_file(error))
+        {
+            continue;
+        }
+        const std::string extension = entry.path().extension().string();
+        if (std::ranges::find(GENERATED_EXTENSIONS, extension)
+            != GENERATED_EXTENSIONS.end())
+        {
+            continue;
+        }
+        assets.push_back(Asset{
+            .relativePath = entry.path().lexically_relative(directory),
+            .model = !extension.empty()
+                  && importer.IsExtensionSupported(extension),
+            .hash = 0,
+        });
+    }
+    // Manifest order does not depend on directory iteration order
+    std::ranges::sort(assets, {}, &Asset::relativePath);
+    return assets;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        utils::logWarning("usage: ",
+                          argv[0],
+                          " <source directory> <output directory>");
+        return EXIT_FAILURE;
+    }
+    const fs::path sourceDirectory{argv[1]};
+    const fs::path outputDirectory{argv[2]};
+    std::optional<std::vector<Asset>> assets = collectAssets(sourceDirectory);
+    if (!assets)
+    {
+        return EXIT_FAILURE;
+    }
+
+    const fs::path manifest = manifestPath(outputDirectory);
+    const std::unordered_map<std::string, std::uint64_t> previousHashes
+        = readManifest(manifest);
+    for (const auto& [relativePath, hash] : previousHashes)
+    {
+        const bool kept = std::ranges::any_of(
+            assets.value(),
+            [&](const Asset& asset)
+            { return asset.relativePath.generic_string() == relativePath; });
+        if (!kept)
+        {
+            removeOutputs(outputDirectory / relativePath);
+        }
+    }
+
+    // Models are imported in tasks of their own, each splitting its import
+    // over the same pool
+    ThreadPool threadPool;
+    TaskCounter counter;
+    std::atomic<size_t> bakedCount{0};
+    std::atomic<bool> failed{false};
+    for (Asset& asset : assets.value())
+    {
+        threadPool.submit(
+            counter,
+            [&]
+            {
+                const fs::path sourcePath = sourceDirectory
+                                          / asset.relativePath;
+                const fs::path outputPath = outputDirectory
+                                          / asset.relativePath;
+                const std::optional<std::uint64_t> hash = hashFile(sourcePath);
+                if (!hash)
+                {
+                    failed = true;
+                    return;
+                }
+                asset.hash = hash.value();
+                const auto previous = previousHashes.find(
+                    asset.relativePath.generic_string());
+                std::error_code error;
+                if (previous != previousHashes.end()
+                    && previous->second == asset.hash
+                    && fs::exists(outputPath, error))
+                {
+                    return;
+                }
+                removeOutputs(outputPath);
+                if (!copySource(sourcePath, outputPath)
+                    || (asset.model && !bakeModel(outputPath, threadPool)))
+                {
+                    utils::logWarning("unable to bake ", sourcePath);
+                    // Baked again on next run
+                    asset.hash = 0;
+                    failed = true;
+                    return;
+                }
+                ++bakedCount;
+            });
+    }
+    threadPool.wait(counter);
+
+    utils::logInfo("baked ",
+                   bakedCount.load(),
+                   " of ",
+                   assets->size(),
+                   " assets into ",
+                   outputDirectory);
+    if (!writeManifest(manifest, assets.value()) || failed)
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,463 @@
+// Microbenchmarks of model import, ray queries, mesh editing, mesh stream
+// decoding, uniform updates and per-object transform math, giving numbers to
+// compare before and after optimizing them.
+//
+// Run from the build directory, where assets are copied next to the
+// executable. Graphics API calls are measured in a hidden window.
+
+#include "bvh.h"
+#include "camera.h"
+#include "editablemesh.h"
+#include "frustum.h"
+#include "geometryarena.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshcodec.h"
+#include "model.h"
+#include "shader.h"
+#include "streambuffer.h"
+#include "threadpool.h"
+#include "transformbatch.h"
+#include "utils.h"
+
+#include "glad/gl.h"
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+#include <GLFW/glfw3.h>
+#include <nanobench.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<const char*, 3> MODEL_PATHS{"assets/meshes/cube.obj",
+                                                 "assets/meshes/teapot.obj",
+                                                 "assets/meshes/bunny.obj"};
+/// Objects transformed per batch, about the copies drawn by a 32x32 instance
+/// grid.
+constexpr size_t TRANSFORM_BATCH_SIZE = 1024;
+/// Rays cast per ray query batch, spread over directions around the model.
+constexpr size_t RAY_BATCH_SIZE = 1024;
+/// Vertices along each side of the edited grid mesh, a million in total, and
+/// along each side of the square moved by a brush stroke.
+constexpr std::uint32_t EDIT_GRID_SIZE = 1024;
+constexpr std::uint32_t BRUSH_SIZE = 64;
+
+void benchmarkModelImport()
+{
+    ankerl::nanobench::Bench bench;
+    bench.title("Model import").unit("model").warmup(1).epochs(5);
+    const ImportOptions options = ImportOptions::createDefault();
+    for (const char* modelPath : MODEL_PATHS)
+    {
+        // Removing the cache entry beforehand measures the full import from
+        // model file, which is what each launch after an edit pays for
+        const fs::path cachePath = meshcache::cachePath(modelPath);
+        bench.run(std::string{modelPath} + " (file)",
+                  [&]
+                  {
+                      std::error_code error;
+                      fs::remove(cachePath, error);
+                      ankerl::nanobench::doNotOptimizeAway(
+                          Model::loadMeshData(modelPath, options));
+                  });
+        bench.run(std::string{modelPath} + " (cache)",
+                  [&]
+                  {
+                      ankerl::nanobench::doNotOptimizeAway(
+                          Model::loadMeshData(modelPath, options));
+                  });
+    }
+}
+
+void benchmarkRayQueries()
+{
+    ThreadPool threadPool;
+    ImportOptions options = ImportOptions::createDefault();
+    options.buildBvh = true;
+    const char* modelPath = MODEL_PATHS.back();
+    std::optional<MeshData> meshData
+        = Model::loadMeshData(modelPath, options, &threadPool);
+    if (!meshData)
+    {
+        utils::showErrorMessage("unable to load model for benchmark");
+        return;
+    }
+    const Model model = Model::create(meshData.value(), true);
+    const CpuGeometry& geometry = model.cpuGeometry.value();
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Ray queries").warmup(1);
+    std::vector<BvhNode> nodes;
+    std::vector<GLuint> triangles;
+    bench.run(std::string{"bvh::build "} + modelPath,
+              [&]
+              {
+                  bvh::build(geometry.positions,
+                             geometry.indices,
+                             &threadPool,
+                             nodes,
+                             triangles);
+                  ankerl::nanobench::doNotOptimizeAway(nodes.size());
+              });
+
+    // Rays are cast towards the center of the bounding sphere from points on
+    // a sphere twice as large, hitting the surface from every side
+    const BoundingSphere& sphere = model.boundingSphere;
+    std::vector<bvh::Ray> rays(RAY_BATCH_SIZE);
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        // Fibonacci sphere spreads directions evenly
+        const float y = 1.0F
+                      - 2.0F * (static_cast<float>(i) + 0.5F)
+                            / static_cast<float>(rays.size());
+        const float ringRadius = std::sqrt(1.0F - y * y);
+        const float angle = 2.39996323F * static_cast<float>(i);
+        const glm::vec3 direction{ringRadius * std::cos(angle),
+                                  y,
+                                  ringRadius * std::sin(angle)};
+        rays[i] = {
+            .origin = sphere.center + direction * sphere.radius * 2.0F,
+            .direction = -direction,
+            .maxDistance = sphere.radius * 4.0F,
+        };
+    }
+    bench.batch(RAY_BATCH_SIZE).unit("ray");
+    bench.run("CpuGeometry::intersect",
+              [&]
+              {
+                  for (const bvh::Ray& ray : rays)
+                  {
+                      ankerl::nanobench::doNotOptimizeAway(
+                          geometry.intersect(ray));
+                  }
+              });
+}
+
+void benchmarkMeshEditing()
+{
+    std::vector<Vertex> vertices;
+    vertices.reserve(size_t{EDIT_GRID_SIZE} * EDIT_GRID_SIZE);
+    for (std::uint32_t z = 0; z < EDIT_GRID_SIZE; ++z)
+    {
+        for (std::uint32_t x = 0; x < EDIT_GRID_SIZE; ++x)
+        {
+            vertices.push_back({
+                .position = glm::vec3{static_cast<float>(x),
+                                      0.0F,
+                                      static_cast<float>(z)},
+                .normal = glm::vec3{0.0F, 1.0F, 0.0F},
+                .texCoord = glm::vec2{0.0F},
+            });
+        }
+    }
+    std::vector<GLuint> indices;
+    for (std::uint32_t z = 0; z + 1 < EDIT_GRID_SIZE; ++z)
+    {
+        for (std::uint32_t x = 0; x + 1 < EDIT_GRID_SIZE; ++x)
+        {
+            const GLuint corner = z * EDIT_GRID_SIZE + x;
+            indices.insert(indices.end(),
+                           {corner,
+                            corner + EDIT_GRID_SIZE,
+                            corner + 1,
+                            corner + 1,
+                            corner + EDIT_GRID_SIZE,
+                            corner + EDIT_GRID_SIZE + 1});
+        }
+    }
+    const Submesh submesh{
+        .firstIndex = 0,
+        .indexCount = static_cast<GLuint>(indices.size()),
+        .baseVertex = 0,
+        .firstMeshlet = 0,
+        .meshletCount = 0,
+        .firstLod = 0,
+        .lodCount = 0,
+        .baseColor = glm::vec3{1.0F},
+        .opacity = 1.0F,
+        .textureLayer = NO_TEXTURE_LAYER,
+    };
+    const MeshData meshData = MeshData::fromContainers(std::move(vertices),
+                                                       std::move(indices),
+                                                       {submesh},
+                                                       {},
+                                                       {});
+    ThreadPool threadPool;
+    EditableMesh mesh = EditableMesh::create(meshData, threadPool);
+    // Sized for updating the whole mesh, which takes every vertex
+    StreamBuffer streamBuffer{
+        static_cast<GLsizeiptr>(meshData.vertexData().size_bytes())};
+
+    // Each update is waited for, so that measurements include the copies on
+    // the GPU
+    ankerl::nanobench::Bench bench;
+    bench.title("Mesh editing").unit("update").warmup(3);
+    float height = 0.0F;
+    // Brush moves a square of vertices in the middle of the grid
+    const std::uint32_t corner
+        = (EDIT_GRID_SIZE - BRUSH_SIZE) / 2 * (EDIT_GRID_SIZE + 1);
+    bench.run("EditableMesh::update (brush)",
+              [&]
+              {
+                  streamBuffer.beginFrame();
+                  height += 0.01F;
+                  for (std::uint32_t row = 0; row < BRUSH_SIZE; ++row)
+                  {
+                      for (glm::vec3& position : mesh.editPositions(
+                               corner + row * EDIT_GRID_SIZE,
+                               BRUSH_SIZE))
+                      {
+                          position.y = height;
+                      }
+                  }
+                  mesh.update(streamBuffer, threadPool);
+                  glFinish();
+              });
+    bench.run("EditableMesh::update (whole mesh)",
+              [&]
+              {
+                  streamBuffer.beginFrame();
+                  height += 0.01F;
+                  for (glm::vec3& position :
+                       mesh.editPositions(0, EDIT_GRID_SIZE * EDIT_GRID_SIZE))
+                  {
+                      position.y = std::sin(position.x * 0.1F + height);
+                  }
+                  mesh.update(streamBuffer, threadPool);
+                  glFinish();
+              });
+}
+
+void benchmarkMeshDecoding()
+{
+    const char* modelPath = MODEL_PATHS.back();
+    const std::optional<MeshData> meshData
+        = Model::loadMeshData(modelPath, ImportOptions::createDefault());
+    if (!meshData)
+    {
+        utils::showErrorMessage("unable to load model for benchmark");
+        return;
+    }
+    const EncodedArenaGeometry encoded = GeometryArena::encode(*meshData);
+    const size_t decodedSize
+        = encoded.vertexCount * sizeof(PackedVertex)
+        + encoded.indexCount * sizeof(GLuint);
+    const size_t encodedSize
+        = (encoded.vertexStream.size() + encoded.indexStream.size())
+        * sizeof(std::uint32_t);
+    utils::logInfo(modelPath,
+                   " encodes ",
+                   decodedSize,
+                   " bytes of arena geometry into ",
+                   encodedSize,
+                   " bytes");
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Mesh decoding").unit("mesh").warmup(3);
+    bench.run(std::string{"GeometryArena::encode "} + modelPath,
+              [&]
+              {
+                  ankerl::nanobench::doNotOptimizeAway(
+                      GeometryArena::encode(*meshData));
+              });
+    std::vector<PackedVertex> vertices(encoded.vertexCount);
+    std::vector<GLuint> indices(encoded.indexCount);
+    bench.run("meshcodec::decode",
+              [&]
+              {
+                  ankerl::nanobench::doNotOptimizeAway(
+                      meshcodec::decodeVertices(encoded.vertexStream, vertices)
+                      && meshcodec::decodeIndices(encoded.indexStream,
+                                                  indices));
+              });
+
+    // Additions are waited for, so that measurements include uploads and
+    // decoding on the GPU. Arena without decoder shader decodes on the CPU.
+    GeometryArena cpuArena;
+    GeometryArena gpuArena;
+    if (!gpuArena.init(GeometryArena::submitShader()))
+    {
+        return;
+    }
+    bench.run("GeometryArena::add (mesh data)",
+              [&]
+              {
+                  cpuArena.remove(cpuArena.add(*meshData));
+                  glFinish();
+              });
+    bench.run("GeometryArena::add (CPU decoding)",
+              [&]
+              {
+                  cpuArena.remove(cpuArena.add(encoded));
+                  glFinish();
+              });
+    bench.run("GeometryArena::add (GPU decoding)",
+              [&]
+              {
+                  gpuArena.remove(gpuArena.add(encoded));
+                  glFinish();
+              });
+}
+
+void benchmarkUniforms()
+{
+    std::optional<Shader> shader = Shader::createComputeFromFile(
+        fs::path{"assets/shaders/cull_gl4.comp.glsl"});
+    if (!shader)
+    {
+        utils::showErrorMessage("unable to create shader for benchmark");
+        return;
+    }
+    GlStateCache glState;
+    shader->use(glState);
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Uniform update").relative(true);
+    bench.run("glGetUniformLocation + glUniform1i",
+              [&]
+              {
+                  glUniform1i(glGetUniformLocation(shader->program(),
+                                                   "u_commandCount"),
+                              1);
+              });
+    bench.run("getUniformHandle + setUniform",
+              [&]
+              {
+                  shader->setUniform(
+                      shader->getUniformHandle<int>("u_commandCount"),
+                      1);
+              });
+    const UniformHandle<int> handle
+        = shader->getUniformHandle<int>("u_commandCount");
+    bench.run("setUniform", [&] { shader->setUniform(handle, 1); });
+    // Uniform updates are only queued by the driver
+    glFinish();
+}
+
+void benchmarkTransforms()
+{
+    const Camera camera{glm::vec3{0.0F, 1.5F, 4.0F},
+                        glm::vec2{-90.0F, -20.0F}};
+    const glm::mat4 projection
+        = glm::perspective(glm::radians(60.0F), 16.0F / 9.0F, 0.1F, 100.0F);
+    const BoundingSphere sphere{.center = glm::vec3{0.0F}, .radius = 1.0F};
+
+    // Grid of world matrices like the instance grid of the application
+    std::vector<glm::mat4> worldMatrices(TRANSFORM_BATCH_SIZE);
+    for (size_t i = 0; i < worldMatrices.size(); ++i)
+    {
+        const glm::vec3 position{static_cast<float>(i % 32),
+                                 0.0F,
+                                 static_cast<float>(i / 32)};
+        worldMatrices[i] = glm::translate(glm::mat4{1.0F}, position);
+    }
+    std::vector<glm::mat4> mvps(TRANSFORM_BATCH_SIZE);
+    std::vector<glm::mat3> normalMatrices(TRANSFORM_BATCH_SIZE);
+
+    ankerl::nanobench::Bench bench;
+    bench.title("Transform math");
+    bench.run("Camera::calculateViewMatrix",
+              [&]
+              {
+                  ankerl::nanobench::doNotOptimizeAway(
+                      camera.calculateViewMatrix());
+              });
+    bench.run("transformSphere",
+              [&]
+              {
+                  ankerl::nanobench::doNotOptimizeAway(
+                      transformSphere(sphere, worldMatrices[1]));
+              });
+
+    // Recording a model copy transforms a single object at a time
+    const glm::mat4 viewProjection = projection * camera.calculateViewMatrix();
+    bench.run("computeMvpMatrices x1",
+              [&]
+              {
+                  transformbatch::computeMvpMatrices(
+                      viewProjection,
+                      std::span{worldMatrices}.first(1),
+                      std::span{mvps}.first(1));
+                  ankerl::nanobench::doNotOptimizeAway(mvps.front());
+              });
+    bench.run("computeNormalMatrices x1",
+              [&]
+              {
+                  transformbatch::computeNormalMatrices(
+                      std::span{worldMatrices}.first(1),
+                      std::span{normalMatrices}.first(1));
+                  ankerl::nanobench::doNotOptimizeAway(normalMatrices.front());
+              });
+    bench.batch(TRANSFORM_BATCH_SIZE).unit("matrix");
+    bench.run("computeMvpMatrices x1024",
+              [&]
+              {
+                  transformbatch::computeMvpMatrices(viewProjection,
+                                                     worldMatrices,
+                                                     mvps);
+                  ankerl::nanobench::doNotOptimizeAway(mvps.back());
+              });
+    bench.run("computeNormalMatrices x1024",
+              [&]
+              {
+                  transformbatch::computeNormalMatrices(worldMatrices,
+                                                        normalMatrices);
+                  ankerl::nanobench::doNotOptimizeAway(normalMatrices.back());
+              });
+}
+}  // namespace
+
+int main()
+{
+    if (!glfwInit())
+    {
+        utils::showErrorMessage("unable to initialize windowing system");
+        return EXIT_FAILURE;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow* window
+        = glfwCreateWindow(1, 1, "3D renderer benchmark", nullptr, nullptr);
+    if (!window)
+    {
+        utils::showErrorMessage("unable to create window");
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL(glfwGetProcAddress))
+    {
+        utils::showErrorMessage("unable to load OpenGL extensions");
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+
+    benchmarkModelImport();
+    benchmarkRayQueries();
+    benchmarkMeshEditing();
+    benchmarkMeshDecoding();
+    benchmarkUniforms();
+    benchmarkTransforms();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return EXIT_SUCCESS;
+}
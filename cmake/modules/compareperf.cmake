@@ -0,0 +1,98 @@
+# Run application in benchmark mode and compare frame time percentiles and
+# load time against a baseline of an earlier run, failing on regression. Run in
+# script mode from the executable directory:
+#
+#   cmake -DAPP=<executable> -DBENCHMARK_ARGUMENTS="--model 2 --grid 1"
+#         -DRESULTS=<results .json> -DBASELINE=<baseline .json>
+#         -DFRAME_TIME_TOLERANCE=<percent> -DLOAD_TIME_TOLERANCE=<percent>
+#         [-DUPDATE_BASELINE=ON] [-DREQUIRE_BASELINE=ON] -P compareperf.cmake
+#
+# Baselines are benchmark results as written by the application. With
+# UPDATE_BASELINE, results are copied over the baseline instead of compared.
+# Missing baselines skip the comparison, or fail with REQUIRE_BASELINE.
+# Only slowdowns fail, refresh the baseline after intended speedups.
+
+separate_arguments(ARGUMENTS UNIX_COMMAND "${BENCHMARK_ARGUMENTS}")
+execute_process(
+    COMMAND "${APP}" --benchmark ${ARGUMENTS} --output "${RESULTS}"
+    RESULT_VARIABLE EXIT_CODE
+)
+if(NOT EXIT_CODE EQUAL 0 OR NOT EXISTS "${RESULTS}")
+    message(FATAL_ERROR "Benchmark failed with exit code ${EXIT_CODE}")
+endif()
+
+file(READ "${RESULTS}" RESULTS_JSON)
+if(UPDATE_BASELINE)
+    file(WRITE "${BASELINE}" "${RESULTS_JSON}")
+    message(STATUS "Recorded baseline ${BASELINE}")
+    return()
+endif()
+if(NOT EXISTS "${BASELINE}")
+    if(REQUIRE_BASELINE)
+        message(FATAL_ERROR "Baseline missing at ${BASELINE}, record one "
+                            "with PERF_UPDATE_BASELINES on the reference "
+                            "machine")
+    endif()
+    message(STATUS "No baseline recorded at ${BASELINE}, record one with "
+                   "PERF_UPDATE_BASELINES on the reference machine")
+    return()
+endif()
+
+file(READ "${BASELINE}" BASELINE_JSON)
+set(REGRESSIONS "")
+
+# Convert milliseconds written by the benchmark into integer microseconds, as
+# math expressions are integer only
+function(to_microseconds MILLISECONDS OUTPUT)
+    string(REGEX MATCH "^([0-9]+)\\.?([0-9]*)" MATCHED "${MILLISECONDS}")
+    set(FRACTION "${CMAKE_MATCH_2}000")
+    string(SUBSTRING "${FRACTION}" 0 3 FRACTION)
+    # Leading one keeps zeros of the fraction from being dropped
+    math(EXPR MICROSECONDS "${CMAKE_MATCH_1} * 1000 + 1${FRACTION} - 1000")
+    set(${OUTPUT} ${MICROSECONDS} PARENT_SCOPE)
+endfunction()
+
+# Compare member at path of both documents, appending a regression when
+# result exceeds baseline by more than tolerance percent
+function(compare_value TOLERANCE)
+    string(JSON RESULT GET "${RESULTS_JSON}" ${ARGN})
+    string(JSON BASE GET "${BASELINE_JSON}" ${ARGN})
+    string(JOIN "." NAME ${ARGN})
+    to_microseconds("${RESULT}" RESULT_US)
+    to_microseconds("${BASE}" BASE_US)
+    math(EXPR LIMIT_US "${BASE_US} * (100 + ${TOLERANCE}) / 100")
+    message(STATUS "${NAME}: ${RESULT} ms, baseline ${BASE} ms")
+    if(RESULT_US GREATER LIMIT_US)
+        string(APPEND REGRESSIONS "\n  ${NAME}: ${RESULT} ms exceeds baseline "
+            "${BASE} ms by over ${TOLERANCE}%")
+        set(REGRESSIONS "${REGRESSIONS}" PARENT_SCOPE)
+    endif()
+endfunction()
+
+compare_value(${FRAME_TIME_TOLERANCE} frameTimeMs p50)
+compare_value(${FRAME_TIME_TOLERANCE} frameTimeMs p90)
+compare_value(${FRAME_TIME_TOLERANCE} frameTimeMs p99)
+compare_value(${LOAD_TIME_TOLERANCE} loadTimeMs)
+
+# Builds counting heap allocations compare the most made by a frame without
+# tolerance, so that frames allocating nothing keep doing so
+string(JSON RESULT_ALLOCATIONS ERROR_VARIABLE RESULT_ERROR
+    GET "${RESULTS_JSON}" heapAllocationsPerFrame)
+string(JSON BASE_ALLOCATIONS ERROR_VARIABLE BASE_ERROR
+    GET "${BASELINE_JSON}" heapAllocationsPerFrame)
+if(NOT RESULT_ERROR AND NOT BASE_ERROR)
+    foreach(SUBSYSTEM IN ITEMS renderer gui)
+        string(JSON RESULT GET "${RESULT_ALLOCATIONS}" ${SUBSYSTEM} max)
+        string(JSON BASE GET "${BASE_ALLOCATIONS}" ${SUBSYSTEM} max)
+        message(STATUS "${SUBSYSTEM} heap allocations per frame: at most "
+                       "${RESULT}, baseline ${BASE}")
+        if(RESULT GREATER BASE)
+            string(APPEND REGRESSIONS "\n  ${SUBSYSTEM}: ${RESULT} heap "
+                "allocations in a frame exceed baseline ${BASE}")
+        endif()
+    endforeach()
+endif()
+
+if(REGRESSIONS)
+    message(FATAL_ERROR "Performance regressed:${REGRESSIONS}")
+endif()
@@ -0,0 +1,8 @@
+# Copy asset directory preserving modification times, which mesh caches baked
+# next to models are validated against. Run in script mode:
+#
+#   cmake -DSOURCE=<asset directory> -DDESTINATION=<directory> -P copyassets.cmake
+#
+# Files already copied with the same modification time are skipped.
+
+file(COPY "${SOURCE}/" DESTINATION "${DESTINATION}")
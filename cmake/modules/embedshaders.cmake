@@ -0,0 +1,59 @@
+# Generate C++ source holding GLSL files of a directory as constant tables,
+# found by embeddedshaders::find() under their path relative to the source
+# tree. Run in script mode:
+#
+#   cmake -DSOURCE_ROOT=<root> -DSHADER_DIR=<root>/assets/shaders
+#         -DOUTPUT=<generated .cpp> -P embedshaders.cmake
+#
+# Sources are written as character arrays instead of string literals, which are
+# limited in length by some compilers.
+
+# Matches 16 bytes, as quantifiers with counts are not supported
+string(REPEAT "'\\\\x[0-9a-f][0-9a-f]'," 16 LINE_PATTERN)
+
+file(GLOB SHADER_FILES LIST_DIRECTORIES false "${SHADER_DIR}/*.glsl")
+# Lookup by binary search relies on sorted paths
+list(SORT SHADER_FILES)
+
+set(ARRAYS "")
+set(ENTRIES "")
+set(INDEX 0)
+foreach(SHADER_FILE IN LISTS SHADER_FILES)
+    file(RELATIVE_PATH KEY "${SOURCE_ROOT}" "${SHADER_FILE}")
+    file(READ "${SHADER_FILE}" HEX_CONTENTS HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," BYTES
+        "${HEX_CONTENTS}")
+    # Break lines every 16 bytes to keep the generated source readable
+    string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n    " BYTES "${BYTES}")
+    string(APPEND ARRAYS
+        "constexpr char SOURCE_${INDEX}[] = {\n    ${BYTES}'\\0'};\n"
+        "constexpr std::string_view TEXT_${INDEX}{SOURCE_${INDEX},\n"
+        "                                  sizeof(SOURCE_${INDEX}) - 1};\n"
+        "constexpr std::uint64_t HASH_${INDEX} = hashBytes(TEXT_${INDEX});\n\n")
+    string(APPEND ENTRIES
+        "    Source{\"${KEY}\", TEXT_${INDEX}, HASH_${INDEX}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+set(CONTENTS "// Generated by embedshaders.cmake from shader sources, do not edit.
+#include \"embeddedshaders.h\"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace embeddedshaders
+{
+namespace
+{
+${ARRAYS}constexpr std::array<Source, ${INDEX}> SOURCES{
+${ENTRIES}};
+}  // namespace
+
+std::span<const Source> sources()
+{
+    return SOURCES;
+}
+}  // namespace embeddedshaders
+")
+file(WRITE "${OUTPUT}" "${CONTENTS}")
@@ -0,0 +1,238 @@
+#include "allocationtracker.h"
+
+#ifdef ALLOCATION_TRACKING_ENABLED
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+// Constant initialized, as allocations may be made by static constructors of
+// other translation units before dynamic initialization of this one
+constinit std::array<std::atomic<size_t>, allocationtracker::SUBSYSTEM_COUNT>
+    allocationCounts{};
+constinit std::array<std::atomic<size_t>, allocationtracker::SUBSYSTEM_COUNT>
+    byteCounts{};
+constinit thread_local allocationtracker::Subsystem currentSubsystem
+    = allocationtracker::Subsystem::Other;
+
+// Only accessed by the main thread
+allocationtracker::SubsystemCounts frameStartCounts{};
+allocationtracker::SubsystemCounts previousFrameCounts{};
+
+void count(size_t size)
+{
+    const auto index = static_cast<size_t>(currentSubsystem);
+    allocationCounts[index].fetch_add(1, std::memory_order_relaxed);
+    byteCounts[index].fetch_add(size, std::memory_order_relaxed);
+}
+
+void* allocate(size_t size)
+{
+    count(size);
+    // Zero sized allocations have to return unique pointers
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment)
+{
+    count(size);
+    const auto alignmentSize = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+    return _aligned_malloc(size > 0 ? size : 1, alignmentSize);
+#else
+    // Size has to be a multiple of alignment
+    const size_t alignedSize
+        = (std::max<size_t>(size, 1) + alignmentSize - 1) / alignmentSize
+        * alignmentSize;
+    return std::aligned_alloc(alignmentSize, alignedSize);
+#endif
+}
+
+void freeAligned(void* pointer)
+{
+#ifdef _MSC_VER
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+/// Exceptions are disabled, so running out of memory ends the application
+/// instead of throwing.
+void* checked(void* pointer)
+{
+    if (!pointer)
+    {
+        std::abort();
+    }
+    return pointer;
+}
+}  // namespace
+
+namespace allocationtracker
+{
+Scope::Scope(Subsystem subsystem)
+    : previous_{currentSubsystem}
+{
+    currentSubsystem = subsystem;
+}
+
+Scope::~Scope()
+{
+    currentSubsystem = previous_;
+}
+
+void beginFrame()
+{
+    const SubsystemCounts counts = total();
+    for (size_t i = 0; i < SUBSYSTEM_COUNT; ++i)
+    {
+        previousFrameCounts[i] = Counts{
+            .allocationCount
+            = counts[i].allocationCount - frameStartCounts[i].allocationCount,
+            .byteCount = counts[i].byteCount - frameStartCounts[i].byteCount,
+        };
+    }
+    frameStartCounts = counts;
+}
+
+const SubsystemCounts& previousFrame()
+{
+    return previousFrameCounts;
+}
+
+SubsystemCounts total()
+{
+    SubsystemCounts counts{};
+    for (size_t i = 0; i < SUBSYSTEM_COUNT; ++i)
+    {
+        counts[i] = Counts{
+            .allocationCount
+            = allocationCounts[i].load(std::memory_order_relaxed),
+            .byteCount = byteCounts[i].load(std::memory_order_relaxed),
+        };
+    }
+    return counts;
+}
+}  // namespace allocationtracker
+
+// Replacements of every global allocation function, as the default sized,
+// aligned and non-throwing overloads are not guaranteed to forward to the
+// replaced basic ones
+
+void* operator new(size_t size)
+{
+    return checked(allocate(size));
+}
+
+void* operator new[](size_t size)
+{
+    return checked(allocate(size));
+}
+
+void* operator new(size_t size, const std::nothrow_t& /*tag*/) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& /*tag*/) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return checked(allocateAligned(size, alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return checked(allocateAligned(size, alignment));
+}
+
+void* operator new(size_t size,
+                   std::align_val_t alignment,
+                   const std::nothrow_t& /*tag*/) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size,
+                     std::align_val_t alignment,
+                     const std::nothrow_t& /*tag*/) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t /*size*/) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t /*size*/) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t& /*tag*/) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t& /*tag*/) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t /*alignment*/) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t /*alignment*/) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete(void* pointer,
+                     size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete[](void* pointer,
+                       size_t /*size*/,
+                       std::align_val_t /*alignment*/) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete(void* pointer,
+                     std::align_val_t /*alignment*/,
+                     const std::nothrow_t& /*tag*/) noexcept
+{
+    freeAligned(pointer);
+}
+
+void operator delete[](void* pointer,
+                       std::align_val_t /*alignment*/,
+                       const std::nothrow_t& /*tag*/) noexcept
+{
+    freeAligned(pointer);
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef ALLOCATION_TRACKER_H_
+#define ALLOCATION_TRACKER_H_
+
+/// Heap allocation counters, tagged by the subsystem making them, for
+/// verifying that frames do not touch the heap.
+///
+/// Global operator new is replaced with one counting allocations and their
+/// bytes before forwarding to malloc. Allocations are tagged by the subsystem
+/// of the innermost allocation scope on the allocating thread, and count as
+/// other ones outside of scopes. Counting costs a few relaxed atomic
+/// increments per allocation.
+///
+/// Enabled by the BUILD_ALLOCATION_TRACKING CMake option. Otherwise scopes
+/// compile out completely and the default operator new is used.
+#ifdef ALLOCATION_TRACKING_ENABLED
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace allocationtracker
+{
+enum class Subsystem : std::uint8_t
+{
+    /// Allocations outside of scopes.
+    Other,
+    /// Importing models and decoding skyboxes on worker threads.
+    Loader,
+    /// Drawing frames on the main thread.
+    Renderer,
+    /// Building and drawing the UI.
+    Gui,
+};
+constexpr size_t SUBSYSTEM_COUNT = 4;
+// Order matches subsystems
+constexpr std::array<const char*, SUBSYSTEM_COUNT> SUBSYSTEM_NAMES{
+    "other",
+    "loader",
+    "renderer",
+    "gui"};
+
+struct Counts
+{
+    size_t allocationCount;
+    size_t byteCount;
+};
+using SubsystemCounts = std::array<Counts, SUBSYSTEM_COUNT>;
+
+/// Tags allocations of the current thread with subsystem from construction
+/// to destruction, restoring the tag of the enclosing scope afterwards.
+class Scope
+{
+public:
+    explicit Scope(Subsystem subsystem);
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope(Scope&&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+    ~Scope();
+
+private:
+    Subsystem previous_;
+};
+
+/// Finish counting allocations of the previous frame, made by any thread.
+/// Meant to be called at the start of each frame on the main thread.
+void beginFrame();
+/// Allocations made during the previous frame.
+[[nodiscard]] const SubsystemCounts& previousFrame();
+/// Allocations made since start.
+[[nodiscard]] SubsystemCounts total();
+}  // namespace allocationtracker
+
+#define ALLOCATION_CONCAT_IMPL(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_IMPL(a, b)
+/// Tag allocations with subsystem until the end of the enclosing scope.
+#define ALLOCATION_SCOPE(subsystem)                                  \
+    const allocationtracker::Scope ALLOCATION_CONCAT(allocationScope, \
+                                                     __LINE__)        \
+    {                                                                 \
+        allocationtracker::Subsystem::subsystem                       \
+    }
+
+#else
+
+#define ALLOCATION_SCOPE(subsystem) static_cast<void>(0)
+
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+#include "ambientocclusion.h"
+
+#include "videomemory.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture unit of the depth copy while computing occlusion. Passes read
+/// the occlusion of the previous pass from the unit the result ends up on.
+constexpr GLuint DEPTH_TEXTURE_UNIT = 0;
+/// Bytes per texel of R8 occlusion.
+constexpr size_t OCCLUSION_TEXEL_SIZE = 1;
+/// Uniform buffer binding point of per-frame uniforms of model shaders.
+constexpr GLuint FRAME_DATA_BINDING = 0;
+
+int getHalfSize(int size)
+{
+    return (size + 1) / 2;
+}
+}  // namespace
+
+AmbientOcclusion::AmbientOcclusion()
+    : upsampledTarget_{}
+    , width_{0}
+    , height_{0}
+{
+}
+
+AmbientOcclusion::~AmbientOcclusion()
+{
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    glDeleteFramebuffers(1, &upsampledTarget_.framebuffer);
+    glDeleteTextures(1, &upsampledTarget_.texture);
+}
+
+AmbientOcclusion::PendingShaders AmbientOcclusion::submitShaders()
+{
+#ifdef __EMSCRIPTEN__
+    const fs::path vertexShaderPath(
+        "assets/shaders/fullscreen_gles3.vert.glsl");
+    return {
+        .occlusionShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/ssao_gles3.frag.glsl"}),
+        .blurShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/ssao_blur_gles3.frag.glsl"}),
+        .upsampleShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/ssao_upsample_gles3.frag.glsl"}),
+    };
+#else
+    const fs::path vertexShaderPath(
+        "assets/shaders/fullscreen_gl4.vert.glsl");
+    return {
+        .occlusionShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/ssao_gl4.frag.glsl"}),
+        .blurShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/ssao_blur_gl4.frag.glsl"}),
+        .upsampleShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/ssao_upsample_gl4.frag.glsl"}),
+    };
+#endif
+}
+
+bool AmbientOcclusion::init(PendingShaders&& shaders)
+{
+    occlusionShader_ = shaders.occlusionShader.finish();
+    blurShader_ = shaders.blurShader.finish();
+    upsampleShader_ = shaders.upsampleShader.finish();
+    if (!occlusionShader_ || !blurShader_ || !upsampleShader_)
+    {
+        return false;
+    }
+    // View space positions are reconstructed with the projection of the
+    // per-frame uniforms of model shaders
+    for (Shader* shader : {&occlusionShader_.value(),
+                           &blurShader_.value(),
+                           &upsampleShader_.value()})
+    {
+        shader->bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    }
+    occlusionDepthUniform_ = occlusionShader_->getUniformHandle<int>("u_depth");
+    occlusionSceneWidthUniform_
+        = occlusionShader_->getUniformHandle<int>("u_sceneWidth");
+    occlusionSceneHeightUniform_
+        = occlusionShader_->getUniformHandle<int>("u_sceneHeight");
+    blurDepthUniform_ = blurShader_->getUniformHandle<int>("u_depth");
+    blurSourceUniform_ = blurShader_->getUniformHandle<int>("u_occlusion");
+    blurSceneWidthUniform_
+        = blurShader_->getUniformHandle<int>("u_sceneWidth");
+    blurSceneHeightUniform_
+        = blurShader_->getUniformHandle<int>("u_sceneHeight");
+    blurHorizontalUniform_
+        = blurShader_->getUniformHandle<bool>("u_horizontal");
+    upsampleDepthUniform_ = upsampleShader_->getUniformHandle<int>("u_depth");
+    upsampleSourceUniform_
+        = upsampleShader_->getUniformHandle<int>("u_occlusion");
+    upsampleSceneWidthUniform_
+        = upsampleShader_->getUniformHandle<int>("u_sceneWidth");
+    upsampleSceneHeightUniform_
+        = upsampleShader_->getUniformHandle<int>("u_sceneHeight");
+    return true;
+}
+
+bool AmbientOcclusion::resize(int width, int height)
+{
+    if (width == width_ && height == height_)
+    {
+        return true;
+    }
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    width_ = width;
+    height_ = height;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize());
+
+    // Texture storage is mutable, so the texture is resized in place. Every
+    // pass fetches exact texels.
+    if (!upsampledTarget_.texture)
+    {
+        glGenTextures(1, &upsampledTarget_.texture);
+        glGenFramebuffers(1, &upsampledTarget_.framebuffer);
+    }
+    glBindTexture(GL_TEXTURE_2D, upsampledTarget_.texture);
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_R8,
+                 width,
+                 height,
+                 0,
+                 GL_RED,
+                 GL_UNSIGNED_BYTE,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, upsampledTarget_.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           upsampledTarget_.texture,
+                           0);
+    const bool complete
+        = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+glm::ivec2 AmbientOcclusion::getOcclusionSize(glm::ivec2 size)
+{
+    return glm::ivec2{getHalfSize(size.x), getHalfSize(size.y)};
+}
+
+void AmbientOcclusion::copyDepth(const FrameGraph::Target& depth,
+                                 glm::ivec2 sceneSize)
+{
+    // Depth renderbuffer of the bound framebuffer can not be sampled, so it
+    // is copied into a depth texture first. Copying depth with
+    // glCopyTexSubImage2D() is not supported in OpenGL ES 3.0, blitting is.
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth.framebuffer);
+    glBlitFramebuffer(0,
+                      0,
+                      sceneSize.x,
+                      sceneSize.y,
+                      0,
+                      0,
+                      sceneSize.x,
+                      sceneSize.y,
+                      GL_DEPTH_BUFFER_BIT,
+                      GL_NEAREST);
+}
+
+void AmbientOcclusion::drawOcclusion(GLuint depthTexture,
+                                     const FrameGraph::Target& destination,
+                                     glm::ivec2 sceneSize,
+                                     GLuint emptyVertexArray,
+                                     GlStateCache& glState)
+{
+    beginPass(depthTexture, emptyVertexArray, glState);
+    occlusionShader_->use(glState);
+    occlusionShader_->setUniform(occlusionDepthUniform_,
+                                 static_cast<int>(DEPTH_TEXTURE_UNIT));
+    occlusionShader_->setUniform(occlusionSceneWidthUniform_, sceneSize.x);
+    occlusionShader_->setUniform(occlusionSceneHeightUniform_, sceneSize.y);
+    drawPass(destination.framebuffer, getOcclusionSize(sceneSize));
+}
+
+void AmbientOcclusion::blur(GLuint depthTexture,
+                            GLuint sourceTexture,
+                            const FrameGraph::Target& destination,
+                            bool horizontal,
+                            glm::ivec2 sceneSize,
+                            GLuint emptyVertexArray,
+                            GlStateCache& glState)
+{
+    beginPass(depthTexture, emptyVertexArray, glState);
+    blurShader_->use(glState);
+    blurShader_->setUniform(blurDepthUniform_,
+                            static_cast<int>(DEPTH_TEXTURE_UNIT));
+    blurShader_->setUniform(blurSourceUniform_,
+                            static_cast<int>(TEXTURE_UNIT));
+    blurShader_->setUniform(blurSceneWidthUniform_, sceneSize.x);
+    blurShader_->setUniform(blurSceneHeightUniform_, sceneSize.y);
+    blurShader_->setUniform(blurHorizontalUniform_, horizontal);
+    glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, sourceTexture);
+    drawPass(destination.framebuffer, getOcclusionSize(sceneSize));
+}
+
+void AmbientOcclusion::upsample(GLuint depthTexture,
+                                GLuint sourceTexture,
+                                glm::ivec2 sceneSize,
+                                GLuint emptyVertexArray,
+                                GlStateCache& glState)
+{
+    beginPass(depthTexture, emptyVertexArray, glState);
+    upsampleShader_->use(glState);
+    upsampleShader_->setUniform(upsampleDepthUniform_,
+                                static_cast<int>(DEPTH_TEXTURE_UNIT));
+    upsampleShader_->setUniform(upsampleSourceUniform_,
+                                static_cast<int>(TEXTURE_UNIT));
+    upsampleShader_->setUniform(upsampleSceneWidthUniform_, sceneSize.x);
+    upsampleShader_->setUniform(upsampleSceneHeightUniform_, sceneSize.y);
+    glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, sourceTexture);
+    drawPass(upsampledTarget_.framebuffer, sceneSize);
+
+    glState.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, upsampledTarget_.texture);
+}
+
+void AmbientOcclusion::beginPass(GLuint depthTexture,
+                                 GLuint emptyVertexArray,
+                                 GlStateCache& glState)
+{
+    // Targets have no depth attachment, so depth test passes everywhere.
+    // Occlusion replaces the contents of targets instead of blending.
+    glState.setColorWriteEnabled(true);
+    glState.setBlendEnabled(false);
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+}
+
+void AmbientOcclusion::drawPass(GLuint framebuffer, glm::ivec2 size)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, size.x, size.y);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+size_t AmbientOcclusion::videoMemorySize() const
+{
+    return static_cast<size_t>(width_) * static_cast<size_t>(height_)
+         * OCCLUSION_TEXEL_SIZE;
+}
@@ -0,0 +1,152 @@
+#ifndef AMBIENT_OCCLUSION_H_
+#define AMBIENT_OCCLUSION_H_
+
+#include "framegraph.h"
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/vec2.hpp"
+
+#include <cstddef>
+#include <optional>
+
+/// Screen-space ambient occlusion estimated from the depth buffer, darkening
+/// ambient light in creases and corners.
+///
+/// Occlusion is computed at half resolution, with normals reconstructed from
+/// neighboring depths instead of being drawn into a G-buffer. Noise of the
+/// few samples taken per pixel is removed by a separable blur, which skips
+/// samples across depth discontinuities, and the result is upsampled to full
+/// resolution weighing each half resolution pixel by how close its depth is
+/// to the full resolution one, so that occlusion does not bleed over edges.
+///
+/// All passes are fullscreen fragment shader passes, supported in OpenGL ES
+/// 3.0 as well, run as passes of the frame graph. Depth copy and half
+/// resolution occlusion only live within the passes and are transient
+/// textures of the graph, while the full resolution result is sampled by
+/// models for the rest of the frame and owned here. Like the scene
+/// framebuffer, textures are allocated at full window size and drawn into at
+/// their bottom-left corner.
+///
+/// Result is created on first resize. Non-copyable, non-movable.
+class AmbientOcclusion
+{
+public:
+    /// Texture unit occlusion is bound to while drawing models.
+    static constexpr GLuint TEXTURE_UNIT = 4;
+
+    /// Shaders of occlusion, blur and upsampling passes submitted for
+    /// compilation.
+    struct PendingShaders
+    {
+        PendingShader occlusionShader;
+        PendingShader blurShader;
+        PendingShader upsampleShader;
+    };
+
+    AmbientOcclusion();
+    AmbientOcclusion(const AmbientOcclusion&) = delete;
+    AmbientOcclusion& operator=(const AmbientOcclusion&) = delete;
+    AmbientOcclusion(AmbientOcclusion&&) = delete;
+    AmbientOcclusion& operator=(AmbientOcclusion&&) = delete;
+    ~AmbientOcclusion();
+
+    /// Submit shaders for compilation without waiting for the driver to
+    /// finish.
+    static PendingShaders submitShaders();
+
+    /// Finish compilation of submitted shaders.
+    bool init(PendingShaders&& shaders);
+
+    /// Recreate result when framebuffer size changes. Returns false when the
+    /// driver rejects its framebuffer.
+    bool resize(int width, int height);
+
+    [[nodiscard]] bool isCreated() const
+    {
+        return upsampledTarget_.texture != 0;
+    }
+    [[nodiscard]] GLuint texture() const { return upsampledTarget_.texture; }
+
+    /// Size of half resolution occlusion of scenes within framebuffer of
+    /// given size.
+    [[nodiscard]] static glm::ivec2 getOcclusionSize(glm::ivec2 size);
+
+    // Passes computing occlusion of the scene drawn into the bottom-left
+    // rectangle of given size. FrameData uniform block of the frame has to
+    // be bound, as positions are reconstructed with its projection.
+    // Framebuffer, viewport and blending are left changed for the caller to
+    // restore.
+
+    /// Copy depth of the framebuffer bound for reading into a depth texture.
+    void copyDepth(const FrameGraph::Target& depth, glm::ivec2 sceneSize);
+    /// Estimate noisy half resolution occlusion from the depth copy.
+    void drawOcclusion(GLuint depthTexture,
+                       const FrameGraph::Target& destination,
+                       glm::ivec2 sceneSize,
+                       GLuint emptyVertexArray,
+                       GlStateCache& glState);
+    /// Blur occlusion along one axis.
+    void blur(GLuint depthTexture,
+              GLuint sourceTexture,
+              const FrameGraph::Target& destination,
+              bool horizontal,
+              glm::ivec2 sceneSize,
+              GLuint emptyVertexArray,
+              GlStateCache& glState);
+    /// Upsample blurred occlusion into the full resolution result, leaving
+    /// it bound to TEXTURE_UNIT.
+    void upsample(GLuint depthTexture,
+                  GLuint sourceTexture,
+                  glm::ivec2 sceneSize,
+                  GLuint emptyVertexArray,
+                  GlStateCache& glState);
+
+private:
+    /// Single channel texture drawn into by a pass, with its framebuffer.
+    struct Target
+    {
+        GLuint texture;
+        GLuint framebuffer;
+    };
+
+    /// Set state shared by the passes, with the depth copy bound.
+    static void beginPass(GLuint depthTexture,
+                          GLuint emptyVertexArray,
+                          GlStateCache& glState);
+
+    /// Bind framebuffer and draw a fullscreen triangle covering given size
+    /// with the shader in use.
+    static void drawPass(GLuint framebuffer, glm::ivec2 size);
+
+    /// Video memory taken by textures in bytes.
+    [[nodiscard]] size_t videoMemorySize() const;
+
+    std::optional<Shader> occlusionShader_;
+    std::optional<Shader> blurShader_;
+    std::optional<Shader> upsampleShader_;
+    UniformHandle<int> occlusionDepthUniform_;
+    UniformHandle<int> occlusionSceneWidthUniform_;
+    UniformHandle<int> occlusionSceneHeightUniform_;
+    UniformHandle<int> blurDepthUniform_;
+    UniformHandle<int> blurSourceUniform_;
+    UniformHandle<int> blurSceneWidthUniform_;
+    UniformHandle<int> blurSceneHeightUniform_;
+    UniformHandle<bool> blurHorizontalUniform_;
+    UniformHandle<int> upsampleDepthUniform_;
+    UniformHandle<int> upsampleSourceUniform_;
+    UniformHandle<int> upsampleSceneWidthUniform_;
+    UniformHandle<int> upsampleSceneHeightUniform_;
+    /// Full resolution result sampled by model shaders.
+    Target upsampledTarget_;
+    int width_;
+    int height_;
+};
+
+#endif
@@ -1,10 +1,16 @@
 #include "app.h"
 
+#include "allocationtracker.h"
+#include "assetfs.h"
 #include "drawproperties.h"
 #include "gui.h"
+#include "profiler.h"
 #include "utils.h"
+#include "videomemory.h"
 
+#include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
 
 #ifdef __EMSCRIPTEN__
 #include "glad/gles2.h"
@@ -14,11 +20,16 @@
 #else
 #include "GLFW/glfw3.h"
 #include "glad/gl.h"
-
-#include <chrono>
 #endif
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
 
 namespace fs = std::filesystem;
 
@@ -27,31 +38,131 @@ namespace
 constexpr uint16_t SCREEN_WIDTH = 1024;
 constexpr uint16_t SCREEN_HEIGHT = 768;
 
-// This is the granularity of how often to update logic and not to be confused
-// with framerate limiting or 60 frames per second, because the main loop
-// implementation uses a fixed update, variable framerate timestep algorithm.
-//
-// 60 logic updates per second is a common value used in games.
-// - Higher update rate (120) can lead to smoother gameplay, more precise
-// control, at the cost of CPU load. Keep mobile devices in mind.
-// - Lower update rate (30) reduces CPU load, runs game logic less frequently,
-// but can make game less responsive.
-constexpr float MAX_LOGIC_UPDATE_PER_SECOND = 60.0F;
-constexpr float FIXED_UPDATE_TIMESTEP = 1.0F / MAX_LOGIC_UPDATE_PER_SECOND;
+// Order matches model selection items in GUI
+constexpr std::array<const char*, 3> MODEL_PATHS{"assets/meshes/cube.obj",
+                                                 "assets/meshes/teapot.obj",
+                                                 "assets/meshes/bunny.obj"};
+// Each directory holds the six cube-map faces of a skybox. Order matches skybox
+// selection items in GUI.
+constexpr std::array<const char*, 1> SKYBOX_DIRECTORIES{"assets/skybox"};
+/// Packed asset archive read instead of loose asset files when present.
+constexpr const char* ASSET_ARCHIVE_PATH = "assets.pak";
+constexpr size_t MEBIBYTE = 1024 * 1024;
+/// Frame allocator blocks start at this size and grow to fit heavier frames.
+constexpr size_t FRAME_ALLOCATOR_CAPACITY = 1 * MEBIBYTE;
+/// Frames drawn after the last change in on-demand rendering mode, so that UI
+/// hover and widget states settle before idling.
+constexpr int REDRAW_FRAME_COUNT = 3;
+#ifndef __EMSCRIPTEN__
+/// Seconds slept at most while idling in on-demand rendering mode, before
+/// checking for changed shader sources.
+constexpr double IDLE_WAKE_INTERVAL = 0.25;
+/// Swap intervals of vertical synchronization modes. Negative interval is
+/// adaptive vsync, tearing frames that missed the refresh instead of waiting
+/// for the next one. Order matches vsync mode items in GUI.
+constexpr std::array<int, 3> SWAP_INTERVALS{0, 1, -1};
+/// Frames the GPU may be working on when starting a new one in low latency
+/// mode. A single one keeps the GPU busy with the previous frame while the
+/// CPU builds the next, without input waiting in a queue of frames.
+constexpr size_t LOW_LATENCY_FRAMES_IN_FLIGHT = 1;
+/// Seconds slept at most while waiting for thumbnail models to load or be
+/// read back.
+constexpr double THUMBNAIL_IDLE_INTERVAL = 0.001;
+#endif
 }  // namespace
 
 App::App()
     : window_{nullptr}
-    , renderer_(drawProps_, camera_)
+    , frameAllocator_(FRAME_ALLOCATOR_CAPACITY)
+    , renderer_(renderProps_, camera_, threadPool_, frameAllocator_)
     // Positioning and rotation accidentally imitates a right-handed 3D
     // coordinate system with positive Z going farther from model, but this
     // setting is done because of initial orientation of the loaded Stanford
     // Bunny mesh.
     , camera_({1.7F, 1.3F, 4.0F}, {240.0F, -15.0F})
     , drawProps_(DrawProperties::createDefault())
+    , drawnProps_(drawProps_)
+    , renderProps_(drawProps_)
+    , redrawFrameCount_{REDRAW_FRAME_COUNT}
+#ifndef __EMSCRIPTEN__
+    , appliedVsyncModeIndex_{-1}
+#endif
     , lastMousePos_{static_cast<float>(SCREEN_WIDTH) / 2.0F,
                     static_cast<float>(SCREEN_HEIGHT) / 2.0F}
+    , sampledInput_{.forward = false,
+                    .backward = false,
+                    .left = false,
+                    .right = false,
+                    .up = false,
+                    .down = false,
+                    .lookOffset = glm::vec2{0.0F}}
+    , simulation_(camera_)
+    , skyboxCache_(static_cast<size_t>(drawProps_.skyboxCacheBudget)
+                   * MEBIBYTE)
+    , pendingSkyboxIndex_{0}
+    , displayedSkyboxIndex_{0}
+    , modelResidency_(static_cast<size_t>(drawProps_.modelResidencyBudget)
+                      * MEBIBYTE)
+#ifdef __EMSCRIPTEN__
+    , modelLoader_(threadPool_, ImportOptions::createDefault())
+#else
+    , uploadContext_(threadPool_)
+    // Loaded models are appended to geometry arena for indirect draws
+    , modelLoader_(threadPool_,
+                   ImportOptions::createDefault(),
+                   &renderer_.geometryArena(),
+                   &renderer_.clusterStreamer(),
+                   &uploadContext_)
+#endif
+#ifndef __EMSCRIPTEN__
+    , outputWindowEnabled_{false}
+#endif
+    , sceneRoot_{0}
+    , firstModelEntity_{0}
+    , modelEntityCount_{0}
+    , shadowCasterModel_{nullptr}
+    , shadowCasterModelGeneration_{0}
+    , previousSceneGeneration_{0}
+    , pointLightGridSize_{0}
+    , pointLightSpacing_{0.0F}
+{
+}
+
+#ifndef __EMSCRIPTEN__
+void App::enableBenchmark(Benchmark::Options options)
 {
+    benchmark_.emplace(std::move(options));
+}
+
+void App::enableRecording(fs::path filePath)
+{
+    recordingPath_ = std::move(filePath);
+}
+
+void App::enableReplay(Recording recording)
+{
+    replay_.emplace(std::move(recording));
+}
+
+void App::enableThumbnails(ThumbnailBatch::Options options)
+{
+    thumbnailBatch_.emplace(std::move(options), threadPool_);
+}
+
+void App::enableStreaming(StreamServer::Options options)
+{
+    streamServer_.emplace(std::move(options));
+}
+
+void App::enableOutputWindow()
+{
+    outputWindowEnabled_ = true;
+}
+#endif
+
+void App::loadPointCloud(fs::path filePath)
+{
+    pointCloudPath_ = std::move(filePath);
 }
 
 bool App::init()
@@ -65,6 +176,15 @@ bool App::init()
           "OpenGL 4.3";
 #endif
 
+    // Archive is mounted before any asset is read. Errors are reported by
+    // mount().
+    std::error_code error;
+    if (fs::exists(ASSET_ARCHIVE_PATH, error)
+        && !assetfs::mount(ASSET_ARCHIVE_PATH))
+    {
+        return false;
+    }
+
     // Initialize windowing system
     if (!glfwInit())
     {
@@ -73,6 +193,7 @@ bool App::init()
         return false;
     }
     glfwSetErrorCallback(errorCallback);
+    startupTimer_.finishPhase(StartupPhase::WindowingSystem);
 
     // Create window
 #ifdef __EMSCRIPTEN__
@@ -87,8 +208,55 @@ bool App::init()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-    // TODO: Make window and OpenGL framebuffer resizable
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+#ifndef __EMSCRIPTEN__
+    if (benchmark_)
+    {
+        const Benchmark::Options& options = benchmark_->options();
+        if (options.modelIndex >= MODEL_PATHS.size())
+        {
+            utils::showErrorMessage("benchmark model index out of range: ",
+                                    options.modelIndex);
+            return false;
+        }
+        // Frames are drawn as fast as the renderer allows, at the same
+        // resolution on every run
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        drawProps_.selectedModelIndex = static_cast<int>(options.modelIndex);
+        drawProps_.instanceGridSize = std::max(options.instanceGridSize, 1);
+        drawProps_.dynamicResolutionEnabled = false;
+        drawProps_.qualityGovernorEnabled = false;
+        drawProps_.onDemandRenderingEnabled = false;
+        drawProps_.vsyncModeIndex = 0;
+        drawProps_.frameCapEnabled = false;
+        drawProps_.lowLatencyEnabled = false;
+    }
+    if (thumbnailBatch_)
+    {
+        // Thumbnails are drawn offscreen at full resolution, the window only
+        // provides the graphics context
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        drawProps_.dynamicResolutionEnabled = false;
+        drawProps_.qualityGovernorEnabled = false;
+        drawProps_.resolutionScale = 1.0F;
+        drawProps_.lowLatencyEnabled = false;
+    }
+    if (streamServer_)
+    {
+        // Frames are drawn continuously at a fixed resolution matching the
+        // encoded video, sampling input as late as possible
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        drawProps_.dynamicResolutionEnabled = false;
+        drawProps_.qualityGovernorEnabled = false;
+        drawProps_.resolutionScale = 1.0F;
+        drawProps_.onDemandRenderingEnabled = false;
+        drawProps_.vsyncModeIndex = 0;
+        drawProps_.lowLatencyEnabled = true;
+    }
+#endif
     window_ = glfwCreateWindow(SCREEN_WIDTH,
                                SCREEN_HEIGHT,
                                "3D renderer by Bálint Kiss",
@@ -105,60 +273,168 @@ bool App::init()
     glfwSetWindowUserPointer(window_, this);
     glfwSetMouseButtonCallback(window_, mouseButtonCallback);
     glfwSetCursorPosCallback(window_, mouseMoveCallback);
+    glfwSetFramebufferSizeCallback(window_, frameBufferSizeCallback);
+    glfwSetKeyCallback(window_, keyCallback);
+    glfwSetScrollCallback(window_, scrollCallback);
+    glfwSetWindowRefreshCallback(window_, windowRefreshCallback);
+#ifndef __EMSCRIPTEN__
+    // Mouse look reads unaccelerated, unscaled motion of the device while the
+    // cursor is disabled, where the platform reports it
+    if (glfwRawMouseMotionSupported())
+    {
+        glfwSetInputMode(window_, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+    }
+#endif
     glfwMakeContextCurrent(window_);
+    startupTimer_.finishPhase(StartupPhase::Window);
 
     // Init GUI
     Gui::init(window_);
+#ifndef __EMSCRIPTEN__
+    // Remote client sees the scene only
+    if (streamServer_)
+    {
+        Gui::toggleVisible();
+    }
+#endif
+    startupTimer_.finishPhase(StartupPhase::Gui);
 
-    // Init renderer
+    // Init renderer with properties overridden by command line options
+    renderProps_ = drawProps_;
     if (!renderer_.init(window_))
     {
         utils::showErrorMessage("unable to initialize renderer. ",
                                 gpuRequirementsMessage);
         return false;
     }
+    startupTimer_.finishPhase(StartupPhase::Renderer);
+#ifndef __EMSCRIPTEN__
+    // Models are uploaded on the main thread when it fails, which is reported
+    uploadContext_.start(window_);
+    // Scene is still shown in the main window when it fails, which is
+    // reported
+    if (outputWindowEnabled_)
+    {
+        outputWindow_.start(window_);
+    }
+#endif
 
     // Load resources
-    std::optional<Skybox> skybox = SkyboxBuilder()
-                                       .setRight("assets/skybox/right.jpg")
-                                       .setLeft("assets/skybox/left.jpg")
-                                       .setTop("assets/skybox/top.jpg")
-                                       .setBottom("assets/skybox/bottom.jpg")
-                                       .setFront("assets/skybox/front.jpg")
-                                       .setBack("assets/skybox/back.jpg")
-                                       .build();
+    // Initial skybox is waited for, later selections are loaded in the
+    // background
+    displayedSkyboxIndex_
+        = static_cast<size_t>(drawProps_.selectedSkyboxIndex);
+    std::optional<Skybox> skybox
+        = createSkyboxBuilder(displayedSkyboxIndex_).build(threadPool_);
     if (!skybox)
     {
         utils::showErrorMessage("unable to create skybox for application");
         return false;
     }
-    skybox_ = std::move(skybox.value());
+    skyboxCache_.insert(displayedSkyboxIndex_, std::move(skybox.value()));
+    startupTimer_.finishPhase(StartupPhase::Skybox);
 
-    const std::array<fs::path, 3> modelPaths{"assets/meshes/cube.obj",
-                                             "assets/meshes/teapot.obj",
-                                             "assets/meshes/bunny.obj"};
-    for (const auto& path : modelPaths)
+    // Models are streamed in on background threads, while a built-in
+    // placeholder stands in for each of them until it arrives. This lets the
+    // window show the first frame right away instead of waiting for every
+    // model file to be parsed. Only the selected model is requested, others
+    // are loaded once picked, so that startup does not pay for models never
+    // looked at.
+    placeholderModel_ = Model::createPlaceholder();
+    models_.resize(MODEL_PATHS.size());
+    requestedModels_.resize(MODEL_PATHS.size(), false);
+    evictedModels_.resize(MODEL_PATHS.size(), false);
+#ifndef __EMSCRIPTEN__
+    // Requests decide on streaming by the budget
+    renderer_.clusterStreamer().setBudget(
+        static_cast<size_t>(drawProps_.clusterStreamingBudget) * MEBIBYTE);
+    // Replayed properties may switch to any model, which would show the
+    // placeholder in the middle of measurements
+    if (replay_)
     {
-        std::optional<Model> model = Model::create(path);
-        if (!model)
+        for (size_t i = 0; i < MODEL_PATHS.size(); ++i)
         {
-            utils::showErrorMessage("unable to create model from path ", path);
-            return false;
+            requestModel(i);
         }
-        models_.emplace_back(std::move(model.value()));
     }
+    // Thumbnail batch loads its own models instead
+    if (!thumbnailBatch_)
+#endif
+    {
+        requestSelectedModel();
+    }
+    if (pointCloudPath_)
+    {
+        // Errors are reported by load()
+        pendingPointCloud_ = threadPool_.submit(
+            [path = pointCloudPath_.value()]
+            { return PointCloud::load(path); });
+    }
+
+    // Shaders were compiling in the driver while resources were loaded
+    if (!renderer_.finishInit())
+    {
+        utils::showErrorMessage("unable to initialize renderer. ",
+                                gpuRequirementsMessage);
+        return false;
+    }
+    startupTimer_.finishPhase(StartupPhase::Shaders);
+#ifndef __EMSCRIPTEN__
+    // Errors are reported by start()
+    if (thumbnailBatch_ && !thumbnailBatch_->start())
+    {
+        return false;
+    }
+    if (streamServer_ && !streamServer_->start())
+    {
+        return false;
+    }
+    if (recordingPath_)
+    {
+        recording_.emplace(drawProps_);
+        simulation_.enableRecording();
+    }
+#endif
+    simulation_.start();
+#ifndef __EMSCRIPTEN__
+    // Application is usable without hot reload, so failure is not fatal
+    if (!shaderWatcher_.start("assets/shaders"))
+    {
+        utils::logWarning("unable to watch shader sources, changes to them "
+                          "are not reloaded");
+    }
+#endif
 
     return true;
 }
 
 void App::cleanup()
 {
+#ifndef __EMSCRIPTEN__
+    if (recording_)
+    {
+        // Errors are reported by save()
+        recordSteps();
+        recording_->save(recordingPath_.value());
+    }
+    // Buffers of readbacks are deleted while the graphics context is alive
+    thumbnailBatch_.reset();
+    // Frames still being read back are saved as well
+    frameCapture_.finish();
+    if (streamServer_)
+    {
+        streamServer_->finish();
+        streamServer_.reset();
+    }
+    outputWindow_.stop();
+    uploadContext_.stop();
+#endif
     Gui::cleanup();
     glfwDestroyWindow(window_);
     glfwTerminate();
 }
 
-void App::run()
+bool App::run()
 {
 #ifdef __EMSCRIPTEN__
     // Web build main loop does not rely on a timestep algorithm or passing
@@ -168,37 +444,32 @@ void App::run()
     // to remain responsive to user interactions.
     emscripten_set_main_loop_arg(emscriptenMainLoopCallback, this, 0, 1);
 #else
-    // Frame-rate independent loop with fixed update, variable framerate.
-    //
-    // A naive calculation and passing of a deltaTime introduces floating point
-    // precision errors, leading to choppy camera movement and unstable logic
-    // even on high framerate. Here, think of it as renderer dictating time, and
-    // logic update adapting to it.
-    //
-    // Prefer steady_clock over high_resolution_clock, because
-    // high_resolution_clock could lie.
-    auto previousTime = std::chrono::steady_clock::now();
-    // How much application "clock" is behind real time. Also known as
-    // "accumulator"
-    float lag = 0.0F;
+    if (thumbnailBatch_)
+    {
+        return runThumbnailBatch();
+    }
+    // Variable framerate loop. Logic is updated with a fixed timestep on the
+    // simulation thread, rendering interpolates between its steps.
     while (!glfwWindowShouldClose(window_))
     {
-        const auto currentTime = std::chrono::steady_clock::now();
-        const float elapsedTime
-            = std::chrono::duration<float>(currentTime - previousTime).count();
-        previousTime = currentTime;
-        lag += elapsedTime;
-
+        if (drawProps_.onDemandRenderingEnabled && redrawFrameCount_ == 0)
+        {
+            // Sleep until input arrives, waking up periodically to pick up
+            // changed shader sources
+            glfwWaitEventsTimeout(IDLE_WAKE_INTERVAL);
+            // Time spent idle is not counted as frame time
+            framePacer_.restart();
+            qualityGovernor_.restart();
+        }
         handleInput();
-
-        while (lag >= FIXED_UPDATE_TIMESTEP)
+        if (outputWindow_.isCloseRequested())
         {
-            lag -= FIXED_UPDATE_TIMESTEP;
+            outputWindow_.stop();
         }
-
         render();
     }
 #endif
+    return true;
 }
 
 void App::errorCallback([[maybe_unused]] int error, const char* description)
@@ -220,6 +491,17 @@ void App::mouseButtonCallback(GLFWwindow* window,
                               int action,
                               [[maybe_unused]] int mods)
 {
+    auto* impl = static_cast<App*>(glfwGetWindowUserPointer(window));
+    impl->requestRedraw();
+#ifndef __EMSCRIPTEN__
+    // Object under the cursor was picked while drawing recent frames. Clicks
+    // on UI are left for the UI.
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS
+        && impl->drawProps_.pickingEnabled && !Gui::isCapturingMouse())
+    {
+        impl->drawProps_.selectedObjectId = impl->renderer_.pickedObjectId();
+    }
+#endif
     if (button == GLFW_MOUSE_BUTTON_RIGHT)
     {
         // Initiate mouse look on right mouse button press
@@ -257,6 +539,8 @@ void App::mouseMoveCallback(GLFWwindow* window,
         static_cast<float>(currentMousePosY),
     };
     auto* impl = static_cast<App*>(glfwGetWindowUserPointer(window));
+    // UI reacts to hovering as well
+    impl->requestRedraw();
     glm::vec2& lastMousePos = impl->lastMousePos_;
     if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_RELEASE)
     {
@@ -273,11 +557,79 @@ void App::mouseMoveCallback(GLFWwindow* window,
     lastMousePos.x = currentMousePosFloat.x;
     lastMousePos.y = currentMousePosFloat.y;
 
-    impl->camera_.look(xOffset, yOffset);
+    // Applied by the simulation step following the movement
+    impl->sampleInput(glm::vec2{xOffset, yOffset});
+}
+
+void App::frameBufferSizeCallback(GLFWwindow* window, int width, int height)
+{
+    auto* impl = static_cast<App*>(glfwGetWindowUserPointer(window));
+    impl->renderer_.resize(width, height);
+    impl->requestRedraw();
+}
+
+void App::keyCallback(GLFWwindow* window,
+                      int key,
+                      [[maybe_unused]] int scancode,
+                      int action,
+                      [[maybe_unused]] int mods)
+{
+    auto* impl = static_cast<App*>(glfwGetWindowUserPointer(window));
+    impl->requestRedraw();
+    // Movement keys are tracked by their events instead of polled once per
+    // frame, so that keys pressed and released between frames still move
+    const std::array<std::pair<int, bool*>, 6> movementKeys{{
+        {GLFW_KEY_W, &impl->sampledInput_.forward},
+        {GLFW_KEY_S, &impl->sampledInput_.backward},
+        {GLFW_KEY_A, &impl->sampledInput_.left},
+        {GLFW_KEY_D, &impl->sampledInput_.right},
+        {GLFW_KEY_SPACE, &impl->sampledInput_.up},
+        {GLFW_KEY_C, &impl->sampledInput_.down},
+    }};
+    for (const auto& [movementKey, held] : movementKeys)
+    {
+        if (key == movementKey && action != GLFW_REPEAT)
+        {
+            *held = action == GLFW_PRESS;
+            impl->sampleInput(glm::vec2{0.0F});
+        }
+    }
+    if (action != GLFW_PRESS)
+    {
+        return;
+    }
+    if (key == GLFW_KEY_H)
+    {
+        Gui::toggleVisible();
+    }
+#ifndef __EMSCRIPTEN__
+    else if (key == GLFW_KEY_F12)
+    {
+        impl->frameCapture_.requestScreenshot();
+    }
+    else if (key == GLFW_KEY_F9)
+    {
+        impl->frameCapture_.toggleRecording();
+    }
+#endif
+}
+
+void App::scrollCallback(GLFWwindow* window,
+                         [[maybe_unused]] double offsetX,
+                         [[maybe_unused]] double offsetY)
+{
+    static_cast<App*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+void App::windowRefreshCallback(GLFWwindow* window)
+{
+    // Window contents were damaged, e.g. by being uncovered
+    static_cast<App*>(glfwGetWindowUserPointer(window))->requestRedraw();
 }
 
 void App::handleInput()
 {
+    PROFILE_SCOPE("App::handleInput");
     glfwPollEvents();
 
 #ifndef __EMSCRIPTEN__
@@ -288,45 +640,780 @@ void App::handleInput()
     }
 #endif
 
-    if (glfwGetKey(window_, GLFW_KEY_W) == GLFW_PRESS)
+#ifndef __EMSCRIPTEN__
+    if (streamServer_)
     {
-        camera_.moveForward(FIXED_UPDATE_TIMESTEP);
+        if (streamServer_->isFinished())
+        {
+            glfwSetWindowShouldClose(window_, true);
+        }
+        // Remote input arrives as held keys and movement since the previous
+        // frame
+        const Simulation::Input input = streamServer_->takeInput();
+        inputEvents_.clear();
+        sampledInput_ = input;
+        sampledInput_.lookOffset = glm::vec2{0.0F};
+        sampleInput(input.lookOffset);
     }
-    if (glfwGetKey(window_, GLFW_KEY_S) == GLFW_PRESS)
+#endif
+    // Held keys do not send events, so moving camera keeps frames coming
+    if (sampledInput_.isActive() || !inputEvents_.empty())
     {
-        camera_.moveBackward(FIXED_UPDATE_TIMESTEP);
+        requestRedraw();
     }
-    if (glfwGetKey(window_, GLFW_KEY_A) == GLFW_PRESS)
+    simulation_.submitInput(inputEvents_);
+    inputEvents_.clear();
+    simulation_.update();
+}
+
+void App::sampleInput(glm::vec2 lookOffset)
+{
+    Simulation::InputEvent& event = inputEvents_.emplace_back(
+        Simulation::InputEvent{.input = sampledInput_,
+                               .time = std::chrono::steady_clock::now()});
+    event.input.lookOffset = lookOffset;
+}
+
+void App::latchInput()
+{
+    PROFILE_SCOPE("App::latchInput");
+#ifndef __EMSCRIPTEN__
+    // GPU is waited for first, so that input is sampled as close as possible
+    // to the GPU starting on the frame
+    renderer_.limitFramesInFlight(LOW_LATENCY_FRAMES_IN_FLIGHT);
+    if (benchmark_ || replay_ || streamServer_)
     {
-        camera_.strafeLeft(FIXED_UPDATE_TIMESTEP);
+        return;
     }
-    if (glfwGetKey(window_, GLFW_KEY_D) == GLFW_PRESS)
+#endif
+    // Mouse movement since handleInput() only turns the rendered camera until
+    // it is submitted to simulation with the next input
+    glfwPollEvents();
+    glm::vec2 lookOffset{0.0F};
+    for (const Simulation::InputEvent& event : inputEvents_)
     {
-        camera_.strafeRight(FIXED_UPDATE_TIMESTEP);
+        lookOffset += event.input.lookOffset;
     }
+    camera_ = simulation_.latchLook(camera_, lookOffset);
+}
 
-    if (glfwGetKey(window_, GLFW_KEY_SPACE) == GLFW_PRESS)
+#ifndef __EMSCRIPTEN__
+void App::updateSwapInterval()
+{
+    if (drawProps_.vsyncModeIndex == appliedVsyncModeIndex_)
+    {
+        return;
+    }
+    int swapInterval = SWAP_INTERVALS[drawProps_.vsyncModeIndex];
+    if (swapInterval < 0
+        && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+        && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+    {
+        utils::logWarning("adaptive vsync is not supported, falling back to "
+                          "vsync");
+        swapInterval = 1;
+    }
+    glfwSwapInterval(swapInterval);
+    appliedVsyncModeIndex_ = drawProps_.vsyncModeIndex;
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+void App::pickUnderCursor()
+{
+    int windowWidth = 0;
+    int windowHeight = 0;
+    glfwGetWindowSize(window_, &windowWidth, &windowHeight);
+    if (lastMousePos_.x < 0.0F || lastMousePos_.y < 0.0F
+        || lastMousePos_.x >= static_cast<float>(windowWidth)
+        || lastMousePos_.y >= static_cast<float>(windowHeight))
+    {
+        return;
+    }
+    // Cursor position is in screen coordinates with origin at the top-left
+    // corner, which differ from framebuffer pixels on high DPI displays
+    int frameBufferWidth = 0;
+    int frameBufferHeight = 0;
+    glfwGetFramebufferSize(window_, &frameBufferWidth, &frameBufferHeight);
+    const glm::vec2 scale{
+        static_cast<float>(frameBufferWidth) / static_cast<float>(windowWidth),
+        static_cast<float>(frameBufferHeight)
+            / static_cast<float>(windowHeight),
+    };
+    renderer_.requestPick(glm::ivec2{
+        static_cast<int>(lastMousePos_.x * scale.x),
+        static_cast<int>((static_cast<float>(windowHeight) - lastMousePos_.y)
+                         * scale.y),
+    });
+}
+#endif
+
+void App::requestRedraw()
+{
+    redrawFrameCount_ = REDRAW_FRAME_COUNT;
+    // Input and changed values may change the UI as well
+    Gui::requestRefresh();
+}
+
+SkyboxBuilder App::createSkyboxBuilder(size_t skyboxIndex)
+{
+    const fs::path directory{SKYBOX_DIRECTORIES[skyboxIndex]};
+    // High dynamic range faces are preferred when the skybox has them
+    const char* extension
+        = assetfs::exists(directory / "right.hdr") ? ".hdr" : ".jpg";
+    const auto facePath = [&](const char* face)
+    { return directory / (std::string{face} + extension); };
+    SkyboxBuilder skyboxBuilder;
+    skyboxBuilder.setRight(facePath("right"))
+        .setLeft(facePath("left"))
+        .setTop(facePath("top"))
+        .setBottom(facePath("bottom"))
+        .setFront(facePath("front"))
+        .setBack(facePath("back"));
+#ifndef __EMSCRIPTEN__
+    skyboxBuilder.setUploadBuffer(renderer_.pixelUploadBuffer());
+#endif
+    return skyboxBuilder;
+}
+
+void App::updateSkybox()
+{
+    skyboxCache_.setVideoMemoryBudget(
+        static_cast<size_t>(drawProps_.skyboxCacheBudget) * MEBIBYTE);
+
+    if (pendingSkybox_ && pendingSkybox_->isReady())
     {
-        camera_.ascend(FIXED_UPDATE_TIMESTEP);
+        // Errors are reported by finish()
+        std::optional<Skybox> skybox = pendingSkybox_->finish();
+        pendingSkybox_.reset();
+        if (skybox)
+        {
+            skyboxCache_.insert(pendingSkyboxIndex_, std::move(skybox.value()));
+        }
+        else if (static_cast<int>(pendingSkyboxIndex_)
+                 == drawProps_.selectedSkyboxIndex)
+        {
+            // Fall back to the skybox on display instead of retrying
+            drawProps_.selectedSkyboxIndex
+                = static_cast<int>(displayedSkyboxIndex_);
+        }
+    }
+
+    const auto selectedIndex
+        = static_cast<size_t>(drawProps_.selectedSkyboxIndex);
+    if (skyboxCache_.find(selectedIndex))
+    {
+        displayedSkyboxIndex_ = selectedIndex;
+        return;
     }
-    if (glfwGetKey(window_, GLFW_KEY_C) == GLFW_PRESS)
+    // A single skybox is loaded at a time, selection changed in the meantime
+    // is loaded afterwards
+    if (!pendingSkybox_)
     {
-        camera_.descend(FIXED_UPDATE_TIMESTEP);
+        pendingSkybox_ = createSkyboxBuilder(selectedIndex).submit(threadPool_);
+        pendingSkyboxIndex_ = selectedIndex;
     }
 }
 
+void App::requestModel(size_t modelIndex)
+{
+    // Failed models are not requested again, placeholder keeps showing
+    if (requestedModels_[modelIndex])
+    {
+        return;
+    }
+    requestedModels_[modelIndex] = true;
+    modelLoader_.request(modelIndex, MODEL_PATHS[modelIndex]);
+}
+
+void App::requestSelectedModel()
+{
+    const auto selectedIndex
+        = static_cast<size_t>(drawProps_.selectedModelIndex);
+#ifndef __EMSCRIPTEN__
+    if (benchmark_ && !benchmark_->drawsModel())
+    {
+        return;
+    }
+#endif
+    requestModel(selectedIndex);
+#ifndef __EMSCRIPTEN__
+    // Loading in the background would disturb measurements
+    if (benchmark_)
+    {
+        return;
+    }
+#endif
+    // Model following the selected one in the combo box is likely picked
+    // next. It is prefetched once the selected one arrived and nothing else
+    // is loading, so that it does not delay the model being looked at.
+    const size_t nextIndex = (selectedIndex + 1) % MODEL_PATHS.size();
+    if (models_[selectedIndex] && !modelLoader_.hasPendingRequests()
+        && !evictedModels_[nextIndex])
+    {
+        requestModel(nextIndex);
+    }
+}
+
+void App::receiveLoadedModels()
+{
+    while (std::optional<ModelLoader::Result> result = modelLoader_.poll())
+    {
+        if (!result->model)
+        {
+            // Keep showing placeholder instead of aborting application
+            utils::showErrorMessage("unable to create model from path ",
+                                    result->path);
+            continue;
+        }
+        models_[result->id] = std::move(result->model);
+        // Baked before residency accounting, which includes the atlas
+        renderer_.bakeImpostor(models_[result->id].value());
+        modelResidency_.insert(result->id,
+                               models_[result->id]->videoMemorySize());
+        // Model may be stored where the shadow caster was
+        ++shadowCasterModelGeneration_;
+    }
+    if (!modelLoader_.hasPendingRequests())
+    {
+        startupTimer_.finishModelLoading();
+    }
+}
+
+void App::evictIdleModels()
+{
+    modelResidency_.setVideoMemoryBudget(
+        static_cast<size_t>(drawProps_.modelResidencyBudget) * MEBIBYTE);
+    modelResidency_.beginFrame();
+    modelResidency_.markUsed(
+        static_cast<size_t>(drawProps_.selectedModelIndex));
+#ifndef __EMSCRIPTEN__
+    // Replays switch between models requested upfront
+    if (benchmark_)
+    {
+        return;
+    }
+#endif
+    while (const std::optional<size_t> modelIndex
+           = modelResidency_.takeEvicted())
+    {
+        models_[modelIndex.value()].reset();
+        requestedModels_[modelIndex.value()] = false;
+        evictedModels_[modelIndex.value()] = true;
+        // Model may be stored where the shadow caster was
+        ++shadowCasterModelGeneration_;
+    }
+}
+
+void App::receiveLoadedPointCloud()
+{
+    if (!pendingPointCloud_.valid()
+        || pendingPointCloud_.wait_for(std::chrono::seconds{0})
+               != std::future_status::ready)
+    {
+        return;
+    }
+    // Models are kept showing when the file could not be read
+    const std::optional<PointCloudData> data = pendingPointCloud_.get();
+    if (data)
+    {
+        pointCloud_ = PointCloud::create(data.value());
+    }
+}
+
+void App::updateScene()
+{
+    // Entities are only recreated when grid size changes, otherwise applying
+    // unchanged transforms leaves them clean
+    const auto gridSize = static_cast<size_t>(drawProps_.instanceGridSize);
+    if (modelEntityCount_ != gridSize * gridSize)
+    {
+        scene_.clear();
+        sceneRoot_ = scene_.createEntity();
+        firstModelEntity_ = sceneRoot_ + 1;
+        modelEntityCount_ = gridSize * gridSize;
+        for (size_t i = 0; i < modelEntityCount_; ++i)
+        {
+            scene_.createEntity(sceneRoot_);
+        }
+    }
+
+    // Avoid Gimbal-lock by converting Euler angles to quaternions
+    const glm::quat quatX
+        = glm::angleAxis(glm::radians(drawProps_.modelRotation[0]),
+                         glm::vec3(1.0F, 0.0F, 0.0F));
+    const glm::quat quatY
+        = glm::angleAxis(glm::radians(drawProps_.modelRotation[1]),
+                         glm::vec3(0.0F, 1.0F, 0.0F));
+    const glm::quat quatZ
+        = glm::angleAxis(glm::radians(drawProps_.modelRotation[2]),
+                         glm::vec3(0.0F, 0.0F, 1.0F));
+    const glm::quat rotation = quatZ * quatY * quatX;
+
+    // Grid is centered around origin on the horizontal plane
+    const float offset = static_cast<float>(gridSize - 1) * 0.5F;
+    for (size_t i = 0; i < modelEntityCount_; ++i)
+    {
+        const auto entity = static_cast<EntityId>(firstModelEntity_ + i);
+        const glm::vec3 position{
+            (static_cast<float>(i % gridSize) - offset)
+                * drawProps_.instanceSpacing,
+            0.0F,
+            (static_cast<float>(i / gridSize) - offset)
+                * drawProps_.instanceSpacing,
+        };
+        scene_.setPosition(entity, position);
+        scene_.setRotation(entity, rotation);
+    }
+    scene_.updateWorldMatrices();
+}
+
+std::pmr::vector<std::uint32_t> App::getChangedCopies()
+{
+    // Entities of other copies do not change, so the changed ones past the
+    // first model entity are all grid copies
+    const std::span<const EntityId> changedEntities = scene_.changedEntities();
+    std::pmr::vector<std::uint32_t> changedCopies(frameAllocator_.resource());
+    changedCopies.reserve(changedEntities.size());
+    for (const EntityId entity : changedEntities)
+    {
+        if (entity >= firstModelEntity_)
+        {
+            changedCopies.push_back(entity - firstModelEntity_);
+        }
+    }
+    return changedCopies;
+}
+
+void App::updateSpatialIndex(const Model& model,
+                             std::span<const std::uint32_t> changedCopies)
+{
+    PROFILE_SCOPE("App::updateSpatialIndex");
+    spatialIndex_.update(
+        model.bounds,
+        scene_.worldMatrices().subspan(firstModelEntity_, modelEntityCount_),
+        changedCopies,
+        threadPool_);
+}
+
+void App::updatePointLights()
+{
+    const auto lightCount = static_cast<size_t>(drawProps_.pointLightCount);
+    if (pointLights_.size() == lightCount
+        && pointLightGridSize_ == drawProps_.instanceGridSize
+        && pointLightSpacing_ == drawProps_.instanceSpacing)
+    {
+        return;
+    }
+    pointLightGridSize_ = drawProps_.instanceGridSize;
+    pointLightSpacing_ = drawProps_.instanceSpacing;
+
+    // Lights are spread evenly over the grid by a low-discrepancy sequence,
+    // so that the same count always gives the same layout and neighboring
+    // lights do not bunch up
+    constexpr float PLASTIC_NUMBER = 1.32471795724474602596F;
+    const glm::vec2 sequenceStep{1.0F / PLASTIC_NUMBER,
+                                 1.0F / (PLASTIC_NUMBER * PLASTIC_NUMBER)};
+    const float extent = static_cast<float>(pointLightGridSize_)
+                       * pointLightSpacing_;
+    const float radius = std::max(pointLightSpacing_, 3.0F);
+    pointLights_.resize(lightCount);
+    for (size_t i = 0; i < lightCount; ++i)
+    {
+        const auto index = static_cast<float>(i);
+        const glm::vec2 sample = glm::fract(sequenceStep * index + 0.5F);
+        const float height = 1.0F + 1.5F * glm::fract(index * 0.618034F);
+        // Hue is spread around the color wheel in golden angle steps
+        const float hue = glm::fract(index * 0.381966F) * 6.0F;
+        const glm::vec3 color = glm::clamp(
+            glm::abs(glm::mod(hue + glm::vec3{0.0F, 4.0F, 2.0F}, 6.0F) - 3.0F)
+                - 1.0F,
+            0.0F,
+            1.0F);
+        // Every fourth light is a spot light shining down
+        const bool spotLight = i % 4 == 3;
+        pointLights_[i] = {
+            .position{(sample.x - 0.5F) * extent,
+                      height,
+                      (sample.y - 0.5F) * extent},
+            .radius = radius,
+            .color = color * 4.0F,
+            .spotAngle = spotLight ? glm::radians(35.0F) : 0.0F,
+            .spotDirection{0.0F, -1.0F, 0.0F},
+        };
+    }
+}
+
+#ifndef __EMSCRIPTEN__
+void App::updateBenchmarkCamera()
+{
+    if (benchmark_->isLoading())
+    {
+        // Replayed properties may switch to any model
+        const bool modelLoading
+            = replay_ ? modelLoader_.hasPendingRequests()
+                      : benchmark_->drawsModel()
+                            && !models_[benchmark_->options().modelIndex];
+        if (modelLoading || pendingSkybox_)
+        {
+            return;
+        }
+        benchmark_->finishLoading();
+    }
+    if (replay_)
+    {
+        replay_->nextStep(camera_, drawProps_);
+    }
+    else
+    {
+        camera_ = benchmark_->nextCamera(drawProps_.instanceSpacing);
+    }
+}
+
+void App::recordBenchmarkFrame()
+{
+    if (benchmark_->isLoading())
+    {
+        return;
+    }
+    benchmark_->recordFrame(renderer_.gpuProfiler().totals());
+    if (benchmark_->isFinished())
+    {
+        // Errors are reported by writeResults()
+        benchmark_->writeResults(startupTimer_);
+        glfwSetWindowShouldClose(window_, true);
+    }
+}
+
+void App::updateReplay()
+{
+    replay_->nextStep(camera_, drawProps_);
+    requestRedraw();
+    if (replay_->isFinished())
+    {
+        glfwSetWindowShouldClose(window_, true);
+    }
+}
+
+void App::recordSteps()
+{
+    for (const Camera& camera : simulation_.takeRecordedSteps())
+    {
+        recording_->appendStep(camera);
+    }
+}
+
+bool App::runThumbnailBatch()
+{
+    const int size = thumbnailBatch_->options().size;
+    renderer_.resize(size, size);
+    camera_ = ThumbnailBatch::createCamera(drawProps_.fov);
+    while (!thumbnailBatch_->isFinished())
+    {
+        // Imported models get their buffers created by main thread tasks
+        threadPool_.runMainThreadTasks();
+        bool drawn = false;
+        while (std::optional<ModelLoader::Result> result
+               = thumbnailBatch_->pollModel())
+        {
+            // Each model is drawn as a frame of its own, fitted to the view
+            frameAllocator_.beginFrame();
+            const glm::mat4 worldMatrix = ThumbnailBatch::createWorldMatrix(
+                result->model->boundingSphere);
+            renderer_.prepareDraw();
+            renderer_.drawModel(result->model.value(),
+                                std::span{&worldMatrix, 1});
+            renderer_.finishOffscreenDraw();
+            renderer_.gpuProfiler().endFrame();
+            thumbnailBatch_->readBack(result->id);
+            drawn = true;
+        }
+        thumbnailBatch_->collectReadbacks();
+        if (!drawn)
+        {
+            // Nothing to draw until imports or readbacks finish
+            glfwWaitEventsTimeout(THUMBNAIL_IDLE_INTERVAL);
+        }
+    }
+    return thumbnailBatch_->reportResults();
+}
+#endif
+
 void App::render()
 {
-    Gui::prepareDraw(camera_, drawProps_);
-    const Model& activeModel = models_[drawProps_.selectedModelIndex];
-    renderer_.prepareDraw();
-    renderer_.drawModel(activeModel);
+    PROFILE_SCOPE("App::render");
+    ALLOCATION_SCOPE(Renderer);
+    // Temporaries of the frame before the previous one are not referred to
+    // anymore
+    frameAllocator_.beginFrame();
+#ifdef ALLOCATION_TRACKING_ENABLED
+    allocationtracker::beginFrame();
+#endif
+    const Simulation::Interpolation interpolation = simulation_.interpolate();
+    camera_ = interpolation.camera;
+    if (!interpolation.settled)
+    {
+        requestRedraw();
+    }
+#ifndef __EMSCRIPTEN__
+    if (recording_)
+    {
+        recordSteps();
+    }
+#endif
+    // Work handed over by background tasks, like creating buffers of imported
+    // models
+    threadPool_.runMainThreadTasks();
+    receiveLoadedModels();
+    receiveLoadedPointCloud();
+    updateSkybox();
+    videomemory::setBudget(static_cast<size_t>(drawProps_.videoMemoryBudget)
+                           * MEBIBYTE);
+#ifndef __EMSCRIPTEN__
+    renderer_.clusterStreamer().setBudget(
+        static_cast<size_t>(drawProps_.clusterStreamingBudget) * MEBIBYTE);
+#endif
+#ifndef __EMSCRIPTEN__
+    renderer_.reloadShaders(shaderWatcher_.takeChangedFiles());
+    if (benchmark_)
+    {
+        updateBenchmarkCamera();
+    }
+    else if (replay_)
+    {
+        updateReplay();
+    }
+#endif
+    // Background work keeps frames coming, so that its results show up as
+    // soon as they arrive
+    if (modelLoader_.hasPendingRequests() || pendingSkybox_
+        || pendingPointCloud_.valid()
+#ifndef __EMSCRIPTEN__
+        || renderer_.isReloadingShaders() || frameCapture_.isCapturing()
+        || renderer_.clusterStreamer().isStreaming()
+#endif
+    )
+    {
+        requestRedraw();
+    }
+    // Minimized window has nothing to draw into. Nothing changed since the
+    // last frame in on-demand rendering mode.
+    if (!renderer_.hasDrawingSurface()
+        || (drawProps_.onDemandRenderingEnabled && redrawFrameCount_ == 0))
+    {
+        return;
+    }
+    if (redrawFrameCount_ > 0)
+    {
+        --redrawFrameCount_;
+    }
+    if (drawProps_.lowLatencyEnabled)
+    {
+        latchInput();
+        // Window may have been minimized by events polled just now
+        if (!renderer_.hasDrawingSurface())
+        {
+            return;
+        }
+    }
+
+#ifndef __EMSCRIPTEN__
+    // Scale chosen by dynamic resolution is shown in UI, and kept when turning
+    // it off. Quality governor takes over resolution scale while enabled.
+    if (drawProps_.dynamicResolutionEnabled
+        && !drawProps_.qualityGovernorEnabled)
+    {
+        drawProps_.resolutionScale = renderer_.resolutionScale();
+    }
+#endif
+    Gui::prepareDraw(camera_,
+                     framePacer_,
+                     frameAllocator_,
+                     renderer_,
+                     startupTimer_,
+                     qualityGovernor_,
+                     drawProps_);
+    if (drawProps_ != drawnProps_)
+    {
+        drawnProps_ = drawProps_;
+        requestRedraw();
+#ifndef __EMSCRIPTEN__
+        if (recording_)
+        {
+            recording_->changeProperties(drawProps_);
+        }
+#endif
+    }
+    // Previous frame decides quality of this one. GPU time leaves out waiting
+    // for vertical synchronization and frame cap, so time between frames is
+    // only used without timer queries.
+    const GpuProfiler& gpuProfiler = renderer_.gpuProfiler();
+    qualityGovernor_.update(gpuProfiler.isSupported()
+                                ? gpuProfiler.latestGpuFrameTime()
+                                : framePacer_.latestFrameTime(),
+                            drawProps_);
+    if (DrawProperties renderProps = qualityGovernor_.apply(drawProps_);
+        renderProps != renderProps_)
+    {
+        renderProps_ = renderProps;
+        requestRedraw();
+    }
+    // Model picked in UI is loaded from now on, placeholder is drawn until
+    // then
+    requestSelectedModel();
+    evictIdleModels();
+    std::optional<Model>& selectedModel
+        = models_[drawProps_.selectedModelIndex];
+    Model& activeModel
+        = selectedModel ? selectedModel.value() : placeholderModel_.value();
+#ifdef __EMSCRIPTEN__
+    if (drawProps_.wireframeModeEnabled)
+    {
+        activeModel.createWireframe();
+    }
+#endif
+    updateScene();
+    const std::pmr::vector<std::uint32_t> changedCopies = getChangedCopies();
+    updateSpatialIndex(activeModel, changedCopies);
+    updatePointLights();
+    const std::span<const glm::mat4> worldMatrices
+        = scene_.worldMatrices().subspan(firstModelEntity_, modelEntityCount_);
+    const SpatialIndex* spatialIndex
+        = drawProps_.spatialIndexEnabled ? &spatialIndex_ : nullptr;
+    // Scene is drawn through the backend interface, only draws specific to
+    // OpenGL use the renderer directly
+    RenderBackend& backend = renderer_;
+    backend.setLights(pointLights_);
+    backend.prepareDraw();
+    if (&activeModel != shadowCasterModel_)
+    {
+        shadowCasterModel_ = &activeModel;
+        ++shadowCasterModelGeneration_;
+    }
+#ifndef __EMSCRIPTEN__
+    // Skybox only benchmark scene measures the background on its own
+    const bool modelHidden = benchmark_ && !benchmark_->drawsModel();
+#else
+    const bool modelHidden = false;
+#endif
+    // Point clouds cast no shadows
+    if (!pointCloud_ && !modelHidden)
+    {
+        backend.drawShadowCasters(
+            activeModel,
+            worldMatrices,
+            (std::uint64_t{shadowCasterModelGeneration_} << 32U)
+                | scene_.generation());
+    }
+#ifndef __EMSCRIPTEN__
+    if (drawProps_.pickingEnabled)
+    {
+        pickUnderCursor();
+    }
+#endif
+    if (modelHidden)
+    {
+        // Only the skybox is drawn
+    }
+    else if (pointCloud_)
+    {
+        backend.drawPointCloud(pointCloud_.value(), worldMatrices);
+    }
+    else
+#ifndef __EMSCRIPTEN__
+    if (drawProps_.indirectDrawEnabled)
+    {
+        const TransformChanges transformChanges{
+            .generation = scene_.generation(),
+            .previousGeneration = previousSceneGeneration_,
+            .changedCopies = changedCopies,
+        };
+        renderer_.drawModelIndirect(activeModel,
+                                    worldMatrices,
+                                    &transformChanges);
+    }
+    else
+#endif
+    if (worldMatrices.size() > 1 && drawProps_.instancingEnabled)
+    {
+        backend.drawModelInstanced(activeModel, worldMatrices, spatialIndex);
+    }
+    else
+    {
+        backend.drawModel(activeModel, worldMatrices, spatialIndex);
+    }
+    previousSceneGeneration_ = scene_.generation();
     if (drawProps_.skyboxEnabled)
     {
-        renderer_.drawSkybox(skybox_);
+        // Evicted only when over budget while another skybox is loaded
+        if (const Skybox* skybox = skyboxCache_.find(displayedSkyboxIndex_))
+        {
+            backend.drawSkybox(*skybox);
+        }
+    }
+#ifndef __EMSCRIPTEN__
+    // Streamed frames are read back from the scene target, the window is
+    // hidden. Copy is queued before waiting for the frame cap, so that it
+    // overlaps with waiting. Scene matches the window size, as resolution
+    // scaling is disabled while streaming.
+    if (streamServer_)
+    {
+        renderer_.finishOffscreenDraw();
+        int frameBufferWidth = 0;
+        int frameBufferHeight = 0;
+        glfwGetFramebufferSize(window_, &frameBufferWidth, &frameBufferHeight);
+        streamServer_->captureFrame(frameBufferWidth, frameBufferHeight);
+    }
+    else
+#endif
+    {
+        backend.finishDraw();
     }
-    Gui::draw();
+#ifndef __EMSCRIPTEN__
+    // Output window shows the scene without UI
+    if (!streamServer_ && outputWindow_.isOpen())
+    {
+        int frameBufferWidth = 0;
+        int frameBufferHeight = 0;
+        glfwGetFramebufferSize(window_, &frameBufferWidth, &frameBufferHeight);
+        outputWindow_.publishFrame(frameBufferWidth, frameBufferHeight);
+    }
+#endif
+    renderer_.gpuProfiler().beginPass(GpuPass::Gui);
+    Gui::draw(renderer_);
+    renderer_.gpuProfiler().endFrame();
 
+#ifndef __EMSCRIPTEN__
+    // Frame is read back from the back buffer before it is swapped out. Copy
+    // is queued before waiting for the frame cap, so that it overlaps with
+    // waiting.
+    int frameBufferWidth = 0;
+    int frameBufferHeight = 0;
+    glfwGetFramebufferSize(window_, &frameBufferWidth, &frameBufferHeight);
+    if (!streamServer_)
+    {
+        frameCapture_.captureFrame(frameBufferWidth, frameBufferHeight);
+    }
+    updateSwapInterval();
+    if (drawProps_.frameCapEnabled)
+    {
+        framePacer_.waitForNextFrame(drawProps_.frameCap);
+    }
+#endif
     glfwSwapBuffers(window_);
+#ifndef __EMSCRIPTEN__
+    if (drawProps_.lowLatencyEnabled)
+    {
+        renderer_.fenceFrame();
+    }
+#endif
+    framePacer_.recordFrame();
+    startupTimer_.finishFirstFrame();
+#ifndef __EMSCRIPTEN__
+    if (benchmark_)
+    {
+        recordBenchmarkFrame();
+    }
+#endif
 }
 
@@ -1,11 +1,52 @@
 #ifndef APP_H_
 #define APP_H_
 
+#ifndef __EMSCRIPTEN__
+#include "benchmark.h"
+#endif
 #include "camera.h"
 #include "drawproperties.h"
+#ifndef __EMSCRIPTEN__
+#include "filewatcher.h"
+#include "framecapture.h"
+#endif
+#include "frameallocator.h"
+#include "framepacer.h"
+#include "lightclusters.h"
 #include "model.h"
+#include "modelloader.h"
+#include "modelresidency.h"
+#ifndef __EMSCRIPTEN__
+#include "outputwindow.h"
+#endif
+#include "pointcloud.h"
+#include "qualitygovernor.h"
+#ifndef __EMSCRIPTEN__
+#include "recording.h"
+#endif
 #include "renderer.h"
+#include "scene.h"
+#include "simulation.h"
 #include "skybox.h"
+#include "skyboxcache.h"
+#include "spatialindex.h"
+#include "startuptimer.h"
+#ifndef __EMSCRIPTEN__
+#include "streamserver.h"
+#endif
+#include "threadpool.h"
+#ifndef __EMSCRIPTEN__
+#include "thumbnailbatch.h"
+#include "uploadcontext.h"
+#endif
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
 
 struct GLFWwindow;
 
@@ -20,11 +61,40 @@ public:
     App(App&&) = delete;
     App& operator=(App&&) = delete;
 
+#ifndef __EMSCRIPTEN__
+    /// Run scripted benchmark in a hidden window instead of taking user
+    /// input, exiting once results are written. Must be called before
+    /// init().
+    void enableBenchmark(Benchmark::Options options);
+    /// Record camera path and draw property changes, saving them into file
+    /// on cleanup. Must be called before init().
+    void enableRecording(std::filesystem::path filePath);
+    /// Draw recorded camera path and draw property changes instead of taking
+    /// user input, exiting once finished. Replaces the camera path of
+    /// benchmark when enabled together. Must be called before init().
+    void enableReplay(Recording recording);
+    /// Render thumbnails of model files in a hidden window instead of taking
+    /// user input, exiting once every thumbnail is written. Must be called
+    /// before init().
+    void enableThumbnails(ThumbnailBatch::Options options);
+    /// Stream frames to a remote client in a hidden window, moving the
+    /// camera by input received from it instead of user input, exiting once
+    /// the client quits. Must be called before init().
+    void enableStreaming(StreamServer::Options options);
+    /// Show the scene in a second window as well, fullscreen on the second
+    /// monitor when one is connected. Must be called before init().
+    void enableOutputWindow();
+#endif
+    /// Load point cloud from PLY or LAS file in the background, drawing it
+    /// in place of models once loaded. Must be called before init().
+    void loadPointCloud(std::filesystem::path filePath);
+
     /// Controlled initialization for explicit error handling.
     bool init();
 
-    /// Execute main loop until user exits application.
-    void run();
+    /// Execute main loop until user exits application. Returns false when a
+    /// thumbnail batch did not write a thumbnail of every model.
+    [[nodiscard]] bool run();
 
     /// Controlled deinitialization instead of relying on RAII to avoid
     /// surprises.
@@ -42,18 +112,183 @@ private:
     static void mouseMoveCallback(GLFWwindow* window,
                                   double currentMousePosX,
                                   double currentMousePosY);
+    static void frameBufferSizeCallback(GLFWwindow* window,
+                                        int width,
+                                        int height);
+    static void keyCallback(GLFWwindow* window,
+                            int key,
+                            int scancode,
+                            int action,
+                            int mods);
+    static void scrollCallback(GLFWwindow* window,
+                               double offsetX,
+                               double offsetY);
+    static void windowRefreshCallback(GLFWwindow* window);
 
+    /// Declared first, so that startup is measured from the very beginning.
+    StartupTimer startupTimer_;
     // TODO: Abstract away window implementation once starting work on native
     // Win32 window
     GLFWwindow* window_;
+    /// Temporary data of the frame being prepared, reset at its start.
+    FrameAllocator frameAllocator_;
     Renderer renderer_;
     Camera camera_;
     DrawProperties drawProps_;
+    /// Properties the last frame was drawn with, for detecting changes made
+    /// by UI.
+    DrawProperties drawnProps_;
+    /// Properties the renderer draws with, quality lowered by the quality
+    /// governor.
+    DrawProperties renderProps_;
+    /// Frames left to draw before idling in on-demand rendering mode.
+    int redrawFrameCount_;
+    FramePacer framePacer_;
+    QualityGovernor qualityGovernor_;
+#ifndef __EMSCRIPTEN__
+    /// Vertical synchronization mode applied to the window, -1 before the
+    /// first frame.
+    int appliedVsyncModeIndex_;
+#endif
     glm::vec2 lastMousePos_;
-    Skybox skybox_;
-    std::vector<Model> models_;
+    /// Movement keys held as of the latest key event.
+    Simulation::Input sampledInput_;
+    /// Key changes and mouse look movement since input was last handed to
+    /// simulation, stamped as they arrived.
+    std::vector<Simulation::InputEvent> inputEvents_;
+    /// Camera above is the interpolated camera being rendered, simulation
+    /// owns the one being moved.
+    Simulation simulation_;
+    /// Recently displayed skyboxes by selection index.
+    SkyboxCache skyboxCache_;
+    /// Skybox being loaded in the background, if any.
+    std::optional<PendingSkybox> pendingSkybox_;
+    size_t pendingSkyboxIndex_;
+    /// Shown until the selected skybox finished loading.
+    size_t displayedSkyboxIndex_;
+    /// Stand-in for models that are still being loaded.
+    std::optional<Model> placeholderModel_;
+    /// Empty until loaded in the background.
+    std::vector<std::optional<Model>> models_;
+    /// Models are requested once first selected, or prefetched.
+    std::vector<bool> requestedModels_;
+    /// Models released over budget are loaded again only once selected, not
+    /// prefetched, so that they are not released again right away.
+    std::vector<bool> evictedModels_;
+    ModelResidency modelResidency_;
+#ifndef __EMSCRIPTEN__
+    /// Fills buffers of loaded models on a thread of its own. Declared before
+    /// the thread pool, so that imports still running on workers while the
+    /// pool is joined submit to a stopped context instead of a destroyed one.
+    UploadContext uploadContext_;
+#endif
+    ThreadPool threadPool_;
+    ModelLoader modelLoader_;
+    std::optional<std::filesystem::path> pointCloudPath_;
+    /// Points imported in the background, invalid once uploaded.
+    std::future<std::optional<PointCloudData>> pendingPointCloud_;
+    /// Drawn over the instance grid instead of the selected model.
+    std::optional<PointCloud> pointCloud_;
+#ifndef __EMSCRIPTEN__
+    /// Shader sources edited while running are recompiled and swapped in.
+    FileWatcher shaderWatcher_;
+    /// Screenshots and video of presented frames.
+    FrameCapture frameCapture_;
+    std::optional<Benchmark> benchmark_;
+    std::optional<std::filesystem::path> recordingPath_;
+    std::optional<Recording> recording_;
+    std::optional<Replay> replay_;
+    std::optional<ThumbnailBatch> thumbnailBatch_;
+    std::optional<StreamServer> streamServer_;
+    bool outputWindowEnabled_;
+    /// Closed by the user independently of the main window.
+    OutputWindow outputWindow_;
+#endif
+    /// Copies of selected model laid out in instance grid, as children of a
+    /// single root entity.
+    Scene scene_;
+    EntityId sceneRoot_;
+    /// Entities of grid copies are created consecutively after the root, so
+    /// their world matrices are contiguous.
+    EntityId firstModelEntity_;
+    size_t modelEntityCount_;
+    /// Loose bounding volume hierarchy over grid copies of the drawn model,
+    /// numbered from the first model entity on.
+    SpatialIndex spatialIndex_;
+    /// Model drawn as shadow caster in the last frame, and a counter
+    /// incremented whenever it is replaced, so that cached shadow cascades are
+    /// drawn again with the new one.
+    const Model* shadowCasterModel_;
+    std::uint32_t shadowCasterModelGeneration_;
+    /// Scene generation of the last frame, which changed copies of the
+    /// current frame are listed relative to.
+    std::uint32_t previousSceneGeneration_;
+    /// Point and spot lights scattered over the instance grid, and the grid
+    /// they were scattered over.
+    std::vector<PointLight> pointLights_;
+    int pointLightGridSize_;
+    float pointLightSpacing_;
 
     void handleInput();
+    /// Record input event of held keys and look offset at the current time.
+    void sampleInput(glm::vec2 lookOffset);
+    /// Sample mouse look again right before drawing in low latency mode,
+    /// after waiting for the GPU to catch up.
+    void latchInput();
+#ifndef __EMSCRIPTEN__
+    /// Apply vertical synchronization mode selected in UI when it changes.
+    void updateSwapInterval();
+    /// Request picking of the object under the cursor while drawing the
+    /// frame, unless the cursor is outside of the window.
+    void pickUnderCursor();
+#endif
+    /// Draw the next few frames even in on-demand rendering mode.
+    void requestRedraw();
+    /// Builder of skybox from cube-map faces in selectable skybox directory.
+    SkyboxBuilder createSkyboxBuilder(size_t skyboxIndex);
+    /// Start loading selected skybox unless it is resident, and take over
+    /// skybox finished loading in the background.
+    void updateSkybox();
+    /// Start loading model in the background unless requested before.
+    void requestModel(size_t modelIndex);
+    /// Request model selected in UI, and prefetch the one likely picked next
+    /// once it arrived.
+    void requestSelectedModel();
+    /// Take over models finished loading in the background.
+    void receiveLoadedModels();
+    /// Mark selected model as drawn, and release models not drawn recently
+    /// over residency budget.
+    void evictIdleModels();
+    /// Upload point cloud once imported in the background.
+    void receiveLoadedPointCloud();
+    /// Apply model transform and instance grid layout from UI onto scene
+    /// entities, and update their world matrices.
+    void updateScene();
+    /// Grid copies whose world matrix changed in the last scene update,
+    /// numbered from the first model entity on.
+    std::pmr::vector<std::uint32_t> getChangedCopies();
+    /// Move changed grid copies of model within spatial index, or rebuild it
+    /// for another model or grid.
+    void updateSpatialIndex(const Model& model,
+                            std::span<const std::uint32_t> changedCopies);
+    /// Scatter point and spot lights over the instance grid when light count
+    /// or grid layout changes in UI.
+    void updatePointLights();
+#ifndef __EMSCRIPTEN__
+    /// Take over camera once benchmark finished loading.
+    void updateBenchmarkCamera();
+    /// Record presented frame, and exit once benchmark is finished.
+    void recordBenchmarkFrame();
+    /// Take over camera and draw properties of the next replayed step, and
+    /// exit once replay is finished.
+    void updateReplay();
+    /// Append steps run by simulation since the previous frame to recording.
+    void recordSteps();
+    /// Draw and read back each model of the thumbnail batch as soon as it is
+    /// loaded, until every thumbnail is written. Returns whether every model
+    /// got a thumbnail.
+    bool runThumbnailBatch();
+#endif
     void render();
 };
 
@@ -0,0 +1,344 @@
+#include "assetarchive.h"
+
+#include "utils.h"
+
+#include "lz4.h"
+#ifndef __EMSCRIPTEN__
+#include "lz4hc.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#ifndef __EMSCRIPTEN__
+#include <fstream>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'A', 'S', 'T', 'A'};
+// Increment on any change of Header or Entry layout.
+constexpr uint32_t FORMAT_VERSION = 1;
+/// Contents of entries start at page boundaries, so that pages of an entry
+/// are not shared with neighbouring entries paged in along with it.
+constexpr uint64_t ENTRY_ALIGNMENT = 4096;
+
+enum class Compression : uint32_t
+{
+    None,
+    Lz4,
+};
+
+struct Header
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t entryCount;
+    uint64_t pathsSize;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+
+/// Relative asset path in the form stored in archives.
+std::string toEntryPath(const fs::path& path)
+{
+    return path.lexically_normal().generic_string();
+}
+}  // namespace
+
+AssetData AssetData::view(std::span<const std::byte> bytes)
+{
+    AssetData data;
+    data.bytes_ = bytes;
+    return data;
+}
+
+AssetData AssetData::fromMappedFile(MappedFile&& file)
+{
+    AssetData data;
+    data.bytes_ = {file.data(), file.size()};
+    data.mappedFile_.emplace(std::move(file));
+    return data;
+}
+
+AssetData AssetData::fromBuffer(std::vector<std::byte>&& buffer)
+{
+    AssetData data;
+    data.buffer_ = std::move(buffer);
+    data.bytes_ = data.buffer_;
+    return data;
+}
+
+std::optional<AssetArchive> AssetArchive::open(const fs::path& path)
+{
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file)
+    {
+        utils::showErrorMessage("unable to open asset archive at ", path);
+        return std::nullopt;
+    }
+
+    Header header;
+    if (file->size() < sizeof(header))
+    {
+        utils::showErrorMessage("asset archive at ", path, " is truncated");
+        return std::nullopt;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (header.magic != MAGIC || header.version != FORMAT_VERSION)
+    {
+        utils::showErrorMessage("asset archive at ",
+                                path,
+                                " has unsupported format, pack it again");
+        return std::nullopt;
+    }
+    const uint64_t tableSize = header.entryCount * sizeof(Entry);
+    if (header.entryCount > file->size() / sizeof(Entry)
+        || sizeof(header) + tableSize + header.pathsSize > file->size())
+    {
+        utils::showErrorMessage("asset archive at ", path, " is truncated");
+        return std::nullopt;
+    }
+
+    AssetArchive archive{std::move(file.value())};
+    const std::byte* data = archive.file_.data();
+    // Header size keeps the entry table aligned within the mapping
+    archive.entries_ = {reinterpret_cast<const Entry*>(data + sizeof(header)),
+                        static_cast<size_t>(header.entryCount)};
+    archive.paths_ = {
+        reinterpret_cast<const char*>(data + sizeof(header) + tableSize),
+        static_cast<size_t>(header.pathsSize)};
+    for (const Entry& entry : archive.entries_)
+    {
+        if (static_cast<uint64_t>(entry.pathOffset) + entry.pathLength
+                > header.pathsSize
+            || entry.dataOffset > archive.file_.size()
+            || entry.storedSize > archive.file_.size() - entry.dataOffset
+            || entry.compression > static_cast<uint32_t>(Compression::Lz4)
+            || (entry.compression != static_cast<uint32_t>(Compression::None)
+                && entry.size > static_cast<uint64_t>(
+                       std::numeric_limits<int>::max())))
+        {
+            utils::showErrorMessage("asset archive at ",
+                                    path,
+                                    " is corrupted");
+            return std::nullopt;
+        }
+    }
+    return archive;
+}
+
+#ifndef __EMSCRIPTEN__
+bool AssetArchive::pack(const fs::path& directory, const fs::path& archivePath)
+{
+    struct Source
+    {
+        std::string path;
+        fs::path filePath;
+    };
+    std::vector<Source> sources;
+    std::error_code error;
+    for (fs::recursive_directory_iterator it{directory, error}, end;
+         !error && it != end;
+         it.increment(error))
+    {
+        if (!it->is_regular_file(error))
+        {
+            continue;
+        }
+        sources.push_back(Source{
+            .path = toEntryPath(directory.filename()
+                                / it->path().lexically_relative(directory)),
+            .filePath = it->path(),
+        });
+    }
+    if (error)
+    {
+        utils::showErrorMessage("unable to list assets in ",
+                                directory,
+                                ": ",
+                                error.message());
+        return false;
+    }
+    // Entries are looked up by binary search over paths
+    std::ranges::sort(sources, {}, &Source::path);
+
+    std::vector<Entry> entries;
+    entries.reserve(sources.size());
+    std::string paths;
+    for (const Source& source : sources)
+    {
+        entries.push_back(Entry{
+            .dataOffset = 0,
+            .storedSize = 0,
+            .size = 0,
+            .pathOffset = static_cast<uint32_t>(paths.size()),
+            .pathLength = static_cast<uint32_t>(source.path.size()),
+            .compression = static_cast<uint32_t>(Compression::None),
+            .padding = 0,
+        });
+        paths += source.path;
+    }
+
+    std::ofstream file(archivePath, std::ios::binary | std::ios::trunc);
+    const Header header{
+        .magic = MAGIC,
+        .version = FORMAT_VERSION,
+        .entryCount = entries.size(),
+        .pathsSize = paths.size(),
+    };
+    // Table of contents is written last, once data offsets are known
+    const uint64_t tableEnd
+        = sizeof(header) + entries.size() * sizeof(Entry) + paths.size();
+    file.seekp(static_cast<std::streamoff>(tableEnd));
+    uint64_t offset = tableEnd;
+    uint64_t totalSize = 0;
+    std::vector<char> compressed;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        const std::optional<MappedFile> source
+            = MappedFile::open(sources[i].filePath);
+        // Empty files can not be mapped and are stored without contents
+        if (!source && fs::file_size(sources[i].filePath, error) != 0)
+        {
+            utils::showErrorMessage("unable to read asset ",
+                                    sources[i].filePath);
+            return false;
+        }
+        const std::span<const std::byte> contents
+            = source ? std::span{source->data(), source->size()}
+                     : std::span<const std::byte>{};
+        if (contents.size()
+            > static_cast<size_t>(std::numeric_limits<int>::max()))
+        {
+            utils::showErrorMessage("asset ",
+                                    sources[i].filePath,
+                                    " is too large to pack");
+            return false;
+        }
+
+        const uint64_t alignedOffset = (offset + ENTRY_ALIGNMENT - 1)
+                                     / ENTRY_ALIGNMENT * ENTRY_ALIGNMENT;
+        file.seekp(static_cast<std::streamoff>(alignedOffset));
+        Entry& entry = entries[i];
+        entry.dataOffset = alignedOffset;
+        entry.size = contents.size();
+        const int sourceSize = static_cast<int>(contents.size());
+        compressed.resize(static_cast<size_t>(LZ4_compressBound(sourceSize)));
+        // High compression packs slower but decompresses as fast, and
+        // packing happens once per build
+        const auto* sourceData = reinterpret_cast<const char*>(contents.data());
+        const int compressedSize
+            = sourceSize > 0
+                ? LZ4_compress_HC(sourceData,
+                                  compressed.data(),
+                                  sourceSize,
+                                  static_cast<int>(compressed.size()),
+                                  LZ4HC_CLEVEL_MAX)
+                : 0;
+        if (compressedSize > 0 && compressedSize < sourceSize)
+        {
+            entry.compression = static_cast<uint32_t>(Compression::Lz4);
+            entry.storedSize = static_cast<uint64_t>(compressedSize);
+            file.write(compressed.data(), compressedSize);
+        }
+        else
+        {
+            entry.storedSize = contents.size();
+            file.write(sourceData,
+                       static_cast<std::streamsize>(contents.size()));
+        }
+        offset = alignedOffset + entry.storedSize;
+        totalSize += entry.size;
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+    file.write(paths.data(), static_cast<std::streamsize>(paths.size()));
+    if (!file)
+    {
+        utils::showErrorMessage("unable to write asset archive at ",
+                                archivePath);
+        return false;
+    }
+    utils::logInfo("packed ",
+                   entries.size(),
+                   " assets of ",
+                   totalSize,
+                   " bytes into ",
+                   offset,
+                   " bytes at ",
+                   archivePath);
+    return true;
+}
+#endif
+
+bool AssetArchive::contains(const fs::path& path) const
+{
+    return find(path) != nullptr;
+}
+
+std::optional<AssetData> AssetArchive::read(const fs::path& path) const
+{
+    const Entry* entry = find(path);
+    if (!entry)
+    {
+        return std::nullopt;
+    }
+    const std::span<const std::byte> stored{
+        file_.data() + entry->dataOffset,
+        static_cast<size_t>(entry->storedSize)};
+    if (static_cast<Compression>(entry->compression) == Compression::None)
+    {
+        return AssetData::view(stored);
+    }
+
+    std::vector<std::byte> buffer(static_cast<size_t>(entry->size));
+    const int decompressedSize
+        = LZ4_decompress_safe(reinterpret_cast<const char*>(stored.data()),
+                              reinterpret_cast<char*>(buffer.data()),
+                              static_cast<int>(stored.size()),
+                              static_cast<int>(buffer.size()));
+    if (decompressedSize < 0
+        || static_cast<uint64_t>(decompressedSize) != entry->size)
+    {
+        utils::showErrorMessage("unable to decompress asset ",
+                                path,
+                                " from archive");
+        return std::nullopt;
+    }
+    return AssetData::fromBuffer(std::move(buffer));
+}
+
+AssetArchive::AssetArchive(MappedFile&& file)
+    : file_{std::move(file)}
+{
+}
+
+std::string_view AssetArchive::entryPath(const Entry& entry) const
+{
+    return paths_.substr(entry.pathOffset, entry.pathLength);
+}
+
+const AssetArchive::Entry* AssetArchive::find(const fs::path& path) const
+{
+    const std::string entryPath = toEntryPath(path);
+    const auto it = std::ranges::lower_bound(
+        entries_,
+        std::string_view{entryPath},
+        {},
+        [this](const Entry& entry) { return this->entryPath(entry); });
+    if (it == entries_.end() || this->entryPath(*it) != entryPath)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
@@ -0,0 +1,111 @@
+#ifndef ASSET_ARCHIVE_H_
+#define ASSET_ARCHIVE_H_
+
+#include "mappedfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/// Contents of an asset read from an archive or a loose file.
+///
+/// Bytes either point into the mapping of the archive or the loose file, or
+/// into a buffer entries are decompressed into, which is owned along with the
+/// mapping of a loose file. Mounted archives outlive assets read from them.
+/// Move-only, bytes stay valid when moved.
+class AssetData
+{
+public:
+    static AssetData view(std::span<const std::byte> bytes);
+    static AssetData fromMappedFile(MappedFile&& file);
+    static AssetData fromBuffer(std::vector<std::byte>&& buffer);
+
+    [[nodiscard]] std::span<const std::byte> bytes() const { return bytes_; }
+    /// Contents of text files, like shader sources.
+    [[nodiscard]] std::string_view text() const
+    {
+        return {reinterpret_cast<const char*>(bytes_.data()), bytes_.size()};
+    }
+
+private:
+    AssetData() = default;
+
+    std::span<const std::byte> bytes_;
+    std::optional<MappedFile> mappedFile_;
+    std::vector<std::byte> buffer_;
+};
+
+/// Single file packing the asset directory, read through a memory mapping.
+///
+/// Opening many small loose files costs a seek and a directory lookup each,
+/// which adds up on spinning disks and network shares during startup. An
+/// archive is opened once, with its table of contents read from the mapping
+/// and the contents of each asset paged in on access.
+///
+/// Archive starts with a header and the table of entries sorted by path,
+/// followed by the path strings and the contents of entries, each starting at
+/// an offset aligned to the page size of memory mappings. Entries are
+/// compressed with LZ4 when that makes them smaller. Text like shader
+/// sources and meshes compress well, while already compressed images are
+/// stored as-is and read from the mapping without copying.
+///
+/// Paths are stored in generic format relative to the directory the archive
+/// was packed from, with the packed directory name as first component, so
+/// that they match the relative paths assets are loaded by.
+///
+/// Non-copyable, move-only.
+class AssetArchive
+{
+public:
+    /// Factory method mapping archive file at path and validating its table
+    /// of contents. Errors are reported.
+    static std::optional<AssetArchive> open(const std::filesystem::path& path);
+
+#ifndef __EMSCRIPTEN__
+    /// Pack every file under directory into archive at path, compressing
+    /// entries. Errors are reported.
+    static bool pack(const std::filesystem::path& directory,
+                     const std::filesystem::path& archivePath);
+#endif
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+    AssetArchive(AssetArchive&&) noexcept = default;
+    AssetArchive& operator=(AssetArchive&&) noexcept = default;
+    ~AssetArchive() = default;
+
+    /// Whether archive has an entry for relative asset path.
+    [[nodiscard]] bool contains(const std::filesystem::path& path) const;
+    /// Contents of entry at relative asset path, decompressed when needed.
+    /// Returns nothing when archive has no such entry, and reports entries
+    /// failing to decompress. Safe to call from multiple threads.
+    [[nodiscard]] std::optional<AssetData> read(
+        const std::filesystem::path& path) const;
+
+private:
+    struct Entry
+    {
+        uint64_t dataOffset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+        uint32_t compression;
+        uint32_t padding;
+    };
+
+    explicit AssetArchive(MappedFile&& file);
+
+    [[nodiscard]] std::string_view entryPath(const Entry& entry) const;
+    [[nodiscard]] const Entry* find(const std::filesystem::path& path) const;
+
+    MappedFile file_;
+    std::span<const Entry> entries_;
+    std::string_view paths_;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "assetfs.h"
+
+#include "mappedfile.h"
+
+#include <system_error>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+std::optional<AssetArchive> mountedArchive;
+}  // namespace
+
+namespace assetfs
+{
+bool mount(const fs::path& archivePath)
+{
+    // Errors are reported by open()
+    mountedArchive = AssetArchive::open(archivePath);
+    return mountedArchive.has_value();
+}
+
+bool exists(const fs::path& path)
+{
+    if (mountedArchive && mountedArchive->contains(path))
+    {
+        return true;
+    }
+    std::error_code error;
+    return fs::exists(path, error);
+}
+
+std::optional<AssetData> readFile(const fs::path& path)
+{
+    if (mountedArchive)
+    {
+        std::optional<AssetData> data = mountedArchive->read(path);
+        if (data)
+        {
+            return data;
+        }
+    }
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+    return AssetData::fromMappedFile(std::move(file.value()));
+}
+}  // namespace assetfs
@@ -0,0 +1,32 @@
+#ifndef ASSET_FS_H_
+#define ASSET_FS_H_
+
+#include "assetarchive.h"
+
+#include <filesystem>
+#include <optional>
+
+/// Virtual file layer assets are loaded through, reading them from a mounted
+/// asset archive, or from loose files under the working directory when no
+/// archive is mounted or the archive has no entry for them.
+///
+/// Entries of the archive take precedence, so loose shader sources edited
+/// while an archive is mounted are not picked up by reloading. Mounting is
+/// done once on startup, before assets are loaded on any thread. Reading is
+/// safe from multiple threads.
+namespace assetfs
+{
+/// Mount archive at path for the rest of the application lifetime. Errors
+/// are reported.
+bool mount(const std::filesystem::path& archivePath);
+
+/// Whether asset at relative path exists in the mounted archive or as a
+/// loose file.
+[[nodiscard]] bool exists(const std::filesystem::path& path);
+
+/// Contents of asset at relative path. Returns nothing when asset does not
+/// exist or is empty, leaving the error to be reported by the caller.
+std::optional<AssetData> readFile(const std::filesystem::path& path);
+}  // namespace assetfs
+
+#endif
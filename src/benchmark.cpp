@@ -0,0 +1,325 @@
+#include "benchmark.h"
+
+#include "utils.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace
+{
+/// Frames drawn before measuring, while the driver finishes work deferred to
+/// first use.
+constexpr int WARM_UP_FRAME_COUNT = 60;
+/// Frames taken by one orbit around the scene.
+constexpr int ORBIT_FRAME_COUNT = 600;
+constexpr float ORBIT_HEIGHT = 1.5F;
+/// Distance of orbit from the center, used unless the instance grid is
+/// larger.
+constexpr float MIN_ORBIT_RADIUS = 4.0F;
+
+// Order matches GPU passes of profiler
+constexpr std::array<const char*, GpuProfiler::PASS_COUNT> PASS_NAMES{
+    "clear",
+    "shadows",
+    "ambientOcclusion",
+    "lightAssignment",
+    "models",
+    "skybox",
+    "antialiasing",
+    "bloom",
+    "tonemap",
+    "ui"};
+// Order matches startup phases
+constexpr std::array<const char*, StartupTimer::PHASE_COUNT>
+    STARTUP_PHASE_NAMES{
+        "windowingSystem",
+        "window",
+        "ui",
+        "renderer",
+        "skybox",
+        "shaders"};
+
+bool parseInt(std::string_view text, int& value)
+{
+    const auto [end, error]
+        = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size();
+}
+
+/// Value at percentile of sorted values, taking the nearest rank.
+float percentile(std::span<const float> sortedValues, float percent)
+{
+    const auto rank = static_cast<size_t>(
+        std::ceil(percent / 100.0F * static_cast<float>(sortedValues.size())));
+    return sortedValues[std::clamp<size_t>(rank, 1, sortedValues.size()) - 1];
+}
+
+/// Write average pass times between totals as members of a JSON object.
+void writePassTimes(std::ostream& output,
+                    const std::array<double, GpuProfiler::PASS_COUNT>& first,
+                    const std::array<double, GpuProfiler::PASS_COUNT>& last,
+                    size_t frameCount)
+{
+    for (size_t i = 0; i < PASS_NAMES.size(); ++i)
+    {
+        const double average = frameCount > 0
+                                 ? (last[i] - first[i])
+                                       / static_cast<double>(frameCount)
+                                 : 0.0;
+        output << (i == 0 ? "" : ", ") << '"' << PASS_NAMES[i]
+               << "\": " << average;
+    }
+}
+}  // namespace
+
+std::optional<Benchmark::Options> Benchmark::parseArguments(
+    std::span<const char* const> arguments)
+{
+    Options options{
+        .modelIndex = 2,
+        .instanceGridSize = 1,
+        .frameCount = 1000,
+        .outputPath = "benchmark.json",
+    };
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        const std::string_view argument{arguments[i]};
+        if (i + 1 == arguments.size())
+        {
+            utils::showErrorMessage("missing value of benchmark argument ",
+                                    argument);
+            return std::nullopt;
+        }
+        const std::string_view value{arguments[++i]};
+        if (argument == "--output")
+        {
+            options.outputPath = value;
+            continue;
+        }
+        int number = 0;
+        if (!parseInt(value, number) || number < 0)
+        {
+            utils::showErrorMessage("invalid value of benchmark argument ",
+                                    argument,
+                                    ": ",
+                                    value);
+            return std::nullopt;
+        }
+        if (argument == "--model")
+        {
+            options.modelIndex = static_cast<size_t>(number);
+        }
+        else if (argument == "--grid")
+        {
+            options.instanceGridSize = number;
+        }
+        else if (argument == "--frames" && number > 0)
+        {
+            options.frameCount = number;
+        }
+        else
+        {
+            utils::showErrorMessage("unknown benchmark argument ",
+                                    argument,
+                                    " or value out of range: ",
+                                    value);
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+Benchmark::Benchmark(Options options)
+    : options_{std::move(options)}
+    , startTime_{Clock::now()}
+    , frameIndex_{0}
+    , firstPassTotals_{}
+    , lastPassTotals_{}
+#ifdef ALLOCATION_TRACKING_ENABLED
+    , frameAllocationSums_{}
+    , maxFrameAllocations_{}
+#endif
+{
+    frameTimes_.reserve(static_cast<size_t>(options_.frameCount));
+}
+
+void Benchmark::finishLoading()
+{
+    loadTime_
+        = std::chrono::duration<float, std::milli>(Clock::now() - startTime_)
+              .count();
+}
+
+Camera Benchmark::nextCamera(float instanceSpacing) const
+{
+    const float gridExtent
+        = static_cast<float>(std::max(options_.instanceGridSize - 1, 0))
+        * instanceSpacing;
+    const float radius = std::max(MIN_ORBIT_RADIUS, gridExtent);
+    const float angle = glm::two_pi<float>() * static_cast<float>(frameIndex_)
+                      / static_cast<float>(ORBIT_FRAME_COUNT);
+    const glm::vec3 position{radius * std::cos(angle),
+                             ORBIT_HEIGHT,
+                             radius * std::sin(angle)};
+    // Yaw and pitch of the direction towards the center
+    const glm::vec2 rotation{
+        glm::degrees(std::atan2(-position.z, -position.x)),
+        glm::degrees(std::atan2(-position.y, radius)),
+    };
+    return Camera{position, rotation};
+}
+
+void Benchmark::recordFrame(const GpuProfiler::Totals& passTotals)
+{
+    const Clock::time_point now = Clock::now();
+    if (frameIndex_ == WARM_UP_FRAME_COUNT)
+    {
+        firstPassTotals_ = passTotals;
+    }
+    else if (frameIndex_ > WARM_UP_FRAME_COUNT)
+    {
+        frameTimes_.push_back(std::chrono::duration<float, std::milli>(
+                                  now - previousFrameTime_.value())
+                                  .count());
+#ifdef ALLOCATION_TRACKING_ENABLED
+        // Counts of the frame before, as this one is still being finished
+        const allocationtracker::SubsystemCounts& allocations
+            = allocationtracker::previousFrame();
+        for (size_t i = 0; i < allocations.size(); ++i)
+        {
+            frameAllocationSums_[i].allocationCount
+                += allocations[i].allocationCount;
+            frameAllocationSums_[i].byteCount += allocations[i].byteCount;
+            maxFrameAllocations_[i].allocationCount
+                = std::max(maxFrameAllocations_[i].allocationCount,
+                           allocations[i].allocationCount);
+            maxFrameAllocations_[i].byteCount
+                = std::max(maxFrameAllocations_[i].byteCount,
+                           allocations[i].byteCount);
+        }
+#endif
+    }
+    lastPassTotals_ = passTotals;
+    previousFrameTime_ = now;
+    ++frameIndex_;
+}
+
+bool Benchmark::isFinished() const
+{
+    return frameTimes_.size() == static_cast<size_t>(options_.frameCount);
+}
+
+bool Benchmark::writeResults(const StartupTimer& startupTimer) const
+{
+    std::ofstream output{options_.outputPath};
+    if (!output)
+    {
+        utils::showErrorMessage("unable to create benchmark results file ",
+                                options_.outputPath);
+        return false;
+    }
+
+    std::vector<float> sortedFrameTimes = frameTimes_;
+    std::ranges::sort(sortedFrameTimes);
+    double frameTimeSum = 0.0;
+    for (const float frameTime : frameTimes_)
+    {
+        frameTimeSum += frameTime;
+    }
+    const double averageFrameTime
+        = sortedFrameTimes.empty()
+            ? 0.0
+            : frameTimeSum / static_cast<double>(sortedFrameTimes.size());
+
+    // GPU results arrive a few frames late, so the frames they average over
+    // are counted separately from CPU ones
+    output << "{\n"
+           << "  \"modelIndex\": " << options_.modelIndex << ",\n"
+           << "  \"instanceGridSize\": " << options_.instanceGridSize << ",\n"
+           << "  \"frameCount\": " << frameTimes_.size() << ",\n"
+           << "  \"loadTimeMs\": " << loadTime_.value_or(0.0F) << ",\n"
+           << "  \"frameTimeMs\": {\"average\": " << averageFrameTime;
+    if (!sortedFrameTimes.empty())
+    {
+        output << ", \"min\": " << sortedFrameTimes.front()
+               << ", \"p50\": " << percentile(sortedFrameTimes, 50.0F)
+               << ", \"p90\": " << percentile(sortedFrameTimes, 90.0F)
+               << ", \"p99\": " << percentile(sortedFrameTimes, 99.0F)
+               << ", \"max\": " << sortedFrameTimes.back();
+    }
+    // Every frame is listed for comparing runs of the same replay frame by
+    // frame
+    output << "},\n  \"frameTimesMs\": [";
+    for (size_t i = 0; i < frameTimes_.size(); ++i)
+    {
+        output << (i == 0 ? "" : ", ") << frameTimes_[i];
+    }
+    output << "],\n  \"cpuPassTimesMs\": {";
+    writePassTimes(output,
+                   firstPassTotals_.cpuPassTimes,
+                   lastPassTotals_.cpuPassTimes,
+                   lastPassTotals_.cpuFrameCount
+                       - firstPassTotals_.cpuFrameCount);
+    output << "},\n  \"gpuPassTimesMs\": {";
+    writePassTimes(output,
+                   firstPassTotals_.gpuPassTimes,
+                   lastPassTotals_.gpuPassTimes,
+                   lastPassTotals_.gpuFrameCount
+                       - firstPassTotals_.gpuFrameCount);
+#ifdef ALLOCATION_TRACKING_ENABLED
+    output << "},\n  \"heapAllocationsPerFrame\": {";
+    const auto frameCount = static_cast<double>(
+        std::max<size_t>(frameTimes_.size(), 1));
+    for (size_t i = 0; i < allocationtracker::SUBSYSTEM_COUNT; ++i)
+    {
+        output << (i == 0 ? "" : ", ") << '"'
+               << allocationtracker::SUBSYSTEM_NAMES[i]
+               << "\": {\"average\": "
+               << static_cast<double>(frameAllocationSums_[i].allocationCount)
+                      / frameCount
+               << ", \"max\": " << maxFrameAllocations_[i].allocationCount
+               << ", \"averageBytes\": "
+               << static_cast<double>(frameAllocationSums_[i].byteCount)
+                      / frameCount
+               << ", \"maxBytes\": " << maxFrameAllocations_[i].byteCount
+               << '}';
+    }
+#endif
+    output << "},\n  \"startupMs\": {";
+    const StartupTimer::PhaseTimes& phaseTimes = startupTimer.phaseTimes();
+    for (size_t i = 0; i < STARTUP_PHASE_NAMES.size(); ++i)
+    {
+        output << '"' << STARTUP_PHASE_NAMES[i] << "\": " << phaseTimes[i]
+               << ", ";
+    }
+    // Models not selected may still be loading
+    output << "\"firstFrame\": "
+           << startupTimer.timeToFirstFrame().value_or(0.0F)
+           << ", \"modelsLoaded\": ";
+    if (const std::optional<float> modelLoadTime
+        = startupTimer.modelLoadTime())
+    {
+        output << modelLoadTime.value();
+    }
+    else
+    {
+        output << "null";
+    }
+    output << "}\n}\n";
+
+    if (!output)
+    {
+        utils::showErrorMessage("unable to write benchmark results file ",
+                                options_.outputPath);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "allocationtracker.h"
+#include "camera.h"
+#include "gpuprofiler.h"
+#include "startuptimer.h"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Scripted run measuring renderer performance without user input, for
+/// catching regressions between releases.
+///
+/// Once loading finished, the camera orbits the scene at a fixed pace per
+/// frame, so that every run draws the same frames regardless of framerate.
+/// Frames are drawn as fast as possible. The first frames are left out of
+/// results, as drivers finish compiling shaders and uploading data on first
+/// use. Results are written as JSON once every frame is drawn.
+class Benchmark
+{
+public:
+    struct Options
+    {
+        size_t modelIndex;
+        /// Copies of model along each side of instance grid. Zero leaves the
+        /// model out, drawing only the skybox.
+        int instanceGridSize;
+        /// Measured frames, not counting warm-up.
+        int frameCount;
+        std::filesystem::path outputPath;
+    };
+
+    /// Parse options from command line arguments following "--benchmark".
+    /// Unknown and malformed arguments are reported.
+    static std::optional<Options> parseArguments(
+        std::span<const char* const> arguments);
+
+    explicit Benchmark(Options options);
+
+    [[nodiscard]] const Options& options() const { return options_; }
+    [[nodiscard]] bool drawsModel() const
+    {
+        return options_.instanceGridSize > 0;
+    }
+
+    /// Record that loading finished, starting warm-up frames.
+    void finishLoading();
+    [[nodiscard]] bool isLoading() const { return !loadTime_.has_value(); }
+
+    /// Camera of the next frame along the scripted path.
+    [[nodiscard]] Camera nextCamera(float instanceSpacing) const;
+
+    /// Record that a frame was presented, with pass times measured so far.
+    void recordFrame(const GpuProfiler::Totals& passTotals);
+    [[nodiscard]] bool isFinished() const;
+
+    /// Write results into the output file, along with startup phase times.
+    bool writeResults(const StartupTimer& startupTimer) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Options options_;
+    Clock::time_point startTime_;
+    /// Milliseconds from start until loading finished.
+    std::optional<float> loadTime_;
+    /// Frames presented since loading finished, including warm-up.
+    int frameIndex_;
+    std::optional<Clock::time_point> previousFrameTime_;
+    /// Milliseconds of each measured frame.
+    std::vector<float> frameTimes_;
+    /// Pass time totals when measurement started and at the last frame.
+    GpuProfiler::Totals firstPassTotals_;
+    GpuProfiler::Totals lastPassTotals_;
+#ifdef ALLOCATION_TRACKING_ENABLED
+    /// Heap allocations summed over measured frames, and the most made by a
+    /// single one.
+    allocationtracker::SubsystemCounts frameAllocationSums_;
+    allocationtracker::SubsystemCounts maxFrameAllocations_;
+#endif
+};
+
+#endif
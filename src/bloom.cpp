@@ -0,0 +1,167 @@
+#include "bloom.h"
+
+#include "glm/common.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture unit of the source while drawing a pass.
+constexpr GLuint SOURCE_TEXTURE_UNIT = 0;
+}  // namespace
+
+Bloom::PendingShaders Bloom::submitShaders()
+{
+#ifdef __EMSCRIPTEN__
+    const fs::path vertexShaderPath{
+        "assets/shaders/fullscreen_gles3.vert.glsl"};
+    return PendingShaders{
+        .downsampleShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/bloom_downsample_gles3.frag.glsl"}),
+        .upsampleShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/bloom_upsample_gles3.frag.glsl"}),
+    };
+#else
+    const fs::path vertexShaderPath{"assets/shaders/fullscreen_gl4.vert.glsl"};
+    return PendingShaders{
+        .downsampleShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/bloom_downsample_gl4.frag.glsl"}),
+        .upsampleShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/bloom_upsample_gl4.frag.glsl"}),
+    };
+#endif
+}
+
+bool Bloom::init(PendingShaders&& shaders)
+{
+    downsampleShader_ = shaders.downsampleShader.finish();
+    upsampleShader_ = shaders.upsampleShader.finish();
+    if (!downsampleShader_ || !upsampleShader_)
+    {
+        return false;
+    }
+    downsampleUniforms_ = getPassUniforms(downsampleShader_.value());
+    upsampleUniforms_ = getPassUniforms(upsampleShader_.value());
+    karisAverageUniform_
+        = downsampleShader_->getUniformHandle<bool>("u_karisAverage");
+    return true;
+}
+
+Bloom::PassUniforms Bloom::getPassUniforms(const Shader& shader)
+{
+    return PassUniforms{
+        .source = shader.getUniformHandle<int>("u_source"),
+        .texCoordScale = shader.getUniformHandle<glm::vec2>("u_texCoordScale"),
+        .texelSize = shader.getUniformHandle<glm::vec2>("u_texelSize"),
+        .maxTexCoord = shader.getUniformHandle<glm::vec2>("u_maxTexCoord"),
+    };
+}
+
+glm::ivec2 Bloom::getLevelSize(glm::ivec2 frameBufferSize, size_t level)
+{
+    glm::ivec2 levelSize = frameBufferSize;
+    for (size_t i = 0; i <= level; ++i)
+    {
+        levelSize = glm::max(levelSize / 2, glm::ivec2{1});
+    }
+    return levelSize;
+}
+
+TextureRegion Bloom::draw(
+    const TextureRegion& scene,
+    std::span<const FrameGraph::Target, LEVEL_COUNT> targets,
+    GLuint emptyVertexArray,
+    GlStateCache& glState)
+{
+    // Levels follow the scene size of the frame within their storage
+    std::array<Level, LEVEL_COUNT> levels;
+    glm::ivec2 levelSize = scene.size;
+    for (size_t i = 0; i < LEVEL_COUNT; ++i)
+    {
+        levelSize = glm::max(levelSize / 2, glm::ivec2{1});
+        levels[i] = Level{
+            .texture = targets[i].texture,
+            .framebuffer = targets[i].framebuffer,
+            .size = glm::min(levelSize, targets[i].textureSize),
+            .textureSize = targets[i].textureSize,
+        };
+    }
+    const auto toRegion = [](const Level& level)
+    {
+        return TextureRegion{.texture = level.texture,
+                             .size = level.size,
+                             .textureSize = level.textureSize};
+    };
+
+    glDisable(GL_DEPTH_TEST);
+    glState.setColorWriteEnabled(true);
+    glState.setBlendEnabled(false);
+    glState.bindVertexArray(emptyVertexArray);
+
+    // Every pixel of each level is replaced on the way down. Only the first
+    // level filters the scene against fireflies.
+    downsampleShader_->use(glState);
+    downsampleShader_->setUniform(downsampleUniforms_.source,
+                                  static_cast<int>(SOURCE_TEXTURE_UNIT));
+    downsampleShader_->setUniform(karisAverageUniform_, true);
+    drawPass(downsampleShader_.value(),
+             downsampleUniforms_,
+             scene,
+             levels[0],
+             glState);
+    downsampleShader_->setUniform(karisAverageUniform_, false);
+    for (size_t i = 1; i < LEVEL_COUNT; ++i)
+    {
+        drawPass(downsampleShader_.value(),
+                 downsampleUniforms_,
+                 toRegion(levels[i - 1]),
+                 levels[i],
+                 glState);
+    }
+
+    // On the way up, each blurred level is added onto the one before it
+    glState.setBlendEnabled(true);
+    glState.setBlendFunc(GL_ONE, GL_ONE);
+    upsampleShader_->use(glState);
+    upsampleShader_->setUniform(upsampleUniforms_.source,
+                                static_cast<int>(SOURCE_TEXTURE_UNIT));
+    for (size_t i = LEVEL_COUNT - 1; i > 0; --i)
+    {
+        drawPass(upsampleShader_.value(),
+                 upsampleUniforms_,
+                 toRegion(levels[i]),
+                 levels[i - 1],
+                 glState);
+    }
+    // Scene is drawn without blending
+    glState.setBlendEnabled(false);
+    return toRegion(levels[0]);
+}
+
+void Bloom::drawPass(Shader& shader,
+                     const PassUniforms& uniforms,
+                     const TextureRegion& source,
+                     const Level& destination,
+                     GlStateCache& glState)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, destination.framebuffer);
+    glViewport(0, 0, destination.size.x, destination.size.y);
+    glState.bindTexture(SOURCE_TEXTURE_UNIT, GL_TEXTURE_2D, source.texture);
+    // Samples are kept half a texel inside the source rectangle, so that
+    // filtering never reads pixels left over from larger scene sizes
+    const glm::vec2 texelSize = 1.0F / glm::vec2{source.textureSize};
+    shader.setUniform(uniforms.texCoordScale,
+                      glm::vec2{source.size} * texelSize
+                          / glm::vec2{destination.size});
+    shader.setUniform(uniforms.texelSize, texelSize);
+    shader.setUniform(uniforms.maxTexCoord,
+                      (glm::vec2{source.size} - 0.5F) * texelSize);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
@@ -0,0 +1,124 @@
+#ifndef BLOOM_H_
+#define BLOOM_H_
+
+#include "framegraph.h"
+#include "glstatecache.h"
+#include "rendertarget.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/vec2.hpp"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+/// Bloom of bright light bleeding into its surroundings, like scattering in
+/// the lens of a camera.
+///
+/// High dynamic range scene is filtered down a chain of progressively
+/// smaller mip levels, each half the size of the previous one, and the chain
+/// is then filtered back up, adding each level onto the larger one before
+/// it. Light gets blurred over a wide radius at the cost of a few small
+/// passes, instead of sampling a large kernel at full resolution. Brightness
+/// is not thresholded, so light spreads in proportion to its intensity, and
+/// the result is mixed with the scene while tonemapping.
+///
+/// The first downsample averages samples weighted by inverse luma, keeping
+/// single very bright pixels from flickering as they move between pixels.
+///
+/// All passes are fullscreen fragment shader passes, supported in OpenGL ES
+/// 3.0 as well. Levels only live while bloom is drawn, and are transient
+/// textures of the frame graph. Like the scene framebuffer, levels are sized
+/// for the full window and drawn into at their bottom-left corner.
+///
+/// Non-copyable, non-movable.
+class Bloom
+{
+public:
+    /// Mip levels in the chain. Light spreads over a radius of about a
+    /// sixtieth of the screen from the smallest one.
+    static constexpr size_t LEVEL_COUNT = 6;
+
+    /// Shaders of downsample and upsample passes submitted for compilation.
+    struct PendingShaders
+    {
+        PendingShader downsampleShader;
+        PendingShader upsampleShader;
+    };
+
+    Bloom() = default;
+    Bloom(const Bloom&) = delete;
+    Bloom& operator=(const Bloom&) = delete;
+    Bloom(Bloom&&) = delete;
+    Bloom& operator=(Bloom&&) = delete;
+
+    /// Submit shaders for compilation without waiting for the driver to
+    /// finish.
+    static PendingShaders submitShaders();
+
+    /// Finish compilation of submitted shaders.
+    bool init(PendingShaders&& shaders);
+
+    /// Storage size of given level for window framebuffer of given size.
+    /// Levels have the color format of the scene, and are filtered
+    /// bilinearly when sampled by the next pass.
+    [[nodiscard]] static glm::ivec2 getLevelSize(glm::ivec2 frameBufferSize,
+                                                 size_t level);
+
+    /// Blur given scene down and back up the mip chain drawn into targets of
+    /// the levels, returning the largest level at half the size of the
+    /// scene. Framebuffer, viewport and depth test are left changed for the
+    /// caller to restore, blending is left disabled.
+    TextureRegion draw(
+        const TextureRegion& scene,
+        std::span<const FrameGraph::Target, LEVEL_COUNT> targets,
+        GLuint emptyVertexArray,
+        GlStateCache& glState);
+
+private:
+    /// Level of the chain with its framebuffer, and the size it is drawn at
+    /// in the current frame.
+    struct Level
+    {
+        GLuint texture;
+        GLuint framebuffer;
+        glm::ivec2 size;
+        glm::ivec2 textureSize;
+    };
+
+    /// Uniforms mapping fragments of the destination onto the source, shared
+    /// by both passes.
+    struct PassUniforms
+    {
+        UniformHandle<int> source;
+        UniformHandle<glm::vec2> texCoordScale;
+        UniformHandle<glm::vec2> texelSize;
+        UniformHandle<glm::vec2> maxTexCoord;
+    };
+
+    static PassUniforms getPassUniforms(const Shader& shader);
+
+    /// Draw source into the bottom-left rectangle of destination with given
+    /// shader in use, mapping fragments of the destination onto the whole
+    /// source rectangle.
+    static void drawPass(Shader& shader,
+                         const PassUniforms& uniforms,
+                         const TextureRegion& source,
+                         const Level& destination,
+                         GlStateCache& glState);
+
+    std::optional<Shader> downsampleShader_;
+    std::optional<Shader> upsampleShader_;
+    PassUniforms downsampleUniforms_;
+    PassUniforms upsampleUniforms_;
+    UniformHandle<bool> karisAverageUniform_;
+};
+
+#endif
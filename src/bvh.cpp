@@ -0,0 +1,568 @@
+#include "bvh.h"
+
+#include "profiler.h"
+#include "threadpool.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace
+{
+/// Candidate split positions evaluated per axis. More bins find slightly
+/// better splits at the cost of longer builds.
+constexpr size_t BIN_COUNT = 16;
+/// Nodes with more triangles are always split, even when the surface area
+/// heuristic would prefer a leaf.
+constexpr std::uint32_t MAX_LEAF_TRIANGLE_COUNT = 8;
+/// Cost of visiting a node relative to intersecting a triangle.
+constexpr float TRAVERSAL_COST = 1.0F;
+/// Subtrees with fewer triangles are built on the thread building their
+/// parent, as a task would cost more than it gains.
+constexpr std::uint32_t PARALLEL_MIN_TRIANGLE_COUNT = 16384;
+/// Triangles whose bounds are computed by a single thread pool task.
+constexpr size_t BOUNDS_BATCH_SIZE = 16384;
+/// Leaves refit by a single thread pool task.
+constexpr size_t REFIT_BATCH_SIZE = 1024;
+/// Nodes deeper than this are split at the median instead, which halves the
+/// triangles at every level. Keeps the hierarchy shallow enough for the fixed
+/// size traversal stack on degenerate input.
+constexpr size_t MAX_SAH_DEPTH = 64;
+/// Median splits of 2^32 triangles add 32 levels at most.
+constexpr size_t MAX_DEPTH = MAX_SAH_DEPTH + 32;
+
+constexpr float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+
+struct Aabb
+{
+    glm::vec3 minimum{INFINITE_DISTANCE};
+    glm::vec3 maximum{-INFINITE_DISTANCE};
+
+    void grow(const glm::vec3& point)
+    {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+    }
+
+    void grow(const Aabb& other)
+    {
+        minimum = glm::min(minimum, other.minimum);
+        maximum = glm::max(maximum, other.maximum);
+    }
+
+    /// Half of the surface area, which is all that ratios of areas need.
+    [[nodiscard]] float halfArea() const
+    {
+        const glm::vec3 extent = glm::max(maximum - minimum, glm::vec3{0.0F});
+        return extent.x * extent.y + extent.y * extent.z
+             + extent.z * extent.x;
+    }
+};
+
+struct Bin
+{
+    Aabb bounds;
+    std::uint32_t triangleCount = 0;
+};
+
+/// Builds nodes into preallocated storage, so that subtrees built on
+/// separate threads only allocate node indices, never reallocate nodes.
+class Builder
+{
+public:
+    Builder(std::span<const glm::vec3> positions,
+            std::span<const GLuint> indices,
+            ThreadPool* threadPool,
+            std::vector<BvhNode>& nodes,
+            std::vector<GLuint>& triangles)
+        : positions_{positions}
+        , indices_{indices}
+        , threadPool_{threadPool}
+        , nodes_{nodes}
+        , triangles_{triangles}
+        , nodeCount_{1}
+    {
+    }
+
+    void build()
+    {
+        const size_t triangleCount = indices_.size() / 3;
+        triangles_.resize(triangleCount);
+        triangleBounds_.resize(triangleCount);
+        centroids_.resize(triangleCount);
+        const auto computeBounds = [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                triangles_[i] = static_cast<GLuint>(i);
+                Aabb& bounds = triangleBounds_[i];
+                bounds = {};
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    bounds.grow(positions_[indices_[i * 3 + corner]]);
+                }
+                centroids_[i] = (bounds.minimum + bounds.maximum) * 0.5F;
+            }
+        };
+        if (threadPool_)
+        {
+            threadPool_->parallelFor(triangleCount,
+                                     BOUNDS_BATCH_SIZE,
+                                     computeBounds);
+        }
+        else
+        {
+            computeBounds(0, triangleCount);
+        }
+
+        // Every leaf holds at least one triangle, bounding node count
+        nodes_.resize(std::max<size_t>(triangleCount * 2, 2) - 1);
+        buildNode(0, 0, static_cast<std::uint32_t>(triangleCount), 0);
+        if (threadPool_)
+        {
+            threadPool_->wait(tasks_);
+        }
+        nodes_.resize(nodeCount_.load(std::memory_order_relaxed));
+    }
+
+private:
+    void buildNode(std::uint32_t nodeIndex,
+                   std::uint32_t begin,
+                   std::uint32_t end,
+                   size_t depth)
+    {
+        Aabb bounds;
+        Aabb centroidBounds;
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            bounds.grow(triangleBounds_[triangles_[i]]);
+            centroidBounds.grow(centroids_[triangles_[i]]);
+        }
+        BvhNode& node = nodes_[nodeIndex];
+        node.minimum = bounds.minimum;
+        node.maximum = bounds.maximum;
+        node.first = begin;
+        node.triangleCount = end - begin;
+
+        const std::uint32_t triangleCount = end - begin;
+        if (triangleCount <= 1)
+        {
+            return;
+        }
+        const std::uint32_t middle
+            = depth < MAX_SAH_DEPTH
+                ? partitionBySah(begin, end, bounds, centroidBounds)
+                : partitionByMedian(begin, end, centroidBounds);
+        if (middle == begin)
+        {
+            return;
+        }
+
+        const std::uint32_t firstChild
+            = nodeCount_.fetch_add(2, std::memory_order_relaxed);
+        node.first = firstChild;
+        node.triangleCount = 0;
+        if (threadPool_ && triangleCount >= PARALLEL_MIN_TRIANGLE_COUNT)
+        {
+            threadPool_->submit(
+                tasks_,
+                [this, firstChild, begin, middle, depth]()
+                {
+                    PROFILE_SCOPE("bvh::buildSubtree");
+                    buildNode(firstChild, begin, middle, depth + 1);
+                });
+        }
+        else
+        {
+            buildNode(firstChild, begin, middle, depth + 1);
+        }
+        buildNode(firstChild + 1, middle, end, depth + 1);
+    }
+
+    /// Reorder triangles of range around the cheapest binned split and return
+    /// where the second child starts. Returns begin when a leaf is cheaper.
+    std::uint32_t partitionBySah(std::uint32_t begin,
+                                 std::uint32_t end,
+                                 const Aabb& bounds,
+                                 const Aabb& centroidBounds)
+    {
+        const std::uint32_t triangleCount = end - begin;
+        float bestCost = INFINITE_DISTANCE;
+        int bestAxis = -1;
+        size_t bestSplit = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float minimum = centroidBounds.minimum[axis];
+            const float extent = centroidBounds.maximum[axis] - minimum;
+            if (extent <= 0.0F)
+            {
+                continue;
+            }
+            const float scale = static_cast<float>(BIN_COUNT) / extent;
+            std::array<Bin, BIN_COUNT> bins{};
+            for (std::uint32_t i = begin; i < end; ++i)
+            {
+                const GLuint triangle = triangles_[i];
+                Bin& bin = bins[binIndex(centroids_[triangle][axis],
+                                         minimum,
+                                         scale)];
+                bin.bounds.grow(triangleBounds_[triangle]);
+                ++bin.triangleCount;
+            }
+
+            // Costs of the right side of each split are swept from the
+            // right, then combined with the left side swept from the left
+            std::array<float, BIN_COUNT - 1> rightCosts{};
+            Aabb rightBounds;
+            std::uint32_t rightCount = 0;
+            for (size_t split = BIN_COUNT - 1; split > 0; --split)
+            {
+                rightBounds.grow(bins[split].bounds);
+                rightCount += bins[split].triangleCount;
+                rightCosts[split - 1]
+                    = rightBounds.halfArea() * static_cast<float>(rightCount);
+            }
+            Aabb leftBounds;
+            std::uint32_t leftCount = 0;
+            for (size_t split = 0; split < BIN_COUNT - 1; ++split)
+            {
+                leftBounds.grow(bins[split].bounds);
+                leftCount += bins[split].triangleCount;
+                const float cost
+                    = leftBounds.halfArea() * static_cast<float>(leftCount)
+                    + rightCosts[split];
+                if (leftCount > 0 && leftCount < triangleCount
+                    && cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // Costs are relative to the area of the node, which the probability
+        // of a ray hitting each child is divided by
+        const float area = bounds.halfArea();
+        const float leafCost = static_cast<float>(triangleCount) * area;
+        const float splitCost = TRAVERSAL_COST * area + bestCost;
+        if (triangleCount <= MAX_LEAF_TRIANGLE_COUNT && leafCost <= splitCost)
+        {
+            return begin;
+        }
+        // Centroids coincide, so no split separates them
+        if (bestAxis < 0)
+        {
+            return triangleCount <= MAX_LEAF_TRIANGLE_COUNT
+                     ? begin
+                     : begin + triangleCount / 2;
+        }
+
+        const float minimum = centroidBounds.minimum[bestAxis];
+        const float scale
+            = static_cast<float>(BIN_COUNT)
+            / (centroidBounds.maximum[bestAxis] - minimum);
+        const auto middle = std::partition(
+            triangles_.begin() + begin,
+            triangles_.begin() + end,
+            [&](GLuint triangle)
+            {
+                return binIndex(centroids_[triangle][bestAxis],
+                                minimum,
+                                scale)
+                    <= bestSplit;
+            });
+        return static_cast<std::uint32_t>(middle - triangles_.begin());
+    }
+
+    /// Reorder triangles of range around the median centroid along the
+    /// longest axis and return where the second child starts.
+    std::uint32_t partitionByMedian(std::uint32_t begin,
+                                    std::uint32_t end,
+                                    const Aabb& centroidBounds)
+    {
+        const glm::vec3 extent
+            = centroidBounds.maximum - centroidBounds.minimum;
+        const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                       : extent.y >= extent.z                        ? 1
+                                                                     : 2;
+        const std::uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(triangles_.begin() + begin,
+                         triangles_.begin() + middle,
+                         triangles_.begin() + end,
+                         [&](GLuint first, GLuint second)
+                         {
+                             return centroids_[first][axis]
+                                  < centroids_[second][axis];
+                         });
+        return middle;
+    }
+
+    static size_t binIndex(float position, float minimum, float scale)
+    {
+        return std::min(static_cast<size_t>((position - minimum) * scale),
+                        BIN_COUNT - 1);
+    }
+
+    std::span<const glm::vec3> positions_;
+    std::span<const GLuint> indices_;
+    ThreadPool* threadPool_;
+    std::vector<BvhNode>& nodes_;
+    std::vector<GLuint>& triangles_;
+    std::vector<Aabb> triangleBounds_;
+    std::vector<glm::vec3> centroids_;
+    /// Nodes allocated so far, the root being the first.
+    std::atomic<std::uint32_t> nodeCount_;
+    /// Subtrees built on the thread pool.
+    TaskCounter tasks_;
+};
+
+/// Distance at which ray enters node bounds, or infinity when it misses them
+/// or only enters them beyond the closest hit so far.
+float intersectBounds(const BvhNode& node,
+                      const glm::vec3& origin,
+                      const glm::vec3& inverseDirection,
+                      float closestDistance)
+{
+    const glm::vec3 t0 = (node.minimum - origin) * inverseDirection;
+    const glm::vec3 t1 = (node.maximum - origin) * inverseDirection;
+    const glm::vec3 slabEnter = glm::min(t0, t1);
+    const glm::vec3 slabExit = glm::max(t0, t1);
+    const float enter
+        = std::max({slabEnter.x, slabEnter.y, slabEnter.z, 0.0F});
+    const float exit
+        = std::min({slabExit.x, slabExit.y, slabExit.z, closestDistance});
+    return enter <= exit ? enter : INFINITE_DISTANCE;
+}
+}  // namespace
+
+namespace bvh
+{
+void build(std::span<const glm::vec3> positions,
+           std::span<const GLuint> indices,
+           ThreadPool* threadPool,
+           std::vector<BvhNode>& outNodes,
+           std::vector<GLuint>& outTriangles)
+{
+    PROFILE_SCOPE("bvh::build");
+    outNodes.clear();
+    outTriangles.clear();
+    if (indices.size() < 3)
+    {
+        return;
+    }
+    Builder builder{positions, indices, threadPool, outNodes, outTriangles};
+    builder.build();
+}
+
+void findParents(std::span<const BvhNode> nodes,
+                 std::vector<std::uint32_t>& outParents)
+{
+    outParents.assign(nodes.size(), 0);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const BvhNode& node = nodes[i];
+        if (node.triangleCount == 0 && node.first > i)
+        {
+            outParents[node.first] = static_cast<std::uint32_t>(i);
+            outParents[node.first + 1] = static_cast<std::uint32_t>(i);
+        }
+    }
+}
+
+void refit(std::span<BvhNode> nodes,
+           std::span<const GLuint> triangles,
+           std::span<const glm::vec3> positions,
+           std::span<const GLuint> indices,
+           std::span<const std::uint32_t> parents,
+           std::vector<std::uint32_t>& dirtyNodes,
+           ThreadPool* threadPool)
+{
+    PROFILE_SCOPE("bvh::refit");
+    const auto refitLeaves = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            BvhNode& node = nodes[dirtyNodes[i]];
+            if (node.triangleCount == 0)
+            {
+                continue;
+            }
+            Aabb bounds;
+            for (std::uint32_t j = 0; j < node.triangleCount; ++j)
+            {
+                const GLuint triangle = triangles[node.first + j];
+                for (size_t corner = 0; corner < 3; ++corner)
+                {
+                    bounds.grow(positions[indices[triangle * 3 + corner]]);
+                }
+            }
+            node.minimum = bounds.minimum;
+            node.maximum = bounds.maximum;
+        }
+    };
+    if (threadPool)
+    {
+        threadPool->parallelFor(dirtyNodes.size(),
+                                REFIT_BATCH_SIZE,
+                                refitLeaves);
+    }
+    else
+    {
+        refitLeaves(0, dirtyNodes.size());
+    }
+
+    // Children come after their parent, so that taking nodes from highest
+    // index down refits both children before their parent. Each node is
+    // taken once and queues its parent in turn.
+    std::ranges::make_heap(dirtyNodes);
+    std::optional<std::uint32_t> previousNode;
+    while (!dirtyNodes.empty())
+    {
+        std::ranges::pop_heap(dirtyNodes);
+        const std::uint32_t nodeIndex = dirtyNodes.back();
+        dirtyNodes.pop_back();
+        if (nodeIndex == previousNode)
+        {
+            continue;
+        }
+        previousNode = nodeIndex;
+        BvhNode& node = nodes[nodeIndex];
+        if (node.triangleCount == 0)
+        {
+            const BvhNode& left = nodes[node.first];
+            const BvhNode& right = nodes[node.first + 1];
+            node.minimum = glm::min(left.minimum, right.minimum);
+            node.maximum = glm::max(left.maximum, right.maximum);
+        }
+        if (nodeIndex != 0)
+        {
+            dirtyNodes.push_back(parents[nodeIndex]);
+            std::ranges::push_heap(dirtyNodes);
+        }
+    }
+}
+
+std::optional<Hit> intersect(std::span<const BvhNode> nodes,
+                             std::span<const GLuint> triangles,
+                             std::span<const glm::vec3> positions,
+                             std::span<const GLuint> indices,
+                             const Ray& ray)
+{
+    if (nodes.empty())
+    {
+        return std::nullopt;
+    }
+    // Division by zero components yields infinities, which slab tests handle
+    const glm::vec3 inverseDirection = 1.0F / ray.direction;
+    std::optional<Hit> closestHit;
+    float closestDistance = ray.maxDistance;
+
+    struct StackEntry
+    {
+        std::uint32_t node;
+        float distance;
+    };
+    // Nearer child is visited first, so the stack holds at most one sibling
+    // per level
+    std::array<StackEntry, MAX_DEPTH + 1> stack;
+    size_t stackSize = 0;
+    const float rootDistance = intersectBounds(nodes[0],
+                                               ray.origin,
+                                               inverseDirection,
+                                               closestDistance);
+    if (rootDistance != INFINITE_DISTANCE)
+    {
+        stack[stackSize++] = {0, rootDistance};
+    }
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+        // Closer hit was found since the node was pushed
+        if (entry.distance > closestDistance)
+        {
+            continue;
+        }
+        const BvhNode& node = nodes[entry.node];
+        if (node.triangleCount > 0)
+        {
+            // Möller-Trumbore intersection, solving for distance and
+            // barycentric coordinates at once
+            for (std::uint32_t i = 0; i < node.triangleCount; ++i)
+            {
+                const GLuint triangle = triangles[node.first + i];
+                const GLuint* corners = &indices[triangle * 3];
+                const glm::vec3& p0 = positions[corners[0]];
+                const glm::vec3 edge1 = positions[corners[1]] - p0;
+                const glm::vec3 edge2 = positions[corners[2]] - p0;
+                const glm::vec3 p = glm::cross(ray.direction, edge2);
+                const float determinant = glm::dot(edge1, p);
+                // Ray is parallel to the triangle plane
+                if (determinant == 0.0F)
+                {
+                    continue;
+                }
+                const float inverseDeterminant = 1.0F / determinant;
+                const glm::vec3 s = ray.origin - p0;
+                const float u = glm::dot(s, p) * inverseDeterminant;
+                if (u < 0.0F || u > 1.0F)
+                {
+                    continue;
+                }
+                const glm::vec3 q = glm::cross(s, edge1);
+                const float v
+                    = glm::dot(ray.direction, q) * inverseDeterminant;
+                if (v < 0.0F || u + v > 1.0F)
+                {
+                    continue;
+                }
+                const float distance
+                    = glm::dot(edge2, q) * inverseDeterminant;
+                if (distance < 0.0F || distance >= closestDistance)
+                {
+                    continue;
+                }
+                closestDistance = distance;
+                closestHit = Hit{
+                    .distance = distance,
+                    .triangle = triangle,
+                    .u = u,
+                    .v = v,
+                };
+            }
+            continue;
+        }
+
+        std::uint32_t nearChild = node.first;
+        std::uint32_t farChild = node.first + 1;
+        float nearDistance = intersectBounds(nodes[nearChild],
+                                             ray.origin,
+                                             inverseDirection,
+                                             closestDistance);
+        float farDistance = intersectBounds(nodes[farChild],
+                                            ray.origin,
+                                            inverseDirection,
+                                            closestDistance);
+        if (farDistance < nearDistance)
+        {
+            std::swap(nearChild, farChild);
+            std::swap(nearDistance, farDistance);
+        }
+        if (farDistance != INFINITE_DISTANCE)
+        {
+            stack[stackSize++] = {farChild, farDistance};
+        }
+        if (nearDistance != INFINITE_DISTANCE)
+        {
+            stack[stackSize++] = {nearChild, nearDistance};
+        }
+    }
+    return closestHit;
+}
+}  // namespace bvh
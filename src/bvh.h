@@ -0,0 +1,84 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include "mesh.h"
+
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+/// Bounding volume hierarchy over mesh triangles, answering ray queries
+/// against the actual geometry instead of bounding volumes.
+///
+/// Nodes are split along the axis and position minimizing the surface area
+/// heuristic, evaluated over a fixed number of bins of triangle centroids, so
+/// that building stays linear in triangle count per level. Leaves keep
+/// triangles in a separate index array instead of reordering the mesh, whose
+/// triangle order is tuned for drawing.
+namespace bvh
+{
+/// Ray with direction of any nonzero length. Hit distances are measured in
+/// multiples of direction length.
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance;
+};
+
+/// Nearest triangle hit by a ray.
+struct Hit
+{
+    float distance;
+    /// Triangle in the order of indices, not of the hierarchy.
+    GLuint triangle;
+    /// Barycentric coordinates of the hit point relative to the second and
+    /// third vertex of the triangle.
+    float u;
+    float v;
+};
+
+/// Build hierarchy over triangles given by every three indices into
+/// positions. Large subtrees are built in parallel on the thread pool when
+/// given. Nodes are written with the root first, along with the triangle
+/// order leaves refer to.
+void build(std::span<const glm::vec3> positions,
+           std::span<const GLuint> indices,
+           ThreadPool* threadPool,
+           std::vector<BvhNode>& outNodes,
+           std::vector<GLuint>& outTriangles);
+
+/// Parent of every node, for refitting. The root is its own parent.
+void findParents(std::span<const BvhNode> nodes,
+                 std::vector<std::uint32_t>& outParents);
+
+/// Update bounds of given nodes and all of their ancestors to moved positions,
+/// keeping the tree topology. Far cheaper than rebuilding, at the cost of
+/// slower queries once triangles moved far from where they were split.
+///
+/// Leaves are refit on the thread pool when given. The node list is used up
+/// while queueing ancestors, keeping its storage for reuse between calls.
+void refit(std::span<BvhNode> nodes,
+           std::span<const GLuint> triangles,
+           std::span<const glm::vec3> positions,
+           std::span<const GLuint> indices,
+           std::span<const std::uint32_t> parents,
+           std::vector<std::uint32_t>& dirtyNodes,
+           ThreadPool* threadPool);
+
+/// Nearest triangle hit by ray within its maximum distance, if any. Geometry
+/// has to be the same the hierarchy was built from. Triangles are hit from
+/// both sides.
+std::optional<Hit> intersect(std::span<const BvhNode> nodes,
+                             std::span<const GLuint> triangles,
+                             std::span<const glm::vec3> positions,
+                             std::span<const GLuint> indices,
+                             const Ray& ray);
+}  // namespace bvh
+
+#endif
@@ -0,0 +1,434 @@
+#include "clusterlod.h"
+
+#include "meshsimplifier.h"
+
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace
+{
+/// Meshlet limits matching the common recommendation for mesh shaders, which
+/// keeps meshlets small enough for fine-grained selection.
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+/// Meshlets simplified together. Groups have to be large enough for their
+/// locked borders to leave interior vertices to collapse, otherwise
+/// simplification stalls after the first few levels.
+constexpr size_t GROUP_SIZE = 16;
+
+/// Groups whose triangle count could not be reduced below this fraction are
+/// left as they are, because the next level would barely be coarser.
+constexpr float MAX_SIMPLIFIED_RATIO = 0.85F;
+
+constexpr uint32_t NO_GROUP = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t SHARED_BY_GROUPS = NO_GROUP - 1;
+
+struct Sphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+/// Smallest sphere enclosing both spheres.
+Sphere mergeSpheres(const Sphere& a, const Sphere& b)
+{
+    const glm::vec3 offset = b.center - a.center;
+    const float distance = glm::length(offset);
+    if (distance + b.radius <= a.radius)
+    {
+        return a;
+    }
+    if (distance + a.radius <= b.radius)
+    {
+        return b;
+    }
+    const float radius = (distance + a.radius + b.radius) * 0.5F;
+    return Sphere{
+        .center = a.center + offset * ((radius - a.radius) / distance),
+        .radius = radius,
+    };
+}
+
+/// Sphere around bounding box center enclosing positions referenced by range
+/// of indices.
+Sphere computeSphere(std::span<const GLuint> indices,
+                     std::span<const Vertex> vertices)
+{
+    glm::vec3 minimum{std::numeric_limits<float>::max()};
+    glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+    for (const GLuint index : indices)
+    {
+        minimum = glm::min(minimum, vertices[index].position);
+        maximum = glm::max(maximum, vertices[index].position);
+    }
+
+    const glm::vec3 center = (minimum + maximum) * 0.5F;
+    float radius = 0.0F;
+    for (const GLuint index : indices)
+    {
+        radius = std::max(radius,
+                          glm::length(vertices[index].position - center));
+    }
+    return Sphere{.center = center, .radius = radius};
+}
+
+/// Split range of triangles greedily into meshlets in their existing order,
+/// so that triangles adjacent in vertex cache order end up together. Self
+/// bounds and error of created meshlets are set to the given ones.
+void appendMeshlets(std::span<const GLuint> indices,
+                    GLuint firstIndex,
+                    GLuint indexCount,
+                    const Sphere& bounds,
+                    float error,
+                    std::vector<Meshlet>& outMeshlets)
+{
+    std::array<GLuint, MESHLET_MAX_VERTICES> meshletVertices{};
+    size_t vertexCount = 0;
+    GLuint meshletFirstIndex = firstIndex;
+
+    const auto emitMeshlet = [&](GLuint end)
+    {
+        if (end == meshletFirstIndex)
+        {
+            return;
+        }
+        outMeshlets.push_back(Meshlet{
+            .firstIndex = meshletFirstIndex,
+            .indexCount = end - meshletFirstIndex,
+            .center = bounds.center,
+            .radius = bounds.radius,
+            .error = error,
+            .parentCenter = bounds.center,
+            .parentRadius = bounds.radius,
+            .parentError = lod::UNBOUNDED_ERROR,
+        });
+        meshletFirstIndex = end;
+        vertexCount = 0;
+    };
+
+    const auto contains = [&](GLuint index)
+    {
+        const auto first = meshletVertices.cbegin();
+        const auto last = first + static_cast<std::ptrdiff_t>(vertexCount);
+        return std::find(first, last, index) != last;
+    };
+
+    const GLuint end = firstIndex + indexCount;
+    for (GLuint i = firstIndex; i < end; i += 3)
+    {
+        // Vertices repeated within a degenerate triangle are counted twice,
+        // which only makes the meshlet end slightly early
+        size_t newVertexCount = 0;
+        for (GLuint corner = 0; corner < 3; ++corner)
+        {
+            newVertexCount += contains(indices[i + corner]) ? 0 : 1;
+        }
+        if (vertexCount + newVertexCount > MESHLET_MAX_VERTICES
+            || (i - meshletFirstIndex) / 3 >= MESHLET_MAX_TRIANGLES)
+        {
+            emitMeshlet(i);
+        }
+
+        for (GLuint corner = 0; corner < 3; ++corner)
+        {
+            if (!contains(indices[i + corner]))
+            {
+                meshletVertices[vertexCount++] = indices[i + corner];
+            }
+        }
+    }
+    emitMeshlet(end);
+}
+
+/// Interleave bits of 10-bit coordinates.
+uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+    const auto spread = [](uint32_t v)
+    {
+        v = (v | (v << 16U)) & 0x030000FFU;
+        v = (v | (v << 8U)) & 0x0300F00FU;
+        v = (v | (v << 4U)) & 0x030C30C3U;
+        v = (v | (v << 2U)) & 0x09249249U;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1U) | (spread(z) << 2U);
+}
+
+/// Order of points along a Morton curve through their bounding box, which
+/// keeps points consecutive in the order close to each other.
+std::vector<size_t> computeMortonOrder(std::span<const glm::vec3> points)
+{
+    glm::vec3 minimum{std::numeric_limits<float>::max()};
+    glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+    for (const glm::vec3& point : points)
+    {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+    }
+    const glm::vec3 extent = glm::max(maximum - minimum, glm::vec3{1e-6F});
+    const auto quantize = [](float v)
+    { return static_cast<uint32_t>(std::clamp(v, 0.0F, 1.0F) * 1023.0F); };
+
+    std::vector<std::pair<uint32_t, size_t>> codes;
+    codes.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const glm::vec3 normalized = (points[i] - minimum) / extent;
+        codes.emplace_back(mortonCode(quantize(normalized.x),
+                                      quantize(normalized.y),
+                                      quantize(normalized.z)),
+                           i);
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<size_t> order;
+    order.reserve(codes.size());
+    for (const auto& [code, i] : codes)
+    {
+        order.push_back(i);
+    }
+    return order;
+}
+
+/// Order meshlets of a level by the centers of their triangles, so that
+/// consecutive meshlets can be grouped. Self bounds are not used, because they
+/// are shared by all meshlets of the same group, which would keep grouping
+/// them together again and prevent simplification across group borders of
+/// the previous level.
+void sortMeshlets(std::vector<size_t>& level,
+                  std::span<const Meshlet> meshlets,
+                  std::span<const GLuint> indices,
+                  std::span<const Vertex> vertices)
+{
+    std::vector<glm::vec3> centers;
+    centers.reserve(level.size());
+    for (const size_t meshlet : level)
+    {
+        centers.push_back(computeSphere(indices.subspan(
+                                            meshlets[meshlet].firstIndex,
+                                            meshlets[meshlet].indexCount),
+                                        vertices)
+                              .center);
+    }
+
+    const std::vector<size_t> order = computeMortonOrder(centers);
+    std::vector<size_t> sorted;
+    sorted.reserve(level.size());
+    for (const size_t i : order)
+    {
+        sorted.push_back(level[i]);
+    }
+    level.swap(sorted);
+}
+
+/// Order triangles by their centroids, so that meshlets split from them are
+/// compact patches. Simplified triangles lose the vertex cache order of the
+/// original ones and would otherwise form scattered meshlets with most of
+/// their vertices shared with other groups, which locks them from further
+/// simplification.
+void sortTriangles(std::vector<GLuint>& indices,
+                   std::span<const Vertex> vertices)
+{
+    std::vector<glm::vec3> centroids;
+    centroids.reserve(indices.size() / 3);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        centroids.push_back((vertices[indices[i]].position
+                             + vertices[indices[i + 1]].position
+                             + vertices[indices[i + 2]].position)
+                            / 3.0F);
+    }
+
+    const std::vector<size_t> order = computeMortonOrder(centroids);
+    std::vector<GLuint> sorted;
+    sorted.reserve(indices.size());
+    for (const size_t triangle : order)
+    {
+        const auto first
+            = indices.begin() + static_cast<std::ptrdiff_t>(3 * triangle);
+        sorted.insert(sorted.end(), first, first + 3);
+    }
+    indices.swap(sorted);
+}
+}  // namespace
+
+namespace clusterlod
+{
+void build(std::span<const Vertex> vertices,
+           std::vector<GLuint>& indices,
+           Submesh& submesh,
+           std::vector<Meshlet>& meshlets)
+{
+    const std::vector<GLuint> positionRemap
+        = meshsimplifier::generatePositionRemap(vertices);
+    const size_t firstMeshlet = meshlets.size();
+
+    // Full detail meshlets have tight bounds of their own, while meshlets of
+    // coarser levels share the bounds of their group
+    appendMeshlets(indices,
+                   submesh.firstIndex,
+                   submesh.indexCount,
+                   Sphere{},
+                   0.0F,
+                   meshlets);
+    std::vector<size_t> level;
+    for (size_t i = firstMeshlet; i < meshlets.size(); ++i)
+    {
+        Meshlet& meshlet = meshlets[i];
+        const Sphere sphere = computeSphere(
+            std::span{indices}.subspan(meshlet.firstIndex, meshlet.indexCount),
+            vertices);
+        meshlet.center = meshlet.parentCenter = sphere.center;
+        meshlet.radius = meshlet.parentRadius = sphere.radius;
+        level.push_back(i);
+    }
+
+    std::vector<uint32_t> positionGroups(vertices.size());
+    std::vector<bool> lockedVertices(vertices.size());
+    std::vector<GLuint> groupIndices;
+    std::vector<size_t> nextLevel;
+    while (level.size() > 1)
+    {
+        sortMeshlets(level, meshlets, indices, vertices);
+        const size_t groupCount = (level.size() + GROUP_SIZE - 1) / GROUP_SIZE;
+        const auto groupMembers = [&](size_t group)
+        {
+            const size_t first = group * GROUP_SIZE;
+            return std::span{level}.subspan(
+                first,
+                std::min(GROUP_SIZE, level.size() - first));
+        };
+
+        // Lock positions on borders between groups, so that every group can
+        // be simplified independently without opening cracks between them
+        std::fill(positionGroups.begin(), positionGroups.end(), NO_GROUP);
+        for (size_t group = 0; group < groupCount; ++group)
+        {
+            for (const size_t meshlet : groupMembers(group))
+            {
+                const GLuint first = meshlets[meshlet].firstIndex;
+                const GLuint end = first + meshlets[meshlet].indexCount;
+                for (GLuint i = first; i < end; ++i)
+                {
+                    uint32_t& owner = positionGroups[positionRemap[indices[i]]];
+                    if (owner == NO_GROUP)
+                    {
+                        owner = static_cast<uint32_t>(group);
+                    }
+                    else if (owner != group)
+                    {
+                        owner = SHARED_BY_GROUPS;
+                    }
+                }
+            }
+        }
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            lockedVertices[v]
+                = positionGroups[positionRemap[v]] == SHARED_BY_GROUPS;
+        }
+
+        nextLevel.clear();
+        bool simplifiedAnyGroup = false;
+        for (size_t group = 0; group < groupCount; ++group)
+        {
+            const std::span<const size_t> members = groupMembers(group);
+            groupIndices.clear();
+            const auto selfSphere = [&](size_t meshlet)
+            {
+                return Sphere{
+                    .center = meshlets[meshlet].center,
+                    .radius = meshlets[meshlet].radius,
+                };
+            };
+            Sphere groupSphere = selfSphere(members.front());
+            float childError = 0.0F;
+            for (const size_t meshlet : members)
+            {
+                const GLuint first = meshlets[meshlet].firstIndex;
+                groupIndices.insert(
+                    groupIndices.end(),
+                    indices.begin() + first,
+                    indices.begin() + first + meshlets[meshlet].indexCount);
+                groupSphere = mergeSpheres(groupSphere, selfSphere(meshlet));
+                childError = std::max(childError, meshlets[meshlet].error);
+            }
+
+            const size_t targetIndexCount = groupIndices.size() / 6 * 3;
+            float simplifyError = 0.0F;
+            std::vector<GLuint> simplified
+                = meshsimplifier::simplify(groupIndices,
+                                           vertices,
+                                           positionRemap,
+                                           lockedVertices,
+                                           targetIndexCount,
+                                           simplifyError);
+            if (simplified.empty()
+                || static_cast<float>(simplified.size())
+                       > static_cast<float>(groupIndices.size())
+                             * MAX_SIMPLIFIED_RATIO)
+            {
+                // Retry with different neighbors on the next level
+                nextLevel.insert(nextLevel.end(),
+                                 members.begin(),
+                                 members.end());
+                continue;
+            }
+
+            // Error accumulates over levels, keeping it monotonic along the
+            // hierarchy as required by selection
+            const float groupError = std::max(simplifyError, childError);
+            simplifiedAnyGroup = true;
+            for (const size_t meshlet : members)
+            {
+                meshlets[meshlet].parentCenter = groupSphere.center;
+                meshlets[meshlet].parentRadius = groupSphere.radius;
+                meshlets[meshlet].parentError = groupError;
+            }
+
+            sortTriangles(simplified, vertices);
+            const auto firstIndex = static_cast<GLuint>(indices.size());
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            const size_t firstNew = meshlets.size();
+            appendMeshlets(indices,
+                           firstIndex,
+                           static_cast<GLuint>(simplified.size()),
+                           groupSphere,
+                           groupError,
+                           meshlets);
+            for (size_t i = firstNew; i < meshlets.size(); ++i)
+            {
+                nextLevel.push_back(i);
+            }
+        }
+        if (!simplifiedAnyGroup)
+        {
+            break;
+        }
+        level.swap(nextLevel);
+    }
+
+    submesh.firstMeshlet = static_cast<GLuint>(firstMeshlet);
+    submesh.meshletCount = static_cast<GLuint>(meshlets.size() - firstMeshlet);
+}
+
+bool isSelected(const Meshlet& meshlet, const lod::View& view)
+{
+    const float error = lod::projectError(meshlet.center,
+                                          meshlet.radius,
+                                          meshlet.error,
+                                          view);
+    const float parentError = lod::projectError(meshlet.parentCenter,
+                                                meshlet.parentRadius,
+                                                meshlet.parentError,
+                                                view);
+    return error <= view.errorThreshold && parentError > view.errorThreshold;
+}
+}  // namespace clusterlod
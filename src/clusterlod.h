@@ -0,0 +1,39 @@
+#ifndef CLUSTER_LOD_H_
+#define CLUSTER_LOD_H_
+
+#include "lod.h"
+#include "mesh.h"
+
+#include <span>
+#include <vector>
+
+/// Cluster level of detail hierarchy for dense meshes, selecting detail per
+/// small cluster of triangles instead of per whole mesh.
+///
+/// Meshlets are grouped by spatial proximity and each group is simplified
+/// with the vertices shared by other groups locked, so that the simplified
+/// group still fits seamlessly next to full detail neighbors. Simplified
+/// triangles are split into meshlets again and the process repeats until one
+/// meshlet is left or simplification does not reduce triangle count anymore.
+/// Near parts of the mesh can therefore be drawn at full detail while distant
+/// parts of the same mesh are drawn coarse.
+namespace clusterlod
+{
+/// Build hierarchy of a sub-mesh from the vertices of the sub-mesh.
+///
+/// Full detail meshlets partition the existing index range of the sub-mesh in
+/// place, preserving the triangle order achieved by optimization. Indices of
+/// simplified meshlets are appended to the end of indices. Meshlets are
+/// appended to meshlets and their range is recorded in the sub-mesh.
+void build(std::span<const Vertex> vertices,
+           std::vector<GLuint>& indices,
+           Submesh& submesh,
+           std::vector<Meshlet>& meshlets);
+
+/// Whether meshlet is part of the coarsest cut through the hierarchy whose
+/// error is below threshold on screen. Exactly one meshlet covers each part of
+/// the surface in the selected cut.
+bool isSelected(const Meshlet& meshlet, const lod::View& view);
+}  // namespace clusterlod
+
+#endif
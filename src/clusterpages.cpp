@@ -0,0 +1,215 @@
+#include "clusterpages.h"
+
+#include "lod.h"
+#include "meshprocessing.h"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace
+{
+/// Identity of a meshlet group by its bounds and error, which all meshlets of
+/// a group share bit for bit. Groups that happen to be identical are paged
+/// together, which keeps replacement consistent.
+using GroupKey = std::array<std::uint32_t, 5>;
+
+GroupKey makeGroupKey(const glm::vec3& center, float radius, float error)
+{
+    return {std::bit_cast<std::uint32_t>(center.x),
+            std::bit_cast<std::uint32_t>(center.y),
+            std::bit_cast<std::uint32_t>(center.z),
+            std::bit_cast<std::uint32_t>(radius),
+            std::bit_cast<std::uint32_t>(error)};
+}
+
+/// Meshlets of a page before their vertices are gathered.
+struct PageMembers
+{
+    std::vector<Meshlet> meshlets;
+    size_t submesh;
+    GLint baseVertex;
+    bool alwaysResident;
+};
+
+/// Append vertices referenced by page meshlets and indices relative to them
+/// to payload. Meshlet first indices are rebased onto the page.
+bool appendPayload(PageMembers& members,
+                   std::span<const PackedVertex> vertices,
+                   const MeshData& meshData,
+                   clusterpages::ClusterPage& page,
+                   std::vector<std::byte>& payload)
+{
+    const auto readIndex = [&](size_t i) -> GLuint
+    {
+        return meshData.indexType() == GL_UNSIGNED_SHORT
+                 ? meshData.shortIndices()[i]
+                 : meshData.indices()[i];
+    };
+
+    std::unordered_map<GLuint, GLushort> localVertices;
+    std::vector<PackedVertex> pageVertices;
+    std::vector<GLushort> pageIndices;
+    for (Meshlet& meshlet : members.meshlets)
+    {
+        const auto firstIndex = static_cast<GLuint>(pageIndices.size());
+        for (GLuint i = 0; i < meshlet.indexCount; ++i)
+        {
+            const GLuint vertex
+                = static_cast<GLuint>(members.baseVertex)
+                + readIndex(meshlet.firstIndex + i);
+            const auto [it, inserted] = localVertices.try_emplace(
+                vertex,
+                static_cast<GLushort>(pageVertices.size()));
+            if (inserted)
+            {
+                if (pageVertices.size() == clusterpages::MAX_PAGE_VERTEX_COUNT)
+                {
+                    return false;
+                }
+                pageVertices.push_back(vertices[vertex]);
+            }
+            pageIndices.push_back(it->second);
+        }
+        meshlet.firstIndex = firstIndex;
+    }
+
+    // Pages start aligned for packed vertices
+    const size_t padding
+        = (alignof(PackedVertex) - payload.size() % alignof(PackedVertex))
+        % alignof(PackedVertex);
+    payload.resize(payload.size() + padding);
+    page.dataOffset = payload.size();
+    page.vertexCount = static_cast<std::uint32_t>(pageVertices.size());
+    page.indexCount = static_cast<std::uint32_t>(pageIndices.size());
+    const size_t vertexDataSize = pageVertices.size() * sizeof(PackedVertex);
+    const size_t indexDataSize = pageIndices.size() * sizeof(GLushort);
+    payload.resize(payload.size() + vertexDataSize + indexDataSize);
+    std::memcpy(payload.data() + page.dataOffset,
+                pageVertices.data(),
+                vertexDataSize);
+    std::memcpy(payload.data() + page.dataOffset + vertexDataSize,
+                pageIndices.data(),
+                indexDataSize);
+    return true;
+}
+}  // namespace
+
+namespace clusterpages
+{
+bool build(const MeshData& meshData,
+           Bounds& outBounds,
+           std::vector<ClusterPage>& outPages,
+           std::vector<PagedMeshlet>& outMeshlets,
+           std::vector<std::byte>& outPayload)
+{
+    // Same vertex format as the geometry arena, packed relative to the bounds
+    // of the whole mesh
+    outBounds = meshData.bounds();
+    std::vector<PackedVertex> packedVertices;
+    std::span<const PackedVertex> vertices = meshData.packedVertices();
+    if (meshData.vertexFormat() == VertexFormat::Float)
+    {
+        outBounds = meshprocessing::computeBounds(meshData.vertices());
+        packedVertices
+            = meshprocessing::packVertices(meshData.vertices(), outBounds);
+        vertices = packedVertices;
+    }
+
+    outPages.clear();
+    outMeshlets.clear();
+    outPayload.clear();
+    std::vector<PageMembers> members;
+    // Page of the meshlets simplified into each group, for finding the page
+    // finer meshlets of a group are in
+    std::vector<std::map<GroupKey, std::uint32_t>> submeshPages;
+    for (const Submesh& submesh : meshData.submeshes())
+    {
+        const size_t submeshIndex = submeshPages.size();
+        std::map<GroupKey, std::uint32_t>& pageOfGroup
+            = submeshPages.emplace_back();
+        if (submesh.meshletCount == 0)
+        {
+            // Drawn whole regardless of view, like a hierarchy root
+            members.push_back({
+                .meshlets = {Meshlet{
+                    .firstIndex = submesh.firstIndex,
+                    .indexCount = submesh.indexCount,
+                    .center = glm::vec3{0.0F},
+                    .radius = 0.0F,
+                    .error = 0.0F,
+                    .parentCenter = glm::vec3{0.0F},
+                    .parentRadius = 0.0F,
+                    .parentError = lod::UNBOUNDED_ERROR,
+                }},
+                .submesh = submeshIndex,
+                .baseVertex = submesh.baseVertex,
+                .alwaysResident = true,
+            });
+            continue;
+        }
+        for (const Meshlet& meshlet : meshData.meshlets().subspan(
+                 submesh.firstMeshlet,
+                 submesh.meshletCount))
+        {
+            const auto [it, inserted] = pageOfGroup.try_emplace(
+                makeGroupKey(meshlet.parentCenter,
+                             meshlet.parentRadius,
+                             meshlet.parentError),
+                static_cast<std::uint32_t>(members.size()));
+            if (inserted)
+            {
+                members.push_back({
+                    .meshlets = {},
+                    .submesh = submeshIndex,
+                    .baseVertex = submesh.baseVertex,
+                    .alwaysResident
+                    = meshlet.parentError == lod::UNBOUNDED_ERROR,
+                });
+            }
+            members[it->second].meshlets.push_back(meshlet);
+        }
+    }
+
+    outPages.resize(members.size());
+    for (size_t i = 0; i < members.size(); ++i)
+    {
+        const std::map<GroupKey, std::uint32_t>& pageOfGroup
+            = submeshPages[members[i].submesh];
+
+        ClusterPage& page = outPages[i];
+        page.firstMeshlet = static_cast<std::uint32_t>(outMeshlets.size());
+        page.meshletCount
+            = static_cast<std::uint32_t>(members[i].meshlets.size());
+        page.alwaysResident = members[i].alwaysResident ? 1 : 0;
+        page.padding = 0;
+        if (!appendPayload(members[i], vertices, meshData, page, outPayload))
+        {
+            return false;
+        }
+        for (const Meshlet& meshlet : members[i].meshlets)
+        {
+            std::uint32_t childPage = NO_PAGE;
+            if (meshlet.error > 0.0F)
+            {
+                const auto child = pageOfGroup.find(makeGroupKey(
+                    meshlet.center,
+                    meshlet.radius,
+                    meshlet.error));
+                if (child != pageOfGroup.end())
+                {
+                    childPage = child->second;
+                }
+            }
+            outMeshlets.push_back({
+                .meshlet = meshlet,
+                .page = static_cast<std::uint32_t>(i),
+                .childPage = childPage,
+            });
+        }
+    }
+    return true;
+}
+}  // namespace clusterpages
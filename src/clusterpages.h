@@ -0,0 +1,99 @@
+#ifndef CLUSTER_PAGES_H_
+#define CLUSTER_PAGES_H_
+
+#include "mappedfile.h"
+#include "mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+/// Split of a cluster level of detail hierarchy into pages streamed in and
+/// out of video memory independently, for meshes too large to be resident
+/// as a whole.
+///
+/// A page holds the meshlets simplified together into the same group of the
+/// next coarser level, along with the vertices they reference. Meshlets of a
+/// group are replaced by the finer ones as a whole once their page is
+/// resident, so that the drawn cut never mixes detail within a group. Pages
+/// of hierarchy roots and of sub-meshes without hierarchy are the coarse
+/// fallback always kept resident. Vertices are packed relative to the bounds
+/// of the whole mesh, and indices are 16-bit relative to the first vertex of
+/// the page.
+namespace clusterpages
+{
+inline constexpr std::uint32_t NO_PAGE
+    = std::numeric_limits<std::uint32_t>::max();
+/// Vertices a page can hold at most with 16-bit indices, leaving the largest
+/// value for primitive restart.
+inline constexpr size_t MAX_PAGE_VERTEX_COUNT
+    = std::numeric_limits<GLushort>::max();
+
+/// Layout is persisted as-is by the binary mesh cache. Bump the page format
+/// version of the mesh cache when changing it.
+struct ClusterPage
+{
+    /// Offset of packed vertices in page payload, followed by indices.
+    std::uint64_t dataOffset;
+    std::uint32_t vertexCount;
+    std::uint32_t indexCount;
+    /// Range of meshlets in the meshlets of the paged mesh.
+    std::uint32_t firstMeshlet;
+    std::uint32_t meshletCount;
+    /// Nonzero for pages without coarser fallback.
+    std::uint32_t alwaysResident;
+    std::uint32_t padding;
+};
+
+/// Meshlet of a paged mesh. Layout is persisted as-is by the binary mesh
+/// cache.
+struct PagedMeshlet
+{
+    /// First index is relative to the indices of the page.
+    Meshlet meshlet;
+    std::uint32_t page;
+    /// Page of the meshlets this meshlet was simplified from, to be drawn
+    /// instead once resident. No page for full detail meshlets.
+    std::uint32_t childPage;
+};
+
+/// Page tables and payload of a paged mesh, mapped from the mesh cache. Page
+/// payload is paged in by the operating system on access, so that system
+/// memory stays bounded as well.
+struct PagedMesh
+{
+    /// Packed vertex data of a page followed by its indices.
+    [[nodiscard]] std::span<const std::byte> pageData(
+        const ClusterPage& page) const
+    {
+        return payload.subspan(page.dataOffset, pageDataSize(page));
+    }
+    [[nodiscard]] static size_t pageDataSize(const ClusterPage& page)
+    {
+        return page.vertexCount * sizeof(PackedVertex)
+             + page.indexCount * sizeof(GLushort);
+    }
+
+    /// Bounding box vertices were packed relative to.
+    Bounds bounds;
+    std::span<const ClusterPage> pages;
+    std::span<const PagedMeshlet> meshlets;
+    std::span<const std::byte> payload;
+    /// Shared with page reads in flight, which may outlive the mesh.
+    std::shared_ptr<const MappedFile> file;
+};
+
+/// Split cluster level of detail hierarchies of mesh into pages. Fails when
+/// a page would exceed the vertex limit of 16-bit indices, like a large
+/// sub-mesh without hierarchy.
+bool build(const MeshData& meshData,
+           Bounds& outBounds,
+           std::vector<ClusterPage>& outPages,
+           std::vector<PagedMeshlet>& outMeshlets,
+           std::vector<std::byte>& outPayload);
+}  // namespace clusterpages
+
+#endif
@@ -0,0 +1,494 @@
+#include "clusterstreamer.h"
+
+#include "profiler.h"
+#include "threadpool.h"
+#include "utils.h"
+#include "vertexformat.h"
+#include "videomemory.h"
+
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace
+{
+/// Page reads in flight at most, so that a sudden camera move does not queue
+/// up reads whose pages are no longer needed by the time they finish.
+constexpr size_t MAX_PENDING_READS = 32;
+
+/// Indices fit in a pool unit of packed vertex size.
+constexpr size_t INDICES_PER_UNIT = sizeof(PackedVertex) / sizeof(GLushort);
+
+/// Pool units taken by vertices and indices of page.
+size_t pageUnitCount(const clusterpages::ClusterPage& page)
+{
+    return page.vertexCount
+         + (page.indexCount + INDICES_PER_UNIT - 1) / INDICES_PER_UNIT;
+}
+
+/// Keep the highest priority requested by any recording thread.
+void raisePriority(std::atomic<float>& priority, float value)
+{
+    float current = priority.load(std::memory_order_relaxed);
+    while (current < value
+           && !priority.compare_exchange_weak(current,
+                                              value,
+                                              std::memory_order_relaxed))
+    {
+    }
+}
+}  // namespace
+
+ClusterStreamer::ClusterStreamer(ThreadPool& threadPool)
+    : threadPool_{threadPool}
+    , nextMeshId_{0}
+    , readQueue_{std::make_shared<ReadQueue>()}
+    , pendingReadCount_{0}
+    , pagesRequested_{false}
+    // Pages are never drawn in frame zero
+    , frame_{1}
+    , budget_{0}
+    , poolOutdated_{false}
+    , vertexArray_{0}
+    , buffer_{0}
+    , residentPageCount_{0}
+{
+}
+
+ClusterStreamer::~ClusterStreamer()
+{
+    glDeleteVertexArrays(1, &vertexArray_);
+    glDeleteBuffers(1, &buffer_);
+    videomemory::release(videomemory::Category::Geometry,
+                         ranges_.capacity() * sizeof(PackedVertex));
+}
+
+std::uint32_t ClusterStreamer::add(clusterpages::PagedMesh&& pagedMesh)
+{
+    const std::uint32_t meshId = nextMeshId_++;
+    const size_t pageCount = pagedMesh.pages.size();
+    StreamedMesh mesh{
+        .pagedMesh = std::move(pagedMesh),
+        .pageStates = std::vector<PageState>(pageCount),
+        .lastDrawnFrames
+        = std::make_unique<std::atomic<std::uint64_t>[]>(pageCount),
+        .requestPriorities = std::make_unique<std::atomic<float>[]>(pageCount),
+    };
+    for (const clusterpages::PagedMeshlet& meshlet : mesh.pagedMesh.meshlets)
+    {
+        if (meshlet.childPage == clusterpages::NO_PAGE)
+        {
+            continue;
+        }
+        std::vector<std::uint32_t>& parents
+            = mesh.pageStates[meshlet.childPage].parentPages;
+        if (std::find(parents.begin(), parents.end(), meshlet.page)
+            == parents.end())
+        {
+            parents.push_back(meshlet.page);
+        }
+    }
+    meshes_.emplace(meshId, std::move(mesh));
+
+    // Coarse fallback is uploaded right away, growing the pool past the
+    // budget if needed, so that the mesh can be drawn from the first frame
+    size_t alwaysResidentUnitCount = 0;
+    for (const clusterpages::ClusterPage& page :
+         meshes_.at(meshId).pagedMesh.pages)
+    {
+        alwaysResidentUnitCount += page.alwaysResident ? pageUnitCount(page)
+                                                       : 0;
+    }
+    if (poolOutdated_ || ranges_.largestFreeSize() < alwaysResidentUnitCount)
+    {
+        recreatePool();
+    }
+    else
+    {
+        const clusterpages::PagedMesh& added = meshes_.at(meshId).pagedMesh;
+        for (std::uint32_t i = 0; i < added.pages.size(); ++i)
+        {
+            if (added.pages[i].alwaysResident)
+            {
+                upload(meshId, i, added.pageData(added.pages[i]));
+            }
+        }
+    }
+    return meshId;
+}
+
+void ClusterStreamer::remove(std::uint32_t meshId)
+{
+    const auto it = meshes_.find(meshId);
+    if (it == meshes_.end())
+    {
+        return;
+    }
+    for (std::uint32_t i = 0; i < it->second.pageStates.size(); ++i)
+    {
+        if (it->second.pageStates[i].resident)
+        {
+            evict(it->second, i);
+        }
+    }
+    meshes_.erase(it);
+}
+
+void ClusterStreamer::setBudget(size_t budget)
+{
+    if (budget == budget_)
+    {
+        return;
+    }
+    budget_ = budget;
+    poolOutdated_ = true;
+}
+
+void ClusterStreamer::update()
+{
+    PROFILE_SCOPE("ClusterStreamer::update");
+    ++frame_;
+    pagesRequested_.store(false, std::memory_order_relaxed);
+    if (poolOutdated_)
+    {
+        recreatePool();
+    }
+
+    std::vector<ReadPage> readPages;
+    {
+        const std::lock_guard lock{readQueue_->mutex};
+        readPages.swap(readQueue_->pages);
+    }
+    pendingReadCount_ -= readPages.size();
+    for (const ReadPage& readPage : readPages)
+    {
+        // Mesh may have been removed while the page was read
+        const auto it = meshes_.find(readPage.meshId);
+        if (it == meshes_.end())
+        {
+            continue;
+        }
+        PageState& state = it->second.pageStates[readPage.page];
+        state.reading = false;
+        // Parents evicted while the page was read leave it without fallback,
+        // it is requested again once they are back
+        const bool parentsResident = std::all_of(
+            state.parentPages.begin(),
+            state.parentPages.end(),
+            [&](std::uint32_t parent)
+            { return it->second.pageStates[parent].resident; });
+        if (parentsResident)
+        {
+            upload(readPage.meshId, readPage.page, readPage.data);
+        }
+    }
+
+    // Requests of the previous frame are collected from every page, which is
+    // cheap next to selecting meshlets of every copy
+    struct Request
+    {
+        float priority;
+        std::uint32_t meshId;
+        std::uint32_t page;
+    };
+    std::vector<Request> requests;
+    for (auto& [meshId, mesh] : meshes_)
+    {
+        for (std::uint32_t i = 0; i < mesh.pageStates.size(); ++i)
+        {
+            const float priority = mesh.requestPriorities[i].exchange(
+                0.0F,
+                std::memory_order_relaxed);
+            const PageState& state = mesh.pageStates[i];
+            if (priority <= 0.0F || state.resident || state.reading)
+            {
+                continue;
+            }
+            const bool parentsResident = std::all_of(
+                state.parentPages.begin(),
+                state.parentPages.end(),
+                [&](std::uint32_t parent)
+                { return mesh.pageStates[parent].resident; });
+            if (parentsResident)
+            {
+                requests.push_back({
+                    .priority = priority,
+                    .meshId = meshId,
+                    .page = i,
+                });
+            }
+        }
+    }
+    const size_t readCount
+        = std::min(requests.size(), MAX_PENDING_READS - pendingReadCount_);
+    std::partial_sort(requests.begin(),
+                      requests.begin() + static_cast<std::ptrdiff_t>(readCount),
+                      requests.end(),
+                      [](const Request& a, const Request& b)
+                      { return a.priority > b.priority; });
+    for (const Request& request : std::span{requests}.first(readCount))
+    {
+        StreamedMesh& mesh = meshes_.at(request.meshId);
+        mesh.pageStates[request.page].reading = true;
+        ++pendingReadCount_;
+        // Reading touches the mapping, paging the data in from disk on the
+        // worker instead of stalling the main thread on upload. Future is not
+        // needed, the page is handed over through the read queue.
+        threadPool_.submit(
+            [meshId = request.meshId,
+             page = request.page,
+             data = mesh.pagedMesh.pageData(
+                 mesh.pagedMesh.pages[request.page]),
+             file = mesh.pagedMesh.file,
+             readQueue = readQueue_]()
+            {
+                ReadPage readPage{
+                    .meshId = meshId,
+                    .page = page,
+                    .data = std::vector<std::byte>(data.begin(), data.end()),
+                };
+                const std::lock_guard lock{readQueue->mutex};
+                readQueue->pages.push_back(std::move(readPage));
+            });
+    }
+}
+
+void ClusterStreamer::recordClusters(std::uint32_t meshId,
+                                     const lod::View& view,
+                                     CommandBuffer& commands) const
+{
+    const auto it = meshes_.find(meshId);
+    if (it == meshes_.end())
+    {
+        return;
+    }
+    const StreamedMesh& mesh = it->second;
+    const clusterpages::PagedMesh& pagedMesh = mesh.pagedMesh;
+    for (std::uint32_t i = 0; i < pagedMesh.pages.size(); ++i)
+    {
+        const PageState& state = mesh.pageStates[i];
+        if (!state.resident)
+        {
+            continue;
+        }
+        const clusterpages::ClusterPage& page = pagedMesh.pages[i];
+        bool drawn = false;
+        for (const clusterpages::PagedMeshlet& paged :
+             pagedMesh.meshlets.subspan(page.firstMeshlet, page.meshletCount))
+        {
+            const Meshlet& meshlet = paged.meshlet;
+            if (lod::projectError(meshlet.parentCenter,
+                                  meshlet.parentRadius,
+                                  meshlet.parentError,
+                                  view)
+                <= view.errorThreshold)
+            {
+                continue;
+            }
+            const float error = lod::projectError(meshlet.center,
+                                                  meshlet.radius,
+                                                  meshlet.error,
+                                                  view);
+            if (error > view.errorThreshold
+                && paged.childPage != clusterpages::NO_PAGE)
+            {
+                if (mesh.pageStates[paged.childPage].resident)
+                {
+                    continue;
+                }
+                // Drawn coarser than wanted until finer meshlets arrive
+                raisePriority(mesh.requestPriorities[paged.childPage], error);
+                pagesRequested_.store(true, std::memory_order_relaxed);
+            }
+            commands.appendRange({
+                .firstIndex = state.firstIndex + meshlet.firstIndex,
+                .indexCount = meshlet.indexCount,
+                .baseVertex = state.baseVertex,
+            });
+            drawn = true;
+        }
+        if (drawn)
+        {
+            mesh.lastDrawnFrames[i].store(frame_, std::memory_order_relaxed);
+        }
+    }
+}
+
+glm::mat4 ClusterStreamer::positionTransform(std::uint32_t meshId) const
+{
+    return VertexFormatDescriptor<PackedVertex>::positionTransform(
+        meshes_.at(meshId).pagedMesh.bounds);
+}
+
+ClusterStreamer::Statistics ClusterStreamer::statistics() const
+{
+    size_t pageCount = 0;
+    for (const auto& [meshId, mesh] : meshes_)
+    {
+        pageCount += mesh.pageStates.size();
+    }
+    return {
+        .residentSize = ranges_.usedSize() * sizeof(PackedVertex),
+        .capacity = ranges_.capacity() * sizeof(PackedVertex),
+        .residentPageCount = residentPageCount_,
+        .pageCount = pageCount,
+        .pendingReadCount = pendingReadCount_,
+    };
+}
+
+bool ClusterStreamer::upload(std::uint32_t meshId,
+                             std::uint32_t page,
+                             std::span<const std::byte> data)
+{
+    StreamedMesh& mesh = meshes_.at(meshId);
+    const clusterpages::ClusterPage& info = mesh.pagedMesh.pages[page];
+    const size_t unitCount = pageUnitCount(info);
+    std::optional<size_t> offset = ranges_.allocate(unitCount);
+    while (!offset)
+    {
+        if (!evictLeastRecentlyDrawn())
+        {
+            return false;
+        }
+        offset = ranges_.allocate(unitCount);
+    }
+
+    // Indices follow vertices within the range, so the same buffer serves
+    // as vertex and index buffer
+    PageState& state = mesh.pageStates[page];
+    state.range = {.offset = offset.value(), .size = unitCount};
+    state.baseVertex = static_cast<GLint>(offset.value());
+    state.firstIndex = static_cast<GLuint>(
+        (offset.value() + info.vertexCount) * INDICES_PER_UNIT);
+    state.resident = true;
+    ++residentPageCount_;
+    for (const std::uint32_t parent : state.parentPages)
+    {
+        ++mesh.pageStates[parent].residentChildCount;
+    }
+    // Not evicted before it had a chance to be drawn
+    mesh.lastDrawnFrames[page].store(frame_, std::memory_order_relaxed);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    glBufferSubData(
+        GL_COPY_WRITE_BUFFER,
+        static_cast<GLintptr>(offset.value() * sizeof(PackedVertex)),
+        static_cast<GLsizeiptr>(data.size()),
+        data.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+void ClusterStreamer::evict(StreamedMesh& mesh, std::uint32_t page)
+{
+    // Contents are left in place, overwritten once the range is reused
+    PageState& state = mesh.pageStates[page];
+    ranges_.release(state.range);
+    state.resident = false;
+    --residentPageCount_;
+    for (const std::uint32_t parent : state.parentPages)
+    {
+        --mesh.pageStates[parent].residentChildCount;
+    }
+}
+
+bool ClusterStreamer::evictLeastRecentlyDrawn()
+{
+    StreamedMesh* victimMesh = nullptr;
+    std::uint32_t victimPage = 0;
+    // Pages drawn in the previous frame are still needed for the current one
+    std::uint64_t oldestFrame = frame_ - 1;
+    for (auto& [meshId, mesh] : meshes_)
+    {
+        for (std::uint32_t i = 0; i < mesh.pageStates.size(); ++i)
+        {
+            const PageState& state = mesh.pageStates[i];
+            const std::uint64_t lastDrawnFrame
+                = mesh.lastDrawnFrames[i].load(std::memory_order_relaxed);
+            if (state.resident && !mesh.pagedMesh.pages[i].alwaysResident
+                && state.residentChildCount == 0
+                && lastDrawnFrame < oldestFrame)
+            {
+                victimMesh = &mesh;
+                victimPage = i;
+                oldestFrame = lastDrawnFrame;
+            }
+        }
+    }
+    if (!victimMesh)
+    {
+        return false;
+    }
+    evict(*victimMesh, victimPage);
+    return true;
+}
+
+void ClusterStreamer::recreatePool()
+{
+    PROFILE_SCOPE("ClusterStreamer::recreatePool");
+    size_t alwaysResidentUnitCount = 0;
+    for (auto& [meshId, mesh] : meshes_)
+    {
+        for (std::uint32_t i = 0; i < mesh.pageStates.size(); ++i)
+        {
+            PageState& state = mesh.pageStates[i];
+            state.resident = false;
+            state.residentChildCount = 0;
+            const clusterpages::ClusterPage& page = mesh.pagedMesh.pages[i];
+            alwaysResidentUnitCount
+                += page.alwaysResident ? pageUnitCount(page) : 0;
+        }
+    }
+    poolOutdated_ = false;
+    const size_t budgetUnitCount = budget_ / sizeof(PackedVertex);
+    if (alwaysResidentUnitCount > budgetUnitCount)
+    {
+        utils::logWarning("coarse cluster pages exceed streaming budget, "
+                          "taking ",
+                          alwaysResidentUnitCount * sizeof(PackedVertex),
+                          " bytes");
+    }
+
+    videomemory::release(videomemory::Category::Geometry,
+                         ranges_.capacity() * sizeof(PackedVertex));
+    ranges_ = RangeAllocator{};
+    ranges_.grow(std::max(budgetUnitCount, alwaysResidentUnitCount));
+    residentPageCount_ = 0;
+    const size_t capacity = ranges_.capacity() * sizeof(PackedVertex);
+    videomemory::allocate(videomemory::Category::Geometry, capacity);
+    if (buffer_ == 0)
+    {
+        glGenBuffers(1, &buffer_);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 static_cast<GLsizeiptr>(capacity),
+                 nullptr,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (vertexArray_ == 0)
+    {
+        // Same layout as the geometry arena
+        glGenVertexArrays(1, &vertexArray_);
+        glBindVertexArray(vertexArray_);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_);
+        vertexformat::setupAttributes<PackedVertex>();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    for (auto& [meshId, mesh] : meshes_)
+    {
+        const clusterpages::PagedMesh& pagedMesh = mesh.pagedMesh;
+        for (std::uint32_t i = 0; i < pagedMesh.pages.size(); ++i)
+        {
+            if (pagedMesh.pages[i].alwaysResident)
+            {
+                upload(meshId, i, pagedMesh.pageData(pagedMesh.pages[i]));
+            }
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef CLUSTER_STREAMER_H_
+#define CLUSTER_STREAMER_H_
+
+#include "clusterpages.h"
+#include "commandbuffer.h"
+#include "lod.h"
+#include "rangeallocator.h"
+
+#include "glad/gl.h"
+#include "glm/mat4x4.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+/// Out-of-core streaming of cluster pages into a pool of video memory with a
+/// fixed budget, for meshes larger than video memory.
+///
+/// Pages are selected for drawing like meshlets of a cluster level of detail
+/// hierarchy, except that a group is only replaced by finer meshlets once the
+/// page holding them is resident. Missing finer pages are requested by the
+/// projected error of the group they refine, which grows with error and
+/// towards the camera, and read from the mapped page file on the thread pool.
+/// Read pages are uploaded on the next update, evicting least recently drawn
+/// pages while the pool is full. A page is only loaded while the pages
+/// referring to it are resident, and only evicted while no page it refers to
+/// is, so that the coarser fallback of every drawn page stays resident.
+///
+/// Pages share a single buffer holding their packed vertices followed by
+/// their 16-bit indices, drawn through a single vertex array. Non-copyable,
+/// non-movable, page reads in flight refer to the instance through shared
+/// state.
+class ClusterStreamer
+{
+public:
+    /// Residency of the pool for display.
+    struct Statistics
+    {
+        size_t residentSize;
+        size_t capacity;
+        size_t residentPageCount;
+        size_t pageCount;
+        size_t pendingReadCount;
+    };
+
+    explicit ClusterStreamer(ThreadPool& threadPool);
+    ClusterStreamer(const ClusterStreamer&) = delete;
+    ClusterStreamer& operator=(const ClusterStreamer&) = delete;
+    ClusterStreamer(ClusterStreamer&&) = delete;
+    ClusterStreamer& operator=(ClusterStreamer&&) = delete;
+    ~ClusterStreamer();
+
+    /// Register paged mesh and upload its always resident pages. Returns
+    /// identifier of the mesh for drawing. Must be called on the thread the
+    /// graphics context is current on.
+    std::uint32_t add(clusterpages::PagedMesh&& pagedMesh);
+    /// Evict all pages of mesh. Reads in flight are dropped once finished.
+    void remove(std::uint32_t meshId);
+
+    /// Resize pool to budget in bytes on the next update, evicting all pages
+    /// not always resident. Always resident pages stay resident even when
+    /// they exceed the budget. Issues no graphics calls itself.
+    void setBudget(size_t budget);
+    [[nodiscard]] size_t budget() const { return budget_; }
+
+    /// Upload pages read since the previous update and start reading the
+    /// pages requested by the selections of the previous frame. Called once
+    /// per frame before recording draws.
+    void update();
+
+    /// Append ranges of resident meshlets selected for view as ranges of the
+    /// next command, and request pages refining the selection. Touches no
+    /// graphics state, so that copies can be recorded on separate threads.
+    void recordClusters(std::uint32_t meshId,
+                        const lod::View& view,
+                        CommandBuffer& commands) const;
+
+    /// Transformation from pool vertex positions of mesh to model space,
+    /// dequantizing packed positions.
+    [[nodiscard]] glm::mat4 positionTransform(std::uint32_t meshId) const;
+    [[nodiscard]] GLuint vertexArray() const { return vertexArray_; }
+    /// Pool indices are always 16-bit.
+    static constexpr GLenum INDEX_TYPE = GL_UNSIGNED_SHORT;
+
+    /// Whether pages are being read or were requested since the last update,
+    /// which arrive only with later frames.
+    [[nodiscard]] bool isStreaming() const
+    {
+        return pendingReadCount_ > 0
+            || pagesRequested_.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] Statistics statistics() const;
+
+private:
+    /// Residency of a page in the pool.
+    struct PageState
+    {
+        /// Pool range in units of packed vertices, vertices first.
+        AllocatedRange range;
+        GLint baseVertex;
+        GLuint firstIndex;
+        bool resident;
+        bool reading;
+        /// Resident pages referred to by meshlets of this page, which have to
+        /// be evicted first.
+        std::uint32_t residentChildCount;
+        /// Pages referring to this page, which have to be resident first.
+        std::vector<std::uint32_t> parentPages;
+    };
+
+    struct StreamedMesh
+    {
+        clusterpages::PagedMesh pagedMesh;
+        std::vector<PageState> pageStates;
+        /// Written by selection on recording threads, read by update.
+        std::unique_ptr<std::atomic<std::uint64_t>[]> lastDrawnFrames;
+        std::unique_ptr<std::atomic<float>[]> requestPriorities;
+    };
+
+    /// Page read from the page file, waiting for upload.
+    struct ReadPage
+    {
+        std::uint32_t meshId;
+        std::uint32_t page;
+        std::vector<std::byte> data;
+    };
+
+    /// Finished reads, shared with reads in flight so that a read finishing
+    /// after destruction never pushes into a destroyed queue.
+    struct ReadQueue
+    {
+        std::mutex mutex;
+        std::vector<ReadPage> pages;
+    };
+
+    /// Upload page data into pool, evicting pages drawn least recently when
+    /// it does not fit. Returns false when nothing evictable frees enough
+    /// space.
+    bool upload(std::uint32_t meshId,
+                std::uint32_t page,
+                std::span<const std::byte> data);
+    void evict(StreamedMesh& mesh, std::uint32_t page);
+    /// Evict least recently drawn page not drawn in the previous frame.
+    bool evictLeastRecentlyDrawn();
+    /// Allocate pool buffer of current budget and upload always resident
+    /// pages of every mesh into it.
+    void recreatePool();
+
+    ThreadPool& threadPool_;
+    std::unordered_map<std::uint32_t, StreamedMesh> meshes_;
+    std::uint32_t nextMeshId_;
+    std::shared_ptr<ReadQueue> readQueue_;
+    size_t pendingReadCount_;
+    /// Set by selections requesting pages.
+    mutable std::atomic<bool> pagesRequested_;
+    /// Frame number of selections, incremented by update.
+    std::uint64_t frame_;
+    size_t budget_;
+    /// Budget changed since the pool was allocated.
+    bool poolOutdated_;
+    GLuint vertexArray_;
+    GLuint buffer_;
+    /// Pool in units of packed vertices.
+    RangeAllocator ranges_;
+    size_t residentPageCount_;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef COMMAND_BUFFER_H_
+#define COMMAND_BUFFER_H_
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+/// Index buffer range drawn by a render command.
+struct DrawRange
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+};
+
+/// Passes of a frame in submission order.
+enum class RenderPass : std::uint8_t
+{
+    Opaque,
+    /// Surfaces of transparent materials, accumulated after every opaque
+    /// surface without writing depth.
+    Transparent,
+};
+
+/// Sort key ordering draws by pass first. Within a pass, draws are grouped by
+/// shader and then by vertex array to minimize state changes between adjacent
+/// draws, and draws sharing both are ordered front to back, so that hidden
+/// fragments are rejected by early depth test.
+///
+/// Bits from most significant: 4 bits of pass, 12 bits of shader index,
+/// 24 bits of vertex array name and 24 bits of depth. Names beyond 24 bits
+/// only weaken grouping. Depth is expected in [0, 1] from near to far plane
+/// and is clamped otherwise.
+constexpr std::uint64_t makeSortKey(RenderPass pass,
+                                    std::uint32_t shaderIndex,
+                                    GLuint vertexArray,
+                                    float depth)
+{
+    constexpr std::uint32_t DEPTH_MASK = (1U << 24U) - 1;
+    const auto depthBucket = static_cast<std::uint32_t>(
+        std::clamp(depth, 0.0F, 1.0F) * static_cast<float>(DEPTH_MASK));
+    return (std::uint64_t{static_cast<std::uint8_t>(pass)} << 60U)
+         | (std::uint64_t{shaderIndex & 0xFFFU} << 48U)
+         | (std::uint64_t{vertexArray & 0xFFFFFFU} << 24U)
+         | depthBucket;
+}
+
+/// Indexed draw recorded for replay on the thread the graphics context is
+/// current on. Plain data only, so that recording touches no graphics state.
+struct RenderCommand
+{
+    /// Commands are replayed in ascending key order, so that draws sharing
+    /// state are submitted one after the other.
+    std::uint64_t sortKey;
+    GLuint program;
+    /// Program writing depth only, used by depth prepass.
+    GLuint depthProgram;
+    GLuint vertexArray;
+    /// Base color textures of the materials of the model, zero without.
+    GLuint textureArray;
+    /// GL_NONE for draws without index buffer, drawing ranges of vertices
+    /// instead.
+    GLenum indexType;
+    /// Byte offset of per-object uniform block data in the command buffer.
+    std::uint32_t uniformOffset;
+    /// Drawn ranges of the command buffer, filled in by record().
+    std::uint32_t firstRange;
+    std::uint32_t rangeCount;
+};
+
+/// Render commands recorded by a single thread, with the data they refer to
+/// allocated linearly next to them.
+///
+/// Storage is kept on clear(), so that recording the same amount of draws
+/// every frame does not allocate once warmed up. Not thread-safe, each
+/// recording thread is meant to have its own buffer.
+class CommandBuffer
+{
+public:
+    CommandBuffer()
+        : firstPendingRange_{0}
+    {
+    }
+
+    /// Forget recorded commands and data, keeping storage for reuse.
+    void clear()
+    {
+        commands_.clear();
+        ranges_.clear();
+        data_.clear();
+        firstPendingRange_ = 0;
+    }
+
+    /// Copy value into the data of the buffer. Returns its byte offset, to be
+    /// referred to by commands.
+    template <typename T>
+    std::uint32_t writeData(const T& value);
+
+    /// Value written by writeData() at byte offset.
+    template <typename T>
+    [[nodiscard]] T readData(std::uint32_t offset) const;
+
+    /// Add range to be drawn by the next recorded command. Ranges adjacent in
+    /// the index buffer are merged into one.
+    void appendRange(const DrawRange& range);
+
+    /// Record command drawing ranges appended since the previous command.
+    /// Commands without ranges are dropped.
+    void record(RenderCommand command);
+
+    [[nodiscard]] std::span<const RenderCommand> commands() const
+    {
+        return commands_;
+    }
+
+    [[nodiscard]] std::span<const DrawRange> ranges(
+        const RenderCommand& command) const
+    {
+        return std::span{ranges_}.subspan(command.firstRange,
+                                          command.rangeCount);
+    }
+
+private:
+    std::vector<RenderCommand> commands_;
+    std::vector<DrawRange> ranges_;
+    std::vector<std::byte> data_;
+    std::uint32_t firstPendingRange_;
+};
+
+template <typename T>
+std::uint32_t CommandBuffer::writeData(const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "command data is copied byte by byte");
+    // Aligned as if allocated separately, keeping reads of matrices and
+    // vectors fast
+    const size_t offset
+        = (data_.size() + alignof(T) - 1) / alignof(T) * alignof(T);
+    data_.resize(offset + sizeof(T));
+    std::memcpy(data_.data() + offset, &value, sizeof(T));
+    return static_cast<std::uint32_t>(offset);
+}
+
+template <typename T>
+T CommandBuffer::readData(std::uint32_t offset) const
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "command data is copied byte by byte");
+    T value;
+    std::memcpy(&value, data_.data() + offset, sizeof(T));
+    return value;
+}
+
+inline void CommandBuffer::appendRange(const DrawRange& range)
+{
+    if (ranges_.size() > firstPendingRange_)
+    {
+        DrawRange& last = ranges_.back();
+        if (last.firstIndex + last.indexCount == range.firstIndex
+            && last.baseVertex == range.baseVertex)
+        {
+            last.indexCount += range.indexCount;
+            return;
+        }
+    }
+    ranges_.push_back(range);
+}
+
+inline void CommandBuffer::record(RenderCommand command)
+{
+    const auto rangeCount = static_cast<std::uint32_t>(ranges_.size());
+    if (rangeCount == firstPendingRange_)
+    {
+        return;
+    }
+    command.firstRange = firstPendingRange_;
+    command.rangeCount = rangeCount - firstPendingRange_;
+    commands_.push_back(command);
+    firstPendingRange_ = rangeCount;
+}
+
+#endif
@@ -15,10 +15,56 @@ DrawProperties DrawProperties::createDefault()
         .modelColor{0.0F, 0.8F, 1.0F},
         .lightDirection{-0.5F, -1.0F, 0.0F},
         .fov = 60.0F,
+        .fovGeneration = 0,
+        .resolutionScale = 1.0F,
+        .dynamicResolutionEnabled = true,
+        // Leaves room for UI and upscaling within a 60 Hz frame
+        .targetGpuTime = 14.0F,
+        .qualityGovernorEnabled = false,
+        // Whole frame within 60 Hz
+        .targetFrameTime = 16.0F,
+        .antialiasingModeIndex = 0,
+        .exposure = 1.0F,
+        .bloomEnabled = true,
+        .bloomIntensity = 0.04F,
         .selectedModelIndex = STANFORD_BUNNY_MODEL_INDEX,
+        .selectedSkyboxIndex = 0,
+        .skyboxCacheBudget = 256,
+        .modelResidencyBudget = 256,
+        .videoMemoryBudget = 1024,
+        .clusterStreamingBudget = 256,
         .skyboxEnabled = true,
         .wireframeModeEnabled = false,
+        .overdrawViewEnabled = false,
+        .shadingRateModeIndex = 0,
         .diffuseEnabled = true,
         .specularEnabled = true,
+        .shadowsEnabled = true,
+        .shadowMapSize = 1024,
+        .pointLightCount = 0,
+        .ambientOcclusionEnabled = true,
+        .lodEnabled = true,
+        .depthPrepassEnabled = false,
+        .lodErrorThreshold = 1.0F,
+        .instanceGridSize = 1,
+        .instanceSpacing = 4.0F,
+        .spatialIndexEnabled = true,
+        .instancingEnabled = true,
+        .impostorsEnabled = true,
+        .impostorScreenSize = 32.0F,
+        .softwareOcclusionCullingEnabled = true,
+        .multiViewEnabled = false,
+        .stereoEnabled = false,
+        .indirectDrawEnabled = false,
+        .gpuCullingEnabled = true,
+        .occlusionCullingEnabled = true,
+        .pickingEnabled = false,
+        .selectedObjectId = 0,
+        .onDemandRenderingEnabled = false,
+        .pipelineStatisticsEnabled = false,
+        .vsyncModeIndex = 1,
+        .frameCapEnabled = false,
+        .frameCap = 60,
+        .lowLatencyEnabled = false,
     };
 }
@@ -2,6 +2,7 @@
 #define DRAW_PROPERTIES_H_
 
 #include <array>
+#include <cstdint>
 
 /// Parameter object for user to customize selected model, model transformations
 /// and rendering properties from UI.
@@ -11,16 +12,169 @@ struct DrawProperties
     /// startup.
     static DrawProperties createDefault();
 
+    bool operator==(const DrawProperties&) const = default;
+
     std::array<float, 3> backgroundColor;
     std::array<float, 3> modelRotation;
     std::array<float, 3> modelColor;
     std::array<float, 3> lightDirection;
     float fov;
+    /// Incremented on every change of field of view, so that projection is
+    /// only rebuilt when it changes.
+    std::uint32_t fovGeneration;
+    /// Fraction of window resolution the scene is drawn at along each axis
+    /// before upscaling. Chosen automatically while dynamic resolution is
+    /// enabled.
+    float resolutionScale;
+    /// Adapt resolution scale to keep GPU time of drawing the scene at the
+    /// target. Supported on desktop only.
+    bool dynamicResolutionEnabled;
+    /// GPU time in milliseconds that drawing the scene is aimed to take.
+    float targetGpuTime;
+    /// Lower render scale, multisampling, shadow resolution, level of detail
+    /// and ambient occlusion below the values chosen here while frames take
+    /// longer than the target frame time, and raise them back once frames
+    /// are well within it. Takes over resolution scale from dynamic
+    /// resolution.
+    bool qualityGovernorEnabled;
+    /// Milliseconds the quality governor aims to keep frames within, measured
+    /// as GPU time of the whole frame where timer queries are supported and
+    /// as time between presented frames otherwise.
+    float targetFrameTime;
+    /// Antialiasing off, FXAA applied while tonemapping, temporal upscaling, or
+    /// multisampling of the scene framebuffer with 2, 4 or 8 samples, in the
+    /// order of the UI. Temporal upscaling accumulates jittered frames drawn
+    /// below window resolution into a sharp image at window resolution.
+    /// Sample count is limited to what the driver supports.
+    int antialiasingModeIndex;
+    /// Multiplier of scene light before it is tonemapped for display.
+    float exposure;
+    /// Blur bright light over its surroundings with a chain of downsampled
+    /// and upsampled mip levels of the scene.
+    bool bloomEnabled;
+    /// Fraction of scene light replaced by its bloom.
+    float bloomIntensity;
     int selectedModelIndex;
+    int selectedSkyboxIndex;
+    /// Video memory in MiB that recently displayed skyboxes are kept resident
+    /// in, so that switching back to them is instant.
+    int skyboxCacheBudget;
+    /// Video memory in MiB that models are kept resident in after they were
+    /// last drawn. Least recently drawn models over it are released, and
+    /// loaded again from binary mesh cache once selected.
+    int modelResidencyBudget;
+    /// Video memory in MiB that tracked resources are expected to stay
+    /// within. Exceeding it is warned about.
+    int videoMemoryBudget;
+    /// Video memory in MiB of the pool cluster pages are streamed into. Models
+    /// with cluster level of detail exceeding it are streamed instead of
+    /// uploaded whole. Supported on desktop only.
+    int clusterStreamingBudget;
     bool skyboxEnabled;
+    /// Overlay triangle edges on shaded models.
     bool wireframeModeEnabled;
+    /// Replace shading with a heatmap of how many fragments of models were
+    /// shaded per pixel, for finding overdraw a depth prepass or culling
+    /// should remove.
+    bool overdrawViewEnabled;
+    /// Shade models at full rate, at coarser rates away from the center of
+    /// the camera view, or at coarser rates where the previous frame was
+    /// flat, in the order of the UI. Supported on desktop only, on GPUs
+    /// providing NV_shading_rate_image.
+    int shadingRateModeIndex;
     bool diffuseEnabled;
     bool specularEnabled;
+    /// Shade models with cascaded shadow maps of the light. Cascades are
+    /// drawn again only when light, camera or models move far enough to
+    /// change them.
+    bool shadowsEnabled;
+    /// Width and height of each shadow cascade in texels.
+    int shadowMapSize;
+    /// Point and spot lights scattered over the instance grid, shaded with
+    /// clustered forward lighting.
+    int pointLightCount;
+    /// Darken ambient light with screen-space ambient occlusion computed at
+    /// half resolution. Forces a depth prepass, as occlusion is computed from
+    /// its depth before shading.
+    bool ambientOcclusionEnabled;
+    /// Select level of detail for models having cluster level of detail
+    /// hierarchies or discrete level of detail chains, instead of drawing them
+    /// at full detail.
+    bool lodEnabled;
+    /// Draw models into the depth buffer with a trivial program first, so
+    /// that the lighting of the color pass is only computed for visible
+    /// fragments.
+    bool depthPrepassEnabled;
+    /// Largest geometric error in pixels tolerated on screen.
+    float lodErrorThreshold;
+    /// Copies of selected model are drawn in a square grid with this many
+    /// copies per side.
+    int instanceGridSize;
+    /// Distance between neighboring copies in the grid.
+    float instanceSpacing;
+    /// Find copies of the grid near the view frustum through a bounding volume
+    /// hierarchy kept up to date as copies move, instead of testing every
+    /// copy each frame.
+    bool spatialIndexEnabled;
+    /// Draw grids larger than one with instancing, instead of a separate draw
+    /// per copy recorded on the thread pool.
+    bool instancingEnabled;
+    /// Draw instanced copies covering fewer pixels than the impostor screen
+    /// size as camera facing quads textured with views baked around the
+    /// model, instead of their geometry.
+    bool impostorsEnabled;
+    /// Diameter in pixels below which copies are drawn as impostors.
+    float impostorScreenSize;
+    /// Leave out copies of the grid hidden behind nearer ones, found by
+    /// rasterizing simplified geometry of the nearest copies into a small
+    /// depth buffer on the CPU. Covers every build, including those without
+    /// GPU culling.
+    bool softwareOcclusionCullingEnabled;
+    /// Show orthographic top, front and side views next to the camera view,
+    /// each in a quadrant of the window. Copies are drawn with instancing into
+    /// every view, culled once for all of them. Orthographic views are lit
+    /// by the directional light without shadows.
+    bool multiViewEnabled;
+    /// Draw the scene once per eye side by side, both eyes in a single pass
+    /// through OVR_multiview2 where supported. Takes precedence over multiple
+    /// views. Streamed models and point clouds are left out.
+    bool stereoEnabled;
+    /// Submit copies of selected model with a single multi-draw indirect call
+    /// reading geometry from the shared geometry arena. Supported on desktop
+    /// only.
+    bool indirectDrawEnabled;
+    /// Discard indirect draws of copies outside of the view frustum in a
+    /// compute shader pass before drawing.
+    bool gpuCullingEnabled;
+    /// Discard indirect draws of copies hidden behind geometry of the previous
+    /// frame as well.
+    bool occlusionCullingEnabled;
+    /// Write identifiers of drawn objects into an extra attachment and read
+    /// back the one under the cursor, so that objects can be selected by
+    /// clicking them. Supported on desktop only.
+    bool pickingEnabled;
+    /// Identifier of the selected object, highlighted when picking is
+    /// enabled. Objects are numbered from one in draw order, zero selects
+    /// none.
+    std::uint32_t selectedObjectId;
+    /// Draw frames only when input, UI, or background loading changes what is
+    /// shown, and sleep otherwise. Supported on desktop only, browsers
+    /// already throttle rendering of hidden pages.
+    bool onDemandRenderingEnabled;
+    /// Count shader invocations and primitives of each profiled pass with
+    /// pipeline statistics queries. Supported on desktop only.
+    bool pipelineStatisticsEnabled;
+    /// Vertical synchronization off, on, or adaptive. Supported on desktop
+    /// only, browsers synchronize to display refresh.
+    int vsyncModeIndex;
+    /// Limit framerate to frame cap. Supported on desktop only.
+    bool frameCapEnabled;
+    /// Frames per second drawn at most when frame cap is enabled.
+    int frameCap;
+    /// Sample mouse look right before drawing instead of at the start of the
+    /// frame, and on desktop let the CPU run no more than a frame ahead of
+    /// the GPU, trading throughput for lower input latency.
+    bool lowLatencyEnabled;
 };
 
 #endif
@@ -0,0 +1,476 @@
+#include "editablemesh.h"
+
+#include "bvh.h"
+#include "meshprocessing.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+/// Consecutive vertices sharing bounds, recomputed together when any of
+/// them moved.
+constexpr std::uint32_t BOUNDS_BLOCK_SIZE = 4096;
+/// Vertices or hierarchy nodes handled by a single thread pool task.
+constexpr size_t BATCH_SIZE = 4096;
+/// Changed vertices closer than this are uploaded as a single range along
+/// with the unchanged ones between them, saving a copy command.
+constexpr std::uint32_t UPLOAD_GAP_VERTEX_COUNT = 32;
+/// Edits touching more than this share of vertices update the whole mesh,
+/// which costs less than collecting the vertices around each of them.
+constexpr size_t MAX_INCREMENTAL_SHARE_PERCENT = 25;
+
+template <typename IndexType>
+void appendIndices(std::span<const IndexType> indices,
+                   const Submesh& submesh,
+                   std::vector<GLuint>& outIndices)
+{
+    const std::span<const IndexType> range
+        = indices.subspan(submesh.firstIndex, submesh.indexCount);
+    outIndices.insert(outIndices.end(), range.begin(), range.end());
+}
+}  // namespace
+
+EditableMesh EditableMesh::create(const MeshData& meshData,
+                                  ThreadPool& threadPool)
+{
+    PROFILE_SCOPE("EditableMesh::create");
+    std::vector<Vertex> vertices;
+    if (meshData.vertexFormat() == VertexFormat::Packed)
+    {
+        vertices.reserve(meshData.packedVertices().size());
+        for (const PackedVertex& vertex : meshData.packedVertices())
+        {
+            vertices.push_back(Vertex{
+                .position
+                = meshprocessing::unpackPosition(vertex, meshData.bounds()),
+                .normal = glm::vec3{0.0F},
+                .texCoord = glm::vec2{glm::unpackHalf1x16(vertex.texCoord[0]),
+                                      glm::unpackHalf1x16(vertex.texCoord[1])},
+            });
+        }
+    }
+    else
+    {
+        vertices.assign(meshData.vertices().begin(),
+                        meshData.vertices().end());
+    }
+
+    // Full detail ranges of sub-meshes only
+    std::vector<GLuint> indices;
+    std::vector<Submesh> submeshes(meshData.submeshes().begin(),
+                                   meshData.submeshes().end());
+    for (Submesh& submesh : submeshes)
+    {
+        const auto firstIndex = static_cast<GLuint>(indices.size());
+        if (meshData.indexType() == GL_UNSIGNED_SHORT)
+        {
+            appendIndices(meshData.shortIndices(), submesh, indices);
+        }
+        else
+        {
+            appendIndices(meshData.indices(), submesh, indices);
+        }
+        submesh.firstIndex = firstIndex;
+        submesh.firstMeshlet = 0;
+        submesh.meshletCount = 0;
+        submesh.firstLod = 0;
+        submesh.lodCount = 0;
+    }
+    const auto vertexCount = static_cast<std::uint32_t>(vertices.size());
+    std::vector<glm::vec2> texCoords;
+    texCoords.reserve(vertices.size());
+    for (const Vertex& vertex : vertices)
+    {
+        texCoords.push_back(vertex.texCoord);
+    }
+
+    MeshData editableData
+        = MeshData::fromContainers(std::move(vertices),
+                                   std::move(indices),
+                                   std::move(submeshes),
+                                   std::vector<Meshlet>{},
+                                   std::vector<SubmeshLod>{});
+    editableData.setTextureLayers({meshData.textureLayers().begin(),
+                                   meshData.textureLayers().end()});
+    EditableMesh mesh{Model::create(editableData, true)};
+    // Occluders are rasterized from geometry of the import, which edits
+    // would leave behind
+    mesh.model_.occluder.reset();
+    CpuGeometry& geometry = mesh.model_.cpuGeometry.value();
+    bvh::build(geometry.positions,
+               geometry.indices,
+               &threadPool,
+               geometry.bvhNodes,
+               geometry.bvhTriangles);
+    mesh.buildAdjacency(threadPool);
+    // Normals are computed by the first update the way they are kept up to
+    // date while editing
+    mesh.normals_.resize(vertexCount);
+    mesh.texCoords_ = std::move(texCoords);
+    mesh.dirtyRanges_.push_back({.first = 0, .count = vertexCount});
+    return mesh;
+}
+
+EditableMesh::EditableMesh(Model&& model)
+    : model_{std::move(model)}
+    , lastUploadVertexCount_{0}
+{
+}
+
+std::span<glm::vec3> EditableMesh::editPositions(std::uint32_t firstVertex,
+                                                 std::uint32_t vertexCount)
+{
+    dirtyRanges_.push_back({.first = firstVertex, .count = vertexCount});
+    for (std::uint32_t block = firstVertex / BOUNDS_BLOCK_SIZE;
+         block * BOUNDS_BLOCK_SIZE < firstVertex + vertexCount;
+         ++block)
+    {
+        dirtyBlocks_[block] = true;
+    }
+    return std::span{model_.cpuGeometry->positions}.subspan(firstVertex,
+                                                           vertexCount);
+}
+
+void EditableMesh::update(StreamBuffer& streamBuffer, ThreadPool& threadPool)
+{
+    lastUploadVertexCount_ = 0;
+    if (dirtyRanges_.empty())
+    {
+        return;
+    }
+    PROFILE_SCOPE("EditableMesh::update");
+    CpuGeometry& geometry = model_.cpuGeometry.value();
+    const auto vertexCount
+        = static_cast<std::uint32_t>(geometry.positions.size());
+    uploadRanges_.clear();
+    if (collectAffected())
+    {
+        updateNormals(affectedVertices_, threadPool);
+        for (const std::uint32_t vertex : affectedVertices_)
+        {
+            if (!uploadRanges_.empty()
+                && vertex <= uploadRanges_.back().first
+                                 + uploadRanges_.back().count
+                                 + UPLOAD_GAP_VERTEX_COUNT)
+            {
+                uploadRanges_.back().count
+                    = vertex - uploadRanges_.back().first + 1;
+                continue;
+            }
+            uploadRanges_.push_back({.first = vertex, .count = 1});
+        }
+    }
+    else
+    {
+        // Every vertex is visited by index instead of collecting them
+        affectedVertices_.clear();
+        threadPool.parallelFor(
+            vertexCount,
+            BATCH_SIZE,
+            [&](size_t begin, size_t end)
+            {
+                for (size_t vertex = begin; vertex < end; ++vertex)
+                {
+                    normals_[vertex]
+                        = computeNormal(static_cast<std::uint32_t>(vertex));
+                }
+            });
+        uploadRanges_.push_back({.first = 0, .count = vertexCount});
+        dirtyNodes_.clear();
+        for (size_t node = 0; node < geometry.bvhNodes.size(); ++node)
+        {
+            if (geometry.bvhNodes[node].triangleCount > 0)
+            {
+                dirtyNodes_.push_back(static_cast<std::uint32_t>(node));
+            }
+        }
+    }
+    dirtyRanges_.clear();
+
+    updateBounds(threadPool);
+    if (!dirtyNodes_.empty())
+    {
+        bvh::refit(geometry.bvhNodes,
+                   geometry.bvhTriangles,
+                   geometry.positions,
+                   geometry.indices,
+                   bvhParents_,
+                   dirtyNodes_,
+                   &threadPool);
+    }
+    upload(streamBuffer, threadPool);
+}
+
+void EditableMesh::buildAdjacency(ThreadPool& threadPool)
+{
+    const CpuGeometry& geometry = model_.cpuGeometry.value();
+    const size_t vertexCount = geometry.positions.size();
+    const size_t triangleCount = geometry.indices.size() / 3;
+
+    // Counting sort of triangle corners by vertex
+    adjacencyOffsets_.assign(vertexCount + 1, 0);
+    for (const GLuint vertex : geometry.indices)
+    {
+        ++adjacencyOffsets_[vertex + 1];
+    }
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        adjacencyOffsets_[vertex + 1] += adjacencyOffsets_[vertex];
+    }
+    adjacentTriangles_.resize(geometry.indices.size());
+    std::vector<std::uint32_t> cursors(adjacencyOffsets_.begin(),
+                                       adjacencyOffsets_.end() - 1);
+    for (size_t i = 0; i < geometry.indices.size(); ++i)
+    {
+        adjacentTriangles_[cursors[geometry.indices[i]]++]
+            = static_cast<std::uint32_t>(i / 3);
+    }
+
+    triangleLeaves_.assign(triangleCount, 0);
+    threadPool.parallelFor(
+        geometry.bvhNodes.size(),
+        BATCH_SIZE,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t node = begin; node < end; ++node)
+            {
+                const BvhNode& leaf = geometry.bvhNodes[node];
+                for (std::uint32_t i = 0; i < leaf.triangleCount; ++i)
+                {
+                    triangleLeaves_[geometry.bvhTriangles[leaf.first + i]]
+                        = static_cast<std::uint32_t>(node);
+                }
+            }
+        });
+    bvh::findParents(geometry.bvhNodes, bvhParents_);
+
+    const size_t blockCount
+        = (vertexCount + BOUNDS_BLOCK_SIZE - 1) / BOUNDS_BLOCK_SIZE;
+    blockBounds_.resize(blockCount);
+    dirtyBlocks_.assign(blockCount, true);
+    vertexMarks_.assign(vertexCount, 0);
+    triangleMarks_.assign(triangleCount, 0);
+}
+
+bool EditableMesh::collectAffected()
+{
+    const CpuGeometry& geometry = model_.cpuGeometry.value();
+    size_t dirtyVertexCount = 0;
+    for (const VertexRange& range : dirtyRanges_)
+    {
+        dirtyVertexCount += range.count;
+    }
+    if (dirtyVertexCount * 100
+        > geometry.positions.size() * MAX_INCREMENTAL_SHARE_PERCENT)
+    {
+        return false;
+    }
+
+    // Normals change for every vertex of a triangle with a moved corner.
+    // Moved vertices are collected themselves as well, even when no
+    // triangle refers to them.
+    affectedVertices_.clear();
+    affectedTriangles_.clear();
+    dirtyNodes_.clear();
+    const auto addVertex = [&](std::uint32_t vertex)
+    {
+        if (vertexMarks_[vertex] == 0)
+        {
+            vertexMarks_[vertex] = 1;
+            affectedVertices_.push_back(vertex);
+        }
+    };
+    for (const VertexRange& range : dirtyRanges_)
+    {
+        for (std::uint32_t vertex = range.first;
+             vertex < range.first + range.count;
+             ++vertex)
+        {
+            addVertex(vertex);
+            for (std::uint32_t i = adjacencyOffsets_[vertex];
+                 i < adjacencyOffsets_[vertex + 1];
+                 ++i)
+            {
+                const std::uint32_t triangle = adjacentTriangles_[i];
+                if (triangleMarks_[triangle] == 0)
+                {
+                    triangleMarks_[triangle] = 1;
+                    affectedTriangles_.push_back(triangle);
+                }
+            }
+        }
+    }
+    const bool hasBvh = !geometry.bvhNodes.empty();
+    for (const std::uint32_t triangle : affectedTriangles_)
+    {
+        triangleMarks_[triangle] = 0;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            addVertex(geometry.indices[triangle * 3 + corner]);
+        }
+        if (hasBvh)
+        {
+            dirtyNodes_.push_back(triangleLeaves_[triangle]);
+        }
+    }
+    for (const std::uint32_t vertex : affectedVertices_)
+    {
+        vertexMarks_[vertex] = 0;
+    }
+    // Sorted for merging upload ranges, and leaves for refitting each once
+    std::ranges::sort(affectedVertices_);
+    std::ranges::sort(dirtyNodes_);
+    const auto duplicateNodes = std::ranges::unique(dirtyNodes_);
+    dirtyNodes_.erase(duplicateNodes.begin(), duplicateNodes.end());
+    return true;
+}
+
+glm::vec3 EditableMesh::computeNormal(std::uint32_t vertex) const
+{
+    // Area weighted like the normals generated on import
+    const CpuGeometry& geometry = model_.cpuGeometry.value();
+    glm::vec3 normal{0.0F};
+    for (std::uint32_t i = adjacencyOffsets_[vertex];
+         i < adjacencyOffsets_[vertex + 1];
+         ++i)
+    {
+        const GLuint* corners
+            = &geometry.indices[size_t{adjacentTriangles_[i]} * 3];
+        const glm::vec3& a = geometry.positions[corners[0]];
+        normal += glm::cross(geometry.positions[corners[1]] - a,
+                             geometry.positions[corners[2]] - a);
+    }
+    const float length = glm::length(normal);
+    return length > 0.0F ? normal / length : glm::vec3{0.0F, 0.0F, 1.0F};
+}
+
+void EditableMesh::updateNormals(std::span<const std::uint32_t> vertices,
+                                 ThreadPool& threadPool)
+{
+    threadPool.parallelFor(vertices.size(),
+                           BATCH_SIZE,
+                           [&](size_t begin, size_t end)
+                           {
+                               for (size_t i = begin; i < end; ++i)
+                               {
+                                   normals_[vertices[i]]
+                                       = computeNormal(vertices[i]);
+                               }
+                           });
+}
+
+void EditableMesh::updateBounds(ThreadPool& threadPool)
+{
+    const std::span<const glm::vec3> positions
+        = model_.cpuGeometry->positions;
+    if (positions.empty())
+    {
+        return;
+    }
+    threadPool.parallelFor(
+        blockBounds_.size(),
+        1,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t block = begin; block < end; ++block)
+            {
+                if (!dirtyBlocks_[block])
+                {
+                    continue;
+                }
+                const std::span<const glm::vec3> blockPositions
+                    = positions.subspan(
+                        block * BOUNDS_BLOCK_SIZE,
+                        std::min<size_t>(BOUNDS_BLOCK_SIZE,
+                                         positions.size()
+                                             - block * BOUNDS_BLOCK_SIZE));
+                Bounds bounds{.minimum = blockPositions.front(),
+                              .maximum = blockPositions.front()};
+                for (const glm::vec3& position : blockPositions)
+                {
+                    bounds.minimum = glm::min(bounds.minimum, position);
+                    bounds.maximum = glm::max(bounds.maximum, position);
+                }
+                blockBounds_[block] = bounds;
+            }
+        });
+    std::fill(dirtyBlocks_.begin(), dirtyBlocks_.end(), false);
+
+    Bounds& bounds = model_.bounds;
+    bounds = blockBounds_.front();
+    for (const Bounds& blockBounds : blockBounds_)
+    {
+        bounds.minimum = glm::min(bounds.minimum, blockBounds.minimum);
+        bounds.maximum = glm::max(bounds.maximum, blockBounds.maximum);
+    }
+    model_.boundingSphere = {
+        .center = (bounds.minimum + bounds.maximum) * 0.5F,
+        .radius = glm::length(bounds.maximum - bounds.minimum) * 0.5F,
+    };
+}
+
+void EditableMesh::upload(StreamBuffer& streamBuffer, ThreadPool& threadPool)
+{
+    size_t uploadVertexCount = 0;
+    for (const VertexRange& range : uploadRanges_)
+    {
+        uploadVertexCount += range.count;
+    }
+    if (uploadVertexCount == 0)
+    {
+        return;
+    }
+    const std::span<const glm::vec3> positions
+        = model_.cpuGeometry->positions;
+    const StreamBuffer::Range streamRange = streamBuffer.write(
+        static_cast<GLsizeiptr>(uploadVertexCount * sizeof(Vertex)),
+        alignof(Vertex),
+        [&](std::span<std::byte> memory)
+        {
+            auto* vertices = reinterpret_cast<Vertex*>(memory.data());
+            for (const VertexRange& range : uploadRanges_)
+            {
+                threadPool.parallelFor(
+                    range.count,
+                    BATCH_SIZE,
+                    [&](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            vertices[i] = {
+                                .position = positions[range.first + i],
+                                .normal = normals_[range.first + i],
+                                .texCoord = texCoords_[range.first + i],
+                            };
+                        }
+                    });
+                vertices += range.count;
+            }
+        });
+
+    glBindBuffer(GL_COPY_READ_BUFFER, streamRange.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, model_.vertexBuffer());
+    GLintptr readOffset = streamRange.offset;
+    for (const VertexRange& range : uploadRanges_)
+    {
+        const auto size
+            = static_cast<GLsizeiptr>(range.count * sizeof(Vertex));
+        glCopyBufferSubData(
+            GL_COPY_READ_BUFFER,
+            GL_COPY_WRITE_BUFFER,
+            readOffset,
+            static_cast<GLintptr>(range.first * sizeof(Vertex)),
+            size);
+        readOffset += size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    lastUploadVertexCount_ = uploadVertexCount;
+}
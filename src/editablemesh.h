@@ -0,0 +1,135 @@
+#ifndef EDITABLE_MESH_H_
+#define EDITABLE_MESH_H_
+
+#include "mesh.h"
+#include "model.h"
+#include "streambuffer.h"
+
+#include "glad/gl.h"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+/// Model whose vertex positions are edited interactively, like by sculpting
+/// or previewing deformations, with only the changed part of the geometry
+/// updated each frame.
+///
+/// Positions are kept in system memory as CPU geometry of the model, so that
+/// ray queries answer against the edited surface. Edited vertex ranges are
+/// marked dirty, and updating recomputes normals of the vertices around
+/// them, bounds of the blocks of vertices they fall in and the bounding
+/// volume hierarchy leaves of the triangles around them on the thread pool.
+/// The hierarchy is refit instead of rebuilt. Changed vertices are written
+/// into the stream buffer and copied into the vertex buffer of the model on
+/// the GPU, merged into ranges across small gaps. Edits touching most of the
+/// mesh update it whole instead, which is cheaper than tracking every vertex.
+///
+/// Geometry is stored at full precision, as quantized positions would have
+/// to be repacked whenever the bounds grow. Simplified levels of detail would
+/// no longer match the edited surface and are left out, so that the model is
+/// always drawn at full detail. Bounding sphere is the one around the bounding
+/// box, which is cheap to keep up to date.
+///
+/// Storage used while updating is kept between frames, allocating nothing
+/// for edits of the same extent. Non-copyable, move-only. Must be created
+/// and updated on the thread the graphics context is current on.
+class EditableMesh
+{
+public:
+    /// Factory method uploading imported geometry for editing. Normals are
+    /// computed by the first update.
+    static EditableMesh create(const MeshData& meshData,
+                               ThreadPool& threadPool);
+
+    EditableMesh(const EditableMesh&) = delete;
+    EditableMesh& operator=(const EditableMesh&) = delete;
+    EditableMesh(EditableMesh&&) noexcept = default;
+    EditableMesh& operator=(EditableMesh&&) noexcept = default;
+    ~EditableMesh() = default;
+
+    [[nodiscard]] std::span<const glm::vec3> positions() const
+    {
+        return model_.cpuGeometry->positions;
+    }
+    /// Positions of a vertex range to be overwritten, marking the range
+    /// dirty until the next update.
+    std::span<glm::vec3> editPositions(std::uint32_t firstVertex,
+                                       std::uint32_t vertexCount);
+
+    /// Bring normals, bounding volumes and the vertex buffer up to date with
+    /// the edits since the last update. Called once per frame after the
+    /// stream buffer began it.
+    void update(StreamBuffer& streamBuffer, ThreadPool& threadPool);
+
+    /// Model drawn like any other, with edits of the last update.
+    [[nodiscard]] const Model& model() const { return model_; }
+
+    /// Vertices and bytes uploaded by the last update.
+    [[nodiscard]] size_t lastUploadVertexCount() const
+    {
+        return lastUploadVertexCount_;
+    }
+    [[nodiscard]] size_t lastUploadSize() const
+    {
+        return lastUploadVertexCount_ * sizeof(Vertex);
+    }
+
+private:
+    /// Consecutive vertices, dirty or uploaded together.
+    struct VertexRange
+    {
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    explicit EditableMesh(Model&& model);
+
+    /// Triangles around each vertex, and leaf and blocks of the hierarchy
+    /// and bounds each triangle and vertex falls in.
+    void buildAdjacency(ThreadPool& threadPool);
+    /// Collect vertices whose normals change with the dirty ranges, and the
+    /// leaves of triangles around them. Returns false when most of the mesh
+    /// changed, in which case everything is updated.
+    bool collectAffected();
+    /// Normal of vertex averaged from the triangles around it.
+    [[nodiscard]] glm::vec3 computeNormal(std::uint32_t vertex) const;
+    void updateNormals(std::span<const std::uint32_t> vertices,
+                       ThreadPool& threadPool);
+    void updateBounds(ThreadPool& threadPool);
+    void upload(StreamBuffer& streamBuffer, ThreadPool& threadPool);
+
+    Model model_;
+    std::vector<glm::vec3> normals_;
+    /// Kept to upload along edited positions, which leave them unchanged.
+    std::vector<glm::vec2> texCoords_;
+    /// Triangles around vertex v are adjacentTriangles_ from
+    /// adjacencyOffsets_[v] up to adjacencyOffsets_[v + 1].
+    std::vector<std::uint32_t> adjacencyOffsets_;
+    std::vector<std::uint32_t> adjacentTriangles_;
+    /// Leaf of the hierarchy holding each triangle, and parents of nodes.
+    std::vector<std::uint32_t> triangleLeaves_;
+    std::vector<std::uint32_t> bvhParents_;
+    /// Bounds of fixed size blocks of consecutive vertices, whose union is
+    /// the bounds of the mesh.
+    std::vector<Bounds> blockBounds_;
+    std::vector<bool> dirtyBlocks_;
+
+    std::vector<VertexRange> dirtyRanges_;
+    /// Nonzero for vertices and triangles collected by the current update,
+    /// cleared again before it returns.
+    std::vector<std::uint8_t> vertexMarks_;
+    std::vector<std::uint8_t> triangleMarks_;
+    std::vector<std::uint32_t> affectedVertices_;
+    std::vector<std::uint32_t> affectedTriangles_;
+    std::vector<std::uint32_t> dirtyNodes_;
+    std::vector<VertexRange> uploadRanges_;
+    size_t lastUploadVertexCount_;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#include "embeddedshaders.h"
+
+#include <algorithm>
+#include <string>
+
+namespace embeddedshaders
+{
+const Source* find(const std::filesystem::path& path)
+{
+    const std::string key = path.lexically_normal().generic_string();
+    const std::span<const Source> table = sources();
+    const auto it = std::ranges::lower_bound(table,
+                                             std::string_view{key},
+                                             {},
+                                             &Source::path);
+    if (it == table.end() || it->path != key)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
+}  // namespace embeddedshaders
@@ -0,0 +1,46 @@
+#ifndef EMBEDDED_SHADERS_H_
+#define EMBEDDED_SHADERS_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+/// GLSL sources of the shader directory compiled into the executable, so that
+/// shaders are created on startup without reading files.
+///
+/// Sources are turned into constant tables by a build step, keyed by the same
+/// relative paths shaders are submitted from, and hashed at compile time for
+/// keying the program binary cache.
+namespace embeddedshaders
+{
+constexpr std::uint64_t HASH_OFFSET_BASIS = 14695981039346656037U;
+
+/// 64-bit FNV-1a hash, continuing from previous hash value.
+constexpr std::uint64_t hashBytes(std::string_view bytes,
+                                  std::uint64_t hash = HASH_OFFSET_BASIS)
+{
+    for (const char c : bytes)
+    {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 1099511628211U;
+    }
+    return hash;
+}
+
+struct Source
+{
+    std::string_view path;
+    std::string_view text;
+    std::uint64_t hash;
+};
+
+/// Every embedded source, sorted by path. Defined by the generated table.
+std::span<const Source> sources();
+
+/// Embedded source at relative path, or nullptr when the path is not part of
+/// the shader directory.
+const Source* find(const std::filesystem::path& path);
+}  // namespace embeddedshaders
+
+#endif
@@ -0,0 +1,251 @@
+#include "filewatcher.h"
+
+#include <algorithm>
+#include <array>
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Change notifications read at once. Notifications not fitting are read in
+/// the next iteration on Linux, but dropped on Windows.
+constexpr size_t NOTIFICATION_BUFFER_SIZE = 16384;
+}  // namespace
+
+FileWatcher::FileWatcher()
+#ifdef _WIN32
+    : directoryHandle_{INVALID_HANDLE_VALUE}
+    , stopEvent_{nullptr}
+#else
+    : inotifyDescriptor_{-1}
+    , stopDescriptor_{-1}
+#endif
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef _WIN32
+    if (thread_.joinable())
+    {
+        SetEvent(stopEvent_);
+        thread_.join();
+    }
+    if (stopEvent_)
+    {
+        CloseHandle(stopEvent_);
+    }
+    if (directoryHandle_ != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(directoryHandle_);
+    }
+#elif defined(__linux__)
+    if (thread_.joinable())
+    {
+        const std::uint64_t wakeUp = 1;
+        [[maybe_unused]] const ssize_t written
+            = write(stopDescriptor_, &wakeUp, sizeof(wakeUp));
+        thread_.join();
+    }
+    if (stopDescriptor_ >= 0)
+    {
+        close(stopDescriptor_);
+    }
+    if (inotifyDescriptor_ >= 0)
+    {
+        close(inotifyDescriptor_);
+    }
+#endif
+}
+
+bool FileWatcher::start(const fs::path& directory)
+{
+    directory_ = directory;
+#ifdef _WIN32
+    // Overlapped reads let the watcher thread wait for changes and stop
+    // request at the same time
+    directoryHandle_
+        = CreateFileW(directory.c_str(),
+                      FILE_LIST_DIRECTORY,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      nullptr,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                      nullptr);
+    if (directoryHandle_ == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    stopEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!stopEvent_)
+    {
+        return false;
+    }
+#elif defined(__linux__)
+    inotifyDescriptor_ = inotify_init1(IN_CLOEXEC);
+    if (inotifyDescriptor_ < 0)
+    {
+        return false;
+    }
+    // Editors either write files in place or replace them with a renamed
+    // temporary file
+    if (inotify_add_watch(inotifyDescriptor_,
+                          directory.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO)
+        < 0)
+    {
+        return false;
+    }
+    stopDescriptor_ = eventfd(0, EFD_CLOEXEC);
+    if (stopDescriptor_ < 0)
+    {
+        return false;
+    }
+#else
+    return false;
+#endif
+
+    thread_ = std::thread(&FileWatcher::watchLoop, this);
+    return true;
+}
+
+std::vector<fs::path> FileWatcher::takeChangedFiles()
+{
+    std::vector<fs::path> changedFiles;
+    const std::lock_guard lock(mutex_);
+    changedFiles.swap(changedFiles_);
+    return changedFiles;
+}
+
+void FileWatcher::addChangedFile(const fs::path& fileName)
+{
+    // Saving a file may notify about several writes
+    fs::path path = directory_ / fileName;
+    const std::lock_guard lock(mutex_);
+    if (std::find(changedFiles_.begin(), changedFiles_.end(), path)
+        == changedFiles_.end())
+    {
+        changedFiles_.emplace_back(std::move(path));
+    }
+}
+
+void FileWatcher::watchLoop()
+{
+#ifdef _WIN32
+    OVERLAPPED overlapped{};
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    const std::array<HANDLE, 2> events{overlapped.hEvent, stopEvent_};
+    alignas(DWORD) std::array<std::byte, NOTIFICATION_BUFFER_SIZE> buffer;
+    while (true)
+    {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(directoryHandle_,
+                                   buffer.data(),
+                                   static_cast<DWORD>(buffer.size()),
+                                   FALSE,
+                                   FILE_NOTIFY_CHANGE_LAST_WRITE
+                                       | FILE_NOTIFY_CHANGE_FILE_NAME,
+                                   nullptr,
+                                   &overlapped,
+                                   nullptr))
+        {
+            break;
+        }
+
+        const DWORD signaled
+            = WaitForMultipleObjects(static_cast<DWORD>(events.size()),
+                                     events.data(),
+                                     FALSE,
+                                     INFINITE);
+        DWORD transferred = 0;
+        if (signaled != WAIT_OBJECT_0)
+        {
+            // Buffer has to outlive the read, so wait for cancellation
+            CancelIo(directoryHandle_);
+            GetOverlappedResult(directoryHandle_,
+                                &overlapped,
+                                &transferred,
+                                TRUE);
+            break;
+        }
+        // Zero bytes are transferred when notifications overflowed the buffer
+        if (!GetOverlappedResult(directoryHandle_,
+                                 &overlapped,
+                                 &transferred,
+                                 FALSE)
+            || transferred == 0)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        while (true)
+        {
+            const auto* notification
+                = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(
+                    buffer.data() + offset);
+            if (notification->Action == FILE_ACTION_ADDED
+                || notification->Action == FILE_ACTION_MODIFIED
+                || notification->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                addChangedFile(std::wstring(
+                    notification->FileName,
+                    notification->FileNameLength / sizeof(WCHAR)));
+            }
+            if (notification->NextEntryOffset == 0)
+            {
+                break;
+            }
+            offset += notification->NextEntryOffset;
+        }
+    }
+    CloseHandle(overlapped.hEvent);
+#elif defined(__linux__)
+    std::array<pollfd, 2> descriptors{{
+        {.fd = inotifyDescriptor_, .events = POLLIN, .revents = 0},
+        {.fd = stopDescriptor_, .events = POLLIN, .revents = 0},
+    }};
+    alignas(inotify_event) std::array<char, NOTIFICATION_BUFFER_SIZE> buffer;
+    while (true)
+    {
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        if (descriptors[1].revents != 0)
+        {
+            return;
+        }
+
+        const ssize_t length
+            = read(inotifyDescriptor_, buffer.data(), buffer.size());
+        ssize_t offset = 0;
+        while (offset < length)
+        {
+            const auto* event = reinterpret_cast<const inotify_event*>(
+                buffer.data() + offset);
+            if (event->len > 0)
+            {
+                addChangedFile(event->name);
+            }
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+    }
+#endif
+}
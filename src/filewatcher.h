@@ -0,0 +1,57 @@
+#ifndef FILE_WATCHER_H_
+#define FILE_WATCHER_H_
+
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Background thread waiting for files of a directory to be written,
+/// collecting their paths until the main thread takes them.
+///
+/// Uses inotify on Linux and ReadDirectoryChangesW on Windows. Watching is
+/// not supported on other platforms, where start() fails. Subdirectories are
+/// not watched.
+///
+/// Non-copyable, non-movable, the watcher thread refers to the instance.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    FileWatcher(FileWatcher&&) = delete;
+    FileWatcher& operator=(FileWatcher&&) = delete;
+
+    /// Stop and join watcher thread.
+    ~FileWatcher();
+
+    /// Start watching directory for files being written. Controlled
+    /// initialization for explicit error handling.
+    bool start(const std::filesystem::path& directory);
+
+    /// Paths of files written since the last call, each reported once.
+    /// Paths are the watched directory as given to start(), joined with the
+    /// file name.
+    std::vector<std::filesystem::path> takeChangedFiles();
+
+private:
+    void watchLoop();
+    void addChangedFile(const std::filesystem::path& fileName);
+
+    std::filesystem::path directory_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::vector<std::filesystem::path> changedFiles_;
+#ifdef _WIN32
+    void* directoryHandle_;
+    /// Signaled on destruction to wake watcher thread up from waiting.
+    void* stopEvent_;
+#else
+    int inotifyDescriptor_;
+    /// Written on destruction to wake watcher thread up from waiting.
+    int stopDescriptor_;
+#endif
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "frameallocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameAllocator::FrameAllocator(size_t initialCapacity)
+    : currentBlock_{0}
+{
+    for (Block& block : blocks_)
+    {
+        block.reset(initialCapacity);
+    }
+}
+
+void FrameAllocator::beginFrame()
+{
+    currentBlock_ = (currentBlock_ + 1) % blocks_.size();
+    Block& block = blocks_[currentBlock_];
+    block.reset(block.capacity());
+}
+
+FrameAllocator::Statistics FrameAllocator::previousFrameStatistics() const
+{
+    const Block& block = blocks_[(currentBlock_ + 1) % blocks_.size()];
+    return {
+        .usedSize = block.usedSize(),
+        .capacity = block.capacity(),
+        .allocationCount = block.allocationCount(),
+        .fallbackCount = block.fallbackCount(),
+    };
+}
+
+FrameAllocator::Block::Block()
+    : capacity_{0}
+    , usedSize_{0}
+    , demandedSize_{0}
+    , allocationCount_{0}
+    , fallbackCount_{0}
+{
+}
+
+void FrameAllocator::Block::reset(size_t capacity)
+{
+    // Storage is only reallocated after a frame outgrew it, which settles
+    // once frames repeat the same work
+    const size_t requiredCapacity = std::max(capacity, demandedSize_);
+    if (requiredCapacity > capacity_)
+    {
+        storage_ = std::make_unique<std::byte[]>(requiredCapacity);
+        capacity_ = requiredCapacity;
+    }
+    usedSize_ = 0;
+    demandedSize_ = 0;
+    allocationCount_ = 0;
+    fallbackCount_ = 0;
+}
+
+void* FrameAllocator::Block::do_allocate(size_t bytes, size_t alignment)
+{
+    // Alignment is applied to the address, as storage is only aligned for
+    // fundamental types
+    const auto base = reinterpret_cast<std::uintptr_t>(storage_.get());
+    const std::uintptr_t address
+        = (base + usedSize_ + alignment - 1) / alignment * alignment;
+    const size_t end = address - base + bytes;
+    demandedSize_ += end - usedSize_;
+    ++allocationCount_;
+    if (end > capacity_)
+    {
+        ++fallbackCount_;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    usedSize_ = end;
+    // NOLINTNEXTLINE(performance-no-int-to-ptr)
+    return reinterpret_cast<void*>(address);
+}
+
+void FrameAllocator::Block::do_deallocate(void* pointer,
+                                          size_t bytes,
+                                          size_t alignment)
+{
+    // Memory of the block is released all at once by reset(), only heap
+    // fallbacks are freed one by one
+    const std::byte* begin = storage_.get();
+    const auto* address = static_cast<const std::byte*>(pointer);
+    if (address < begin || address >= begin + capacity_)
+    {
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef FRAME_ALLOCATOR_H_
+#define FRAME_ALLOCATOR_H_
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+/// Linear allocator for temporary CPU data of a frame, like culling results
+/// and draw lists, handed to std::pmr containers.
+///
+/// Allocation bumps an offset into a preallocated block and deallocation does
+/// nothing, everything is released at once when the block is reset. Two
+/// blocks are used in turns, so that data allocated in a frame stays valid
+/// until the end of the next one.
+///
+/// Allocations not fitting the block fall back to the heap, and are counted
+/// apart from those made from the block.
+/// The block is grown to fit the next time it is reset, so that frames doing
+/// the same work as before do not touch the heap at all. Not thread-safe,
+/// allocations are meant to be made on the main thread only.
+class FrameAllocator
+{
+public:
+    /// Usage of a block by a frame.
+    struct Statistics
+    {
+        /// Bytes allocated from the block so far, including alignment.
+        size_t usedSize;
+        size_t capacity;
+        /// Every allocation made by the frame, from the block or the heap.
+        size_t allocationCount;
+        /// Allocations that did not fit the block and fell back to the heap.
+        size_t fallbackCount;
+    };
+
+    explicit FrameAllocator(size_t initialCapacity);
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+    FrameAllocator(FrameAllocator&&) = delete;
+    FrameAllocator& operator=(FrameAllocator&&) = delete;
+    ~FrameAllocator() = default;
+
+    /// Switch to the other block and release everything allocated from it two
+    /// frames ago. Meant to be called at the start of each frame.
+    void beginFrame();
+
+    /// Memory resource allocating from the block of the current frame.
+    [[nodiscard]] std::pmr::memory_resource* resource()
+    {
+        return &blocks_[currentBlock_];
+    }
+
+    /// Usage by the previous frame, which finished allocating.
+    [[nodiscard]] Statistics previousFrameStatistics() const;
+
+private:
+    class Block : public std::pmr::memory_resource
+    {
+    public:
+        Block();
+
+        /// Release all allocations, growing storage to at least capacity, or
+        /// to fit everything allocated since the previous reset if more.
+        void reset(size_t capacity);
+
+        [[nodiscard]] size_t usedSize() const { return usedSize_; }
+        [[nodiscard]] size_t capacity() const { return capacity_; }
+        [[nodiscard]] size_t allocationCount() const
+        {
+            return allocationCount_;
+        }
+        [[nodiscard]] size_t fallbackCount() const { return fallbackCount_; }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer,
+                           size_t bytes,
+                           size_t alignment) override;
+        [[nodiscard]] bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        std::unique_ptr<std::byte[]> storage_;
+        size_t capacity_;
+        size_t usedSize_;
+        /// Bytes that would have been used with enough storage, including
+        /// those that went to the heap.
+        size_t demandedSize_;
+        size_t allocationCount_;
+        size_t fallbackCount_;
+    };
+
+    std::array<Block, 2> blocks_;
+    size_t currentBlock_;
+};
+
+#endif
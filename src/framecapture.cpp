@@ -0,0 +1,243 @@
+#include "framecapture.h"
+
+#include "pngwriter.h"
+#include "utils.h"
+
+#include "glad/gl.h"
+
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Readbacks in flight. Frames are usually read back a frame or two after
+/// being drawn, a third buffer covers frames the GPU is late with.
+constexpr size_t READBACK_BUFFER_COUNT = 3;
+/// Video frames waiting for the encoder thread before further ones are
+/// dropped, bounding memory held by frames when the disk is too slow.
+constexpr size_t MAX_QUEUED_FRAME_COUNT = 8;
+
+/// First path of numbered files not taken yet, advancing the number past it.
+fs::path nextFreePath(const std::string& prefix,
+                      const std::string& suffix,
+                      size_t& number)
+{
+    while (true)
+    {
+        ++number;
+        fs::path path = prefix + std::to_string(number) + suffix;
+        std::error_code error;
+        if (!fs::exists(path, error))
+        {
+            return path;
+        }
+    }
+}
+}  // namespace
+
+FrameCapture::FrameCapture()
+    : pixelReadback_(READBACK_BUFFER_COUNT)
+    , screenshotRequested_{false}
+    , recording_{false}
+    , session_{0}
+    , screenshotCount_{0}
+    , droppedFrameCount_{0}
+    , queuedFrameCount_{0}
+    , videoSession_{0}
+    , videoWidth_{0}
+    , videoHeight_{0}
+    , videoFileCount_{0}
+    , stopping_{false}
+{
+    thread_ = std::thread(&FrameCapture::encodeLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    {
+        const std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    taskQueued_.notify_one();
+    thread_.join();
+}
+
+void FrameCapture::requestScreenshot()
+{
+    screenshotRequested_ = true;
+}
+
+void FrameCapture::toggleRecording()
+{
+    recording_ = !recording_;
+    if (recording_)
+    {
+        ++session_;
+        droppedFrameCount_ = 0;
+        utils::logInfo("started recording video");
+        return;
+    }
+    utils::logInfo("stopped recording video, ",
+                   droppedFrameCount_,
+                   " frames dropped");
+}
+
+void FrameCapture::captureFrame(int width, int height)
+{
+    // Finished readbacks are taken first, freeing their buffers for this
+    // frame
+    while (std::optional<PixelReadback::Pixels> pixels
+           = pixelReadback_.takeFinished())
+    {
+        submit(std::move(pixels.value()));
+    }
+
+    size_t id = 0;
+    if (recording_)
+    {
+        id |= VIDEO_FLAG | (static_cast<size_t>(session_) << SESSION_SHIFT);
+        if (pixelReadback_.isFull()
+            || queuedFrameCount_.load(std::memory_order_relaxed)
+                   >= MAX_QUEUED_FRAME_COUNT)
+        {
+            ++droppedFrameCount_;
+            id &= ~VIDEO_FLAG;
+        }
+    }
+    // Screenshot waits for the next frame with a free buffer
+    if (screenshotRequested_ && !pixelReadback_.isFull())
+    {
+        screenshotRequested_ = false;
+        id |= SCREENSHOT_FLAG;
+    }
+    if ((id & (SCREENSHOT_FLAG | VIDEO_FLAG)) == 0)
+    {
+        return;
+    }
+
+    // Frame with UI on top is in the back buffer of the window, not in the
+    // offscreen scene framebuffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    pixelReadback_.readPixels(id, width, height);
+}
+
+void FrameCapture::finish()
+{
+    while (pixelReadback_.hasPending())
+    {
+        submit(pixelReadback_.takeOldest());
+    }
+}
+
+void FrameCapture::submit(PixelReadback::Pixels&& pixels)
+{
+    if (pixels.data.empty())
+    {
+        utils::showErrorMessage("unable to read back captured frame");
+        return;
+    }
+
+    fs::path screenshotPath;
+    if (pixels.id & SCREENSHOT_FLAG)
+    {
+        screenshotPath = nextFreePath("screenshot_", ".png", screenshotCount_);
+    }
+    const bool videoFrame = (pixels.id & VIDEO_FLAG) != 0;
+    const auto session = static_cast<std::uint32_t>(pixels.id >> SESSION_SHIFT);
+    queuedFrameCount_.fetch_add(1, std::memory_order_relaxed);
+    {
+        const std::lock_guard lock(mutex_);
+        tasks_.emplace_back(
+            [this,
+             pixels = std::move(pixels),
+             screenshotPath = std::move(screenshotPath),
+             videoFrame,
+             session]()
+            {
+                if (!screenshotPath.empty())
+                {
+                    if (pngwriter::writeFramebuffer(
+                            screenshotPath,
+                            static_cast<std::uint32_t>(pixels.width),
+                            static_cast<std::uint32_t>(pixels.height),
+                            pixels.data))
+                    {
+                        utils::logInfo("saved screenshot ", screenshotPath);
+                    }
+                    else
+                    {
+                        utils::showErrorMessage("unable to write screenshot ",
+                                                screenshotPath);
+                    }
+                }
+                if (videoFrame)
+                {
+                    appendVideoFrame(pixels, session);
+                }
+                queuedFrameCount_.fetch_sub(1, std::memory_order_relaxed);
+            });
+    }
+    taskQueued_.notify_one();
+}
+
+void FrameCapture::encodeLoop()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        taskQueued_.wait(lock,
+                         [this]() { return stopping_ || !tasks_.empty(); });
+        // Frames queued before stopping are still written
+        if (tasks_.empty())
+        {
+            return;
+        }
+        const std::function<void()> task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+void FrameCapture::appendVideoFrame(const PixelReadback::Pixels& pixels,
+                                    std::uint32_t session)
+{
+    // Sessions are numbered from one, so the first frame starts a file
+    if (session != videoSession_ || pixels.width != videoWidth_
+        || pixels.height != videoHeight_)
+    {
+        // Raw frames carry no size, so each file holds frames of one size
+        videoFile_.close();
+        videoSession_ = session;
+        videoWidth_ = pixels.width;
+        videoHeight_ = pixels.height;
+        const fs::path videoPath = nextFreePath(
+            "capture_",
+            "_" + std::to_string(videoWidth_) + "x"
+                + std::to_string(videoHeight_) + ".rgba",
+            videoFileCount_);
+        videoFile_.open(videoPath, std::ios::binary);
+        if (!videoFile_)
+        {
+            utils::showErrorMessage("unable to create video file ", videoPath);
+        }
+        else
+        {
+            utils::logInfo("recording video into ", videoPath);
+        }
+    }
+    // Rest of the session is dropped when the file could not be created
+    if (!videoFile_.is_open())
+    {
+        return;
+    }
+    // Flushed right away, so that the file is complete as soon as recording
+    // stops
+    videoFile_.write(reinterpret_cast<const char*>(pixels.data.data()),
+                     static_cast<std::streamsize>(pixels.data.size()));
+    videoFile_.flush();
+}
@@ -0,0 +1,109 @@
+#ifndef FRAME_CAPTURE_H_
+#define FRAME_CAPTURE_H_
+
+#include "pixelreadback.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// Screenshots and video capture of frames presented in the window.
+///
+/// Frames are read back asynchronously and written to files by an encoder
+/// thread of its own, so that capturing does not lower the framerate.
+/// Screenshots are saved as PNG files. Video is appended to a file of raw RGBA
+/// frames with rows ordered from bottom to top, meant to be piped into a video
+/// encoder like FFmpeg. A new video file is started whenever the window is
+/// resized while recording.
+///
+/// Video frames are dropped instead of waiting when readbacks or the encoder
+/// fall behind, screenshots never are. Files are written into the working
+/// directory.
+///
+/// Non-copyable, non-movable, the encoder thread refers to the instance.
+class FrameCapture
+{
+public:
+    FrameCapture();
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+    FrameCapture(FrameCapture&&) = delete;
+    FrameCapture& operator=(FrameCapture&&) = delete;
+    /// Write frames already handed to the encoder thread and join it.
+    ~FrameCapture();
+
+    /// Save the next captured frame as a screenshot.
+    void requestScreenshot();
+    /// Start recording video from the next captured frame on, or stop
+    /// recording.
+    void toggleRecording();
+
+    /// Frames are waiting to be captured or read back, so that more frames
+    /// are needed even when nothing else changes.
+    [[nodiscard]] bool isCapturing() const
+    {
+        return screenshotRequested_ || recording_
+            || pixelReadback_.hasPending();
+    }
+
+    /// Read back the default framebuffer of given size, if the frame is to be
+    /// captured, and hand frames read back earlier over to the encoder
+    /// thread. Meant to be called after the frame is fully drawn, before
+    /// presenting it.
+    void captureFrame(int width, int height);
+    /// Wait for frames still being read back and hand them over to the
+    /// encoder thread. Meant to be called before the graphics context is
+    /// destroyed.
+    void finish();
+
+private:
+    /// Captured frame is saved as screenshot, appended to video, or both,
+    /// encoded into the identifier of its readback.
+    static constexpr size_t SCREENSHOT_FLAG = 1;
+    static constexpr size_t VIDEO_FLAG = 2;
+    /// Video session is stored above the flags.
+    static constexpr size_t SESSION_SHIFT = 2;
+
+    void submit(PixelReadback::Pixels&& pixels);
+    void encodeLoop();
+    /// Append frame to the video file of given session, starting a new file
+    /// for a new session or frame size. Runs on the encoder thread.
+    void appendVideoFrame(const PixelReadback::Pixels& pixels,
+                          std::uint32_t session);
+
+    PixelReadback pixelReadback_;
+    bool screenshotRequested_;
+    bool recording_;
+    /// Incremented each time recording starts.
+    std::uint32_t session_;
+    /// Screenshots saved so far, numbering screenshot files.
+    size_t screenshotCount_;
+    /// Video frames dropped in the current session.
+    size_t droppedFrameCount_;
+    /// Frames handed to the encoder thread and not written yet.
+    std::atomic<size_t> queuedFrameCount_;
+
+    // Only accessed by the encoder thread
+    std::ofstream videoFile_;
+    std::uint32_t videoSession_;
+    int videoWidth_;
+    int videoHeight_;
+    /// Video files started so far, numbering video files.
+    size_t videoFileCount_;
+
+    /// Guards tasks and stopping flag.
+    std::mutex mutex_;
+    std::condition_variable taskQueued_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,575 @@
+#include "framegraph.h"
+
+#include "utils.h"
+#include "videomemory.h"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+
+namespace
+{
+/// Frames a pooled texture is kept for without being handed out.
+constexpr std::uint32_t UNUSED_FRAME_LIMIT = 8;
+constexpr std::uint32_t NO_USE = UINT32_MAX;
+/// Texture unit textures are bound to while created or filtered.
+constexpr GLuint SETUP_TEXTURE_UNIT = 0;
+
+/// Pixel format and size of an internal format of transient textures.
+struct FormatInfo
+{
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    size_t pixelSize;
+};
+
+/// OpenGL ES 3.0 only accepts half float formats with half float or float
+/// pixel types, even without pixels to upload.
+constexpr std::array FORMATS{
+    FormatInfo{GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8},
+    FormatInfo{GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4},
+    FormatInfo{GL_R16F, GL_RED, GL_HALF_FLOAT, 2},
+    FormatInfo{GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1},
+    // Assuming 24-bit depth is padded to 32 bits
+    FormatInfo{GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4},
+};
+
+const FormatInfo* findFormat(GLenum internalFormat)
+{
+    const auto format = std::ranges::find(FORMATS,
+                                          internalFormat,
+                                          &FormatInfo::internalFormat);
+    return format != FORMATS.end() ? &*format : nullptr;
+}
+
+size_t getTextureSize(GLenum internalFormat, glm::ivec2 size)
+{
+    const FormatInfo* format = findFormat(internalFormat);
+    return format ? static_cast<size_t>(size.x) * static_cast<size_t>(size.y)
+                        * format->pixelSize
+                  : 0;
+}
+
+std::uint32_t getPassBit(size_t passIndex)
+{
+    return 1U << passIndex;
+}
+}  // namespace
+
+FrameGraph::FrameGraph()
+    : frameIndex_{0}
+    , executedPassCount_{0}
+    , culledPassCount_{0}
+    , requestedSize_{0}
+    , poolSize_{0}
+    , poolGeneration_{0}
+{
+}
+
+FrameGraph::~FrameGraph()
+{
+    releasePool();
+}
+
+void FrameGraph::beginFrame()
+{
+    ++frameIndex_;
+    executedPassCount_ = 0;
+    culledPassCount_ = 0;
+    requestedSize_ = 0;
+    // Indices of pooled textures are only held while a graph executes, so
+    // the pool can be compacted in between
+    std::erase_if(pool_,
+                  [this](PoolTexture& poolTexture)
+                  {
+                      if (frameIndex_ - poolTexture.lastUsedFrame
+                          <= UNUSED_FRAME_LIMIT)
+                      {
+                          return false;
+                      }
+                      deletePoolTexture(poolTexture);
+                      return true;
+                  });
+}
+
+void FrameGraph::releasePool()
+{
+    for (PoolTexture& poolTexture : pool_)
+    {
+        deletePoolTexture(poolTexture);
+    }
+    pool_.clear();
+}
+
+void FrameGraph::reset()
+{
+    resources_.clear();
+    passes_.clear();
+    accesses_.clear();
+    order_.clear();
+}
+
+FrameGraph::Resource FrameGraph::createTexture(const char* name,
+                                               const TextureDesc& desc)
+{
+    resources_.push_back({
+        .name = name,
+        .desc = desc,
+        .importedTexture = 0,
+        .imported = false,
+        .output = false,
+        .poolTexture = NO_POOL_TEXTURE,
+        .firstUse = NO_USE,
+        .lastUse = NO_USE,
+    });
+    return Resource{static_cast<std::uint32_t>(resources_.size() - 1)};
+}
+
+FrameGraph::Resource FrameGraph::importTexture(const char* name,
+                                               GLuint texture,
+                                               glm::ivec2 textureSize)
+{
+    resources_.push_back({
+        .name = name,
+        .desc = {.size = textureSize,
+                 .internalFormat = GL_NONE,
+                 .filter = GL_NONE},
+        .importedTexture = texture,
+        .imported = true,
+        .output = false,
+        .poolTexture = NO_POOL_TEXTURE,
+        .firstUse = NO_USE,
+        .lastUse = NO_USE,
+    });
+    return Resource{static_cast<std::uint32_t>(resources_.size() - 1)};
+}
+
+void FrameGraph::addPass(const char* name,
+                         std::span<const Resource> reads,
+                         std::span<const Resource> writes,
+                         Execute execute)
+{
+    if (passes_.size() == MAX_PASS_COUNT)
+    {
+        utils::logWarning("frame graph pass ", name, " over limit dropped");
+        return;
+    }
+    const auto accessBegin = static_cast<std::uint32_t>(accesses_.size());
+    for (const Resource resource : reads)
+    {
+        accesses_.push_back(resource.index);
+    }
+    for (const Resource resource : writes)
+    {
+        accesses_.push_back(resource.index);
+    }
+    passes_.push_back({
+        .name = name,
+        .execute = std::move(execute),
+        .accessBegin = accessBegin,
+        .readCount = static_cast<std::uint32_t>(reads.size()),
+        .writeCount = static_cast<std::uint32_t>(writes.size()),
+        .dataDependencies = 0,
+        .orderDependencies = 0,
+        .live = false,
+    });
+}
+
+void FrameGraph::markOutput(Resource resource)
+{
+    resources_[resource.index].output = true;
+}
+
+bool FrameGraph::execute(GlStateCache& glState)
+{
+    findDependencies();
+    cullPasses();
+    if (!sortPasses())
+    {
+        utils::logWarning("frame graph passes depend on each other in a "
+                          "cycle");
+        return false;
+    }
+    const bool allocated = allocateTransients(glState);
+    if (allocated)
+    {
+        for (const std::uint32_t passIndex : order_)
+        {
+            passes_[passIndex].execute(*this);
+        }
+        executedPassCount_ += static_cast<std::uint32_t>(order_.size());
+    }
+    culledPassCount_
+        += static_cast<std::uint32_t>(passes_.size() - order_.size());
+    // Textures return to the pool for the next graph of the frame
+    for (ResourceNode& resource : resources_)
+    {
+        if (resource.poolTexture != NO_POOL_TEXTURE)
+        {
+            pool_[resource.poolTexture].inUse = false;
+            resource.poolTexture = NO_POOL_TEXTURE;
+        }
+    }
+    return allocated;
+}
+
+FrameGraph::Target FrameGraph::target(Resource resource) const
+{
+    const ResourceNode& node = resources_[resource.index];
+    if (node.imported)
+    {
+        return Target{.texture = node.importedTexture,
+                      .framebuffer = 0,
+                      .textureSize = node.desc.size};
+    }
+    if (node.poolTexture == NO_POOL_TEXTURE)
+    {
+        return Target{.texture = 0, .framebuffer = 0, .textureSize = {}};
+    }
+    const PoolTexture& poolTexture = pool_[node.poolTexture];
+    return Target{.texture = poolTexture.texture,
+                  .framebuffer = poolTexture.framebuffer,
+                  .textureSize = poolTexture.size};
+}
+
+bool FrameGraph::isRead(const PassNode& pass, std::uint32_t resource) const
+{
+    const auto reads = std::span{accesses_}.subspan(pass.accessBegin,
+                                                    pass.readCount);
+    return std::ranges::find(reads, resource) != reads.end();
+}
+
+bool FrameGraph::isWritten(const PassNode& pass, std::uint32_t resource) const
+{
+    const auto writes = std::span{accesses_}.subspan(
+        pass.accessBegin + pass.readCount,
+        pass.writeCount);
+    return std::ranges::find(writes, resource) != writes.end();
+}
+
+void FrameGraph::findDependencies()
+{
+    // Reads first, so that writes can tell readers of earlier contents from
+    // readers of their own results
+    for (size_t i = 0; i < passes_.size(); ++i)
+    {
+        PassNode& pass = passes_[i];
+        for (std::uint32_t r = 0; r < pass.readCount; ++r)
+        {
+            const std::uint32_t resource = accesses_[pass.accessBegin + r];
+            std::optional<size_t> writer;
+            for (size_t j = 0; j < i; ++j)
+            {
+                if (isWritten(passes_[j], resource))
+                {
+                    writer = j;
+                }
+            }
+            // Imported textures have contents before any pass writes them,
+            // transients only get them from a writer declared later
+            for (size_t j = passes_.size(); !writer && j-- > i + 1;)
+            {
+                if (!resources_[resource].imported
+                    && isWritten(passes_[j], resource))
+                {
+                    writer = j;
+                }
+            }
+            if (writer)
+            {
+                pass.dataDependencies |= getPassBit(writer.value());
+            }
+        }
+        pass.orderDependencies = pass.dataDependencies;
+    }
+    for (size_t i = 0; i < passes_.size(); ++i)
+    {
+        PassNode& pass = passes_[i];
+        for (std::uint32_t w = 0; w < pass.writeCount; ++w)
+        {
+            const std::uint32_t resource
+                = accesses_[pass.accessBegin + pass.readCount + w];
+            for (size_t j = 0; j < i; ++j)
+            {
+                const PassNode& earlier = passes_[j];
+                const bool readsResult
+                    = (earlier.dataDependencies & getPassBit(i)) != 0;
+                if (isWritten(earlier, resource)
+                    || (isRead(earlier, resource) && !readsResult))
+                {
+                    pass.orderDependencies |= getPassBit(j);
+                }
+            }
+        }
+    }
+}
+
+void FrameGraph::cullPasses()
+{
+    std::uint32_t liveMask = 0;
+    for (size_t i = 0; i < passes_.size(); ++i)
+    {
+        const PassNode& pass = passes_[i];
+        const auto writes = std::span{accesses_}.subspan(
+            pass.accessBegin + pass.readCount,
+            pass.writeCount);
+        if (std::ranges::any_of(writes,
+                                [this](std::uint32_t resource)
+                                { return resources_[resource].output; }))
+        {
+            liveMask |= getPassBit(i);
+        }
+    }
+    // Passes whose results are read by live passes are live as well
+    std::uint32_t previousMask = 0;
+    while (liveMask != previousMask)
+    {
+        previousMask = liveMask;
+        for (size_t i = 0; i < passes_.size(); ++i)
+        {
+            if ((liveMask & getPassBit(i)) != 0)
+            {
+                liveMask |= passes_[i].dataDependencies;
+            }
+        }
+    }
+    for (size_t i = 0; i < passes_.size(); ++i)
+    {
+        passes_[i].live = (liveMask & getPassBit(i)) != 0;
+    }
+}
+
+bool FrameGraph::sortPasses()
+{
+    // Culled passes are left out of the order, and ordering against them is
+    // dropped along with them
+    std::uint32_t remainingMask = 0;
+    for (size_t i = 0; i < passes_.size(); ++i)
+    {
+        if (passes_[i].live)
+        {
+            remainingMask |= getPassBit(i);
+        }
+    }
+    while (remainingMask != 0)
+    {
+        bool found = false;
+        for (size_t i = 0; i < passes_.size(); ++i)
+        {
+            if ((remainingMask & getPassBit(i)) != 0
+                && (passes_[i].orderDependencies & remainingMask) == 0)
+            {
+                order_.push_back(static_cast<std::uint32_t>(i));
+                remainingMask &= ~getPassBit(i);
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            order_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FrameGraph::allocateTransients(GlStateCache& glState)
+{
+    for (std::uint32_t position = 0; position < order_.size(); ++position)
+    {
+        const PassNode& pass = passes_[order_[position]];
+        const auto accesses = std::span{accesses_}.subspan(
+            pass.accessBegin,
+            pass.readCount + pass.writeCount);
+        for (const std::uint32_t resource : accesses)
+        {
+            ResourceNode& node = resources_[resource];
+            node.firstUse = std::min(node.firstUse, position);
+            node.lastUse = node.lastUse == NO_USE
+                             ? position
+                             : std::max(node.lastUse, position);
+        }
+    }
+
+    // Transients starting at a pass are handed textures before those ending
+    // at it give theirs back, as the pass accesses both
+    bool complete = true;
+    for (std::uint32_t position = 0; position < order_.size(); ++position)
+    {
+        for (ResourceNode& node : resources_)
+        {
+            if (!node.imported && node.firstUse == position)
+            {
+                node.poolTexture = acquire(node.desc, glState);
+                complete = node.poolTexture != NO_POOL_TEXTURE && complete;
+                requestedSize_ += getTextureSize(node.desc.internalFormat,
+                                                 node.desc.size);
+            }
+        }
+        for (const ResourceNode& node : resources_)
+        {
+            if (node.poolTexture != NO_POOL_TEXTURE
+                && node.lastUse == position)
+            {
+                pool_[node.poolTexture].inUse = false;
+            }
+        }
+    }
+    // Released textures are only marked free, handles stay with resources
+    // for the passes to look up
+    for (const ResourceNode& node : resources_)
+    {
+        if (node.poolTexture != NO_POOL_TEXTURE)
+        {
+            pool_[node.poolTexture].inUse = true;
+        }
+    }
+    if (!complete)
+    {
+        utils::logWarning("incomplete frame graph framebuffer");
+    }
+    return complete;
+}
+
+std::uint32_t FrameGraph::acquire(const TextureDesc& desc,
+                                  GlStateCache& glState)
+{
+    // Smallest free texture fitting, so that large ones stay available
+    std::uint32_t found = NO_POOL_TEXTURE;
+    for (std::uint32_t i = 0; i < pool_.size(); ++i)
+    {
+        const PoolTexture& poolTexture = pool_[i];
+        if (poolTexture.inUse
+            || poolTexture.internalFormat != desc.internalFormat
+            || poolTexture.size.x < desc.size.x
+            || poolTexture.size.y < desc.size.y)
+        {
+            continue;
+        }
+        if (found == NO_POOL_TEXTURE
+            || poolTexture.size.x * poolTexture.size.y
+                   < pool_[found].size.x * pool_[found].size.y)
+        {
+            found = i;
+        }
+    }
+    if (found != NO_POOL_TEXTURE)
+    {
+        PoolTexture& poolTexture = pool_[found];
+        poolTexture.inUse = true;
+        poolTexture.lastUsedFrame = frameIndex_;
+        if (poolTexture.filter != desc.filter)
+        {
+            poolTexture.filter = desc.filter;
+            glState.bindTexture(SETUP_TEXTURE_UNIT,
+                                GL_TEXTURE_2D,
+                                poolTexture.texture);
+            glTexParameteri(GL_TEXTURE_2D,
+                            GL_TEXTURE_MIN_FILTER,
+                            static_cast<GLint>(desc.filter));
+            glTexParameteri(GL_TEXTURE_2D,
+                            GL_TEXTURE_MAG_FILTER,
+                            static_cast<GLint>(desc.filter));
+        }
+        return found;
+    }
+
+    const FormatInfo* format = findFormat(desc.internalFormat);
+    if (!format)
+    {
+        utils::logWarning("unsupported frame graph texture format ",
+                          desc.internalFormat);
+        return NO_POOL_TEXTURE;
+    }
+    PoolTexture poolTexture{
+        .texture = 0,
+        .framebuffer = 0,
+        .internalFormat = desc.internalFormat,
+        .filter = desc.filter,
+        .size = desc.size,
+        .inUse = true,
+        .lastUsedFrame = frameIndex_,
+    };
+    glGenTextures(1, &poolTexture.texture);
+    glState.bindTexture(SETUP_TEXTURE_UNIT,
+                        GL_TEXTURE_2D,
+                        poolTexture.texture);
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 static_cast<GLint>(format->internalFormat),
+                 desc.size.x,
+                 desc.size.y,
+                 0,
+                 format->format,
+                 format->type,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D,
+                    GL_TEXTURE_MIN_FILTER,
+                    static_cast<GLint>(desc.filter));
+    glTexParameteri(GL_TEXTURE_2D,
+                    GL_TEXTURE_MAG_FILTER,
+                    static_cast<GLint>(desc.filter));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Passes may rely on framebuffers bound by earlier work, like scene
+    // depth bound for reading, so bindings are restored. Textures are only
+    // created while the pool grows.
+    GLint drawFramebuffer = 0;
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glGenFramebuffers(1, &poolTexture.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, poolTexture.framebuffer);
+    if (desc.internalFormat == GL_DEPTH_COMPONENT24)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_2D,
+                               poolTexture.texture,
+                               0);
+        const GLenum noDrawBuffer = GL_NONE;
+        glDrawBuffers(1, &noDrawBuffer);
+        glReadBuffer(GL_NONE);
+    }
+    else
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D,
+                               poolTexture.texture,
+                               0);
+    }
+    const bool complete
+        = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER,
+                      static_cast<GLuint>(drawFramebuffer));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER,
+                      static_cast<GLuint>(readFramebuffer));
+
+    if (!complete)
+    {
+        glDeleteFramebuffers(1, &poolTexture.framebuffer);
+        glDeleteTextures(1, &poolTexture.texture);
+        return NO_POOL_TEXTURE;
+    }
+    const size_t size = getTextureSize(desc.internalFormat, desc.size);
+    videomemory::allocate(videomemory::Category::RenderTarget, size);
+    poolSize_ += size;
+    pool_.push_back(poolTexture);
+    return static_cast<std::uint32_t>(pool_.size() - 1);
+}
+
+void FrameGraph::deletePoolTexture(PoolTexture& poolTexture)
+{
+    const size_t size
+        = getTextureSize(poolTexture.internalFormat, poolTexture.size);
+    videomemory::release(videomemory::Category::RenderTarget, size);
+    poolSize_ -= size;
+    ++poolGeneration_;
+    glDeleteFramebuffers(1, &poolTexture.framebuffer);
+    glDeleteTextures(1, &poolTexture.texture);
+}
@@ -0,0 +1,236 @@
+#ifndef FRAME_GRAPH_H_
+#define FRAME_GRAPH_H_
+
+#include "glstatecache.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/vec2.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <span>
+#include <utility>
+#include <vector>
+
+/// Passes of a frame declared with the textures they read and write, run in
+/// dependency order with textures that only live within the frame taken
+/// from a shared pool.
+///
+/// A graph is declared anew for each part of the frame, then compiled and
+/// executed at once. Passes whose results do not reach a texture marked as
+/// output are culled without running. Reads depend on the last pass
+/// declared before them writing the texture, or on the last writer when
+/// none was declared before, so that passes may be declared out of order.
+/// Writes come after earlier writers and readers of the same texture.
+///
+/// Transient textures are described by size and format instead of being
+/// created by their users. Each one is handed a pooled texture of the same
+/// format at least as large from the first pass using it to the last one,
+/// and the texture returns to the pool for later transients of the frame,
+/// including those of graphs declared after it. Textures drawn into at
+/// their bottom-left corner like the scene take larger storage without
+/// harm. Textures left unused for a while are deleted, and the pool is
+/// emptied on resize, as larger textures of the previous size would keep
+/// being handed out.
+///
+/// OpenGL has no placement of textures in shared memory, so that aliasing
+/// is reuse of whole textures, limited to transients of the same format.
+///
+/// Compiling keeps its storage between graphs, allocating nothing once the
+/// graphs of a frame have been declared before. Execute callbacks capturing
+/// no more than a couple of pointers fit into std::function without
+/// allocating either. Non-copyable, non-movable.
+class FrameGraph
+{
+public:
+    /// Handle of a texture declared in the current graph.
+    struct Resource
+    {
+        std::uint32_t index;
+    };
+
+    /// Transient texture requested by passes.
+    struct TextureDesc
+    {
+        glm::ivec2 size;
+        /// GL_DEPTH_COMPONENT24 for depth, color formats otherwise.
+        GLenum internalFormat;
+        /// Minification and magnification filter while sampled.
+        GLenum filter;
+    };
+
+    /// Texture handed to a resource, with a framebuffer drawing into it.
+    /// Framebuffers of depth textures have no color buffers.
+    struct Target
+    {
+        GLuint texture;
+        GLuint framebuffer;
+        glm::ivec2 textureSize;
+    };
+
+    using Execute = std::function<void(const FrameGraph&)>;
+
+    /// Passes a single graph can hold.
+    static constexpr size_t MAX_PASS_COUNT = 32;
+
+    FrameGraph();
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+    FrameGraph(FrameGraph&&) = delete;
+    FrameGraph& operator=(FrameGraph&&) = delete;
+    ~FrameGraph();
+
+    /// Start counting statistics of a new frame, and delete pooled textures
+    /// left unused for several frames. Names of deleted textures may be
+    /// reused, so bindings of the state cache have to be invalidated
+    /// afterwards.
+    void beginFrame();
+    /// Delete every pooled texture, invalidating bindings like beginFrame().
+    void releasePool();
+
+    /// Drop passes and resources, starting declaration of the next graph.
+    void reset();
+
+    Resource createTexture(const char* name, const TextureDesc& desc);
+    /// Texture owned outside the graph, such as history kept between frames
+    /// or the default framebuffer, which is named by texture zero.
+    Resource importTexture(const char* name,
+                           GLuint texture,
+                           glm::ivec2 textureSize);
+    /// Pass accessing given resources, executed by given callback. Passes
+    /// over MAX_PASS_COUNT are dropped with a warning.
+    void addPass(const char* name,
+                 std::span<const Resource> reads,
+                 std::span<const Resource> writes,
+                 Execute execute);
+    void addPass(const char* name,
+                 std::initializer_list<Resource> reads,
+                 std::initializer_list<Resource> writes,
+                 Execute execute)
+    {
+        addPass(name,
+                std::span{reads.begin(), reads.size()},
+                std::span{writes.begin(), writes.size()},
+                std::move(execute));
+    }
+    /// Keep passes writing the resource and everything they depend on.
+    void markOutput(Resource resource);
+
+    /// Order and cull passes, hand out transient textures and run the
+    /// passes. Returns false without running any pass when dependencies
+    /// form a cycle, or when the driver rejects a framebuffer. Textures are
+    /// bound through the cache when created or filtered differently.
+    bool execute(GlStateCache& glState);
+
+    /// Texture handed to the resource, only valid while passes execute.
+    /// Framebuffer of imported resources is zero, as they are drawn through
+    /// framebuffers of their owners.
+    [[nodiscard]] Target target(Resource resource) const;
+
+    /// Passes run and culled by graphs of the current frame.
+    [[nodiscard]] std::uint32_t executedPassCount() const
+    {
+        return executedPassCount_;
+    }
+    [[nodiscard]] std::uint32_t culledPassCount() const
+    {
+        return culledPassCount_;
+    }
+    /// Bytes transients of the current frame would take as textures of
+    /// their own, and bytes taken by the pool instead.
+    [[nodiscard]] size_t requestedSize() const { return requestedSize_; }
+    [[nodiscard]] size_t poolSize() const { return poolSize_; }
+    /// Changes whenever pooled textures are deleted, after which names of
+    /// textures handed out before may be given to new ones.
+    [[nodiscard]] std::uint32_t poolGeneration() const
+    {
+        return poolGeneration_;
+    }
+
+private:
+    static constexpr std::uint32_t NO_POOL_TEXTURE = UINT32_MAX;
+
+    struct ResourceNode
+    {
+        const char* name;
+        TextureDesc desc;
+        /// Texture of imported resources.
+        GLuint importedTexture;
+        bool imported;
+        bool output;
+        /// Pooled texture handed out while passes execute.
+        std::uint32_t poolTexture;
+        /// First and last position in execution order of passes accessing
+        /// a transient.
+        std::uint32_t firstUse;
+        std::uint32_t lastUse;
+    };
+
+    struct PassNode
+    {
+        const char* name;
+        Execute execute;
+        /// Range of accessed resources in accesses_, reads first.
+        std::uint32_t accessBegin;
+        std::uint32_t readCount;
+        std::uint32_t writeCount;
+        /// Bits of passes this one reads results of, and of passes it has
+        /// to run after for any reason.
+        std::uint32_t dataDependencies;
+        std::uint32_t orderDependencies;
+        bool live;
+    };
+
+    struct PoolTexture
+    {
+        GLuint texture;
+        GLuint framebuffer;
+        GLenum internalFormat;
+        GLenum filter;
+        glm::ivec2 size;
+        bool inUse;
+        std::uint32_t lastUsedFrame;
+    };
+
+    [[nodiscard]] bool isRead(const PassNode& pass,
+                              std::uint32_t resource) const;
+    [[nodiscard]] bool isWritten(const PassNode& pass,
+                                 std::uint32_t resource) const;
+
+    /// Collect dependencies of every pass from their accesses.
+    void findDependencies();
+    /// Order passes topologically, earlier declared first among those ready.
+    /// Returns false on a cycle.
+    bool sortPasses();
+    /// Mark passes reaching outputs as live.
+    void cullPasses();
+    /// Hand out pooled textures to transients over their lifetimes.
+    bool allocateTransients(GlStateCache& glState);
+    /// Index of free pooled texture fitting the description, created when
+    /// none does. NO_POOL_TEXTURE when the format is not supported or the
+    /// driver rejects its framebuffer.
+    std::uint32_t acquire(const TextureDesc& desc, GlStateCache& glState);
+    void deletePoolTexture(PoolTexture& poolTexture);
+
+    std::vector<ResourceNode> resources_;
+    std::vector<PassNode> passes_;
+    std::vector<std::uint32_t> accesses_;
+    /// Indices of passes in execution order.
+    std::vector<std::uint32_t> order_;
+    std::vector<PoolTexture> pool_;
+    std::uint32_t frameIndex_;
+    std::uint32_t executedPassCount_;
+    std::uint32_t culledPassCount_;
+    size_t requestedSize_;
+    size_t poolSize_;
+    std::uint32_t poolGeneration_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "framepacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <thread>
+
+namespace
+{
+/// Sleep lateness assumed before any sleep is measured.
+constexpr std::chrono::milliseconds INITIAL_SLEEP_LATENESS{1};
+}  // namespace
+
+FramePacer::FramePacer()
+    : nextDeadline_{}
+    , sleepLateness_{INITIAL_SLEEP_LATENESS}
+    , frameTimes_{}
+    , sortedFrameTimes_{}
+    , frameTimeCount_{0}
+    , nextFrameTime_{0}
+    , statistics_{.averageFrameTime = 0.0F,
+                  .frameTimeJitter = 0.0F,
+                  .minFrameTime = 0.0F,
+                  .maxFrameTime = 0.0F,
+                  .p99FrameTime = 0.0F}
+{
+}
+
+void FramePacer::waitForNextFrame(int framesPerSecond)
+{
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / framesPerSecond));
+    const Clock::time_point now = Clock::now();
+    // Missed deadlines are not caught up with, which would present a burst of
+    // frames
+    nextDeadline_ = std::max(nextDeadline_ + interval, now);
+
+    const Clock::time_point sleepEnd = nextDeadline_ - sleepLateness_;
+    if (now < sleepEnd)
+    {
+        std::this_thread::sleep_until(sleepEnd);
+        // Lateness decays slowly, so that occasional spikes are forgotten
+        sleepLateness_ = std::max(Clock::now() - sleepEnd,
+                                  sleepLateness_ - sleepLateness_ / 16);
+    }
+    while (Clock::now() < nextDeadline_)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::recordFrame()
+{
+    const Clock::time_point now = Clock::now();
+    if (previousFrameTime_)
+    {
+        frameTimes_[nextFrameTime_]
+            = std::chrono::duration<float, std::milli>(
+                  now - previousFrameTime_.value())
+                  .count();
+        nextFrameTime_ = (nextFrameTime_ + 1) % FRAME_TIME_COUNT;
+        frameTimeCount_ = std::min(frameTimeCount_ + 1, FRAME_TIME_COUNT);
+
+        const auto recentFrameTimes
+            = std::span{frameTimes_}.first(frameTimeCount_);
+        float sum = 0.0F;
+        float minFrameTime = recentFrameTimes.front();
+        float maxFrameTime = 0.0F;
+        for (const float frameTime : recentFrameTimes)
+        {
+            sum += frameTime;
+            minFrameTime = std::min(minFrameTime, frameTime);
+            maxFrameTime = std::max(maxFrameTime, frameTime);
+        }
+        const float average = sum / static_cast<float>(frameTimeCount_);
+        float squaredDeviationSum = 0.0F;
+        for (const float frameTime : recentFrameTimes)
+        {
+            const float deviation = frameTime - average;
+            squaredDeviationSum += deviation * deviation;
+        }
+        // Partial ordering is enough to find the percentile in linear time
+        const auto sortedFrameTimes
+            = std::span{sortedFrameTimes_}.first(frameTimeCount_);
+        std::ranges::copy(recentFrameTimes, sortedFrameTimes.begin());
+        const size_t p99Index = (frameTimeCount_ * 99 + 99) / 100 - 1;
+        std::nth_element(
+            sortedFrameTimes.begin(),
+            sortedFrameTimes.begin() + static_cast<std::ptrdiff_t>(p99Index),
+            sortedFrameTimes.end());
+        statistics_ = {
+            .averageFrameTime = average,
+            .frameTimeJitter = std::sqrt(squaredDeviationSum
+                                         / static_cast<float>(frameTimeCount_)),
+            .minFrameTime = minFrameTime,
+            .maxFrameTime = maxFrameTime,
+            .p99FrameTime = sortedFrameTimes[p99Index],
+        };
+    }
+    previousFrameTime_ = now;
+}
+
+void FramePacer::restart()
+{
+    nextDeadline_ = {};
+    previousFrameTime_.reset();
+}
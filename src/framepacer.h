@@ -0,0 +1,80 @@
+#ifndef FRAME_PACER_H_
+#define FRAME_PACER_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+/// Framerate limiting and frame time statistics.
+///
+/// Frames are capped by sleeping until shortly before the deadline of the
+/// next frame, then spinning for the rest. Sleeps of the OS may wake up over a
+/// millisecond late, so sleeping ends early by the largest lateness observed
+/// recently. Deadlines advance by whole frame intervals from the previous one
+/// instead of the time waiting ended, so that frames do not drift.
+class FramePacer
+{
+public:
+    /// Statistics of recent frame times in milliseconds.
+    struct Statistics
+    {
+        float averageFrameTime;
+        /// Standard deviation of frame times.
+        float frameTimeJitter;
+        float minFrameTime;
+        float maxFrameTime;
+        /// Frame time not exceeded by 99% of frames, unlike single spikes.
+        float p99FrameTime;
+    };
+
+    FramePacer();
+
+    /// Wait until the deadline of the next frame at given framerate.
+    void waitForNextFrame(int framesPerSecond);
+    /// Record that a frame was presented.
+    void recordFrame();
+    /// Forget timing of the previous frame, so that a pause (e.g. idling) is
+    /// not counted as a frame.
+    void restart();
+
+    [[nodiscard]] const Statistics& statistics() const { return statistics_; }
+
+    /// Ring of recent frame times in milliseconds, starting at
+    /// oldestFrameTimeIndex() once full.
+    [[nodiscard]] std::span<const float> frameTimes() const
+    {
+        return std::span{frameTimes_}.first(frameTimeCount_);
+    }
+    [[nodiscard]] size_t oldestFrameTimeIndex() const
+    {
+        return frameTimeCount_ == FRAME_TIME_COUNT ? nextFrameTime_ : 0;
+    }
+    /// Time of the latest frame in milliseconds, zero before any.
+    [[nodiscard]] float latestFrameTime() const
+    {
+        return frameTimeCount_ > 0
+                 ? frameTimes_[(nextFrameTime_ + FRAME_TIME_COUNT - 1)
+                               % FRAME_TIME_COUNT]
+                 : 0.0F;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t FRAME_TIME_COUNT = 120;
+
+    Clock::time_point nextDeadline_;
+    Clock::duration sleepLateness_;
+    std::optional<Clock::time_point> previousFrameTime_;
+    /// Ring of recent frame times in milliseconds.
+    std::array<float, FRAME_TIME_COUNT> frameTimes_;
+    /// Scratch storage for finding percentiles without sorting the ring.
+    std::array<float, FRAME_TIME_COUNT> sortedFrameTimes_;
+    size_t frameTimeCount_;
+    size_t nextFrameTime_;
+    Statistics statistics_;
+};
+
+#endif
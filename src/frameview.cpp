@@ -0,0 +1,18 @@
+#include "frameview.h"
+
+#include "glm/matrix.hpp"
+
+FrameView FrameView::create(const Camera& camera, const glm::mat4& projection)
+{
+    const glm::mat4 view = camera.calculateViewMatrix();
+    const glm::mat4 viewProjection = projection * view;
+    return FrameView{
+        .cameraPosition = camera.position(),
+        .cameraRotation = camera.rotation(),
+        .view = view,
+        .projection = projection,
+        .viewProjection = viewProjection,
+        .inverseViewProjection = glm::inverse(viewProjection),
+        .frustum = Frustum::fromMatrix(viewProjection),
+    };
+}
@@ -0,0 +1,44 @@
+#ifndef FRAME_VIEW_H_
+#define FRAME_VIEW_H_
+
+#include "camera.h"
+#include "frustum.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+/// Camera view of a frame and everything derived from it, computed once and
+/// shared by every pass and by culling.
+///
+/// Camera is rebuilt from the interpolated simulation state every frame, so
+/// changes are detected by comparing the pose and projection it was built
+/// from, not by the identity of the camera. The view is only rebuilt when
+/// they differ, which in on-demand rendering and while standing still is
+/// rarely.
+struct FrameView
+{
+    /// Build view of camera through projection.
+    static FrameView create(const Camera& camera, const glm::mat4& projection);
+
+    /// Whether view was built from the same camera pose and projection.
+    [[nodiscard]] bool isBuiltFrom(const Camera& camera,
+                                   const glm::mat4& projection) const
+    {
+        return camera.position() == cameraPosition
+            && camera.rotation() == cameraRotation
+            && projection == this->projection;
+    }
+
+    glm::vec3 cameraPosition;
+    glm::vec2 cameraRotation;
+    glm::mat4 view;
+    glm::mat4 projection;
+    /// Without subpixel jitter of temporal upscaling.
+    glm::mat4 viewProjection;
+    glm::mat4 inverseViewProjection;
+    /// World space view frustum.
+    Frustum frustum;
+};
+
+#endif
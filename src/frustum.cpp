@@ -0,0 +1,97 @@
+#include "frustum.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+{
+    // A point is inside when -w <= x, y, z <= w in clip space, so each plane
+    // is the sum or difference of the last row and another row of the matrix
+    const glm::mat4 rows = glm::transpose(viewProjection);
+    Frustum frustum;
+    frustum.planes_ = {
+        rows[3] + rows[0],  // Left
+        rows[3] - rows[0],  // Right
+        rows[3] + rows[1],  // Bottom
+        rows[3] - rows[1],  // Top
+        rows[3] + rows[2],  // Near
+        rows[3] - rows[2],  // Far
+    };
+    for (glm::vec4& plane : frustum.planes_)
+    {
+        plane /= glm::length(glm::vec3{plane});
+    }
+    return frustum;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const
+{
+    return std::ranges::all_of(
+        planes_,
+        [&sphere](const glm::vec4& plane)
+        {
+            return glm::dot(glm::vec3{plane}, sphere.center) + plane.w
+                >= -sphere.radius;
+        });
+}
+
+Frustum::Overlap Frustum::classify(const Bounds& box) const
+{
+    // Corners of the box farthest along and against the plane normal decide
+    // whether the box is entirely behind or entirely in front of the plane
+    Overlap overlap = Overlap::Inside;
+    for (const glm::vec4& plane : planes_)
+    {
+        const glm::vec3 normal{plane};
+        glm::vec3 positiveCorner;
+        glm::vec3 negativeCorner;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const bool positive = normal[axis] > 0.0F;
+            positiveCorner[axis]
+                = positive ? box.maximum[axis] : box.minimum[axis];
+            negativeCorner[axis]
+                = positive ? box.minimum[axis] : box.maximum[axis];
+        }
+        if (glm::dot(normal, positiveCorner) + plane.w < 0.0F)
+        {
+            return Overlap::Outside;
+        }
+        if (glm::dot(normal, negativeCorner) + plane.w < 0.0F)
+        {
+            overlap = Overlap::Partial;
+        }
+    }
+    return overlap;
+}
+
+BoundingSphere transformSphere(const BoundingSphere& sphere,
+                               const glm::mat4& worldMatrix)
+{
+    const float scale = std::max({glm::length(glm::vec3{worldMatrix[0]}),
+                                  glm::length(glm::vec3{worldMatrix[1]}),
+                                  glm::length(glm::vec3{worldMatrix[2]})});
+    return {
+        .center = glm::vec3{worldMatrix * glm::vec4{sphere.center, 1.0F}},
+        .radius = sphere.radius * scale,
+    };
+}
+
+Bounds transformBounds(const Bounds& bounds, const glm::mat4& worldMatrix)
+{
+    // Each axis of the matrix stretches the box along the world axes by the
+    // absolute value of its components
+    const glm::vec3 center = (bounds.minimum + bounds.maximum) * 0.5F;
+    const glm::vec3 extent = (bounds.maximum - bounds.minimum) * 0.5F;
+    const glm::vec3 worldCenter{worldMatrix * glm::vec4{center, 1.0F}};
+    const glm::vec3 worldExtent
+        = glm::abs(glm::vec3{worldMatrix[0]}) * extent.x
+        + glm::abs(glm::vec3{worldMatrix[1]}) * extent.y
+        + glm::abs(glm::vec3{worldMatrix[2]}) * extent.z;
+    return {
+        .minimum = worldCenter - worldExtent,
+        .maximum = worldCenter + worldExtent,
+    };
+}
@@ -0,0 +1,50 @@
+#ifndef FRUSTUM_H_
+#define FRUSTUM_H_
+
+#include "mesh.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+
+#include <array>
+
+/// View frustum as six planes facing inward, for skipping draws of objects
+/// that are entirely off-screen.
+class Frustum
+{
+public:
+    /// Placement of a box relative to the frustum.
+    enum class Overlap
+    {
+        Outside,
+        Partial,
+        Inside,
+    };
+
+    /// Extract planes from combined projection and view matrix (Gribb and
+    /// Hartmann). Planes are in world space, or in the space of whatever the
+    /// matrix transforms from.
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+    /// Conservative test, which may accept spheres near frustum corners that
+    /// are outside of it.
+    [[nodiscard]] bool intersects(const BoundingSphere& sphere) const;
+    /// Conservative like the sphere test, reporting boxes near frustum
+    /// corners that are outside of it as partially inside.
+    [[nodiscard]] Overlap classify(const Bounds& box) const;
+
+private:
+    /// Normal in xyz and distance from origin in w, normalized.
+    std::array<glm::vec4, 6> planes_;
+};
+
+/// Bounding sphere transformed by world matrix. Radius is scaled by the
+/// largest axis scale, so that the result still encloses the object under
+/// non-uniform scale.
+BoundingSphere transformSphere(const BoundingSphere& sphere,
+                               const glm::mat4& worldMatrix);
+
+/// Axis-aligned box enclosing box transformed by world matrix (Arvo).
+Bounds transformBounds(const Bounds& bounds, const glm::mat4& worldMatrix);
+
+#endif
@@ -0,0 +1,419 @@
+#include "geometryarena.h"
+
+#include "meshcodec.h"
+#include "meshprocessing.h"
+#include "profiler.h"
+#include "vertexformat.h"
+#include "videomemory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <span>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Initial capacities are enough for the bundled models, avoiding growth in
+/// the common case.
+constexpr size_t INITIAL_VERTEX_CAPACITY = 64 * 1024;
+constexpr size_t INITIAL_INDEX_CAPACITY = 256 * 1024;
+#ifndef __EMSCRIPTEN__
+/// Shader storage buffer bindings of the decoder shader.
+constexpr GLuint ENCODED_BINDING = 0;
+constexpr GLuint DECODED_BINDING = 1;
+/// Work groups a single dispatch is guaranteed to support in one dimension.
+constexpr size_t MAX_GROUP_COUNT = 65535;
+#endif
+
+/// Gather full detail geometry of mesh in the vertex format of the arena.
+/// Unpacked vertices are packed into given storage relative to their own
+/// bounding box, which is returned. Only full detail ranges are gathered,
+/// levels of detail are not drawn from the arena. Indices are widened, and
+/// stay relative to base vertex of sub-meshes, whose ranges are relative to
+/// the gathered geometry.
+Bounds gatherGeometry(const MeshData& meshData,
+                      std::vector<PackedVertex>& packedVertices,
+                      std::span<const PackedVertex>& vertices,
+                      std::vector<GLuint>& indices,
+                      std::vector<Submesh>& submeshes)
+{
+    Bounds bounds = meshData.bounds();
+    vertices = meshData.packedVertices();
+    if (meshData.vertexFormat() == VertexFormat::Float)
+    {
+        bounds = meshprocessing::computeBounds(meshData.vertices());
+        packedVertices
+            = meshprocessing::packVertices(meshData.vertices(), bounds);
+        vertices = packedVertices;
+    }
+
+    submeshes.reserve(meshData.submeshes().size());
+    for (const Submesh& submesh : meshData.submeshes())
+    {
+        submeshes.push_back({
+            .firstIndex = static_cast<GLuint>(indices.size()),
+            .indexCount = submesh.indexCount,
+            .baseVertex = submesh.baseVertex,
+            .firstMeshlet = 0,
+            .meshletCount = 0,
+            .firstLod = 0,
+            .lodCount = 0,
+            .baseColor = submesh.baseColor,
+            .opacity = submesh.opacity,
+            .textureLayer = submesh.textureLayer,
+        });
+        if (meshData.indexType() == GL_UNSIGNED_SHORT)
+        {
+            const std::span<const GLushort> submeshIndices
+                = meshData.shortIndices().subspan(submesh.firstIndex,
+                                                  submesh.indexCount);
+            indices.insert(indices.end(),
+                           submeshIndices.begin(),
+                           submeshIndices.end());
+        }
+        else
+        {
+            const std::span<const GLuint> submeshIndices
+                = meshData.indices().subspan(submesh.firstIndex,
+                                             submesh.indexCount);
+            indices.insert(indices.end(),
+                           submeshIndices.begin(),
+                           submeshIndices.end());
+        }
+    }
+    return bounds;
+}
+
+/// Replace buffer with a larger one and copy its contents over. Free ranges
+/// may lie anywhere, so the whole buffer is copied.
+GLuint growBuffer(GLuint buffer, size_t previousCapacity, size_t capacity)
+{
+    GLuint grownBuffer = 0;
+    glGenBuffers(1, &grownBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grownBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 static_cast<GLsizeiptr>(capacity),
+                 nullptr,
+                 GL_STATIC_DRAW);
+    if (previousCapacity > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                            GL_COPY_WRITE_BUFFER,
+                            0,
+                            0,
+                            static_cast<GLsizeiptr>(previousCapacity));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    videomemory::release(videomemory::Category::Geometry, previousCapacity);
+    videomemory::allocate(videomemory::Category::Geometry, capacity);
+    return grownBuffer;
+}
+}  // namespace
+
+GeometryArena::GeometryArena()
+    : vertexArray_{0}
+    , vertexBuffer_{0}
+    , indexBuffer_{0}
+#ifndef __EMSCRIPTEN__
+    , encodedBuffer_{0}
+#endif
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+    glDeleteVertexArrays(1, &vertexArray_);
+    glDeleteBuffers(1, &vertexBuffer_);
+    glDeleteBuffers(1, &indexBuffer_);
+#ifndef __EMSCRIPTEN__
+    glDeleteBuffers(1, &encodedBuffer_);
+#endif
+    videomemory::release(videomemory::Category::Geometry,
+                         vertexRanges_.capacity() * sizeof(PackedVertex)
+                             + indexRanges_.capacity() * sizeof(GLuint));
+}
+
+#ifndef __EMSCRIPTEN__
+PendingShader GeometryArena::submitShader()
+{
+    return Shader::submitComputeFromFile(
+        fs::path{"assets/shaders/mesh_decode_gl4.comp.glsl"});
+}
+
+bool GeometryArena::init(PendingShader&& decodeShader)
+{
+    decodeShader_ = decodeShader.finish();
+    if (!decodeShader_)
+    {
+        return false;
+    }
+    streamOffsetUniform_
+        = decodeShader_->getUniformHandle<int>("u_streamOffset");
+    elementCountUniform_
+        = decodeShader_->getUniformHandle<int>("u_elementCount");
+    firstBlockUniform_ = decodeShader_->getUniformHandle<int>("u_firstBlock");
+    decodedOffsetUniform_
+        = decodeShader_->getUniformHandle<int>("u_decodedOffset");
+    verticesUniform_ = decodeShader_->getUniformHandle<bool>("u_vertices");
+    glGenBuffers(1, &encodedBuffer_);
+    return true;
+}
+#endif
+
+EncodedArenaGeometry GeometryArena::encode(const MeshData& meshData)
+{
+    PROFILE_SCOPE("GeometryArena::encode");
+    std::vector<PackedVertex> packedVertices;
+    std::span<const PackedVertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<Submesh> submeshes;
+    const Bounds bounds = gatherGeometry(meshData,
+                                         packedVertices,
+                                         vertices,
+                                         indices,
+                                         submeshes);
+    return EncodedArenaGeometry{
+        .bounds = bounds,
+        .submeshes = std::move(submeshes),
+        .vertexCount = static_cast<std::uint32_t>(vertices.size()),
+        .indexCount = static_cast<std::uint32_t>(indices.size()),
+        .vertexStream = meshcodec::encodeVertices(vertices),
+        .indexStream = meshcodec::encodeIndices(indices),
+    };
+}
+
+ArenaMesh GeometryArena::add(const MeshData& meshData)
+{
+    std::vector<PackedVertex> packedVertices;
+    std::span<const PackedVertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<Submesh> submeshes;
+    const Bounds bounds = gatherGeometry(meshData,
+                                         packedVertices,
+                                         vertices,
+                                         indices,
+                                         submeshes);
+    ArenaMesh mesh = place(bounds,
+                           std::move(submeshes),
+                           vertices.size(),
+                           indices.size());
+    upload(mesh, vertices, indices);
+    return mesh;
+}
+
+ArenaMesh GeometryArena::add(const EncodedArenaGeometry& geometry)
+{
+    PROFILE_SCOPE("GeometryArena::addEncoded");
+    ArenaMesh mesh = place(geometry.bounds,
+                           geometry.submeshes,
+                           geometry.vertexCount,
+                           geometry.indexCount);
+#ifndef __EMSCRIPTEN__
+    if (decodeShader_)
+    {
+        decode(geometry, mesh);
+        return mesh;
+    }
+#endif
+    std::vector<PackedVertex> vertices(geometry.vertexCount);
+    std::vector<GLuint> indices(geometry.indexCount);
+    // Streams were encoded by this process, so they only fail to decode
+    // through a bug
+    [[maybe_unused]] const bool decoded
+        = meshcodec::decodeVertices(geometry.vertexStream, vertices)
+       && meshcodec::decodeIndices(geometry.indexStream, indices);
+    assert(decoded);
+    upload(mesh, vertices, indices);
+    return mesh;
+}
+
+#ifndef __EMSCRIPTEN__
+void GeometryArena::decode(const EncodedArenaGeometry& geometry,
+                           const ArenaMesh& mesh)
+{
+    // Streams are uploaded one after the other as they are
+    const std::span<const std::uint32_t> vertexStream{geometry.vertexStream};
+    const std::span<const std::uint32_t> indexStream{geometry.indexStream};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, encodedBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(vertexStream.size_bytes()
+                                         + indexStream.size_bytes()),
+                 nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    0,
+                    static_cast<GLsizeiptr>(vertexStream.size_bytes()),
+                    vertexStream.data());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(vertexStream.size_bytes()),
+                    static_cast<GLsizeiptr>(indexStream.size_bytes()),
+                    indexStream.data());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                     ENCODED_BINDING,
+                     encodedBuffer_);
+
+    // Program is bound outside of the state cache, like objects created by
+    // loading models, which the renderer expects between frames
+    glUseProgram(decodeShader_->program());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DECODED_BINDING, vertexBuffer_);
+    dispatchDecode(0,
+                   geometry.vertexCount,
+                   mesh.vertexRange.offset * sizeof(PackedVertex)
+                       / sizeof(std::uint32_t),
+                   true);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DECODED_BINDING, indexBuffer_);
+    dispatchDecode(vertexStream.size(),
+                   geometry.indexCount,
+                   mesh.indexRange.offset,
+                   false);
+    // Decoded geometry is drawn from, culled and copied when the buffers grow
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+                    | GL_ELEMENT_ARRAY_BARRIER_BIT
+                    | GL_SHADER_STORAGE_BARRIER_BIT
+                    | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glUseProgram(0);
+
+    // Storage stays alive until decoding finished, and is not held on to
+    // until the next upload
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+#endif
+
+ArenaMesh GeometryArena::place(const Bounds& bounds,
+                               std::vector<Submesh> submeshes,
+                               size_t vertexCount,
+                               size_t indexCount)
+{
+    ArenaMesh mesh{
+        .positionTransform
+        = VertexFormatDescriptor<PackedVertex>::positionTransform(bounds),
+        .submeshes = std::move(submeshes),
+        .vertexRange = {.offset = 0, .size = vertexCount},
+        .indexRange = {.offset = 0, .size = indexCount},
+    };
+    reserve(vertexCount, indexCount);
+    mesh.vertexRange.offset = vertexRanges_.allocate(vertexCount).value();
+    mesh.indexRange.offset = indexRanges_.allocate(indexCount).value();
+    for (Submesh& submesh : mesh.submeshes)
+    {
+        submesh.firstIndex += static_cast<GLuint>(mesh.indexRange.offset);
+        submesh.baseVertex += static_cast<GLint>(mesh.vertexRange.offset);
+    }
+    return mesh;
+}
+
+void GeometryArena::upload(const ArenaMesh& mesh,
+                           std::span<const PackedVertex> vertices,
+                           std::span<const GLuint> indices)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+    glBufferSubData(
+        GL_ARRAY_BUFFER,
+        static_cast<GLintptr>(mesh.vertexRange.offset * sizeof(PackedVertex)),
+        static_cast<GLsizeiptr>(vertices.size_bytes()),
+        vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Index buffer binding is part of vertex array state, so it is bound
+    // through a copy target instead
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer_);
+    glBufferSubData(
+        GL_COPY_WRITE_BUFFER,
+        static_cast<GLintptr>(mesh.indexRange.offset * sizeof(GLuint)),
+        static_cast<GLsizeiptr>(indices.size_bytes()),
+        indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+#ifndef __EMSCRIPTEN__
+void GeometryArena::dispatchDecode(size_t streamOffset,
+                                   size_t elementCount,
+                                   size_t decodedOffset,
+                                   bool vertices)
+{
+    decodeShader_->setUniform(streamOffsetUniform_,
+                              static_cast<int>(streamOffset));
+    decodeShader_->setUniform(elementCountUniform_,
+                              static_cast<int>(elementCount));
+    decodeShader_->setUniform(decodedOffsetUniform_,
+                              static_cast<int>(decodedOffset));
+    decodeShader_->setUniform(verticesUniform_, vertices);
+    const size_t blockCount
+        = meshcodec::blockCount(static_cast<std::uint32_t>(elementCount));
+    for (size_t firstBlock = 0; firstBlock < blockCount;
+         firstBlock += MAX_GROUP_COUNT)
+    {
+        decodeShader_->setUniform(firstBlockUniform_,
+                                  static_cast<int>(firstBlock));
+        glDispatchCompute(
+            static_cast<GLuint>(
+                std::min(blockCount - firstBlock, MAX_GROUP_COUNT)),
+            1,
+            1);
+    }
+}
+#endif
+
+void GeometryArena::remove(const ArenaMesh& mesh)
+{
+    // Contents are left in place, overwritten once the ranges are reused
+    vertexRanges_.release(mesh.vertexRange);
+    indexRanges_.release(mesh.indexRange);
+}
+
+void GeometryArena::reserve(size_t vertexCount, size_t indexCount)
+{
+    // Grown by at least the requested size, which always fits once merged
+    // with a free range at the end
+    const bool vertexBufferFull
+        = vertexRanges_.largestFreeSize() < vertexCount;
+    const bool indexBufferFull = indexRanges_.largestFreeSize() < indexCount;
+    if (vertexBufferFull)
+    {
+        const size_t previousCapacity = vertexRanges_.capacity();
+        vertexRanges_.grow(std::max({previousCapacity * 2,
+                                     previousCapacity + vertexCount,
+                                     INITIAL_VERTEX_CAPACITY}));
+        vertexBuffer_
+            = growBuffer(vertexBuffer_,
+                         previousCapacity * sizeof(PackedVertex),
+                         vertexRanges_.capacity() * sizeof(PackedVertex));
+    }
+    if (indexBufferFull)
+    {
+        const size_t previousCapacity = indexRanges_.capacity();
+        indexRanges_.grow(std::max({previousCapacity * 2,
+                                    previousCapacity + indexCount,
+                                    INITIAL_INDEX_CAPACITY}));
+        indexBuffer_ = growBuffer(indexBuffer_,
+                                  previousCapacity * sizeof(GLuint),
+                                  indexRanges_.capacity() * sizeof(GLuint));
+    }
+    // Vertex array keeps referring to replaced buffers until set up again
+    if (vertexBufferFull || indexBufferFull)
+    {
+        setupVertexArray();
+    }
+}
+
+void GeometryArena::setupVertexArray()
+{
+    if (vertexArray_ == 0)
+    {
+        glGenVertexArrays(1, &vertexArray_);
+    }
+    glBindVertexArray(vertexArray_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+
+    // Same layout as packed vertices of a model
+    vertexformat::setupAttributes<PackedVertex>();
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,159 @@
+#ifndef GEOMETRY_ARENA_H_
+#define GEOMETRY_ARENA_H_
+
+#include "mesh.h"
+#include "rangeallocator.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+#include "glm/mat4x4.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Placement of a mesh in the shared buffers of a geometry arena.
+struct ArenaMesh
+{
+    /// Transformation from arena vertex positions to model space, meant to be
+    /// folded into the model matrix the same way as Model::positionTransform.
+    glm::mat4 positionTransform;
+    /// Full detail sub-mesh ranges. First indices and base vertices are
+    /// absolute within the arena, level of detail ranges are left empty.
+    std::vector<Submesh> submeshes;
+    /// Ranges of arena buffers taken by the mesh, in vertices and indices.
+    AllocatedRange vertexRange;
+    AllocatedRange indexRange;
+};
+
+/// Full detail geometry of a mesh in the vertex format of the arena,
+/// compressed by meshcodec for upload. Prepared away from the thread the
+/// graphics context is current on, as packing and compressing large meshes
+/// takes a while.
+struct EncodedArenaGeometry
+{
+    /// Bounding box vertices are packed relative to.
+    Bounds bounds;
+    /// Full detail sub-mesh ranges relative to the geometry.
+    std::vector<Submesh> submeshes;
+    std::uint32_t vertexCount;
+    std::uint32_t indexCount;
+    std::vector<std::uint32_t> vertexStream;
+    std::vector<std::uint32_t> indexStream;
+};
+
+/// Layout of indirect draw command read by glMultiDrawElementsIndirect,
+/// drawing a range of the geometry arena.
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/// Single vertex and index buffer holding the geometry of all models, so that
+/// draws of different models can be submitted together without switching
+/// vertex arrays in between.
+///
+/// Vertices are stored as PackedVertex and indices as GLuint regardless of the
+/// format they were imported in, because a single vertex array and a single
+/// index type serves every mesh of the arena. Ranges of removed meshes are
+/// reused by meshes added later. Buffers grow geometrically when no free
+/// range fits, copying previous contents on the GPU.
+///
+/// Geometry encoded in advance is uploaded compressed and decoded by a
+/// compute shader straight into the arena buffers, so that a fraction of its
+/// size crosses the bus. Without the decoder shader, it is decoded on the
+/// CPU and uploaded whole instead.
+///
+/// Non-copyable, non-movable, meshes refer to the buffers by offset.
+class GeometryArena
+{
+public:
+    GeometryArena();
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+    GeometryArena(GeometryArena&&) = delete;
+    GeometryArena& operator=(GeometryArena&&) = delete;
+    ~GeometryArena();
+
+#ifndef __EMSCRIPTEN__
+    /// Submit decoder compute shader for compilation without waiting for the
+    /// driver to finish.
+    ///
+    /// Compute shaders are only supported from OpenGL 4.3+ and are not
+    /// available in OpenGL ES 3.0.
+    static PendingShader submitShader();
+    /// Finish compilation of submitted decoder shader. Returns false when it
+    /// fails, in which case encoded geometry is decoded on the CPU.
+    bool init(PendingShader&& decodeShader);
+#endif
+
+    /// Pack and compress full detail geometry of mesh for add(). May be
+    /// called on any thread.
+    static EncodedArenaGeometry encode(const MeshData& meshData);
+
+    /// Append full detail geometry of mesh to the arena. Must be called on the
+    /// thread the graphics context is current on.
+    ArenaMesh add(const MeshData& meshData);
+    ArenaMesh add(const EncodedArenaGeometry& geometry);
+    /// Free ranges taken by mesh for meshes added later.
+    void remove(const ArenaMesh& mesh);
+
+    /// Vertex array reading arena buffers. Zero until the first mesh is added.
+    [[nodiscard]] GLuint vertexArray() const { return vertexArray_; }
+
+private:
+    /// Make sure that free ranges of given sizes fit, replacing buffers with
+    /// larger ones when needed.
+    void reserve(size_t vertexCount, size_t indexCount);
+    void setupVertexArray();
+    /// Allocate ranges of given sizes, and place sub-mesh ranges relative to
+    /// the geometry into them.
+    ArenaMesh place(const Bounds& bounds,
+                    std::vector<Submesh> submeshes,
+                    size_t vertexCount,
+                    size_t indexCount);
+    void upload(const ArenaMesh& mesh,
+                std::span<const PackedVertex> vertices,
+                std::span<const GLuint> indices);
+#ifndef __EMSCRIPTEN__
+    /// Upload encoded streams of geometry and decode them into the ranges of
+    /// mesh with the decoder shader.
+    void decode(const EncodedArenaGeometry& geometry, const ArenaMesh& mesh);
+    /// Decode stream of encoded buffer into blocks of work groups, starting
+    /// at given word offsets of both buffers.
+    void dispatchDecode(size_t streamOffset,
+                        size_t elementCount,
+                        size_t decodedOffset,
+                        bool vertices);
+#endif
+
+    GLuint vertexArray_;
+    GLuint vertexBuffer_;
+    GLuint indexBuffer_;
+#ifndef __EMSCRIPTEN__
+    /// Encoded streams being decoded, orphaned once decoding is issued.
+    GLuint encodedBuffer_;
+    /// Empty until initialized.
+    std::optional<Shader> decodeShader_;
+    UniformHandle<int> streamOffsetUniform_;
+    UniformHandle<int> elementCountUniform_;
+    UniformHandle<int> firstBlockUniform_;
+    UniformHandle<int> decodedOffsetUniform_;
+    UniformHandle<bool> verticesUniform_;
+#endif
+    /// Ranges of buffers in vertices and indices.
+    RangeAllocator vertexRanges_;
+    RangeAllocator indexRanges_;
+};
+
+#endif
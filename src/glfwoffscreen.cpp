@@ -0,0 +1,770 @@
+// GLFW functions used by the application and the ImGui backend, implemented
+// on top of the HTML5 API of Emscripten for running the renderer in a worker.
+//
+// The GLFW port bundled with Emscripten drives the canvas element from the
+// browser main thread, which does not exist in workers. Here the canvas is
+// transferred to the worker as OffscreenCanvas, and DOM events are received
+// on the main thread by Emscripten and forwarded to the worker, which runs
+// them when polling for events. Only a single window is supported.
+#include <GLFW/glfw3.h>
+#include <emscripten.h>
+#include <emscripten/html5.h>
+#include <emscripten/threading.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+struct GLFWwindow
+{
+    EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context;
+    void* userPointer;
+    int width;
+    int height;
+    double cursorX;
+    double cursorY;
+    int cursorMode;
+    const char* cursorStyle;
+    std::array<int, GLFW_KEY_LAST + 1> keys;
+    std::array<int, GLFW_MOUSE_BUTTON_LAST + 1> mouseButtons;
+    std::string clipboard;
+    GLFWmousebuttonfun mouseButtonCallback;
+    GLFWcursorposfun cursorPosCallback;
+    GLFWcursorenterfun cursorEnterCallback;
+    GLFWscrollfun scrollCallback;
+    GLFWkeyfun keyCallback;
+    GLFWcharfun charCallback;
+    GLFWframebuffersizefun frameBufferSizeCallback;
+    GLFWwindowrefreshfun refreshCallback;
+    GLFWwindowfocusfun focusCallback;
+};
+
+struct GLFWcursor
+{
+    /// Value of the CSS cursor property.
+    const char* style;
+};
+
+namespace
+{
+/// Canvas transferred to the worker with -sOFFSCREENCANVASES_TO_PTHREAD.
+constexpr const char* CANVAS = "#canvas";
+
+GLFWerrorfun errorCallback = nullptr;
+int contextVersionMajor = 3;
+double startTime = 0.0;
+
+/// GLFW keys by the code of the physical key in keyboard events, which does
+/// not depend on the keyboard layout like GLFW keys.
+constexpr auto KEY_CODES = std::to_array<std::pair<std::string_view, int>>({
+    {"Space", GLFW_KEY_SPACE},
+    {"Quote", GLFW_KEY_APOSTROPHE},
+    {"Comma", GLFW_KEY_COMMA},
+    {"Minus", GLFW_KEY_MINUS},
+    {"Period", GLFW_KEY_PERIOD},
+    {"Slash", GLFW_KEY_SLASH},
+    {"Semicolon", GLFW_KEY_SEMICOLON},
+    {"Equal", GLFW_KEY_EQUAL},
+    {"BracketLeft", GLFW_KEY_LEFT_BRACKET},
+    {"Backslash", GLFW_KEY_BACKSLASH},
+    {"BracketRight", GLFW_KEY_RIGHT_BRACKET},
+    {"Backquote", GLFW_KEY_GRAVE_ACCENT},
+    {"Escape", GLFW_KEY_ESCAPE},
+    {"Enter", GLFW_KEY_ENTER},
+    {"Tab", GLFW_KEY_TAB},
+    {"Backspace", GLFW_KEY_BACKSPACE},
+    {"Insert", GLFW_KEY_INSERT},
+    {"Delete", GLFW_KEY_DELETE},
+    {"ArrowRight", GLFW_KEY_RIGHT},
+    {"ArrowLeft", GLFW_KEY_LEFT},
+    {"ArrowDown", GLFW_KEY_DOWN},
+    {"ArrowUp", GLFW_KEY_UP},
+    {"PageUp", GLFW_KEY_PAGE_UP},
+    {"PageDown", GLFW_KEY_PAGE_DOWN},
+    {"Home", GLFW_KEY_HOME},
+    {"End", GLFW_KEY_END},
+    {"CapsLock", GLFW_KEY_CAPS_LOCK},
+    {"ScrollLock", GLFW_KEY_SCROLL_LOCK},
+    {"NumLock", GLFW_KEY_NUM_LOCK},
+    {"PrintScreen", GLFW_KEY_PRINT_SCREEN},
+    {"Pause", GLFW_KEY_PAUSE},
+    {"F1", GLFW_KEY_F1},
+    {"F2", GLFW_KEY_F2},
+    {"F3", GLFW_KEY_F3},
+    {"F4", GLFW_KEY_F4},
+    {"F5", GLFW_KEY_F5},
+    {"F6", GLFW_KEY_F6},
+    {"F7", GLFW_KEY_F7},
+    {"F8", GLFW_KEY_F8},
+    {"F9", GLFW_KEY_F9},
+    {"F10", GLFW_KEY_F10},
+    {"F11", GLFW_KEY_F11},
+    {"F12", GLFW_KEY_F12},
+    {"Numpad0", GLFW_KEY_KP_0},
+    {"Numpad1", GLFW_KEY_KP_1},
+    {"Numpad2", GLFW_KEY_KP_2},
+    {"Numpad3", GLFW_KEY_KP_3},
+    {"Numpad4", GLFW_KEY_KP_4},
+    {"Numpad5", GLFW_KEY_KP_5},
+    {"Numpad6", GLFW_KEY_KP_6},
+    {"Numpad7", GLFW_KEY_KP_7},
+    {"Numpad8", GLFW_KEY_KP_8},
+    {"Numpad9", GLFW_KEY_KP_9},
+    {"NumpadDecimal", GLFW_KEY_KP_DECIMAL},
+    {"NumpadDivide", GLFW_KEY_KP_DIVIDE},
+    {"NumpadMultiply", GLFW_KEY_KP_MULTIPLY},
+    {"NumpadSubtract", GLFW_KEY_KP_SUBTRACT},
+    {"NumpadAdd", GLFW_KEY_KP_ADD},
+    {"NumpadEnter", GLFW_KEY_KP_ENTER},
+    {"NumpadEqual", GLFW_KEY_KP_EQUAL},
+    {"ShiftLeft", GLFW_KEY_LEFT_SHIFT},
+    {"ControlLeft", GLFW_KEY_LEFT_CONTROL},
+    {"AltLeft", GLFW_KEY_LEFT_ALT},
+    {"MetaLeft", GLFW_KEY_LEFT_SUPER},
+    {"ShiftRight", GLFW_KEY_RIGHT_SHIFT},
+    {"ControlRight", GLFW_KEY_RIGHT_CONTROL},
+    {"AltRight", GLFW_KEY_RIGHT_ALT},
+    {"MetaRight", GLFW_KEY_RIGHT_SUPER},
+    {"ContextMenu", GLFW_KEY_MENU},
+    {"IntlBackslash", GLFW_KEY_WORLD_1},
+    {"IntlRo", GLFW_KEY_WORLD_2},
+    {"IntlYen", GLFW_KEY_WORLD_2},
+});
+
+int translateKey(std::string_view code)
+{
+    // Letters and digits follow the same order as GLFW keys
+    if (code.size() == 4 && code.starts_with("Key") && code[3] >= 'A'
+        && code[3] <= 'Z')
+    {
+        return GLFW_KEY_A + (code[3] - 'A');
+    }
+    if (code.size() == 6 && code.starts_with("Digit") && code[5] >= '0'
+        && code[5] <= '9')
+    {
+        return GLFW_KEY_0 + (code[5] - '0');
+    }
+    const auto* const found = std::find_if(KEY_CODES.begin(),
+                                           KEY_CODES.end(),
+                                           [code](const auto& keyCode)
+                                           {
+                                               return keyCode.first == code;
+                                           });
+    return found != KEY_CODES.end() ? found->second : GLFW_KEY_UNKNOWN;
+}
+
+int translateMods(const EmscriptenKeyboardEvent& event)
+{
+    return (event.shiftKey ? GLFW_MOD_SHIFT : 0)
+         | (event.ctrlKey ? GLFW_MOD_CONTROL : 0)
+         | (event.altKey ? GLFW_MOD_ALT : 0)
+         | (event.metaKey ? GLFW_MOD_SUPER : 0);
+}
+
+int translateMods(const EmscriptenMouseEvent& event)
+{
+    return (event.shiftKey ? GLFW_MOD_SHIFT : 0)
+         | (event.ctrlKey ? GLFW_MOD_CONTROL : 0)
+         | (event.altKey ? GLFW_MOD_ALT : 0)
+         | (event.metaKey ? GLFW_MOD_SUPER : 0);
+}
+
+/// Browsers number the middle button before the right one.
+int translateMouseButton(unsigned short button)
+{
+    switch (button)
+    {
+    case 0:
+        return GLFW_MOUSE_BUTTON_LEFT;
+    case 1:
+        return GLFW_MOUSE_BUTTON_MIDDLE;
+    case 2:
+        return GLFW_MOUSE_BUTTON_RIGHT;
+    default:
+        return button;
+    }
+}
+
+/// Code point of key value holding a single UTF-8 encoded character, zero for
+/// named keys like "Enter".
+std::uint32_t decodeCharacter(const char* key)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(key);
+    const size_t length = std::strlen(key);
+    if (length == 1 && bytes[0] >= 0x20 && bytes[0] < 0x7F)
+    {
+        return bytes[0];
+    }
+    if (length == 2 && (bytes[0] & 0xE0U) == 0xC0U)
+    {
+        return ((bytes[0] & 0x1FU) << 6U) | (bytes[1] & 0x3FU);
+    }
+    if (length == 3 && (bytes[0] & 0xF0U) == 0xE0U)
+    {
+        return ((bytes[0] & 0x0FU) << 12U) | ((bytes[1] & 0x3FU) << 6U)
+             | (bytes[2] & 0x3FU);
+    }
+    if (length == 4 && (bytes[0] & 0xF8U) == 0xF0U)
+    {
+        return ((bytes[0] & 0x07U) << 18U) | ((bytes[1] & 0x3FU) << 12U)
+             | ((bytes[2] & 0x3FU) << 6U) | (bytes[3] & 0x3FU);
+    }
+    return 0;
+}
+
+void reportError(int error, const char* description)
+{
+    if (errorCallback)
+    {
+        errorCallback(error, description);
+    }
+}
+
+/// Canvas styles are only reachable from the main thread.
+void applyCursorStyle(const GLFWwindow& window)
+{
+    const char* style
+        = window.cursorMode == GLFW_CURSOR_NORMAL ? window.cursorStyle : "none";
+    // Styles are string literals, which outlive the asynchronous call
+    MAIN_THREAD_ASYNC_EM_ASM(
+        {
+            if (Module['canvas'])
+                Module['canvas'].style.cursor = UTF8ToString($0);
+        },
+        style);
+}
+
+EM_BOOL onKey(int eventType, const EmscriptenKeyboardEvent* event, void* data)
+{
+    auto* window = static_cast<GLFWwindow*>(data);
+    const int key = translateKey(event->code);
+    int action = GLFW_RELEASE;
+    if (eventType == EMSCRIPTEN_EVENT_KEYDOWN)
+    {
+        action = event->repeat ? GLFW_REPEAT : GLFW_PRESS;
+    }
+    if (key != GLFW_KEY_UNKNOWN)
+    {
+        window->keys[key] = action == GLFW_RELEASE ? GLFW_RELEASE : GLFW_PRESS;
+    }
+    if (window->keyCallback)
+    {
+        window->keyCallback(window, key, 0, action, translateMods(*event));
+    }
+    // Text input has no separate event since keypress is deprecated
+    if (action != GLFW_RELEASE && window->charCallback && !event->ctrlKey
+        && !event->metaKey)
+    {
+        const std::uint32_t character = decodeCharacter(event->key);
+        if (character != 0)
+        {
+            window->charCallback(window, character);
+        }
+    }
+    return EM_TRUE;
+}
+
+EM_BOOL onMouseButton(int eventType,
+                      const EmscriptenMouseEvent* event,
+                      void* data)
+{
+    auto* window = static_cast<GLFWwindow*>(data);
+    const int button = translateMouseButton(event->button);
+    if (button > GLFW_MOUSE_BUTTON_LAST)
+    {
+        return EM_FALSE;
+    }
+    const int action
+        = eventType == EMSCRIPTEN_EVENT_MOUSEDOWN ? GLFW_PRESS : GLFW_RELEASE;
+    // Releases are received from the whole document, so that buttons do not
+    // get stuck when released outside of the canvas
+    if (action == GLFW_RELEASE && window->mouseButtons[button] == GLFW_RELEASE)
+    {
+        return EM_FALSE;
+    }
+    window->mouseButtons[button] = action;
+    if (window->mouseButtonCallback)
+    {
+        window->mouseButtonCallback(window,
+                                    button,
+                                    action,
+                                    translateMods(*event));
+    }
+    return EM_TRUE;
+}
+
+EM_BOOL onMouseMove([[maybe_unused]] int eventType,
+                    const EmscriptenMouseEvent* event,
+                    void* data)
+{
+    auto* window = static_cast<GLFWwindow*>(data);
+    // Disabled cursor reports an unbounded virtual position like on desktop.
+    // Pointer lock can only be requested by the main thread while handling
+    // the button press, so the cursor is just hidden instead.
+    if (window->cursorMode == GLFW_CURSOR_DISABLED)
+    {
+        window->cursorX += event->movementX;
+        window->cursorY += event->movementY;
+    }
+    else
+    {
+        window->cursorX = event->targetX;
+        window->cursorY = event->targetY;
+    }
+    if (window->cursorPosCallback)
+    {
+        window->cursorPosCallback(window, window->cursorX, window->cursorY);
+    }
+    return EM_TRUE;
+}
+
+EM_BOOL onMouseEnter(int eventType,
+                     [[maybe_unused]] const EmscriptenMouseEvent* event,
+                     void* data)
+{
+    auto* window = static_cast<GLFWwindow*>(data);
+    if (window->cursorEnterCallback)
+    {
+        window->cursorEnterCallback(
+            window,
+            eventType == EMSCRIPTEN_EVENT_MOUSEENTER ? GLFW_TRUE : GLFW_FALSE);
+    }
+    return EM_TRUE;
+}
+
+EM_BOOL onWheel([[maybe_unused]] int eventType,
+                const EmscriptenWheelEvent* event,
+                void* data)
+{
+    auto* window = static_cast<GLFWwindow*>(data);
+    if (window->scrollCallback)
+    {
+        // Same scale as the Emscripten port of GLFW, one step per line
+        const double scale = event->deltaMode == DOM_DELTA_PIXEL ? 0.01 : 1.0;
+        window->scrollCallback(window,
+                               -event->deltaX * scale,
+                               -event->deltaY * scale);
+    }
+    return EM_TRUE;
+}
+
+EM_BOOL onFocus(int eventType,
+                [[maybe_unused]] const EmscriptenFocusEvent* event,
+                void* data)
+{
+    auto* window = static_cast<GLFWwindow*>(data);
+    const bool focused = eventType == EMSCRIPTEN_EVENT_FOCUS;
+    if (!focused)
+    {
+        // Keys released while the page is in the background are never
+        // reported, so they are released on losing focus instead
+        for (size_t key = 0; key < window->keys.size(); ++key)
+        {
+            if (window->keys[key] == GLFW_PRESS)
+            {
+                window->keys[key] = GLFW_RELEASE;
+                if (window->keyCallback)
+                {
+                    window->keyCallback(window,
+                                        static_cast<int>(key),
+                                        0,
+                                        GLFW_RELEASE,
+                                        0);
+                }
+            }
+        }
+    }
+    if (window->focusCallback)
+    {
+        window->focusCallback(window, focused ? GLFW_TRUE : GLFW_FALSE);
+    }
+    return EM_TRUE;
+}
+
+/// Listeners are registered on the main thread, events are queued to the
+/// thread registering them.
+void registerEventCallbacks(GLFWwindow* window)
+{
+    emscripten_set_keydown_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                    window,
+                                    EM_TRUE,
+                                    onKey);
+    emscripten_set_keyup_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                  window,
+                                  EM_TRUE,
+                                  onKey);
+    emscripten_set_mousedown_callback(CANVAS, window, EM_TRUE, onMouseButton);
+    emscripten_set_mouseup_callback(EMSCRIPTEN_EVENT_TARGET_DOCUMENT,
+                                    window,
+                                    EM_TRUE,
+                                    onMouseButton);
+    emscripten_set_mousemove_callback(CANVAS, window, EM_TRUE, onMouseMove);
+    emscripten_set_mouseenter_callback(CANVAS, window, EM_TRUE, onMouseEnter);
+    emscripten_set_mouseleave_callback(CANVAS, window, EM_TRUE, onMouseEnter);
+    emscripten_set_wheel_callback(CANVAS, window, EM_TRUE, onWheel);
+    emscripten_set_focus_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                  window,
+                                  EM_TRUE,
+                                  onFocus);
+    emscripten_set_blur_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                 window,
+                                 EM_TRUE,
+                                 onFocus);
+}
+
+void unregisterEventCallbacks()
+{
+    emscripten_set_keydown_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                    nullptr,
+                                    EM_TRUE,
+                                    nullptr);
+    emscripten_set_keyup_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                  nullptr,
+                                  EM_TRUE,
+                                  nullptr);
+    emscripten_set_mousedown_callback(CANVAS, nullptr, EM_TRUE, nullptr);
+    emscripten_set_mouseup_callback(EMSCRIPTEN_EVENT_TARGET_DOCUMENT,
+                                    nullptr,
+                                    EM_TRUE,
+                                    nullptr);
+    emscripten_set_mousemove_callback(CANVAS, nullptr, EM_TRUE, nullptr);
+    emscripten_set_mouseenter_callback(CANVAS, nullptr, EM_TRUE, nullptr);
+    emscripten_set_mouseleave_callback(CANVAS, nullptr, EM_TRUE, nullptr);
+    emscripten_set_wheel_callback(CANVAS, nullptr, EM_TRUE, nullptr);
+    emscripten_set_focus_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                  nullptr,
+                                  EM_TRUE,
+                                  nullptr);
+    emscripten_set_blur_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW,
+                                 nullptr,
+                                 EM_TRUE,
+                                 nullptr);
+}
+}  // namespace
+
+int glfwInit()
+{
+    startTime = emscripten_get_now();
+    return GLFW_TRUE;
+}
+
+void glfwTerminate() {}
+
+GLFWerrorfun glfwSetErrorCallback(GLFWerrorfun callback)
+{
+    return std::exchange(errorCallback, callback);
+}
+
+void glfwWindowHint(int hint, int value)
+{
+    // Context attributes follow those of the GLFW port, other hints have no
+    // meaning for a canvas
+    if (hint == GLFW_CONTEXT_VERSION_MAJOR)
+    {
+        contextVersionMajor = value;
+    }
+}
+
+GLFWwindow* glfwCreateWindow(int width,
+                             int height,
+                             [[maybe_unused]] const char* title,
+                             [[maybe_unused]] GLFWmonitor* monitor,
+                             [[maybe_unused]] GLFWwindow* share)
+{
+    EmscriptenWebGLContextAttributes attributes;
+    emscripten_webgl_init_context_attributes(&attributes);
+    attributes.majorVersion = contextVersionMajor >= 3 ? 2 : 1;
+    attributes.minorVersion = 0;
+    attributes.antialias = EM_FALSE;
+    attributes.stencil = EM_TRUE;
+    emscripten_set_canvas_element_size(CANVAS, width, height);
+    const EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context
+        = emscripten_webgl_create_context(CANVAS, &attributes);
+    if (context <= 0)
+    {
+        reportError(GLFW_VERSION_UNAVAILABLE,
+                    "unable to create WebGL context on OffscreenCanvas");
+        return nullptr;
+    }
+
+    auto* window = new GLFWwindow{
+        .context = context,
+        .userPointer = nullptr,
+        .width = width,
+        .height = height,
+        .cursorX = 0.0,
+        .cursorY = 0.0,
+        .cursorMode = GLFW_CURSOR_NORMAL,
+        .cursorStyle = "default",
+        .keys = {},
+        .mouseButtons = {},
+        .clipboard = {},
+        .mouseButtonCallback = nullptr,
+        .cursorPosCallback = nullptr,
+        .cursorEnterCallback = nullptr,
+        .scrollCallback = nullptr,
+        .keyCallback = nullptr,
+        .charCallback = nullptr,
+        .frameBufferSizeCallback = nullptr,
+        .refreshCallback = nullptr,
+        .focusCallback = nullptr,
+    };
+    registerEventCallbacks(window);
+    return window;
+}
+
+void glfwDestroyWindow(GLFWwindow* window)
+{
+    if (!window)
+    {
+        return;
+    }
+    unregisterEventCallbacks();
+    emscripten_webgl_destroy_context(window->context);
+    delete window;
+}
+
+void glfwMakeContextCurrent(GLFWwindow* window)
+{
+    emscripten_webgl_make_context_current(window ? window->context : 0);
+}
+
+void glfwSwapBuffers([[maybe_unused]] GLFWwindow* window)
+{
+    // Frame is presented when the worker returns to the browser, like the
+    // canvas of the main thread
+}
+
+GLFWglproc glfwGetProcAddress(const char* procname)
+{
+    return reinterpret_cast<GLFWglproc>(
+        emscripten_webgl_get_proc_address(procname));
+}
+
+void glfwSetWindowUserPointer(GLFWwindow* window, void* pointer)
+{
+    window->userPointer = pointer;
+}
+
+void* glfwGetWindowUserPointer(GLFWwindow* window)
+{
+    return window->userPointer;
+}
+
+GLFWmousebuttonfun glfwSetMouseButtonCallback(GLFWwindow* window,
+                                              GLFWmousebuttonfun callback)
+{
+    return std::exchange(window->mouseButtonCallback, callback);
+}
+
+GLFWcursorposfun glfwSetCursorPosCallback(GLFWwindow* window,
+                                          GLFWcursorposfun callback)
+{
+    return std::exchange(window->cursorPosCallback, callback);
+}
+
+GLFWcursorenterfun glfwSetCursorEnterCallback(GLFWwindow* window,
+                                              GLFWcursorenterfun callback)
+{
+    return std::exchange(window->cursorEnterCallback, callback);
+}
+
+GLFWscrollfun glfwSetScrollCallback(GLFWwindow* window, GLFWscrollfun callback)
+{
+    return std::exchange(window->scrollCallback, callback);
+}
+
+GLFWkeyfun glfwSetKeyCallback(GLFWwindow* window, GLFWkeyfun callback)
+{
+    return std::exchange(window->keyCallback, callback);
+}
+
+GLFWcharfun glfwSetCharCallback(GLFWwindow* window, GLFWcharfun callback)
+{
+    return std::exchange(window->charCallback, callback);
+}
+
+GLFWframebuffersizefun glfwSetFramebufferSizeCallback(
+    GLFWwindow* window,
+    GLFWframebuffersizefun callback)
+{
+    return std::exchange(window->frameBufferSizeCallback, callback);
+}
+
+GLFWwindowrefreshfun glfwSetWindowRefreshCallback(
+    GLFWwindow* window,
+    GLFWwindowrefreshfun callback)
+{
+    return std::exchange(window->refreshCallback, callback);
+}
+
+GLFWwindowfocusfun glfwSetWindowFocusCallback(GLFWwindow* window,
+                                              GLFWwindowfocusfun callback)
+{
+    return std::exchange(window->focusCallback, callback);
+}
+
+GLFWmonitorfun glfwSetMonitorCallback([[maybe_unused]] GLFWmonitorfun callback)
+{
+    // Canvas has no monitors to be notified about
+    return nullptr;
+}
+
+void glfwPollEvents()
+{
+    // Events forwarded by the main thread since the last frame are run now
+    // instead of after returning to the browser, so that they are not a frame
+    // late
+    emscripten_current_thread_process_queued_calls();
+}
+
+int glfwGetKey(GLFWwindow* window, int key)
+{
+    return key >= 0 && key <= GLFW_KEY_LAST ? window->keys[key] : GLFW_RELEASE;
+}
+
+int glfwGetMouseButton(GLFWwindow* window, int button)
+{
+    return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST
+             ? window->mouseButtons[button]
+             : GLFW_RELEASE;
+}
+
+int glfwGetInputMode(GLFWwindow* window, int mode)
+{
+    return mode == GLFW_CURSOR ? window->cursorMode : 0;
+}
+
+void glfwSetInputMode(GLFWwindow* window, int mode, int value)
+{
+    if (mode != GLFW_CURSOR || window->cursorMode == value)
+    {
+        return;
+    }
+    window->cursorMode = value;
+    applyCursorStyle(*window);
+}
+
+void glfwGetCursorPos(GLFWwindow* window, double* x, double* y)
+{
+    *x = window->cursorX;
+    *y = window->cursorY;
+}
+
+void glfwSetCursorPos(GLFWwindow* window, double x, double y)
+{
+    // Browsers do not allow moving the cursor, only the reported position is
+    // changed
+    window->cursorX = x;
+    window->cursorY = y;
+}
+
+void glfwGetWindowSize(GLFWwindow* window, int* width, int* height)
+{
+    *width = window->width;
+    *height = window->height;
+}
+
+void glfwSetWindowSize(GLFWwindow* window, int width, int height)
+{
+    if (width == window->width && height == window->height)
+    {
+        return;
+    }
+    // Drawing buffer is owned by the worker, the element keeps its CSS size
+    emscripten_set_canvas_element_size(CANVAS, width, height);
+    window->width = width;
+    window->height = height;
+    if (window->frameBufferSizeCallback)
+    {
+        window->frameBufferSizeCallback(window, width, height);
+    }
+    if (window->refreshCallback)
+    {
+        window->refreshCallback(window);
+    }
+}
+
+void glfwGetFramebufferSize(GLFWwindow* window, int* width, int* height)
+{
+    // Canvas pixels are not scaled by the device pixel ratio, like in the
+    // GLFW port
+    *width = window->width;
+    *height = window->height;
+}
+
+double glfwGetTime()
+{
+    return (emscripten_get_now() - startTime) / 1000.0;
+}
+
+GLFWcursor* glfwCreateStandardCursor(int shape)
+{
+    const char* style = "default";
+    switch (shape)
+    {
+    case GLFW_IBEAM_CURSOR:
+        style = "text";
+        break;
+    case GLFW_CROSSHAIR_CURSOR:
+        style = "crosshair";
+        break;
+    case GLFW_HAND_CURSOR:
+        style = "pointer";
+        break;
+    case GLFW_HRESIZE_CURSOR:
+        style = "ew-resize";
+        break;
+    case GLFW_VRESIZE_CURSOR:
+        style = "ns-resize";
+        break;
+    default:
+        break;
+    }
+    return new GLFWcursor{.style = style};
+}
+
+void glfwDestroyCursor(GLFWcursor* cursor)
+{
+    delete cursor;
+}
+
+void glfwSetCursor(GLFWwindow* window, GLFWcursor* cursor)
+{
+    const char* style = cursor ? cursor->style : "default";
+    if (style == window->cursorStyle)
+    {
+        return;
+    }
+    window->cursorStyle = style;
+    applyCursorStyle(*window);
+}
+
+const char* glfwGetClipboardString(GLFWwindow* window)
+{
+    // System clipboard is asynchronous and only available to the page, so
+    // text is only copied within the application
+    return window->clipboard.c_str();
+}
+
+void glfwSetClipboardString(GLFWwindow* window, const char* text)
+{
+    window->clipboard = text;
+}
+
+const float* glfwGetJoystickAxes([[maybe_unused]] int joy, int* count)
+{
+    *count = 0;
+    return nullptr;
+}
+
+const unsigned char* glfwGetJoystickButtons([[maybe_unused]] int joy,
+                                            int* count)
+{
+    *count = 0;
+    return nullptr;
+}
@@ -0,0 +1,145 @@
+#include "glstatecache.h"
+
+GlStateCache::GlStateCache()
+    : program_{UNKNOWN}
+    , vertexArray_{UNKNOWN}
+    , activeTextureUnit_{UNKNOWN}
+    , textureBindings_{}
+    , depthFunc_{UNKNOWN}
+    , depthWriteEnabled_{UNKNOWN}
+    , colorWriteEnabled_{UNKNOWN}
+    , blendEnabled_{UNKNOWN}
+    , blendFactors_{UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN}
+    , issuedCallCount_{0}
+    , skippedCallCount_{0}
+{
+    invalidateBindings();
+}
+
+template <typename T>
+bool GlStateCache::update(T& cached, T value)
+{
+    if (cached == value)
+    {
+        ++skippedCallCount_;
+        return false;
+    }
+    cached = value;
+    ++issuedCallCount_;
+    return true;
+}
+
+bool GlStateCache::useProgram(GLuint program)
+{
+    if (!update(program_, program))
+    {
+        return false;
+    }
+    glUseProgram(program);
+    return true;
+}
+
+void GlStateCache::bindVertexArray(GLuint vertexArray)
+{
+    if (update(vertexArray_, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void GlStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    // Units have a binding per target, but only the last bound target of a
+    // unit is tracked. Rebinding a different target is always issued.
+    if (unit < TEXTURE_UNIT_COUNT)
+    {
+        TextureBinding& binding = textureBindings_[unit];
+        if (binding.target == target && binding.texture == texture)
+        {
+            ++skippedCallCount_;
+            return;
+        }
+        binding = {.target = target, .texture = texture};
+    }
+    if (update(activeTextureUnit_, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    glBindTexture(target, texture);
+    ++issuedCallCount_;
+}
+
+void GlStateCache::setDepthFunc(GLenum func)
+{
+    if (update(depthFunc_, func))
+    {
+        glDepthFunc(func);
+    }
+}
+
+void GlStateCache::setDepthWriteEnabled(bool enabled)
+{
+    if (update(depthWriteEnabled_, static_cast<GLuint>(enabled)))
+    {
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GlStateCache::setColorWriteEnabled(bool enabled)
+{
+    if (update(colorWriteEnabled_, static_cast<GLuint>(enabled)))
+    {
+        const GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+}
+
+void GlStateCache::setBlendEnabled(bool enabled)
+{
+    if (update(blendEnabled_, static_cast<GLuint>(enabled)))
+    {
+        if (enabled)
+        {
+            glEnable(GL_BLEND);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+        }
+    }
+}
+
+void GlStateCache::setBlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+    setBlendFuncSeparate(sourceFactor,
+                         destinationFactor,
+                         sourceFactor,
+                         destinationFactor);
+}
+
+void GlStateCache::setBlendFuncSeparate(GLenum colorSourceFactor,
+                                        GLenum colorDestinationFactor,
+                                        GLenum alphaSourceFactor,
+                                        GLenum alphaDestinationFactor)
+{
+    // Counted as a single call, all factors are set together
+    const std::array<GLenum, 4> factors{colorSourceFactor,
+                                        colorDestinationFactor,
+                                        alphaSourceFactor,
+                                        alphaDestinationFactor};
+    if (update(blendFactors_, factors))
+    {
+        glBlendFuncSeparate(colorSourceFactor,
+                            colorDestinationFactor,
+                            alphaSourceFactor,
+                            alphaDestinationFactor);
+    }
+}
+
+void GlStateCache::invalidateBindings()
+{
+    program_ = UNKNOWN;
+    vertexArray_ = UNKNOWN;
+    activeTextureUnit_ = UNKNOWN;
+    textureBindings_.fill({.target = UNKNOWN, .texture = UNKNOWN});
+}
@@ -0,0 +1,92 @@
+#ifndef GL_STATE_CACHE_H_
+#define GL_STATE_CACHE_H_
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <array>
+#include <cstdint>
+
+/// Shadow copy of OpenGL state changed by draws, dropping calls that would set
+/// state to the value it already has. Especially worthwhile in WebGL, where
+/// every call crosses from WebAssembly into JavaScript.
+///
+/// State has to be changed only through the cache for it to stay accurate.
+/// Bindings are assumed unknown until set for the first time, or after
+/// invalidateBindings() when other code may have changed them.
+class GlStateCache
+{
+public:
+    /// Texture units tracked by the cache. Binding textures to further units
+    /// is always issued.
+    static constexpr GLuint TEXTURE_UNIT_COUNT = 8;
+
+    GlStateCache();
+
+    /// Returns true when the program was bound by this call, meaning that
+    /// program state reset on binding needs to be applied again.
+    bool useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void setDepthFunc(GLenum func);
+    void setDepthWriteEnabled(bool enabled);
+    /// Writes of all color components are enabled or disabled together.
+    void setColorWriteEnabled(bool enabled);
+    void setBlendEnabled(bool enabled);
+    /// Blending state set last, disabled before it is first set.
+    [[nodiscard]] bool blendEnabled() const { return blendEnabled_ == 1; }
+    void setBlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+    /// Blend color and alpha components with factors of their own.
+    void setBlendFuncSeparate(GLenum colorSourceFactor,
+                              GLenum colorDestinationFactor,
+                              GLenum alphaSourceFactor,
+                              GLenum alphaDestinationFactor);
+
+    /// Forget program, vertex array and texture bindings, because object
+    /// creation and UI rendering bind them outside of the cache.
+    void invalidateBindings();
+
+    /// Number of state changes passed on to OpenGL since creation.
+    [[nodiscard]] std::uint64_t issuedCallCount() const
+    {
+        return issuedCallCount_;
+    }
+
+    /// Number of state changes dropped since creation.
+    [[nodiscard]] std::uint64_t skippedCallCount() const
+    {
+        return skippedCallCount_;
+    }
+
+private:
+    /// Tracked value before it is first set, not matching any valid value.
+    static constexpr GLuint UNKNOWN = ~GLuint{0};
+
+    struct TextureBinding
+    {
+        GLenum target;
+        GLuint texture;
+    };
+
+    /// Compare and update cached value, counting skipped changes.
+    template <typename T>
+    bool update(T& cached, T value);
+
+    GLuint program_;
+    GLuint vertexArray_;
+    GLuint activeTextureUnit_;
+    std::array<TextureBinding, TEXTURE_UNIT_COUNT> textureBindings_;
+    GLenum depthFunc_;
+    GLuint depthWriteEnabled_;
+    GLuint colorWriteEnabled_;
+    GLuint blendEnabled_;
+    /// Source and destination factors of color, followed by those of alpha.
+    std::array<GLenum, 4> blendFactors_;
+    std::uint64_t issuedCallCount_;
+    std::uint64_t skippedCallCount_;
+};
+
+#endif
@@ -0,0 +1,905 @@
+#include "gltfloader.h"
+
+#include "assetfs.h"
+#include "materialtexture.h"
+#include "meshprocessing.h"
+#include "profiler.h"
+#include "threadpool.h"
+#include "utils.h"
+
+// clang-format off
+#define CGLTF_IMPLEMENTATION
+#include "cgltf.h"
+// clang-format on
+#ifdef DRACO_ENABLED
+#include "draco/compression/decode.h"
+#endif
+#include "meshoptimizer.h"
+
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "glm/mat3x3.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/matrix.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Vertex data of a triangle primitive, read either from accessors of the
+/// file or from geometry decoded from Draco. Shared by every instance of the
+/// primitive in the node hierarchy.
+struct PrimitiveSource
+{
+    const cgltf_accessor* positions;
+    const cgltf_accessor* normals;
+    /// First set of texture coordinates, the one base color textures are
+    /// sampled with.
+    const cgltf_accessor* texCoords;
+    const cgltf_accessor* indices;
+    /// Replace accessors when the primitive is Draco compressed.
+    std::vector<glm::vec3> decodedPositions;
+    std::vector<glm::vec3> decodedNormals;
+    std::vector<glm::vec2> decodedTexCoords;
+    std::vector<GLuint> decodedIndices;
+    bool decoded;
+    size_t vertexCount;
+    size_t indexCount;
+    bool hasNormals;
+    bool hasTexCoords;
+};
+
+/// Image of base color texture of the material of primitive, if any.
+/// Textures sampled with other than the first texture coordinates are
+/// skipped.
+const cgltf_image* getBaseColorImage(const cgltf_primitive& primitive)
+{
+    if (!primitive.material || !primitive.material->has_pbr_metallic_roughness)
+    {
+        return nullptr;
+    }
+    const cgltf_texture_view& view
+        = primitive.material->pbr_metallic_roughness.base_color_texture;
+    if (!view.texture || view.texcoord != 0)
+    {
+        return nullptr;
+    }
+    return view.texture->image;
+}
+
+/// Encoded contents of image, from a buffer view, a data URI or a file
+/// relative to the glTF file.
+std::optional<std::vector<std::byte>> readImage(const cgltf_image& image,
+                                                const fs::path& filePath)
+{
+    if (image.buffer_view)
+    {
+        const auto* bytes = reinterpret_cast<const std::byte*>(
+            cgltf_buffer_view_data(image.buffer_view));
+        if (!bytes)
+        {
+            return std::nullopt;
+        }
+        return std::vector<std::byte>{bytes, bytes + image.buffer_view->size};
+    }
+    if (!image.uri)
+    {
+        return std::nullopt;
+    }
+    const std::string_view uri{image.uri};
+    if (uri.starts_with("data:"))
+    {
+        const size_t separator = uri.find(";base64,");
+        if (separator == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        const std::string_view base64 = uri.substr(separator + 8);
+        const size_t padding
+            = base64.size() - base64.find_last_not_of('=') - 1;
+        const size_t size = base64.size() / 4 * 3 - padding;
+        const cgltf_options options{};
+        void* decoded = nullptr;
+        if (cgltf_load_buffer_base64(&options, size, base64.data(), &decoded)
+            != cgltf_result_success)
+        {
+            return std::nullopt;
+        }
+        const std::unique_ptr<void, decltype(&std::free)> owner(decoded,
+                                                                std::free);
+        const auto* bytes = static_cast<const std::byte*>(decoded);
+        return std::vector<std::byte>{bytes, bytes + size};
+    }
+    std::string decodedUri{uri};
+    decodedUri.resize(cgltf_decode_uri(decodedUri.data()));
+    const std::optional<AssetData> file
+        = assetfs::readFile(filePath.parent_path() / decodedUri);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+    return std::vector<std::byte>{file->bytes().begin(), file->bytes().end()};
+}
+
+/// Base color factor of the material of primitive, white without one.
+glm::vec3 getBaseColor(const cgltf_primitive& primitive)
+{
+    if (!primitive.material || !primitive.material->has_pbr_metallic_roughness)
+    {
+        return glm::vec3{1.0F};
+    }
+    const cgltf_float* factor
+        = primitive.material->pbr_metallic_roughness.base_color_factor;
+    return glm::vec3{factor[0], factor[1], factor[2]};
+}
+
+/// Alpha of base color of materials in blend mode. Alpha of opaque and
+/// masked materials does not make them transparent.
+float getOpacity(const cgltf_primitive& primitive)
+{
+    if (!primitive.material
+        || primitive.material->alpha_mode != cgltf_alpha_mode_blend
+        || !primitive.material->has_pbr_metallic_roughness)
+    {
+        return 1.0F;
+    }
+    return std::clamp(
+        primitive.material->pbr_metallic_roughness.base_color_factor[3],
+        0.0F,
+        1.0F);
+}
+
+/// Primitive placed into the scene by a node.
+struct PrimitiveInstance
+{
+    size_t sourceIndex;
+    glm::mat4 transform;
+};
+
+/// Run body over ranges of count items on the thread pool when given, or on
+/// the calling thread otherwise. Every item is a range of its own, items are
+/// expected to be large.
+template <typename F>
+void forEachItem(ThreadPool* threadPool, size_t count, F&& body)
+{
+    if (threadPool)
+    {
+        threadPool->parallelFor(count, 1, std::forward<F>(body));
+    }
+    else if (count > 0)
+    {
+        body(size_t{0}, count);
+    }
+}
+
+/// Decode buffer view compressed with EXT_meshopt_compression into memory
+/// cgltf reads accessors from instead of the buffer.
+bool decodeMeshoptView(cgltf_buffer_view& view)
+{
+    const cgltf_meshopt_compression& compression = view.meshopt_compression;
+    if (!compression.buffer || !compression.buffer->data)
+    {
+        return false;
+    }
+    const auto* source
+        = static_cast<const unsigned char*>(compression.buffer->data)
+        + compression.offset;
+    // Freed by cgltf_free() along with the rest of the file
+    void* decoded = std::malloc(compression.count * compression.stride);
+    if (!decoded)
+    {
+        return false;
+    }
+    view.data = decoded;
+
+    int result = -1;
+    switch (compression.mode)
+    {
+    case cgltf_meshopt_compression_mode_attributes:
+        result = meshopt_decodeVertexBuffer(decoded,
+                                            compression.count,
+                                            compression.stride,
+                                            source,
+                                            compression.size);
+        break;
+    case cgltf_meshopt_compression_mode_triangles:
+        result = meshopt_decodeIndexBuffer(decoded,
+                                           compression.count,
+                                           compression.stride,
+                                           source,
+                                           compression.size);
+        break;
+    case cgltf_meshopt_compression_mode_indices:
+        result = meshopt_decodeIndexSequence(decoded,
+                                             compression.count,
+                                             compression.stride,
+                                             source,
+                                             compression.size);
+        break;
+    default:
+        break;
+    }
+    if (result != 0)
+    {
+        return false;
+    }
+
+    switch (compression.filter)
+    {
+    case cgltf_meshopt_compression_filter_octahedral:
+        meshopt_decodeFilterOct(decoded, compression.count, compression.stride);
+        break;
+    case cgltf_meshopt_compression_filter_quaternion:
+        meshopt_decodeFilterQuat(decoded,
+                                 compression.count,
+                                 compression.stride);
+        break;
+    case cgltf_meshopt_compression_filter_exponential:
+        meshopt_decodeFilterExp(decoded, compression.count, compression.stride);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+#ifdef DRACO_ENABLED
+/// Decode primitive compressed with KHR_draco_mesh_compression. Attributes
+/// of the extension refer to Draco attributes by unique identifier, which
+/// cgltf stores as accessor index.
+bool decodeDracoPrimitive(const cgltf_data& data,
+                          const cgltf_primitive& primitive,
+                          PrimitiveSource& source)
+{
+    const cgltf_draco_mesh_compression& compression
+        = primitive.draco_mesh_compression;
+    draco::DecoderBuffer buffer;
+    buffer.Init(reinterpret_cast<const char*>(
+                    cgltf_buffer_view_data(compression.buffer_view)),
+                compression.buffer_view->size);
+    draco::Decoder decoder;
+    draco::StatusOr<std::unique_ptr<draco::Mesh>> decodedMesh
+        = decoder.DecodeMeshFromBuffer(&buffer);
+    if (!decodedMesh.ok())
+    {
+        return false;
+    }
+    const std::unique_ptr<draco::Mesh> mesh = std::move(decodedMesh).value();
+
+    const auto pointCount = static_cast<size_t>(mesh->num_points());
+    for (size_t i = 0; i < compression.attributes_count; ++i)
+    {
+        const cgltf_attribute& attribute = compression.attributes[i];
+        const draco::PointAttribute* dracoAttribute
+            = mesh->GetAttributeByUniqueId(
+                static_cast<std::uint32_t>(attribute.data - data.accessors));
+        if (attribute.type == cgltf_attribute_type_texcoord
+            && attribute.index == 0)
+        {
+            if (!dracoAttribute)
+            {
+                return false;
+            }
+            source.decodedTexCoords.resize(pointCount);
+            for (draco::PointIndex point(0); point < mesh->num_points();
+                 ++point)
+            {
+                dracoAttribute->ConvertValue<float, 2>(
+                    dracoAttribute->mapped_index(point),
+                    &source.decodedTexCoords[point.value()].x);
+            }
+            continue;
+        }
+        std::vector<glm::vec3>* values = nullptr;
+        if (attribute.type == cgltf_attribute_type_position)
+        {
+            values = &source.decodedPositions;
+        }
+        else if (attribute.type == cgltf_attribute_type_normal)
+        {
+            values = &source.decodedNormals;
+        }
+        else
+        {
+            continue;
+        }
+        if (!dracoAttribute)
+        {
+            return false;
+        }
+        values->resize(pointCount);
+        for (draco::PointIndex point(0); point < mesh->num_points(); ++point)
+        {
+            dracoAttribute->ConvertValue<float, 3>(
+                dracoAttribute->mapped_index(point),
+                &(*values)[point.value()].x);
+        }
+    }
+    if (source.decodedPositions.empty())
+    {
+        return false;
+    }
+
+    source.decodedIndices.resize(static_cast<size_t>(mesh->num_faces()) * 3);
+    for (draco::FaceIndex face(0); face < mesh->num_faces(); ++face)
+    {
+        const draco::Mesh::Face& corners = mesh->face(face);
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            source.decodedIndices[face.value() * 3 + corner]
+                = corners[corner].value();
+        }
+    }
+    source.decoded = true;
+    source.vertexCount = pointCount;
+    source.indexCount = source.decodedIndices.size();
+    source.hasNormals = !source.decodedNormals.empty();
+    source.hasTexCoords = !source.decodedTexCoords.empty();
+    return true;
+}
+#endif
+
+/// Find accessors of primitive, or decode it when compressed.
+bool prepareSource(const cgltf_data& data,
+                   const cgltf_primitive& primitive,
+                   PrimitiveSource& source)
+{
+    source = {};
+    for (size_t i = 0; i < primitive.attributes_count; ++i)
+    {
+        const cgltf_attribute& attribute = primitive.attributes[i];
+        if (attribute.type == cgltf_attribute_type_position)
+        {
+            source.positions = attribute.data;
+        }
+        else if (attribute.type == cgltf_attribute_type_normal)
+        {
+            source.normals = attribute.data;
+        }
+        else if (attribute.type == cgltf_attribute_type_texcoord
+                 && attribute.index == 0)
+        {
+            source.texCoords = attribute.data;
+        }
+    }
+    source.indices = primitive.indices;
+#ifdef DRACO_ENABLED
+    if (primitive.has_draco_mesh_compression)
+    {
+        return decodeDracoPrimitive(data, primitive, source);
+    }
+#else
+    (void)data;
+#endif
+    if (!source.positions)
+    {
+        return false;
+    }
+    source.vertexCount = source.positions->count;
+    source.indexCount
+        = source.indices ? source.indices->count : source.vertexCount;
+    source.hasNormals = source.normals != nullptr;
+    source.hasTexCoords = source.texCoords != nullptr
+                       && source.texCoords->count == source.vertexCount;
+    return true;
+}
+
+/// Read accessor of two or three components into vectors with given byte
+/// stride between them. Float data is copied straight from the buffer,
+/// quantized and sparse accessors are converted element by element.
+template <typename Vector>
+void readVectors(const cgltf_accessor& accessor,
+                 Vector* out,
+                 size_t outStride)
+{
+    auto* outBytes = reinterpret_cast<std::byte*>(out);
+    if (accessor.component_type == cgltf_component_type_r_32f
+        && cgltf_num_components(accessor.type)
+               == static_cast<cgltf_size>(Vector::length())
+        && !accessor.is_sparse && accessor.buffer_view)
+    {
+        const std::uint8_t* source
+            = cgltf_buffer_view_data(accessor.buffer_view) + accessor.offset;
+        for (size_t i = 0; i < accessor.count; ++i)
+        {
+            std::memcpy(outBytes + i * outStride,
+                        source + i * accessor.stride,
+                        sizeof(Vector));
+        }
+        return;
+    }
+    for (size_t i = 0; i < accessor.count; ++i)
+    {
+        cgltf_accessor_read_float(
+            &accessor,
+            i,
+            reinterpret_cast<cgltf_float*>(outBytes + i * outStride),
+            Vector::length());
+    }
+}
+
+void readIndices(const PrimitiveSource& source, GLuint* out)
+{
+    if (source.decoded)
+    {
+        std::copy(source.decodedIndices.begin(),
+                  source.decodedIndices.end(),
+                  out);
+        return;
+    }
+    const cgltf_accessor* accessor = source.indices;
+    // Primitives without indices draw their vertices in order
+    if (!accessor)
+    {
+        std::iota(out, out + source.indexCount, GLuint{0});
+        return;
+    }
+    if (!accessor->is_sparse && accessor->buffer_view)
+    {
+        const std::uint8_t* indexData
+            = cgltf_buffer_view_data(accessor->buffer_view) + accessor->offset;
+        if (accessor->component_type == cgltf_component_type_r_32u)
+        {
+            for (size_t i = 0; i < accessor->count; ++i)
+            {
+                std::memcpy(&out[i],
+                            indexData + i * accessor->stride,
+                            sizeof(GLuint));
+            }
+            return;
+        }
+        if (accessor->component_type == cgltf_component_type_r_16u)
+        {
+            for (size_t i = 0; i < accessor->count; ++i)
+            {
+                std::uint16_t index = 0;
+                std::memcpy(&index,
+                            indexData + i * accessor->stride,
+                            sizeof(index));
+                out[i] = index;
+            }
+            return;
+        }
+    }
+    for (size_t i = 0; i < accessor->count; ++i)
+    {
+        out[i] = static_cast<GLuint>(cgltf_accessor_read_index(accessor, i));
+    }
+}
+
+/// Copy instance of primitive into its sub-mesh range of the merged arrays,
+/// transformed into model space. Vertices of primitives without normals are
+/// unwelded for flat normals unless smooth normals are generated. Fails on
+/// indices past the vertices, which decoded buffers are not checked for.
+[[nodiscard]] bool copyInstance(const PrimitiveSource& source,
+                  const glm::mat4& transform,
+                  bool smoothNormals,
+                  ThreadPool* threadPool,
+                  std::span<Vertex> vertices,
+                  std::span<GLuint> indices)
+{
+    if (vertices.empty())
+    {
+        return true;
+    }
+    readIndices(source, indices.data());
+    if (!std::ranges::all_of(indices,
+                             [&](GLuint index)
+                             { return index < source.vertexCount; }))
+    {
+        return false;
+    }
+    const glm::mat3 linearTransform{transform};
+    // Mirroring transforms turn front faces into back faces, which swapping
+    // two corners of every triangle turns back
+    if (glm::determinant(linearTransform) < 0.0F)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            std::swap(indices[i + 1], indices[i + 2]);
+        }
+    }
+
+    const bool flatNormals = !source.hasNormals && !smoothNormals;
+    std::vector<glm::vec3> flatPositions;
+    std::vector<glm::vec2> flatTexCoords;
+    glm::vec3* positions = &vertices.front().position;
+    size_t positionStride = sizeof(Vertex);
+    glm::vec2* texCoords = &vertices.front().texCoord;
+    size_t texCoordStride = sizeof(Vertex);
+    if (flatNormals)
+    {
+        flatPositions.resize(source.vertexCount);
+        positions = flatPositions.data();
+        positionStride = sizeof(glm::vec3);
+        if (source.hasTexCoords)
+        {
+            flatTexCoords.resize(source.vertexCount);
+            texCoords = flatTexCoords.data();
+            texCoordStride = sizeof(glm::vec2);
+        }
+    }
+    if (source.decoded)
+    {
+        for (size_t i = 0; i < source.vertexCount; ++i)
+        {
+            *reinterpret_cast<glm::vec3*>(reinterpret_cast<std::byte*>(
+                                              positions)
+                                          + i * positionStride)
+                = source.decodedPositions[i];
+            if (source.hasNormals)
+            {
+                vertices[i].normal = source.decodedNormals[i];
+            }
+            if (source.hasTexCoords)
+            {
+                *reinterpret_cast<glm::vec2*>(reinterpret_cast<std::byte*>(
+                                                  texCoords)
+                                              + i * texCoordStride)
+                    = source.decodedTexCoords[i];
+            }
+        }
+    }
+    else
+    {
+        readVectors(*source.positions, positions, positionStride);
+        if (source.hasNormals)
+        {
+            readVectors(*source.normals,
+                        &vertices.front().normal,
+                        sizeof(Vertex));
+        }
+        if (source.hasTexCoords)
+        {
+            readVectors(*source.texCoords, texCoords, texCoordStride);
+        }
+    }
+
+    if (flatNormals)
+    {
+        // Every corner becomes a vertex of its own, sharing the normal of its
+        // triangle
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const glm::vec3 a = glm::vec3{
+                transform * glm::vec4{flatPositions[indices[i]], 1.0F}};
+            const glm::vec3 b = glm::vec3{
+                transform * glm::vec4{flatPositions[indices[i + 1]], 1.0F}};
+            const glm::vec3 c = glm::vec3{
+                transform * glm::vec4{flatPositions[indices[i + 2]], 1.0F}};
+            const glm::vec3 faceNormal = glm::cross(b - a, c - a);
+            const float length = glm::length(faceNormal);
+            const glm::vec3 normal = length > 0.0F
+                                       ? faceNormal / length
+                                       : glm::vec3{0.0F, 0.0F, 1.0F};
+            const std::array corners{a, b, c};
+            for (size_t corner = 0; corner < corners.size(); ++corner)
+            {
+                vertices[i + corner] = {
+                    .position = corners[corner],
+                    .normal = normal,
+                    .texCoord = source.hasTexCoords
+                                  ? flatTexCoords[indices[i + corner]]
+                                  : glm::vec2{0.0F},
+                };
+            }
+        }
+        std::iota(indices.begin(), indices.end(), GLuint{0});
+        return true;
+    }
+
+    if (transform != glm::mat4{1.0F})
+    {
+        const glm::mat3 normalMatrix = glm::inverseTranspose(linearTransform);
+        for (Vertex& vertex : vertices)
+        {
+            vertex.position
+                = glm::vec3{transform * glm::vec4{vertex.position, 1.0F}};
+            vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+        }
+    }
+    if (!source.hasNormals)
+    {
+        meshprocessing::generateSmoothNormals(vertices, indices, threadPool);
+    }
+    return true;
+}
+}  // namespace
+
+namespace gltf
+{
+bool isGltfFile(const fs::path& filePath)
+{
+    const fs::path extension = filePath.extension();
+    return extension == ".gltf" || extension == ".glb";
+}
+
+bool load(const fs::path& filePath,
+          const ImportOptions& options,
+          ThreadPool* threadPool,
+          std::vector<Vertex>& outVertices,
+          std::vector<GLuint>& outIndices,
+          std::vector<Submesh>& outSubmeshes,
+          std::vector<std::byte>& outTextureLayers)
+{
+    PROFILE_SCOPE("gltf::load");
+    const std::string path = filePath.string();
+    // Binary chunk of GLB files is referred to by parsed data, so the file
+    // outlives it. External buffers are resolved relative to the path as
+    // loose files.
+    const std::optional<AssetData> file = assetfs::readFile(filePath);
+    const cgltf_options parseOptions{};
+    cgltf_data* parsedData = nullptr;
+    if (!file
+        || cgltf_parse(&parseOptions,
+                       file->bytes().data(),
+                       file->bytes().size(),
+                       &parsedData)
+               != cgltf_result_success)
+    {
+        utils::showErrorMessage("unable to parse glTF file at ", filePath);
+        return false;
+    }
+    const std::unique_ptr<cgltf_data, decltype(&cgltf_free)> data(parsedData,
+                                                                 cgltf_free);
+    if (cgltf_load_buffers(&parseOptions, data.get(), path.c_str())
+            != cgltf_result_success
+        || cgltf_validate(data.get()) != cgltf_result_success)
+    {
+        utils::showErrorMessage("unable to load buffers of glTF file at ",
+                                filePath);
+        return false;
+    }
+
+    // Compressed buffer views are decoded up front, so that accessors read
+    // decoded data through cgltf as if it was never compressed
+    std::vector<cgltf_buffer_view*> compressedViews;
+    for (size_t i = 0; i < data->buffer_views_count; ++i)
+    {
+        if (data->buffer_views[i].has_meshopt_compression)
+        {
+            compressedViews.push_back(&data->buffer_views[i]);
+        }
+    }
+    std::atomic<bool> failed{false};
+    forEachItem(threadPool,
+                compressedViews.size(),
+                [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        if (!decodeMeshoptView(*compressedViews[i]))
+                        {
+                            failed.store(true, std::memory_order_relaxed);
+                        }
+                    }
+                });
+    if (failed)
+    {
+        utils::showErrorMessage("unable to decode meshopt compressed buffer "
+                                "of glTF file at ",
+                                filePath);
+        return false;
+    }
+
+    // Triangle primitives of every mesh are numbered in mesh order. Points,
+    // lines, strips and fans are skipped.
+    std::vector<size_t> firstSources(data->meshes_count);
+    std::vector<const cgltf_primitive*> primitives;
+    for (size_t i = 0; i < data->meshes_count; ++i)
+    {
+        firstSources[i] = primitives.size();
+        const cgltf_mesh& mesh = data->meshes[i];
+        for (size_t j = 0; j < mesh.primitives_count; ++j)
+        {
+            const cgltf_primitive& primitive = mesh.primitives[j];
+            if (primitive.type != cgltf_primitive_type_triangles)
+            {
+                continue;
+            }
+#ifndef DRACO_ENABLED
+            if (primitive.has_draco_mesh_compression)
+            {
+                utils::showErrorMessage(
+                    "glTF file at ",
+                    filePath,
+                    " uses Draco compression, which requires building with "
+                    "BUILD_DRACO");
+                return false;
+            }
+#endif
+            primitives.push_back(&primitive);
+        }
+    }
+    std::vector<PrimitiveSource> sources(primitives.size());
+    forEachItem(threadPool,
+                primitives.size(),
+                [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        if (!prepareSource(*data, *primitives[i], sources[i]))
+                        {
+                            failed.store(true, std::memory_order_relaxed);
+                        }
+                    }
+                });
+    if (failed)
+    {
+        utils::showErrorMessage("unable to read primitive of glTF file at ",
+                                filePath);
+        return false;
+    }
+
+    // Every image used as base color texture of a primitive with texture
+    // coordinates becomes a layer, shared by the primitives using it
+    std::vector<std::int32_t> imageLayers(data->images_count,
+                                          NO_TEXTURE_LAYER);
+    std::vector<const cgltf_image*> layerImages;
+    for (size_t i = 0; i < primitives.size(); ++i)
+    {
+        const cgltf_image* image = getBaseColorImage(*primitives[i]);
+        if (!image || !sources[i].hasTexCoords)
+        {
+            continue;
+        }
+        std::int32_t& layer
+            = imageLayers[static_cast<size_t>(image - data->images)];
+        if (layer == NO_TEXTURE_LAYER)
+        {
+            layer = static_cast<std::int32_t>(layerImages.size());
+            layerImages.push_back(image);
+        }
+    }
+    outTextureLayers.assign(layerImages.size()
+                                * materialtexture::LAYER_BYTE_SIZE,
+                            std::byte{0});
+    forEachItem(
+        threadPool,
+        layerImages.size(),
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const std::optional<std::vector<std::byte>> encoded
+                    = readImage(*layerImages[i], filePath);
+                const bool decoded = materialtexture::decodeLayer(
+                    encoded ? std::span<const std::byte>{*encoded}
+                            : std::span<const std::byte>{},
+                    std::span{outTextureLayers}.subspan(
+                        i * materialtexture::LAYER_BYTE_SIZE,
+                        materialtexture::LAYER_BYTE_SIZE));
+                if (!decoded)
+                {
+                    utils::logWarning("unable to read texture image ",
+                                      layerImages[i] - data->images,
+                                      " of glTF file at ",
+                                      filePath);
+                }
+            }
+        });
+    const auto getTextureLayer = [&](size_t sourceIndex)
+    {
+        const cgltf_image* image
+            = getBaseColorImage(*primitives[sourceIndex]);
+        return image && sources[sourceIndex].hasTexCoords
+                 ? imageLayers[static_cast<size_t>(image - data->images)]
+                 : NO_TEXTURE_LAYER;
+    };
+
+    // Meshes are placed by nodes with their world transform. Files without
+    // nodes referring to meshes get each mesh once, untransformed.
+    std::vector<PrimitiveInstance> instances;
+    const auto addMeshInstances = [&](const cgltf_mesh& mesh,
+                                      const glm::mat4& transform)
+    {
+        const auto meshIndex = static_cast<size_t>(&mesh - data->meshes);
+        const size_t firstSource = firstSources[meshIndex];
+        const size_t endSource = meshIndex + 1 < data->meshes_count
+                                   ? firstSources[meshIndex + 1]
+                                   : sources.size();
+        for (size_t i = firstSource; i < endSource; ++i)
+        {
+            instances.push_back({.sourceIndex = i, .transform = transform});
+        }
+    };
+    for (size_t i = 0; i < data->nodes_count; ++i)
+    {
+        const cgltf_node& node = data->nodes[i];
+        if (node.mesh)
+        {
+            cgltf_float worldMatrix[16];
+            cgltf_node_transform_world(&node, worldMatrix);
+            addMeshInstances(*node.mesh, glm::make_mat4(worldMatrix));
+        }
+    }
+    if (instances.empty())
+    {
+        for (size_t i = 0; i < data->meshes_count; ++i)
+        {
+            addMeshInstances(data->meshes[i], glm::mat4{1.0F});
+        }
+    }
+
+    // Counting pass sizes output arrays exactly once, so that instances can
+    // be copied into their ranges in parallel
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    outSubmeshes.clear();
+    outSubmeshes.reserve(instances.size());
+    for (const PrimitiveInstance& instance : instances)
+    {
+        const PrimitiveSource& source = sources[instance.sourceIndex];
+        const bool flatNormals = !source.hasNormals && !options.smoothNormals;
+        outSubmeshes.push_back({
+            .firstIndex = static_cast<GLuint>(indexCount),
+            .indexCount = static_cast<GLuint>(source.indexCount),
+            .baseVertex = static_cast<GLint>(vertexCount),
+            .firstMeshlet = 0,
+            .meshletCount = 0,
+            .firstLod = 0,
+            .lodCount = 0,
+            .baseColor = getBaseColor(*primitives[instance.sourceIndex]),
+            .opacity = getOpacity(*primitives[instance.sourceIndex]),
+            .textureLayer = getTextureLayer(instance.sourceIndex),
+        });
+        vertexCount += flatNormals ? source.indexCount : source.vertexCount;
+        indexCount += source.indexCount;
+    }
+    outVertices.resize(vertexCount);
+    outIndices.resize(indexCount);
+
+    forEachItem(
+        threadPool,
+        instances.size(),
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const Submesh& submesh = outSubmeshes[i];
+                const size_t submeshEnd
+                    = i + 1 < outSubmeshes.size()
+                        ? static_cast<size_t>(outSubmeshes[i + 1].baseVertex)
+                        : outVertices.size();
+                const bool copied = copyInstance(
+                    sources[instances[i].sourceIndex],
+                    instances[i].transform,
+                    options.smoothNormals,
+                    threadPool,
+                    std::span{outVertices}.subspan(
+                        static_cast<size_t>(submesh.baseVertex),
+                        submeshEnd - static_cast<size_t>(submesh.baseVertex)),
+                    std::span{outIndices}.subspan(submesh.firstIndex,
+                                                  submesh.indexCount));
+                if (!copied)
+                {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        });
+    if (failed)
+    {
+        utils::showErrorMessage("glTF file at ",
+                                filePath,
+                                " has primitive with indices out of range");
+        return false;
+    }
+
+    return true;
+}
+}  // namespace gltf
@@ -0,0 +1,40 @@
+#ifndef GLTF_LOADER_H_
+#define GLTF_LOADER_H_
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+class ThreadPool;
+
+/// Native import of glTF 2.0 files, both JSON with separate buffers and
+/// binary GLB, bypassing Assimp.
+///
+/// Binary buffers are read as they are, and accessors are mapped into the
+/// vertex layout directly. Buffer views compressed with EXT_meshopt_compression
+/// are decoded in parallel, as are primitives compressed with
+/// KHR_draco_mesh_compression when built with Draco support. Every mesh
+/// instance of the node hierarchy becomes a sub-mesh, with the world
+/// transform of its node applied to its vertices.
+namespace gltf
+{
+/// File is glTF by its extension.
+bool isGltfFile(const std::filesystem::path& filePath);
+
+/// Read triangle primitives into merged vertex and index arrays, with indices
+/// of each sub-mesh relative to its base vertex. Buffer views and primitives
+/// are decoded, and primitives copied on the thread pool when given. Normals
+/// missing from the file are generated as import options ask for. Base color
+/// textures are decoded into texture layers, which sub-meshes refer to.
+bool load(const std::filesystem::path& filePath,
+          const ImportOptions& options,
+          ThreadPool* threadPool,
+          std::vector<Vertex>& outVertices,
+          std::vector<GLuint>& outIndices,
+          std::vector<Submesh>& outSubmeshes,
+          std::vector<std::byte>& outTextureLayers);
+}  // namespace gltf
+
+#endif
@@ -0,0 +1,378 @@
+#include "gpuculler.h"
+
+#include "videomemory.h"
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Work group sizes declared by the compute shaders.
+constexpr GLuint CULL_GROUP_SIZE = 64;
+constexpr GLuint DEPTH_PYRAMID_GROUP_SIZE = 8;
+
+/// Shader storage buffer bindings of the culling shader. Draw data binding is
+/// shared with the indirect model shader.
+constexpr GLuint DRAW_DATA_BINDING = 0;
+constexpr GLuint INPUT_COMMAND_BINDING = 1;
+constexpr GLuint OUTPUT_COMMAND_BINDING = 2;
+constexpr GLuint DRAW_COUNT_BINDING = 3;
+
+GLuint getGroupCount(GLuint invocationCount, GLuint groupSize)
+{
+    return (invocationCount + groupSize - 1) / groupSize;
+}
+}  // namespace
+
+GpuCuller::PendingShaders GpuCuller::submitShaders()
+{
+    return {
+        .cullShader = Shader::submitComputeFromFile(
+            fs::path{"assets/shaders/cull_gl4.comp.glsl"}),
+        .depthPyramidShader = Shader::submitComputeFromFile(
+            fs::path{"assets/shaders/hiz_gl4.comp.glsl"}),
+    };
+}
+
+std::optional<GpuCuller> GpuCuller::create(PendingShaders&& shaders)
+{
+    std::optional<Shader> cullShader = shaders.cullShader.finish();
+    if (!cullShader)
+    {
+        return std::nullopt;
+    }
+    std::optional<Shader> depthPyramidShader
+        = shaders.depthPyramidShader.finish();
+    if (!depthPyramidShader)
+    {
+        return std::nullopt;
+    }
+    return GpuCuller{std::move(cullShader.value()),
+                     std::move(depthPyramidShader.value())};
+}
+
+GpuCuller::GpuCuller(Shader&& cullShader, Shader&& depthPyramidShader)
+    : cullShader_{std::move(cullShader)}
+    , depthPyramidShader_{std::move(depthPyramidShader)}
+    , outputCommandBuffer_{0}
+    , drawCountBuffer_{0}
+    , commandCount_{0}
+    , depthTexture_{0}
+    , depthPyramidTexture_{0}
+    , frameBufferWidth_{0}
+    , frameBufferHeight_{0}
+    , depthPyramidLevelCount_{0}
+    , depthVideoMemorySize_{0}
+    , depthPyramidValid_{false}
+    , commandCountUniform_{cullShader_.getUniformHandle<int>("u_commandCount")}
+    , drawsPerObjectUniform_{
+          cullShader_.getUniformHandle<int>("u_drawsPerObject")}
+    , viewProjectionUniform_{
+          cullShader_.getUniformHandle<glm::mat4>("u_viewProjection")}
+    , occlusionEnabledUniform_{
+          cullShader_.getUniformHandle<bool>("u_occlusionEnabled")}
+    , hiZUniform_{cullShader_.getUniformHandle<int>("u_hiZ")}
+    , hiZLevelCountUniform_{
+          cullShader_.getUniformHandle<int>("u_hiZLevelCount")}
+    , viewportWidthUniform_{
+          cullShader_.getUniformHandle<int>("u_viewportWidth")}
+    , viewportHeightUniform_{
+          cullShader_.getUniformHandle<int>("u_viewportHeight")}
+    , sourceUniform_{depthPyramidShader_.getUniformHandle<int>("u_source")}
+    , sourceLevelUniform_{
+          depthPyramidShader_.getUniformHandle<int>("u_sourceLevel")}
+{
+    glGenBuffers(1, &outputCommandBuffer_);
+    glGenBuffers(1, &drawCountBuffer_);
+}
+
+GpuCuller::GpuCuller(GpuCuller&& other) noexcept
+    : cullShader_{std::move(other.cullShader_)}
+    , depthPyramidShader_{std::move(other.depthPyramidShader_)}
+    , outputCommandBuffer_{std::exchange(other.outputCommandBuffer_, 0)}
+    , drawCountBuffer_{std::exchange(other.drawCountBuffer_, 0)}
+    , commandCount_{std::exchange(other.commandCount_, 0)}
+    , depthTexture_{std::exchange(other.depthTexture_, 0)}
+    , depthPyramidTexture_{std::exchange(other.depthPyramidTexture_, 0)}
+    , frameBufferWidth_{std::exchange(other.frameBufferWidth_, 0)}
+    , frameBufferHeight_{std::exchange(other.frameBufferHeight_, 0)}
+    , depthPyramidLevelCount_{std::exchange(other.depthPyramidLevelCount_, 0)}
+    , depthVideoMemorySize_{std::exchange(other.depthVideoMemorySize_, 0)}
+    , depthPyramidValid_{std::exchange(other.depthPyramidValid_, false)}
+    , commandCountUniform_{other.commandCountUniform_}
+    , drawsPerObjectUniform_{other.drawsPerObjectUniform_}
+    , viewProjectionUniform_{other.viewProjectionUniform_}
+    , occlusionEnabledUniform_{other.occlusionEnabledUniform_}
+    , hiZUniform_{other.hiZUniform_}
+    , hiZLevelCountUniform_{other.hiZLevelCountUniform_}
+    , viewportWidthUniform_{other.viewportWidthUniform_}
+    , viewportHeightUniform_{other.viewportHeightUniform_}
+    , sourceUniform_{other.sourceUniform_}
+    , sourceLevelUniform_{other.sourceLevelUniform_}
+{
+}
+
+GpuCuller& GpuCuller::operator=(GpuCuller&& other) noexcept
+{
+    std::swap(cullShader_, other.cullShader_);
+    std::swap(depthPyramidShader_, other.depthPyramidShader_);
+    std::swap(outputCommandBuffer_, other.outputCommandBuffer_);
+    std::swap(drawCountBuffer_, other.drawCountBuffer_);
+    std::swap(commandCount_, other.commandCount_);
+    std::swap(depthTexture_, other.depthTexture_);
+    std::swap(depthPyramidTexture_, other.depthPyramidTexture_);
+    std::swap(frameBufferWidth_, other.frameBufferWidth_);
+    std::swap(frameBufferHeight_, other.frameBufferHeight_);
+    std::swap(depthPyramidLevelCount_, other.depthPyramidLevelCount_);
+    std::swap(depthVideoMemorySize_, other.depthVideoMemorySize_);
+    std::swap(depthPyramidValid_, other.depthPyramidValid_);
+    std::swap(commandCountUniform_, other.commandCountUniform_);
+    std::swap(drawsPerObjectUniform_, other.drawsPerObjectUniform_);
+    std::swap(viewProjectionUniform_, other.viewProjectionUniform_);
+    std::swap(occlusionEnabledUniform_, other.occlusionEnabledUniform_);
+    std::swap(hiZUniform_, other.hiZUniform_);
+    std::swap(hiZLevelCountUniform_, other.hiZLevelCountUniform_);
+    std::swap(viewportWidthUniform_, other.viewportWidthUniform_);
+    std::swap(viewportHeightUniform_, other.viewportHeightUniform_);
+    std::swap(sourceUniform_, other.sourceUniform_);
+    std::swap(sourceLevelUniform_, other.sourceLevelUniform_);
+    return *this;
+}
+
+GpuCuller::~GpuCuller()
+{
+    glDeleteBuffers(1, &outputCommandBuffer_);
+    glDeleteBuffers(1, &drawCountBuffer_);
+    glDeleteTextures(1, &depthTexture_);
+    glDeleteTextures(1, &depthPyramidTexture_);
+    videomemory::release(videomemory::Category::RenderTarget,
+                         depthVideoMemorySize_);
+}
+
+void GpuCuller::cull(const StreamBuffer::Range& commands,
+                     GLsizei commandCount,
+                     GLuint drawDataBuffer,
+                     GLsizeiptr drawDataSize,
+                     const glm::mat4& viewProjection,
+                     GLsizei drawsPerObject,
+                     bool occlusionEnabled,
+                     GlStateCache& glState)
+{
+    commandCount_ = commandCount;
+    const auto commandsSize
+        = static_cast<GLsizeiptr>(commandCount)
+        * static_cast<GLsizeiptr>(sizeof(DrawElementsIndirectCommand));
+
+    // Input is read where the renderer wrote it. Output buffers are orphaned
+    // on every cull, and output is cleared, so that commands past the visible
+    // ones draw nothing.
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                      INPUT_COMMAND_BINDING,
+                      commands.buffer,
+                      commands.offset,
+                      commandsSize);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                     OUTPUT_COMMAND_BINDING,
+                     outputCommandBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 commandsSize,
+                 nullptr,
+                 GL_STREAM_DRAW);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER,
+                      GL_R32UI,
+                      GL_RED_INTEGER,
+                      GL_UNSIGNED_INT,
+                      nullptr);
+    constexpr GLuint zeroDrawCount = 0;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                     DRAW_COUNT_BINDING,
+                     drawCountBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 sizeof(zeroDrawCount),
+                 &zeroDrawCount,
+                 GL_STREAM_DRAW);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                      DRAW_DATA_BINDING,
+                      drawDataBuffer,
+                      0,
+                      drawDataSize);
+
+    cullShader_.use(glState);
+    cullShader_.setUniform(commandCountUniform_, commandCount);
+    cullShader_.setUniform(drawsPerObjectUniform_, drawsPerObject);
+    cullShader_.setUniform(viewProjectionUniform_, viewProjection);
+    const bool occlusionTested = occlusionEnabled && depthPyramidValid_;
+    cullShader_.setUniform(occlusionEnabledUniform_, occlusionTested);
+    if (occlusionTested)
+    {
+        constexpr int textureUnit = 0;
+        glState.bindTexture(textureUnit, GL_TEXTURE_2D, depthPyramidTexture_);
+        cullShader_.setUniform(hiZUniform_, textureUnit);
+        cullShader_.setUniform(hiZLevelCountUniform_, depthPyramidLevelCount_);
+        cullShader_.setUniform(viewportWidthUniform_, frameBufferWidth_);
+        cullShader_.setUniform(viewportHeightUniform_, frameBufferHeight_);
+    }
+    glDispatchCompute(
+        getGroupCount(static_cast<GLuint>(commandCount), CULL_GROUP_SIZE),
+        1,
+        1);
+    // Draw commands and count are read by the draw call, not by shaders
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void GpuCuller::drawVisible()
+{
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, outputCommandBuffer_);
+    if (GLAD_GL_ARB_indirect_parameters)
+    {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, drawCountBuffer_);
+        glMultiDrawElementsIndirectCountARB(
+            GL_TRIANGLES,
+            GL_UNSIGNED_INT,
+            nullptr,
+            0,
+            commandCount_,
+            0);
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    }
+    else
+    {
+        glMultiDrawElementsIndirect(GL_TRIANGLES,
+                                    GL_UNSIGNED_INT,
+                                    nullptr,
+                                    commandCount_,
+                                    0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GpuCuller::updateDepthPyramid(int frameBufferWidth,
+                                   int frameBufferHeight,
+                                   GlStateCache& glState)
+{
+    // Pyramid starts at half resolution, so a single pixel framebuffer has
+    // nothing to reduce
+    if (frameBufferWidth < 2 || frameBufferHeight < 2)
+    {
+        depthPyramidValid_ = false;
+        return;
+    }
+    if (frameBufferWidth != frameBufferWidth_
+        || frameBufferHeight != frameBufferHeight_)
+    {
+        resizeDepthPyramid(frameBufferWidth, frameBufferHeight, glState);
+    }
+
+    // Depth renderbuffer of the bound framebuffer can not be sampled, so it
+    // is copied into a depth texture first
+    constexpr int textureUnit = 0;
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, depthTexture_);
+    glCopyTexSubImage2D(GL_TEXTURE_2D,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        frameBufferWidth,
+                        frameBufferHeight);
+
+    depthPyramidShader_.use(glState);
+    depthPyramidShader_.setUniform(sourceUniform_, textureUnit);
+    int destinationWidth = frameBufferWidth / 2;
+    int destinationHeight = frameBufferHeight / 2;
+    for (int level = 0; level < depthPyramidLevelCount_; ++level)
+    {
+        // First level reduces the depth copy, the rest the level before them
+        if (level == 0)
+        {
+            depthPyramidShader_.setUniform(sourceLevelUniform_, 0);
+        }
+        else
+        {
+            glState.bindTexture(textureUnit,
+                                GL_TEXTURE_2D,
+                                depthPyramidTexture_);
+            depthPyramidShader_.setUniform(sourceLevelUniform_, level - 1);
+        }
+        glBindImageTexture(0,
+                           depthPyramidTexture_,
+                           level,
+                           GL_FALSE,
+                           0,
+                           GL_WRITE_ONLY,
+                           GL_R32F);
+        glDispatchCompute(
+            getGroupCount(static_cast<GLuint>(destinationWidth),
+                          DEPTH_PYRAMID_GROUP_SIZE),
+            getGroupCount(static_cast<GLuint>(destinationHeight),
+                          DEPTH_PYRAMID_GROUP_SIZE),
+            1);
+        // Next level samples the one just written
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        destinationWidth = std::max(destinationWidth / 2, 1);
+        destinationHeight = std::max(destinationHeight / 2, 1);
+    }
+    depthPyramidValid_ = true;
+}
+
+void GpuCuller::resizeDepthPyramid(int frameBufferWidth,
+                                   int frameBufferHeight,
+                                   GlStateCache& glState)
+{
+    frameBufferWidth_ = frameBufferWidth;
+    frameBufferHeight_ = frameBufferHeight;
+    const int width = frameBufferWidth / 2;
+    const int height = frameBufferHeight / 2;
+    depthPyramidLevelCount_ = std::bit_width(
+        static_cast<unsigned int>(std::max(width, height)));
+
+    // Immutable storage can not be resized, so textures are recreated. Unbound
+    // first, because new textures may reuse the names of deleted ones still
+    // tracked as bound.
+    constexpr int textureUnit = 0;
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &depthTexture_);
+    glDeleteTextures(1, &depthPyramidTexture_);
+
+    glGenTextures(1, &depthTexture_);
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, depthTexture_);
+    glTexStorage2D(GL_TEXTURE_2D,
+                   1,
+                   GL_DEPTH_COMPONENT24,
+                   frameBufferWidth,
+                   frameBufferHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &depthPyramidTexture_);
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, depthPyramidTexture_);
+    glTexStorage2D(GL_TEXTURE_2D,
+                   depthPyramidLevelCount_,
+                   GL_R32F,
+                   width,
+                   height);
+    glTexParameteri(GL_TEXTURE_2D,
+                    GL_TEXTURE_MIN_FILTER,
+                    GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Texels of both formats take 4 bytes
+    videomemory::release(videomemory::Category::RenderTarget,
+                         depthVideoMemorySize_);
+    depthVideoMemorySize_ = static_cast<size_t>(frameBufferWidth)
+                          * static_cast<size_t>(frameBufferHeight) * 4;
+    for (int level = 0; level < depthPyramidLevelCount_; ++level)
+    {
+        const auto levelWidth
+            = static_cast<size_t>(std::max(width >> level, 1));
+        const auto levelHeight
+            = static_cast<size_t>(std::max(height >> level, 1));
+        depthVideoMemorySize_ += levelWidth * levelHeight * 4;
+    }
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          depthVideoMemorySize_);
+}
@@ -0,0 +1,111 @@
+#ifndef GPU_CULLER_H_
+#define GPU_CULLER_H_
+
+#include "geometryarena.h"
+#include "glstatecache.h"
+#include "shader.h"
+#include "streambuffer.h"
+
+#include "glad/gl.h"
+#include "glm/mat4x4.hpp"
+
+#include <optional>
+
+/// Compute shader pass discarding indirect draw commands of objects outside of
+/// the view frustum or hidden behind geometry drawn in the previous frame,
+/// keeping the cost of culling off the CPU however many objects are drawn.
+///
+/// Occlusion is tested against a hierarchical depth pyramid (Hi-Z) built from
+/// the depth buffer at the end of each frame. Each texel holds the farthest
+/// depth of the area it covers, so an object is hidden when its nearest depth
+/// lies behind the farthest depth of every texel its screen rectangle touches.
+/// Objects revealed by camera movement may appear one frame late.
+///
+/// Visible commands are compacted to the front of the draw buffer. The draw
+/// count is read from GPU memory when ARB_indirect_parameters is available,
+/// otherwise all commands are submitted, leaving culled ones empty.
+///
+/// Non-copyable, move-only. Compute shaders are only supported from OpenGL
+/// 4.3+ and are not available in OpenGL ES 3.0.
+class GpuCuller
+{
+public:
+    /// Culling and depth pyramid compute shaders submitted for compilation.
+    struct PendingShaders
+    {
+        PendingShader cullShader;
+        PendingShader depthPyramidShader;
+    };
+
+    /// Submit compute shaders for compilation without waiting for the driver
+    /// to finish.
+    static PendingShaders submitShaders();
+
+    /// Factory method finishing compilation of submitted compute shaders.
+    static std::optional<GpuCuller> create(PendingShaders&& shaders);
+
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+    GpuCuller(GpuCuller&& other) noexcept;
+    GpuCuller& operator=(GpuCuller&& other) noexcept;
+    ~GpuCuller();
+
+    /// Cull commands of given range, compacting the visible ones into the
+    /// draw buffer. Commands refer to their per-draw data by base instance
+    /// divided by draws per object, which is read from the draw data buffer
+    /// for their model matrix. Leaves the culling shader bound.
+    void cull(const StreamBuffer::Range& commands,
+              GLsizei commandCount,
+              GLuint drawDataBuffer,
+              GLsizeiptr drawDataSize,
+              const glm::mat4& viewProjection,
+              GLsizei drawsPerObject,
+              bool occlusionEnabled,
+              GlStateCache& glState);
+
+    /// Draw commands left visible by the last cull with the shader and vertex
+    /// array currently bound.
+    void drawVisible();
+
+    /// Rebuild depth pyramid from the depth buffer of the bound framebuffer,
+    /// covering its bottom-left rectangle of given size, to be used for
+    /// occlusion culling in the next frame.
+    void updateDepthPyramid(int frameBufferWidth,
+                            int frameBufferHeight,
+                            GlStateCache& glState);
+
+private:
+    GpuCuller(Shader&& cullShader, Shader&& depthPyramidShader);
+
+    /// Recreate depth textures when framebuffer size changes.
+    void resizeDepthPyramid(int frameBufferWidth,
+                            int frameBufferHeight,
+                            GlStateCache& glState);
+
+    Shader cullShader_;
+    Shader depthPyramidShader_;
+    GLuint outputCommandBuffer_;
+    GLuint drawCountBuffer_;
+    GLsizei commandCount_;
+    GLuint depthTexture_;
+    GLuint depthPyramidTexture_;
+    int frameBufferWidth_;
+    int frameBufferHeight_;
+    int depthPyramidLevelCount_;
+    /// Video memory taken by depth textures in bytes.
+    size_t depthVideoMemorySize_;
+    /// Depth pyramid is undefined until the first frame finished.
+    bool depthPyramidValid_;
+    UniformHandle<int> commandCountUniform_;
+    UniformHandle<int> drawsPerObjectUniform_;
+    UniformHandle<glm::mat4> viewProjectionUniform_;
+    UniformHandle<bool> occlusionEnabledUniform_;
+    UniformHandle<int> hiZUniform_;
+    UniformHandle<int> hiZLevelCountUniform_;
+    UniformHandle<int> viewportWidthUniform_;
+    UniformHandle<int> viewportHeightUniform_;
+    UniformHandle<int> sourceUniform_;
+    UniformHandle<int> sourceLevelUniform_;
+};
+
+#endif
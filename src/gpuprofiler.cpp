@@ -0,0 +1,308 @@
+#include "gpuprofiler.h"
+
+#ifdef __EMSCRIPTEN__
+#include <GLFW/glfw3.h>  // Use GLFW port from Emscripten
+#include <emscripten/html5.h>
+#endif
+
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+#ifdef __EMSCRIPTEN__
+constexpr GLenum TIME_ELAPSED = GL_TIME_ELAPSED_EXT;
+#else
+constexpr GLenum TIME_ELAPSED = GL_TIME_ELAPSED;
+#endif
+/// Weight of the latest frame in averaged pass times. Smooths out noise of
+/// individual frames while following changes within a second.
+constexpr float AVERAGE_WEIGHT = 0.05F;
+
+#ifndef __EMSCRIPTEN__
+// Order matches members of pipeline statistics
+constexpr std::array<GLenum, 4> STATISTIC_TARGETS{
+    GL_VERTEX_SHADER_INVOCATIONS_ARB,
+    GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+    GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB};
+constexpr std::array STATISTIC_MEMBERS{
+    &GpuProfiler::PipelineStatistics::vertexShaderInvocations,
+    &GpuProfiler::PipelineStatistics::clippingInputPrimitives,
+    &GpuProfiler::PipelineStatistics::clippingOutputPrimitives,
+    &GpuProfiler::PipelineStatistics::fragmentShaderInvocations};
+#endif
+}  // namespace
+
+GpuProfiler::GpuProfiler()
+    : supported_{false}
+    , pipelineStatisticsSupported_{false}
+    , pipelineStatisticsEnabled_{false}
+    , frames_{}
+    , firstPending_{0}
+    , pendingCount_{0}
+    , measuring_{false}
+    , queryActive_{false}
+    , statisticsActive_{false}
+    , latestFrame_{std::nullopt}
+    , latestGpuFrameTime_{0.0F}
+    , averageGpuPassTimes_{}
+    , activePass_{std::nullopt}
+    , passBegin_{}
+    , cpuPassTimes_{}
+    , averageCpuPassTimes_{}
+    , totals_{}
+    , latestPipelineStatistics_{}
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (Frame& frame : frames_)
+    {
+        if (frame.queries[0])
+        {
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()),
+                            frame.queries.data());
+        }
+        if (frame.statisticsQueries[0])
+        {
+            glDeleteQueries(
+                static_cast<GLsizei>(frame.statisticsQueries.size()),
+                frame.statisticsQueries.data());
+        }
+    }
+}
+
+void GpuProfiler::init()
+{
+#ifdef __EMSCRIPTEN__
+    // WebGL extensions have to be enabled before use. glad does not detect
+    // the extension under its WebGL name, so the only function missing from
+    // WebGL 2 is loaded here.
+    supported_ = emscripten_webgl_enable_extension(
+        emscripten_webgl_get_current_context(),
+        "EXT_disjoint_timer_query_webgl2");
+    if (supported_)
+    {
+        glad_glGetQueryObjectui64vEXT
+            = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+                glfwGetProcAddress("glGetQueryObjectui64vEXT"));
+        supported_ = glad_glGetQueryObjectui64vEXT != nullptr;
+    }
+#else
+    supported_ = true;
+    pipelineStatisticsSupported_ = GLAD_GL_ARB_pipeline_statistics_query != 0;
+#endif
+}
+
+void GpuProfiler::beginFrame()
+{
+    if (!supported_)
+    {
+        return;
+    }
+#ifdef __EMSCRIPTEN__
+    // Results are meaningless when the GPU was interrupted, for example by
+    // power saving
+    GLint disjoint = GL_FALSE;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint)
+    {
+        firstPending_ = (firstPending_ + pendingCount_) % FRAME_COUNT;
+        pendingCount_ = 0;
+    }
+#endif
+
+    // Frames finish in submission order, so reading stops at the first one
+    // still in flight. The last queries of a frame finish after the others.
+    while (pendingCount_ > 0)
+    {
+        const Frame& frame = frames_[firstPending_];
+        if (frame.queryCount > 0)
+        {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(frame.queries[frame.queryCount - 1],
+                                GL_QUERY_RESULT_AVAILABLE,
+                                &available);
+            if (available && frame.statisticsCounted)
+            {
+                glGetQueryObjectuiv(
+                    frame.statisticsQueries[frame.queryCount * STATISTIC_COUNT
+                                            - 1],
+                    GL_QUERY_RESULT_AVAILABLE,
+                    &available);
+            }
+            if (!available)
+            {
+                break;
+            }
+            readFrame(frame);
+        }
+        firstPending_ = (firstPending_ + 1) % FRAME_COUNT;
+        --pendingCount_;
+    }
+
+    measuring_ = pendingCount_ < FRAME_COUNT;
+    if (measuring_)
+    {
+        Frame& frame = frames_[(firstPending_ + pendingCount_) % FRAME_COUNT];
+        if (!frame.queries[0])
+        {
+            glGenQueries(static_cast<GLsizei>(frame.queries.size()),
+                         frame.queries.data());
+        }
+        frame.queryCount = 0;
+        frame.statisticsCounted = pipelineStatisticsEnabled_;
+        if (frame.statisticsCounted && !frame.statisticsQueries[0])
+        {
+            glGenQueries(static_cast<GLsizei>(frame.statisticsQueries.size()),
+                         frame.statisticsQueries.data());
+        }
+    }
+}
+
+void GpuProfiler::endFrame()
+{
+    endPass();
+    for (size_t i = 0; i < PASS_COUNT; ++i)
+    {
+        averageCpuPassTimes_[i] = std::lerp(averageCpuPassTimes_[i],
+                                            cpuPassTimes_[i],
+                                            AVERAGE_WEIGHT);
+        totals_.cpuPassTimes[i] += cpuPassTimes_[i];
+    }
+    ++totals_.cpuFrameCount;
+    cpuPassTimes_ = {};
+    if (measuring_)
+    {
+        ++pendingCount_;
+        measuring_ = false;
+    }
+}
+
+void GpuProfiler::beginPass(GpuPass pass)
+{
+    endPass();
+    activePass_ = pass;
+    passBegin_ = std::chrono::steady_clock::now();
+    if (!measuring_)
+    {
+        return;
+    }
+    Frame& frame = frames_[(firstPending_ + pendingCount_) % FRAME_COUNT];
+    // Passes beyond the query budget of the frame are left unmeasured
+    if (frame.queryCount == QUERIES_PER_FRAME)
+    {
+        return;
+    }
+    frame.passes[frame.queryCount] = pass;
+    glBeginQuery(TIME_ELAPSED, frame.queries[frame.queryCount]);
+#ifndef __EMSCRIPTEN__
+    if (frame.statisticsCounted)
+    {
+        for (size_t i = 0; i < STATISTIC_COUNT; ++i)
+        {
+            glBeginQuery(
+                STATISTIC_TARGETS[i],
+                frame.statisticsQueries[frame.queryCount * STATISTIC_COUNT
+                                        + i]);
+        }
+        statisticsActive_ = true;
+    }
+#endif
+    ++frame.queryCount;
+    queryActive_ = true;
+}
+
+void GpuProfiler::endPass()
+{
+    if (queryActive_)
+    {
+        glEndQuery(TIME_ELAPSED);
+        queryActive_ = false;
+    }
+#ifndef __EMSCRIPTEN__
+    if (statisticsActive_)
+    {
+        for (const GLenum target : STATISTIC_TARGETS)
+        {
+            glEndQuery(target);
+        }
+        statisticsActive_ = false;
+    }
+#endif
+    if (activePass_)
+    {
+        cpuPassTimes_[static_cast<size_t>(activePass_.value())]
+            += std::chrono::duration<float, std::milli>(
+                   std::chrono::steady_clock::now() - passBegin_)
+                   .count();
+        activePass_.reset();
+    }
+}
+
+std::optional<GpuProfiler::PassTimes> GpuProfiler::takeLatestFrame()
+{
+    return std::exchange(latestFrame_, std::nullopt);
+}
+
+void GpuProfiler::readFrame(const Frame& frame)
+{
+    PassTimes passTimes{};
+    for (size_t i = 0; i < frame.queryCount; ++i)
+    {
+        GLuint64 elapsedNanoseconds = 0;
+#ifdef __EMSCRIPTEN__
+        glGetQueryObjectui64vEXT(frame.queries[i],
+                                 GL_QUERY_RESULT,
+                                 &elapsedNanoseconds);
+#else
+        glGetQueryObjectui64v(frame.queries[i],
+                              GL_QUERY_RESULT,
+                              &elapsedNanoseconds);
+#endif
+        passTimes[static_cast<size_t>(frame.passes[i])]
+            += static_cast<float>(elapsedNanoseconds) * 1e-6F;
+    }
+    for (size_t i = 0; i < PASS_COUNT; ++i)
+    {
+        averageGpuPassTimes_[i]
+            = std::lerp(averageGpuPassTimes_[i], passTimes[i], AVERAGE_WEIGHT);
+        totals_.gpuPassTimes[i] += passTimes[i];
+    }
+    ++totals_.gpuFrameCount;
+    latestFrame_ = passTimes;
+    latestGpuFrameTime_ = std::accumulate(passTimes.begin(),
+                                          passTimes.end(),
+                                          0.0F);
+    if (frame.statisticsCounted)
+    {
+        readPipelineStatistics(frame);
+    }
+}
+
+void GpuProfiler::readPipelineStatistics(const Frame& frame)
+{
+#ifndef __EMSCRIPTEN__
+    PassStatistics statistics{};
+    for (size_t i = 0; i < frame.queryCount; ++i)
+    {
+        PipelineStatistics& passStatistics
+            = statistics[static_cast<size_t>(frame.passes[i])];
+        for (size_t j = 0; j < STATISTIC_COUNT; ++j)
+        {
+            GLuint64 count = 0;
+            glGetQueryObjectui64v(
+                frame.statisticsQueries[i * STATISTIC_COUNT + j],
+                GL_QUERY_RESULT,
+                &count);
+            passStatistics.*STATISTIC_MEMBERS[j] += count;
+        }
+    }
+    latestPipelineStatistics_ = statistics;
+#else
+    static_cast<void>(frame);
+#endif
+}
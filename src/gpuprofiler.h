@@ -0,0 +1,201 @@
+#ifndef GPU_PROFILER_H_
+#define GPU_PROFILER_H_
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/// Render passes measured by GPU profiler.
+enum class GpuPass : std::uint8_t
+{
+    Clear,
+    Shadows,
+    AmbientOcclusion,
+    LightAssignment,
+    Models,
+    Skybox,
+    Antialiasing,
+    Bloom,
+    Tonemap,
+    Gui,
+};
+
+/// Measures GPU time taken by each render pass of a frame with timer queries.
+///
+/// Passes are measured between beginPass() and endPass(), one at a time, as
+/// timer queries can not be nested. A pass may be measured several times in a
+/// frame, adding up its times.
+///
+/// Results become available a few frames after submission. Frames are kept in
+/// flight in a ring and read back only once available, so that measuring
+/// never stalls the pipeline. Frames are left unmeasured while every frame of
+/// the ring is in flight.
+///
+/// Timer queries are core in OpenGL 4.3. In WebGL 2 they are provided by
+/// EXT_disjoint_timer_query_webgl2, without which GPU time is not measured.
+/// Queries are created on first use.
+///
+/// CPU time spent issuing each pass is measured along, available right after
+/// the frame ended, telling passes limited by driver overhead apart from
+/// those limited by the GPU.
+///
+/// On desktop, pipeline statistics of each pass are optionally counted along
+/// with time through GL_ARB_pipeline_statistics_query: vertex shader
+/// invocations telling how well the vertex cache is reused, primitives
+/// entering and leaving clipping telling how much culling leaves to the
+/// rasterizer, and fragment shader invocations telling how much overdraw the
+/// depth prepass saves. Non-copyable, non-movable.
+class GpuProfiler
+{
+public:
+    static constexpr size_t PASS_COUNT = 10;
+
+    /// Milliseconds of each pass in a frame, indexed by GpuPass.
+    using PassTimes = std::array<float, PASS_COUNT>;
+
+    /// Work done by the GPU in a pass, counted by pipeline statistics
+    /// queries.
+    struct PipelineStatistics
+    {
+        std::uint64_t vertexShaderInvocations;
+        std::uint64_t clippingInputPrimitives;
+        std::uint64_t clippingOutputPrimitives;
+        std::uint64_t fragmentShaderInvocations;
+    };
+    /// Pipeline statistics of each pass in a frame, indexed by GpuPass.
+    using PassStatistics = std::array<PipelineStatistics, PASS_COUNT>;
+
+    /// Pass times summed over all measured frames. Differences of totals
+    /// taken at two points give exact averages over the frames in between.
+    struct Totals
+    {
+        std::array<double, PASS_COUNT> gpuPassTimes;
+        size_t gpuFrameCount;
+        std::array<double, PASS_COUNT> cpuPassTimes;
+        size_t cpuFrameCount;
+    };
+
+    GpuProfiler();
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+    GpuProfiler(GpuProfiler&&) = delete;
+    GpuProfiler& operator=(GpuProfiler&&) = delete;
+    ~GpuProfiler();
+
+    /// Check whether timer queries are supported, enabling the WebGL
+    /// extension providing them. Must be called after loading OpenGL
+    /// functions and before measuring.
+    void init();
+
+    [[nodiscard]] bool isSupported() const { return supported_; }
+    /// Whether pipeline statistics can be counted. Never in WebGL.
+    [[nodiscard]] bool isPipelineStatisticsSupported() const
+    {
+        return pipelineStatisticsSupported_;
+    }
+    /// Count pipeline statistics of frames begun from now on, when
+    /// supported.
+    void setPipelineStatisticsEnabled(bool enabled)
+    {
+        pipelineStatisticsEnabled_ = enabled && pipelineStatisticsSupported_;
+    }
+
+    /// Read back frames that finished on the GPU and start measuring a new
+    /// one.
+    void beginFrame();
+    void endFrame();
+
+    void beginPass(GpuPass pass);
+    void endPass();
+
+    /// Pass times of the latest frame read back since the last call, if any.
+    std::optional<PassTimes> takeLatestFrame();
+    /// Milliseconds of every pass of the latest frame read back, whether
+    /// taken or not. Zero before any.
+    [[nodiscard]] float latestGpuFrameTime() const
+    {
+        return latestGpuFrameTime_;
+    }
+
+    /// GPU pass times averaged over recent frames.
+    [[nodiscard]] const PassTimes& averageGpuPassTimes() const
+    {
+        return averageGpuPassTimes_;
+    }
+    /// CPU pass times averaged over recent frames.
+    [[nodiscard]] const PassTimes& averageCpuPassTimes() const
+    {
+        return averageCpuPassTimes_;
+    }
+
+    [[nodiscard]] const Totals& totals() const { return totals_; }
+
+    /// Pipeline statistics of the latest frame read back while counting
+    /// them, zero before any.
+    [[nodiscard]] const PassStatistics& latestPipelineStatistics() const
+    {
+        return latestPipelineStatistics_;
+    }
+
+private:
+    /// Frames in flight. Results take a few frames to become available.
+    static constexpr size_t FRAME_COUNT = 4;
+    /// Measured passes per frame, including repeated ones.
+    static constexpr size_t QUERIES_PER_FRAME = 16;
+    /// Pipeline statistics counted per pass, in order of PipelineStatistics
+    /// members.
+    static constexpr size_t STATISTIC_COUNT = 4;
+
+    struct Frame
+    {
+        std::array<GLuint, QUERIES_PER_FRAME> queries;
+        std::array<GpuPass, QUERIES_PER_FRAME> passes;
+        size_t queryCount;
+        /// Pipeline statistics queries of each measured pass one after
+        /// another, created on first use.
+        std::array<GLuint, QUERIES_PER_FRAME * STATISTIC_COUNT>
+            statisticsQueries;
+        /// Whether pipeline statistics are counted in the frame.
+        bool statisticsCounted;
+    };
+
+    /// Add up pass times of a finished frame.
+    void readFrame(const Frame& frame);
+    /// Sum pipeline statistics of each pass of a finished frame.
+    void readPipelineStatistics(const Frame& frame);
+
+    bool supported_;
+    bool pipelineStatisticsSupported_;
+    bool pipelineStatisticsEnabled_;
+    std::array<Frame, FRAME_COUNT> frames_;
+    /// Oldest frame in flight.
+    size_t firstPending_;
+    size_t pendingCount_;
+    /// Whether the frame begun last is measured.
+    bool measuring_;
+    /// Whether a pass query is active.
+    bool queryActive_;
+    /// Whether pipeline statistics queries of a pass are active.
+    bool statisticsActive_;
+    std::optional<PassTimes> latestFrame_;
+    float latestGpuFrameTime_;
+    PassTimes averageGpuPassTimes_;
+    /// Pass being measured on the CPU, if any.
+    std::optional<GpuPass> activePass_;
+    std::chrono::steady_clock::time_point passBegin_;
+    /// CPU pass times of the frame being measured.
+    PassTimes cpuPassTimes_;
+    PassTimes averageCpuPassTimes_;
+    Totals totals_;
+    PassStatistics latestPipelineStatistics_;
+};
+
+#endif
@@ -1,12 +1,56 @@
 #include "gui.h"
 
+#include "allocationtracker.h"
 #include "camera.h"
 #include "drawproperties.h"
+#include "frameallocator.h"
+#include "gpuprofiler.h"
+#include "lightclusters.h"
+#include "profiler.h"
+#include "qualitygovernor.h"
+#include "renderer.h"
+#include "startuptimer.h"
+#include "videomemory.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#ifdef __EMSCRIPTEN__
+#include <GLFW/glfw3.h>  // Use GLFW port from Emscripten
+#else
+#include "GLFW/glfw3.h"
+#endif
+
+#include <algorithm>
+#include <optional>
+#include <span>
+
+namespace
+{
+/// Seconds between refreshes without input, keeping performance readouts
+/// current. Faster updates of them are too quick to be read anyway.
+constexpr double IDLE_REFRESH_INTERVAL = 0.25;
+
+float toMebibytes(size_t size)
+{
+    return static_cast<float>(size) / (1024.0F * 1024.0F);
+}
+
+/// Labeled duration, or a dash while it is not measured yet.
+void textMilliseconds(const char* label, std::optional<float> milliseconds)
+{
+    if (milliseconds)
+    {
+        ImGui::Text("%s: %.1f ms", label, milliseconds.value());
+    }
+    else
+    {
+        ImGui::Text("%s: -", label);
+    }
+}
+}  // namespace
+
 void Gui::init(GLFWwindow* window)
 {
     IMGUI_CHECKVERSION();
@@ -29,8 +73,31 @@ void Gui::init(GLFWwindow* window)
     colors[ImGuiCol_TitleBg] = transparentBackgroundColor;
 }
 
-void Gui::prepareDraw(const Camera& camera, DrawProperties& drawProps)
+void Gui::prepareDraw(const Camera& camera,
+                      const FramePacer& framePacer,
+                      const FrameAllocator& frameAllocator,
+                      const Renderer& renderer,
+                      const StartupTimer& startupTimer,
+                      const QualityGovernor& qualityGovernor,
+                      DrawProperties& drawProps)
 {
+    ALLOCATION_SCOPE(Gui);
+    refreshed_ = false;
+    if (!visible_)
+    {
+        // Input queued by the backend would otherwise pile up until shown
+        ImGui::GetIO().ClearEventsQueue();
+        return;
+    }
+    const double time = glfwGetTime();
+    if (!refreshRequested_ && time - refreshTime_ < IDLE_REFRESH_INTERVAL)
+    {
+        return;
+    }
+    refreshRequested_ = false;
+    refreshed_ = true;
+    refreshTime_ = time;
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -42,6 +109,283 @@ void Gui::prepareDraw(const Camera& camera, DrawProperties& drawProps)
         ImGui::BulletText("Mouse look: Right-click and drag");
         ImGui::BulletText("Ascend: Spacebar");
         ImGui::BulletText("Descend: C");
+        ImGui::BulletText("Hide UI: H");
+#ifndef __EMSCRIPTEN__
+        ImGui::BulletText("Screenshot: F12");
+        ImGui::BulletText("Record video: F9");
+        ImGui::BulletText("Select object: Left-click with object picking");
+#endif
+    }
+
+    if (ImGui::CollapsingHeader("Performance", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        const FramePacer::Statistics& frameStatistics
+            = framePacer.statistics();
+        const std::span<const float> frameTimes = framePacer.frameTimes();
+        ImGui::PlotLines("##Frame times",
+                         frameTimes.data(),
+                         static_cast<int>(frameTimes.size()),
+                         static_cast<int>(framePacer.oldestFrameTimeIndex()),
+                         nullptr,
+                         0.0F,
+                         std::max(frameStatistics.maxFrameTime, 1.0F),
+                         ImVec2{0.0F, 40.0F});
+        ImGui::Text("Frame time: %.2f ms", frameStatistics.averageFrameTime);
+        ImGui::Text("Min %.2f / p99 %.2f / max %.2f ms",
+                    frameStatistics.minFrameTime,
+                    frameStatistics.p99FrameTime,
+                    frameStatistics.maxFrameTime);
+        ImGui::Text("Jitter: %.2f ms", frameStatistics.frameTimeJitter);
+
+        const Renderer::FrameStatistics& renderStatistics
+            = renderer.frameStatistics();
+        ImGui::Text("Draw calls: %u", renderStatistics.drawCallCount);
+        ImGui::Text("Triangles: %llu",
+                    static_cast<unsigned long long>(
+                        renderStatistics.triangleCount));
+        ImGui::Text("State changes: %u", renderStatistics.stateChangeCount);
+        ImGui::Text("Occluded copies: %u",
+                    renderStatistics.occludedCopyCount);
+        ImGui::Text("Transform upload: %.2f MiB",
+                    toMebibytes(static_cast<size_t>(
+                        renderStatistics.transformUploadSize)));
+        ImGui::Text("Graph passes: %u, culled: %u",
+                    renderStatistics.graphPassCount,
+                    renderStatistics.culledGraphPassCount);
+        // Transients sharing pooled textures take less than they ask for
+        ImGui::Text("Transient targets: %.1f MiB for %.1f MiB requested",
+                    toMebibytes(static_cast<size_t>(
+                        renderStatistics.transientPoolSize)),
+                    toMebibytes(static_cast<size_t>(
+                        renderStatistics.transientRequestedSize)));
+        if (drawProps.qualityGovernorEnabled)
+        {
+            const QualityGovernor::Decisions& decisions
+                = qualityGovernor.decisions();
+            ImGui::Text("Quality level %d at %.2f ms",
+                        decisions.level,
+                        qualityGovernor.smoothedFrameTime());
+            ImGui::Text("Scale <= %.0f%%, samples <= %d, shadows / %d",
+                        decisions.maxResolutionScale * 100.0F,
+                        decisions.maxSampleCount,
+                        decisions.shadowMapSizeDivisor);
+            ImGui::Text("LOD error x%.1f, ambient occlusion %s",
+                        decisions.lodErrorScale,
+                        decisions.ambientOcclusionAllowed ? "allowed" : "off");
+        }
+        // Heap fallbacks are expected only while frame allocator blocks grow
+        // to fit
+        const FrameAllocator::Statistics frameMemory
+            = frameAllocator.previousFrameStatistics();
+        ImGui::Text("Frame memory: %.1f / %.1f MiB",
+                    toMebibytes(frameMemory.usedSize),
+                    toMebibytes(frameMemory.capacity));
+        ImGui::Text("Frame allocations: %zu, heap fallbacks: %zu",
+                    frameMemory.allocationCount,
+                    frameMemory.fallbackCount);
+#ifdef ALLOCATION_TRACKING_ENABLED
+        // Frames drawn again without changes are expected to allocate nothing
+        if (ImGui::TreeNode("Heap allocations per frame"))
+        {
+            const allocationtracker::SubsystemCounts& allocations
+                = allocationtracker::previousFrame();
+            for (size_t i = 0; i < allocationtracker::SUBSYSTEM_COUNT; ++i)
+            {
+                ImGui::Text("%s: %zu, %.1f KiB",
+                            allocationtracker::SUBSYSTEM_NAMES[i],
+                            allocations[i].allocationCount,
+                            static_cast<float>(allocations[i].byteCount)
+                                / 1024.0F);
+            }
+            ImGui::TreePop();
+        }
+#endif
+        if (ImGui::TreeNode("Video memory"))
+        {
+            for (size_t i = 0; i < videomemory::CATEGORY_COUNT; ++i)
+            {
+                ImGui::Text("%s: %.1f MiB",
+                            videomemory::CATEGORY_NAMES[i],
+                            toMebibytes(videomemory::used(
+                                static_cast<videomemory::Category>(i))));
+            }
+            const ImVec4 totalColor = videomemory::isOverBudget()
+                                        ? ImVec4{1.0F, 0.3F, 0.3F, 1.0F}
+                                        : ImGui::GetStyleColorVec4(
+                                              ImGuiCol_Text);
+            ImGui::TextColored(totalColor,
+                               "Total: %.1f MiB",
+                               toMebibytes(videomemory::totalUsed()));
+            ImGui::SliderInt("##Video memory budget",
+                             &drawProps.videoMemoryBudget,
+                             64,
+                             8192,
+                             "Budget = %d MiB");
+#ifndef __EMSCRIPTEN__
+            // Pages of streamed models are loaded on demand within the pool
+            const ClusterStreamer::Statistics streaming
+                = renderer.clusterStreamer().statistics();
+            ImGui::Text("Cluster pages: %zu / %zu, %zu reading",
+                        streaming.residentPageCount,
+                        streaming.pageCount,
+                        streaming.pendingReadCount);
+            ImGui::Text("Cluster pool: %.1f / %.1f MiB",
+                        toMebibytes(streaming.residentSize),
+                        toMebibytes(streaming.capacity));
+            ImGui::SliderInt("##Cluster streaming budget",
+                             &drawProps.clusterStreamingBudget,
+                             16,
+                             4096,
+                             "Streaming budget = %d MiB");
+#endif
+            // Includes memory used by other applications
+            if (const std::optional<videomemory::DeviceMemory> device
+                = videomemory::queryDevice())
+            {
+                ImGui::Text("Device available: %.1f MiB",
+                            toMebibytes(device->availableSize));
+                if (device->dedicatedSize)
+                {
+                    ImGui::Text("Device dedicated: %.1f MiB",
+                                toMebibytes(device->dedicatedSize.value()));
+                }
+            }
+            ImGui::TreePop();
+        }
+
+        // Order matches GPU passes of profiler
+        static const std::array passNames{"Clear",
+                                          "Shadows",
+                                          "Ambient occlusion",
+                                          "Light assignment",
+                                          "Models",
+                                          "Skybox",
+                                          "Antialiasing",
+                                          "Bloom",
+                                          "Tonemap",
+                                          "UI"};
+        const GpuProfiler& gpuProfiler = renderer.gpuProfiler();
+        static_assert(passNames.size() == GpuProfiler::PASS_COUNT);
+        const GpuProfiler::PassTimes& cpuPassTimes
+            = gpuProfiler.averageCpuPassTimes();
+        const GpuProfiler::PassTimes& gpuPassTimes
+            = gpuProfiler.averageGpuPassTimes();
+        if (ImGui::BeginTable("##Pass times", 3))
+        {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("CPU ms");
+            ImGui::TableSetupColumn("GPU ms");
+            ImGui::TableHeadersRow();
+            for (size_t i = 0; i < passNames.size(); ++i)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(passNames[i]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", cpuPassTimes[i]);
+                ImGui::TableNextColumn();
+                // Timer queries are optional in WebGL
+                if (gpuProfiler.isSupported())
+                {
+                    ImGui::Text("%.2f", gpuPassTimes[i]);
+                }
+                else
+                {
+                    ImGui::TextUnformatted("-");
+                }
+            }
+            ImGui::EndTable();
+        }
+        // Not available in WebGL
+        if (gpuProfiler.isPipelineStatisticsSupported())
+        {
+            ImGui::Checkbox("Pipeline statistics",
+                            &drawProps.pipelineStatisticsEnabled);
+        }
+        if (drawProps.pipelineStatisticsEnabled
+            && gpuProfiler.isPipelineStatisticsSupported()
+            && ImGui::BeginTable("##Pipeline statistics", 5))
+        {
+            const GpuProfiler::PassStatistics& statistics
+                = gpuProfiler.latestPipelineStatistics();
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("Vertices");
+            ImGui::TableSetupColumn("Primitives");
+            ImGui::TableSetupColumn("Clipped");
+            ImGui::TableSetupColumn("Fragments");
+            ImGui::TableHeadersRow();
+            for (size_t i = 0; i < passNames.size(); ++i)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(passNames[i]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu",
+                            static_cast<unsigned long long>(
+                                statistics[i].vertexShaderInvocations));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu",
+                            static_cast<unsigned long long>(
+                                statistics[i].clippingInputPrimitives));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu",
+                            static_cast<unsigned long long>(
+                                statistics[i].clippingOutputPrimitives));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu",
+                            static_cast<unsigned long long>(
+                                statistics[i].fragmentShaderInvocations));
+            }
+            ImGui::EndTable();
+        }
+        if (ImGui::TreeNode("Startup"))
+        {
+            const StartupTimer::PhaseTimes& phaseTimes
+                = startupTimer.phaseTimes();
+            for (size_t i = 0; i < phaseTimes.size(); ++i)
+            {
+                ImGui::Text("%s: %.1f ms",
+                            StartupTimer::PHASE_NAMES[i],
+                            phaseTimes[i]);
+            }
+            // UI of the first frame is drawn before it is presented
+            textMilliseconds("First frame", startupTimer.timeToFirstFrame());
+            textMilliseconds("Models loaded", startupTimer.modelLoadTime());
+            ImGui::TreePop();
+        }
+#if defined(PROFILER_ENABLED) && !defined(__EMSCRIPTEN__)
+        // Written into working directory. Browsers have no file system to
+        // export to.
+        if (ImGui::Button("Save CPU trace"))
+        {
+            profiler::writeChromeTrace("cpu_trace.json");
+        }
+#endif
+    }
+
+    if (ImGui::CollapsingHeader("Frame pacing",
+                                ImGuiTreeNodeFlags_DefaultOpen))
+    {
+#ifndef __EMSCRIPTEN__
+        // Order matches swap intervals of application
+        static const std::array vsyncModeItems{"Vsync off",
+                                               "Vsync on",
+                                               "Adaptive vsync"};
+        ImGui::Combo("##Vsync mode",
+                     &drawProps.vsyncModeIndex,
+                     vsyncModeItems.data(),
+                     static_cast<int>(vsyncModeItems.size()));
+        ImGui::Checkbox("Frame cap", &drawProps.frameCapEnabled);
+        if (drawProps.frameCapEnabled)
+        {
+            ImGui::SliderInt("##Frame cap",
+                             &drawProps.frameCap,
+                             15,
+                             240,
+                             "Frame cap = %d FPS");
+        }
+#endif
+        ImGui::Checkbox("Low latency", &drawProps.lowLatencyEnabled);
     }
 
     if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen))
@@ -55,13 +399,114 @@ void Gui::prepareDraw(const Camera& camera, DrawProperties& drawProps)
         ImGui::Text("Yaw:%.1f° Pitch:%.1f°",
                     cameraRotation.x,
                     cameraRotation.y);
-        ImGui::SliderFloat("##FOV",
-                           &drawProps.fov,
-                           45.0F,
-                           120.0F,
-                           "FOV = %.1f°");
+        if (ImGui::SliderFloat("##FOV",
+                               &drawProps.fov,
+                               45.0F,
+                               120.0F,
+                               "FOV = %.1f°"))
+        {
+            ++drawProps.fovGeneration;
+        }
+#ifndef __EMSCRIPTEN__
+        ImGui::Checkbox("On-demand rendering",
+                        &drawProps.onDemandRenderingEnabled);
+        ImGui::Checkbox("Dynamic resolution",
+                        &drawProps.dynamicResolutionEnabled);
+        if (drawProps.dynamicResolutionEnabled)
+        {
+            ImGui::SliderFloat("##Target GPU time",
+                               &drawProps.targetGpuTime,
+                               4.0F,
+                               33.0F,
+                               "Target GPU time = %.1f ms");
+            ImGui::Text("Resolution scale = %.0f%%",
+                        drawProps.resolutionScale * 100.0F);
+        }
+        else
+#endif
+        {
+            ImGui::SliderFloat("##Resolution scale",
+                               &drawProps.resolutionScale,
+                               0.25F,
+                               1.0F,
+                               "Resolution scale = %.2f");
+        }
+        ImGui::Checkbox("Quality governor", &drawProps.qualityGovernorEnabled);
+        if (drawProps.qualityGovernorEnabled)
+        {
+            ImGui::SliderFloat("##Target frame time",
+                               &drawProps.targetFrameTime,
+                               4.0F,
+                               50.0F,
+                               "Target frame time = %.1f ms");
+        }
+        // Order matches antialiasing modes of renderer
+        static const std::array antialiasingModeItems{"Antialiasing off",
+                                                      "FXAA",
+                                                      "Temporal upscaling",
+                                                      "MSAA 2x",
+                                                      "MSAA 4x",
+                                                      "MSAA 8x"};
+        ImGui::Combo("##Antialiasing mode",
+                     &drawProps.antialiasingModeIndex,
+                     antialiasingModeItems.data(),
+                     static_cast<int>(antialiasingModeItems.size()));
+#ifndef __EMSCRIPTEN__
+        if (renderer.isVariableRateShadingSupported())
+        {
+            // Order matches modes of shading rate image
+            static const std::array shadingRateModeItems{
+                "Full rate shading",
+                "Foveated shading",
+                "Content adaptive shading"};
+            ImGui::Combo("##Shading rate mode",
+                         &drawProps.shadingRateModeIndex,
+                         shadingRateModeItems.data(),
+                         static_cast<int>(shadingRateModeItems.size()));
+            // Full rate time is kept from before switching modes
+            const Renderer::ShadingRateTimes& shadingRateTimes
+                = renderer.shadingRateTimes();
+            if (drawProps.shadingRateModeIndex != 0
+                && shadingRateTimes.fullRate > 0.0F
+                && shadingRateTimes.variableRate > 0.0F)
+            {
+                ImGui::Text("Scene GPU time %.2f ms, %.2f ms saved",
+                            shadingRateTimes.variableRate,
+                            shadingRateTimes.fullRate
+                                - shadingRateTimes.variableRate);
+            }
+        }
+#endif
+        ImGui::SliderFloat("##Exposure",
+                           &drawProps.exposure,
+                           0.1F,
+                           4.0F,
+                           "Exposure = %.2f");
+        ImGui::Checkbox("Bloom", &drawProps.bloomEnabled);
+        if (drawProps.bloomEnabled)
+        {
+            ImGui::SliderFloat("##Bloom intensity",
+                               &drawProps.bloomIntensity,
+                               0.0F,
+                               0.2F,
+                               "Bloom intensity = %.3f");
+        }
         ImGui::Checkbox("Skybox", &drawProps.skyboxEnabled);
-        if (!drawProps.skyboxEnabled)
+        if (drawProps.skyboxEnabled)
+        {
+            // Order matches skybox directories of application
+            static const std::array skyboxItems{"Lake"};
+            ImGui::Combo("##Selected Skybox",
+                         &drawProps.selectedSkyboxIndex,
+                         skyboxItems.data(),
+                         static_cast<int>(skyboxItems.size()));
+            ImGui::SliderInt("##Skybox cache",
+                             &drawProps.skyboxCacheBudget,
+                             16,
+                             1024,
+                             "Skybox cache = %d MiB");
+        }
+        else
         {
             ImGui::ColorEdit3("Background", drawProps.backgroundColor.data());
         }
@@ -76,9 +521,22 @@ void Gui::prepareDraw(const Camera& camera, DrawProperties& drawProps)
                      &drawProps.selectedModelIndex,
                      modelItems.data(),
                      static_cast<int>(modelItems.size()));
-#ifndef __EMSCRIPTEN__
+        ImGui::SliderInt("##Model residency",
+                         &drawProps.modelResidencyBudget,
+                         16,
+                         1024,
+                         "Resident models = %d MiB");
         ImGui::Checkbox("Wireframe mode", &drawProps.wireframeModeEnabled);
-#endif
+        ImGui::Checkbox("Overdraw heatmap", &drawProps.overdrawViewEnabled);
+        ImGui::Checkbox("Level of detail", &drawProps.lodEnabled);
+        if (drawProps.lodEnabled)
+        {
+            ImGui::SliderFloat("##LOD error",
+                               &drawProps.lodErrorThreshold,
+                               0.1F,
+                               16.0F,
+                               "LOD error = %.1f px");
+        }
     }
 
     if (ImGui::CollapsingHeader("Transform", ImGuiTreeNodeFlags_DefaultOpen))
@@ -100,6 +558,60 @@ void Gui::prepareDraw(const Camera& camera, DrawProperties& drawProps)
                            minModelRotation,
                            maxModelRotation,
                            "Z rotation = %.0f°");
+        ImGui::SliderInt("##Instance grid",
+                         &drawProps.instanceGridSize,
+                         1,
+                         64,
+                         "Instance grid = %d");
+        if (drawProps.instanceGridSize > 1)
+        {
+            ImGui::SliderFloat("##Instance spacing",
+                               &drawProps.instanceSpacing,
+                               1.0F,
+                               10.0F,
+                               "Instance spacing = %.1f");
+            ImGui::Checkbox("Spatial index", &drawProps.spatialIndexEnabled);
+            ImGui::Checkbox("Software occlusion culling",
+                            &drawProps.softwareOcclusionCullingEnabled);
+            ImGui::Checkbox("Instancing", &drawProps.instancingEnabled);
+            if (drawProps.instancingEnabled)
+            {
+                ImGui::Checkbox("Impostors", &drawProps.impostorsEnabled);
+                if (drawProps.impostorsEnabled)
+                {
+                    ImGui::SliderFloat("##Impostor screen size",
+                                       &drawProps.impostorScreenSize,
+                                       4.0F,
+                                       256.0F,
+                                       "Impostor screen size = %.0f px");
+                }
+            }
+        }
+        ImGui::Checkbox("Multiple views", &drawProps.multiViewEnabled);
+        if (renderer.isStereoSupported())
+        {
+            ImGui::Checkbox("Stereo", &drawProps.stereoEnabled);
+        }
+#ifndef __EMSCRIPTEN__
+        ImGui::Checkbox("Multi-draw indirect",
+                        &drawProps.indirectDrawEnabled);
+        if (drawProps.indirectDrawEnabled)
+        {
+            ImGui::Checkbox("GPU culling", &drawProps.gpuCullingEnabled);
+            if (drawProps.gpuCullingEnabled)
+            {
+                ImGui::Checkbox("Occlusion culling",
+                                &drawProps.occlusionCullingEnabled);
+            }
+        }
+        ImGui::Checkbox("Object picking", &drawProps.pickingEnabled);
+        if (drawProps.pickingEnabled)
+        {
+            // Zero stands for background or nothing selected
+            ImGui::Text("Hovered object = %u", renderer.pickedObjectId());
+            ImGui::Text("Selected object = %u", drawProps.selectedObjectId);
+        }
+#endif
     }
 
     if (ImGui::CollapsingHeader("Material", ImGuiTreeNodeFlags_DefaultOpen))
@@ -115,15 +627,64 @@ void Gui::prepareDraw(const Camera& camera, DrawProperties& drawProps)
                             1.0F);
         ImGui::Checkbox("Diffuse", &drawProps.diffuseEnabled);
         ImGui::Checkbox("Specular", &drawProps.specularEnabled);
+        ImGui::Checkbox("Shadows", &drawProps.shadowsEnabled);
+        if (drawProps.shadowsEnabled)
+        {
+            static constexpr std::array shadowMapSizes{512, 1024, 2048, 4096};
+            static const std::array shadowMapSizeItems{"Shadows 512",
+                                                       "Shadows 1024",
+                                                       "Shadows 2048",
+                                                       "Shadows 4096"};
+            int shadowMapSizeIndex = static_cast<int>(
+                std::ranges::find(shadowMapSizes, drawProps.shadowMapSize)
+                - shadowMapSizes.begin());
+            if (ImGui::Combo("##Shadow resolution",
+                             &shadowMapSizeIndex,
+                             shadowMapSizeItems.data(),
+                             static_cast<int>(shadowMapSizeItems.size())))
+            {
+                drawProps.shadowMapSize = shadowMapSizes[static_cast<size_t>(
+                    shadowMapSizeIndex)];
+            }
+        }
+        ImGui::Checkbox("Ambient occlusion",
+                        &drawProps.ambientOcclusionEnabled);
+        ImGui::SliderInt("Point lights",
+                         &drawProps.pointLightCount,
+                         0,
+                         static_cast<int>(LightClusters::MAX_LIGHT_COUNT));
+        ImGui::Checkbox("Depth prepass", &drawProps.depthPrepassEnabled);
     }
 
     ImGui::End();
     ImGui::Render();
 }
 
-void Gui::draw()
+void Gui::draw(Renderer& renderer)
 {
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    ALLOCATION_SCOPE(Gui);
+    if (!visible_)
+    {
+        return;
+    }
+    // Draw data of the last refresh stays valid until the next one
+    if (refreshed_)
+    {
+        overlayCached_ = renderer.beginUiOverlay();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (overlayCached_)
+        {
+            renderer.endUiOverlay();
+        }
+    }
+    else if (!overlayCached_)
+    {
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+    if (overlayCached_)
+    {
+        renderer.drawUiOverlay();
+    }
 }
 
 void Gui::cleanup()
@@ -133,3 +694,24 @@ void Gui::cleanup()
     ImGui::DestroyContext();
 }
 
+bool Gui::isCapturingMouse()
+{
+    return visible_ && ImGui::GetIO().WantCaptureMouse;
+}
+
+void Gui::toggleVisible()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    // Key is typed into the widget being edited instead
+    if (visible_ && io.WantTextInput)
+    {
+        return;
+    }
+    visible_ = !visible_;
+    // Buttons held while hiding are released, as their release would be
+    // dropped
+    io.ClearInputKeys();
+    io.ClearInputMouse();
+    refreshRequested_ = true;
+}
+
@@ -1,7 +1,13 @@
 #ifndef GUI_H_
 #define GUI_H_
 
+#include "framepacer.h"
+
 class Camera;
+class FrameAllocator;
+class QualityGovernor;
+class Renderer;
+class StartupTimer;
 struct DrawProperties;
 struct GLFWwindow;
 
@@ -11,14 +17,36 @@ struct GLFWwindow;
 /// application's responsibility to provide that in the form of DrawProperties.
 /// Widgets are redrawn for each frame to integrate well into the loop of
 /// real-time graphics and game applications.
+///
+/// Widgets are only rebuilt when refresh is requested on input or changed
+/// values, and periodically to keep performance readouts current. In between,
+/// UI drawn into an overlay by the renderer is composited over the scene
+/// again.
 class Gui
 {
 public:
     static void init(GLFWwindow* window);
-    /// Setup UI widgets before submitting to draw call.
-    static void prepareDraw(const Camera& camera, DrawProperties& drawProps);
-    static void draw();
+    /// Setup UI widgets before submitting to draw call, when refresh is due.
+    /// Performance data is read from the renderer for the previous frame.
+    static void prepareDraw(const Camera& camera,
+                            const FramePacer& framePacer,
+                            const FrameAllocator& frameAllocator,
+                            const Renderer& renderer,
+                            const StartupTimer& startupTimer,
+                            const QualityGovernor& qualityGovernor,
+                            DrawProperties& drawProps);
+    /// Draw widgets set up this frame into the overlay of the renderer, and
+    /// composite the overlay over the window.
+    static void draw(Renderer& renderer);
     static void cleanup();
+    /// Mouse is over UI or interacting with it, so mouse input is meant for
+    /// the UI instead of the scene.
+    [[nodiscard]] static bool isCapturingMouse();
+    /// Rebuild widgets in the next frame, as input arrived or shown values
+    /// may have changed.
+    static void requestRefresh() { refreshRequested_ = true; }
+    /// Hide or show UI. Hidden UI takes no time at all, and ignores input.
+    static void toggleVisible();
 
     // Kept as class instead of utility function collection like "utils"
     // namespace, as there might be need for storing state in the future.
@@ -27,6 +55,17 @@ public:
     Gui& operator=(const Gui&) = delete;
     Gui(Gui&&) = delete;
     Gui& operator=(Gui&&) = delete;
+
+private:
+    inline static bool visible_ = true;
+    inline static bool refreshRequested_ = true;
+    /// Widgets were set up in the current frame.
+    inline static bool refreshed_ = false;
+    /// UI is drawn into the overlay of the renderer, instead of the window
+    /// when the overlay could not be created.
+    inline static bool overlayCached_ = false;
+    /// Time of the last refresh in seconds.
+    inline static double refreshTime_ = 0.0;
 };
 
 #endif
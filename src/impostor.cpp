@@ -0,0 +1,351 @@
+#include "impostor.h"
+
+#include "model.h"
+#include "utils.h"
+#include "videomemory.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/vec2.hpp"
+
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture units of atlas textures while drawing, apart from the units model
+/// shaders keep their textures bound to for the whole frame.
+constexpr GLuint COLOR_TEXTURE_UNIT = 0;
+constexpr GLuint NORMAL_DEPTH_TEXTURE_UNIT = 7;
+/// Frames shrink to 8x8 pixels at the smallest level, beyond which filtering
+/// would blend neighboring frames.
+constexpr GLsizei MIP_LEVEL_COUNT = 5;
+constexpr std::array<GLenum, 2> DRAW_BUFFERS{GL_COLOR_ATTACHMENT0,
+                                             GL_COLOR_ATTACHMENT1};
+constexpr std::array<GLfloat, 4> CLEAR_COLOR{0.0F, 0.0F, 0.0F, 0.0F};
+constexpr GLfloat CLEAR_DEPTH = 1.0F;
+
+/// Direction of octahedral coordinates in [-1, 1] range, matching the
+/// impostor shader. Up axis is at the center, and the lower hemisphere is
+/// folded over the corners.
+glm::vec3 octahedralDirection(glm::vec2 coordinates)
+{
+    glm::vec3 direction{coordinates.x,
+                        1.0F - std::abs(coordinates.x)
+                            - std::abs(coordinates.y),
+                        coordinates.y};
+    if (direction.y < 0.0F)
+    {
+        direction.x = (1.0F - std::abs(coordinates.y))
+                    * (coordinates.x >= 0.0F ? 1.0F : -1.0F);
+        direction.z = (1.0F - std::abs(coordinates.x))
+                    * (coordinates.y >= 0.0F ? 1.0F : -1.0F);
+    }
+    return glm::normalize(direction);
+}
+
+/// View projection of frame looking at bounding sphere from direction, with
+/// depth running linearly through the sphere. Up vector matches the frame
+/// axes of the impostor shader.
+glm::mat4 frameViewProjection(const BoundingSphere& sphere,
+                              const glm::vec3& direction)
+{
+    const glm::vec3 up = std::abs(direction.y) > 0.999F
+                           ? glm::vec3{0.0F, 0.0F, 1.0F}
+                           : glm::vec3{0.0F, 1.0F, 0.0F};
+    const glm::mat4 view = glm::lookAt(sphere.center
+                                           + direction * sphere.radius,
+                                       sphere.center,
+                                       up);
+    const float radius = sphere.radius;
+    return glm::ortho(-radius, radius, -radius, radius, 0.0F, 2.0F * radius)
+         * view;
+}
+
+/// Allocate immutable storage of atlas texture with its mip chain. Bound
+/// through the cache, as textures are created between frames.
+void allocateTexture(GLuint texture, GlStateCache& glState)
+{
+    glState.bindTexture(COLOR_TEXTURE_UNIT, GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D,
+                   MIP_LEVEL_COUNT,
+                   GL_RGBA8,
+                   ImpostorAtlas::SIZE,
+                   ImpostorAtlas::SIZE);
+    glTexParameteri(GL_TEXTURE_2D,
+                    GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+/// Draw every sub-mesh of model at full detail with its base color.
+void drawSubmeshes(const Model& model,
+                   Shader& shader,
+                   UniformHandle<glm::vec3> colorUniform)
+{
+    for (size_t i = 0; i < model.submeshes.size(); ++i)
+    {
+        shader.setUniform(colorUniform, model.submeshes[i].baseColor);
+#ifdef __EMSCRIPTEN__
+        // Sub-mesh indices are rebased on import
+        glDrawElements(GL_TRIANGLES,
+                       model.submeshIndexCounts[i],
+                       model.indexType,
+                       model.submeshIndexOffsets[i]);
+#else
+        glDrawElementsBaseVertex(GL_TRIANGLES,
+                                 model.submeshIndexCounts[i],
+                                 model.indexType,
+                                 model.submeshIndexOffsets[i],
+                                 model.submeshBaseVertices[i]);
+#endif
+    }
+}
+}  // namespace
+
+ImpostorAtlas::ImpostorAtlas()
+    : colorTexture_{0}
+    , normalDepthTexture_{0}
+{
+}
+
+ImpostorAtlas::ImpostorAtlas(ImpostorAtlas&& other) noexcept
+    : colorTexture_{std::exchange(other.colorTexture_, 0)}
+    , normalDepthTexture_{std::exchange(other.normalDepthTexture_, 0)}
+{
+}
+
+ImpostorAtlas& ImpostorAtlas::operator=(ImpostorAtlas&& other) noexcept
+{
+    std::swap(colorTexture_, other.colorTexture_);
+    std::swap(normalDepthTexture_, other.normalDepthTexture_);
+    return *this;
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+    if (colorTexture_ == 0)
+    {
+        return;
+    }
+    glDeleteTextures(1, &colorTexture_);
+    glDeleteTextures(1, &normalDepthTexture_);
+    videomemory::release(videomemory::Category::Texture, videoMemorySize());
+}
+
+size_t ImpostorAtlas::videoMemorySize()
+{
+    constexpr size_t pixelSize = 4;
+    size_t size = 0;
+    for (GLsizei level = 0; level < MIP_LEVEL_COUNT; ++level)
+    {
+        const auto levelSize = static_cast<size_t>(SIZE >> level);
+        size += levelSize * levelSize * pixelSize;
+    }
+    // Color and normal with depth
+    return size * 2;
+}
+
+ImpostorRenderer::PendingShaders ImpostorRenderer::submitShaders()
+{
+#ifdef __EMSCRIPTEN__
+    return PendingShaders{
+        .bakeShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/impostor_bake_gles3.vert.glsl"},
+            fs::path{"assets/shaders/impostor_bake_gles3.frag.glsl"}),
+        .drawShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/impostor_gles3.vert.glsl"},
+            fs::path{"assets/shaders/impostor_gles3.frag.glsl"}),
+    };
+#else
+    return PendingShaders{
+        .bakeShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/impostor_bake_gl4.vert.glsl"},
+            fs::path{"assets/shaders/impostor_bake_gl4.frag.glsl"}),
+        .drawShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/impostor_gl4.vert.glsl"},
+            fs::path{"assets/shaders/impostor_gl4.frag.glsl"}),
+    };
+#endif
+}
+
+bool ImpostorRenderer::init(PendingShaders&& shaders,
+                            GLuint frameDataBinding,
+                            GlStateCache& glState)
+{
+    bakeShader_ = shaders.bakeShader.finish();
+    drawShader_ = shaders.drawShader.finish();
+    if (!bakeShader_ || !drawShader_)
+    {
+        return false;
+    }
+    bakeModelUniform_ = bakeShader_->getUniformHandle<glm::mat4>("u_model");
+    bakeViewProjectionUniform_
+        = bakeShader_->getUniformHandle<glm::mat4>("u_viewProjection");
+    bakeColorUniform_ = bakeShader_->getUniformHandle<glm::vec3>("u_color");
+
+    drawShader_->bindUniformBlock("FrameData", frameDataBinding);
+    boundingSphereUniform_
+        = drawShader_->getUniformHandle<glm::vec4>("u_boundingSphere");
+    colorUniform_ = drawShader_->getUniformHandle<glm::vec3>("u_color");
+#ifndef __EMSCRIPTEN__
+    // Picking is not available in OpenGL ES 3.0
+    objectIdUniform_ = drawShader_->getUniformHandle<int>("u_objectId");
+#endif
+    // Atlas textures always go to the same units, so samplers are only set
+    // once
+    drawShader_->use(glState);
+    drawShader_->setUniform(drawShader_->getUniformHandle<int>("u_colorAtlas"),
+                            static_cast<int>(COLOR_TEXTURE_UNIT));
+    drawShader_->setUniform(
+        drawShader_->getUniformHandle<int>("u_normalDepthAtlas"),
+        static_cast<int>(NORMAL_DEPTH_TEXTURE_UNIT));
+    return true;
+}
+
+std::optional<ImpostorAtlas> ImpostorRenderer::bake(const Model& model,
+                                                    GlStateCache& glState)
+{
+#ifndef __EMSCRIPTEN__
+    if (model.streamedMesh)
+    {
+        return std::nullopt;
+    }
+#endif
+    if (model.vertexArray == 0 || model.boundingSphere.radius <= 0.0F)
+    {
+        return std::nullopt;
+    }
+
+    ImpostorAtlas atlas;
+    glGenTextures(1, &atlas.colorTexture_);
+    glGenTextures(1, &atlas.normalDepthTexture_);
+    allocateTexture(atlas.colorTexture_, glState);
+    allocateTexture(atlas.normalDepthTexture_, glState);
+    videomemory::allocate(videomemory::Category::Texture,
+                          ImpostorAtlas::videoMemorySize());
+
+    // Depth is only needed while baking, so it is released right after
+    GLuint depthRenderbuffer = 0;
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER,
+                          GL_DEPTH_COMPONENT24,
+                          ImpostorAtlas::SIZE,
+                          ImpostorAtlas::SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           atlas.colorTexture_,
+                           0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D,
+                           atlas.normalDepthTexture_,
+                           0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER,
+                              depthRenderbuffer);
+    glDrawBuffers(static_cast<GLsizei>(DRAW_BUFFERS.size()),
+                  DRAW_BUFFERS.data());
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER)
+                       == GL_FRAMEBUFFER_COMPLETE;
+    if (complete)
+    {
+        glState.setDepthFunc(GL_LESS);
+        glState.setDepthWriteEnabled(true);
+        glState.setColorWriteEnabled(true);
+        glState.setBlendEnabled(false);
+        glClearBufferfv(GL_COLOR, 0, CLEAR_COLOR.data());
+        glClearBufferfv(GL_COLOR, 1, CLEAR_COLOR.data());
+        glClearBufferfv(GL_DEPTH, 0, &CLEAR_DEPTH);
+
+        bakeShader_->use(glState);
+        bakeShader_->setUniform(bakeModelUniform_, model.positionTransform);
+        glState.bindVertexArray(model.vertexArray);
+        // Frame centers of the grid are spread evenly over octahedral
+        // coordinates
+        for (int y = 0; y < ImpostorAtlas::FRAME_GRID_SIZE; ++y)
+        {
+            for (int x = 0; x < ImpostorAtlas::FRAME_GRID_SIZE; ++x)
+            {
+                const glm::vec2 coordinates
+                    = (glm::vec2{static_cast<float>(x),
+                                 static_cast<float>(y)}
+                       + 0.5F)
+                        / static_cast<float>(ImpostorAtlas::FRAME_GRID_SIZE)
+                        * 2.0F
+                    - 1.0F;
+                bakeShader_->setUniform(
+                    bakeViewProjectionUniform_,
+                    frameViewProjection(model.boundingSphere,
+                                        octahedralDirection(coordinates)));
+                glViewport(x * ImpostorAtlas::FRAME_SIZE,
+                           y * ImpostorAtlas::FRAME_SIZE,
+                           ImpostorAtlas::FRAME_SIZE,
+                           ImpostorAtlas::FRAME_SIZE);
+                drawSubmeshes(model, bakeShader_.value(), bakeColorUniform_);
+            }
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    if (!complete)
+    {
+        utils::logWarning("incomplete impostor framebuffer");
+        return std::nullopt;
+    }
+
+    // Distant impostors cover few pixels, and sample the smaller levels
+    for (const GLuint texture :
+         {atlas.colorTexture_, atlas.normalDepthTexture_})
+    {
+        glState.bindTexture(COLOR_TEXTURE_UNIT, GL_TEXTURE_2D, texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    return atlas;
+}
+
+void ImpostorRenderer::use(const Model& model,
+                           const ImpostorAtlas& atlas,
+                           const glm::vec3& color,
+                           std::uint32_t firstObjectId,
+                           GlStateCache& glState)
+{
+    drawShader_->use(glState);
+    glState.bindTexture(COLOR_TEXTURE_UNIT,
+                        GL_TEXTURE_2D,
+                        atlas.colorTexture());
+    glState.bindTexture(NORMAL_DEPTH_TEXTURE_UNIT,
+                        GL_TEXTURE_2D,
+                        atlas.normalDepthTexture());
+    drawShader_->setUniform(boundingSphereUniform_,
+                            glm::vec4{model.boundingSphere.center,
+                                      model.boundingSphere.radius});
+    drawShader_->setUniform(colorUniform_, color);
+#ifdef __EMSCRIPTEN__
+    static_cast<void>(firstObjectId);
+#else
+    drawShader_->setUniform(objectIdUniform_,
+                            static_cast<int>(firstObjectId));
+#endif
+}
+
+void ImpostorRenderer::draw(GLsizei instanceCount)
+{
+    // Corners of each quad are generated from vertex index
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount);
+}
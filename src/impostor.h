@@ -0,0 +1,131 @@
+#ifndef IMPOSTOR_H_
+#define IMPOSTOR_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+class Model;
+
+/// Views of a model baked from directions all around it, drawn on a camera
+/// facing quad in place of distant copies of the model.
+///
+/// Directions are spread over the sphere by an octahedral mapping, each one
+/// rendered orthographically into a frame of a square grid covering the
+/// atlas. One texture holds base color with coverage in alpha, the other
+/// model space normal with depth along the view direction of the frame in
+/// alpha. Background texels are zero, so that filtered texels of both are
+/// premultiplied by coverage.
+///
+/// Move-only, releasing its textures when destroyed.
+class ImpostorAtlas
+{
+public:
+    /// Frames along each side of the atlas.
+    static constexpr int FRAME_GRID_SIZE = 8;
+    /// Width and height of each frame in pixels.
+    static constexpr int FRAME_SIZE = 128;
+    static constexpr int SIZE = FRAME_GRID_SIZE * FRAME_SIZE;
+
+    ImpostorAtlas();
+    ImpostorAtlas(const ImpostorAtlas&) = delete;
+    ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+    ImpostorAtlas(ImpostorAtlas&& other) noexcept;
+    ImpostorAtlas& operator=(ImpostorAtlas&& other) noexcept;
+    ~ImpostorAtlas();
+
+    [[nodiscard]] GLuint colorTexture() const { return colorTexture_; }
+    [[nodiscard]] GLuint normalDepthTexture() const
+    {
+        return normalDepthTexture_;
+    }
+    /// Video memory taken by both textures and their mip levels in bytes.
+    [[nodiscard]] static size_t videoMemorySize();
+
+private:
+    friend class ImpostorRenderer;
+
+    GLuint colorTexture_;
+    GLuint normalDepthTexture_;
+};
+
+/// Bakes impostor atlases of models and draws copies of models as impostors.
+///
+/// Impostors are lit by the directional light and ambient light only. Depth
+/// of the baked frames offsets fragment depth, so that impostors intersect
+/// each other and nearby geometry roughly where their models would. Views of
+/// the four frames nearest to the direction a copy is seen from are blended,
+/// so that impostors change smoothly as the camera moves around them.
+///
+/// Supported in OpenGL ES 3.0 as well. Non-copyable, non-movable.
+class ImpostorRenderer
+{
+public:
+    /// Shaders of baking and drawing submitted for compilation.
+    struct PendingShaders
+    {
+        PendingShader bakeShader;
+        PendingShader drawShader;
+    };
+
+    ImpostorRenderer() = default;
+    ImpostorRenderer(const ImpostorRenderer&) = delete;
+    ImpostorRenderer& operator=(const ImpostorRenderer&) = delete;
+    ImpostorRenderer(ImpostorRenderer&&) = delete;
+    ImpostorRenderer& operator=(ImpostorRenderer&&) = delete;
+    ~ImpostorRenderer() = default;
+
+    /// Submit shaders for compilation without waiting for the driver to
+    /// finish.
+    static PendingShaders submitShaders();
+
+    /// Finish compilation of submitted shaders. Shader of drawing reads
+    /// FrameData uniform block from given binding.
+    bool init(PendingShaders&& shaders,
+              GLuint frameDataBinding,
+              GlStateCache& glState);
+
+    /// Render model from every frame direction into a new atlas. Nothing is
+    /// baked from streamed models, whose geometry is not resident whole.
+    /// Framebuffer, viewport and depth state are left changed, so baking is
+    /// meant to happen outside of drawing frames.
+    std::optional<ImpostorAtlas> bake(const Model& model,
+                                      GlStateCache& glState);
+
+    /// Bind program and atlas of model for drawing its copies. Atlas colors
+    /// are tinted by given color, and copies are identified from given
+    /// object identifier on.
+    void use(const Model& model,
+             const ImpostorAtlas& atlas,
+             const glm::vec3& color,
+             std::uint32_t firstObjectId,
+             GlStateCache& glState);
+
+    /// Draw a quad per instance of world matrices and copy indices bound at
+    /// the instance attribute locations of the instanced model shader.
+    static void draw(GLsizei instanceCount);
+
+private:
+    std::optional<Shader> bakeShader_;
+    UniformHandle<glm::mat4> bakeModelUniform_;
+    UniformHandle<glm::mat4> bakeViewProjectionUniform_;
+    UniformHandle<glm::vec3> bakeColorUniform_;
+    std::optional<Shader> drawShader_;
+    UniformHandle<glm::vec4> boundingSphereUniform_;
+    UniformHandle<glm::vec3> colorUniform_;
+#ifndef __EMSCRIPTEN__
+    UniformHandle<int> objectIdUniform_;
+#endif
+};
+
+#endif
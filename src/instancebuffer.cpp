@@ -0,0 +1,243 @@
+#include "instancebuffer.h"
+
+#include "threadpool.h"
+#include "transformbatch.h"
+#include "videomemory.h"
+
+#include "glm/mat3x3.hpp"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Work group size declared by the scatter shader.
+constexpr GLuint SCATTER_GROUP_SIZE = 64;
+/// Shader storage buffer bindings of the scatter shader.
+constexpr GLuint SCATTERED_BINDING = 0;
+constexpr GLuint INSTANCE_BINDING = 1;
+/// Copies whose transforms are computed by a single thread pool task.
+constexpr size_t TRANSFORM_BATCH_SIZE = 1024;
+/// Scattered transforms are larger than transforms uploaded whole and take
+/// an extra dispatch, so every copy is uploaded once more than this share of
+/// them changed.
+constexpr size_t MAX_SCATTERED_COPY_SHARE_PERCENT = 50;
+}  // namespace
+
+InstanceBuffer::InstanceBuffer()
+    : buffer_{0}
+    , capacity_{0}
+    , copyCount_{0}
+    , positionTransform_{1.0F}
+    , lastUploadSize_{0}
+{
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    glDeleteBuffers(1, &buffer_);
+    videomemory::release(videomemory::Category::DrawData,
+                         capacity_ * sizeof(Instance));
+}
+
+PendingShader InstanceBuffer::submitShader()
+{
+    return Shader::submitComputeFromFile(
+        fs::path{"assets/shaders/transform_scatter_gl4.comp.glsl"});
+}
+
+bool InstanceBuffer::init(PendingShader&& scatterShader)
+{
+    scatterShader_ = scatterShader.finish();
+    if (!scatterShader_)
+    {
+        return false;
+    }
+    scatterCountUniform_
+        = scatterShader_->getUniformHandle<int>("u_scatterCount");
+    glGenBuffers(1, &buffer_);
+    return true;
+}
+
+void InstanceBuffer::update(std::span<const glm::mat4> worldMatrices,
+                            const glm::mat4& positionTransform,
+                            const TransformChanges* changes,
+                            StreamBuffer& streamBuffer,
+                            GLsizeiptr storageBufferAlignment,
+                            ThreadPool& threadPool,
+                            GlStateCache& glState)
+{
+    lastUploadSize_ = 0;
+    const bool resident = changes != nullptr && generation_
+                       && worldMatrices.size() == copyCount_
+                       && positionTransform == positionTransform_;
+    if (resident && changes->generation == generation_.value())
+    {
+        return;
+    }
+    if (resident && changes->previousGeneration == generation_.value()
+        && changes->changedCopies.size() * 100
+               <= copyCount_ * MAX_SCATTERED_COPY_SHARE_PERCENT)
+    {
+        scatter(worldMatrices,
+                positionTransform,
+                changes->changedCopies,
+                streamBuffer,
+                storageBufferAlignment,
+                threadPool,
+                glState);
+    }
+    else
+    {
+        uploadAll(worldMatrices,
+                  positionTransform,
+                  streamBuffer,
+                  storageBufferAlignment,
+                  threadPool);
+    }
+    positionTransform_ = positionTransform;
+    generation_ = changes != nullptr
+                    ? std::optional<std::uint64_t>{changes->generation}
+                    : std::nullopt;
+}
+
+void InstanceBuffer::reserve(size_t copyCount)
+{
+    copyCount_ = copyCount;
+    if (copyCount <= capacity_)
+    {
+        return;
+    }
+    videomemory::release(videomemory::Category::DrawData,
+                         capacity_ * sizeof(Instance));
+    capacity_ = copyCount;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(capacity_ * sizeof(Instance)),
+                 nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    videomemory::allocate(videomemory::Category::DrawData,
+                          capacity_ * sizeof(Instance));
+}
+
+void InstanceBuffer::uploadAll(std::span<const glm::mat4> worldMatrices,
+                               const glm::mat4& positionTransform,
+                               StreamBuffer& streamBuffer,
+                               GLsizeiptr storageBufferAlignment,
+                               ThreadPool& threadPool)
+{
+    reserve(worldMatrices.size());
+    if (worldMatrices.empty())
+    {
+        return;
+    }
+    // Transforms are computed in batches straight into the stream buffer,
+    // then copied on the GPU
+    const GLsizeiptr uploadSize = size();
+    const StreamBuffer::Range range = streamBuffer.write(
+        uploadSize,
+        storageBufferAlignment,
+        [&](std::span<std::byte> memory)
+        {
+            const std::span instances{
+                reinterpret_cast<Instance*>(memory.data()),
+                worldMatrices.size()};
+            threadPool.parallelFor(
+                worldMatrices.size(),
+                TRANSFORM_BATCH_SIZE,
+                [&](size_t begin, size_t end)
+                {
+                    std::array<glm::mat3, TRANSFORM_BATCH_SIZE> normalMatrices;
+                    const size_t count = end - begin;
+                    transformbatch::computeNormalMatrices(
+                        worldMatrices.subspan(begin, count),
+                        std::span{normalMatrices}.first(count));
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        instances[i] = {
+                            .model = worldMatrices[i] * positionTransform,
+                            .normalMatrix
+                            = glm::mat4{normalMatrices[i - begin]},
+                        };
+                    }
+                });
+        });
+    glBindBuffer(GL_COPY_READ_BUFFER, range.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                        GL_COPY_WRITE_BUFFER,
+                        range.offset,
+                        0,
+                        uploadSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    lastUploadSize_ = static_cast<size_t>(uploadSize);
+}
+
+void InstanceBuffer::scatter(std::span<const glm::mat4> worldMatrices,
+                             const glm::mat4& positionTransform,
+                             std::span<const std::uint32_t> changedCopies,
+                             StreamBuffer& streamBuffer,
+                             GLsizeiptr storageBufferAlignment,
+                             ThreadPool& threadPool,
+                             GlStateCache& glState)
+{
+    if (changedCopies.empty())
+    {
+        return;
+    }
+    const auto uploadSize = static_cast<GLsizeiptr>(
+        changedCopies.size() * sizeof(ScatteredInstance));
+    const StreamBuffer::Range range = streamBuffer.write(
+        uploadSize,
+        storageBufferAlignment,
+        [&](std::span<std::byte> memory)
+        {
+            const std::span scattered{
+                reinterpret_cast<ScatteredInstance*>(memory.data()),
+                changedCopies.size()};
+            threadPool.parallelFor(
+                changedCopies.size(),
+                TRANSFORM_BATCH_SIZE,
+                [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        const std::uint32_t copy = changedCopies[i];
+                        glm::mat3 normalMatrix;
+                        transformbatch::computeNormalMatrices(
+                            worldMatrices.subspan(copy, 1),
+                            std::span{&normalMatrix, 1});
+                        scattered[i] = {
+                            .instance = {
+                                .model = worldMatrices[copy]
+                                       * positionTransform,
+                                .normalMatrix = glm::mat4{normalMatrix},
+                            },
+                            .copy = copy,
+                            .padding = {},
+                        };
+                    }
+                });
+        });
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                      SCATTERED_BINDING,
+                      range.buffer,
+                      range.offset,
+                      uploadSize);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, buffer_);
+    const auto scatterCount = static_cast<GLuint>(changedCopies.size());
+    scatterShader_->use(glState);
+    scatterShader_->setUniform(scatterCountUniform_,
+                               static_cast<int>(scatterCount));
+    glDispatchCompute(
+        (scatterCount + SCATTER_GROUP_SIZE - 1) / SCATTER_GROUP_SIZE,
+        1,
+        1);
+    // Transforms are read by the culling pass and vertex shaders
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    lastUploadSize_ = static_cast<size_t>(uploadSize);
+}
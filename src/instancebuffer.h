@@ -0,0 +1,131 @@
+#ifndef INSTANCE_BUFFER_H_
+#define INSTANCE_BUFFER_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+#include "streambuffer.h"
+
+#include "glad/gl.h"
+#include "glm/mat4x4.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+class ThreadPool;
+
+/// Copies whose world matrices changed since an earlier state of all of
+/// them, so that data kept of that state can be updated for the changed
+/// copies alone.
+struct TransformChanges
+{
+    /// Identifies the current world matrices. Changed by the caller whenever
+    /// copies move or the model is replaced.
+    std::uint64_t generation;
+    /// Generation the changed copies are listed relative to.
+    std::uint64_t previousGeneration;
+    std::span<const std::uint32_t> changedCopies;
+};
+
+/// Transforms of every copy of a model resident in a shader storage buffer,
+/// read by indirect draws and the culling compute pass.
+///
+/// Transforms are independent of the view, so that they only need to be
+/// uploaded when copies move. When few copies moved since the resident
+/// state, their transforms are written to the stream buffer together with
+/// their copy index and scattered into place by a compute shader. Otherwise
+/// transforms of every copy are written and copied over whole, which is
+/// cheaper once most copies change. Upload size follows the number of
+/// changed copies instead of the number of all copies.
+///
+/// Compute shaders are only supported from OpenGL 4.3+ and are not available
+/// in OpenGL ES 3.0. Non-copyable, non-movable.
+class InstanceBuffer
+{
+public:
+    /// Transforms of a copy in std430 layout.
+    struct Instance
+    {
+        /// Includes dequantization of vertex positions.
+        glm::mat4 model;
+        /// Columns are padded to four components.
+        glm::mat4 normalMatrix;
+    };
+
+    InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+    InstanceBuffer(InstanceBuffer&&) = delete;
+    InstanceBuffer& operator=(InstanceBuffer&&) = delete;
+    ~InstanceBuffer();
+
+    /// Submit scatter compute shader for compilation without waiting for the
+    /// driver to finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted compute shader.
+    bool init(PendingShader&& scatterShader);
+
+    /// Bring transforms up to date with world matrices, each followed by
+    /// position transform of the model. Only changed copies are uploaded
+    /// when changes are relative to the resident state, every copy when no
+    /// changes are given. Leaves the scatter shader bound when scattering.
+    void update(std::span<const glm::mat4> worldMatrices,
+                const glm::mat4& positionTransform,
+                const TransformChanges* changes,
+                StreamBuffer& streamBuffer,
+                GLsizeiptr storageBufferAlignment,
+                ThreadPool& threadPool,
+                GlStateCache& glState);
+
+    [[nodiscard]] GLuint buffer() const { return buffer_; }
+    /// Bytes of the transforms of all copies.
+    [[nodiscard]] GLsizeiptr size() const
+    {
+        return static_cast<GLsizeiptr>(copyCount_ * sizeof(Instance));
+    }
+    /// Bytes written to the stream buffer by the last update.
+    [[nodiscard]] size_t lastUploadSize() const { return lastUploadSize_; }
+
+private:
+    /// Transforms of a copy with its index, in std430 layout of the scatter
+    /// shader.
+    struct ScatteredInstance
+    {
+        Instance instance;
+        std::uint32_t copy;
+        std::array<std::uint32_t, 3> padding;
+    };
+
+    /// Replace buffer with one fitting copy count, dropping its contents.
+    void reserve(size_t copyCount);
+    /// Write transforms of every copy and copy them into the buffer.
+    void uploadAll(std::span<const glm::mat4> worldMatrices,
+                   const glm::mat4& positionTransform,
+                   StreamBuffer& streamBuffer,
+                   GLsizeiptr storageBufferAlignment,
+                   ThreadPool& threadPool);
+    /// Write transforms of changed copies and scatter them into the buffer.
+    void scatter(std::span<const glm::mat4> worldMatrices,
+                 const glm::mat4& positionTransform,
+                 std::span<const std::uint32_t> changedCopies,
+                 StreamBuffer& streamBuffer,
+                 GLsizeiptr storageBufferAlignment,
+                 ThreadPool& threadPool,
+                 GlStateCache& glState);
+
+    std::optional<Shader> scatterShader_;
+    UniformHandle<int> scatterCountUniform_;
+    GLuint buffer_;
+    size_t capacity_;
+    size_t copyCount_;
+    /// Position transform and generation of the resident transforms. No
+    /// generation when uploaded without changes.
+    glm::mat4 positionTransform_;
+    std::optional<std::uint64_t> generation_;
+    size_t lastUploadSize_;
+};
+
+#endif
@@ -0,0 +1,350 @@
+#include "lightclusters.h"
+
+#include "profiler.h"
+#include "videomemory.h"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Entries of each cluster list, its light count followed by light indices.
+constexpr size_t CLUSTER_STRIDE = 1 + LightClusters::MAX_LIGHTS_PER_CLUSTER;
+
+/// Frustum of a perspective projection, recovered from its matrix.
+struct ProjectionFrustum
+{
+    /// Tangents of half horizontal and vertical field of view.
+    glm::vec2 tanHalfFov;
+    float nearPlane;
+    float farPlane;
+};
+
+ProjectionFrustum getFrustum(const glm::mat4& projection)
+{
+    return {
+        .tanHalfFov{1.0F / projection[0][0], 1.0F / projection[1][1]},
+        .nearPlane = projection[3][2] / (projection[2][2] - 1.0F),
+        .farPlane = projection[3][2] / (projection[2][2] + 1.0F),
+    };
+}
+
+#ifndef __EMSCRIPTEN__
+/// Work group size declared by the assignment compute shader.
+constexpr GLuint ASSIGN_GROUP_SIZE = 64;
+
+/// Shader storage buffer bindings of lights and cluster lists, shared by the
+/// assignment compute shader and the model fragment shader.
+constexpr GLuint LIGHT_BINDING = 4;
+constexpr GLuint CLUSTER_BINDING = 5;
+#else
+/// View depth at which slice of given index starts.
+float getSliceDepth(const ProjectionFrustum& frustum, std::uint32_t slice)
+{
+    return frustum.nearPlane
+         * std::pow(frustum.farPlane / frustum.nearPlane,
+                    static_cast<float>(slice)
+                        / static_cast<float>(LightClusters::GRID_DEPTH));
+}
+
+/// Slice containing given view depth, clamped to the grid.
+std::uint32_t getSlice(const ProjectionFrustum& frustum, float depth)
+{
+    const float slice
+        = std::log(std::max(depth, frustum.nearPlane) / frustum.nearPlane)
+        / std::log(frustum.farPlane / frustum.nearPlane)
+        * static_cast<float>(LightClusters::GRID_DEPTH);
+    return std::min(static_cast<std::uint32_t>(slice),
+                    LightClusters::GRID_DEPTH - 1);
+}
+#endif
+}  // namespace
+
+LightClusters::LightClusters()
+#ifndef __EMSCRIPTEN__
+    : lightBuffer_{0}
+    , clusterBuffer_{0}
+#else
+    : lightTexture_{0}
+    , clusterTexture_{0}
+#endif
+{
+}
+
+LightClusters::~LightClusters()
+{
+#ifndef __EMSCRIPTEN__
+    if (clusterBuffer_)
+    {
+        videomemory::release(videomemory::Category::DrawData,
+                             videoMemorySize());
+    }
+    glDeleteBuffers(1, &lightBuffer_);
+    glDeleteBuffers(1, &clusterBuffer_);
+#else
+    if (clusterTexture_)
+    {
+        videomemory::release(videomemory::Category::DrawData,
+                             videoMemorySize());
+    }
+    glDeleteTextures(1, &lightTexture_);
+    glDeleteTextures(1, &clusterTexture_);
+#endif
+}
+
+#ifndef __EMSCRIPTEN__
+PendingShader LightClusters::submitShader()
+{
+    return Shader::submitComputeFromFile(
+        fs::path{"assets/shaders/cluster_gl4.comp.glsl"});
+}
+
+bool LightClusters::init(PendingShader&& assignShader)
+{
+    assignShader_ = assignShader.finish();
+    if (!assignShader_)
+    {
+        return false;
+    }
+    // Grid and view are read from per-frame uniforms of model shaders
+    assignShader_->bindUniformBlock("FrameData", 0);
+
+    glGenBuffers(1, &lightBuffer_);
+    glGenBuffers(1, &clusterBuffer_);
+    // Cluster lists are written and read on the GPU only
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(CLUSTER_COUNT * CLUSTER_STRIDE
+                                         * sizeof(GLuint)),
+                 nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    videomemory::allocate(videomemory::Category::DrawData, videoMemorySize());
+    return true;
+}
+#else
+bool LightClusters::init()
+{
+    glGenTextures(1, &lightTexture_);
+    glGenTextures(1, &clusterTexture_);
+    // Texels are fetched without filtering, which integer and 32-bit float
+    // textures do not support anyway. Each light takes a row of three texels.
+    glBindTexture(GL_TEXTURE_2D, lightTexture_);
+    glTexStorage2D(GL_TEXTURE_2D,
+                   1,
+                   GL_RGBA32F,
+                   3,
+                   static_cast<GLsizei>(MAX_LIGHT_COUNT));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Each row holds the lists of a row of tiles in a slice
+    glBindTexture(GL_TEXTURE_2D, clusterTexture_);
+    glTexStorage2D(GL_TEXTURE_2D,
+                   1,
+                   GL_R16UI,
+                   static_cast<GLsizei>(GRID_WIDTH * CLUSTER_STRIDE),
+                   static_cast<GLsizei>(GRID_HEIGHT * GRID_DEPTH));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    clusterLights_.resize(CLUSTER_COUNT * CLUSTER_STRIDE);
+    videomemory::allocate(videomemory::Category::DrawData, videoMemorySize());
+    return true;
+}
+#endif
+
+glm::vec4 LightClusters::fragmentScale(const glm::mat4& projection,
+                                       int sceneWidth,
+                                       int sceneHeight)
+{
+    // Slice of view depth z is log(z / near) / log(far / near) * depth
+    const ProjectionFrustum frustum = getFrustum(projection);
+    const float sliceScale
+        = static_cast<float>(GRID_DEPTH)
+        / std::log(frustum.farPlane / frustum.nearPlane);
+    return {
+        static_cast<float>(GRID_WIDTH) / static_cast<float>(sceneWidth),
+        static_cast<float>(GRID_HEIGHT) / static_cast<float>(sceneHeight),
+        sliceScale,
+        -std::log(frustum.nearPlane) * sliceScale,
+    };
+}
+
+void LightClusters::assign(std::span<const PointLight> lights,
+                           const glm::mat4& view,
+                           const glm::mat4& projection,
+                           GlStateCache& glState)
+{
+    PROFILE_SCOPE("LightClusters::assign");
+    lights = lights.first(std::min(lights.size(), MAX_LIGHT_COUNT));
+    gpuLights_.resize(lights.size());
+    std::transform(lights.begin(),
+                   lights.end(),
+                   gpuLights_.begin(),
+                   toGpuLight);
+#ifndef __EMSCRIPTEN__
+    static_cast<void>(view);
+    static_cast<void>(projection);
+    // Orphaned, so that the upload does not wait for draws of the previous
+    // frame still reading the old lights
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, lightBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(MAX_LIGHT_COUNT * sizeof(GpuLight)),
+                 nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    0,
+                    static_cast<GLsizeiptr>(gpuLights_.size()
+                                            * sizeof(GpuLight)),
+                    gpuLights_.data());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                     CLUSTER_BINDING,
+                     clusterBuffer_);
+    assignShader_->use(glState);
+    glDispatchCompute((CLUSTER_COUNT + ASSIGN_GROUP_SIZE - 1)
+                          / ASSIGN_GROUP_SIZE,
+                      1,
+                      1);
+    // Cluster lists are read by fragment shaders of the following draws
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+#else
+    assignOnCpu(lights, view, projection);
+    // Bindings are invalidated at the start of the frame, so binding makes
+    // the unit active for the upload as well
+    glState.bindTexture(LIGHT_TEXTURE_UNIT, GL_TEXTURE_2D, lightTexture_);
+    if (!gpuLights_.empty())
+    {
+        glTexSubImage2D(GL_TEXTURE_2D,
+                        0,
+                        0,
+                        0,
+                        3,
+                        static_cast<GLsizei>(gpuLights_.size()),
+                        GL_RGBA,
+                        GL_FLOAT,
+                        gpuLights_.data());
+    }
+    glState.bindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_2D, clusterTexture_);
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    0,
+                    0,
+                    static_cast<GLsizei>(GRID_WIDTH * CLUSTER_STRIDE),
+                    static_cast<GLsizei>(GRID_HEIGHT * GRID_DEPTH),
+                    GL_RED_INTEGER,
+                    GL_UNSIGNED_SHORT,
+                    clusterLights_.data());
+#endif
+}
+
+#ifdef __EMSCRIPTEN__
+void LightClusters::assignOnCpu(std::span<const PointLight> lights,
+                                const glm::mat4& view,
+                                const glm::mat4& projection)
+{
+    // Only counts need clearing, indices past them are never read
+    for (size_t cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+    {
+        clusterLights_[cluster * CLUSTER_STRIDE] = 0;
+    }
+    const ProjectionFrustum frustum = getFrustum(projection);
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        const glm::vec3 center{view * glm::vec4{lights[i].position, 1.0F}};
+        const float radius = lights[i].radius;
+        // View space looks down the negative z-axis
+        const float nearestDepth = -center.z - radius;
+        const float farthestDepth = -center.z + radius;
+        if (farthestDepth < frustum.nearPlane
+            || nearestDepth > frustum.farPlane)
+        {
+            continue;
+        }
+        const std::uint32_t firstSlice = getSlice(frustum, nearestDepth);
+        const std::uint32_t lastSlice = getSlice(frustum, farthestDepth);
+        for (std::uint32_t z = firstSlice; z <= lastSlice; ++z)
+        {
+            const float sliceNear = getSliceDepth(frustum, z);
+            const float sliceFar = getSliceDepth(frustum, z + 1);
+            for (std::uint32_t y = 0; y < GRID_HEIGHT; ++y)
+            {
+                for (std::uint32_t x = 0; x < GRID_WIDTH; ++x)
+                {
+                    // Bounding box of the cluster in view space, covering
+                    // the tile at both depths of the slice
+                    const glm::vec2 tileMin
+                        = (glm::vec2{static_cast<float>(x),
+                                     static_cast<float>(y)}
+                               / glm::vec2{GRID_WIDTH, GRID_HEIGHT}
+                               * 2.0F
+                           - 1.0F)
+                        * frustum.tanHalfFov;
+                    const glm::vec2 tileMax
+                        = (glm::vec2{static_cast<float>(x + 1),
+                                     static_cast<float>(y + 1)}
+                               / glm::vec2{GRID_WIDTH, GRID_HEIGHT}
+                               * 2.0F
+                           - 1.0F)
+                        * frustum.tanHalfFov;
+                    const glm::vec3 boxMin{
+                        glm::min(tileMin * sliceNear, tileMin * sliceFar),
+                        -sliceFar};
+                    const glm::vec3 boxMax{
+                        glm::max(tileMax * sliceNear, tileMax * sliceFar),
+                        -sliceNear};
+                    const glm::vec3 offset
+                        = glm::clamp(center, boxMin, boxMax) - center;
+                    if (glm::dot(offset, offset) > radius * radius)
+                    {
+                        continue;
+                    }
+                    const size_t cluster
+                        = x + GRID_WIDTH * (y + GRID_HEIGHT * z);
+                    std::uint16_t& count
+                        = clusterLights_[cluster * CLUSTER_STRIDE];
+                    if (count < MAX_LIGHTS_PER_CLUSTER)
+                    {
+                        ++count;
+                        clusterLights_[cluster * CLUSTER_STRIDE + count]
+                            = static_cast<std::uint16_t>(i);
+                    }
+                }
+            }
+        }
+    }
+}
+#endif
+
+LightClusters::GpuLight LightClusters::toGpuLight(const PointLight& light)
+{
+    // Lights shining in all directions get a cone wider than the sphere,
+    // which lights everything
+    const bool spotLight = light.spotAngle > 0.0F;
+    const float cosOuter = spotLight ? std::cos(light.spotAngle) : -2.0F;
+    const float cosInner
+        = spotLight ? std::cos(light.spotAngle * 0.8F) : -1.0F;
+    const glm::vec3 direction
+        = spotLight ? glm::normalize(light.spotDirection) : glm::vec3{0.0F};
+    return {
+        .positionRadius{light.position, light.radius},
+        .colorCosOuter{light.color, cosOuter},
+        .directionCosInner{direction, cosInner},
+    };
+}
+
+size_t LightClusters::videoMemorySize()
+{
+#ifndef __EMSCRIPTEN__
+    return CLUSTER_COUNT * CLUSTER_STRIDE * sizeof(GLuint)
+         + MAX_LIGHT_COUNT * sizeof(GpuLight);
+#else
+    return CLUSTER_COUNT * CLUSTER_STRIDE * sizeof(std::uint16_t)
+         + MAX_LIGHT_COUNT * sizeof(GpuLight);
+#endif
+}
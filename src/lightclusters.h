@@ -0,0 +1,150 @@
+#ifndef LIGHT_CLUSTERS_H_
+#define LIGHT_CLUSTERS_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Light shining in all directions, or in a cone for spot lights, fading out
+/// completely at its radius.
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    /// Half angle in radians of the cone lit by spot lights. Zero for lights
+    /// shining in all directions.
+    float spotAngle;
+    /// Axis of the cone of spot lights.
+    glm::vec3 spotDirection;
+};
+
+/// Assignment of point and spot lights to clusters of the view frustum for
+/// clustered forward shading.
+///
+/// View frustum is divided into a grid of clusters, tiles of the screen split
+/// further by view depth into exponentially thicker slices, so that clusters
+/// have similar proportions at every distance. Each cluster lists the lights
+/// whose sphere of influence overlaps it, and fragments only loop over the
+/// list of the cluster they fall into. Shading cost therefore follows the
+/// number of lights near each fragment instead of the total.
+///
+/// Grid is derived from the projection in the FrameData uniform block. On
+/// desktop, lights are stored in a shader storage buffer and assigned by a
+/// compute shader, one invocation per cluster. In OpenGL ES 3.0 lacking
+/// compute shaders and storage buffers, lights are assigned on the CPU and
+/// stored in textures.
+///
+/// Non-copyable, non-movable.
+class LightClusters
+{
+public:
+    static constexpr std::uint32_t GRID_WIDTH = 16;
+    static constexpr std::uint32_t GRID_HEIGHT = 9;
+    static constexpr std::uint32_t GRID_DEPTH = 24;
+    static constexpr std::uint32_t CLUSTER_COUNT
+        = GRID_WIDTH * GRID_HEIGHT * GRID_DEPTH;
+    /// Lights listed per cluster at most. Further overlapping lights are left
+    /// out of the cluster.
+    static constexpr std::uint32_t MAX_LIGHTS_PER_CLUSTER = 64;
+    /// Lights beyond this many are ignored.
+    static constexpr size_t MAX_LIGHT_COUNT = 1024;
+#ifdef __EMSCRIPTEN__
+    /// Texture units light and cluster textures are bound to while drawing
+    /// models.
+    static constexpr GLuint LIGHT_TEXTURE_UNIT = 2;
+    static constexpr GLuint CLUSTER_TEXTURE_UNIT = 3;
+#endif
+
+    LightClusters();
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+    LightClusters(LightClusters&&) = delete;
+    LightClusters& operator=(LightClusters&&) = delete;
+    ~LightClusters();
+
+#ifndef __EMSCRIPTEN__
+    /// Submit light assignment compute shader for compilation without
+    /// waiting for the driver to finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted compute shader and create buffers.
+    bool init(PendingShader&& assignShader);
+#else
+    /// Create textures lights and clusters are stored in.
+    bool init();
+#endif
+
+    /// Scale and bias turning fragment coordinates into cluster tile
+    /// coordinates in xy, and logarithm of view depth into slice coordinate
+    /// in zw, for scene of given size drawn with given perspective
+    /// projection.
+    [[nodiscard]] static glm::vec4 fragmentScale(const glm::mat4& projection,
+                                                 int sceneWidth,
+                                                 int sceneHeight);
+
+    /// Upload lights and assign them to clusters of the view. FrameData
+    /// uniform block of the frame has to be bound already, as the grid is
+    /// derived from its projection. Leaves lights and clusters bound for
+    /// model shaders.
+    void assign(std::span<const PointLight> lights,
+                const glm::mat4& view,
+                const glm::mat4& projection,
+                GlStateCache& glState);
+
+private:
+    /// Light in std430 layout of the light buffer, or as three texels of the
+    /// light texture.
+    struct GpuLight
+    {
+        glm::vec4 positionRadius;
+        /// Cosine of the outer angle of the cone in w.
+        glm::vec4 colorCosOuter;
+        /// Cosine of the inner angle of the cone in w, where light starts
+        /// fading out towards the outer angle.
+        glm::vec4 directionCosInner;
+    };
+
+    static GpuLight toGpuLight(const PointLight& light);
+
+#ifdef __EMSCRIPTEN__
+    /// Fill cluster lists on the CPU, visiting only the slices each light
+    /// overlaps in depth.
+    void assignOnCpu(std::span<const PointLight> lights,
+                     const glm::mat4& view,
+                     const glm::mat4& projection);
+#endif
+
+    /// Video memory taken by light and cluster storage in bytes.
+    [[nodiscard]] static size_t videoMemorySize();
+
+    std::vector<GpuLight> gpuLights_;
+#ifndef __EMSCRIPTEN__
+    std::optional<Shader> assignShader_;
+    GLuint lightBuffer_;
+    GLuint clusterBuffer_;
+#else
+    /// Light count and indices of each cluster, laid out like the cluster
+    /// texture.
+    std::vector<std::uint16_t> clusterLights_;
+    GLuint lightTexture_;
+    GLuint clusterTexture_;
+#endif
+};
+
+#endif
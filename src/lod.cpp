@@ -0,0 +1,111 @@
+#include "lod.h"
+
+#include "meshprocessing.h"
+#include "meshsimplifier.h"
+
+#include "glm/geometric.hpp"
+
+namespace
+{
+/// Levels in addition to full detail. Coarser levels would cover so few
+/// pixels that drawing them costs about as much as the previous one.
+constexpr size_t CHAIN_LENGTH = 3;
+
+/// Levels whose triangle count could not be reduced below this fraction of
+/// the previous one end the chain, because they would barely be coarser.
+constexpr float MAX_SIMPLIFIED_RATIO = 0.85F;
+}  // namespace
+
+namespace lod
+{
+float projectError(const glm::vec3& center,
+                   float radius,
+                   float error,
+                   const View& view)
+{
+    if (error <= 0.0F)
+    {
+        return 0.0F;
+    }
+    if (error == UNBOUNDED_ERROR)
+    {
+        return UNBOUNDED_ERROR;
+    }
+    const float distance
+        = glm::length(center - view.cameraPosition) - radius;
+    if (distance <= 0.0F)
+    {
+        return UNBOUNDED_ERROR;
+    }
+    return error / distance * view.projectionScale;
+}
+
+void buildChain(std::span<const Vertex> vertices,
+                std::vector<GLuint>& indices,
+                Submesh& submesh,
+                std::vector<SubmeshLod>& lods)
+{
+    const std::vector<GLuint> positionRemap
+        = meshsimplifier::generatePositionRemap(vertices);
+    const Bounds bounds = meshprocessing::computeBounds(vertices);
+    const glm::vec3 center = (bounds.minimum + bounds.maximum) * 0.5F;
+    const float radius = glm::length(bounds.maximum - bounds.minimum) * 0.5F;
+    const size_t firstLod = lods.size();
+
+    std::vector<GLuint> source(
+        indices.begin() + submesh.firstIndex,
+        indices.begin() + submesh.firstIndex + submesh.indexCount);
+    float error = 0.0F;
+    for (size_t level = 0; level < CHAIN_LENGTH; ++level)
+    {
+        float levelError = 0.0F;
+        std::vector<GLuint> simplified
+            = meshsimplifier::simplify(source,
+                                       vertices,
+                                       positionRemap,
+                                       {},
+                                       source.size() / 6 * 3,
+                                       levelError);
+        if (simplified.empty()
+            || static_cast<float>(simplified.size())
+                   > static_cast<float>(source.size()) * MAX_SIMPLIFIED_RATIO)
+        {
+            break;
+        }
+        // Simplification leaves surviving triangles in their original order
+        // with gaps, so vertex cache locality is restored
+        meshprocessing::optimizeVertexCache(simplified, vertices.size());
+
+        // Each level is simplified from the previous one, so its distance
+        // from the full detail surface is at most the sum of distances
+        error += levelError;
+        lods.push_back(SubmeshLod{
+            .firstIndex = static_cast<GLuint>(indices.size()),
+            .indexCount = static_cast<GLuint>(simplified.size()),
+            .center = center,
+            .radius = radius,
+            .error = error,
+        });
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        source = std::move(simplified);
+    }
+
+    submesh.firstLod = static_cast<GLuint>(firstLod);
+    submesh.lodCount = static_cast<GLuint>(lods.size() - firstLod);
+}
+
+std::optional<size_t> selectChainLevel(std::span<const SubmeshLod> chain,
+                                       const View& view)
+{
+    for (size_t level = chain.size(); level > 0; --level)
+    {
+        const SubmeshLod& lod = chain[level - 1];
+        if (projectError(lod.center, lod.radius, lod.error, view)
+            <= view.errorThreshold)
+        {
+            return level - 1;
+        }
+    }
+    return std::nullopt;
+}
+}  // namespace lod
@@ -0,0 +1,63 @@
+#ifndef LOD_H_
+#define LOD_H_
+
+#include "mesh.h"
+
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Geometric error based level of detail selection, and discrete level of
+/// detail chains for sub-meshes too small to benefit from a cluster level of
+/// detail hierarchy.
+///
+/// Simplified geometry records the largest distance of its surface from the
+/// full detail one. Projecting that distance onto screen tells how many
+/// pixels the simplification can be off by from a given viewpoint, which is
+/// compared against a threshold in pixels.
+namespace lod
+{
+/// Error of geometry which is never acceptable, like the parent of hierarchy
+/// roots.
+inline constexpr float UNBOUNDED_ERROR = std::numeric_limits<float>::max();
+
+/// Viewpoint of level of detail selection.
+struct View
+{
+    /// Camera position in model space, where bounds are defined.
+    glm::vec3 cameraPosition;
+    /// Screen pixels covered by unit length at unit distance from the camera.
+    float projectionScale;
+    /// Largest projected error in pixels accepted for drawn geometry.
+    float errorThreshold;
+};
+
+/// Error in pixels of geometry within bounding sphere as seen from viewpoint.
+/// Conservatively measured at the nearest point of the sphere, and unbounded
+/// when the camera is inside of it.
+float projectError(const glm::vec3& center,
+                   float radius,
+                   float error,
+                   const View& view);
+
+/// Build chain of successively halved triangle counts for a sub-mesh from the
+/// vertices of the sub-mesh. Simplified indices are appended to the end of
+/// indices and levels are appended to lods, recording their range in the
+/// sub-mesh. The chain ends early when simplification stops reducing
+/// triangle count.
+void buildChain(std::span<const Vertex> vertices,
+                std::vector<GLuint>& indices,
+                Submesh& submesh,
+                std::vector<SubmeshLod>& lods);
+
+/// Coarsest level of chain whose error is below threshold on screen. Returns
+/// nothing when full detail is needed.
+std::optional<size_t> selectChainLevel(std::span<const SubmeshLod> chain,
+                                       const View& view);
+}  // namespace lod
+
+#endif
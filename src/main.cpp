@@ -1,6 +1,36 @@
 #include "app.h"
+#include "assetarchive.h"
+#include "model.h"
+#include "progressivemesh.h"
+#include "utils.h"
 
 #include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#ifndef __EMSCRIPTEN__
+namespace
+{
+/// Convert model file into progressive file next to it, for fetching in the
+/// browser.
+bool writeProgressiveMesh(const std::filesystem::path& sourcePath)
+{
+    // Discrete level of detail chains become the progressive levels, so
+    // cluster hierarchies are not built
+    ImportOptions options = ImportOptions::createDefault();
+    options.buildClusterLod = false;
+    const std::optional<MeshData> meshData
+        = Model::loadMeshData(sourcePath, options);
+    return meshData
+        && progressivemesh::write(
+               meshData.value(),
+               progressivemesh::progressivePath(sourcePath));
+}
+}  // namespace
+#endif
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -10,18 +40,122 @@ int WINAPI WinMain([[maybe_unused]] _In_ HINSTANCE hInstance,
                    [[maybe_unused]] _In_ LPSTR lpCmdLine,
                    [[maybe_unused]] _In_ int nShowCmd)
 #else
-int main()
+int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
 #endif
 {
+#ifdef _WIN32
+    // Arguments are split by the C runtime like for main()
+    const int argc = __argc;
+    char** argv = __argv;
+#endif
+
     App app;
+#ifndef __EMSCRIPTEN__
+    const std::span<const char* const> arguments{argv + 1,
+                                                 static_cast<size_t>(argc - 1)};
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        const std::string_view argument{arguments[i]};
+        if (argument == "--benchmark")
+        {
+            // Benchmark options take the rest of the command line
+            std::optional<Benchmark::Options> options
+                = Benchmark::parseArguments(arguments.subspan(i + 1));
+            if (!options)
+            {
+                return EXIT_FAILURE;
+            }
+            app.enableBenchmark(std::move(options.value()));
+            break;
+        }
+        if (argument == "--thumbnails")
+        {
+            // Thumbnail options take the rest of the command line
+            std::optional<ThumbnailBatch::Options> options
+                = ThumbnailBatch::parseArguments(arguments.subspan(i + 1));
+            if (!options)
+            {
+                return EXIT_FAILURE;
+            }
+            app.enableThumbnails(std::move(options.value()));
+            break;
+        }
+        if (argument == "--progressive")
+        {
+            // Remaining arguments are model files, converted without opening
+            // a window
+            for (const char* path : arguments.subspan(i + 1))
+            {
+                if (!writeProgressiveMesh(path))
+                {
+                    return EXIT_FAILURE;
+                }
+            }
+            return EXIT_SUCCESS;
+        }
+        if (argument == "--pack" && i + 2 < arguments.size())
+        {
+            // Assets are packed without opening a window
+            const std::filesystem::path archivePath{arguments[i + 1]};
+            // Directory name is the first component of entry paths, so
+            // that a trailing separator or dot leaves the name to its parent
+            std::filesystem::path directory
+                = std::filesystem::path{arguments[i + 2]}.lexically_normal();
+            if (directory.filename().empty())
+            {
+                directory = directory.parent_path();
+            }
+            return AssetArchive::pack(directory, archivePath) ? EXIT_SUCCESS
+                                                              : EXIT_FAILURE;
+        }
+        if ((argument == "--record" || argument == "--replay")
+            && i + 1 < arguments.size())
+        {
+            const std::filesystem::path filePath{arguments[++i]};
+            if (argument == "--record")
+            {
+                app.enableRecording(filePath);
+                continue;
+            }
+            std::optional<Recording> recording = Recording::load(filePath);
+            if (!recording)
+            {
+                return EXIT_FAILURE;
+            }
+            app.enableReplay(std::move(recording.value()));
+            continue;
+        }
+        if (argument == "--stream" && i + 2 < arguments.size())
+        {
+            std::filesystem::path frameOutputPath{arguments[++i]};
+            std::filesystem::path inputPath{arguments[++i]};
+            app.enableStreaming(StreamServer::Options{
+                .frameOutputPath = std::move(frameOutputPath),
+                .inputPath = std::move(inputPath),
+            });
+            continue;
+        }
+        if (argument == "--output-window")
+        {
+            app.enableOutputWindow();
+            continue;
+        }
+        if (argument == "--point-cloud" && i + 1 < arguments.size())
+        {
+            app.loadPointCloud(arguments[++i]);
+            continue;
+        }
+        utils::showErrorMessage("unknown or incomplete argument ", argument);
+        return EXIT_FAILURE;
+    }
+#endif
     if (!app.init())
     {
         return EXIT_FAILURE;
     }
 
-    app.run();
+    const bool succeeded = app.run();
     app.cleanup();
 
-    return EXIT_SUCCESS;
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
 }
-
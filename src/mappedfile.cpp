@@ -0,0 +1,135 @@
+#include "mappedfile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+std::optional<MappedFile> MappedFile::open(const fs::path& path)
+{
+    MappedFile mappedFile;
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return std::nullopt;
+    }
+    mappedFile.fileHandle_ = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        return std::nullopt;
+    }
+
+    HANDLE mapping
+        = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        return std::nullopt;
+    }
+    mappedFile.mappingHandle_ = mapping;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        return std::nullopt;
+    }
+    mappedFile.data_ = static_cast<const std::byte*>(view);
+    mappedFile.size_ = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size <= 0)
+    {
+        close(fd);
+        return std::nullopt;
+    }
+
+    const auto fileSize = static_cast<size_t>(fileStatus.st_size);
+    void* view = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // Mapping stays valid after closing descriptor
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return std::nullopt;
+    }
+    mappedFile.data_ = static_cast<const std::byte*>(view);
+    mappedFile.size_ = fileSize;
+#endif
+
+    return mappedFile;
+}
+
+MappedFile::MappedFile()
+    : data_{nullptr}
+    , size_{0}
+#ifdef _WIN32
+    , fileHandle_{INVALID_HANDLE_VALUE}
+    , mappingHandle_{nullptr}
+#endif
+{
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)}
+    , size_{std::exchange(other.size_, 0)}
+#ifdef _WIN32
+    , fileHandle_{std::exchange(other.fileHandle_, INVALID_HANDLE_VALUE)}
+    , mappingHandle_{std::exchange(other.mappingHandle_, nullptr)}
+#endif
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+#ifdef _WIN32
+    std::swap(fileHandle_, other.fileHandle_);
+    std::swap(mappingHandle_, other.mappingHandle_);
+#endif
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mappingHandle_)
+    {
+        CloseHandle(mappingHandle_);
+    }
+    if (fileHandle_ != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(fileHandle_);
+    }
+#else
+    if (data_)
+    {
+        munmap(const_cast<std::byte*>(data_), size_);
+    }
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+
+/// Read-only memory mapping of a whole file.
+///
+/// File contents are paged in by the operating system on access instead of
+/// being copied into a separately allocated buffer, which allows passing large
+/// files directly to graphics API calls without intermediate copies.
+///
+/// Non-copyable, move-only. Mapping is released on destruction.
+class MappedFile
+{
+public:
+    /// Factory method mapping file at path. Returns nothing when file does not
+    /// exist, is empty or cannot be mapped.
+    static std::optional<MappedFile> open(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    ~MappedFile();
+
+    [[nodiscard]] const std::byte* data() const { return data_; }
+    [[nodiscard]] size_t size() const { return size_; }
+
+private:
+    MappedFile();
+
+    const std::byte* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* fileHandle_;
+    void* mappingHandle_;
+#endif
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "materialtexture.h"
+
+// clang-format off
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+// clang-format on
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+constexpr int CHANNEL_COUNT = 4;
+
+/// Texels of source axis averaged into a layer texel when the source is
+/// larger than the layer, or the pair blended bilinearly when smaller.
+struct Footprint
+{
+    int first;
+    int last;
+    float weight;
+};
+
+Footprint getFootprint(int texel, int sourceSize)
+{
+    if (sourceSize >= materialtexture::LAYER_SIZE)
+    {
+        const int first = texel * sourceSize / materialtexture::LAYER_SIZE;
+        const int end = (texel + 1) * sourceSize / materialtexture::LAYER_SIZE;
+        return {
+            .first = first,
+            .last = std::max(end - 1, first),
+            .weight = 0.0F,
+        };
+    }
+    // Texel centers line up at the edges, which are clamped
+    const float position = (static_cast<float>(texel) + 0.5F)
+                             * static_cast<float>(sourceSize)
+                             / static_cast<float>(materialtexture::LAYER_SIZE)
+                         - 0.5F;
+    const float clamped
+        = std::clamp(position, 0.0F, static_cast<float>(sourceSize - 1));
+    const auto first = static_cast<int>(clamped);
+    return {
+        .first = first,
+        .last = std::min(first + 1, sourceSize - 1),
+        .weight = clamped - static_cast<float>(first),
+    };
+}
+
+/// Resample RGBA image into layer, box filtered along axes larger than the
+/// layer and bilinearly filtered along smaller ones.
+void resample(const stbi_uc* pixels,
+              int width,
+              int height,
+              std::span<std::byte> layer)
+{
+    const auto readTexel = [&](int x, int y, int channel)
+    {
+        return static_cast<float>(
+            pixels[(static_cast<size_t>(y) * width + x) * CHANNEL_COUNT
+                   + channel]);
+    };
+    const bool boxX = width >= materialtexture::LAYER_SIZE;
+    const bool boxY = height >= materialtexture::LAYER_SIZE;
+    for (int y = 0; y < materialtexture::LAYER_SIZE; ++y)
+    {
+        const Footprint rows = getFootprint(y, height);
+        for (int x = 0; x < materialtexture::LAYER_SIZE; ++x)
+        {
+            const Footprint columns = getFootprint(x, width);
+            std::array<float, CHANNEL_COUNT> sum{};
+            float totalWeight = 0.0F;
+            for (int sourceY = rows.first; sourceY <= rows.last; ++sourceY)
+            {
+                const float weightY
+                    = boxY ? 1.0F
+                           : (sourceY == rows.first ? 1.0F - rows.weight
+                                                    : rows.weight);
+                for (int sourceX = columns.first; sourceX <= columns.last;
+                     ++sourceX)
+                {
+                    const float weightX
+                        = boxX ? 1.0F
+                               : (sourceX == columns.first
+                                      ? 1.0F - columns.weight
+                                      : columns.weight);
+                    const float weight = weightX * weightY;
+                    for (int channel = 0; channel < CHANNEL_COUNT; ++channel)
+                    {
+                        sum[channel]
+                            += readTexel(sourceX, sourceY, channel) * weight;
+                    }
+                    totalWeight += weight;
+                }
+            }
+            const size_t texel
+                = (static_cast<size_t>(y) * materialtexture::LAYER_SIZE + x)
+                * CHANNEL_COUNT;
+            for (int channel = 0; channel < CHANNEL_COUNT; ++channel)
+            {
+                layer[texel + channel] = static_cast<std::byte>(
+                    std::lround(std::clamp(sum[channel] / totalWeight,
+                                           0.0F,
+                                           255.0F)));
+            }
+        }
+    }
+}
+}  // namespace
+
+namespace materialtexture
+{
+bool decodeLayer(std::span<const std::byte> encoded,
+                 std::span<std::byte> layer)
+{
+    int width = 0;
+    int height = 0;
+    int channelCount = 0;
+    const std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(
+        stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()),
+                              static_cast<int>(encoded.size()),
+                              &width,
+                              &height,
+                              &channelCount,
+                              STBI_rgb_alpha),
+        stbi_image_free);
+    if (!pixels)
+    {
+        std::ranges::fill(layer, std::byte{0xFF});
+        return false;
+    }
+    resample(pixels.get(), width, height, layer);
+    return true;
+}
+}  // namespace materialtexture
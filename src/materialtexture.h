@@ -0,0 +1,34 @@
+#ifndef MATERIAL_TEXTURE_H_
+#define MATERIAL_TEXTURE_H_
+
+#include <cstddef>
+#include <span>
+
+/// Base color textures of materials, decoded on import into layers of a
+/// single texture array per model.
+///
+/// Layers of an array share their size, so every image is resampled to
+/// LAYER_SIZE, larger ones averaging the texels each layer texel covers and
+/// smaller ones filtered bilinearly. Sub-meshes refer to their layer by index
+/// from the material table, so that sub-meshes of different materials are
+/// drawn by a single multi-draw without binding textures in between.
+/// Layers are independent of each other, so that importers decode them on
+/// thread pool tasks.
+namespace materialtexture
+{
+/// Width and height of every layer in texels.
+inline constexpr int LAYER_SIZE = 512;
+/// Bytes of an RGBA layer with 8 bits per channel, rows ordered from top to
+/// bottom as stored in image files.
+inline constexpr size_t LAYER_BYTE_SIZE
+    = static_cast<size_t>(LAYER_SIZE) * LAYER_SIZE * 4;
+
+/// Decode image file contents in any format read by stb_image into layer of
+/// LAYER_BYTE_SIZE bytes. Images failing to decode leave the layer white, so
+/// that sub-meshes referring to it are drawn in their base color, and return
+/// false for the caller to report.
+bool decodeLayer(std::span<const std::byte> encoded,
+                 std::span<std::byte> layer);
+}  // namespace materialtexture
+
+#endif
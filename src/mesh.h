@@ -0,0 +1,437 @@
+#ifndef MESH_H_
+#define MESH_H_
+
+#include "mappedfile.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+/// Per-vertex data containing vertex attributes for each vertex.
+///
+/// Layout is persisted as-is by the binary mesh cache. Bump the mesh cache
+/// format version when changing it.
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    /// Texture coordinates of the base color texture, with the origin at the
+    /// top left of the image. Zero for meshes without them.
+    glm::vec2 texCoord;
+};
+
+/// Compact vertex layout taking half the memory and fetch bandwidth of Vertex.
+///
+/// Layout is persisted as-is by the binary mesh cache. Bump the mesh cache
+/// format version when changing it.
+struct PackedVertex
+{
+    /// Position quantized to 16-bit unsigned normalized values relative to the
+    /// bounding box of the mesh. Fourth component is padding keeping the normal
+    /// aligned.
+    std::array<uint16_t, 4> position;
+    /// Normal as signed normalized GL_INT_2_10_10_10_REV value.
+    uint32_t normal;
+    /// Texture coordinates as half floats, keeping the repeat of tiling
+    /// textures outside of [0, 1] range.
+    std::array<uint16_t, 2> texCoord;
+};
+
+/// Vertex layout of mesh data and of the vertex buffer created from it.
+enum class VertexFormat : uint8_t
+{
+    Float,   ///< Vertex
+    Packed,  ///< PackedVertex
+};
+
+/// Axis-aligned bounding box of mesh positions.
+struct Bounds
+{
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+};
+
+/// Sphere enclosing mesh positions, cheaper to test for visibility than a box.
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+/// Texture layer of sub-meshes whose material has no base color texture.
+inline constexpr std::int32_t NO_TEXTURE_LAYER = -1;
+
+/// Range of indices in the index buffer shared by all sub-meshes of a model.
+///
+/// Models consisting of multiple meshes keep all of their vertices and indices
+/// in a single vertex and index buffer, and each sub-mesh refers to its own
+/// part of them, avoiding a separate vertex array per sub-mesh. Indices of a
+/// sub-mesh are relative to its base vertex.
+struct Submesh
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+    /// Range of meshlets forming the cluster level of detail hierarchy of the
+    /// sub-mesh. Empty when no hierarchy was built.
+    GLuint firstMeshlet;
+    GLuint meshletCount;
+    /// Range of simplified levels forming the discrete level of detail chain
+    /// of the sub-mesh, from finest to coarsest. Empty when no chain was
+    /// built.
+    GLuint firstLod;
+    GLuint lodCount;
+    /// Base color of the material of the sub-mesh, tinting the model color.
+    /// White when the model file defines no material color.
+    glm::vec3 baseColor;
+    /// Opacity of the material of the sub-mesh. Sub-meshes below one are
+    /// drawn by the transparency pass instead of with opaque geometry.
+    float opacity;
+    /// Layer of the base color texture of the material in the texture array
+    /// of the model, NO_TEXTURE_LAYER when the material has none.
+    std::int32_t textureLayer;
+};
+
+/// Simplified version of a whole sub-mesh in its discrete level of detail
+/// chain. Indices belong to the index buffer of the model and are relative to
+/// the base vertex of the sub-mesh.
+struct SubmeshLod
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    /// Bounding sphere of the sub-mesh, shared by all of its levels.
+    glm::vec3 center;
+    float radius;
+    /// Largest distance of simplified surface from full detail surface.
+    float error;
+};
+
+/// Cluster of triangles in the cluster level of detail hierarchy of a
+/// sub-mesh. Indices belong to the index buffer of the model and are relative
+/// to the base vertex of the sub-mesh, like the indices of the sub-mesh
+/// itself.
+///
+/// Coarser meshlets are produced by simplifying groups of finer ones. A
+/// meshlet is drawn when the error of the group it was produced by is small
+/// enough on screen, but the error of the group it was simplified into is
+/// not. All meshlets of a group share bounds and error of the group, so that
+/// they switch detail together without cracks between them.
+struct Meshlet
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    /// Bounding sphere and error of the group this meshlet was produced by.
+    /// Error is zero for full detail meshlets.
+    glm::vec3 center;
+    float radius;
+    float error;
+    /// Bounding sphere and error of the group this meshlet was simplified
+    /// into. Error is the largest float value at the root of the hierarchy.
+    glm::vec3 parentCenter;
+    float parentRadius;
+    float parentError;
+};
+
+/// Node of a bounding volume hierarchy over the triangles of a model, for ray
+/// queries against its geometry. Nodes take 32 bytes, so that two of them
+/// share a cache line.
+///
+/// Layout is persisted as-is by the binary mesh cache. Bump the mesh cache
+/// format version when changing it.
+struct BvhNode
+{
+    glm::vec3 minimum;
+    /// First of two adjacent children of inner nodes, or first entry of leaf
+    /// triangles in the triangle order of the hierarchy.
+    std::uint32_t first;
+    glm::vec3 maximum;
+    /// Triangles of leaves, zero for inner nodes.
+    std::uint32_t triangleCount;
+};
+
+/// Optional processing steps of the import stage. Cached geometry is only
+/// reused when it was imported with the same options.
+struct ImportOptions
+{
+    /// Factory method creating options used by the application by default.
+    static ImportOptions createDefault()
+    {
+        return {
+            .optimizeMesh = true,
+            .packVertices = true,
+            .buildClusterLod = true,
+            .buildLodChain = true,
+            .buildBvh = false,
+            .smoothNormals = true,
+        };
+    }
+
+    /// Reorder triangles for post-transform vertex cache hits and reduced
+    /// overdraw, then reorder vertices to match fetch order.
+    bool optimizeMesh;
+    /// Store vertices as PackedVertex instead of Vertex.
+    bool packVertices;
+    /// Build cluster level of detail hierarchy for sub-meshes dense enough to
+    /// benefit from it.
+    bool buildClusterLod;
+    /// Build discrete level of detail chain for the remaining sub-meshes.
+    bool buildLodChain;
+    /// Build bounding volume hierarchy over full detail triangles for ray
+    /// queries on the CPU.
+    bool buildBvh;
+    /// Generate smooth normals on the thread pool for meshes without normals
+    /// of their own, instead of flat normals of the importer.
+    bool smoothNormals;
+};
+
+/// CPU-side mesh geometry produced by the import stage, ready to be uploaded
+/// into GPU buffers.
+///
+/// Producing mesh data does not involve graphics API calls, so it can be done
+/// on any thread. Vertices and indices are either owned by this object or
+/// reference a file mapping of the binary mesh cache. Depending on vertex
+/// format, either vertices() or packedVertices() holds the vertices, and
+/// depending on index type, either indices() or shortIndices() holds the
+/// indices. Bounding volume hierarchy is only present when it was built.
+///
+/// Non-copyable, move-only, because vertex and index views refer to the
+/// storage owned by this object.
+class MeshData
+{
+public:
+    /// Take ownership of imported vertices (Vertex or PackedVertex), indices
+    /// (GLuint or GLushort), sub-mesh ranges, meshlets and level of detail
+    /// chains. Bounds are the ones packed positions were quantized relative
+    /// to.
+    template <typename VertexType, typename IndexType>
+    static MeshData fromContainers(std::vector<VertexType>&& vertices,
+                                   std::vector<IndexType>&& indices,
+                                   std::vector<Submesh>&& submeshes,
+                                   std::vector<Meshlet>&& meshlets,
+                                   std::vector<SubmeshLod>&& lods,
+                                   const Bounds& bounds = {})
+    {
+        MeshData meshData;
+        meshData.own(std::move(vertices));
+        meshData.own(std::move(indices));
+        meshData.ownedSubmeshes_ = std::move(submeshes);
+        meshData.submeshes_ = meshData.ownedSubmeshes_;
+        meshData.ownedMeshlets_ = std::move(meshlets);
+        meshData.meshlets_ = meshData.ownedMeshlets_;
+        meshData.ownedLods_ = std::move(lods);
+        meshData.lods_ = meshData.ownedLods_;
+        meshData.bounds_ = bounds;
+        return meshData;
+    }
+
+    /// Keep file mapping alive for mesh data pointing into it.
+    template <typename VertexType, typename IndexType>
+    static MeshData fromMapping(MappedFile&& mapping,
+                                std::span<const VertexType> vertices,
+                                std::span<const IndexType> indices,
+                                std::span<const Submesh> submeshes,
+                                std::span<const Meshlet> meshlets,
+                                std::span<const SubmeshLod> lods,
+                                const Bounds& bounds = {},
+                                std::span<const BvhNode> bvhNodes = {},
+                                std::span<const GLuint> bvhTriangles = {},
+                                std::span<const std::byte> textureLayers = {})
+    {
+        MeshData meshData;
+        meshData.mapping_ = std::move(mapping);
+        meshData.view(vertices);
+        meshData.view(indices);
+        meshData.submeshes_ = submeshes;
+        meshData.meshlets_ = meshlets;
+        meshData.lods_ = lods;
+        meshData.bounds_ = bounds;
+        meshData.bvhNodes_ = bvhNodes;
+        meshData.bvhTriangles_ = bvhTriangles;
+        meshData.textureLayers_ = textureLayers;
+        return meshData;
+    }
+
+    /// Take ownership of bounding volume hierarchy built over the geometry.
+    void setBvh(std::vector<BvhNode>&& nodes, std::vector<GLuint>&& triangles)
+    {
+        ownedBvhNodes_ = std::move(nodes);
+        bvhNodes_ = ownedBvhNodes_;
+        ownedBvhTriangles_ = std::move(triangles);
+        bvhTriangles_ = ownedBvhTriangles_;
+    }
+
+    /// Take ownership of base color textures of materials.
+    void setTextureLayers(std::vector<std::byte>&& layers)
+    {
+        ownedTextureLayers_ = std::move(layers);
+        textureLayers_ = ownedTextureLayers_;
+    }
+
+    MeshData(const MeshData&) = delete;
+    MeshData& operator=(const MeshData&) = delete;
+    // Moving containers and file mapping keeps their underlying memory at the
+    // same address, so views stay valid.
+    MeshData(MeshData&&) noexcept = default;
+    MeshData& operator=(MeshData&&) noexcept = default;
+    ~MeshData() = default;
+
+    [[nodiscard]] VertexFormat vertexFormat() const { return vertexFormat_; }
+    [[nodiscard]] std::span<const Vertex> vertices() const { return vertices_; }
+    [[nodiscard]] std::span<const PackedVertex> packedVertices() const
+    {
+        return packedVertices_;
+    }
+    /// Raw bytes of vertices in either vertex format, to be passed to buffer
+    /// uploads.
+    [[nodiscard]] std::span<const std::byte> vertexData() const
+    {
+        return vertexFormat_ == VertexFormat::Packed
+                 ? std::as_bytes(packedVertices_)
+                 : std::as_bytes(vertices_);
+    }
+    [[nodiscard]] size_t vertexCount() const
+    {
+        return vertexFormat_ == VertexFormat::Packed ? packedVertices_.size()
+                                                     : vertices_.size();
+    }
+
+    /// GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+    [[nodiscard]] GLenum indexType() const { return indexType_; }
+    [[nodiscard]] std::span<const GLuint> indices() const { return indices_; }
+    [[nodiscard]] std::span<const GLushort> shortIndices() const
+    {
+        return shortIndices_;
+    }
+    /// Raw bytes of indices of either index type, to be passed to buffer
+    /// uploads.
+    [[nodiscard]] std::span<const std::byte> indexData() const
+    {
+        return indexType_ == GL_UNSIGNED_SHORT ? std::as_bytes(shortIndices_)
+                                               : std::as_bytes(indices_);
+    }
+    [[nodiscard]] size_t indexCount() const
+    {
+        return indexType_ == GL_UNSIGNED_SHORT ? shortIndices_.size()
+                                               : indices_.size();
+    }
+
+    [[nodiscard]] std::span<const Submesh> submeshes() const
+    {
+        return submeshes_;
+    }
+    [[nodiscard]] std::span<const Meshlet> meshlets() const
+    {
+        return meshlets_;
+    }
+    [[nodiscard]] std::span<const SubmeshLod> lods() const { return lods_; }
+    /// Bounding volume hierarchy over full detail triangles, with the
+    /// triangles referenced by its leaves. Triangles are numbered in sub-mesh
+    /// order. Empty unless built on import.
+    [[nodiscard]] std::span<const BvhNode> bvhNodes() const
+    {
+        return bvhNodes_;
+    }
+    [[nodiscard]] std::span<const GLuint> bvhTriangles() const
+    {
+        return bvhTriangles_;
+    }
+    /// Base color textures of materials, one layer after the other in the
+    /// layout of materialtexture, referred to by the texture layer of
+    /// sub-meshes. Empty when no material has a texture.
+    [[nodiscard]] std::span<const std::byte> textureLayers() const
+    {
+        return textureLayers_;
+    }
+    /// Bounding box packed positions are relative to. Unused for unpacked
+    /// vertices.
+    [[nodiscard]] const Bounds& bounds() const { return bounds_; }
+
+private:
+    MeshData()
+        : vertexFormat_{VertexFormat::Float}
+        , indexType_{GL_UNSIGNED_INT}
+        , bounds_{}
+    {
+    }
+
+    void view(std::span<const Vertex> vertices)
+    {
+        vertexFormat_ = VertexFormat::Float;
+        vertices_ = vertices;
+    }
+    void view(std::span<const PackedVertex> vertices)
+    {
+        vertexFormat_ = VertexFormat::Packed;
+        packedVertices_ = vertices;
+    }
+    void view(std::span<const GLuint> indices)
+    {
+        indexType_ = GL_UNSIGNED_INT;
+        indices_ = indices;
+    }
+    void view(std::span<const GLushort> indices)
+    {
+        indexType_ = GL_UNSIGNED_SHORT;
+        shortIndices_ = indices;
+    }
+
+    void own(std::vector<Vertex>&& vertices)
+    {
+        ownedVertices_ = std::move(vertices);
+        view(std::span<const Vertex>{ownedVertices_});
+    }
+    void own(std::vector<PackedVertex>&& vertices)
+    {
+        ownedPackedVertices_ = std::move(vertices);
+        view(std::span<const PackedVertex>{ownedPackedVertices_});
+    }
+    void own(std::vector<GLuint>&& indices)
+    {
+        ownedIndices_ = std::move(indices);
+        view(std::span<const GLuint>{ownedIndices_});
+    }
+    void own(std::vector<GLushort>&& indices)
+    {
+        ownedShortIndices_ = std::move(indices);
+        view(std::span<const GLushort>{ownedShortIndices_});
+    }
+
+    VertexFormat vertexFormat_;
+    GLenum indexType_;
+    Bounds bounds_;
+    std::vector<Vertex> ownedVertices_;
+    std::vector<PackedVertex> ownedPackedVertices_;
+    std::vector<GLuint> ownedIndices_;
+    std::vector<GLushort> ownedShortIndices_;
+    std::vector<Submesh> ownedSubmeshes_;
+    std::vector<Meshlet> ownedMeshlets_;
+    std::vector<SubmeshLod> ownedLods_;
+    std::vector<BvhNode> ownedBvhNodes_;
+    std::vector<GLuint> ownedBvhTriangles_;
+    std::vector<std::byte> ownedTextureLayers_;
+    std::optional<MappedFile> mapping_;
+    std::span<const Vertex> vertices_;
+    std::span<const PackedVertex> packedVertices_;
+    std::span<const GLuint> indices_;
+    std::span<const GLushort> shortIndices_;
+    std::span<const Submesh> submeshes_;
+    std::span<const Meshlet> meshlets_;
+    std::span<const SubmeshLod> lods_;
+    std::span<const BvhNode> bvhNodes_;
+    std::span<const GLuint> bvhTriangles_;
+    std::span<const std::byte> textureLayers_;
+};
+
+#endif
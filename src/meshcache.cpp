@@ -0,0 +1,487 @@
+#include "meshcache.h"
+
+#include "materialtexture.h"
+#include "utils.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'M', 'S', 'H', 'C'};
+// Increment on any change of Header, vertex or payload layout.
+constexpr uint32_t FORMAT_VERSION = 10;
+constexpr std::array<char, 4> PAGE_MAGIC{'C', 'P', 'G', 'C'};
+// Increment on any change of PageHeader, page or meshlet layout.
+constexpr uint32_t PAGE_FORMAT_VERSION = 2;
+
+struct Header
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t indexSize;
+    uint64_t sourceFileSize;
+    int64_t sourceModifiedTime;
+    uint64_t importOptions;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t submeshCount;
+    uint64_t meshletCount;
+    uint64_t lodCount;
+    uint64_t bvhNodeCount;
+    uint64_t bvhTriangleCount;
+    uint64_t textureLayerSize;
+    // Quantization bounds of packed vertices
+    std::array<float, 3> boundsMinimum;
+    std::array<float, 3> boundsMaximum;
+};
+/// Header of page file, followed by pages, paged meshlets and page payload.
+struct PageHeader
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t sourceFileSize;
+    int64_t sourceModifiedTime;
+    uint64_t importOptions;
+    uint64_t pageCount;
+    uint64_t meshletCount;
+    uint64_t payloadSize;
+    std::array<float, 3> boundsMinimum;
+    std::array<float, 3> boundsMaximum;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(std::is_trivially_copyable_v<PageHeader>);
+static_assert(std::is_trivially_copyable_v<clusterpages::ClusterPage>);
+static_assert(std::is_trivially_copyable_v<clusterpages::PagedMeshlet>);
+static_assert(std::is_trivially_copyable_v<Vertex>);
+static_assert(std::is_trivially_copyable_v<PackedVertex>);
+static_assert(std::is_trivially_copyable_v<Submesh>);
+static_assert(std::is_trivially_copyable_v<Meshlet>);
+static_assert(std::is_trivially_copyable_v<SubmeshLod>);
+static_assert(std::is_trivially_copyable_v<BvhNode>);
+
+/// Identity of source mesh file revision used for cache invalidation.
+struct SourceStamp
+{
+    uint64_t fileSize;
+    int64_t modifiedTime;
+};
+
+/// Bit mask of import options affecting the stored geometry.
+uint64_t encodeImportOptions(const ImportOptions& options)
+{
+    return (options.optimizeMesh ? 1U : 0U) | (options.packVertices ? 2U : 0U)
+         | (options.buildClusterLod ? 4U : 0U)
+         | (options.buildLodChain ? 8U : 0U) | (options.buildBvh ? 16U : 0U)
+         | (options.smoothNormals ? 32U : 0U);
+}
+
+std::optional<SourceStamp> querySourceStamp(const fs::path& sourcePath)
+{
+    std::error_code error;
+    const uintmax_t fileSize = fs::file_size(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+    const fs::file_time_type modifiedTime
+        = fs::last_write_time(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+
+    return SourceStamp{
+        .fileSize = static_cast<uint64_t>(fileSize),
+        .modifiedTime
+        = static_cast<int64_t>(modifiedTime.time_since_epoch().count()),
+    };
+}
+/// Index array is padded to keep the sub-mesh ranges following it aligned.
+uint64_t paddedIndexDataSize(uint64_t indexCount, uint64_t indexSize)
+{
+    constexpr uint64_t alignment = alignof(Submesh);
+    return (indexCount * indexSize + alignment - 1) / alignment * alignment;
+}
+
+/// Write file contents into temporary file first and rename afterwards, so
+/// that an interrupted write never leaves a half-written cache entry behind.
+template <typename F>
+bool replaceFile(const fs::path& path, F&& writeContents)
+{
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        writeContents(file);
+        if (!file)
+        {
+            utils::logWarning("unable to write mesh cache ", temporaryPath);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temporaryPath, path, error);
+    if (error)
+    {
+        utils::logWarning("unable to write mesh cache ",
+                          path,
+                          ": ",
+                          error.message());
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+void writeSpan(std::ofstream& file, std::span<const T> values)
+{
+    file.write(reinterpret_cast<const char*>(values.data()),
+               static_cast<std::streamsize>(values.size_bytes()));
+}
+
+template <typename VertexType, typename IndexType>
+MeshData mapPayload(MappedFile&& file, const Header& header)
+{
+    // Payload offsets are suitably aligned, because header size is a multiple
+    // of vertex and index alignment, and mappings start at page boundary.
+    static_assert(sizeof(Header) % alignof(VertexType) == 0);
+    static_assert(sizeof(VertexType) % alignof(IndexType) == 0);
+    const std::byte* vertexData = file.data() + sizeof(Header);
+    const std::byte* indexData
+        = vertexData + header.vertexCount * sizeof(VertexType);
+    const std::byte* submeshData
+        = indexData + paddedIndexDataSize(header.indexCount, sizeof(IndexType));
+    static_assert(sizeof(Submesh) % alignof(Meshlet) == 0);
+    const std::byte* meshletData
+        = submeshData + header.submeshCount * sizeof(Submesh);
+    static_assert(sizeof(Meshlet) % alignof(SubmeshLod) == 0);
+    const std::byte* lodData
+        = meshletData + header.meshletCount * sizeof(Meshlet);
+    static_assert(sizeof(SubmeshLod) % alignof(BvhNode) == 0);
+    const std::byte* bvhNodeData
+        = lodData + header.lodCount * sizeof(SubmeshLod);
+    static_assert(sizeof(BvhNode) % alignof(GLuint) == 0);
+    const std::byte* bvhTriangleData
+        = bvhNodeData + header.bvhNodeCount * sizeof(BvhNode);
+    const std::byte* textureLayerData
+        = bvhTriangleData + header.bvhTriangleCount * sizeof(GLuint);
+
+    const Bounds bounds{
+        .minimum = glm::vec3{header.boundsMinimum[0],
+                             header.boundsMinimum[1],
+                             header.boundsMinimum[2]},
+        .maximum = glm::vec3{header.boundsMaximum[0],
+                             header.boundsMaximum[1],
+                             header.boundsMaximum[2]},
+    };
+    return MeshData::fromMapping(
+        std::move(file),
+        std::span{reinterpret_cast<const VertexType*>(vertexData),
+                  static_cast<size_t>(header.vertexCount)},
+        std::span{reinterpret_cast<const IndexType*>(indexData),
+                  static_cast<size_t>(header.indexCount)},
+        std::span{reinterpret_cast<const Submesh*>(submeshData),
+                  static_cast<size_t>(header.submeshCount)},
+        std::span{reinterpret_cast<const Meshlet*>(meshletData),
+                  static_cast<size_t>(header.meshletCount)},
+        std::span{reinterpret_cast<const SubmeshLod*>(lodData),
+                  static_cast<size_t>(header.lodCount)},
+        bounds,
+        std::span{reinterpret_cast<const BvhNode*>(bvhNodeData),
+                  static_cast<size_t>(header.bvhNodeCount)},
+        std::span{reinterpret_cast<const GLuint*>(bvhTriangleData),
+                  static_cast<size_t>(header.bvhTriangleCount)},
+        std::span{textureLayerData,
+                  static_cast<size_t>(header.textureLayerSize)});
+}
+}  // namespace
+
+namespace meshcache
+{
+fs::path cachePath(const fs::path& sourcePath)
+{
+    fs::path path = sourcePath;
+    path += ".meshcache";
+    return path;
+}
+
+fs::path pageCachePath(const fs::path& sourcePath)
+{
+    fs::path path = sourcePath;
+    path += ".pagecache";
+    return path;
+}
+
+std::optional<MeshData> map(const fs::path& sourcePath,
+                            const ImportOptions& options)
+{
+    const std::optional<SourceStamp> stamp = querySourceStamp(sourcePath);
+    if (!stamp)
+    {
+        return std::nullopt;
+    }
+
+    std::optional<MappedFile> file = MappedFile::open(cachePath(sourcePath));
+    if (!file || file->size() < sizeof(Header))
+    {
+        return std::nullopt;
+    }
+
+    const size_t vertexSize
+        = options.packVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(Header));
+    if (header.magic != MAGIC || header.version != FORMAT_VERSION
+        || header.vertexSize != vertexSize
+        || (header.indexSize != sizeof(GLuint)
+            && header.indexSize != sizeof(GLushort))
+        || header.sourceFileSize != stamp->fileSize
+        || header.sourceModifiedTime != stamp->modifiedTime
+        || header.importOptions != encodeImportOptions(options))
+    {
+        return std::nullopt;
+    }
+
+    // Reject truncated files before trusting counts stored in header
+    const uint64_t vertexDataSize = header.vertexCount * vertexSize;
+    const uint64_t indexDataSize
+        = paddedIndexDataSize(header.indexCount, header.indexSize);
+    const uint64_t submeshDataSize = header.submeshCount * sizeof(Submesh);
+    const uint64_t meshletDataSize = header.meshletCount * sizeof(Meshlet);
+    const uint64_t lodDataSize = header.lodCount * sizeof(SubmeshLod);
+    const uint64_t bvhDataSize = header.bvhNodeCount * sizeof(BvhNode)
+                               + header.bvhTriangleCount * sizeof(GLuint);
+    if (file->size() != sizeof(Header) + vertexDataSize + indexDataSize
+                            + submeshDataSize + meshletDataSize + lodDataSize
+                            + bvhDataSize + header.textureLayerSize
+        || header.textureLayerSize % materialtexture::LAYER_BYTE_SIZE != 0)
+    {
+        return std::nullopt;
+    }
+
+    const bool shortIndices = header.indexSize == sizeof(GLushort);
+    if (options.packVertices)
+    {
+        return shortIndices
+                 ? mapPayload<PackedVertex, GLushort>(std::move(*file), header)
+                 : mapPayload<PackedVertex, GLuint>(std::move(*file), header);
+    }
+    return shortIndices ? mapPayload<Vertex, GLushort>(std::move(*file), header)
+                        : mapPayload<Vertex, GLuint>(std::move(*file), header);
+}
+
+bool store(const fs::path& sourcePath,
+           const ImportOptions& options,
+           const MeshData& meshData)
+{
+    const std::span<const std::byte> vertexData = meshData.vertexData();
+    const std::span<const std::byte> indexData = meshData.indexData();
+    const std::span<const Submesh> submeshes = meshData.submeshes();
+    const std::span<const Meshlet> meshlets = meshData.meshlets();
+    const std::span<const SubmeshLod> lods = meshData.lods();
+    const std::span<const BvhNode> bvhNodes = meshData.bvhNodes();
+    const std::span<const GLuint> bvhTriangles = meshData.bvhTriangles();
+    const std::span<const std::byte> textureLayers = meshData.textureLayers();
+    const Bounds& bounds = meshData.bounds();
+    const std::optional<SourceStamp> stamp = querySourceStamp(sourcePath);
+    if (!stamp)
+    {
+        return false;
+    }
+
+    const Header header{
+        .magic = MAGIC,
+        .version = FORMAT_VERSION,
+        .vertexSize = static_cast<uint32_t>(
+            meshData.vertexFormat() == VertexFormat::Packed
+                ? sizeof(PackedVertex)
+                : sizeof(Vertex)),
+        .indexSize = static_cast<uint32_t>(
+            meshData.indexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort)
+                                                      : sizeof(GLuint)),
+        .sourceFileSize = stamp->fileSize,
+        .sourceModifiedTime = stamp->modifiedTime,
+        .importOptions = encodeImportOptions(options),
+        .vertexCount = meshData.vertexCount(),
+        .indexCount = meshData.indexCount(),
+        .submeshCount = submeshes.size(),
+        .meshletCount = meshlets.size(),
+        .lodCount = lods.size(),
+        .bvhNodeCount = bvhNodes.size(),
+        .bvhTriangleCount = bvhTriangles.size(),
+        .textureLayerSize = textureLayers.size(),
+        .boundsMinimum = {bounds.minimum.x, bounds.minimum.y, bounds.minimum.z},
+        .boundsMaximum = {bounds.maximum.x, bounds.maximum.y, bounds.maximum.z},
+    };
+
+    return replaceFile(
+        cachePath(sourcePath),
+        [&](std::ofstream& file)
+        {
+            file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            writeSpan(file, vertexData);
+            writeSpan(file, indexData);
+            constexpr std::array<char, alignof(Submesh)> padding{};
+            file.write(padding.data(),
+                       static_cast<std::streamsize>(
+                           paddedIndexDataSize(header.indexCount,
+                                               header.indexSize)
+                           - indexData.size_bytes()));
+            writeSpan(file, submeshes);
+            writeSpan(file, meshlets);
+            writeSpan(file, lods);
+            writeSpan(file, bvhNodes);
+            writeSpan(file, bvhTriangles);
+            writeSpan(file, textureLayers);
+        });
+}
+
+std::optional<clusterpages::PagedMesh> mapPages(const fs::path& sourcePath,
+                                                const ImportOptions& options)
+{
+    const std::optional<SourceStamp> stamp = querySourceStamp(sourcePath);
+    if (!stamp)
+    {
+        return std::nullopt;
+    }
+
+    std::optional<MappedFile> file
+        = MappedFile::open(pageCachePath(sourcePath));
+    if (!file || file->size() < sizeof(PageHeader))
+    {
+        return std::nullopt;
+    }
+
+    PageHeader header;
+    std::memcpy(&header, file->data(), sizeof(PageHeader));
+    if (header.magic != PAGE_MAGIC || header.version != PAGE_FORMAT_VERSION
+        || header.sourceFileSize != stamp->fileSize
+        || header.sourceModifiedTime != stamp->modifiedTime
+        || header.importOptions != encodeImportOptions(options))
+    {
+        return std::nullopt;
+    }
+
+    // Tables are suitably aligned, because each size is a multiple of the
+    // alignment of what follows, and mappings start at page boundary
+    static_assert(sizeof(PageHeader) % alignof(clusterpages::ClusterPage)
+                  == 0);
+    static_assert(sizeof(clusterpages::ClusterPage)
+                      % alignof(clusterpages::PagedMeshlet)
+                  == 0);
+    static_assert(sizeof(clusterpages::PagedMeshlet) % alignof(PackedVertex)
+                  == 0);
+    const uint64_t pageDataSize
+        = header.pageCount * sizeof(clusterpages::ClusterPage);
+    const uint64_t meshletDataSize
+        = header.meshletCount * sizeof(clusterpages::PagedMeshlet);
+    if (file->size() != sizeof(PageHeader) + pageDataSize + meshletDataSize
+                            + header.payloadSize)
+    {
+        return std::nullopt;
+    }
+
+    const std::byte* pageData = file->data() + sizeof(PageHeader);
+    const std::byte* meshletData = pageData + pageDataSize;
+    const std::byte* payloadData = meshletData + meshletDataSize;
+    clusterpages::PagedMesh pagedMesh{
+        .bounds = {
+            .minimum = glm::vec3{header.boundsMinimum[0],
+                                 header.boundsMinimum[1],
+                                 header.boundsMinimum[2]},
+            .maximum = glm::vec3{header.boundsMaximum[0],
+                                 header.boundsMaximum[1],
+                                 header.boundsMaximum[2]},
+        },
+        .pages = std::span{
+            reinterpret_cast<const clusterpages::ClusterPage*>(pageData),
+            static_cast<size_t>(header.pageCount)},
+        .meshlets = std::span{
+            reinterpret_cast<const clusterpages::PagedMeshlet*>(meshletData),
+            static_cast<size_t>(header.meshletCount)},
+        .payload = std::span{payloadData,
+                             static_cast<size_t>(header.payloadSize)},
+        .file = nullptr,
+    };
+    // Reject pages and meshlets out of range before trusting them
+    for (const clusterpages::ClusterPage& page : pagedMesh.pages)
+    {
+        if (page.dataOffset
+                    + clusterpages::PagedMesh::pageDataSize(page)
+                > header.payloadSize
+            || page.firstMeshlet + static_cast<uint64_t>(page.meshletCount)
+                   > header.meshletCount)
+        {
+            return std::nullopt;
+        }
+    }
+    for (const clusterpages::PagedMeshlet& meshlet : pagedMesh.meshlets)
+    {
+        const clusterpages::ClusterPage* page
+            = meshlet.page < header.pageCount ? &pagedMesh.pages[meshlet.page]
+                                              : nullptr;
+        if (!page
+            || (meshlet.childPage != clusterpages::NO_PAGE
+                && meshlet.childPage >= header.pageCount)
+            || meshlet.meshlet.firstIndex
+                       + static_cast<uint64_t>(meshlet.meshlet.indexCount)
+                   > page->indexCount)
+        {
+            return std::nullopt;
+        }
+    }
+    pagedMesh.file = std::make_shared<const MappedFile>(std::move(*file));
+    return pagedMesh;
+}
+
+bool storePages(const fs::path& sourcePath,
+                const ImportOptions& options,
+                const Bounds& bounds,
+                std::span<const clusterpages::ClusterPage> pages,
+                std::span<const clusterpages::PagedMeshlet> meshlets,
+                std::span<const std::byte> payload)
+{
+    const std::optional<SourceStamp> stamp = querySourceStamp(sourcePath);
+    if (!stamp)
+    {
+        return false;
+    }
+
+    const PageHeader header{
+        .magic = PAGE_MAGIC,
+        .version = PAGE_FORMAT_VERSION,
+        .sourceFileSize = stamp->fileSize,
+        .sourceModifiedTime = stamp->modifiedTime,
+        .importOptions = encodeImportOptions(options),
+        .pageCount = pages.size(),
+        .meshletCount = meshlets.size(),
+        .payloadSize = payload.size(),
+        .boundsMinimum = {bounds.minimum.x, bounds.minimum.y, bounds.minimum.z},
+        .boundsMaximum = {bounds.maximum.x, bounds.maximum.y, bounds.maximum.z},
+    };
+    return replaceFile(
+        pageCachePath(sourcePath),
+        [&](std::ofstream& file)
+        {
+            file.write(reinterpret_cast<const char*>(&header),
+                       sizeof(PageHeader));
+            writeSpan(file, pages);
+            writeSpan(file, meshlets);
+            writeSpan(file, payload);
+        });
+}
+}  // namespace meshcache
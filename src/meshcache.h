@@ -0,0 +1,67 @@
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include "clusterpages.h"
+#include "mesh.h"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+
+/// Versioned binary mesh cache to avoid parsing text-based mesh formats (like
+/// OBJ) through Assimp on every application launch.
+///
+/// Cache file is placed next to the source mesh file and contains a fixed-size
+/// header followed by the interleaved vertex array, the index array, the
+/// sub-mesh ranges, the meshlets of cluster level of detail hierarchies and
+/// the levels of discrete level of detail chains, followed by the nodes and
+/// triangle order of the bounding volume hierarchy, stored exactly as they are
+/// laid out in memory, so that the file can be memory mapped and uploaded to
+/// GPU buffers as-is. A cache entry is considered stale when the size or
+/// modification time of the source file differs from what is recorded in the
+/// header, or when the cache format version or the import options changed.
+///
+/// Cluster pages of meshes streamed out-of-core are stored in a page file
+/// next to the cache file, invalidated the same way. Page tables are followed
+/// by the payload of all pages, so that pages are read from the mapping
+/// individually as they are streamed in.
+namespace meshcache
+{
+/// Location of the cache file belonging to a source mesh file.
+std::filesystem::path cachePath(const std::filesystem::path& sourcePath);
+/// Location of the page file belonging to a source mesh file.
+std::filesystem::path pageCachePath(const std::filesystem::path& sourcePath);
+
+/// Map geometry of a previously imported mesh. Returned mesh data points into
+/// the file mapping, allowing it to be passed straight to buffer uploads
+/// without intermediate copies. Returns nothing when cache entry is
+/// missing, stale or corrupted, in which case the caller is expected to import
+/// the source file and store the result.
+std::optional<MeshData> map(const std::filesystem::path& sourcePath,
+                            const ImportOptions& options);
+
+/// Persist imported mesh for subsequent launches. Failure to write the cache
+/// is not fatal, the mesh is imported again on next launch.
+bool store(const std::filesystem::path& sourcePath,
+           const ImportOptions& options,
+           const MeshData& meshData);
+
+/// Map cluster pages of a previously imported mesh. Returns nothing when page
+/// file is missing, stale or corrupted, in which case the caller is expected
+/// to build the pages and store them.
+std::optional<clusterpages::PagedMesh> mapPages(
+    const std::filesystem::path& sourcePath,
+    const ImportOptions& options);
+
+/// Persist cluster pages built from imported mesh. Pages can only be streamed
+/// from the page file, so failure to write it leaves the mesh to be loaded
+/// whole.
+bool storePages(const std::filesystem::path& sourcePath,
+                const ImportOptions& options,
+                const Bounds& bounds,
+                std::span<const clusterpages::ClusterPage> pages,
+                std::span<const clusterpages::PagedMeshlet> meshlets,
+                std::span<const std::byte> payload);
+}  // namespace meshcache
+
+#endif
@@ -0,0 +1,244 @@
+#include "meshcodec.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+
+namespace
+{
+using meshcodec::BLOCK_SIZE;
+
+/// Words of a block before the differences of its channels.
+constexpr std::uint32_t headerSize(std::uint32_t channelCount)
+{
+    return channelCount + (channelCount + 3) / 4;
+}
+
+/// Signed 10-bit and 2-bit normal components are offset into unsigned
+/// range, so that small negative and positive values are close together.
+constexpr std::uint32_t SNORM10_OFFSET = 0x200;
+constexpr std::uint32_t SNORM2_OFFSET = 0x2;
+constexpr std::uint32_t SNORM10_MASK = 0x3FF;
+
+std::array<std::uint32_t, meshcodec::VERTEX_CHANNEL_COUNT> splitVertex(
+    const PackedVertex& vertex)
+{
+    return {vertex.position[0],
+            vertex.position[1],
+            vertex.position[2],
+            (vertex.normal & SNORM10_MASK) ^ SNORM10_OFFSET,
+            ((vertex.normal >> 10) & SNORM10_MASK) ^ SNORM10_OFFSET,
+            ((vertex.normal >> 20) & SNORM10_MASK) ^ SNORM10_OFFSET,
+            (vertex.normal >> 30) ^ SNORM2_OFFSET,
+            vertex.texCoord[0],
+            vertex.texCoord[1]};
+}
+
+PackedVertex mergeVertex(
+    const std::array<std::array<std::uint32_t, BLOCK_SIZE>,
+                     meshcodec::VERTEX_CHANNEL_COUNT>& channels,
+    std::uint32_t lane)
+{
+    return PackedVertex{
+        .position = {static_cast<std::uint16_t>(channels[0][lane]),
+                     static_cast<std::uint16_t>(channels[1][lane]),
+                     static_cast<std::uint16_t>(channels[2][lane]),
+                     0},
+        .normal = ((channels[3][lane] ^ SNORM10_OFFSET) & SNORM10_MASK)
+                | (((channels[4][lane] ^ SNORM10_OFFSET) & SNORM10_MASK) << 10)
+                | (((channels[5][lane] ^ SNORM10_OFFSET) & SNORM10_MASK) << 20)
+                | ((channels[6][lane] ^ SNORM2_OFFSET) << 30),
+        .texCoord = {static_cast<std::uint16_t>(channels[7][lane]),
+                     static_cast<std::uint16_t>(channels[8][lane])},
+    };
+}
+
+/// Set value of given bit width at bit offset of zeroed words. Values of
+/// full word width always start at a word boundary.
+void writeBits(std::span<std::uint32_t> words,
+               std::uint32_t bitOffset,
+               std::uint32_t value,
+               std::uint32_t width)
+{
+    const std::uint32_t word = bitOffset / 32;
+    const std::uint32_t shift = bitOffset % 32;
+    words[word] |= value << shift;
+    if (shift + width > 32)
+    {
+        words[word + 1] |= value >> (32 - shift);
+    }
+}
+
+template <std::uint32_t ChannelCount, typename Element, typename Split>
+std::vector<std::uint32_t> encode(std::span<const Element> elements,
+                                  Split split)
+{
+    const auto elementCount = static_cast<std::uint32_t>(elements.size());
+    const std::uint32_t blockCount = meshcodec::blockCount(elementCount);
+    // Block offsets come first, filled in as blocks are appended
+    std::vector<std::uint32_t> stream(blockCount, 0);
+    std::array<std::array<std::uint32_t, BLOCK_SIZE>, ChannelCount> values{};
+    for (std::uint32_t block = 0; block < blockCount; ++block)
+    {
+        stream[block] = static_cast<std::uint32_t>(stream.size());
+        const std::uint32_t first = block * BLOCK_SIZE;
+        const std::uint32_t count = std::min(BLOCK_SIZE, elementCount - first);
+        for (std::uint32_t lane = 0; lane < count; ++lane)
+        {
+            const auto channels = split(elements[first + lane]);
+            for (std::uint32_t channel = 0; channel < ChannelCount; ++channel)
+            {
+                values[channel][lane] = channels[channel];
+            }
+        }
+
+        std::array<std::uint32_t, ChannelCount> minimums{};
+        std::array<std::uint32_t, ChannelCount> widths{};
+        for (std::uint32_t channel = 0; channel < ChannelCount; ++channel)
+        {
+            const auto [minimum, maximum] = std::minmax_element(
+                values[channel].begin(),
+                values[channel].begin() + count);
+            minimums[channel] = *minimum;
+            widths[channel] = static_cast<std::uint32_t>(
+                std::bit_width(*maximum - *minimum));
+        }
+        stream.insert(stream.end(), minimums.begin(), minimums.end());
+        for (std::uint32_t channel = 0; channel < ChannelCount; channel += 4)
+        {
+            std::uint32_t packedWidths = 0;
+            for (std::uint32_t i = channel;
+                 i < std::min(channel + 4, ChannelCount);
+                 ++i)
+            {
+                packedWidths |= widths[i] << ((i - channel) * 8);
+            }
+            stream.push_back(packedWidths);
+        }
+        for (std::uint32_t channel = 0; channel < ChannelCount; ++channel)
+        {
+            const std::uint32_t width = widths[channel];
+            const size_t channelStart = stream.size();
+            // Block of 64 values takes exactly two words per bit of width
+            stream.resize(channelStart + size_t{2} * width, 0);
+            const std::span<std::uint32_t> words
+                = std::span{stream}.subspan(channelStart);
+            for (std::uint32_t lane = 0; lane < count; ++lane)
+            {
+                writeBits(words,
+                          lane * width,
+                          values[channel][lane] - minimums[channel],
+                          width);
+            }
+        }
+    }
+    return stream;
+}
+
+/// Unpack every lane of a channel, including those past the last element.
+/// Words are copied into a padded array first, so that each lane reads the
+/// pair of words its bits fall into without a branch.
+void unpackChannel(std::span<const std::uint32_t> words,
+                   std::uint32_t width,
+                   std::uint32_t minimum,
+                   std::array<std::uint32_t, BLOCK_SIZE>& values)
+{
+    // Channels of full word width take a word per lane
+    std::array<std::uint32_t, BLOCK_SIZE + 1> padded{};
+    std::ranges::copy(words, padded.begin());
+    const std::uint64_t mask = (std::uint64_t{1} << width) - 1;
+    for (std::uint32_t lane = 0; lane < BLOCK_SIZE; ++lane)
+    {
+        const std::uint32_t bitOffset = lane * width;
+        const std::uint32_t word = bitOffset / 32;
+        const std::uint64_t pair
+            = padded[word] | (std::uint64_t{padded[word + 1]} << 32);
+        values[lane]
+            = minimum
+            + static_cast<std::uint32_t>((pair >> (bitOffset % 32)) & mask);
+    }
+}
+
+template <std::uint32_t ChannelCount, typename Element, typename Merge>
+bool decode(std::span<const std::uint32_t> stream,
+            std::span<Element> elements,
+            Merge merge)
+{
+    const auto elementCount = static_cast<std::uint32_t>(elements.size());
+    const std::uint32_t blockCount = meshcodec::blockCount(elementCount);
+    if (stream.size() < blockCount)
+    {
+        return false;
+    }
+    std::array<std::array<std::uint32_t, BLOCK_SIZE>, ChannelCount> values{};
+    for (std::uint32_t block = 0; block < blockCount; ++block)
+    {
+        const std::uint32_t offset = stream[block];
+        if (offset > stream.size()
+            || stream.size() - offset < headerSize(ChannelCount))
+        {
+            return false;
+        }
+        const std::span<const std::uint32_t> minimums
+            = stream.subspan(offset, ChannelCount);
+        size_t channelStart = offset + headerSize(ChannelCount);
+        for (std::uint32_t channel = 0; channel < ChannelCount; ++channel)
+        {
+            const std::uint32_t width
+                = (stream[offset + ChannelCount + channel / 4]
+                   >> ((channel % 4) * 8))
+                & 0xFF;
+            if (width > 32 || stream.size() - channelStart < size_t{2} * width)
+            {
+                return false;
+            }
+            unpackChannel(stream.subspan(channelStart, size_t{2} * width),
+                          width,
+                          minimums[channel],
+                          values[channel]);
+            channelStart += size_t{2} * width;
+        }
+
+        const std::uint32_t first = block * BLOCK_SIZE;
+        const std::uint32_t count = std::min(BLOCK_SIZE, elementCount - first);
+        for (std::uint32_t lane = 0; lane < count; ++lane)
+        {
+            elements[first + lane] = merge(values, lane);
+        }
+    }
+    return true;
+}
+}  // namespace
+
+namespace meshcodec
+{
+std::vector<std::uint32_t> encodeVertices(
+    std::span<const PackedVertex> vertices)
+{
+    return encode<VERTEX_CHANNEL_COUNT>(vertices, splitVertex);
+}
+
+std::vector<std::uint32_t> encodeIndices(std::span<const GLuint> indices)
+{
+    return encode<INDEX_CHANNEL_COUNT>(
+        indices,
+        [](GLuint index) { return std::array<std::uint32_t, 1>{index}; });
+}
+
+bool decodeVertices(std::span<const std::uint32_t> stream,
+                    std::span<PackedVertex> vertices)
+{
+    return decode<VERTEX_CHANNEL_COUNT>(stream, vertices, mergeVertex);
+}
+
+bool decodeIndices(std::span<const std::uint32_t> stream,
+                   std::span<GLuint> indices)
+{
+    return decode<INDEX_CHANNEL_COUNT>(
+        stream,
+        indices,
+        [](const std::array<std::array<std::uint32_t, BLOCK_SIZE>, 1>& values,
+           std::uint32_t lane) { return GLuint{values[0][lane]}; });
+}
+}  // namespace meshcodec
@@ -0,0 +1,63 @@
+#ifndef MESH_CODEC_H_
+#define MESH_CODEC_H_
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// Lossless compression of packed vertex and index streams, so that fewer
+/// bytes cross the bus or the network, decodable block by block in parallel
+/// on the CPU or by a compute shader.
+///
+/// Elements are split into blocks of BLOCK_SIZE, and each element into
+/// channels of up to 32 bits: quantized position components, normal
+/// components and half float texture coordinates of packed vertices, or the
+/// index itself. Every channel of a
+/// block is stored as the smallest value of the block followed by the
+/// difference of each element from it, bit-packed at the width of the
+/// largest difference. Neighbouring vertices are close after the locality
+/// optimizations of the importer, and so are the vertices triangles nearby
+/// in index order refer to, so that differences take a fraction of the
+/// width of their channel. Unlike differences from the previous element,
+/// differences from the block minimum decode without a prefix sum, every
+/// element on its own.
+///
+/// A stream starts with the word offset of each block from the start of the
+/// stream. A block holds the minimum of each channel, the bit width of each
+/// channel as bytes packed into words, then the differences of each channel
+/// in turn, taking twice its width in words. Elements past the end of the
+/// last block are zero differences. Layout is persisted as-is by
+/// progressive mesh files and read by the decoder shader, so both have to
+/// be changed together with it.
+///
+/// Padding of packed vertex positions is not stored, and decodes as zero.
+namespace meshcodec
+{
+/// Elements per block, decoded by one work group of the decoder shader.
+inline constexpr std::uint32_t BLOCK_SIZE = 64;
+/// Quantized position components, signed normal components moved into
+/// unsigned range, and bits of texture coordinates.
+inline constexpr std::uint32_t VERTEX_CHANNEL_COUNT = 9;
+inline constexpr std::uint32_t INDEX_CHANNEL_COUNT = 1;
+
+[[nodiscard]] constexpr std::uint32_t blockCount(std::uint32_t elementCount)
+{
+    return (elementCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+std::vector<std::uint32_t> encodeVertices(
+    std::span<const PackedVertex> vertices);
+std::vector<std::uint32_t> encodeIndices(std::span<const GLuint> indices);
+
+/// Decode stream holding as many elements as the output has room for.
+/// Returns false when the stream is truncated or corrupted, leaving the
+/// output partially written.
+bool decodeVertices(std::span<const std::uint32_t> stream,
+                    std::span<PackedVertex> vertices);
+bool decodeIndices(std::span<const std::uint32_t> stream,
+                   std::span<GLuint> indices);
+}  // namespace meshcodec
+
+#endif
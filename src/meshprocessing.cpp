@@ -0,0 +1,557 @@
+#include "meshprocessing.h"
+
+#include "threadpool.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace
+{
+// Scoring parameters suggested by Forsyth. Cache size is the simulated LRU
+// cache, which is robust to the actual cache size of the GPU.
+constexpr size_t VERTEX_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5F;
+constexpr float LAST_TRIANGLE_SCORE = 0.75F;
+constexpr float VALENCE_BOOST_SCALE = 2.0F;
+constexpr float VALENCE_BOOST_POWER = 0.5F;
+
+// Conservative FIFO cache size of older GPUs for finding cluster boundaries
+constexpr uint32_t FIFO_CACHE_SIZE = 16;
+
+constexpr size_t NO_TRIANGLE = std::numeric_limits<size_t>::max();
+
+// Triangles summed into a partial normal array of their own. Fewer triangles
+// per range would cost more in clearing and reducing partial sums than they
+// gain in parallelism.
+constexpr size_t NORMAL_RANGE_MIN_TRIANGLE_COUNT = 16384;
+// Vertices whose partial normal sums are reduced by a single task
+constexpr size_t NORMAL_REDUCTION_BATCH_SIZE = 16384;
+
+// Largest magnitude of 16-bit unsigned and 10-bit signed normalized values
+constexpr float UNORM16_MAX = 65535.0F;
+constexpr float SNORM10_MAX = 511.0F;
+
+float scoreVertex(int cachePosition, uint32_t remainingTriangleCount)
+{
+    if (remainingTriangleCount == 0)
+    {
+        return -1.0F;  // No triangle left to be emitted
+    }
+
+    float score = 0.0F;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+        {
+            // Vertices of the last emitted triangle get a fixed, lower score,
+            // otherwise the next triangle would always be one sharing an edge
+            // with the last one, resulting in long strips instead of
+            // compact patches.
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            const float scale
+                = 1.0F / static_cast<float>(VERTEX_CACHE_SIZE - 3);
+            score = std::pow(
+                1.0F - static_cast<float>(cachePosition - 3) * scale,
+                CACHE_DECAY_POWER);
+        }
+    }
+
+    // Favor vertices with few triangles left to finish them off, so that
+    // lone triangles are not left behind requiring vertices to be reloaded.
+    score += VALENCE_BOOST_SCALE
+           * std::pow(static_cast<float>(remainingTriangleCount),
+                      -VALENCE_BOOST_POWER);
+    return score;
+}
+
+uint16_t packUnorm16(float value)
+{
+    return static_cast<uint16_t>(
+        std::round(std::clamp(value, 0.0F, UNORM16_MAX)));
+}
+
+uint32_t packSnorm10(float value)
+{
+    const auto quantized = static_cast<int32_t>(
+        std::round(std::clamp(value, -1.0F, 1.0F) * SNORM10_MAX));
+    // Two's complement bits of the 10-bit value
+    return static_cast<uint32_t>(quantized) & 0x3FFU;
+}
+
+float scoreTriangle(const GLuint* triangle,
+                    const std::vector<float>& vertexScores)
+{
+    return vertexScores[triangle[0]] + vertexScores[triangle[1]]
+         + vertexScores[triangle[2]];
+}
+}  // namespace
+
+namespace meshprocessing
+{
+void optimizeVertexCache(std::span<GLuint> indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Triangles adjacent to each vertex, stored as consecutive ranges of a
+    // single array. Emitted triangles are removed by shrinking the range.
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (const GLuint index : indices)
+    {
+        ++adjacencyOffsets[index + 1];
+    }
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    }
+    std::vector<uint32_t> adjacentTriangles(indices.size());
+    std::vector<uint32_t> remainingTriangleCounts(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        const GLuint vertex = indices[i];
+        adjacentTriangles[adjacencyOffsets[vertex]
+                          + remainingTriangleCounts[vertex]++]
+            = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        vertexScores[i] = scoreVertex(-1, remainingTriangleCounts[i]);
+    }
+
+    size_t bestTriangle = 0;
+    float bestScore = scoreTriangle(indices.data(), vertexScores);
+    for (size_t i = 1; i < triangleCount; ++i)
+    {
+        const float score = scoreTriangle(&indices[i * 3], vertexScores);
+        if (score > bestScore)
+        {
+            bestTriangle = i;
+            bestScore = score;
+        }
+    }
+
+    std::vector<GLuint> optimizedIndices;
+    optimizedIndices.reserve(indices.size());
+    std::vector<bool> emitted(triangleCount, false);
+    size_t fallbackCursor = 0;
+    // Cache includes room for the vertices of the triangle being emitted, the
+    // excess is evicted.
+    std::array<GLuint, VERTEX_CACHE_SIZE + 3> cache{};
+    std::array<GLuint, VERTEX_CACHE_SIZE + 3> nextCache{};
+    size_t cacheCount = 0;
+    while (bestTriangle != NO_TRIANGLE)
+    {
+        emitted[bestTriangle] = true;
+        const GLuint* triangle = &indices[bestTriangle * 3];
+
+        size_t nextCacheCount = 0;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const GLuint vertex = triangle[i];
+            optimizedIndices.push_back(vertex);
+
+            const auto adjacencyBegin
+                = adjacentTriangles.begin() + adjacencyOffsets[vertex];
+            const auto adjacencyEnd
+                = adjacencyBegin + remainingTriangleCounts[vertex];
+            *std::find(adjacencyBegin, adjacencyEnd, bestTriangle)
+                = *(adjacencyEnd - 1);
+            --remainingTriangleCounts[vertex];
+
+            const auto nextCacheEnd = nextCache.begin() + nextCacheCount;
+            if (std::find(nextCache.begin(), nextCacheEnd, vertex)
+                == nextCacheEnd)
+            {
+                nextCache[nextCacheCount++] = vertex;
+            }
+        }
+        const size_t triangleVertexCount = nextCacheCount;
+        for (size_t i = 0; i < cacheCount; ++i)
+        {
+            const auto triangleVerticesEnd
+                = nextCache.begin() + triangleVertexCount;
+            if (std::find(nextCache.begin(), triangleVerticesEnd, cache[i])
+                == triangleVerticesEnd)
+            {
+                nextCache[nextCacheCount++] = cache[i];
+            }
+        }
+
+        // Rescore vertices that moved in cache or got evicted from it
+        for (size_t i = 0; i < nextCacheCount; ++i)
+        {
+            const GLuint vertex = nextCache[i];
+            cachePositions[vertex]
+                = i < VERTEX_CACHE_SIZE ? static_cast<int>(i) : -1;
+            vertexScores[vertex] = scoreVertex(cachePositions[vertex],
+                                               remainingTriangleCounts[vertex]);
+        }
+
+        // Best candidate is searched only among triangles around cached
+        // vertices, keeping the algorithm linear in triangle count
+        bestTriangle = NO_TRIANGLE;
+        bestScore = -1.0F;
+        for (size_t i = 0; i < nextCacheCount; ++i)
+        {
+            const GLuint vertex = nextCache[i];
+            for (uint32_t j = 0; j < remainingTriangleCounts[vertex]; ++j)
+            {
+                const uint32_t candidate
+                    = adjacentTriangles[adjacencyOffsets[vertex] + j];
+                const float score
+                    = scoreTriangle(&indices[candidate * 3], vertexScores);
+                if (score > bestScore)
+                {
+                    bestTriangle = candidate;
+                    bestScore = score;
+                }
+            }
+        }
+
+        cacheCount = std::min(nextCacheCount, VERTEX_CACHE_SIZE);
+        std::swap(cache, nextCache);
+
+        // Disconnected part of mesh is reached, continue with any triangle
+        // left
+        if (bestTriangle == NO_TRIANGLE)
+        {
+            while (fallbackCursor < triangleCount && emitted[fallbackCursor])
+            {
+                ++fallbackCursor;
+            }
+            if (fallbackCursor < triangleCount)
+            {
+                bestTriangle = fallbackCursor;
+            }
+        }
+    }
+
+    std::copy(optimizedIndices.begin(),
+              optimizedIndices.end(),
+              indices.begin());
+}
+
+void optimizeOverdraw(std::span<GLuint> indices,
+                      std::span<const Vertex> vertices)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Cluster boundaries are triangles missing the simulated FIFO cache with
+    // all of their vertices. Vertex is in cache when it was inserted at most
+    // cache size insertions ago.
+    std::vector<uint32_t> insertionTimes(vertices.size(), 0);
+    uint32_t time = FIFO_CACHE_SIZE + 1;
+    std::vector<size_t> clusterStarts;
+    for (size_t i = 0; i < triangleCount; ++i)
+    {
+        size_t missCount = 0;
+        for (size_t j = 0; j < 3; ++j)
+        {
+            const GLuint vertex = indices[i * 3 + j];
+            if (time - insertionTimes[vertex] > FIFO_CACHE_SIZE)
+            {
+                insertionTimes[vertex] = time++;
+                ++missCount;
+            }
+        }
+        if (i == 0 || missCount == 3)
+        {
+            clusterStarts.push_back(i);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    struct Cluster
+    {
+        size_t firstTriangle;
+        size_t triangleCount;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    clusters.reserve(clusterStarts.size() - 1);
+    glm::vec3 meshCentroid{0.0F};
+    float meshArea = 0.0F;
+    for (size_t i = 0; i + 1 < clusterStarts.size(); ++i)
+    {
+        // Area weighted centroid and normal of cluster
+        glm::vec3 centroid{0.0F};
+        glm::vec3 normal{0.0F};
+        float area = 0.0F;
+        for (size_t j = clusterStarts[i]; j < clusterStarts[i + 1]; ++j)
+        {
+            const glm::vec3& p0 = vertices[indices[j * 3]].position;
+            const glm::vec3& p1 = vertices[indices[j * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[j * 3 + 2]].position;
+            const glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+            const float triangleArea = glm::length(triangleNormal);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0F);
+            normal += triangleNormal;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        clusters.push_back({
+            .firstTriangle = clusterStarts[i],
+            .triangleCount = clusterStarts[i + 1] - clusterStarts[i],
+            .centroid = area > 0.0F ? centroid / area : centroid,
+            .normal = normal,
+            .sortKey = 0.0F,
+        });
+    }
+    if (meshArea > 0.0F)
+    {
+        meshCentroid /= meshArea;
+    }
+
+    for (Cluster& cluster : clusters)
+    {
+        const float normalLength = glm::length(cluster.normal);
+        if (normalLength > 0.0F)
+        {
+            cluster.sortKey = glm::dot(cluster.centroid - meshCentroid,
+                                       cluster.normal / normalLength);
+        }
+    }
+    std::stable_sort(clusters.begin(),
+                     clusters.end(),
+                     [](const Cluster& lhs, const Cluster& rhs)
+                     { return lhs.sortKey > rhs.sortKey; });
+
+    std::vector<GLuint> sortedIndices;
+    sortedIndices.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+    {
+        const auto clusterBegin
+            = indices.begin()
+            + static_cast<std::ptrdiff_t>(cluster.firstTriangle * 3);
+        sortedIndices.insert(
+            sortedIndices.end(),
+            clusterBegin,
+            clusterBegin
+                + static_cast<std::ptrdiff_t>(cluster.triangleCount * 3));
+    }
+    std::copy(sortedIndices.begin(), sortedIndices.end(), indices.begin());
+}
+
+void optimizeVertexFetch(std::span<GLuint> indices, std::span<Vertex> vertices)
+{
+    constexpr GLuint UNASSIGNED = std::numeric_limits<GLuint>::max();
+    std::vector<GLuint> remap(vertices.size(), UNASSIGNED);
+    GLuint nextVertex = 0;
+    for (GLuint& index : indices)
+    {
+        if (remap[index] == UNASSIGNED)
+        {
+            remap[index] = nextVertex++;
+        }
+        index = remap[index];
+    }
+    for (GLuint& newIndex : remap)
+    {
+        if (newIndex == UNASSIGNED)
+        {
+            newIndex = nextVertex++;
+        }
+    }
+
+    std::vector<Vertex> reorderedVertices(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        reorderedVertices[remap[i]] = vertices[i];
+    }
+    std::copy(reorderedVertices.begin(),
+              reorderedVertices.end(),
+              vertices.begin());
+}
+
+void generateSmoothNormals(std::span<Vertex> vertices,
+                           std::span<const GLuint> indices,
+                           ThreadPool* threadPool)
+{
+    // Normals of separate triangle ranges are summed without atomics, each
+    // range into partial sums covering only the vertices it refers to, which
+    // are small for the spatially coherent triangle order of most meshes
+    struct PartialSums
+    {
+        GLuint firstVertex;
+        std::vector<glm::vec3> normals;
+    };
+    const size_t triangleCount = indices.size() / 3;
+    const size_t threadCount = threadPool ? threadPool->threadCount() + 1 : 1;
+    const size_t rangeCount = std::clamp<size_t>(
+        triangleCount / NORMAL_RANGE_MIN_TRIANGLE_COUNT,
+        1,
+        threadCount);
+    const size_t rangeSize = (triangleCount + rangeCount - 1) / rangeCount;
+    std::vector<PartialSums> partialSums(rangeCount);
+    const auto sumRanges = [&](size_t beginRange, size_t endRange)
+    {
+        for (size_t range = beginRange; range < endRange; ++range)
+        {
+            const size_t begin = std::min(range * rangeSize, triangleCount) * 3;
+            const size_t end
+                = std::min((range + 1) * rangeSize, triangleCount) * 3;
+            if (begin == end)
+            {
+                continue;
+            }
+            const auto [minimum, maximum]
+                = std::minmax_element(indices.begin() + begin,
+                                      indices.begin() + end);
+            PartialSums& sums = partialSums[range];
+            sums.firstVertex = *minimum;
+            sums.normals.assign(*maximum - *minimum + 1, glm::vec3{0.0F});
+            for (size_t i = begin; i < end; i += 3)
+            {
+                const GLuint a = indices[i];
+                const GLuint b = indices[i + 1];
+                const GLuint c = indices[i + 2];
+                // Cross product is as long as twice the triangle area, which
+                // weights large triangles more than slivers
+                const glm::vec3 faceNormal
+                    = glm::cross(vertices[b].position - vertices[a].position,
+                                 vertices[c].position - vertices[a].position);
+                sums.normals[a - sums.firstVertex] += faceNormal;
+                sums.normals[b - sums.firstVertex] += faceNormal;
+                sums.normals[c - sums.firstVertex] += faceNormal;
+            }
+        }
+    };
+    const auto reduceSums = [&](size_t begin, size_t end)
+    {
+        for (size_t vertex = begin; vertex < end; ++vertex)
+        {
+            glm::vec3 normal{0.0F};
+            for (const PartialSums& sums : partialSums)
+            {
+                if (vertex >= sums.firstVertex
+                    && vertex - sums.firstVertex < sums.normals.size())
+                {
+                    normal += sums.normals[vertex - sums.firstVertex];
+                }
+            }
+            // Vertices of degenerate triangles only, or of none at all, keep
+            // an arbitrary unit normal
+            const float length = glm::length(normal);
+            vertices[vertex].normal = length > 0.0F
+                                        ? normal / length
+                                        : glm::vec3{0.0F, 0.0F, 1.0F};
+        }
+    };
+    if (threadPool)
+    {
+        threadPool->parallelFor(rangeCount, 1, sumRanges);
+        threadPool->parallelFor(vertices.size(),
+                                NORMAL_REDUCTION_BATCH_SIZE,
+                                reduceSums);
+    }
+    else
+    {
+        sumRanges(0, rangeCount);
+        reduceSums(0, vertices.size());
+    }
+}
+
+std::optional<std::vector<GLushort>> narrowIndices(
+    std::span<const GLuint> indices)
+{
+    constexpr GLuint PRIMITIVE_RESTART_INDEX
+        = std::numeric_limits<GLushort>::max();
+    if (std::any_of(indices.begin(),
+                    indices.end(),
+                    [](GLuint index)
+                    { return index >= PRIMITIVE_RESTART_INDEX; }))
+    {
+        return std::nullopt;
+    }
+
+    return std::vector<GLushort>(indices.begin(), indices.end());
+}
+
+Bounds computeBounds(std::span<const Vertex> vertices)
+{
+    if (vertices.empty())
+    {
+        return {.minimum = glm::vec3{0.0F}, .maximum = glm::vec3{0.0F}};
+    }
+
+    Bounds bounds{
+        .minimum = vertices.front().position,
+        .maximum = vertices.front().position,
+    };
+    for (const Vertex& vertex : vertices)
+    {
+        bounds.minimum = glm::min(bounds.minimum, vertex.position);
+        bounds.maximum = glm::max(bounds.maximum, vertex.position);
+    }
+    return bounds;
+}
+
+std::vector<PackedVertex> packVertices(std::span<const Vertex> vertices,
+                                       const Bounds& bounds)
+{
+    // Flat axis of bounding box maps every position to zero
+    const glm::vec3 extent = bounds.maximum - bounds.minimum;
+    const glm::vec3 scale{
+        extent.x > 0.0F ? UNORM16_MAX / extent.x : 0.0F,
+        extent.y > 0.0F ? UNORM16_MAX / extent.y : 0.0F,
+        extent.z > 0.0F ? UNORM16_MAX / extent.z : 0.0F,
+    };
+
+    std::vector<PackedVertex> packedVertices(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const glm::vec3 quantized
+            = (vertices[i].position - bounds.minimum) * scale;
+        packedVertices[i].position = {
+            packUnorm16(quantized.x),
+            packUnorm16(quantized.y),
+            packUnorm16(quantized.z),
+            0,
+        };
+
+        const glm::vec3& normal = vertices[i].normal;
+        packedVertices[i].normal = packSnorm10(normal.x)
+                                 | (packSnorm10(normal.y) << 10)
+                                 | (packSnorm10(normal.z) << 20);
+        packedVertices[i].texCoord = {
+            glm::packHalf1x16(vertices[i].texCoord.x),
+            glm::packHalf1x16(vertices[i].texCoord.y),
+        };
+    }
+    return packedVertices;
+}
+
+glm::vec3 unpackPosition(const PackedVertex& vertex, const Bounds& bounds)
+{
+    const glm::vec3 normalized{
+        static_cast<float>(vertex.position[0]) / UNORM16_MAX,
+        static_cast<float>(vertex.position[1]) / UNORM16_MAX,
+        static_cast<float>(vertex.position[2]) / UNORM16_MAX,
+    };
+    return bounds.minimum + normalized * (bounds.maximum - bounds.minimum);
+}
+}  // namespace meshprocessing
@@ -0,0 +1,78 @@
+#ifndef MESH_PROCESSING_H_
+#define MESH_PROCESSING_H_
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+/// Optional import stages reordering and compacting mesh geometry for
+/// efficient rendering.
+///
+/// Reordering passes operate on a single sub-mesh with indices relative to the
+/// first vertex of the sub-mesh, and are expected to be applied in declaration
+/// order, because each pass preserves the locality achieved by the previous
+/// ones.
+namespace meshprocessing
+{
+/// Reorder triangles to maximize hits in the post-transform vertex cache of
+/// the GPU, so that vertices shared by adjacent triangles are shaded once.
+///
+/// Implements Tom Forsyth's linear-speed vertex cache optimization, which
+/// greedily emits the triangle whose vertices score best based on their
+/// position in a simulated cache and on the number of their remaining
+/// triangles.
+void optimizeVertexCache(std::span<GLuint> indices, size_t vertexCount);
+
+/// Reorder clusters of vertex cache optimized triangles to reduce overdraw.
+///
+/// Triangle order is split into clusters where the simulated vertex cache is
+/// restarted, so that moving clusters around does not introduce cache misses.
+/// Clusters facing away from the mesh center are drawn first, because they
+/// are likely to occlude the rest of the mesh from most view directions.
+void optimizeOverdraw(std::span<GLuint> indices,
+                      std::span<const Vertex> vertices);
+
+/// Reorder vertices to match the order in which indices first refer to them,
+/// improving locality of vertex fetches. Indices are remapped accordingly.
+/// Unreferenced vertices are moved to the end.
+void optimizeVertexFetch(std::span<GLuint> indices,
+                         std::span<Vertex> vertices);
+
+/// Replace vertex normals with smooth normals, averaging normals of the
+/// triangles around each vertex weighted by triangle area. Vertices shared by
+/// triangles get a normal blending across them, unlike flat normals of
+/// separate vertices per face.
+///
+/// Triangles are split into ranges summed on the thread pool when given, each
+/// into partial sums of its own, which are reduced per vertex afterwards.
+void generateSmoothNormals(std::span<Vertex> vertices,
+                           std::span<const GLuint> indices,
+                           ThreadPool* threadPool);
+
+/// Axis-aligned bounding box of vertex positions.
+Bounds computeBounds(std::span<const Vertex> vertices);
+
+/// Quantize positions relative to bounding box, pack normals into 10 bits
+/// per component and texture coordinates into half floats. Vertex order is
+/// preserved.
+std::vector<PackedVertex> packVertices(std::span<const Vertex> vertices,
+                                       const Bounds& bounds);
+
+/// Dequantize packed position relative to the bounding box it was packed with.
+glm::vec3 unpackPosition(const PackedVertex& vertex, const Bounds& bounds);
+
+/// Convert indices to 16-bit when all of them fit, halving index memory and
+/// fetch bandwidth. Returns nothing when an index is too large.
+///
+/// The largest 16-bit value is not allowed, because it is reserved for
+/// primitive restart, which is always enabled in WebGL 2.
+std::optional<std::vector<GLushort>> narrowIndices(
+    std::span<const GLuint> indices);
+}  // namespace meshprocessing
+
+#endif
@@ -0,0 +1,464 @@
+#include "meshsimplifier.h"
+
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+/// Symmetric 4x4 matrix of squared plane distance sum, weighted by triangle
+/// area. Evaluating it at a position yields the weighted sum of squared
+/// distances from the planes of accumulated triangles.
+struct Quadric
+{
+    float a2, b2, c2, d2;
+    float ab, ac, ad;
+    float bc, bd;
+    float cd;
+    float weight;
+};
+
+Quadric makePlaneQuadric(const glm::vec3& normal, float distance, float weight)
+{
+    return Quadric{
+        .a2 = weight * normal.x * normal.x,
+        .b2 = weight * normal.y * normal.y,
+        .c2 = weight * normal.z * normal.z,
+        .d2 = weight * distance * distance,
+        .ab = weight * normal.x * normal.y,
+        .ac = weight * normal.x * normal.z,
+        .ad = weight * normal.x * distance,
+        .bc = weight * normal.y * normal.z,
+        .bd = weight * normal.y * distance,
+        .cd = weight * normal.z * distance,
+        .weight = weight,
+    };
+}
+
+void accumulate(Quadric& quadric, const Quadric& other)
+{
+    quadric.a2 += other.a2;
+    quadric.b2 += other.b2;
+    quadric.c2 += other.c2;
+    quadric.d2 += other.d2;
+    quadric.ab += other.ab;
+    quadric.ac += other.ac;
+    quadric.ad += other.ad;
+    quadric.bc += other.bc;
+    quadric.bd += other.bd;
+    quadric.cd += other.cd;
+    quadric.weight += other.weight;
+}
+
+/// Mean squared distance of position from accumulated planes.
+float evaluate(const Quadric& quadric, const glm::vec3& p)
+{
+    const float sum = quadric.a2 * p.x * p.x + quadric.b2 * p.y * p.y
+                    + quadric.c2 * p.z * p.z
+                    + 2.0F
+                          * (quadric.ab * p.x * p.y + quadric.ac * p.x * p.z
+                             + quadric.bc * p.y * p.z)
+                    + 2.0F
+                          * (quadric.ad * p.x + quadric.bd * p.y
+                             + quadric.cd * p.z)
+                    + quadric.d2;
+    return quadric.weight > 0.0F ? std::abs(sum) / quadric.weight : 0.0F;
+}
+
+struct Collapse
+{
+    uint32_t source;
+    uint32_t target;
+    float error;
+};
+
+/// Sorted unique values, where each value can be looked up by binary search
+/// to get its compact local identifier.
+std::vector<GLuint> uniqueSorted(std::vector<GLuint> values)
+{
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return values;
+}
+
+uint32_t findLocal(const std::vector<GLuint>& sortedValues, GLuint value)
+{
+    return static_cast<uint32_t>(
+        std::lower_bound(sortedValues.begin(), sortedValues.end(), value)
+        - sortedValues.begin());
+}
+}  // namespace
+
+namespace meshsimplifier
+{
+std::vector<GLuint> generatePositionRemap(std::span<const Vertex> vertices)
+{
+    struct PositionHash
+    {
+        size_t operator()(const std::array<uint32_t, 3>& bits) const
+        {
+            return (bits[0] * 73856093U) ^ (bits[1] * 19349663U)
+                 ^ (bits[2] * 83492791U);
+        }
+    };
+
+    // Exact bitwise comparison, because vertices split by the importer keep
+    // the position they were read with.
+    std::unordered_map<std::array<uint32_t, 3>, GLuint, PositionHash>
+        firstVertices;
+    firstVertices.reserve(vertices.size());
+    std::vector<GLuint> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const glm::vec3& position = vertices[i].position;
+        const std::array<uint32_t, 3> bits{std::bit_cast<uint32_t>(position.x),
+                                           std::bit_cast<uint32_t>(position.y),
+                                           std::bit_cast<uint32_t>(position.z)};
+        remap[i] = firstVertices.try_emplace(bits, static_cast<GLuint>(i))
+                       .first->second;
+    }
+    return remap;
+}
+
+std::vector<GLuint> simplify(std::span<const GLuint> indices,
+                             std::span<const Vertex> vertices,
+                             std::span<const GLuint> positionRemap,
+                             const std::vector<bool>& lockedVertices,
+                             size_t targetIndexCount,
+                             float& outError)
+{
+    outError = 0.0F;
+
+    // Work with compact local identifiers of vertices and positions used by
+    // the simplified indices only, so that simplifying a small part of a
+    // large mesh does not touch memory proportional to the whole mesh.
+    const std::vector<GLuint> localVertices
+        = uniqueSorted({indices.begin(), indices.end()});
+    std::vector<GLuint> vertexPositionIds(localVertices.size());
+    for (size_t i = 0; i < localVertices.size(); ++i)
+    {
+        vertexPositionIds[i] = positionRemap[localVertices[i]];
+    }
+    const std::vector<GLuint> localPositions = uniqueSorted(vertexPositionIds);
+    for (GLuint& positionId : vertexPositionIds)
+    {
+        positionId = findLocal(localPositions, positionId);
+    }
+    const size_t positionCount = localPositions.size();
+
+    // Vertices at each position, stored as consecutive ranges
+    std::vector<uint32_t> wedgeOffsets(positionCount + 1, 0);
+    for (const GLuint positionId : vertexPositionIds)
+    {
+        ++wedgeOffsets[positionId + 1];
+    }
+    for (size_t i = 0; i < positionCount; ++i)
+    {
+        wedgeOffsets[i + 1] += wedgeOffsets[i];
+    }
+    std::vector<uint32_t> wedges(vertexPositionIds.size());
+    {
+        std::vector<uint32_t> wedgeCounts(positionCount, 0);
+        for (uint32_t i = 0; i < vertexPositionIds.size(); ++i)
+        {
+            const GLuint positionId = vertexPositionIds[i];
+            wedges[wedgeOffsets[positionId] + wedgeCounts[positionId]++] = i;
+        }
+    }
+
+    auto positionOf = [&](uint32_t localVertex) -> const glm::vec3&
+    { return vertices[localVertices[localVertex]].position; };
+    auto normalOf = [&](uint32_t localVertex) -> const glm::vec3&
+    { return vertices[localVertices[localVertex]].normal; };
+
+    std::vector<uint32_t> triangles(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        triangles[i] = findLocal(localVertices, indices[i]);
+    }
+
+    std::vector<Quadric> quadrics(positionCount, Quadric{});
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const glm::vec3& p0 = positionOf(triangles[i]);
+        const glm::vec3 normal = glm::cross(positionOf(triangles[i + 1]) - p0,
+                                            positionOf(triangles[i + 2]) - p0);
+        const float length = glm::length(normal);
+        if (length <= 0.0F)
+        {
+            continue;
+        }
+        const glm::vec3 unitNormal = normal / length;
+        const Quadric quadric = makePlaneQuadric(unitNormal,
+                                                 -glm::dot(unitNormal, p0),
+                                                 length * 0.5F);
+        for (size_t j = 0; j < 3; ++j)
+        {
+            accumulate(quadrics[vertexPositionIds[triangles[i + j]]], quadric);
+        }
+    }
+
+    std::vector<bool> lockedPositions(positionCount, false);
+    if (!lockedVertices.empty())
+    {
+        for (uint32_t i = 0; i < localVertices.size(); ++i)
+        {
+            if (lockedVertices[localVertices[i]])
+            {
+                lockedPositions[vertexPositionIds[i]] = true;
+            }
+        }
+    }
+
+    float largestError = 0.0F;
+    std::vector<uint32_t> vertexTargets(localVertices.size());
+    std::vector<uint32_t> adjacencyOffsets(positionCount + 1);
+    std::vector<uint32_t> adjacentTriangles;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<Collapse> collapses;
+    std::vector<bool> fixedPositions(positionCount);
+    std::vector<bool> touchedPositions(positionCount);
+    while (triangles.size() > targetIndexCount)
+    {
+        const size_t triangleCount = triangles.size() / 3;
+
+        // Triangles around each position
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (const uint32_t vertex : triangles)
+        {
+            ++adjacencyOffsets[vertexPositionIds[vertex] + 1];
+        }
+        for (size_t i = 0; i < positionCount; ++i)
+        {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+        adjacentTriangles.resize(triangles.size());
+        {
+            std::vector<uint32_t> counts(positionCount, 0);
+            for (size_t i = 0; i < triangles.size(); ++i)
+            {
+                const GLuint positionId = vertexPositionIds[triangles[i]];
+                adjacentTriangles[adjacencyOffsets[positionId]
+                                  + counts[positionId]++]
+                    = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Edges used by a single triangle are on open border
+        edges.clear();
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const GLuint a = vertexPositionIds[triangles[i + j]];
+                const GLuint b
+                    = vertexPositionIds[triangles[i + (j + 1) % 3]];
+                edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        fixedPositions = lockedPositions;
+        collapses.clear();
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i])
+            {
+                ++j;
+            }
+            if (j - i == 1)
+            {
+                fixedPositions[edges[i].first] = true;
+                fixedPositions[edges[i].second] = true;
+            }
+            i = j;
+        }
+
+        // Cheaper direction of each edge collapse, when there is any
+        for (size_t i = 0; i < edges.size(); ++i)
+        {
+            if ((i > 0 && edges[i] == edges[i - 1])
+                || edges[i].first == edges[i].second)
+            {
+                continue;
+            }
+            const auto [a, b] = edges[i];
+            Quadric merged = quadrics[a];
+            accumulate(merged, quadrics[b]);
+            const glm::vec3& positionA = positionOf(wedges[wedgeOffsets[a]]);
+            const glm::vec3& positionB = positionOf(wedges[wedgeOffsets[b]]);
+            const float errorToA = fixedPositions[b]
+                                     ? std::numeric_limits<float>::max()
+                                     : evaluate(merged, positionA);
+            const float errorToB = fixedPositions[a]
+                                     ? std::numeric_limits<float>::max()
+                                     : evaluate(merged, positionB);
+            if (errorToA == std::numeric_limits<float>::max()
+                && errorToB == std::numeric_limits<float>::max())
+            {
+                continue;
+            }
+            collapses.push_back(errorToB <= errorToA
+                                    ? Collapse{a, b, errorToB}
+                                    : Collapse{b, a, errorToA});
+        }
+        std::sort(collapses.begin(),
+                  collapses.end(),
+                  [](const Collapse& lhs, const Collapse& rhs)
+                  { return lhs.error < rhs.error; });
+
+        if (collapses.empty())
+        {
+            break;
+        }
+        // Each collapse removes about two triangles. Collapses more expensive
+        // than needed for reaching target are deferred to later passes,
+        // because cheaper ones may become possible after this pass.
+        const size_t collapseGoal
+            = (triangleCount - targetIndexCount / 3) / 2;
+        const float passErrorLimit
+            = collapses[std::min(collapseGoal, collapses.size() - 1)].error;
+
+        // Independent collapses of a pass only involve positions not touched
+        // by other collapses, keeping adjacency valid during the pass.
+        for (uint32_t i = 0; i < vertexTargets.size(); ++i)
+        {
+            vertexTargets[i] = i;
+        }
+        std::fill(touchedPositions.begin(), touchedPositions.end(), false);
+        size_t remainingTriangleCount = triangleCount;
+        bool collapsed = false;
+        for (const Collapse& collapse : collapses)
+        {
+            if (remainingTriangleCount * 3 <= targetIndexCount
+                || collapse.error > passErrorLimit)
+            {
+                break;
+            }
+            if (touchedPositions[collapse.source]
+                || touchedPositions[collapse.target])
+            {
+                continue;
+            }
+
+            const glm::vec3& targetPosition
+                = positionOf(wedges[wedgeOffsets[collapse.target]]);
+            const auto adjacencyBegin
+                = adjacentTriangles.begin()
+                + adjacencyOffsets[collapse.source];
+            const auto adjacencyEnd = adjacentTriangles.begin()
+                                    + adjacencyOffsets[collapse.source + 1];
+            bool flips = false;
+            size_t removedTriangleCount = 0;
+            for (auto it = adjacencyBegin; it != adjacencyEnd && !flips; ++it)
+            {
+                const uint32_t* triangle = &triangles[*it * 3];
+                std::array<glm::vec3, 3> corners{};
+                std::array<glm::vec3, 3> movedCorners{};
+                bool containsTarget = false;
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    const GLuint positionId = vertexPositionIds[triangle[j]];
+                    corners[j] = positionOf(triangle[j]);
+                    movedCorners[j] = positionId == collapse.source
+                                        ? targetPosition
+                                        : corners[j];
+                    containsTarget |= positionId == collapse.target;
+                }
+                if (containsTarget)
+                {
+                    ++removedTriangleCount;
+                    continue;
+                }
+                const glm::vec3 normal
+                    = glm::cross(corners[1] - corners[0],
+                                 corners[2] - corners[0]);
+                const glm::vec3 movedNormal
+                    = glm::cross(movedCorners[1] - movedCorners[0],
+                                 movedCorners[2] - movedCorners[0]);
+                flips = glm::dot(normal, movedNormal) <= 0.0F;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            // Keep shading seams by moving each vertex onto the vertex of
+            // target position with the most similar normal
+            for (uint32_t j = wedgeOffsets[collapse.source];
+                 j < wedgeOffsets[collapse.source + 1];
+                 ++j)
+            {
+                const uint32_t sourceVertex = wedges[j];
+                uint32_t bestVertex = wedges[wedgeOffsets[collapse.target]];
+                float bestSimilarity = -2.0F;
+                for (uint32_t k = wedgeOffsets[collapse.target];
+                     k < wedgeOffsets[collapse.target + 1];
+                     ++k)
+                {
+                    const float similarity = glm::dot(normalOf(sourceVertex),
+                                                      normalOf(wedges[k]));
+                    if (similarity > bestSimilarity)
+                    {
+                        bestVertex = wedges[k];
+                        bestSimilarity = similarity;
+                    }
+                }
+                vertexTargets[sourceVertex] = bestVertex;
+            }
+            accumulate(quadrics[collapse.target], quadrics[collapse.source]);
+            largestError = std::max(largestError, collapse.error);
+            remainingTriangleCount -= removedTriangleCount;
+            collapsed = true;
+
+            for (auto it = adjacencyBegin; it != adjacencyEnd; ++it)
+            {
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    touchedPositions[vertexPositionIds[triangles[*it * 3 + j]]]
+                        = true;
+                }
+            }
+        }
+        if (!collapsed)
+        {
+            break;
+        }
+
+        // Apply collapses and drop triangles that became degenerate
+        size_t writeIndex = 0;
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            const uint32_t v0 = vertexTargets[triangles[i]];
+            const uint32_t v1 = vertexTargets[triangles[i + 1]];
+            const uint32_t v2 = vertexTargets[triangles[i + 2]];
+            const GLuint p0 = vertexPositionIds[v0];
+            const GLuint p1 = vertexPositionIds[v1];
+            const GLuint p2 = vertexPositionIds[v2];
+            if (p0 == p1 || p1 == p2 || p0 == p2)
+            {
+                continue;
+            }
+            triangles[writeIndex++] = v0;
+            triangles[writeIndex++] = v1;
+            triangles[writeIndex++] = v2;
+        }
+        triangles.resize(writeIndex);
+    }
+
+    outError = std::sqrt(largestError);
+    std::vector<GLuint> simplifiedIndices(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        simplifiedIndices[i] = localVertices[triangles[i]];
+    }
+    return simplifiedIndices;
+}
+}  // namespace meshsimplifier
@@ -0,0 +1,44 @@
+#ifndef MESH_SIMPLIFIER_H_
+#define MESH_SIMPLIFIER_H_
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/// Triangle count reduction of meshes for level of detail generation.
+///
+/// Simplified meshes refer to the vertices of the original mesh, so that every
+/// level of detail can be drawn from the same vertex buffer with a separate
+/// range of indices.
+namespace meshsimplifier
+{
+/// Map each vertex to the first vertex having the same position.
+///
+/// Imported vertices sharing position but having different normals are
+/// separate vertices, which would leave the mesh without connectivity across
+/// such seams when looking at vertex indices alone.
+std::vector<GLuint> generatePositionRemap(std::span<const Vertex> vertices);
+
+/// Reduce triangle count towards target by edge collapses in the order of
+/// increasing quadric error metric (Garland and Heckbert).
+///
+/// Each collapse moves all vertices at a position onto a neighboring position,
+/// choosing the vertex with the most similar normal there. Vertices on open
+/// borders and locked vertices are never moved, which allows simplifying parts
+/// of a mesh while keeping them attached to the rest of it. Collapses flipping
+/// the orientation of remaining triangles are rejected.
+///
+/// Simplification stops early when no more collapses are possible. Error is
+/// the largest distance of collapsed positions from the original surface.
+/// Locked vertices are indexed by vertex and may be left empty.
+std::vector<GLuint> simplify(std::span<const GLuint> indices,
+                             std::span<const Vertex> vertices,
+                             std::span<const GLuint> positionRemap,
+                             const std::vector<bool>& lockedVertices,
+                             size_t targetIndexCount,
+                             float& outError);
+}  // namespace meshsimplifier
+
+#endif
@@ -1,78 +1,1050 @@
 #include "model.h"
 
+#include "assetfs.h"
+#include "bvh.h"
+#include "clusterlod.h"
+#ifndef __EMSCRIPTEN__
+#include "clusterstreamer.h"
+#endif
+#include "gltfloader.h"
+#include "lod.h"
+#include "materialtexture.h"
+#include "meshcache.h"
+#include "meshprocessing.h"
+#include "profiler.h"
+#include "threadpool.h"
 #include "utils.h"
+#include "vertexformat.h"
+#include "videomemory.h"
 
 #include "assimp/Importer.hpp"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
 #include <utility>
 
 namespace fs = std::filesystem;
 
-std::optional<Model> Model::create(const fs::path& filePath)
+#ifdef __EMSCRIPTEN__
+// Provided by WebGL 2 as readback of buffers, but missing from OpenGL ES 3.0
+// loaded by glad.
+extern "C" void glGetBufferSubData(GLenum target,
+                                   GLintptr offset,
+                                   GLsizeiptr size,
+                                   void* data);
+#endif
+
+namespace
 {
-    std::vector<Vertex> vertices;
+/// Sub-meshes with fewer triangles are cheap enough to draw whole and would
+/// gain little from selecting detail per meshlet.
+constexpr GLuint CLUSTER_LOD_MIN_TRIANGLE_COUNT = 8192;
+/// Sub-meshes with fewer triangles are drawn at full detail, because their
+/// cost is dominated by the draw call itself.
+constexpr GLuint LOD_CHAIN_MIN_TRIANGLE_COUNT = 1024;
+/// Occluders with more triangles would take longer to rasterize than the
+/// draws they could save.
+constexpr size_t MAX_OCCLUDER_TRIANGLE_COUNT = 2048;
+
+bool isTriangleMesh(const aiMesh& mesh)
+{
+    return mesh.mPrimitiveTypes & aiPrimitiveType_TRIANGLE;
+}
+
+/// Diffuse color of the material of mesh. Default material the importer adds
+/// to files without materials, like the bundled OBJ files, is white, leaving
+/// the model color as is.
+glm::vec3 getBaseColor(const aiScene& scene, const aiMesh& mesh)
+{
+    if (mesh.mMaterialIndex >= scene.mNumMaterials)
+    {
+        return glm::vec3{1.0F};
+    }
+    const aiMaterial& material = *scene.mMaterials[mesh.mMaterialIndex];
+    aiColor3D color{1.0F, 1.0F, 1.0F};
+    if (std::strcmp(material.GetName().C_Str(), AI_DEFAULT_MATERIAL_NAME) == 0
+        || material.Get(AI_MATKEY_COLOR_DIFFUSE, color) != aiReturn_SUCCESS)
+    {
+        return glm::vec3{1.0F};
+    }
+    return glm::vec3{color.r, color.g, color.b};
+}
+
+/// Opacity of the material of mesh, opaque when the material defines none.
+float getOpacity(const aiScene& scene, const aiMesh& mesh)
+{
+    if (mesh.mMaterialIndex >= scene.mNumMaterials)
+    {
+        return 1.0F;
+    }
+    const aiMaterial& material = *scene.mMaterials[mesh.mMaterialIndex];
+    ai_real opacity = 1.0F;
+    if (material.Get(AI_MATKEY_OPACITY, opacity) != aiReturn_SUCCESS)
+    {
+        return 1.0F;
+    }
+    return std::clamp(static_cast<float>(opacity), 0.0F, 1.0F);
+}
+
+/// Encoded contents of texture at path of diffuse texture of a material,
+/// embedded in the scene or read from a file relative to the model file.
+std::optional<std::vector<std::byte>> readTexture(const aiScene& scene,
+                                                  const aiString& path,
+                                                  const fs::path& filePath)
+{
+    if (const aiTexture* texture = scene.GetEmbeddedTexture(path.C_Str()))
+    {
+        // Embedded textures of zero height hold the image file as it is,
+        // decoded ones are left out
+        if (texture->mHeight != 0)
+        {
+            return std::nullopt;
+        }
+        const auto* bytes = reinterpret_cast<const std::byte*>(texture->pcData);
+        return std::vector<std::byte>{bytes, bytes + texture->mWidth};
+    }
+    const std::optional<AssetData> file
+        = assetfs::readFile(filePath.parent_path() / path.C_Str());
+    if (!file)
+    {
+        return std::nullopt;
+    }
+    return std::vector<std::byte>{file->bytes().begin(), file->bytes().end()};
+}
+
+/// Decode diffuse textures of materials into texture layers. Materials
+/// sharing a texture share its layer. Returns the layer of every material.
+std::vector<std::int32_t> loadMaterialTextures(
+    const aiScene& scene,
+    const fs::path& filePath,
+    ThreadPool* threadPool,
+    std::vector<std::byte>& outTextureLayers)
+{
+    std::vector<std::int32_t> materialLayers(scene.mNumMaterials,
+                                             NO_TEXTURE_LAYER);
+    std::vector<aiString> layerPaths;
+    for (size_t i = 0; i < scene.mNumMaterials; ++i)
+    {
+        aiString path;
+        if (scene.mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &path)
+            != aiReturn_SUCCESS)
+        {
+            continue;
+        }
+        const auto existing = std::ranges::find(layerPaths, path);
+        materialLayers[i]
+            = static_cast<std::int32_t>(existing - layerPaths.begin());
+        if (existing == layerPaths.end())
+        {
+            layerPaths.push_back(path);
+        }
+    }
+
+    outTextureLayers.assign(layerPaths.size()
+                                * materialtexture::LAYER_BYTE_SIZE,
+                            std::byte{0});
+    const auto decodeLayers = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const std::optional<std::vector<std::byte>> encoded
+                = readTexture(scene, layerPaths[i], filePath);
+            const bool decoded = materialtexture::decodeLayer(
+                encoded ? std::span<const std::byte>{*encoded}
+                        : std::span<const std::byte>{},
+                std::span{outTextureLayers}.subspan(
+                    i * materialtexture::LAYER_BYTE_SIZE,
+                    materialtexture::LAYER_BYTE_SIZE));
+            if (!decoded)
+            {
+                utils::logWarning("unable to read texture ",
+                                  layerPaths[i].C_Str(),
+                                  " of 3D model file at ",
+                                  filePath);
+            }
+        }
+    };
+    if (threadPool)
+    {
+        threadPool->parallelFor(layerPaths.size(), 1, decodeLayers);
+    }
+    else
+    {
+        decodeLayers(0, layerPaths.size());
+    }
+    return materialLayers;
+}
+
+size_t countFaceIndices(const aiMesh& mesh)
+{
+    // Triangulation post-process step leaves only triangles in meshes with
+    // polygons, which can be counted without visiting every face.
+    if (mesh.mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+    {
+        return static_cast<size_t>(mesh.mNumFaces) * 3;
+    }
+
+    size_t indexCount = 0;
+    for (size_t i = 0; i < mesh.mNumFaces; ++i)
+    {
+        indexCount += mesh.mFaces[i].mNumIndices;
+    }
+    return indexCount;
+}
+
+/// Vertices of sub-mesh at index. Vertices of sub-meshes are laid out in the
+/// same order as their indices, so vertex range ends where the next one
+/// begins.
+std::span<Vertex> getSubmeshVertices(std::vector<Vertex>& vertices,
+                                     std::span<const Submesh> submeshes,
+                                     size_t i)
+{
+    const auto vertexBegin = static_cast<size_t>(submeshes[i].baseVertex);
+    const size_t vertexEnd
+        = i + 1 < submeshes.size()
+            ? static_cast<size_t>(submeshes[i + 1].baseVertex)
+            : vertices.size();
+    return std::span{vertices}.subspan(vertexBegin, vertexEnd - vertexBegin);
+}
+
+void optimizeSubmeshes(std::vector<Vertex>& vertices,
+                       std::vector<GLuint>& indices,
+                       std::span<const Submesh> submeshes)
+{
+    for (size_t i = 0; i < submeshes.size(); ++i)
+    {
+        const std::span<Vertex> submeshVertices
+            = getSubmeshVertices(vertices, submeshes, i);
+        const std::span<GLuint> submeshIndices
+            = std::span{indices}.subspan(submeshes[i].firstIndex,
+                                         submeshes[i].indexCount);
+
+        meshprocessing::optimizeVertexCache(submeshIndices,
+                                            submeshVertices.size());
+        meshprocessing::optimizeOverdraw(submeshIndices, submeshVertices);
+        meshprocessing::optimizeVertexFetch(submeshIndices, submeshVertices);
+    }
+}
+
+/// Dense sub-meshes get a cluster level of detail hierarchy, others a
+/// discrete level of detail chain, depending on enabled options.
+void buildLevelsOfDetail(std::vector<Vertex>& vertices,
+                         std::vector<GLuint>& indices,
+                         std::span<Submesh> submeshes,
+                         const ImportOptions& options,
+                         std::vector<Meshlet>& outMeshlets,
+                         std::vector<SubmeshLod>& outLods)
+{
+    for (size_t i = 0; i < submeshes.size(); ++i)
+    {
+        const GLuint triangleCount = submeshes[i].indexCount / 3;
+        if (options.buildClusterLod
+            && triangleCount >= CLUSTER_LOD_MIN_TRIANGLE_COUNT)
+        {
+            clusterlod::build(getSubmeshVertices(vertices, submeshes, i),
+                              indices,
+                              submeshes[i],
+                              outMeshlets);
+        }
+        else if (options.buildLodChain
+                 && triangleCount >= LOD_CHAIN_MIN_TRIANGLE_COUNT)
+        {
+            lod::buildChain(getSubmeshVertices(vertices, submeshes, i),
+                            indices,
+                            submeshes[i],
+                            outLods);
+        }
+    }
+}
+
+template <typename IndexType>
+MeshData packMeshData(std::vector<Vertex>&& vertices,
+                      std::vector<IndexType>&& indices,
+                      std::vector<Submesh>&& submeshes,
+                      std::vector<Meshlet>&& meshlets,
+                      std::vector<SubmeshLod>&& lods,
+                      const ImportOptions& options)
+{
+    if (options.packVertices)
+    {
+        const Bounds bounds = meshprocessing::computeBounds(vertices);
+        return MeshData::fromContainers(
+            meshprocessing::packVertices(vertices, bounds),
+            std::move(indices),
+            std::move(submeshes),
+            std::move(meshlets),
+            std::move(lods),
+            bounds);
+    }
+    return MeshData::fromContainers(std::move(vertices),
+                                    std::move(indices),
+                                    std::move(submeshes),
+                                    std::move(meshlets),
+                                    std::move(lods));
+}
+
+template <typename IndexType>
+void appendCpuIndices(std::span<const IndexType> indices,
+                      std::span<const Submesh> submeshes,
+                      std::vector<GLuint>& outIndices)
+{
+    outIndices.reserve(indices.size());
+    for (const Submesh& submesh : submeshes)
+    {
+        for (GLuint i = 0; i < submesh.indexCount; ++i)
+        {
+            outIndices.push_back(static_cast<GLuint>(
+                indices[submesh.firstIndex + i] + submesh.baseVertex));
+        }
+    }
+}
+
+/// Model space positions of mesh vertices in either vertex format.
+std::vector<glm::vec3> decodePositions(const MeshData& meshData)
+{
+    return vertexformat::visitVertices(
+        meshData,
+        [&meshData]<typename VertexType>(std::span<const VertexType> vertices)
+        {
+            std::vector<glm::vec3> positions;
+            positions.reserve(vertices.size());
+            using Descriptor = VertexFormatDescriptor<VertexType>;
+            for (const VertexType& vertex : vertices)
+            {
+                positions.push_back(
+                    Descriptor::position(vertex, meshData.bounds()));
+            }
+            return positions;
+        });
+}
+
+CpuGeometry extractCpuGeometry(const MeshData& meshData)
+{
+    CpuGeometry geometry;
+    geometry.positions = decodePositions(meshData);
+
+    if (meshData.indexType() == GL_UNSIGNED_SHORT)
+    {
+        appendCpuIndices(meshData.shortIndices(),
+                         meshData.submeshes(),
+                         geometry.indices);
+    }
+    else
+    {
+        appendCpuIndices(meshData.indices(),
+                         meshData.submeshes(),
+                         geometry.indices);
+    }
+    geometry.bvhNodes.assign(meshData.bvhNodes().begin(),
+                             meshData.bvhNodes().end());
+    geometry.bvhTriangles.assign(meshData.bvhTriangles().begin(),
+                                 meshData.bvhTriangles().end());
+    return geometry;
+}
+
+/// Index ranges of the coarsest geometry of each sub-mesh, root clusters of
+/// its cluster level of detail hierarchy or last level of its chain, into
+/// occluder with only the positions they refer to. Nothing is built above
+/// the triangle budget of occluders.
+template <typename IndexType>
+std::optional<OccluderMesh> buildOccluderMesh(
+    const MeshData& meshData,
+    std::span<const IndexType> indices)
+{
+    struct IndexRange
+    {
+        GLuint firstIndex;
+        GLuint indexCount;
+        GLint baseVertex;
+    };
+    std::vector<IndexRange> ranges;
+    size_t occluderIndexCount = 0;
+    const auto addRange = [&](GLuint firstIndex,
+                              GLuint indexCount,
+                              GLint baseVertex)
+    {
+        ranges.push_back({firstIndex, indexCount, baseVertex});
+        occluderIndexCount += indexCount;
+    };
+    for (const Submesh& submesh : meshData.submeshes())
+    {
+        if (submesh.meshletCount > 0)
+        {
+            for (const Meshlet& meshlet : meshData.meshlets().subspan(
+                     submesh.firstMeshlet,
+                     submesh.meshletCount))
+            {
+                if (meshlet.parentError == lod::UNBOUNDED_ERROR)
+                {
+                    addRange(meshlet.firstIndex,
+                             meshlet.indexCount,
+                             submesh.baseVertex);
+                }
+            }
+        }
+        else if (submesh.lodCount > 0)
+        {
+            const SubmeshLod& coarsest
+                = meshData.lods()[submesh.firstLod + submesh.lodCount - 1];
+            addRange(coarsest.firstIndex,
+                     coarsest.indexCount,
+                     submesh.baseVertex);
+        }
+        else
+        {
+            addRange(submesh.firstIndex,
+                     submesh.indexCount,
+                     submesh.baseVertex);
+        }
+    }
+    if (occluderIndexCount == 0
+        || occluderIndexCount > MAX_OCCLUDER_TRIANGLE_COUNT * 3)
+    {
+        return std::nullopt;
+    }
+
+    // Vertices are renumbered in order of first use
+    const std::vector<glm::vec3> positions = decodePositions(meshData);
+    constexpr GLuint UNUSED = std::numeric_limits<GLuint>::max();
+    std::vector<GLuint> remap(positions.size(), UNUSED);
+    OccluderMesh occluder;
+    occluder.indices.reserve(occluderIndexCount);
+    for (const IndexRange& range : ranges)
+    {
+        for (GLuint i = 0; i < range.indexCount; ++i)
+        {
+            const auto vertex = static_cast<GLuint>(
+                indices[range.firstIndex + i] + range.baseVertex);
+            if (remap[vertex] == UNUSED)
+            {
+                remap[vertex] = static_cast<GLuint>(occluder.positions.size());
+                occluder.positions.push_back(positions[vertex]);
+            }
+            occluder.indices.push_back(remap[vertex]);
+        }
+    }
+    return occluder;
+}
+
+std::optional<OccluderMesh> buildOccluderMesh(const MeshData& meshData)
+{
+    if (meshData.indexType() == GL_UNSIGNED_SHORT)
+    {
+        return buildOccluderMesh(meshData, meshData.shortIndices());
+    }
+    return buildOccluderMesh(meshData, meshData.indices());
+}
+
+/// Model space bounding box and bounding sphere of mesh positions. Sphere is
+/// centered on the box and reaches the farthest position, which is tighter
+/// than the sphere around the box for rounded meshes.
+void computeBoundingVolumes(const MeshData& meshData,
+                            Bounds& outBounds,
+                            BoundingSphere& outSphere)
+{
+    outBounds = meshData.vertexFormat() == VertexFormat::Packed
+                  ? meshData.bounds()
+                  : meshprocessing::computeBounds(meshData.vertices());
+    const std::vector<glm::vec3> positions = decodePositions(meshData);
+
+    outSphere.center = (outBounds.minimum + outBounds.maximum) * 0.5F;
+    float radiusSquared = 0.0F;
+    for (const glm::vec3& position : positions)
+    {
+        const glm::vec3 offset = position - outSphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    outSphere.radius = std::sqrt(radiusSquared);
+}
+
+#ifdef __EMSCRIPTEN__
+void rebaseSubmeshIndices(std::vector<GLuint>& indices,
+                          std::span<Submesh> submeshes,
+                          std::span<const Meshlet> meshlets,
+                          std::span<const SubmeshLod> lods)
+{
+    // WebGL 2 has no base vertex draw calls, so indices are rebased onto the
+    // merged vertex array instead, and sub-meshes are drawn at once.
+    const auto rebase = [&](GLuint firstIndex, GLuint count, GLint baseVertex)
+    {
+        for (GLuint i = 0; i < count; ++i)
+        {
+            indices[firstIndex + i] += static_cast<GLuint>(baseVertex);
+        }
+    };
+    for (Submesh& submesh : submeshes)
+    {
+        rebase(submesh.firstIndex, submesh.indexCount, submesh.baseVertex);
+        // Full detail meshlets lie within the range of the sub-mesh, while
+        // simplified meshlets and levels are stored after all sub-meshes
+        const GLuint submeshEnd = submesh.firstIndex + submesh.indexCount;
+        for (const Meshlet& meshlet :
+             meshlets.subspan(submesh.firstMeshlet, submesh.meshletCount))
+        {
+            if (meshlet.firstIndex >= submeshEnd)
+            {
+                rebase(meshlet.firstIndex,
+                       meshlet.indexCount,
+                       submesh.baseVertex);
+            }
+        }
+        for (const SubmeshLod& lod :
+             lods.subspan(submesh.firstLod, submesh.lodCount))
+        {
+            rebase(lod.firstIndex, lod.indexCount, submesh.baseVertex);
+        }
+        submesh.baseVertex = 0;
+    }
+}
+
+/// Copy of vertices in index order, one vertex per index. Every triangle gets
+/// three vertices of its own, identifying its corners by vertex order.
+std::vector<std::byte> expandIndexedVertices(
+    std::span<const std::byte> vertices,
+    std::span<const std::byte> indices,
+    GLenum indexType,
+    size_t vertexStride)
+{
+    const size_t indexSize
+        = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    const size_t indexCount = indices.size() / indexSize;
+    std::vector<std::byte> expanded(indexCount * vertexStride);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        GLuint index = 0;
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            GLushort shortIndex = 0;
+            std::memcpy(&shortIndex,
+                        indices.data() + i * indexSize,
+                        sizeof(GLushort));
+            index = shortIndex;
+        }
+        else
+        {
+            std::memcpy(&index, indices.data() + i * indexSize, sizeof(GLuint));
+        }
+        std::memcpy(expanded.data() + i * vertexStride,
+                    vertices.data() + index * vertexStride,
+                    vertexStride);
+    }
+    return expanded;
+}
+#endif
+}  // namespace
+
+std::optional<Model> Model::create(const fs::path& filePath,
+                                   const ImportOptions& options)
+{
+    PROFILE_SCOPE("Model::create");
+    std::optional<MeshData> meshData = loadMeshData(filePath, options);
+    if (!meshData)
+    {
+        return std::nullopt;
+    }
+
+    return create(meshData.value());
+}
+
+Model Model::create(const MeshData& meshData, bool keepCpuGeometry)
+{
+    PROFILE_SCOPE("Model::upload");
+    Model model;
+    model.uploadBuffers(meshData);
+    model.uploadTextures(meshData);
+    computeBoundingVolumes(meshData, model.bounds, model.boundingSphere);
+    model.occluder = buildOccluderMesh(meshData);
+    if (keepCpuGeometry)
+    {
+        model.cpuGeometry = extractCpuGeometry(meshData);
+    }
+    return model;
+}
+
+#ifndef __EMSCRIPTEN__
+Model Model::create(const MeshData& meshData,
+                    GeometryBuffers buffers,
+                    bool keepCpuGeometry)
+{
+    PROFILE_SCOPE("Model::adopt");
     Model model;
-    if (!loadModelFromFile(filePath, vertices, model.indices))
+    model.adoptBuffers(meshData, buffers);
+    model.uploadTextures(meshData);
+    computeBoundingVolumes(meshData, model.bounds, model.boundingSphere);
+    model.occluder = buildOccluderMesh(meshData);
+    if (keepCpuGeometry)
+    {
+        model.cpuGeometry = extractCpuGeometry(meshData);
+    }
+    return model;
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+Model Model::createStreamed(const MeshData& meshData,
+                            clusterpages::PagedMesh&& pagedMesh,
+                            ClusterStreamer& clusterStreamer,
+                            bool keepCpuGeometry)
+{
+    PROFILE_SCOPE("Model::createStreamed");
+    // Only bounds of the geometry are needed up front, pages are selected and
+    // drawn from the buffer of the streamer
+    Model model;
+    const std::uint32_t meshId = clusterStreamer.add(std::move(pagedMesh));
+    model.streamedMesh = meshId;
+    model.clusterStreamer_ = &clusterStreamer;
+    model.positionTransform = clusterStreamer.positionTransform(meshId);
+    model.indexType = ClusterStreamer::INDEX_TYPE;
+    model.uploadTextures(meshData);
+    computeBoundingVolumes(meshData, model.bounds, model.boundingSphere);
+    model.occluder = buildOccluderMesh(meshData);
+    if (keepCpuGeometry)
+    {
+        model.cpuGeometry = extractCpuGeometry(meshData);
+    }
+    return model;
+}
+#endif
+
+Model Model::createPlaceholder()
+{
+    // Each face has its own four vertices, because vertices of adjacent
+    // faces share position but not normal.
+    constexpr std::array<glm::vec3, 6> faceNormals{
+        glm::vec3{1.0F, 0.0F, 0.0F},
+        glm::vec3{-1.0F, 0.0F, 0.0F},
+        glm::vec3{0.0F, 1.0F, 0.0F},
+        glm::vec3{0.0F, -1.0F, 0.0F},
+        glm::vec3{0.0F, 0.0F, 1.0F},
+        glm::vec3{0.0F, 0.0F, -1.0F},
+    };
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    vertices.reserve(faceNormals.size() * 4);
+    indices.reserve(faceNormals.size() * 6);
+    for (const glm::vec3& normal : faceNormals)
+    {
+        // Two axes spanning the face, oriented for counter-clockwise winding
+        // when looking at the face from outside.
+        const glm::vec3 tangent
+            = std::abs(normal.y) > 0.0F ? glm::vec3{0.0F, 0.0F, normal.y}
+                                        : glm::vec3{-normal.z, 0.0F, normal.x};
+        const glm::vec3 bitangent = glm::cross(normal, tangent);
+        const auto firstVertex = static_cast<GLuint>(vertices.size());
+        for (const auto& [u, v] : {std::pair{-1.0F, -1.0F},
+                                   std::pair{1.0F, -1.0F},
+                                   std::pair{1.0F, 1.0F},
+                                   std::pair{-1.0F, 1.0F}})
+        {
+            vertices.push_back({
+                .position = normal + u * tangent + v * bitangent,
+                .normal = normal,
+                .texCoord = glm::vec2{0.0F},
+            });
+        }
+        for (const GLuint index : {0U, 1U, 2U, 2U, 3U, 0U})
+        {
+            indices.push_back(firstVertex + index);
+        }
+    }
+
+    const Submesh submesh{
+        .firstIndex = 0,
+        .indexCount = static_cast<GLuint>(indices.size()),
+        .baseVertex = 0,
+        .firstMeshlet = 0,
+        .meshletCount = 0,
+        .firstLod = 0,
+        .lodCount = 0,
+        .baseColor = glm::vec3{1.0F},
+        .opacity = 1.0F,
+        .textureLayer = NO_TEXTURE_LAYER,
+    };
+    return create(MeshData::fromContainers(std::move(vertices),
+                                           std::move(indices),
+                                           {submesh},
+                                           std::vector<Meshlet>{},
+                                           std::vector<SubmeshLod>{}));
+}
+
+std::optional<MeshData> Model::loadMeshData(const fs::path& filePath,
+                                            const ImportOptions& options,
+                                            ThreadPool* threadPool)
+{
+    PROFILE_SCOPE("Model::loadMeshData");
+    // Parsing text-based mesh files is slow, so prefer previously imported
+    // geometry from binary cache when available and up-to-date. Cached
+    // geometry is uploaded straight from the file mapping without copying it
+    // into intermediate containers first.
+    std::optional<MeshData> cachedMesh = meshcache::map(filePath, options);
+    if (cachedMesh)
+    {
+        return cachedMesh;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<Submesh> submeshes;
+    std::vector<std::byte> textureLayers;
+    // glTF files are read natively, their binary buffers map onto vertices
+    // without conversion through the scene graph of Assimp
+    const bool loaded = gltf::isGltfFile(filePath)
+                          ? gltf::load(filePath,
+                                       options,
+                                       threadPool,
+                                       vertices,
+                                       indices,
+                                       submeshes,
+                                       textureLayers)
+                          : loadModelFromFile(filePath,
+                                              options,
+                                              threadPool,
+                                              vertices,
+                                              indices,
+                                              submeshes,
+                                              textureLayers);
+    if (!loaded)
     {
         return std::nullopt;
     }
+    if (options.optimizeMesh)
+    {
+        optimizeSubmeshes(vertices, indices, submeshes);
+    }
+    // Built after optimization, so that full detail meshlets keep the
+    // optimized triangle order
+    std::vector<Meshlet> meshlets;
+    std::vector<SubmeshLod> lods;
+    buildLevelsOfDetail(vertices, indices, submeshes, options, meshlets, lods);
+#ifdef __EMSCRIPTEN__
+    rebaseSubmeshIndices(indices, submeshes, meshlets, lods);
+#endif
+    std::optional<std::vector<GLushort>> shortIndices
+        = meshprocessing::narrowIndices(indices);
+    MeshData meshData = shortIndices ? packMeshData(std::move(vertices),
+                                                    std::move(*shortIndices),
+                                                    std::move(submeshes),
+                                                    std::move(meshlets),
+                                                    std::move(lods),
+                                                    options)
+                                     : packMeshData(std::move(vertices),
+                                                    std::move(indices),
+                                                    std::move(submeshes),
+                                                    std::move(meshlets),
+                                                    std::move(lods),
+                                                    options);
+    meshData.setTextureLayers(std::move(textureLayers));
+    if (options.buildBvh)
+    {
+        // Built over dequantized positions, which is the geometry queries are
+        // answered against
+        const CpuGeometry geometry = extractCpuGeometry(meshData);
+        std::vector<BvhNode> bvhNodes;
+        std::vector<GLuint> bvhTriangles;
+        bvh::build(geometry.positions,
+                   geometry.indices,
+                   threadPool,
+                   bvhNodes,
+                   bvhTriangles);
+        meshData.setBvh(std::move(bvhNodes), std::move(bvhTriangles));
+    }
+    meshcache::store(filePath, options, meshData);
+
+    return meshData;
+}
+
+#ifndef __EMSCRIPTEN__
+Model::GeometryBuffers Model::uploadGeometry(const MeshData& meshData)
+{
+    PROFILE_SCOPE("Model::uploadGeometry");
+    const std::span<const std::byte> vertices = meshData.vertexData();
+    const std::span<const std::byte> indices = meshData.indexData();
+    GeometryBuffers buffers{.vertexBuffer = 0, .indexBuffer = 0};
+    // Objects are created and filled without binding them, leaving bindings
+    // of the state cache intact. Immutable storage lets the driver place
+    // buffers without expecting them to be reallocated.
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        glCreateBuffers(1, &buffers.vertexBuffer);
+        glNamedBufferStorage(buffers.vertexBuffer,
+                             static_cast<GLsizeiptr>(vertices.size_bytes()),
+                             vertices.data(),
+                             0);
+        glCreateBuffers(1, &buffers.indexBuffer);
+        glNamedBufferStorage(buffers.indexBuffer,
+                             static_cast<GLsizeiptr>(indices.size_bytes()),
+                             indices.data(),
+                             0);
+        return buffers;
+    }
+
+    // Element array binding belongs to vertex arrays, so both buffers are
+    // filled through a binding point that is not
+    glGenBuffers(1, &buffers.vertexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.vertexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 static_cast<GLsizeiptr>(vertices.size_bytes()),
+                 vertices.data(),
+                 GL_STATIC_DRAW);
+    glGenBuffers(1, &buffers.indexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.indexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 static_cast<GLsizeiptr>(indices.size_bytes()),
+                 indices.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffers;
+}
+#endif
+
+void Model::uploadBuffers(const MeshData& meshData)
+{
+#ifndef __EMSCRIPTEN__
+    adoptBuffers(meshData, uploadGeometry(meshData));
+#else
+    setDrawParameters(meshData);
+    const VertexFormat vertexFormat = meshData.vertexFormat();
+    const std::span<const std::byte> vertices = meshData.vertexData();
+    const std::span<const std::byte> indices = meshData.indexData();
 
     // Create vertex array
-    glGenVertexArrays(1, &model.vertexArray);
-    glBindVertexArray(model.vertexArray);
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
 
     // Create vertex buffer
-    glGenBuffers(1, &model.vertexBuffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, model.vertexBuffer_);
+    glGenBuffers(1, &vertexBuffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
     glBufferData(GL_ARRAY_BUFFER,
-                 static_cast<GLsizeiptr>(sizeof(Vertex) * vertices.size()),
+                 static_cast<GLsizeiptr>(vertices.size_bytes()),
                  vertices.data(),
                  GL_STATIC_DRAW);
 
     // Create index buffer
-    glGenBuffers(1, &model.indexBuffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.indexBuffer_);
+    glGenBuffers(1, &indexBuffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 static_cast<GLsizeiptr>(sizeof(GLuint) * model.indices.size()),
-                 model.indices.data(),
+                 static_cast<GLsizeiptr>(indices.size_bytes()),
+                 indices.data(),
                  GL_STATIC_DRAW);
 
     // Setup vertex array layout
-    // Vertex Attribute 0: position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          reinterpret_cast<GLvoid*>(0));
-
-    // Vertex Attribute 1: normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          // NOLINTNEXTLINE(performance-no-int-to-ptr)
-                          reinterpret_cast<GLvoid*>(offsetof(Vertex, normal)));
+    vertexformat::setupAttributes(vertexFormat);
+    vertexFormat_ = vertexFormat;
 
     glBindVertexArray(0);
+#endif
+}
 
-    return model;
+#ifdef __EMSCRIPTEN__
+void Model::createWireframe()
+{
+    if (wireframeVertexArray != 0 || vertexBuffer_ == 0)
+    {
+        return;
+    }
+    PROFILE_SCOPE("Model::createWireframe");
+    // Mesh data is gone by now, so vertices and indices are read back. Copy
+    // read target leaves the index buffer binding of vertex arrays alone.
+    const auto readBuffer = [](GLuint buffer)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        GLint size = 0;
+        glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+        std::vector<std::byte> data(static_cast<size_t>(size));
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, data.data());
+        return data;
+    };
+    const std::vector<std::byte> vertices = readBuffer(vertexBuffer_);
+    const std::vector<std::byte> indices = readBuffer(indexBuffer_);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // Wireframe draws take barycentric coordinates from vertex order, as
+    // OpenGL ES 3.0 has no geometry shaders to generate them. Every index
+    // range maps to the same range of expanded vertices, including meshlets
+    // and levels of detail.
+    const std::vector<std::byte> wireframeVertices = expandIndexedVertices(
+        vertices,
+        indices,
+        indexType,
+        static_cast<size_t>(vertexformat::stride(vertexFormat_)));
+    videoMemorySize_ += wireframeVertices.size();
+    videomemory::allocate(videomemory::Category::Geometry,
+                          wireframeVertices.size());
+    glGenVertexArrays(1, &wireframeVertexArray);
+    glBindVertexArray(wireframeVertexArray);
+    glGenBuffers(1, &wireframeVertexBuffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, wireframeVertexBuffer_);
+    glBufferData(GL_ARRAY_BUFFER,
+                 static_cast<GLsizeiptr>(wireframeVertices.size()),
+                 wireframeVertices.data(),
+                 GL_STATIC_DRAW);
+    vertexformat::setupAttributes(vertexFormat_);
+    glBindVertexArray(0);
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+void Model::adoptBuffers(const MeshData& meshData, GeometryBuffers buffers)
+{
+    setDrawParameters(meshData);
+    const VertexFormat vertexFormat = meshData.vertexFormat();
+    vertexBuffer_ = buffers.vertexBuffer;
+    indexBuffer_ = buffers.indexBuffer;
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        // Attributes are fetched through a single vertex buffer binding
+        glCreateVertexArrays(1, &vertexArray);
+        glVertexArrayVertexBuffer(vertexArray,
+                                  0,
+                                  vertexBuffer_,
+                                  0,
+                                  vertexformat::stride(vertexFormat));
+        glVertexArrayElementBuffer(vertexArray, indexBuffer_);
+        vertexformat::setupAttributes(vertexArray, vertexFormat);
+        return;
+    }
+
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+    vertexformat::setupAttributes(vertexFormat);
+    glBindVertexArray(0);
+}
+#endif
+
+void Model::setDrawParameters(const MeshData& meshData)
+{
+    indexType = meshData.indexType();
+    indexCount = 0;
+    const size_t indexSize
+        = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+    submeshes.assign(meshData.submeshes().begin(),
+                     meshData.submeshes().end());
+    meshlets.assign(meshData.meshlets().begin(), meshData.meshlets().end());
+    lods.assign(meshData.lods().begin(), meshData.lods().end());
+    submeshIndexCounts.reserve(submeshes.size());
+    submeshIndexOffsets.reserve(submeshes.size());
+    submeshBaseVertices.reserve(submeshes.size());
+    for (const Submesh& submesh : submeshes)
+    {
+        indexCount += static_cast<GLsizei>(submesh.indexCount);
+        submeshIndexCounts.push_back(static_cast<GLsizei>(submesh.indexCount));
+        submeshIndexOffsets.push_back(
+            // NOLINTNEXTLINE(performance-no-int-to-ptr)
+            reinterpret_cast<const GLvoid*>(submesh.firstIndex * indexSize));
+        submeshBaseVertices.push_back(submesh.baseVertex);
+    }
+
+    videoMemorySize_ = meshData.vertexData().size_bytes()
+                     + meshData.indexData().size_bytes();
+    videomemory::allocate(videomemory::Category::Geometry, videoMemorySize_);
+
+    positionTransform = vertexformat::positionTransform(meshData.vertexFormat(),
+                                                        meshData.bounds());
+}
+
+void Model::uploadTextures(const MeshData& meshData)
+{
+    const std::span<const std::byte> layers = meshData.textureLayers();
+    if (layers.empty())
+    {
+        return;
+    }
+    PROFILE_SCOPE("Model::uploadTextures");
+    // Layers are stored top row first, which samples the top of the image at
+    // the texture coordinates of the importers, flipped to top-left origin
+    constexpr GLsizei LAYER_SIZE = materialtexture::LAYER_SIZE;
+    const auto layerCount = static_cast<GLsizei>(
+        layers.size() / materialtexture::LAYER_BYTE_SIZE);
+    const auto levelCount = static_cast<GLsizei>(
+        std::bit_width(static_cast<unsigned int>(LAYER_SIZE)));
+    glGenTextures(1, &textureArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+    // Base colors are authored in sRGB, lighting works on linear values
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY,
+                   levelCount,
+                   GL_SRGB8_ALPHA8,
+                   LAYER_SIZE,
+                   LAYER_SIZE,
+                   layerCount);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                    0,
+                    0,
+                    0,
+                    0,
+                    LAYER_SIZE,
+                    LAYER_SIZE,
+                    layerCount,
+                    GL_RGBA,
+                    GL_UNSIGNED_BYTE,
+                    layers.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,
+                    GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    // Mip chain adds a third of the base level
+    textureMemorySize_ = layers.size() + layers.size() / 3;
+    videomemory::allocate(videomemory::Category::Texture, textureMemorySize_);
 }
 
 bool Model::loadModelFromFile(const fs::path& filePath,
+                              const ImportOptions& options,
+                              ThreadPool* threadPool,
                               std::vector<Vertex>& outVertices,
-                              std::vector<GLuint>& outIndices)
+                              std::vector<GLuint>& outIndices,
+                              std::vector<Submesh>& outSubmeshes,
+                              std::vector<std::byte>& outTextureLayers)
 {
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-        filePath.string().c_str(),
-        aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs);
+    // Sorting by primitive type splits meshes mixing points and lines with
+    // triangles, so that the remaining non-triangle meshes can be skipped.
+    // Joining identical vertices restores connectivity between faces, which
+    // formats like OBJ otherwise import with separate vertices per face, and
+    // which mesh simplification relies on.
+    //
+    // Flat normals of the importer are generated single-threaded before
+    // joining, leaving vertices with separate normals per face unjoined.
+    // Smooth normals are generated afterwards instead.
+    unsigned int postProcessSteps = aiProcess_Triangulate
+                                  | aiProcess_SortByPType
+                                  | aiProcess_JoinIdenticalVertices
+                                  | aiProcess_FlipUVs;
+    if (!options.smoothNormals)
+    {
+        postProcessSteps |= aiProcess_GenNormals;
+    }
+    // Importer is handed contents read through the asset layer, with the
+    // extension hinting at the format
+    const std::optional<AssetData> file = assetfs::readFile(filePath);
+    if (!file)
+    {
+        utils::showErrorMessage("unable to read 3D model file at ", filePath);
+        return false;
+    }
+    const std::string extension = filePath.extension().string();
+    const aiScene* scene = importer.ReadFileFromMemory(
+        file->bytes().data(),
+        file->bytes().size(),
+        postProcessSteps,
+        extension.empty() ? "" : extension.c_str() + 1);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE
         || !scene->mRootNode)
     {
@@ -88,29 +1060,113 @@ bool Model::loadModelFromFile(const fs::path& filePath,
     //
     // Sometimes you get a mesh file with just a single mesh and no nodes.
     // The bundled default files are such meshes.
+    //
+    // All meshes are merged into a single vertex and index array. Each mesh
+    // indexes its own vertices starting from zero, so every mesh becomes a
+    // sub-mesh drawn with the offset of its first vertex in the merged array
+    // as base vertex.
+    //
+    // Counting pass first to size output arrays exactly once, avoiding
+    // repeated reallocations while filling them for large meshes.
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    size_t submeshCount = 0;
     for (size_t i = 0; i < scene->mNumMeshes; ++i)
     {
-        aiMesh* mesh = scene->mMeshes[i];
-        for (size_t j = 0; j < mesh->mNumVertices; ++j)
+        const aiMesh* mesh = scene->mMeshes[i];
+        if (!isTriangleMesh(*mesh))
+        {
+            continue;
+        }
+        vertexCount += mesh->mNumVertices;
+        indexCount += countFaceIndices(*mesh);
+        ++submeshCount;
+    }
+    outVertices.resize(vertexCount);
+    outIndices.resize(indexCount);
+    outSubmeshes.clear();
+    outSubmeshes.reserve(submeshCount);
+    const std::vector<std::int32_t> materialLayers
+        = loadMaterialTextures(*scene, filePath, threadPool, outTextureLayers);
+
+    static_assert(sizeof(*aiFace::mIndices) == sizeof(GLuint));
+    Vertex* vertexOut = outVertices.data();
+    GLuint* indexOut = outIndices.data();
+    for (size_t i = 0; i < scene->mNumMeshes; ++i)
+    {
+        const aiMesh* mesh = scene->mMeshes[i];
+        if (!isTriangleMesh(*mesh))
         {
-            Vertex vertex;
-            vertex.position.x = mesh->mVertices[j].x;
-            vertex.position.y = mesh->mVertices[j].y;
-            vertex.position.z = mesh->mVertices[j].z;
-            vertex.normal.x = mesh->mNormals[j].x;
-            vertex.normal.y = mesh->mNormals[j].y;
-            vertex.normal.z = mesh->mNormals[j].z;
-            outVertices.push_back(vertex);
+            continue;
         }
+        const auto baseVertex
+            = static_cast<GLuint>(vertexOut - outVertices.data());
+        const auto firstIndex
+            = static_cast<GLuint>(indexOut - outIndices.data());
 
-        for (size_t j = 0; j < mesh->mNumFaces; ++j)
+        const aiVector3D* positions = mesh->mVertices;
+        const aiVector3D* normals = mesh->mNormals;
+        const aiVector3D* texCoords = mesh->mTextureCoords[0];
+        // Straight-line loop over contiguous arrays without bookkeeping of
+        // container size lets the compiler vectorize copying
+        for (size_t j = 0; j < mesh->mNumVertices; ++j)
         {
-            aiFace face = mesh->mFaces[j];
-            for (size_t k = 0; k < face.mNumIndices; ++k)
+            vertexOut[j].position
+                = glm::vec3{positions[j].x, positions[j].y, positions[j].z};
+        }
+        if (normals)
+        {
+            for (size_t j = 0; j < mesh->mNumVertices; ++j)
             {
-                outIndices.push_back(face.mIndices[k]);
+                vertexOut[j].normal
+                    = glm::vec3{normals[j].x, normals[j].y, normals[j].z};
             }
         }
+        if (texCoords)
+        {
+            for (size_t j = 0; j < mesh->mNumVertices; ++j)
+            {
+                vertexOut[j].texCoord
+                    = glm::vec2{texCoords[j].x, texCoords[j].y};
+            }
+        }
+        vertexOut += mesh->mNumVertices;
+
+        // Faces are only referenced to avoid copying them
+        for (size_t j = 0; j < mesh->mNumFaces; ++j)
+        {
+            const aiFace& face = mesh->mFaces[j];
+            std::memcpy(indexOut,
+                        face.mIndices,
+                        face.mNumIndices * sizeof(GLuint));
+            indexOut += face.mNumIndices;
+        }
+
+        const auto submeshIndexCount
+            = static_cast<GLuint>(indexOut - outIndices.data()) - firstIndex;
+        // Normals are missing only when the importer did not generate them
+        if (!normals)
+        {
+            meshprocessing::generateSmoothNormals(
+                std::span{outVertices}.subspan(baseVertex, mesh->mNumVertices),
+                std::span{outIndices}.subspan(firstIndex, submeshIndexCount),
+                threadPool);
+        }
+        outSubmeshes.push_back({
+            .firstIndex = firstIndex,
+            .indexCount = submeshIndexCount,
+            .baseVertex = static_cast<GLint>(baseVertex),
+            .firstMeshlet = 0,
+            .meshletCount = 0,
+            .firstLod = 0,
+            .lodCount = 0,
+            .baseColor = getBaseColor(*scene, *mesh),
+            .opacity = getOpacity(*scene, *mesh),
+            .textureLayer
+            = texCoords && mesh->mMaterialIndex < scene->mNumMaterials
+                ? materialLayers[mesh->mMaterialIndex]
+                : NO_TEXTURE_LAYER,
+        });
     }
 
     return true;
@@ -118,25 +1174,106 @@ bool Model::loadModelFromFile(const fs::path& filePath,
 
 Model::Model()
     : vertexArray{0}
+#ifdef __EMSCRIPTEN__
+    , wireframeVertexArray{0}
+#endif
+    , textureArray{0}
+    , positionTransform{1.0F}
+    , indexType{GL_UNSIGNED_INT}
+    , indexCount{0}
+    , bounds{}
+    , boundingSphere{}
     , vertexBuffer_{0}
     , indexBuffer_{0}
+#ifdef __EMSCRIPTEN__
+    , wireframeVertexBuffer_{0}
+    , vertexFormat_{VertexFormat::Float}
+#endif
+    , videoMemorySize_{0}
+    , textureMemorySize_{0}
+    , geometryArena_{nullptr}
+#ifndef __EMSCRIPTEN__
+    , clusterStreamer_{nullptr}
+#endif
 {
 }
 
 Model::Model(Model&& other) noexcept
     : vertexArray{std::exchange(other.vertexArray, 0)}
-    , indices{std::move(other.indices)}
+#ifdef __EMSCRIPTEN__
+    , wireframeVertexArray{std::exchange(other.wireframeVertexArray, 0)}
+#endif
+    , textureArray{std::exchange(other.textureArray, 0)}
+    , positionTransform{other.positionTransform}
+    , indexType{other.indexType}
+    , indexCount{std::exchange(other.indexCount, 0)}
+    , submeshIndexCounts{std::move(other.submeshIndexCounts)}
+    , submeshIndexOffsets{std::move(other.submeshIndexOffsets)}
+    , submeshBaseVertices{std::move(other.submeshBaseVertices)}
+    , submeshes{std::move(other.submeshes)}
+    , meshlets{std::move(other.meshlets)}
+    , lods{std::move(other.lods)}
+    , bounds{other.bounds}
+    , boundingSphere{other.boundingSphere}
+    , cpuGeometry{std::move(other.cpuGeometry)}
+    , arenaMesh{std::exchange(other.arenaMesh, std::nullopt)}
+#ifndef __EMSCRIPTEN__
+    , streamedMesh{std::exchange(other.streamedMesh, std::nullopt)}
+#endif
+    , impostor{std::exchange(other.impostor, std::nullopt)}
+    , occluder{std::move(other.occluder)}
     , vertexBuffer_{std::exchange(other.vertexBuffer_, 0)}
     , indexBuffer_{std::exchange(other.indexBuffer_, 0)}
+#ifdef __EMSCRIPTEN__
+    , wireframeVertexBuffer_{std::exchange(other.wireframeVertexBuffer_, 0)}
+    , vertexFormat_{other.vertexFormat_}
+#endif
+    , videoMemorySize_{std::exchange(other.videoMemorySize_, 0)}
+    , textureMemorySize_{std::exchange(other.textureMemorySize_, 0)}
+    , geometryArena_{std::exchange(other.geometryArena_, nullptr)}
+#ifndef __EMSCRIPTEN__
+    , clusterStreamer_{std::exchange(other.clusterStreamer_, nullptr)}
+#endif
 {
 }
 
 Model& Model::operator=(Model&& other) noexcept
 {
     std::swap(vertexArray, other.vertexArray);
-    indices = std::move(other.indices);
+#ifdef __EMSCRIPTEN__
+    std::swap(wireframeVertexArray, other.wireframeVertexArray);
+#endif
+    std::swap(textureArray, other.textureArray);
+    std::swap(positionTransform, other.positionTransform);
+    std::swap(indexType, other.indexType);
+    std::swap(indexCount, other.indexCount);
+    std::swap(submeshIndexCounts, other.submeshIndexCounts);
+    std::swap(submeshIndexOffsets, other.submeshIndexOffsets);
+    std::swap(submeshBaseVertices, other.submeshBaseVertices);
+    std::swap(submeshes, other.submeshes);
+    std::swap(meshlets, other.meshlets);
+    std::swap(lods, other.lods);
+    std::swap(bounds, other.bounds);
+    std::swap(boundingSphere, other.boundingSphere);
+    std::swap(cpuGeometry, other.cpuGeometry);
+    std::swap(arenaMesh, other.arenaMesh);
+#ifndef __EMSCRIPTEN__
+    std::swap(streamedMesh, other.streamedMesh);
+#endif
+    std::swap(impostor, other.impostor);
+    std::swap(occluder, other.occluder);
     std::swap(vertexBuffer_, other.vertexBuffer_);
     std::swap(indexBuffer_, other.indexBuffer_);
+#ifdef __EMSCRIPTEN__
+    std::swap(wireframeVertexBuffer_, other.wireframeVertexBuffer_);
+    std::swap(vertexFormat_, other.vertexFormat_);
+#endif
+    std::swap(videoMemorySize_, other.videoMemorySize_);
+    std::swap(textureMemorySize_, other.textureMemorySize_);
+    std::swap(geometryArena_, other.geometryArena_);
+#ifndef __EMSCRIPTEN__
+    std::swap(clusterStreamer_, other.clusterStreamer_);
+#endif
     return *this;
 }
 
@@ -145,5 +1282,49 @@ Model::~Model()
     glDeleteVertexArrays(1, &vertexArray);
     glDeleteBuffers(1, &indexBuffer_);
     glDeleteBuffers(1, &vertexBuffer_);
+#ifdef __EMSCRIPTEN__
+    glDeleteVertexArrays(1, &wireframeVertexArray);
+    glDeleteBuffers(1, &wireframeVertexBuffer_);
+#endif
+    glDeleteTextures(1, &textureArray);
+    videomemory::release(videomemory::Category::Geometry, videoMemorySize_);
+    videomemory::release(videomemory::Category::Texture, textureMemorySize_);
+    if (arenaMesh)
+    {
+        geometryArena_->remove(arenaMesh.value());
+    }
+#ifndef __EMSCRIPTEN__
+    if (streamedMesh)
+    {
+        clusterStreamer_->remove(streamedMesh.value());
+    }
+#endif
+}
+
+size_t Model::videoMemorySize() const
+{
+    return videoMemorySize_ + textureMemorySize_
+         + (impostor ? ImpostorAtlas::videoMemorySize() : 0);
+}
+
+void Model::addToArena(GeometryArena& geometryArena, const MeshData& meshData)
+{
+    if (arenaMesh)
+    {
+        geometryArena_->remove(arenaMesh.value());
+    }
+    arenaMesh = geometryArena.add(meshData);
+    geometryArena_ = &geometryArena;
+}
+
+void Model::addToArena(GeometryArena& geometryArena,
+                       const EncodedArenaGeometry& geometry)
+{
+    if (arenaMesh)
+    {
+        geometryArena_->remove(arenaMesh.value());
+    }
+    arenaMesh = geometryArena.add(geometry);
+    geometryArena_ = &geometryArena;
 }
 
@@ -1,26 +1,141 @@
 #ifndef MODEL_H_
 #define MODEL_H_
 
-#ifdef __EMSCRIPTEN__
-#include "glad/gles2.h"
-#else
-#include "glad/gl.h"
-#endif
+#include "bvh.h"
+#include "clusterpages.h"
+#include "geometryarena.h"
+#include "impostor.h"
+#include "mesh.h"
+
+#include "glm/mat4x4.hpp"
 #include "glm/vec3.hpp"
 
+#include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <vector>
 
+class ClusterStreamer;
+class ThreadPool;
+
+/// Model space triangles of a model kept in system memory for CPU-side queries
+/// like picking or collision detection. Indices refer to positions directly,
+/// without sub-mesh base vertex.
+struct CpuGeometry
+{
+    /// Nearest triangle hit by model space ray. Nothing is hit when the
+    /// model was imported without a bounding volume hierarchy.
+    [[nodiscard]] std::optional<bvh::Hit> intersect(const bvh::Ray& ray) const
+    {
+        return bvh::intersect(bvhNodes, bvhTriangles, positions, indices, ray);
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> indices;
+    /// Bounding volume hierarchy over the triangles. Empty unless built on
+    /// import.
+    std::vector<BvhNode> bvhNodes;
+    std::vector<GLuint> bvhTriangles;
+};
+
+/// Coarsest geometry of a model in model space, rasterized on the CPU as
+/// occluder by software occlusion culling. Indices refer to positions
+/// directly, without sub-mesh base vertex.
+struct OccluderMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> indices;
+};
+
 /// Representation of 3D model (currently mesh only).
 ///
 /// Non-copyable, move-only. Mesh face vertices reside in GPU memory.
 /// Vertices are referred by indices to avoid storing duplicated vertices.
+/// A copy of the geometry is kept in system memory only when requested.
 class Model
 {
 public:
     /// Factory method loading a model file and initializing buffers.
-    static std::optional<Model> create(const std::filesystem::path& filePath);
+    static std::optional<Model> create(const std::filesystem::path& filePath,
+                                       const ImportOptions& options);
+    /// Factory method initializing buffers from already imported geometry.
+    ///
+    /// Must be called on the thread the graphics context is current on.
+    /// Geometry is kept in system memory as well when CPU geometry is kept.
+    static Model create(const MeshData& meshData, bool keepCpuGeometry = false);
+
+#ifndef __EMSCRIPTEN__
+    /// Vertex and index buffers of geometry, created ahead of the model.
+    struct GeometryBuffers
+    {
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+    };
+
+    /// Upload stage of model creation, creating and filling buffers of
+    /// geometry. May be called on any thread with a context current that
+    /// shares objects with the context the model is drawn in.
+    static GeometryBuffers uploadGeometry(const MeshData& meshData);
+
+    /// Factory method taking over buffers of geometry uploaded ahead, which
+    /// have to be finished uploading. Vertex arrays are not shared between
+    /// contexts, so they are created here.
+    ///
+    /// Must be called on the thread the graphics context is current on.
+    static Model create(const MeshData& meshData,
+                        GeometryBuffers buffers,
+                        bool keepCpuGeometry = false);
+#endif
+
+#ifndef __EMSCRIPTEN__
+    /// Factory method registering cluster pages of geometry with a cluster
+    /// streamer instead of uploading the geometry whole, for meshes larger
+    /// than video memory. Streamer has to outlive the model.
+    ///
+    /// Must be called on the thread the graphics context is current on.
+    static Model createStreamed(const MeshData& meshData,
+                                clusterpages::PagedMesh&& pagedMesh,
+                                ClusterStreamer& clusterStreamer,
+                                bool keepCpuGeometry = false);
+#endif
+
+    /// Factory method creating a unit cube from built-in geometry without any
+    /// file access. Used as stand-in while the actual model is still loading.
+    static Model createPlaceholder();
+
+    /// Import stage of model creation, reading mesh geometry from binary cache
+    /// or from model file.
+    ///
+    /// Does not issue graphics API calls, allowing to import models on worker
+    /// threads in parallel while buffer creation happens on the main thread.
+    /// Bounding volume hierarchy is built on the thread pool when given.
+    static std::optional<MeshData> loadMeshData(
+        const std::filesystem::path& filePath,
+        const ImportOptions& options,
+        ThreadPool* threadPool = nullptr);
+
+    /// Append full detail geometry to geometry arena, from which it is removed
+    /// again when model is destroyed. Arena has to outlive the model.
+    void addToArena(GeometryArena& geometryArena, const MeshData& meshData);
+    /// Append geometry encoded from full detail mesh data instead.
+    void addToArena(GeometryArena& geometryArena,
+                    const EncodedArenaGeometry& geometry);
+
+#ifndef __EMSCRIPTEN__
+    /// Vertex buffer the model is drawn from, written in place when geometry
+    /// is edited. Zero for models drawn from the cluster streamer.
+    [[nodiscard]] GLuint vertexBuffer() const { return vertexBuffer_; }
+#else
+    /// Create wireframe vertex array from the buffers of the model, unless
+    /// created already. Called once wireframe drawing is requested, as the
+    /// expanded vertices take several times the memory of indexed ones.
+    void createWireframe();
+#endif
+
+    /// Video memory taken by vertex and index buffers, material textures and
+    /// impostor atlas of the model itself in bytes, excluding geometry arena
+    /// and cluster streamer.
+    [[nodiscard]] size_t videoMemorySize() const;
 
     Model(const Model& other) = delete;
     Model& operator=(const Model& other) = delete;
@@ -32,27 +147,97 @@ public:
     // (Exposed as public variables instead of getters due to performance
     // concerns)
     GLuint vertexArray;
-    std::vector<GLuint> indices;
+#ifdef __EMSCRIPTEN__
+    /// Vertex array of wireframe draws, holding a vertex per index of the
+    /// index buffer and drawn without indices. Ranges of indices are drawn as
+    /// the same ranges of vertices. Zero until createWireframe() is called.
+    GLuint wireframeVertexArray;
+#endif
+    /// Base color textures of materials in layers of LAYER_SIZE of
+    /// materialtexture, referred to by texture layer of sub-meshes. Zero
+    /// when no material is textured.
+    GLuint textureArray;
+    /// Transformation from vertex buffer positions to model space. Identity
+    /// unless positions are quantized, in which case it is meant to be folded
+    /// into the model matrix for dequantization.
+    glm::mat4 positionTransform;
+    /// GL_UNSIGNED_SHORT when all indices fit in 16 bits, otherwise
+    /// GL_UNSIGNED_INT.
+    GLenum indexType;
+    /// Only the number of indices is kept on CPU side for issuing draw calls,
+    /// index data itself resides in GPU memory. Covers full detail sub-meshes
+    /// only, simplified meshlets of cluster level of detail are stored after
+    /// them.
+    GLsizei indexCount;
+    /// Per sub-mesh draw parameters laid out as separate arrays, matching the
+    /// parameters of a multi-draw call covering all sub-meshes at once.
+    std::vector<GLsizei> submeshIndexCounts;
+    std::vector<const GLvoid*> submeshIndexOffsets;
+    std::vector<GLint> submeshBaseVertices;
+    /// Sub-mesh ranges with their cluster level of detail hierarchies and
+    /// discrete level of detail chains, from which geometry to draw is
+    /// selected each frame. Empty when none were built.
+    std::vector<Submesh> submeshes;
+    std::vector<Meshlet> meshlets;
+    std::vector<SubmeshLod> lods;
+    /// Model space bounding volumes of the geometry, computed on import for
+    /// visibility tests.
+    Bounds bounds;
+    BoundingSphere boundingSphere;
+    /// Empty unless model was created with keeping CPU geometry.
+    std::optional<CpuGeometry> cpuGeometry;
+    /// Placement of full detail geometry in the shared geometry arena. Empty
+    /// unless added to an arena.
+    std::optional<ArenaMesh> arenaMesh;
+#ifndef __EMSCRIPTEN__
+    /// Mesh of the cluster streamer the model is drawn from instead of its
+    /// own buffers. Empty unless model was created streamed.
+    std::optional<std::uint32_t> streamedMesh;
+#endif
+    /// Views of the model drawn in place of distant copies. Empty until baked
+    /// by the renderer.
+    std::optional<ImpostorAtlas> impostor;
+    /// Empty when even the coarsest geometry has too many triangles to be
+    /// rasterized on the CPU every frame.
+    std::optional<OccluderMesh> occluder;
 
 private:
-    /// Per-vertex data containing vertex attributes for each vertex.
-    ///
-    /// Texture UV coordinates are omitted because none of the bundled default
-    /// models have textures.
-    struct Vertex
-    {
-        glm::vec3 position;
-        glm::vec3 normal;
-    };
-
     static bool loadModelFromFile(const std::filesystem::path& filePath,
+                                  const ImportOptions& options,
+                                  ThreadPool* threadPool,
                                   std::vector<Vertex>& outVertices,
-                                  std::vector<GLuint>& outIndices);
+                                  std::vector<GLuint>& outIndices,
+                                  std::vector<Submesh>& outSubmeshes,
+                                  std::vector<std::byte>& outTextureLayers);
 
     Model();
 
+    void uploadBuffers(const MeshData& meshData);
+#ifndef __EMSCRIPTEN__
+    void adoptBuffers(const MeshData& meshData, GeometryBuffers buffers);
+#endif
+    /// Draw parameters of sub-meshes and transformation of vertex positions.
+    void setDrawParameters(const MeshData& meshData);
+    /// Create texture array from texture layers of mesh data, if any.
+    void uploadTextures(const MeshData& meshData);
+
     GLuint vertexBuffer_;
     GLuint indexBuffer_;  /// Index buffer avoids duplication of vertices in
                           /// vertex buffer
+#ifdef __EMSCRIPTEN__
+    GLuint wireframeVertexBuffer_;
+    /// Layout of the vertex buffer, expanded into the wireframe one.
+    VertexFormat vertexFormat_;
+#endif
+    /// Video memory taken by vertex and index buffers in bytes.
+    size_t videoMemorySize_;
+    /// Video memory taken by the texture array and its mip chain in bytes.
+    size_t textureMemorySize_;
+    /// Arena holding arena mesh, if any.
+    GeometryArena* geometryArena_;
+#ifndef __EMSCRIPTEN__
+    /// Streamer holding streamed mesh, if any.
+    ClusterStreamer* clusterStreamer_;
+#endif
 };
 #endif
@@ -0,0 +1,335 @@
+#include "modelloader.h"
+
+#include "allocationtracker.h"
+#include "geometryarena.h"
+#include "meshcache.h"
+#include "threadpool.h"
+#include "utils.h"
+#ifdef __EMSCRIPTEN__
+#include "webmeshfetch.h"
+#else
+#include "clusterstreamer.h"
+#include "uploadcontext.h"
+#endif
+
+#include <memory>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Cluster pages of mesh from the mesh cache, splitting mesh into pages and
+/// caching them first when missing or outdated.
+std::optional<clusterpages::PagedMesh> mapPages(const fs::path& path,
+                                                const ImportOptions& options,
+                                                const MeshData& meshData)
+{
+    std::optional<clusterpages::PagedMesh> pagedMesh
+        = meshcache::mapPages(path, options);
+    if (pagedMesh)
+    {
+        return pagedMesh;
+    }
+    Bounds bounds{};
+    std::vector<clusterpages::ClusterPage> pages;
+    std::vector<clusterpages::PagedMeshlet> meshlets;
+    std::vector<std::byte> payload;
+    if (!clusterpages::build(meshData, bounds, pages, meshlets, payload))
+    {
+        utils::logWarning("unable to split ",
+                          path,
+                          " into cluster pages, uploading it whole");
+        return std::nullopt;
+    }
+    // Streamed straight from the page file, which is paged in on access
+    // instead of keeping the payload in system memory
+    if (!meshcache::storePages(path,
+                               options,
+                               bounds,
+                               pages,
+                               meshlets,
+                               payload))
+    {
+        return std::nullopt;
+    }
+    return meshcache::mapPages(path, options);
+}
+}  // namespace
+
+ModelLoader::ModelLoader(ThreadPool& threadPool,
+                         const ImportOptions& importOptions,
+                         GeometryArena* geometryArena,
+                         ClusterStreamer* clusterStreamer,
+                         UploadContext* uploadContext)
+    : threadPool_(threadPool)
+    , importOptions_(importOptions)
+    , geometryArena_{geometryArena}
+    , clusterStreamer_{clusterStreamer}
+    , uploadContext_{uploadContext}
+    , finishedResults_{std::make_shared<std::queue<Result>>()}
+    , pendingRequestCount_{0}
+{
+}
+
+void ModelLoader::request(size_t id,
+                          const fs::path& path,
+                          bool keepCpuGeometry)
+{
+    request(id, path, importOptions_, keepCpuGeometry);
+}
+
+void ModelLoader::request(size_t id,
+                          const fs::path& path,
+                          const ImportOptions& importOptions,
+                          bool keepCpuGeometry)
+{
+    ++pendingRequestCount_;
+#ifdef __EMSCRIPTEN__
+    // Fetched levels are handed over like imports finished on a worker, so
+    // that buffers are created while the main thread tasks are run
+    webmeshfetch::fetch(
+        path,
+        importOptions,
+        threadPool_,
+        [id,
+         path,
+         keepCpuGeometry,
+         threadPool = &threadPool_,
+         finishedResults = finishedResults_](
+            std::optional<MeshData>&& meshData,
+            bool complete)
+        {
+            Import import{
+                .id = id,
+                .path = path,
+                .keepCpuGeometry = keepCpuGeometry,
+                .meshData = std::move(meshData),
+                .pagedMesh = std::nullopt,
+                .arenaGeometry = std::nullopt,
+                .partial = !complete,
+            };
+            threadPool->submitToMainThread(
+                [import = std::make_shared<Import>(std::move(import)),
+                 finishedResults]()
+                {
+                    finishedResults->push(createResult(std::move(*import),
+                                                       nullptr,
+                                                       nullptr));
+                });
+        });
+    return;
+#endif
+    Request request{
+        .id = id,
+        .path = path,
+        .importOptions = importOptions,
+        .keepCpuGeometry = keepCpuGeometry,
+    };
+    // Without worker threads, the import would block the caller right away.
+    if (threadPool_.threadCount() == 0)
+    {
+        deferredRequests_.push(std::move(request));
+        return;
+    }
+
+    // Future is not needed, result is handed over through the main thread
+    threadPool_.submit(
+        [request = std::move(request),
+         streamingBudget = streamingBudget(),
+         threadPool = &threadPool_,
+         geometryArena = geometryArena_,
+         clusterStreamer = clusterStreamer_,
+         uploadContext = uploadContext_,
+         finishedResults = finishedResults_]()
+        {
+            // Main thread tasks are copyable, so the move-only import is
+            // shared instead of captured by value
+            auto import = std::make_shared<Import>(
+                importModel(request, streamingBudget, threadPool));
+            // Packing and encoding of arena geometry are done here instead
+            // of on the main thread, which only uploads the smaller streams
+            if (geometryArena && import->meshData
+                && !(import->pagedMesh && clusterStreamer))
+            {
+                import->arenaGeometry
+                    = GeometryArena::encode(import->meshData.value());
+            }
+#ifndef __EMSCRIPTEN__
+            // Buffers of meshes uploaded whole are filled by the upload
+            // context, so that large uploads do not stall frames. Uploads
+            // refused by a context not running are done on the main thread.
+            if (uploadContext && import->meshData
+                && !(import->pagedMesh && clusterStreamer))
+            {
+                auto buffers = std::make_shared<Model::GeometryBuffers>();
+                const bool submitted = uploadContext->submit(
+                    [import, buffers]()
+                    {
+                        *buffers
+                            = Model::uploadGeometry(import->meshData.value());
+                    },
+                    [import, buffers, geometryArena, finishedResults]()
+                    {
+                        finishedResults->push(
+                            createUploadedResult(std::move(*import),
+                                                 *buffers,
+                                                 geometryArena));
+                    });
+                if (submitted)
+                {
+                    return;
+                }
+            }
+#else
+            static_cast<void>(uploadContext);
+#endif
+            // GPU buffers can only be created where the context is current
+            threadPool->submitToMainThread(
+                [import = std::move(import),
+                 geometryArena,
+                 clusterStreamer,
+                 finishedResults]()
+                {
+                    finishedResults->push(createResult(std::move(*import),
+                                                       geometryArena,
+                                                       clusterStreamer));
+                });
+        });
+}
+
+std::optional<ModelLoader::Result> ModelLoader::poll()
+{
+    if (finishedResults_->empty() && !deferredRequests_.empty())
+    {
+        const Request request = std::move(deferredRequests_.front());
+        deferredRequests_.pop();
+        finishedResults_->push(
+            createResult(importModel(request, streamingBudget(), nullptr),
+                         geometryArena_,
+                         clusterStreamer_));
+    }
+    if (finishedResults_->empty())
+    {
+        return std::nullopt;
+    }
+
+    Result result = std::move(finishedResults_->front());
+    if (!result.partial)
+    {
+        --pendingRequestCount_;
+    }
+    finishedResults_->pop();
+    return result;
+}
+
+ModelLoader::Import ModelLoader::importModel(const Request& request,
+                                             size_t streamingBudget,
+                                             ThreadPool* threadPool)
+{
+    ALLOCATION_SCOPE(Loader);
+    Import import{
+        .id = request.id,
+        .path = request.path,
+        .keepCpuGeometry = request.keepCpuGeometry,
+        .meshData = Model::loadMeshData(request.path,
+                                        request.importOptions,
+                                        threadPool),
+        .pagedMesh = std::nullopt,
+        .arenaGeometry = std::nullopt,
+        .partial = false,
+    };
+    // Pages refine meshlets of the hierarchy, so meshes without one are
+    // uploaded whole regardless of size
+    if (import.meshData && !import.meshData->meshlets().empty()
+        && streamingBudget > 0
+        && import.meshData->vertexData().size_bytes()
+                   + import.meshData->indexData().size_bytes()
+               > streamingBudget)
+    {
+        import.pagedMesh = mapPages(request.path,
+                                    request.importOptions,
+                                    import.meshData.value());
+    }
+    return import;
+}
+
+ModelLoader::Result ModelLoader::createResult(Import&& import,
+                                              GeometryArena* geometryArena,
+                                              ClusterStreamer* clusterStreamer)
+{
+    Result result{
+        .id = import.id,
+        .path = std::move(import.path),
+        .model = std::nullopt,
+        .partial = import.partial,
+    };
+    if (!import.meshData)
+    {
+        return result;
+    }
+#ifndef __EMSCRIPTEN__
+    if (import.pagedMesh && clusterStreamer)
+    {
+        result.model = Model::createStreamed(import.meshData.value(),
+                                             std::move(*import.pagedMesh),
+                                             *clusterStreamer,
+                                             import.keepCpuGeometry);
+        return result;
+    }
+#else
+    static_cast<void>(clusterStreamer);
+#endif
+    result.model
+        = Model::create(import.meshData.value(), import.keepCpuGeometry);
+    if (geometryArena)
+    {
+        addToArena(*result.model, *geometryArena, import);
+    }
+    return result;
+}
+
+void ModelLoader::addToArena(Model& model,
+                             GeometryArena& geometryArena,
+                             const Import& import)
+{
+    if (import.arenaGeometry)
+    {
+        model.addToArena(geometryArena, import.arenaGeometry.value());
+    }
+    else
+    {
+        model.addToArena(geometryArena, import.meshData.value());
+    }
+}
+
+#ifndef __EMSCRIPTEN__
+ModelLoader::Result ModelLoader::createUploadedResult(
+    Import&& import,
+    Model::GeometryBuffers buffers,
+    GeometryArena* geometryArena)
+{
+    Result result{
+        .id = import.id,
+        .path = std::move(import.path),
+        .model = Model::create(import.meshData.value(),
+                               buffers,
+                               import.keepCpuGeometry),
+        .partial = import.partial,
+    };
+    if (geometryArena)
+    {
+        addToArena(*result.model, *geometryArena, import);
+    }
+    return result;
+}
+#endif
+
+size_t ModelLoader::streamingBudget() const
+{
+#ifndef __EMSCRIPTEN__
+    return clusterStreamer_ ? clusterStreamer_->budget() : 0;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,150 @@
+#ifndef MODEL_LOADER_H_
+#define MODEL_LOADER_H_
+
+#include "clusterpages.h"
+#include "mesh.h"
+#include "model.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <queue>
+
+class ClusterStreamer;
+class GeometryArena;
+class ThreadPool;
+class UploadContext;
+
+/// Asynchronous streaming of model files.
+///
+/// Model files are imported on background threads while the application keeps
+/// rendering. Finished imports are handed over to the thread owning the
+/// graphics context as main thread tasks of the thread pool, which create GPU
+/// buffers and queue the result for polling.
+///
+/// In environments without threads, imports are deferred and processed one per
+/// poll instead, so that the first frame is not delayed by model loading.
+///
+/// In the browser, model files are fetched over the network on demand. Models
+/// with progressive file arrive as a series of results, coarsest first.
+///
+/// Meshes with cluster level of detail whose geometry exceeds the budget of
+/// the cluster streamer are split into cluster pages and streamed instead of
+/// uploaded whole. Pages are cached next to the model file like the mesh
+/// itself.
+///
+/// On desktop, buffers of meshes uploaded whole are filled on the thread of
+/// the upload context when it was started, and only vertex arrays are
+/// created on the main thread.
+class ModelLoader
+{
+public:
+    /// Model that finished loading. Model is empty when loading failed.
+    struct Result
+    {
+        size_t id;
+        std::filesystem::path path;
+        std::optional<Model> model;
+        /// Whether a more refined model follows for the same request.
+        bool partial;
+    };
+
+    /// Geometry of loaded models is appended to geometry arena as well, when
+    /// given. Meshes are only streamed when cluster streamer is given, and
+    /// only uploaded in the background when upload context is given.
+    ModelLoader(ThreadPool& threadPool,
+                const ImportOptions& importOptions,
+                GeometryArena* geometryArena = nullptr,
+                ClusterStreamer* clusterStreamer = nullptr,
+                UploadContext* uploadContext = nullptr);
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+    ModelLoader(ModelLoader&&) = delete;
+    ModelLoader& operator=(ModelLoader&&) = delete;
+    ~ModelLoader() = default;
+
+    /// Begin loading model file in the background. Identifier is passed back
+    /// in the result to associate it with the request. Geometry is kept in
+    /// system memory of the loaded model as well when CPU geometry is kept.
+    void request(size_t id,
+                 const std::filesystem::path& path,
+                 bool keepCpuGeometry = false);
+    /// Begin loading model file with import options of its own instead of
+    /// those of the loader, like normal generation suited to the model.
+    void request(size_t id,
+                 const std::filesystem::path& path,
+                 const ImportOptions& importOptions,
+                 bool keepCpuGeometry = false);
+
+    /// Retrieve next model that finished loading, if any. Must be called on
+    /// the thread the graphics context is current on. Models imported in the
+    /// background show up after the main thread tasks of the thread pool were
+    /// run.
+    std::optional<Result> poll();
+
+    [[nodiscard]] bool hasPendingRequests() const
+    {
+        return pendingRequestCount_ > 0;
+    }
+
+private:
+    struct Request
+    {
+        size_t id;
+        std::filesystem::path path;
+        ImportOptions importOptions;
+        bool keepCpuGeometry;
+    };
+
+    struct Import
+    {
+        size_t id;
+        std::filesystem::path path;
+        bool keepCpuGeometry;
+        std::optional<MeshData> meshData;
+        /// Empty unless mesh exceeds the streaming budget.
+        std::optional<clusterpages::PagedMesh> pagedMesh;
+        /// Geometry encoded by the worker for the geometry arena, which
+        /// decodes it on upload. Empty when meshes are added to the arena
+        /// from mesh data instead.
+        std::optional<EncodedArenaGeometry> arenaGeometry;
+        bool partial;
+    };
+
+    /// Import stage, reading mesh geometry and its cluster pages when
+    /// geometry exceeds streaming budget. Zero budget disables streaming.
+    static Import importModel(const Request& request,
+                              size_t streamingBudget,
+                              ThreadPool* threadPool);
+    /// Create GPU buffers of imported geometry, or register its pages with
+    /// the cluster streamer.
+    static Result createResult(Import&& import,
+                               GeometryArena* geometryArena,
+                               ClusterStreamer* clusterStreamer);
+    /// Add geometry of import to the arena, encoded by the worker if it was.
+    static void addToArena(Model& model,
+                           GeometryArena& geometryArena,
+                           const Import& import);
+#ifndef __EMSCRIPTEN__
+    /// Create model from buffers of import filled by the upload context.
+    static Result createUploadedResult(Import&& import,
+                                       Model::GeometryBuffers buffers,
+                                       GeometryArena* geometryArena);
+#endif
+    /// Budget of the cluster streamer in bytes, zero without streamer.
+    [[nodiscard]] size_t streamingBudget() const;
+
+    ThreadPool& threadPool_;
+    ImportOptions importOptions_;
+    GeometryArena* geometryArena_;
+    ClusterStreamer* clusterStreamer_;
+    UploadContext* uploadContext_;
+    // Shared with main thread tasks in flight, so that an import finishing
+    // after destruction never pushes into a destroyed queue.
+    std::shared_ptr<std::queue<Result>> finishedResults_;
+    std::queue<Request> deferredRequests_;
+    size_t pendingRequestCount_;
+};
+
+#endif
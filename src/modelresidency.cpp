@@ -0,0 +1,61 @@
+#include "modelresidency.h"
+
+#include <algorithm>
+
+ModelResidency::ModelResidency(size_t videoMemoryBudget)
+    : videoMemoryBudget_{videoMemoryBudget}
+    , residentVideoMemory_{0}
+    , frame_{0}
+{
+}
+
+void ModelResidency::insert(size_t id, size_t videoMemorySize)
+{
+    // Replaced model, like a refined progressive one, is tracked by its new
+    // size
+    remove(id);
+    residentVideoMemory_ += videoMemorySize;
+    entries_.push_back(Entry{
+        .id = id,
+        .videoMemorySize = videoMemorySize,
+        .lastUsedFrame = frame_,
+    });
+}
+
+void ModelResidency::remove(size_t id)
+{
+    const auto it = std::ranges::find(entries_, id, &Entry::id);
+    if (it == entries_.end())
+    {
+        return;
+    }
+    residentVideoMemory_ -= it->videoMemorySize;
+    entries_.erase(it);
+}
+
+void ModelResidency::markUsed(size_t id)
+{
+    const auto it = std::ranges::find(entries_, id, &Entry::id);
+    if (it != entries_.end())
+    {
+        it->lastUsedFrame = frame_;
+    }
+}
+
+std::optional<size_t> ModelResidency::takeEvicted()
+{
+    if (residentVideoMemory_ <= videoMemoryBudget_)
+    {
+        return std::nullopt;
+    }
+    const auto it
+        = std::ranges::min_element(entries_, {}, &Entry::lastUsedFrame);
+    if (it == entries_.end() || it->lastUsedFrame == frame_)
+    {
+        return std::nullopt;
+    }
+    const size_t id = it->id;
+    residentVideoMemory_ -= it->videoMemorySize;
+    entries_.erase(it);
+    return id;
+}
@@ -0,0 +1,66 @@
+#ifndef MODEL_RESIDENCY_H_
+#define MODEL_RESIDENCY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/// Bookkeeping of models kept resident in video memory, deciding which ones
+/// to release once their combined video memory exceeds the budget.
+///
+/// Models themselves are owned elsewhere and released by destroying them, so
+/// that their buffers are freed the same way as any other model. Released
+/// models are loaded again from the binary mesh cache when needed, which
+/// skips parsing the model file.
+///
+/// Each model is stamped with the last frame it was used in. Least recently
+/// used models are released first, models used in the current frame never.
+class ModelResidency
+{
+public:
+    explicit ModelResidency(size_t videoMemoryBudget);
+
+    /// Start a new frame, after which models not marked as used are idle.
+    void beginFrame() { ++frame_; }
+
+    /// Track model of identifier as resident and used in the current frame.
+    void insert(size_t id, size_t videoMemorySize);
+    /// Stop tracking model of identifier released for other reasons.
+    void remove(size_t id);
+    /// Stamp resident model as used in the current frame. Ignored when model
+    /// is not resident.
+    void markUsed(size_t id);
+
+    void setVideoMemoryBudget(size_t videoMemoryBudget)
+    {
+        videoMemoryBudget_ = videoMemoryBudget;
+    }
+
+    /// Identifier of least recently used idle model to release while over
+    /// budget, no longer tracked afterwards. Nothing once within budget or
+    /// when only models used in the current frame are left.
+    std::optional<size_t> takeEvicted();
+
+    [[nodiscard]] size_t residentVideoMemory() const
+    {
+        return residentVideoMemory_;
+    }
+
+private:
+    struct Entry
+    {
+        size_t id;
+        size_t videoMemorySize;
+        uint64_t lastUsedFrame;
+    };
+
+    /// Unordered, searched linearly. Only the models of the catalog that fit
+    /// in the budget are resident, and eviction is rare.
+    std::vector<Entry> entries_;
+    size_t videoMemoryBudget_;
+    size_t residentVideoMemory_;
+    uint64_t frame_;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "objectpicker.h"
+
+#include "videomemory.h"
+
+ObjectPicker::ObjectPicker()
+    : readbacks_{}
+    , firstPending_{0}
+    , pendingCount_{0}
+{
+}
+
+ObjectPicker::~ObjectPicker()
+{
+    for (const Readback& readback : readbacks_)
+    {
+        if (readback.fence)
+        {
+            glDeleteSync(readback.fence);
+        }
+        if (readback.buffer)
+        {
+            glDeleteBuffers(1, &readback.buffer);
+            videomemory::release(videomemory::Category::Upload,
+                                 sizeof(std::uint32_t));
+        }
+    }
+}
+
+void ObjectPicker::readObjectId(int x, int y)
+{
+    Readback& readback
+        = readbacks_[(firstPending_ + pendingCount_) % readbacks_.size()];
+    ++pendingCount_;
+    if (!readback.buffer)
+    {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER,
+                     sizeof(std::uint32_t),
+                     nullptr,
+                     GL_STREAM_READ);
+        videomemory::allocate(videomemory::Category::Upload,
+                              sizeof(std::uint32_t));
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    }
+
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    // Blits and other readbacks expect the color attachment
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+std::optional<std::uint32_t> ObjectPicker::takeFinished()
+{
+    std::optional<std::uint32_t> objectId;
+    while (pendingCount_ > 0)
+    {
+        Readback& readback = readbacks_[firstPending_];
+        // Flushing makes sure the copy gets submitted, otherwise polling could
+        // wait for it forever
+        const GLenum status = glClientWaitSync(readback.fence,
+                                               GL_SYNC_FLUSH_COMMANDS_BIT,
+                                               0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        firstPending_ = (firstPending_ + 1) % readbacks_.size();
+        --pendingCount_;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        if (const void* mappedId = glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                                                    0,
+                                                    sizeof(std::uint32_t),
+                                                    GL_MAP_READ_BIT))
+        {
+            objectId = *static_cast<const std::uint32_t*>(mappedId);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    return objectId;
+}
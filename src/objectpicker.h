@@ -0,0 +1,62 @@
+#ifndef OBJECT_PICKER_H_
+#define OBJECT_PICKER_H_
+
+#include "glad/gl.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/// Asynchronous readback of the object identifier under a single pixel, for
+/// selecting objects by clicking them.
+///
+/// Only the one pixel is copied into a tiny pixel pack buffer, so picking
+/// costs the same regardless of scene complexity. Copies are fenced and taken
+/// once the GPU signalled them, usually a frame later, instead of stalling
+/// the pipeline for the frame being drawn.
+///
+/// Non-copyable, non-movable, pending copies refer to the buffers.
+class ObjectPicker
+{
+public:
+    ObjectPicker();
+    ObjectPicker(const ObjectPicker&) = delete;
+    ObjectPicker& operator=(const ObjectPicker&) = delete;
+    ObjectPicker(ObjectPicker&&) = delete;
+    ObjectPicker& operator=(ObjectPicker&&) = delete;
+    ~ObjectPicker();
+
+    /// Every buffer holds a copy not taken yet.
+    [[nodiscard]] bool isFull() const
+    {
+        return pendingCount_ == readbacks_.size();
+    }
+
+    /// Queue copy of identifier at given position from the second color
+    /// attachment of the framebuffer bound for reading. Must not be full.
+    void readObjectId(int x, int y);
+
+    /// Identifier of the newest copy the GPU finished, taking every finished
+    /// copy.
+    std::optional<std::uint32_t> takeFinished();
+
+private:
+    /// Copies in flight. Results normally arrive the next frame, a second
+    /// buffer lets the following frame queue its copy meanwhile.
+    static constexpr size_t READBACK_COUNT = 2;
+
+    struct Readback
+    {
+        GLuint buffer;
+        /// Signalled when the copy finished, null when the buffer is free.
+        GLsync fence;
+    };
+
+    std::array<Readback, READBACK_COUNT> readbacks_;
+    /// Oldest pending copy, followed by the rest in ring order.
+    size_t firstPending_;
+    size_t pendingCount_;
+};
+
+#endif
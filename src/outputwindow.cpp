@@ -0,0 +1,279 @@
+#include "outputwindow.h"
+
+#include "profiler.h"
+#include "utils.h"
+
+#include "GLFW/glfw3.h"
+
+#include <algorithm>
+
+namespace
+{
+/// Size of the window when no second monitor is connected.
+constexpr int WINDOWED_WIDTH = 960;
+constexpr int WINDOWED_HEIGHT = 540;
+}  // namespace
+
+OutputWindow::OutputWindow()
+    : window_{nullptr}
+    , renderbuffers_{}
+    , framebuffers_{}
+    , targetSizes_{}
+    , fences_{}
+    , targetCount_{0}
+    , stopping_{false}
+    , presentRequested_{false}
+    , windowSize_{0}
+{
+}
+
+OutputWindow::~OutputWindow()
+{
+    stop();
+}
+
+bool OutputWindow::start(GLFWwindow* sharedWindow)
+{
+    // Primary monitor is listed first, and is where the main window opens
+    int monitorCount = 0;
+    GLFWmonitor** monitors = glfwGetMonitors(&monitorCount);
+    GLFWmonitor* monitor = monitorCount > 1 ? monitors[1] : nullptr;
+
+    // Context hints of the shared window are still set, so the context is
+    // created with the same version and profile. Fullscreen window stays on
+    // its monitor while the main window has focus.
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+    glfwWindowHint(GLFW_AUTO_ICONIFY, GL_FALSE);
+    glfwWindowHint(GLFW_FOCUS_ON_SHOW, GL_FALSE);
+    if (monitor)
+    {
+        // Current video mode of the monitor is kept instead of switching it
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        window_ = glfwCreateWindow(mode->width,
+                                   mode->height,
+                                   "3D renderer output",
+                                   monitor,
+                                   sharedWindow);
+    }
+    else
+    {
+        window_ = glfwCreateWindow(WINDOWED_WIDTH,
+                                   WINDOWED_HEIGHT,
+                                   "3D renderer output",
+                                   nullptr,
+                                   sharedWindow);
+    }
+    glfwWindowHint(GLFW_AUTO_ICONIFY, GL_TRUE);
+    glfwWindowHint(GLFW_FOCUS_ON_SHOW, GL_TRUE);
+    if (!window_)
+    {
+        utils::logWarning("unable to create output window");
+        return false;
+    }
+    glfwSetWindowUserPointer(window_, this);
+    glfwSetFramebufferSizeCallback(window_, frameBufferSizeCallback);
+
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window_, &width, &height);
+    windowSize_ = glm::ivec2{width, height};
+    stopping_ = false;
+    presentRequested_ = false;
+    frames_.emplace(Frame{
+        .target = NO_TARGET,
+        .renderbuffer = 0,
+        .size = glm::ivec2{0},
+        .copied = nullptr,
+    });
+    thread_ = std::thread(&OutputWindow::run, this);
+    return true;
+}
+
+void OutputWindow::stop()
+{
+    if (!window_)
+    {
+        return;
+    }
+    {
+        const std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_one();
+    thread_.join();
+
+    // Presenting context finished reading every renderbuffer before it
+    // released the context
+    for (std::uint32_t i = 0; i < targetCount_; ++i)
+    {
+        glDeleteFramebuffers(1, &framebuffers_[i]);
+        glDeleteRenderbuffers(1, &renderbuffers_[i]);
+        if (fences_[i])
+        {
+            glDeleteSync(fences_[i]);
+        }
+    }
+    renderbuffers_ = {};
+    framebuffers_ = {};
+    targetSizes_ = {};
+    fences_ = {};
+    targetCount_ = 0;
+    frames_.reset();
+    glfwDestroyWindow(window_);
+    window_ = nullptr;
+}
+
+bool OutputWindow::isCloseRequested() const
+{
+    return window_ && glfwWindowShouldClose(window_);
+}
+
+void OutputWindow::publishFrame(int frameBufferWidth, int frameBufferHeight)
+{
+    PROFILE_SCOPE("OutputWindow::publishFrame");
+    // Renderbuffer of the write slot is not read by the presenting context,
+    // which finished reading it before handing the slot back
+    Frame& frame = frames_->writeBuffer();
+    if (frame.target == NO_TARGET)
+    {
+        frame.target = targetCount_++;
+        glGenRenderbuffers(1, &renderbuffers_[frame.target]);
+        glGenFramebuffers(1, &framebuffers_[frame.target]);
+        frame.renderbuffer = renderbuffers_[frame.target];
+    }
+    const std::uint32_t target = frame.target;
+    const glm::ivec2 size{frameBufferWidth, frameBufferHeight};
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers_[target]);
+    if (targetSizes_[target] != size)
+    {
+        // Renderbuffers are not bound through the state cache, unlike
+        // textures
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[target]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER,
+                                  GL_COLOR_ATTACHMENT0,
+                                  GL_RENDERBUFFER,
+                                  renderbuffers_[target]);
+        targetSizes_[target] = size;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0,
+                      0,
+                      size.x,
+                      size.y,
+                      0,
+                      0,
+                      size.x,
+                      size.y,
+                      GL_COLOR_BUFFER_BIT,
+                      GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (fences_[target])
+    {
+        glDeleteSync(fences_[target]);
+    }
+    fences_[target] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Flushed, so that the presenting context waiting for the fence does not
+    // depend on further commands of this context
+    glFlush();
+    frame.size = size;
+    frame.copied = fences_[target];
+    frames_->publish();
+    {
+        const std::lock_guard lock(mutex_);
+        presentRequested_ = true;
+    }
+    changed_.notify_one();
+}
+
+void OutputWindow::frameBufferSizeCallback(GLFWwindow* window,
+                                           int width,
+                                           int height)
+{
+    auto* outputWindow
+        = static_cast<OutputWindow*>(glfwGetWindowUserPointer(window));
+    {
+        const std::lock_guard lock(outputWindow->mutex_);
+        outputWindow->windowSize_ = glm::ivec2{width, height};
+        outputWindow->presentRequested_ = true;
+    }
+    outputWindow->changed_.notify_one();
+}
+
+void OutputWindow::run()
+{
+    glfwMakeContextCurrent(window_);
+    // Paced by the display of this window alone
+    glfwSwapInterval(1);
+    glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
+    // Framebuffers are not shared between contexts
+    GLuint readFramebuffer = 0;
+    glGenFramebuffers(1, &readFramebuffer);
+
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        changed_.wait(lock,
+                      [this]() { return stopping_ || presentRequested_; });
+        if (stopping_)
+        {
+            break;
+        }
+        presentRequested_ = false;
+        const glm::ivec2 windowSize = windowSize_;
+        lock.unlock();
+        // Same frame is presented again when only the window was resized
+        const Frame& frame = frames_->read();
+        if (frame.target != NO_TARGET && windowSize.x > 0 && windowSize.y > 0)
+        {
+            PROFILE_SCOPE("OutputWindow::present");
+            present(frame, readFramebuffer, windowSize);
+            glfwSwapBuffers(window_);
+            // Slot is handed back to the main thread by the next read, so
+            // reading its renderbuffer has to be finished by then
+            glFinish();
+        }
+        lock.lock();
+    }
+    lock.unlock();
+    glDeleteFramebuffers(1, &readFramebuffer);
+    glfwMakeContextCurrent(nullptr);
+}
+
+void OutputWindow::present(const Frame& frame,
+                           GLuint readFramebuffer,
+                           glm::ivec2 windowSize)
+{
+    // Waited for on the GPU, without blocking this thread
+    glWaitSync(frame.copied, 0, GL_TIMEOUT_IGNORED);
+    // Attached again for every frame, so that storage respecified by the main
+    // context is picked up
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+    glFramebufferRenderbuffer(GL_READ_FRAMEBUFFER,
+                              GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER,
+                              frame.renderbuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowSize.x, windowSize.y);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Scaled to fit, centered between black bars
+    const glm::vec2 frameSize{frame.size};
+    const glm::vec2 scales = glm::vec2{windowSize} / frameSize;
+    const float scale = std::min(scales.x, scales.y);
+    const glm::ivec2 scaledSize{frameSize * scale};
+    const glm::ivec2 offset = (windowSize - scaledSize) / 2;
+    glBlitFramebuffer(0,
+                      0,
+                      frame.size.x,
+                      frame.size.y,
+                      offset.x,
+                      offset.y,
+                      offset.x + scaledSize.x,
+                      offset.y + scaledSize.y,
+                      GL_COLOR_BUFFER_BIT,
+                      GL_LINEAR);
+}
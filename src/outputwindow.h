@@ -0,0 +1,114 @@
+#ifndef OUTPUT_WINDOW_H_
+#define OUTPUT_WINDOW_H_
+
+#include "triplebuffer.h"
+
+#include "glad/gl.h"
+#include "glm/vec2.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+struct GLFWwindow;
+
+/// Second window showing the scene of the main window without UI, like on a
+/// projector or a second monitor.
+///
+/// Window has a graphics context shared with the main window, and frames are
+/// presented into it by a thread of its own. Scene is drawn once by the main
+/// context and copied into renderbuffers shared between the contexts, handed
+/// over through a triple buffer with a fence for the copy. Models, textures
+/// and shaders live in the main context only, as vertex arrays and
+/// framebuffers of another context could not draw them without being created
+/// again. Presenting thread waits for vertical synchronization of its own
+/// display, so that a slower display never holds back the main window.
+/// Frames published faster than displayed are dropped.
+///
+/// Non-copyable, non-movable. Desktop only.
+class OutputWindow
+{
+public:
+    OutputWindow();
+    OutputWindow(const OutputWindow&) = delete;
+    OutputWindow& operator=(const OutputWindow&) = delete;
+    OutputWindow(OutputWindow&&) = delete;
+    OutputWindow& operator=(OutputWindow&&) = delete;
+    ~OutputWindow();
+
+    /// Open window sharing the graphics context of given window, fullscreen
+    /// on the second monitor when one is connected. Returns false when it
+    /// can not be created. Called on the main thread with the context of the
+    /// shared window current.
+    bool start(GLFWwindow* sharedWindow);
+    /// Close window and release renderbuffers, after which it may be opened
+    /// again. Called on the main thread with the context of the shared window
+    /// current.
+    void stop();
+
+    [[nodiscard]] bool isOpen() const { return window_ != nullptr; }
+    /// Window was asked to be closed by the user since it was opened.
+    [[nodiscard]] bool isCloseRequested() const;
+
+    /// Copy default framebuffer of given size into the next frame and hand
+    /// it over for presenting. Called on the main thread after the scene was
+    /// drawn into the default framebuffer, leaving it bound.
+    void publishFrame(int frameBufferWidth, int frameBufferHeight);
+
+private:
+    /// Frame handed over to the presenting thread.
+    struct Frame
+    {
+        /// Index of renderbuffer holding the frame, NO_TARGET when none was
+        /// assigned to the slot yet. Each slot keeps its renderbuffer.
+        std::uint32_t target;
+        GLuint renderbuffer;
+        glm::ivec2 size;
+        /// Signaled once the frame is copied into its renderbuffer.
+        GLsync copied;
+    };
+
+    static constexpr std::uint32_t NO_TARGET = UINT32_MAX;
+    static constexpr std::uint32_t TARGET_COUNT = 3;
+
+    static void frameBufferSizeCallback(GLFWwindow* window,
+                                        int width,
+                                        int height);
+
+    /// Presenting thread, drawing the latest frame whenever one arrives or
+    /// the window is resized.
+    void run();
+    /// Blit frame scaled into the window keeping its aspect ratio.
+    void present(const Frame& frame,
+                 GLuint readFramebuffer,
+                 glm::ivec2 windowSize);
+
+    GLFWwindow* window_;
+    /// Created anew on start, as slots refer to renderbuffers released by
+    /// stop().
+    std::optional<TripleBuffer<Frame>> frames_;
+    /// Renderbuffers shared with the presenting context, and framebuffers of
+    /// the main context copying into them. Framebuffers are not shared.
+    std::array<GLuint, TARGET_COUNT> renderbuffers_;
+    std::array<GLuint, TARGET_COUNT> framebuffers_;
+    std::array<glm::ivec2, TARGET_COUNT> targetSizes_;
+    /// Latest fence of each renderbuffer, deleted when it is copied into
+    /// again.
+    std::array<GLsync, TARGET_COUNT> fences_;
+    std::uint32_t targetCount_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    /// Guarded by the mutex.
+    bool stopping_;
+    /// Set when a frame was published or the window resized since the last
+    /// one was presented.
+    bool presentRequested_;
+    glm::ivec2 windowSize_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "pixelreadback.h"
+
+#include "videomemory.h"
+
+#include <cstring>
+
+namespace
+{
+constexpr size_t RGBA_CHANNEL_COUNT = 4;
+}  // namespace
+
+PixelReadback::PixelReadback(size_t bufferCount)
+    : buffers_(bufferCount,
+               Buffer{
+                   .buffer = 0,
+                   .capacity = 0,
+                   .fence = nullptr,
+                   .id = 0,
+                   .width = 0,
+                   .height = 0,
+               })
+{
+    for (size_t i = bufferCount; i-- > 0;)
+    {
+        freeBuffers_.push_back(i);
+    }
+}
+
+PixelReadback::~PixelReadback()
+{
+    for (const Buffer& buffer : buffers_)
+    {
+        if (buffer.fence)
+        {
+            glDeleteSync(buffer.fence);
+        }
+        if (buffer.buffer)
+        {
+            glDeleteBuffers(1, &buffer.buffer);
+            videomemory::release(videomemory::Category::Upload,
+                                 buffer.capacity);
+        }
+    }
+}
+
+void PixelReadback::readPixels(size_t id, int width, int height)
+{
+    const size_t index = freeBuffers_.back();
+    freeBuffers_.pop_back();
+    Buffer& buffer = buffers_[index];
+    const size_t size = static_cast<size_t>(width)
+                      * static_cast<size_t>(height) * RGBA_CHANNEL_COUNT;
+    if (!buffer.buffer)
+    {
+        glGenBuffers(1, &buffer.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer);
+    if (buffer.capacity < size)
+    {
+        // Free buffers are not read by the GPU anymore, so storage is
+        // replaced without waiting
+        glBufferData(GL_PIXEL_PACK_BUFFER,
+                     static_cast<GLsizeiptr>(size),
+                     nullptr,
+                     GL_STREAM_READ);
+        videomemory::release(videomemory::Category::Upload, buffer.capacity);
+        videomemory::allocate(videomemory::Category::Upload, size);
+        buffer.capacity = size;
+    }
+
+    // Rows of four bytes per pixel are tightly packed at the default pack
+    // alignment
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer.id = id;
+    buffer.width = width;
+    buffer.height = height;
+    pendingBuffers_.push_back(index);
+}
+
+std::optional<PixelReadback::Pixels> PixelReadback::takeFinished()
+{
+    if (pendingBuffers_.empty())
+    {
+        return std::nullopt;
+    }
+    // Flushing makes sure the copy gets submitted, otherwise polling could
+    // wait for it forever
+    const GLsync fence = buffers_[pendingBuffers_.front()].fence;
+    const GLenum status
+        = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        return std::nullopt;
+    }
+    return takePixels();
+}
+
+PixelReadback::Pixels PixelReadback::takeOldest()
+{
+    glClientWaitSync(buffers_[pendingBuffers_.front()].fence,
+                     GL_SYNC_FLUSH_COMMANDS_BIT,
+                     UINT64_MAX);
+    return takePixels();
+}
+
+PixelReadback::Pixels PixelReadback::takePixels()
+{
+    const size_t index = pendingBuffers_.front();
+    pendingBuffers_.pop_front();
+    freeBuffers_.push_back(index);
+    Buffer& buffer = buffers_[index];
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    Pixels pixels{
+        .id = buffer.id,
+        .width = buffer.width,
+        .height = buffer.height,
+        .data = {},
+    };
+    const size_t size = static_cast<size_t>(buffer.width)
+                      * static_cast<size_t>(buffer.height)
+                      * RGBA_CHANNEL_COUNT;
+    // Pixels are copied out, so that the buffer is free for the next copy
+    // while they are processed
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer);
+    if (const void* mappedPixels
+        = glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                           0,
+                           static_cast<GLsizeiptr>(size),
+                           GL_MAP_READ_BIT))
+    {
+        pixels.data.resize(size);
+        std::memcpy(pixels.data.data(), mappedPixels, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return pixels;
+}
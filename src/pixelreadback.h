@@ -0,0 +1,82 @@
+#ifndef PIXEL_READBACK_H_
+#define PIXEL_READBACK_H_
+
+#include "glad/gl.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+/// Asynchronous copies of framebuffer pixels into system memory, for saving
+/// rendered images without stalling the pipeline.
+///
+/// Pixels are read into a ring of pixel pack buffers, which returns right
+/// away while the copy is queued behind the draws. Each copy is fenced and
+/// only mapped once the GPU signalled it, usually a frame or two later, so
+/// that taking the pixels does not wait for the GPU either.
+///
+/// Buffers are created on first use and grown to fit larger framebuffers.
+/// Non-copyable, non-movable, pending copies refer to the buffers.
+class PixelReadback
+{
+public:
+    /// Pixels copied out of a pixel pack buffer.
+    struct Pixels
+    {
+        /// Identifier passed to readPixels().
+        size_t id;
+        int width;
+        int height;
+        /// 8-bit RGBA pixels with tightly packed rows ordered from bottom to
+        /// top, as read from the framebuffer. Empty when the buffer could not
+        /// be mapped.
+        std::vector<std::uint8_t> data;
+    };
+
+    explicit PixelReadback(size_t bufferCount);
+    PixelReadback(const PixelReadback&) = delete;
+    PixelReadback& operator=(const PixelReadback&) = delete;
+    PixelReadback(PixelReadback&&) = delete;
+    PixelReadback& operator=(PixelReadback&&) = delete;
+    ~PixelReadback();
+
+    /// Every buffer holds a copy not taken yet.
+    [[nodiscard]] bool isFull() const { return freeBuffers_.empty(); }
+    [[nodiscard]] bool hasPending() const { return !pendingBuffers_.empty(); }
+
+    /// Queue copy of the bottom-left corner of the framebuffer bound for
+    /// reading into a free buffer. Identifier is passed back with the pixels
+    /// to associate them with the request. Must not be full.
+    void readPixels(size_t id, int width, int height);
+
+    /// Pixels of the oldest copy, if the GPU finished it.
+    std::optional<Pixels> takeFinished();
+    /// Pixels of the oldest copy, waiting for the GPU to finish it. Must have
+    /// pending copies.
+    Pixels takeOldest();
+
+private:
+    struct Buffer
+    {
+        GLuint buffer;
+        /// Bytes of storage, grown to fit larger copies.
+        size_t capacity;
+        /// Signalled when the copy finished, null when the buffer is free.
+        GLsync fence;
+        size_t id;
+        int width;
+        int height;
+    };
+
+    /// Map oldest pending buffer and copy its pixels out, freeing it.
+    Pixels takePixels();
+
+    std::vector<Buffer> buffers_;
+    /// Indices of buffers holding copies, oldest first.
+    std::deque<size_t> pendingBuffers_;
+    std::vector<size_t> freeBuffers_;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "pixeluploadbuffer.h"
+
+#include "videomemory.h"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+namespace
+{
+/// Fits a 2048x2048 RGB image with its mip chain.
+constexpr GLsizeiptr CAPACITY = 32 * 1024 * 1024;
+}  // namespace
+
+PixelUploadBuffer::PixelUploadBuffer()
+    : buffer_{0}
+    , mappedData_{nullptr}
+    , head_{0}
+{
+}
+
+PixelUploadBuffer::~PixelUploadBuffer()
+{
+    for (const PendingRange& range : pendingRanges_)
+    {
+        glDeleteSync(range.fence);
+    }
+    if (mappedData_)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    if (buffer_)
+    {
+        glDeleteBuffers(1, &buffer_);
+        videomemory::release(videomemory::Category::Upload,
+                             static_cast<size_t>(CAPACITY));
+    }
+}
+
+std::optional<GLintptr> PixelUploadBuffer::stage(
+    std::span<const std::byte> data)
+{
+    const auto size = static_cast<GLsizeiptr>(data.size());
+    if (data.empty() || size > CAPACITY)
+    {
+        return std::nullopt;
+    }
+    if (!buffer_)
+    {
+        createBuffer();
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+    if (!mappedData_)
+    {
+        // Orphaning hands previous storage over to the driver until pending
+        // transfers finish, instead of waiting for them
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, CAPACITY, nullptr, GL_STREAM_DRAW);
+        void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                        0,
+                                        size,
+                                        GL_MAP_WRITE_BIT
+                                            | GL_MAP_INVALIDATE_BUFFER_BIT);
+        std::memcpy(target, data.data(), data.size());
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return 0;
+    }
+
+    if (head_ + size > CAPACITY)
+    {
+        head_ = 0;
+    }
+    // Ranges are written in ring order, so the oldest pending range is the
+    // first one the new range can overlap
+    while (!pendingRanges_.empty())
+    {
+        const PendingRange& oldest = pendingRanges_.front();
+        if (oldest.offset >= head_ + size
+            || oldest.offset + oldest.size <= head_)
+        {
+            break;
+        }
+        glClientWaitSync(oldest.fence,
+                         GL_SYNC_FLUSH_COMMANDS_BIT,
+                         UINT64_MAX);
+        glDeleteSync(oldest.fence);
+        pendingRanges_.pop_front();
+    }
+    std::memcpy(mappedData_ + head_, data.data(), data.size());
+    return head_;
+}
+
+void PixelUploadBuffer::finishStaging(GLintptr offset, size_t size)
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!mappedData_)
+    {
+        return;
+    }
+
+    pendingRanges_.push_back(PendingRange{
+        .offset = offset,
+        .size = static_cast<GLsizeiptr>(size),
+        .fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+    });
+    head_ = offset + static_cast<GLintptr>(size);
+}
+
+void PixelUploadBuffer::createBuffer()
+{
+    glGenBuffers(1, &buffer_);
+    // Storage is allocated here or on first upload, at the same capacity
+    videomemory::allocate(videomemory::Category::Upload,
+                          static_cast<size_t>(CAPACITY));
+    if (!GLAD_GL_ARB_buffer_storage)
+    {
+        return;
+    }
+
+    // Coherent mapping makes writes visible to the GPU without explicit
+    // flushes, ordering is ensured by fences instead
+    constexpr GLbitfield mapFlags
+        = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, CAPACITY, nullptr, mapFlags);
+    mappedData_ = static_cast<std::byte*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, CAPACITY, mapFlags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+const void* PixelUploadBuffer::bufferOffset(GLintptr offset)
+{
+    return reinterpret_cast<const void*>(static_cast<std::uintptr_t>(offset));
+}
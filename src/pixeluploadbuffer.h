@@ -0,0 +1,79 @@
+#ifndef PIXEL_UPLOAD_BUFFER_H_
+#define PIXEL_UPLOAD_BUFFER_H_
+
+#include "glad/gl.h"
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <span>
+
+/// Staging memory for texture uploads, bound as pixel unpack buffer so that
+/// texture image calls return right after pixels are copied into driver
+/// memory, and transfer happens asynchronously.
+///
+/// With ARB_buffer_storage (core in OpenGL 4.4), pixels are written into a
+/// persistently mapped ring buffer, fenced until the GPU consumed them.
+/// Otherwise buffer storage is orphaned and mapped again for every upload.
+/// Pixels larger than the whole buffer are uploaded from client memory.
+///
+/// Buffer is created on first upload. Non-copyable, non-movable, pending
+/// uploads refer to the buffer. Mapping buffers is not available in WebGL 2.
+class PixelUploadBuffer
+{
+public:
+    PixelUploadBuffer();
+    PixelUploadBuffer(const PixelUploadBuffer&) = delete;
+    PixelUploadBuffer& operator=(const PixelUploadBuffer&) = delete;
+    PixelUploadBuffer(PixelUploadBuffer&&) = delete;
+    PixelUploadBuffer& operator=(PixelUploadBuffer&&) = delete;
+    ~PixelUploadBuffer();
+
+    /// Stage data for the texture image call made by imageCall, which
+    /// receives the pointer to pass in place of client memory. The pointer is
+    /// an offset into the bound staging buffer, or data itself when it does
+    /// not fit and is uploaded from client memory.
+    template <typename ImageCall>
+    void upload(std::span<const std::byte> data, ImageCall&& imageCall);
+
+private:
+    /// Range of ring buffer the GPU may still be reading from.
+    struct PendingRange
+    {
+        GLintptr offset;
+        GLsizeiptr size;
+        GLsync fence;
+    };
+
+    /// Copy data into staging memory and bind the buffer for unpacking.
+    /// Returns offset of data in the buffer, or nothing when data does not
+    /// fit and has to be uploaded from client memory.
+    [[nodiscard]] std::optional<GLintptr> stage(
+        std::span<const std::byte> data);
+    /// Unbind the buffer after texture image call and fence the staged range.
+    void finishStaging(GLintptr offset, size_t size);
+    void createBuffer();
+    /// Pixel unpack buffer offsets are passed to texture image calls in place
+    /// of client memory pointers.
+    [[nodiscard]] static const void* bufferOffset(GLintptr offset);
+
+    GLuint buffer_;
+    /// Persistently mapped storage, null when orphaning instead.
+    std::byte* mappedData_;
+    GLintptr head_;
+    std::deque<PendingRange> pendingRanges_;
+};
+
+template <typename ImageCall>
+void PixelUploadBuffer::upload(std::span<const std::byte> data,
+                               ImageCall&& imageCall)
+{
+    const std::optional<GLintptr> offset = stage(data);
+    imageCall(offset ? bufferOffset(offset.value()) : data.data());
+    if (offset)
+    {
+        finishStaging(offset.value(), data.size());
+    }
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "pngwriter.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+constexpr std::array<std::uint8_t, 8> SIGNATURE{
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+/// Largest payload of a deflate block stored without compression.
+constexpr size_t MAX_STORED_BLOCK_SIZE = 0xFFFF;
+constexpr std::uint8_t COLOR_TYPE_RGB = 2;
+constexpr size_t RGB_CHANNEL_COUNT = 3;
+constexpr size_t RGBA_CHANNEL_COUNT = 4;
+
+constexpr std::array<std::uint32_t, 256> createCrcTable()
+{
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < table.size(); ++i)
+    {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1U) ? 0xEDB88320U ^ (crc >> 1U) : crc >> 1U;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<std::uint32_t, 256> CRC_TABLE = createCrcTable();
+
+std::uint32_t updateCrc(std::uint32_t crc, std::span<const std::uint8_t> data)
+{
+    for (const std::uint8_t byte : data)
+    {
+        crc = CRC_TABLE[(crc ^ byte) & 0xFFU] ^ (crc >> 8U);
+    }
+    return crc;
+}
+
+void appendBigEndian(std::vector<std::uint8_t>& output, std::uint32_t value)
+{
+    output.push_back(static_cast<std::uint8_t>(value >> 24U));
+    output.push_back(static_cast<std::uint8_t>(value >> 16U));
+    output.push_back(static_cast<std::uint8_t>(value >> 8U));
+    output.push_back(static_cast<std::uint8_t>(value));
+}
+
+/// Append chunk of given type. Length and checksum enclose the data.
+void appendChunk(std::vector<std::uint8_t>& output,
+                 std::string_view type,
+                 std::span<const std::uint8_t> data)
+{
+    appendBigEndian(output, static_cast<std::uint32_t>(data.size()));
+    const size_t typeOffset = output.size();
+    output.insert(output.end(), type.begin(), type.end());
+    output.insert(output.end(), data.begin(), data.end());
+    // Checksum covers chunk type and data, but not length
+    const std::uint32_t crc
+        = updateCrc(0xFFFFFFFFU, std::span{output}.subspan(typeOffset));
+    appendBigEndian(output, crc ^ 0xFFFFFFFFU);
+}
+
+/// Wrap filtered scanlines into a zlib stream of stored deflate blocks.
+std::vector<std::uint8_t> createStoredZlibStream(
+    std::span<const std::uint8_t> data)
+{
+    std::vector<std::uint8_t> stream;
+    const size_t blockCount
+        = std::max<size_t>((data.size() + MAX_STORED_BLOCK_SIZE - 1)
+                               / MAX_STORED_BLOCK_SIZE,
+                           1);
+    stream.reserve(data.size() + blockCount * 5 + 6);
+    // Deflate with 32 KiB window and no preset dictionary, header check bits
+    // making the pair a multiple of 31
+    stream.push_back(0x78);
+    stream.push_back(0x01);
+    std::uint32_t adlerA = 1;
+    std::uint32_t adlerB = 0;
+    for (size_t block = 0; block < blockCount; ++block)
+    {
+        const size_t begin = block * MAX_STORED_BLOCK_SIZE;
+        const size_t size
+            = std::min(MAX_STORED_BLOCK_SIZE, data.size() - begin);
+        const auto length = static_cast<std::uint16_t>(size);
+        const auto inverseLength = static_cast<std::uint16_t>(~length);
+        stream.push_back(block + 1 == blockCount ? 1 : 0);
+        stream.push_back(static_cast<std::uint8_t>(length));
+        stream.push_back(static_cast<std::uint8_t>(length >> 8U));
+        stream.push_back(static_cast<std::uint8_t>(inverseLength));
+        stream.push_back(static_cast<std::uint8_t>(inverseLength >> 8U));
+        const std::span<const std::uint8_t> blockData
+            = data.subspan(begin, size);
+        stream.insert(stream.end(), blockData.begin(), blockData.end());
+        for (const std::uint8_t byte : blockData)
+        {
+            adlerA = (adlerA + byte) % 65521U;
+            adlerB = (adlerB + adlerA) % 65521U;
+        }
+    }
+    appendBigEndian(stream, (adlerB << 16U) | adlerA);
+    return stream;
+}
+
+/// Write PNG file of 8-bit RGB scanlines, each prefixed with its filter type.
+bool writeScanlines(const std::filesystem::path& filePath,
+                    std::uint32_t width,
+                    std::uint32_t height,
+                    std::span<const std::uint8_t> scanlines)
+{
+    std::vector<std::uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    // Bit depth, color type, then default compression, filtering and no
+    // interlacing
+    header.insert(header.end(), {8, COLOR_TYPE_RGB, 0, 0, 0});
+
+    std::vector<std::uint8_t> output(SIGNATURE.begin(), SIGNATURE.end());
+    appendChunk(output, "IHDR", header);
+    appendChunk(output, "IDAT", createStoredZlibStream(scanlines));
+    appendChunk(output, "IEND", {});
+
+    std::ofstream file(filePath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(output.data()),
+               static_cast<std::streamsize>(output.size()));
+    return static_cast<bool>(file);
+}
+}  // namespace
+
+namespace pngwriter
+{
+bool writeFramebuffer(const std::filesystem::path& filePath,
+                      std::uint32_t width,
+                      std::uint32_t height,
+                      std::span<const std::uint8_t> pixels)
+{
+    // Scanlines are flipped to top to bottom order while dropping alpha.
+    // Every scanline starts with its filter type, none of them filtered.
+    const size_t rowSize = static_cast<size_t>(width) * RGBA_CHANNEL_COUNT;
+    std::vector<std::uint8_t> scanlines;
+    scanlines.reserve((static_cast<size_t>(width) * RGB_CHANNEL_COUNT + 1)
+                      * height);
+    for (size_t y = height; y-- > 0;)
+    {
+        const std::uint8_t* row = pixels.data() + y * rowSize;
+        scanlines.push_back(0);
+        for (size_t x = 0; x < rowSize; x += RGBA_CHANNEL_COUNT)
+        {
+            scanlines.insert(scanlines.end(),
+                             row + x,
+                             row + x + RGB_CHANNEL_COUNT);
+        }
+    }
+    return writeScanlines(filePath, width, height, scanlines);
+}
+}  // namespace pngwriter
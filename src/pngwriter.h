@@ -0,0 +1,27 @@
+#ifndef PNG_WRITER_H_
+#define PNG_WRITER_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+/// Minimal PNG encoder for images produced by the renderer, like thumbnails.
+///
+/// Pixels are stored in deflate blocks without compression, so that encoding
+/// costs little more than copying and checksumming, and no compression
+/// library is needed. Files are larger than those of image editors, but
+/// readable by any PNG decoder. Thread-safe, meant to be called from thread
+/// pool tasks.
+namespace pngwriter
+{
+/// Write 8-bit RGBA image as read back from a framebuffer, with tightly
+/// packed rows ordered from bottom to top. Alpha is left out, as
+/// framebuffers are shown opaque. Returns false when the file can not be
+/// written.
+bool writeFramebuffer(const std::filesystem::path& filePath,
+                      std::uint32_t width,
+                      std::uint32_t height,
+                      std::span<const std::uint8_t> pixels);
+}  // namespace pngwriter
+
+#endif
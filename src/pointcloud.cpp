@@ -0,0 +1,686 @@
+#include "pointcloud.h"
+
+#include "mappedfile.h"
+#include "profiler.h"
+#include "utils.h"
+#include "videomemory.h"
+
+#include "glm/common.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/vec3.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Largest quantized coordinate along each axis.
+constexpr double QUANTIZATION_MAX = 65535.0;
+/// Fixed seed, so that the same file is shuffled the same way on every
+/// import.
+constexpr std::mt19937::result_type SHUFFLE_SEED = 5489U;
+/// PLY headers are a few hundred bytes, anything longer is not a PLY file.
+constexpr size_t MAX_PLY_HEADER_SIZE = 64 * 1024;
+/// Size of the LAS 1.0 header, which every later version extends.
+constexpr size_t LAS_HEADER_SIZE = 227;
+/// LAS 1.4 header, holding a 64-bit point count.
+constexpr size_t LAS_1_4_HEADER_SIZE = 375;
+
+enum class ScalarType : std::uint8_t
+{
+    Int8,
+    Uint8,
+    Int16,
+    Uint16,
+    Int32,
+    Uint32,
+    Float32,
+    Float64,
+};
+
+/// Properties a point is read from.
+enum Property : std::uint8_t
+{
+    X,
+    Y,
+    Z,
+    Red,
+    Green,
+    Blue,
+    PROPERTY_COUNT,
+};
+
+/// Property of a point record, at byte offset in binary records, or in
+/// column of ASCII records.
+struct Attribute
+{
+    ScalarType type;
+    size_t offset;
+};
+
+/// Where and how points are stored in a point cloud file.
+struct PointLayout
+{
+    size_t count;
+    /// Byte offset of the first record.
+    size_t dataOffset;
+    /// Bytes from one binary record to the next.
+    size_t stride;
+    bool ascii;
+    bool bigEndian;
+    /// Color properties are missing from files without colors.
+    std::array<std::optional<Attribute>, PROPERTY_COUNT> attributes;
+    /// Integer coordinates of LAS files are scaled and offset into meters.
+    glm::dvec3 scale;
+    glm::dvec3 offset;
+    bool zUp;
+};
+
+size_t scalarSize(ScalarType type)
+{
+    switch (type)
+    {
+    case ScalarType::Int8:
+    case ScalarType::Uint8:
+        return 1;
+    case ScalarType::Int16:
+    case ScalarType::Uint16:
+        return 2;
+    case ScalarType::Int32:
+    case ScalarType::Uint32:
+    case ScalarType::Float32:
+        return 4;
+    case ScalarType::Float64:
+        return 8;
+    }
+    return 0;
+}
+
+bool isFloatingPoint(ScalarType type)
+{
+    return type == ScalarType::Float32 || type == ScalarType::Float64;
+}
+
+template <typename T>
+double readAs(const std::byte* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return static_cast<double>(value);
+}
+
+double readScalar(const std::byte* data, ScalarType type, bool bigEndian)
+{
+    std::array<std::byte, sizeof(double)> bytes{};
+    const size_t size = scalarSize(type);
+    std::copy_n(data, size, bytes.begin());
+    if (bigEndian)
+    {
+        std::reverse(bytes.begin(), bytes.begin() + size);
+    }
+    switch (type)
+    {
+    case ScalarType::Int8:
+        return readAs<std::int8_t>(bytes.data());
+    case ScalarType::Uint8:
+        return readAs<std::uint8_t>(bytes.data());
+    case ScalarType::Int16:
+        return readAs<std::int16_t>(bytes.data());
+    case ScalarType::Uint16:
+        return readAs<std::uint16_t>(bytes.data());
+    case ScalarType::Int32:
+        return readAs<std::int32_t>(bytes.data());
+    case ScalarType::Uint32:
+        return readAs<std::uint32_t>(bytes.data());
+    case ScalarType::Float32:
+        return readAs<float>(bytes.data());
+    case ScalarType::Float64:
+        return readAs<double>(bytes.data());
+    }
+    return 0.0;
+}
+
+std::optional<ScalarType> parsePlyType(std::string_view name)
+{
+    // Both the original type names and the sized ones are in use
+    constexpr std::array<std::pair<std::string_view, ScalarType>, 16> types{{
+        {"char", ScalarType::Int8},
+        {"int8", ScalarType::Int8},
+        {"uchar", ScalarType::Uint8},
+        {"uint8", ScalarType::Uint8},
+        {"short", ScalarType::Int16},
+        {"int16", ScalarType::Int16},
+        {"ushort", ScalarType::Uint16},
+        {"uint16", ScalarType::Uint16},
+        {"int", ScalarType::Int32},
+        {"int32", ScalarType::Int32},
+        {"uint", ScalarType::Uint32},
+        {"uint32", ScalarType::Uint32},
+        {"float", ScalarType::Float32},
+        {"float32", ScalarType::Float32},
+        {"double", ScalarType::Float64},
+        {"float64", ScalarType::Float64},
+    }};
+    for (const auto& [typeName, type] : types)
+    {
+        if (typeName == name)
+        {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<Property> parsePlyProperty(std::string_view name)
+{
+    constexpr std::array<std::pair<std::string_view, Property>, 9> properties{{
+        {"x", X},
+        {"y", Y},
+        {"z", Z},
+        {"red", Red},
+        {"green", Green},
+        {"blue", Blue},
+        {"diffuse_red", Red},
+        {"diffuse_green", Green},
+        {"diffuse_blue", Blue},
+    }};
+    for (const auto& [propertyName, property] : properties)
+    {
+        if (propertyName == name)
+        {
+            return property;
+        }
+    }
+    return std::nullopt;
+}
+
+/// Split line into words separated by spaces.
+std::vector<std::string_view> splitWords(std::string_view line)
+{
+    std::vector<std::string_view> words;
+    while (!line.empty())
+    {
+        const size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string_view::npos)
+        {
+            break;
+        }
+        line.remove_prefix(start);
+        const size_t end = std::min(line.find_first_of(" \t\r"), line.size());
+        words.push_back(line.substr(0, end));
+        line.remove_prefix(end);
+    }
+    return words;
+}
+
+/// Read header of PLY file. Points are read from the vertex element, which
+/// has to be the first element, as records of elements before it may have
+/// variable size.
+std::optional<PointLayout> parsePlyHeader(std::span<const std::byte> file,
+                                          const fs::path& filePath)
+{
+    const std::string_view text{
+        reinterpret_cast<const char*>(file.data()),
+        std::min(file.size(), MAX_PLY_HEADER_SIZE)};
+    const size_t headerEnd = text.find("end_header");
+    const size_t dataOffset = text.find('\n', headerEnd);
+    if (headerEnd == std::string_view::npos
+        || dataOffset == std::string_view::npos)
+    {
+        utils::showErrorMessage("PLY header is incomplete in ", filePath);
+        return std::nullopt;
+    }
+
+    PointLayout layout{.count = 0,
+                       .dataOffset = dataOffset + 1,
+                       .stride = 0,
+                       .ascii = false,
+                       .bigEndian = false,
+                       .attributes = {},
+                       .scale = glm::dvec3{1.0},
+                       .offset = glm::dvec3{0.0},
+                       .zUp = false};
+    bool formatFound = false;
+    bool inVertexElement = false;
+    bool vertexElementFound = false;
+    size_t column = 0;
+    std::string_view lines = text.substr(0, headerEnd);
+    while (!lines.empty())
+    {
+        const size_t lineEnd = std::min(lines.find('\n'), lines.size());
+        const std::vector<std::string_view> words
+            = splitWords(lines.substr(0, lineEnd));
+        lines.remove_prefix(std::min(lineEnd + 1, lines.size()));
+        if (words.empty())
+        {
+            continue;
+        }
+        if (words[0] == "format" && words.size() >= 2)
+        {
+            formatFound = true;
+            layout.ascii = words[1] == "ascii";
+            layout.bigEndian = words[1] == "binary_big_endian";
+        }
+        else if (words[0] == "element" && words.size() >= 3)
+        {
+            if (vertexElementFound)
+            {
+                // Elements after vertices, like faces, are not read
+                inVertexElement = false;
+                continue;
+            }
+            if (words[1] != "vertex")
+            {
+                utils::showErrorMessage(
+                    "PLY vertex element must come first in ",
+                    filePath);
+                return std::nullopt;
+            }
+            inVertexElement = true;
+            vertexElementFound = true;
+            layout.count = std::strtoull(std::string{words[2]}.c_str(),
+                                         nullptr,
+                                         10);
+        }
+        else if (words[0] == "property" && inVertexElement)
+        {
+            if (words.size() < 3 || words[1] == "list")
+            {
+                utils::showErrorMessage(
+                    "PLY vertices with list properties are not supported in ",
+                    filePath);
+                return std::nullopt;
+            }
+            const std::optional<ScalarType> type = parsePlyType(words[1]);
+            if (!type)
+            {
+                utils::showErrorMessage("unknown PLY property type ",
+                                        words[1],
+                                        " in ",
+                                        filePath);
+                return std::nullopt;
+            }
+            if (const std::optional<Property> property
+                = parsePlyProperty(words[2]))
+            {
+                layout.attributes[*property] = Attribute{
+                    .type = type.value(),
+                    .offset = layout.ascii ? column : layout.stride,
+                };
+            }
+            layout.stride += scalarSize(type.value());
+            ++column;
+        }
+    }
+    if (!formatFound || !layout.attributes[X] || !layout.attributes[Y]
+        || !layout.attributes[Z])
+    {
+        utils::showErrorMessage("PLY file has no vertex positions: ",
+                                filePath);
+        return std::nullopt;
+    }
+    return layout;
+}
+
+/// Read header of LAS file. Coordinates are stored as scaled integers at
+/// the start of every point record, colors at an offset depending on point
+/// data record format.
+std::optional<PointLayout> parseLasHeader(std::span<const std::byte> file,
+                                          const fs::path& filePath)
+{
+    if (file.size() < LAS_HEADER_SIZE)
+    {
+        utils::showErrorMessage("LAS header is incomplete in ", filePath);
+        return std::nullopt;
+    }
+    const auto readUint = [&](size_t offset, ScalarType type)
+    { return static_cast<size_t>(readScalar(&file[offset], type, false)); };
+    const auto readDouble = [&](size_t offset)
+    { return readScalar(&file[offset], ScalarType::Float64, false); };
+
+    const size_t versionMinor = readUint(25, ScalarType::Uint8);
+    const size_t headerSize = readUint(94, ScalarType::Uint16);
+    const size_t format = readUint(104, ScalarType::Uint8);
+    // Compressed LAZ files set the highest bits of the format
+    if (format > 10)
+    {
+        utils::showErrorMessage(
+            "only uncompressed LAS point formats 0 to 10 are supported in ",
+            filePath);
+        return std::nullopt;
+    }
+    PointLayout layout{
+        .count = readUint(107, ScalarType::Uint32),
+        .dataOffset = readUint(96, ScalarType::Uint32),
+        .stride = readUint(105, ScalarType::Uint16),
+        .ascii = false,
+        .bigEndian = false,
+        .attributes = {},
+        .scale = glm::dvec3{readDouble(131), readDouble(139), readDouble(147)},
+        .offset
+        = glm::dvec3{readDouble(155), readDouble(163), readDouble(171)},
+        .zUp = true,
+    };
+    // Point count of LAS 1.4 is 64-bit, with the legacy count left zero for
+    // files too large for it
+    if (versionMinor >= 4 && headerSize >= LAS_1_4_HEADER_SIZE
+        && file.size() >= LAS_1_4_HEADER_SIZE)
+    {
+        std::uint64_t count = 0;
+        std::memcpy(&count, &file[247], sizeof(count));
+        layout.count = static_cast<size_t>(count);
+    }
+    for (const Property property : {X, Y, Z})
+    {
+        layout.attributes[property]
+            = Attribute{.type = ScalarType::Int32,
+                        .offset = static_cast<size_t>(property) * 4};
+    }
+    // Formats 2, 3 and 5 store colors after GPS time of 3 and 5, formats 7,
+    // 8 and 10 after the extended fields of LAS 1.4
+    constexpr std::array<size_t, 11> colorOffsets{0, 0, 20, 28, 0, 28,
+                                                  0, 30, 30, 0, 30};
+    const size_t colorOffset = colorOffsets[format];
+    if (layout.stride < std::max<size_t>(colorOffset + 6, 12))
+    {
+        utils::showErrorMessage("LAS point records are too short in ",
+                                filePath);
+        return std::nullopt;
+    }
+    if (colorOffset > 0)
+    {
+        for (const Property property : {Red, Green, Blue})
+        {
+            layout.attributes[property] = Attribute{
+                .type = ScalarType::Uint16,
+                .offset = colorOffset + (property - Red) * 2,
+            };
+        }
+    }
+    return layout;
+}
+
+/// Call function with position and color of every point, color being zero
+/// when missing. Returns false when records run past the end of file.
+template <typename F>
+bool forEachPoint(std::span<const std::byte> file,
+                  const PointLayout& layout,
+                  F&& function)
+{
+    const auto toPosition = [&](const glm::dvec3& raw)
+    {
+        const glm::dvec3 position = raw * layout.scale + layout.offset;
+        return layout.zUp ? glm::dvec3{position.x, position.z, -position.y}
+                          : position;
+    };
+
+    if (!layout.ascii)
+    {
+        if (layout.stride == 0 || layout.dataOffset > file.size()
+            || (file.size() - layout.dataOffset) / layout.stride
+                   < layout.count)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < layout.count; ++i)
+        {
+            const std::byte* record
+                = &file[layout.dataOffset + i * layout.stride];
+            std::array<double, PROPERTY_COUNT> values{};
+            for (size_t p = 0; p < PROPERTY_COUNT; ++p)
+            {
+                if (const std::optional<Attribute>& attribute
+                    = layout.attributes[p])
+                {
+                    values[p] = readScalar(record + attribute->offset,
+                                           attribute->type,
+                                           layout.bigEndian);
+                }
+            }
+            function(toPosition({values[X], values[Y], values[Z]}),
+                     glm::dvec3{values[Red], values[Green], values[Blue]});
+        }
+        return true;
+    }
+
+    // Words of ASCII records are copied out to be terminated for strtod(), as
+    // the mapped file is not
+    const std::string_view text{
+        reinterpret_cast<const char*>(file.data()) + layout.dataOffset,
+        file.size() - layout.dataOffset};
+    size_t position = 0;
+    std::array<char, 64> word{};
+    for (size_t i = 0; i < layout.count; ++i)
+    {
+        if (position >= text.size())
+        {
+            return false;
+        }
+        const size_t lineEnd
+            = std::min(text.find('\n', position), text.size());
+        const std::vector<std::string_view> words
+            = splitWords(text.substr(position, lineEnd - position));
+        position = lineEnd + 1;
+        std::array<double, PROPERTY_COUNT> values{};
+        for (size_t p = 0; p < PROPERTY_COUNT; ++p)
+        {
+            const std::optional<Attribute>& attribute = layout.attributes[p];
+            if (!attribute)
+            {
+                continue;
+            }
+            if (attribute->offset >= words.size())
+            {
+                return false;
+            }
+            const std::string_view value = words[attribute->offset];
+            const size_t length = std::min(value.size(), word.size() - 1);
+            std::copy_n(value.begin(), length, word.begin());
+            word[length] = '\0';
+            values[p] = std::strtod(word.data(), nullptr);
+        }
+        function(toPosition({values[X], values[Y], values[Z]}),
+                 glm::dvec3{values[Red], values[Green], values[Blue]});
+    }
+    return true;
+}
+
+/// Quantize position into [0, 65535] range of bounds.
+std::uint32_t quantize(double value, double minimum, double extent)
+{
+    if (extent <= 0.0)
+    {
+        return 0;
+    }
+    return static_cast<std::uint32_t>(std::clamp(
+        std::round((value - minimum) / extent * QUANTIZATION_MAX),
+        0.0,
+        QUANTIZATION_MAX));
+}
+
+/// Pack color of [0, 255] range into RGB565.
+std::uint32_t packColor(const glm::dvec3& color)
+{
+    const glm::dvec3 clamped = glm::clamp(color, 0.0, 255.0);
+    const auto red
+        = static_cast<std::uint32_t>(clamped.x * 31.0 / 255.0 + 0.5);
+    const auto green
+        = static_cast<std::uint32_t>(clamped.y * 63.0 / 255.0 + 0.5);
+    const auto blue
+        = static_cast<std::uint32_t>(clamped.z * 31.0 / 255.0 + 0.5);
+    return (red << 11U) | (green << 5U) | blue;
+}
+}  // namespace
+
+std::optional<PointCloudData> PointCloud::load(const fs::path& filePath)
+{
+    PROFILE_SCOPE("PointCloud::load");
+    const std::optional<MappedFile> file = MappedFile::open(filePath);
+    if (!file)
+    {
+        utils::showErrorMessage("unable to open point cloud file ", filePath);
+        return std::nullopt;
+    }
+    const std::span<const std::byte> bytes{file->data(), file->size()};
+    const bool las = bytes.size() >= 4
+                  && std::memcmp(bytes.data(), "LASF", 4) == 0;
+    const std::optional<PointLayout> layout
+        = las ? parseLasHeader(bytes, filePath)
+              : parsePlyHeader(bytes, filePath);
+    if (!layout)
+    {
+        return std::nullopt;
+    }
+    if (layout->count
+        > static_cast<size_t>(std::numeric_limits<GLsizei>::max()))
+    {
+        utils::showErrorMessage("too many points in ", filePath);
+        return std::nullopt;
+    }
+
+    // Bounds and color range are found by a first pass, so that points are
+    // quantized on the second one without keeping unquantized copies of them
+    glm::dvec3 minimum{std::numeric_limits<double>::max()};
+    glm::dvec3 maximum{std::numeric_limits<double>::lowest()};
+    double maxColor = 0.0;
+    const bool boundsRead = forEachPoint(
+        bytes,
+        layout.value(),
+        [&](const glm::dvec3& position, const glm::dvec3& color)
+        {
+            minimum = glm::min(minimum, position);
+            maximum = glm::max(maximum, position);
+            maxColor = std::max({maxColor, color.x, color.y, color.z});
+        });
+    if (!boundsRead || layout->count == 0)
+    {
+        utils::showErrorMessage("point cloud file is truncated or empty: ",
+                                filePath);
+        return std::nullopt;
+    }
+
+    // Colors of 16-bit channels and of floating point channels are brought
+    // into 8-bit range. Some LAS files store 8-bit values in 16-bit channels.
+    const std::optional<Attribute>& redAttribute = layout->attributes[Red];
+    double colorScale = 1.0;
+    if (!redAttribute)
+    {
+        maxColor = 255.0;
+    }
+    else if (isFloatingPoint(redAttribute->type) && maxColor <= 1.0)
+    {
+        colorScale = 255.0;
+    }
+    else if (maxColor > 255.0)
+    {
+        colorScale = 255.0 / 65535.0;
+    }
+    const glm::dvec3 extent = maximum - minimum;
+    PointCloudData data;
+    data.points.reserve(layout->count);
+    forEachPoint(bytes,
+                 layout.value(),
+                 [&](const glm::dvec3& position, const glm::dvec3& color)
+                 {
+                     const glm::dvec3 pointColor
+                         = redAttribute ? color * colorScale
+                                        : glm::dvec3{255.0};
+                     data.points.emplace_back(
+                         quantize(position.x, minimum.x, extent.x)
+                             | (quantize(position.y, minimum.y, extent.y)
+                                << 16U),
+                         quantize(position.z, minimum.z, extent.z)
+                             | (packColor(pointColor) << 16U));
+                 });
+    std::shuffle(data.points.begin(),
+                 data.points.end(),
+                 std::mt19937{SHUFFLE_SEED});
+    const glm::dvec3 center = (minimum + maximum) * 0.5;
+    data.bounds = Bounds{.minimum = glm::vec3{minimum - center},
+                         .maximum = glm::vec3{maximum - center}};
+    return data;
+}
+
+PointCloud PointCloud::create(const PointCloudData& data)
+{
+    PointCloud pointCloud;
+    pointCloud.pointCount = static_cast<GLsizei>(data.points.size());
+    pointCloud.bounds = data.bounds;
+    pointCloud.positionTransform = glm::scale(
+        glm::translate(glm::mat4{1.0F}, data.bounds.minimum),
+        (data.bounds.maximum - data.bounds.minimum)
+            / static_cast<float>(QUANTIZATION_MAX));
+    pointCloud.boundingSphere = BoundingSphere{
+        .center = (data.bounds.minimum + data.bounds.maximum) * 0.5F,
+        .radius = glm::length(data.bounds.maximum - data.bounds.minimum)
+                * 0.5F,
+    };
+    const auto size
+        = static_cast<GLsizeiptr>(data.points.size() * sizeof(glm::uvec2));
+    pointCloud.videoMemorySize_ = static_cast<size_t>(size);
+    videomemory::allocate(videomemory::Category::Geometry,
+                          pointCloud.videoMemorySize_);
+
+    glGenVertexArrays(1, &pointCloud.vertexArray);
+    glBindVertexArray(pointCloud.vertexArray);
+    glGenBuffers(1, &pointCloud.pointBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, pointCloud.pointBuffer);
+    glBufferData(GL_ARRAY_BUFFER, size, data.points.data(), GL_STATIC_DRAW);
+    // Points are decoded by shaders from integer words
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(glm::uvec2), nullptr);
+    glBindVertexArray(0);
+    return pointCloud;
+}
+
+PointCloud::PointCloud()
+    : pointBuffer{0}
+    , vertexArray{0}
+    , pointCount{0}
+    , positionTransform{1.0F}
+    , bounds{}
+    , boundingSphere{}
+    , videoMemorySize_{0}
+{
+}
+
+PointCloud::PointCloud(PointCloud&& other) noexcept
+    : pointBuffer{std::exchange(other.pointBuffer, 0)}
+    , vertexArray{std::exchange(other.vertexArray, 0)}
+    , pointCount{std::exchange(other.pointCount, 0)}
+    , positionTransform{other.positionTransform}
+    , bounds{other.bounds}
+    , boundingSphere{other.boundingSphere}
+    , videoMemorySize_{std::exchange(other.videoMemorySize_, 0)}
+{
+}
+
+PointCloud& PointCloud::operator=(PointCloud&& other) noexcept
+{
+    std::swap(pointBuffer, other.pointBuffer);
+    std::swap(vertexArray, other.vertexArray);
+    std::swap(pointCount, other.pointCount);
+    std::swap(positionTransform, other.positionTransform);
+    std::swap(bounds, other.bounds);
+    std::swap(boundingSphere, other.boundingSphere);
+    std::swap(videoMemorySize_, other.videoMemorySize_);
+    return *this;
+}
+
+PointCloud::~PointCloud()
+{
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &pointBuffer);
+    videomemory::release(videomemory::Category::Geometry, videoMemorySize_);
+}
@@ -0,0 +1,93 @@
+#ifndef POINT_CLOUD_H_
+#define POINT_CLOUD_H_
+
+#include "mesh.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+/// Points of a scan imported from a PLY or LAS file, quantized for upload.
+///
+/// Each point takes 8 bytes: positions quantized to 16 bits per axis relative
+/// to the bounding box, and color as RGB565. First word holds X in its low
+/// and Y in its high half, second word holds Z in its low and color in its
+/// high half.
+///
+/// Points are shuffled on import, so that any prefix of them is an even
+/// subsample of the whole cloud, and drawing fewer points is a matter of
+/// drawing a shorter prefix.
+struct PointCloudData
+{
+    std::vector<glm::uvec2> points;
+    /// Model space bounds of the points, centered on the origin, as
+    /// georeferenced scans lie far from it, where single precision floats
+    /// can not tell nearby points apart.
+    Bounds bounds;
+};
+
+/// Point cloud drawn as single pixel points, instead of being converted into
+/// triangles of a model.
+///
+/// Points reside in a single buffer in GPU memory, read as a shader storage
+/// buffer by the compute rasterizer of the renderer, or as vertices of point
+/// primitives where compute rasterization is not available.
+///
+/// Non-copyable, move-only.
+class PointCloud
+{
+public:
+    /// Import stage of point cloud creation, reading points of an ASCII or
+    /// binary PLY file, or of an uncompressed LAS file, and quantizing them.
+    /// Colors are taken from red, green and blue properties when present,
+    /// points are white otherwise. LAS files are Z-up, and are turned Y-up
+    /// like the rest of the scene.
+    ///
+    /// Does not issue graphics API calls, allowing to import on worker
+    /// threads. Returns nothing when the file can not be read, reporting the
+    /// error to the user.
+    static std::optional<PointCloudData> load(
+        const std::filesystem::path& filePath);
+
+    /// Factory method uploading imported points. Must be called on the thread
+    /// the graphics context is current on.
+    static PointCloud create(const PointCloudData& data);
+
+    PointCloud(const PointCloud&) = delete;
+    PointCloud& operator=(const PointCloud&) = delete;
+    PointCloud(PointCloud&& other) noexcept;
+    PointCloud& operator=(PointCloud&& other) noexcept;
+
+    ~PointCloud();
+
+    // (Exposed as public variables instead of getters due to performance
+    // concerns)
+    /// Point buffer, bound as shader storage buffer by compute rasterization.
+    GLuint pointBuffer;
+    /// Vertex array of point primitive draws, reading the point buffer as an
+    /// integer attribute.
+    GLuint vertexArray;
+    GLsizei pointCount;
+    /// Transformation from quantized positions to model space, meant to be
+    /// folded into the model matrix.
+    glm::mat4 positionTransform;
+    Bounds bounds;
+    BoundingSphere boundingSphere;
+
+private:
+    PointCloud();
+
+    /// Video memory taken by point buffer in bytes.
+    size_t videoMemorySize_;
+};
+
+#endif
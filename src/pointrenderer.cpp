@@ -0,0 +1,251 @@
+#include "pointrenderer.h"
+
+#include "pointcloud.h"
+#include "profiler.h"
+#include "videomemory.h"
+
+#include "glm/vec2.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+#ifndef __EMSCRIPTEN__
+/// Shader storage bindings of points and pixels, shared with the GPU culler,
+/// which binds its own buffers before every cull.
+constexpr GLuint POINT_BINDING = 1;
+constexpr GLuint PIXEL_BINDING = 2;
+/// Matches local size of the rasterization compute shader.
+constexpr GLuint RASTER_GROUP_SIZE = 256;
+/// Work groups along each dimension of a dispatch are guaranteed up to this
+/// count, so large point clouds are dispatched as a 2D grid of groups.
+constexpr GLuint MAX_GROUP_COUNT = 65535;
+/// Dispatched point ranges start at multiples of this many points, keeping
+/// their offsets aligned for shader storage ranges.
+constexpr GLsizei DISPATCH_ALIGNMENT = 64 * 1024;
+constexpr size_t PIXEL_SIZE = sizeof(std::uint64_t);
+#endif
+}  // namespace
+
+PointRenderer::PointRenderer()
+#ifndef __EMSCRIPTEN__
+    : pixelBuffer_{0}
+    , width_{0}
+    , height_{0}
+    , maxPointsPerDispatch_{0}
+#endif
+{
+}
+
+PointRenderer::~PointRenderer()
+{
+#ifndef __EMSCRIPTEN__
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    glDeleteBuffers(1, &pixelBuffer_);
+#endif
+}
+
+PointRenderer::PendingShaders PointRenderer::submitShaders()
+{
+#ifdef __EMSCRIPTEN__
+    return PendingShaders{
+        .pointShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/points_gles3.vert.glsl"},
+            fs::path{"assets/shaders/points_gles3.frag.glsl"}),
+    };
+#else
+    PendingShaders shaders{
+        .pointShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/points_gl4.vert.glsl"},
+            fs::path{"assets/shaders/points_gl4.frag.glsl"}),
+        .rasterShader = std::nullopt,
+        .resolveShader = std::nullopt,
+    };
+    // Shaders requiring the extensions would fail to compile without them
+    if (GLAD_GL_ARB_gpu_shader_int64 && GLAD_GL_NV_shader_atomic_int64)
+    {
+        shaders.rasterShader = Shader::submitComputeFromFile(
+            fs::path{"assets/shaders/points_raster_gl4.comp.glsl"});
+        shaders.resolveShader = Shader::submitFromFile(
+            fs::path{"assets/shaders/fullscreen_gl4.vert.glsl"},
+            fs::path{"assets/shaders/points_resolve_gl4.frag.glsl"});
+    }
+    return shaders;
+#endif
+}
+
+bool PointRenderer::init(PendingShaders&& shaders)
+{
+    pointShader_ = shaders.pointShader.finish();
+    if (!pointShader_)
+    {
+        return false;
+    }
+    pointModelViewProjectionUniform_
+        = pointShader_->getUniformHandle<glm::mat4>("u_modelViewProjection");
+#ifndef __EMSCRIPTEN__
+    if (!shaders.rasterShader || !shaders.resolveShader)
+    {
+        return true;
+    }
+    rasterShader_ = shaders.rasterShader->finish();
+    resolveShader_ = shaders.resolveShader->finish();
+    if (!rasterShader_ || !resolveShader_)
+    {
+        return false;
+    }
+    rasterModelViewProjectionUniform_
+        = rasterShader_->getUniformHandle<glm::mat4>("u_modelViewProjection");
+    rasterPointCountUniform_
+        = rasterShader_->getUniformHandle<int>("u_pointCount");
+    rasterSceneWidthUniform_
+        = rasterShader_->getUniformHandle<int>("u_sceneWidth");
+    rasterSceneHeightUniform_
+        = rasterShader_->getUniformHandle<int>("u_sceneHeight");
+    resolveSceneWidthUniform_
+        = resolveShader_->getUniformHandle<int>("u_sceneWidth");
+
+    GLint64 maxBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+    const GLint64 maxPoints = std::min<GLint64>(
+        maxBlockSize / static_cast<GLint64>(sizeof(glm::uvec2)),
+        std::numeric_limits<GLsizei>::max());
+    maxPointsPerDispatch_ = std::max(
+        static_cast<GLsizei>(maxPoints) / DISPATCH_ALIGNMENT
+            * DISPATCH_ALIGNMENT,
+        DISPATCH_ALIGNMENT);
+#endif
+    return true;
+}
+
+bool PointRenderer::isComputeRasterized() const
+{
+#ifdef __EMSCRIPTEN__
+    return false;
+#else
+    return rasterShader_.has_value();
+#endif
+}
+
+void PointRenderer::resize([[maybe_unused]] int width,
+                           [[maybe_unused]] int height)
+{
+#ifndef __EMSCRIPTEN__
+    if (!isComputeRasterized() || (width == width_ && height == height_))
+    {
+        return;
+    }
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    width_ = width;
+    height_ = height;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize());
+
+    if (!pixelBuffer_)
+    {
+        glGenBuffers(1, &pixelBuffer_);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(videoMemorySize()),
+                 nullptr,
+                 GL_DYNAMIC_COPY);
+    constexpr std::array<GLuint, 2> emptyPixel{
+        std::numeric_limits<GLuint>::max(),
+        std::numeric_limits<GLuint>::max()};
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER,
+                      GL_RG32UI,
+                      GL_RG_INTEGER,
+                      GL_UNSIGNED_INT,
+                      emptyPixel.data());
+#endif
+}
+
+void PointRenderer::draw(const PointCloud& pointCloud,
+                         std::span<const Copy> copies,
+                         [[maybe_unused]] int sceneWidth,
+                         [[maybe_unused]] int sceneHeight,
+                         [[maybe_unused]] GLuint emptyVertexArray,
+                         GlStateCache& glState)
+{
+    PROFILE_SCOPE("PointRenderer::draw");
+#ifndef __EMSCRIPTEN__
+    if (isComputeRasterized() && pixelBuffer_)
+    {
+        rasterize(pointCloud, copies, sceneWidth, sceneHeight, glState);
+        // Nearest point of each pixel is written with its depth, so that
+        // later draws are tested against points like against any surface
+        glState.bindVertexArray(emptyVertexArray);
+        resolveShader_->use(glState);
+        resolveShader_->setUniform(resolveSceneWidthUniform_, sceneWidth);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        return;
+    }
+#endif
+    glState.bindVertexArray(pointCloud.vertexArray);
+    pointShader_->use(glState);
+    for (const Copy& copy : copies)
+    {
+        pointShader_->setUniform(pointModelViewProjectionUniform_,
+                                 copy.modelViewProjection);
+        glDrawArrays(GL_POINTS, 0, copy.pointCount);
+    }
+}
+
+#ifndef __EMSCRIPTEN__
+void PointRenderer::rasterize(const PointCloud& pointCloud,
+                              std::span<const Copy> copies,
+                              int sceneWidth,
+                              int sceneHeight,
+                              GlStateCache& glState)
+{
+    // Resolve of the previous frame cleared pixels from a fragment shader
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PIXEL_BINDING, pixelBuffer_);
+    rasterShader_->use(glState);
+    rasterShader_->setUniform(rasterSceneWidthUniform_, sceneWidth);
+    rasterShader_->setUniform(rasterSceneHeightUniform_, sceneHeight);
+    for (const Copy& copy : copies)
+    {
+        rasterShader_->setUniform(rasterModelViewProjectionUniform_,
+                                  copy.modelViewProjection);
+        for (GLsizei first = 0; first < copy.pointCount;
+             first += maxPointsPerDispatch_)
+        {
+            const GLsizei count
+                = std::min(copy.pointCount - first, maxPointsPerDispatch_);
+            glBindBufferRange(
+                GL_SHADER_STORAGE_BUFFER,
+                POINT_BINDING,
+                pointCloud.pointBuffer,
+                static_cast<GLintptr>(first)
+                    * static_cast<GLintptr>(sizeof(glm::uvec2)),
+                static_cast<GLsizeiptr>(count)
+                    * static_cast<GLsizeiptr>(sizeof(glm::uvec2)));
+            rasterShader_->setUniform(rasterPointCountUniform_, count);
+            const GLuint groupCount
+                = (static_cast<GLuint>(count) + RASTER_GROUP_SIZE - 1)
+                / RASTER_GROUP_SIZE;
+            const GLuint groupCountX = std::min(groupCount, MAX_GROUP_COUNT);
+            glDispatchCompute(groupCountX,
+                              (groupCount + groupCountX - 1) / groupCountX,
+                              1);
+        }
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+size_t PointRenderer::videoMemorySize() const
+{
+    return static_cast<size_t>(width_) * static_cast<size_t>(height_)
+         * PIXEL_SIZE;
+}
+#endif
@@ -0,0 +1,127 @@
+#ifndef POINT_RENDERER_H_
+#define POINT_RENDERER_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+#include "glm/mat4x4.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+class PointCloud;
+
+/// Drawing of point clouds, rasterized by compute shaders where 64-bit
+/// atomics are available, and drawn as point primitives otherwise.
+///
+/// Point primitives go through primitive assembly, rasterization and
+/// blending for a single pixel each, which stalls fixed function hardware
+/// long before memory bandwidth runs out. Compute rasterization instead
+/// projects each point in a compute shader, and keeps the nearest point of
+/// each pixel with a single 64-bit atomic minimum on a buffer of pixels,
+/// holding depth in its high and color in its low bits. A fullscreen pass
+/// then resolves the buffer into color and depth of the scene, clearing it
+/// for the next frame.
+///
+/// Compute rasterization needs ARB_gpu_shader_int64 and
+/// NV_shader_atomic_int64, and is not available in OpenGL ES 3.0. Like the
+/// scene framebuffer, the pixel buffer is allocated for the full window size
+/// and covers the scene at its bottom-left corner.
+///
+/// Pixel buffer is created on first resize. Non-copyable, non-movable.
+class PointRenderer
+{
+public:
+    /// Shaders of point primitives and of compute rasterization submitted
+    /// for compilation.
+    struct PendingShaders
+    {
+        PendingShader pointShader;
+#ifndef __EMSCRIPTEN__
+        /// Empty without 64-bit atomics.
+        std::optional<PendingShader> rasterShader;
+        std::optional<PendingShader> resolveShader;
+#endif
+    };
+
+    /// Copy of a point cloud to draw, and the number of points it is drawn
+    /// with, taken from the start of its shuffled points.
+    struct Copy
+    {
+        /// Includes the position transform of the point cloud.
+        glm::mat4 modelViewProjection;
+        GLsizei pointCount;
+    };
+
+    PointRenderer();
+    PointRenderer(const PointRenderer&) = delete;
+    PointRenderer& operator=(const PointRenderer&) = delete;
+    PointRenderer(PointRenderer&&) = delete;
+    PointRenderer& operator=(PointRenderer&&) = delete;
+    ~PointRenderer();
+
+    /// Submit shaders for compilation without waiting for the driver to
+    /// finish. Compute shaders are only submitted when supported.
+    static PendingShaders submitShaders();
+
+    /// Finish compilation of submitted shaders.
+    bool init(PendingShaders&& shaders);
+
+    /// Whether points are rasterized by compute shaders.
+    [[nodiscard]] bool isComputeRasterized() const;
+
+    /// Recreate pixel buffer of compute rasterization when the size of the
+    /// camera view changes. Nothing is allocated when points are drawn as
+    /// primitives.
+    void resize(int width, int height);
+
+    /// Draw copies of point cloud into the bottom-left rectangle of given
+    /// size of the bound framebuffer, with the depth state set by the
+    /// caller.
+    void draw(const PointCloud& pointCloud,
+              std::span<const Copy> copies,
+              int sceneWidth,
+              int sceneHeight,
+              GLuint emptyVertexArray,
+              GlStateCache& glState);
+
+private:
+    std::optional<Shader> pointShader_;
+    UniformHandle<glm::mat4> pointModelViewProjectionUniform_;
+#ifndef __EMSCRIPTEN__
+    /// Rasterize points of each copy into the pixel buffer.
+    void rasterize(const PointCloud& pointCloud,
+                   std::span<const Copy> copies,
+                   int sceneWidth,
+                   int sceneHeight,
+                   GlStateCache& glState);
+
+    /// Video memory taken by pixel buffer in bytes.
+    [[nodiscard]] size_t videoMemorySize() const;
+
+    std::optional<Shader> rasterShader_;
+    std::optional<Shader> resolveShader_;
+    UniformHandle<glm::mat4> rasterModelViewProjectionUniform_;
+    UniformHandle<int> rasterPointCountUniform_;
+    UniformHandle<int> rasterSceneWidthUniform_;
+    UniformHandle<int> rasterSceneHeightUniform_;
+    UniformHandle<int> resolveSceneWidthUniform_;
+    /// Nearest point of each pixel, empty pixels holding the largest value.
+    /// Cleared on creation, and by the resolve pass afterwards, which visits
+    /// every pixel any point was rasterized into.
+    GLuint pixelBuffer_;
+    int width_;
+    int height_;
+    /// Points bound as a single shader storage range at most, as drivers may
+    /// limit storage blocks far below the size of large point clouds.
+    GLsizei maxPointsPerDispatch_;
+#endif
+};
+
+#endif
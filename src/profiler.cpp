@@ -0,0 +1,182 @@
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+/// Zones kept per thread. About a second of zones of a busy thread.
+constexpr size_t ZONE_CAPACITY = size_t{1} << 15U;
+
+const std::chrono::steady_clock::time_point START_TIME
+    = std::chrono::steady_clock::now();
+
+/// Fields are atomic only to allow reading them while being overwritten,
+/// which is detected through the counters of the ring.
+struct RecordedZone
+{
+    std::atomic<const char*> name;
+    std::atomic<std::int64_t> begin;
+    std::atomic<std::int64_t> end;
+};
+
+/// Ring of zones written by a single thread and read by export.
+struct ThreadRing
+{
+    std::array<RecordedZone, ZONE_CAPACITY> zones;
+    /// Zones whose writing started, including the one being written.
+    std::atomic<std::uint64_t> startedCount;
+    /// Zones completely written.
+    std::atomic<std::uint64_t> finishedCount;
+    size_t threadIndex;
+};
+
+/// Rings are never freed, so that zones of exited threads can still be
+/// exported.
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<ThreadRing>> rings;
+
+thread_local ThreadRing* currentRing = nullptr;
+
+ThreadRing& getCurrentRing()
+{
+    // Locking happens only once per thread
+    if (!currentRing)
+    {
+        const std::lock_guard lock(ringsMutex);
+        auto ring = std::make_unique<ThreadRing>();
+        ring->threadIndex = rings.size();
+        currentRing = rings.emplace_back(std::move(ring)).get();
+    }
+    return *currentRing;
+}
+
+struct ZoneCopy
+{
+    const char* name;
+    std::int64_t begin;
+    std::int64_t end;
+};
+
+/// Copy zones of ring that were not overwritten while copying.
+std::vector<ZoneCopy> copyZones(const ThreadRing& ring)
+{
+    const std::uint64_t finishedCount
+        = ring.finishedCount.load(std::memory_order_acquire);
+    const std::uint64_t firstIndex
+        = finishedCount > ZONE_CAPACITY ? finishedCount - ZONE_CAPACITY : 0;
+    std::vector<ZoneCopy> copies;
+    copies.reserve(finishedCount - firstIndex);
+    for (std::uint64_t i = firstIndex; i < finishedCount; ++i)
+    {
+        const RecordedZone& zone = ring.zones[i % ZONE_CAPACITY];
+        copies.push_back({
+            .name = zone.name.load(std::memory_order_relaxed),
+            .begin = zone.begin.load(std::memory_order_relaxed),
+            .end = zone.end.load(std::memory_order_relaxed),
+        });
+    }
+
+    // Zones written meanwhile overwrote the oldest copies, which are dropped
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::uint64_t startedCount
+        = ring.startedCount.load(std::memory_order_relaxed);
+    const std::uint64_t firstValidIndex
+        = startedCount > ZONE_CAPACITY ? startedCount - ZONE_CAPACITY : 0;
+    if (firstValidIndex > firstIndex)
+    {
+        const auto droppedCount = static_cast<std::ptrdiff_t>(
+            std::min<std::uint64_t>(firstValidIndex - firstIndex,
+                                    copies.size()));
+        copies.erase(copies.begin(), copies.begin() + droppedCount);
+    }
+    return copies;
+}
+}  // namespace
+
+namespace profiler
+{
+std::int64_t Zone::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - START_TIME)
+        .count();
+}
+
+void Zone::record(const char* name,
+                  std::int64_t beginNanoseconds,
+                  std::int64_t endNanoseconds)
+{
+    ThreadRing& ring = getCurrentRing();
+    // Only this thread writes the ring, so counters need no read-modify-write
+    const std::uint64_t index
+        = ring.finishedCount.load(std::memory_order_relaxed);
+    ring.startedCount.store(index + 1, std::memory_order_relaxed);
+    // Export seeing any part of the zone sees the started count as well
+    std::atomic_thread_fence(std::memory_order_release);
+    RecordedZone& zone = ring.zones[index % ZONE_CAPACITY];
+    zone.name.store(name, std::memory_order_relaxed);
+    zone.begin.store(beginNanoseconds, std::memory_order_relaxed);
+    zone.end.store(endNanoseconds, std::memory_order_relaxed);
+    ring.finishedCount.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::filesystem::path& filePath)
+{
+    std::ofstream file{filePath};
+    if (!file)
+    {
+        utils::showErrorMessage("unable to create trace file ", filePath);
+        return false;
+    }
+
+    // Rings registered during export are left out
+    std::vector<const ThreadRing*> threadRings;
+    {
+        const std::lock_guard lock(ringsMutex);
+        threadRings.reserve(rings.size());
+        for (const std::unique_ptr<ThreadRing>& ring : rings)
+        {
+            threadRings.push_back(ring.get());
+        }
+    }
+
+    // Complete events with begin and duration in microseconds. Viewers nest
+    // events of the same thread by their time ranges.
+    file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    bool first = true;
+    for (const ThreadRing* ring : threadRings)
+    {
+        for (const ZoneCopy& zone : copyZones(*ring))
+        {
+            file << (first ? "\n" : ",\n") << R"({"name":")" << zone.name
+                 << R"(","ph":"X","pid":0,"tid":)" << ring->threadIndex
+                 << R"(,"ts":)" << static_cast<double>(zone.begin) * 1e-3
+                 << R"(,"dur":)"
+                 << static_cast<double>(zone.end - zone.begin) * 1e-3 << '}';
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+
+    if (!file)
+    {
+        utils::showErrorMessage("unable to write trace file ", filePath);
+        return false;
+    }
+    return true;
+}
+}  // namespace profiler
+
+#endif
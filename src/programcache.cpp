@@ -0,0 +1,176 @@
+#include "programcache.h"
+
+#include "embeddedshaders.h"
+#include "utils.h"
+
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'P', 'R', 'G', 'C'};
+// Increment on any change of Header layout.
+constexpr uint32_t FORMAT_VERSION = 1;
+
+struct Header
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+
+std::string_view getDriverString(GLenum name)
+{
+    const GLubyte* value = glGetString(name);
+    return value ? std::string_view{reinterpret_cast<const char*>(value)}
+                 : std::string_view{};
+}
+
+fs::path cachePath(uint64_t key)
+{
+    std::array<char, 17> name;
+    std::snprintf(name.data(),
+                  name.size(),
+                  "%016llx",
+                  static_cast<unsigned long long>(key));
+    fs::path path{"shadercache"};
+    path /= name.data();
+    path += ".bin";
+    return path;
+}
+}  // namespace
+
+namespace programcache
+{
+uint64_t computeKey(std::span<const uint64_t> sourceHashes)
+{
+    using embeddedshaders::hashBytes;
+    uint64_t hash = embeddedshaders::HASH_OFFSET_BASIS;
+    for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        hash = hashBytes(getDriverString(name), hash);
+        // Separator keeps adjacent strings from hashing the same when the
+        // boundary between them moves
+        hash = hashBytes(std::string_view{"\0", 1}, hash);
+    }
+    // Sources were hashed when read, embedded ones at compile time
+    for (const uint64_t sourceHash : sourceHashes)
+    {
+        const auto* bytes = reinterpret_cast<const char*>(&sourceHash);
+        hash = hashBytes(std::string_view{bytes, sizeof(sourceHash)}, hash);
+    }
+    return hash;
+}
+
+std::optional<GLuint> load(uint64_t key)
+{
+    std::ifstream file(cachePath(key), std::ios::binary);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    Header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+    if (!file || header.magic != MAGIC || header.version != FORMAT_VERSION
+        || header.key != key || header.binarySize == 0)
+    {
+        return std::nullopt;
+    }
+    std::vector<char> binary(header.binarySize);
+    file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    // Driver updates changing the binary format without changing the version
+    // string are caught by failing link status
+    const GLuint program = glCreateProgram();
+    glProgramBinary(program,
+                    header.binaryFormat,
+                    binary.data(),
+                    static_cast<GLsizei>(binary.size()));
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(program);
+        return std::nullopt;
+    }
+    return program;
+}
+
+bool store(uint64_t key, GLuint program)
+{
+    // Drivers are allowed to support no binary formats at all
+    GLint binarySize = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0)
+    {
+        return false;
+    }
+    std::vector<char> binary(static_cast<size_t>(binarySize));
+    GLenum binaryFormat = 0;
+    GLsizei writtenSize = 0;
+    glGetProgramBinary(program,
+                       binarySize,
+                       &writtenSize,
+                       &binaryFormat,
+                       binary.data());
+    if (writtenSize <= 0)
+    {
+        return false;
+    }
+
+    const Header header{
+        .magic = MAGIC,
+        .version = FORMAT_VERSION,
+        .key = key,
+        .binaryFormat = static_cast<uint32_t>(binaryFormat),
+        .binarySize = static_cast<uint32_t>(writtenSize),
+    };
+
+    // Write into temporary file first and rename afterwards, so that an
+    // interrupted write never leaves a half-written cache entry behind.
+    const fs::path path = cachePath(key);
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(binary.data(), writtenSize);
+        if (!file)
+        {
+            utils::logWarning("unable to write program cache ", temporaryPath);
+            return false;
+        }
+    }
+
+    fs::rename(temporaryPath, path, error);
+    if (error)
+    {
+        utils::logWarning("unable to write program cache ",
+                          path,
+                          ": ",
+                          error.message());
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+
+    return true;
+}
+}  // namespace programcache
@@ -0,0 +1,38 @@
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+
+#include "glad/gl.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/// Persistent cache of linked shader program binaries to avoid compiling and
+/// linking GLSL sources on every application launch.
+///
+/// Cache entries are placed into a "shadercache" directory next to the
+/// executable, the same way assets are looked up, one file per program named
+/// after its key. The key combines hashes of the GLSL sources with the
+/// vendor, renderer and version strings of the driver, because program
+/// binaries are only valid for the driver that produced them. A driver may
+/// still reject a binary, in which case the caller is expected to compile the
+/// program from sources and store the result.
+///
+/// Program binaries are not available in WebGL 2.
+namespace programcache
+{
+/// Key identifying program built from sources of given hashes on the current
+/// driver. Graphics context has to be current.
+std::uint64_t computeKey(std::span<const std::uint64_t> sourceHashes);
+
+/// Create program from previously stored binary. Returns nothing when cache
+/// entry is missing, corrupted or rejected by the driver.
+std::optional<GLuint> load(std::uint64_t key);
+
+/// Persist binary of linked program for subsequent launches. Program has to be
+/// linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. Failure to write the
+/// cache is not fatal, the program is compiled again on next launch.
+bool store(std::uint64_t key, GLuint program);
+}  // namespace programcache
+
+#endif
@@ -0,0 +1,398 @@
+#include "progressivemesh.h"
+
+#include "meshcodec.h"
+#include "meshprocessing.h"
+#include "utils.h"
+
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'P', 'M', 'S', 'H'};
+constexpr std::uint32_t FORMAT_VERSION = 3;
+constexpr GLuint UNASSIGNED_VERTEX = std::numeric_limits<GLuint>::max();
+
+static_assert(sizeof(progressivemesh::Level) == 32);
+static_assert(std::is_trivially_copyable_v<progressivemesh::Header>);
+
+size_t indexSize(std::uint32_t indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+/// FNV-1a, enough to tell apart different versions of the same file.
+std::uint64_t hashBytes(std::uint64_t hash, std::span<const std::byte> bytes)
+{
+    for (const std::byte byte : bytes)
+    {
+        hash ^= static_cast<std::uint64_t>(byte);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void appendStream(std::span<const std::uint32_t> stream,
+                  std::vector<std::byte>& chunk)
+{
+    const size_t offset = chunk.size();
+    chunk.resize(offset + stream.size_bytes());
+    std::memcpy(chunk.data() + offset, stream.data(), stream.size_bytes());
+}
+
+/// Copy of encoded stream at given byte range of chunk, which is not aligned
+/// for reading words in place.
+std::vector<std::uint32_t> readStream(std::span<const std::byte> bytes)
+{
+    std::vector<std::uint32_t> stream(bytes.size() / sizeof(std::uint32_t));
+    std::memcpy(stream.data(), bytes.data(), bytes.size());
+    return stream;
+}
+
+template <typename IndexType>
+std::vector<std::byte> narrowIndices(std::span<const GLuint> indices)
+{
+    std::vector<std::byte> bytes(indices.size() * sizeof(IndexType));
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        const auto index = static_cast<IndexType>(indices[i]);
+        std::memcpy(bytes.data() + i * sizeof(IndexType),
+                    &index,
+                    sizeof(IndexType));
+    }
+    return bytes;
+}
+}  // namespace
+
+namespace progressivemesh
+{
+fs::path progressivePath(const fs::path& sourcePath)
+{
+    fs::path path = sourcePath;
+    path += ".progressive";
+    return path;
+}
+
+bool write(const MeshData& meshData, const fs::path& path)
+{
+    // Packed relative to the bounds of the whole mesh, like the geometry
+    // arena
+    Bounds bounds = meshData.bounds();
+    std::vector<PackedVertex> packedVertices;
+    std::span<const PackedVertex> vertices = meshData.packedVertices();
+    if (meshData.vertexFormat() == VertexFormat::Float)
+    {
+        bounds = meshprocessing::computeBounds(meshData.vertices());
+        packedVertices
+            = meshprocessing::packVertices(meshData.vertices(), bounds);
+        vertices = packedVertices;
+    }
+    const auto readIndex = [&](size_t i) -> GLuint
+    {
+        return meshData.indexType() == GL_UNSIGNED_SHORT
+                 ? meshData.shortIndices()[i]
+                 : meshData.indices()[i];
+    };
+
+    // Levels are gathered from full detail towards coarsest, sub-meshes with
+    // shorter chains repeat their coarsest level
+    size_t chainLength = 0;
+    for (const Submesh& submesh : meshData.submeshes())
+    {
+        chainLength = std::max<size_t>(chainLength, submesh.lodCount);
+    }
+    const size_t levelCount = std::min(chainLength + 1, MAX_LEVEL_COUNT);
+    std::vector<std::vector<GLuint>> levelIndices(levelCount);
+    std::vector<float> levelErrors(levelCount, 0.0F);
+    for (size_t simplification = 0; simplification < levelCount;
+         ++simplification)
+    {
+        std::vector<GLuint>& indices = levelIndices[simplification];
+        for (const Submesh& submesh : meshData.submeshes())
+        {
+            GLuint firstIndex = submesh.firstIndex;
+            GLuint indexCount = submesh.indexCount;
+            if (simplification > 0 && submesh.lodCount > 0)
+            {
+                const GLuint chainLevel
+                    = std::min(static_cast<GLuint>(simplification),
+                               submesh.lodCount)
+                    - 1;
+                const SubmeshLod& lod
+                    = meshData.lods()[submesh.firstLod + chainLevel];
+                firstIndex = lod.firstIndex;
+                indexCount = lod.indexCount;
+                levelErrors[simplification]
+                    = std::max(levelErrors[simplification], lod.error);
+            }
+            for (GLuint i = 0; i < indexCount; ++i)
+            {
+                indices.push_back(
+                    readIndex(firstIndex + i)
+                    + static_cast<GLuint>(submesh.baseVertex));
+            }
+        }
+    }
+    // Written coarsest first
+    std::reverse(levelIndices.begin(), levelIndices.end());
+    std::reverse(levelErrors.begin(), levelErrors.end());
+
+    // Vertices are renumbered in order of first reference, so that each
+    // chunk only appends the vertices its level adds
+    std::vector<GLuint> remap(vertices.size(), UNASSIGNED_VERTEX);
+    std::vector<PackedVertex> orderedVertices;
+    std::vector<size_t> levelVertexCounts;
+    for (std::vector<GLuint>& indices : levelIndices)
+    {
+        for (GLuint& index : indices)
+        {
+            if (remap[index] == UNASSIGNED_VERTEX)
+            {
+                remap[index] = static_cast<GLuint>(orderedVertices.size());
+                orderedVertices.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        levelVertexCounts.push_back(orderedVertices.size());
+    }
+
+    Header header{};
+    header.magic = MAGIC;
+    header.version = FORMAT_VERSION;
+    header.levelCount = static_cast<std::uint32_t>(levelCount);
+    // Largest short index is left for primitive restart
+    header.indexType
+        = orderedVertices.size() < std::numeric_limits<GLushort>::max()
+            ? GL_UNSIGNED_SHORT
+            : GL_UNSIGNED_INT;
+    header.boundsMinimum
+        = {bounds.minimum.x, bounds.minimum.y, bounds.minimum.z};
+    header.boundsMaximum
+        = {bounds.maximum.x, bounds.maximum.y, bounds.maximum.z};
+    std::vector<std::vector<std::byte>> chunks(levelCount);
+    std::uint64_t offset = sizeof(Header);
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t firstVertex = 0;
+    // File size with streams unencoded, for comparison
+    size_t unencodedSize = sizeof(Header);
+    for (size_t level = 0; level < levelCount; ++level)
+    {
+        std::vector<std::byte>& chunk = chunks[level];
+        const std::span<const PackedVertex> levelVertices
+            = std::span{orderedVertices}.subspan(
+                firstVertex,
+                levelVertexCounts[level] - firstVertex);
+        appendStream(meshcodec::encodeVertices(levelVertices), chunk);
+        const size_t vertexStreamSize = chunk.size();
+        appendStream(meshcodec::encodeIndices(levelIndices[level]), chunk);
+        header.levels[level] = {
+            .offset = offset,
+            .size = chunk.size(),
+            .vertexCount
+            = static_cast<std::uint32_t>(levelVertexCounts[level]),
+            .indexCount
+            = static_cast<std::uint32_t>(levelIndices[level].size()),
+            .error = levelErrors[level],
+            .vertexStreamSize = static_cast<std::uint32_t>(vertexStreamSize),
+        };
+        offset += chunk.size();
+        unencodedSize += levelVertices.size_bytes()
+                       + levelIndices[level].size()
+                             * indexSize(header.indexType);
+        hash = hashBytes(hash, chunk);
+        firstVertex = levelVertexCounts[level];
+    }
+    header.contentHash = hash;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::vector<std::byte>& chunk : chunks)
+    {
+        file.write(reinterpret_cast<const char*>(chunk.data()),
+                   static_cast<std::streamsize>(chunk.size()));
+    }
+    if (!file)
+    {
+        utils::showErrorMessage("unable to write progressive mesh file at ",
+                                path);
+        return false;
+    }
+    utils::logInfo("wrote ",
+                   levelCount,
+                   " levels of ",
+                   path,
+                   ", coarsest level takes ",
+                   sizeof(Header) + header.levels[0].size,
+                   " of ",
+                   offset,
+                   " bytes, ",
+                   unencodedSize,
+                   " bytes unencoded");
+    return true;
+}
+
+std::optional<Header> readHeader(std::span<const std::byte> data,
+                                 std::uint64_t fileSize)
+{
+    Header header{};
+    if (data.size() < sizeof(header))
+    {
+        return std::nullopt;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != MAGIC || header.version != FORMAT_VERSION
+        || header.levelCount == 0 || header.levelCount > MAX_LEVEL_COUNT
+        || (header.indexType != GL_UNSIGNED_SHORT
+            && header.indexType != GL_UNSIGNED_INT))
+    {
+        return std::nullopt;
+    }
+    // Encoded sizes depend on the geometry, so only the block offsets of
+    // both streams are known to be there
+    std::uint32_t previousVertexCount = 0;
+    std::uint64_t levelOffset = sizeof(header);
+    for (const Level& level :
+         std::span{header.levels}.first(header.levelCount))
+    {
+        // Chunks follow each other, so every level is fetched from inside
+        // the file
+        if (level.offset != levelOffset || level.offset > fileSize
+            || level.size > fileSize - level.offset)
+        {
+            return std::nullopt;
+        }
+        levelOffset += level.size;
+        const size_t vertexBlocks
+            = meshcodec::blockCount(level.vertexCount - previousVertexCount);
+        const size_t indexBlocks = meshcodec::blockCount(level.indexCount);
+        if (level.vertexCount < previousVertexCount
+            || level.vertexStreamSize % sizeof(std::uint32_t) != 0
+            || level.size % sizeof(std::uint32_t) != 0
+            || level.vertexStreamSize > level.size
+            || level.vertexStreamSize < vertexBlocks * sizeof(std::uint32_t)
+            || level.size - level.vertexStreamSize
+                   < indexBlocks * sizeof(std::uint32_t))
+        {
+            return std::nullopt;
+        }
+        previousVertexCount = level.vertexCount;
+    }
+    return header;
+}
+
+Builder::Builder(const Header& header)
+    : header_{header}
+{
+}
+
+bool Builder::appendLevel(std::span<const std::byte> chunk)
+{
+    if (isComplete())
+    {
+        return false;
+    }
+    const Level& level = header_.levels[levelIndices_.size()];
+    if (chunk.size() != level.size)
+    {
+        return false;
+    }
+    const size_t firstVertex = vertices_.size();
+    std::vector<PackedVertex> newVertices(level.vertexCount - firstVertex);
+    std::vector<GLuint> indices(level.indexCount);
+    if (!meshcodec::decodeVertices(
+            readStream(chunk.first(level.vertexStreamSize)),
+            newVertices)
+        || !meshcodec::decodeIndices(
+            readStream(chunk.subspan(level.vertexStreamSize)),
+            indices))
+    {
+        return false;
+    }
+    // Out of range indices are an error in WebGL, rejected up front instead
+    if (std::ranges::any_of(indices,
+                            [&](GLuint index)
+                            { return index >= level.vertexCount; }))
+    {
+        return false;
+    }
+
+    vertices_.insert(vertices_.end(), newVertices.begin(), newVertices.end());
+    levelIndices_.push_back(header_.indexType == GL_UNSIGNED_SHORT
+                                ? narrowIndices<GLushort>(indices)
+                                : narrowIndices<GLuint>(indices));
+    return true;
+}
+
+MeshData Builder::meshData() const
+{
+    return header_.indexType == GL_UNSIGNED_SHORT ? assemble<GLushort>()
+                                                  : assemble<GLuint>();
+}
+
+template <typename IndexType>
+MeshData Builder::assemble() const
+{
+    const Bounds bounds{
+        .minimum = glm::vec3{header_.boundsMinimum[0],
+                             header_.boundsMinimum[1],
+                             header_.boundsMinimum[2]},
+        .maximum = glm::vec3{header_.boundsMaximum[0],
+                             header_.boundsMaximum[1],
+                             header_.boundsMaximum[2]},
+    };
+    const glm::vec3 center = (bounds.minimum + bounds.maximum) * 0.5F;
+    const float radius = glm::length(bounds.maximum - bounds.minimum) * 0.5F;
+
+    // Finest level first, followed by the coarser ones from finest to
+    // coarsest as its chain
+    std::vector<IndexType> indices;
+    std::vector<SubmeshLod> lods;
+    const auto appendLevelIndices = [&](size_t level)
+    {
+        const std::vector<std::byte>& levelData = levelIndices_[level];
+        const size_t firstIndex = indices.size();
+        indices.resize(firstIndex + levelData.size() / sizeof(IndexType));
+        std::memcpy(indices.data() + firstIndex,
+                    levelData.data(),
+                    levelData.size());
+    };
+    const size_t finest = levelIndices_.size() - 1;
+    appendLevelIndices(finest);
+    const Submesh submesh{
+        .firstIndex = 0,
+        .indexCount = static_cast<GLuint>(indices.size()),
+        .baseVertex = 0,
+        .firstMeshlet = 0,
+        .meshletCount = 0,
+        .firstLod = 0,
+        .lodCount = static_cast<GLuint>(finest),
+        .baseColor = glm::vec3{1.0F},
+        .opacity = 1.0F,
+        .textureLayer = NO_TEXTURE_LAYER,
+    };
+    for (size_t level = finest; level > 0; --level)
+    {
+        lods.push_back({
+            .firstIndex = static_cast<GLuint>(indices.size()),
+            .indexCount = header_.levels[level - 1].indexCount,
+            .center = center,
+            .radius = radius,
+            .error = header_.levels[level - 1].error,
+        });
+        appendLevelIndices(level - 1);
+    }
+    return MeshData::fromContainers(std::vector<PackedVertex>{vertices_},
+                                    std::move(indices),
+                                    {submesh},
+                                    std::vector<Meshlet>{},
+                                    std::move(lods),
+                                    bounds);
+}
+}  // namespace progressivemesh
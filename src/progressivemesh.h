@@ -0,0 +1,110 @@
+#ifndef PROGRESSIVE_MESH_H_
+#define PROGRESSIVE_MESH_H_
+
+#include "mesh.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Progressive mesh file, laid out so that any prefix of its levels can be
+/// drawn, for fetching models over the network coarse first.
+///
+/// A fixed-size header holding the level table is followed by one chunk per
+/// level from coarsest to full detail. A chunk holds the packed vertices first
+/// referenced by its level, followed by the complete indices of the level into
+/// the vertices of all chunks so far, both as streams encoded by meshcodec
+/// and decoded on arrival. Vertices are never repeated, only the indices of
+/// coarser levels are, which are a fraction of the full detail indices.
+/// Coarser levels received earlier become the discrete level of detail chain
+/// of the refined mesh, so nothing fetched is wasted.
+///
+/// Levels are the discrete level of detail chains of the sub-meshes, merged
+/// into a single range of indices rebased onto the merged vertices.
+namespace progressivemesh
+{
+inline constexpr size_t MAX_LEVEL_COUNT = 8;
+
+/// Layout is persisted as-is. Bump the format version when changing it.
+struct Level
+{
+    /// Byte range of the chunk of the level in the file.
+    std::uint64_t offset;
+    std::uint64_t size;
+    /// Vertices of all chunks up to and including this level.
+    std::uint32_t vertexCount;
+    std::uint32_t indexCount;
+    /// Largest distance of the level from the full detail surface.
+    float error;
+    /// Bytes of the chunk taken by the encoded vertex stream, followed by the
+    /// encoded index stream.
+    std::uint32_t vertexStreamSize;
+};
+
+/// Layout is persisted as-is. Bump the format version when changing it.
+struct Header
+{
+    std::array<char, 4> magic;
+    std::uint32_t version;
+    std::uint32_t levelCount;
+    /// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices of the assembled mesh.
+    /// Indices are encoded the same either way.
+    std::uint32_t indexType;
+    /// Hash of all chunks, identifying cached chunks of the same file.
+    std::uint64_t contentHash;
+    /// Bounding box vertices are packed relative to.
+    std::array<float, 3> boundsMinimum;
+    std::array<float, 3> boundsMaximum;
+    std::array<Level, MAX_LEVEL_COUNT> levels;
+};
+
+/// Location of the progressive file belonging to a source mesh file.
+std::filesystem::path progressivePath(const std::filesystem::path& sourcePath);
+
+/// Write imported mesh as progressive file. Levels are taken from the
+/// discrete level of detail chains of the mesh, meshes without chains are
+/// written as a single level.
+bool write(const MeshData& meshData, const std::filesystem::path& path);
+
+/// Validated header from the first bytes of a progressive file of given total
+/// size. Returns nothing when data is too short, not a progressive file of
+/// this version, or levels are not laid out back to back within the file.
+std::optional<Header> readHeader(std::span<const std::byte> data,
+                                 std::uint64_t fileSize);
+
+/// Mesh refined level by level as chunks arrive in order.
+class Builder
+{
+public:
+    explicit Builder(const Header& header);
+
+    /// Decode and append chunk of the next level. Returns false when chunk
+    /// does not match the level table or fails to decode.
+    bool appendLevel(std::span<const std::byte> chunk);
+
+    /// Mesh of the finest level appended so far, with the coarser levels as
+    /// its level of detail chain. Must not be called before the first level.
+    [[nodiscard]] MeshData meshData() const;
+
+    [[nodiscard]] size_t levelCount() const { return levelIndices_.size(); }
+    [[nodiscard]] bool isComplete() const
+    {
+        return levelIndices_.size() == header_.levelCount;
+    }
+
+private:
+    template <typename IndexType>
+    [[nodiscard]] MeshData assemble() const;
+
+    Header header_;
+    std::vector<PackedVertex> vertices_;
+    /// Raw indices of each appended level, coarsest first.
+    std::vector<std::vector<std::byte>> levelIndices_;
+};
+}  // namespace progressivemesh
+
+#endif
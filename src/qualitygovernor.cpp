@@ -0,0 +1,208 @@
+#include "qualitygovernor.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+/// Quality levels from full quality down, each lowering some settings
+/// further than the level above it. Reductions costing the least image
+/// quality for their savings come first.
+constexpr std::array LEVELS{
+    QualityGovernor::Decisions{.level = 0,
+                               .maxResolutionScale = 1.0F,
+                               .maxSampleCount = 8,
+                               .shadowMapSizeDivisor = 1,
+                               .lodErrorScale = 1.0F,
+                               .ambientOcclusionAllowed = true},
+    QualityGovernor::Decisions{.level = 1,
+                               .maxResolutionScale = 0.85F,
+                               .maxSampleCount = 8,
+                               .shadowMapSizeDivisor = 1,
+                               .lodErrorScale = 1.5F,
+                               .ambientOcclusionAllowed = true},
+    QualityGovernor::Decisions{.level = 2,
+                               .maxResolutionScale = 0.85F,
+                               .maxSampleCount = 4,
+                               .shadowMapSizeDivisor = 2,
+                               .lodErrorScale = 1.5F,
+                               .ambientOcclusionAllowed = true},
+    QualityGovernor::Decisions{.level = 3,
+                               .maxResolutionScale = 0.75F,
+                               .maxSampleCount = 2,
+                               .shadowMapSizeDivisor = 2,
+                               .lodErrorScale = 2.0F,
+                               .ambientOcclusionAllowed = false},
+    QualityGovernor::Decisions{.level = 4,
+                               .maxResolutionScale = 0.65F,
+                               .maxSampleCount = 1,
+                               .shadowMapSizeDivisor = 4,
+                               .lodErrorScale = 3.0F,
+                               .ambientOcclusionAllowed = false},
+    QualityGovernor::Decisions{.level = 5,
+                               .maxResolutionScale = 0.5F,
+                               .maxSampleCount = 1,
+                               .shadowMapSizeDivisor = 4,
+                               .lodErrorScale = 4.0F,
+                               .ambientOcclusionAllowed = false},
+};
+constexpr int LOWEST_LEVEL = static_cast<int>(LEVELS.size()) - 1;
+
+/// Weight of the latest frame in the smoothed frame time.
+constexpr float FRAME_TIME_WEIGHT = 0.1F;
+/// Quality is lowered above this fraction of the target, and raised below
+/// the other. The gap between them keeps quality from changing back and
+/// forth around the target.
+constexpr float LOWER_THRESHOLD = 1.05F;
+constexpr float RAISE_THRESHOLD = 0.75F;
+/// Seconds frames have to stay over the target before lowering quality.
+constexpr float LOWER_DELAY = 0.5F;
+/// Seconds frames have to stay under the target before raising quality, at
+/// first and at most.
+constexpr float MIN_RAISE_DELAY = 2.0F;
+constexpr float MAX_RAISE_DELAY = 32.0F;
+/// Quality lowered within this many seconds after raising it means that the
+/// raise did not fit.
+constexpr float FAILED_RAISE_WINDOW = 4.0F;
+/// Seconds measurements are ignored for after changing level, covering the
+/// frames in flight measured with the previous settings.
+constexpr float SETTLE_DELAY = 0.25F;
+/// Longest time counted between updates, so that a stall does not lower or
+/// raise quality on its own.
+constexpr float MAX_UPDATE_INTERVAL = 0.1F;
+
+/// Antialiasing modes in the order of the UI, the first with FXAA and the
+/// first one multisampling with two samples, each one after it doubling
+/// samples.
+constexpr int FXAA_MODE_INDEX = 1;
+constexpr int FIRST_MSAA_MODE_INDEX = 3;
+constexpr int MIN_SHADOW_MAP_SIZE = 256;
+
+/// Antialiasing mode index multisampling with at most given samples, FXAA
+/// replacing multisampling altogether below two.
+int limitSampleCount(int antialiasingModeIndex, int maxSampleCount)
+{
+    if (antialiasingModeIndex < FIRST_MSAA_MODE_INDEX)
+    {
+        return antialiasingModeIndex;
+    }
+    if (maxSampleCount < 2)
+    {
+        return FXAA_MODE_INDEX;
+    }
+    const int maxModeIndex
+        = FIRST_MSAA_MODE_INDEX
+        + static_cast<int>(std::log2(static_cast<float>(maxSampleCount))) - 1;
+    return std::min(antialiasingModeIndex, maxModeIndex);
+}
+}  // namespace
+
+QualityGovernor::QualityGovernor()
+    : level_{0}
+    , smoothedFrameTime_{0.0F}
+    , overTargetTime_{0.0F}
+    , underTargetTime_{0.0F}
+    , settleTime_{0.0F}
+    , raiseDelay_{MIN_RAISE_DELAY}
+    , timeSinceRaise_{FAILED_RAISE_WINDOW}
+{
+}
+
+void QualityGovernor::update(float frameTime, const DrawProperties& drawProps)
+{
+    const Clock::time_point now = Clock::now();
+    const float elapsedTime
+        = previousUpdate_
+            ? std::min(std::chrono::duration<float>(now - *previousUpdate_)
+                           .count(),
+                       MAX_UPDATE_INTERVAL)
+            : 0.0F;
+    previousUpdate_ = now;
+    if (!drawProps.qualityGovernorEnabled || frameTime <= 0.0F)
+    {
+        return;
+    }
+
+    timeSinceRaise_ += elapsedTime;
+    if (settleTime_ > 0.0F)
+    {
+        settleTime_ -= elapsedTime;
+        return;
+    }
+    smoothedFrameTime_
+        = smoothedFrameTime_ > 0.0F
+            ? std::lerp(smoothedFrameTime_, frameTime, FRAME_TIME_WEIGHT)
+            : frameTime;
+    overTargetTime_
+        = smoothedFrameTime_ > drawProps.targetFrameTime * LOWER_THRESHOLD
+            ? overTargetTime_ + elapsedTime
+            : 0.0F;
+    underTargetTime_
+        = smoothedFrameTime_ < drawProps.targetFrameTime * RAISE_THRESHOLD
+            ? underTargetTime_ + elapsedTime
+            : 0.0F;
+
+    if (overTargetTime_ >= LOWER_DELAY && level_ < LOWEST_LEVEL)
+    {
+        // Raise that did not hold is tried again only after a longer wait
+        raiseDelay_ = timeSinceRaise_ < FAILED_RAISE_WINDOW
+                        ? std::min(raiseDelay_ * 2.0F, MAX_RAISE_DELAY)
+                        : MIN_RAISE_DELAY;
+        changeLevel(level_ + 1);
+    }
+    else if (underTargetTime_ >= raiseDelay_ && level_ > 0)
+    {
+        timeSinceRaise_ = 0.0F;
+        changeLevel(level_ - 1);
+    }
+}
+
+void QualityGovernor::restart()
+{
+    previousUpdate_.reset();
+}
+
+DrawProperties QualityGovernor::apply(const DrawProperties& drawProps) const
+{
+    if (!drawProps.qualityGovernorEnabled)
+    {
+        return drawProps;
+    }
+    const Decisions& current = decisions();
+    DrawProperties applied = drawProps;
+    // Scale left behind by dynamic resolution was not chosen by the user
+    const float chosenResolutionScale = drawProps.dynamicResolutionEnabled
+                                          ? 1.0F
+                                          : drawProps.resolutionScale;
+    applied.dynamicResolutionEnabled = false;
+    applied.resolutionScale
+        = std::min(chosenResolutionScale, current.maxResolutionScale);
+    applied.antialiasingModeIndex
+        = limitSampleCount(drawProps.antialiasingModeIndex,
+                           current.maxSampleCount);
+    applied.shadowMapSize
+        = std::max(drawProps.shadowMapSize / current.shadowMapSizeDivisor,
+                   std::min(drawProps.shadowMapSize, MIN_SHADOW_MAP_SIZE));
+    applied.lodErrorThreshold = drawProps.lodErrorThreshold
+                              * current.lodErrorScale;
+    applied.ambientOcclusionEnabled
+        = drawProps.ambientOcclusionEnabled
+       && current.ambientOcclusionAllowed;
+    return applied;
+}
+
+const QualityGovernor::Decisions& QualityGovernor::decisions() const
+{
+    return LEVELS[static_cast<size_t>(level_)];
+}
+
+void QualityGovernor::changeLevel(int level)
+{
+    level_ = level;
+    overTargetTime_ = 0.0F;
+    underTargetTime_ = 0.0F;
+    settleTime_ = SETTLE_DELAY;
+    // Frame times of the previous level say nothing about the new one
+    smoothedFrameTime_ = 0.0F;
+}
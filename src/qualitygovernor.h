@@ -0,0 +1,83 @@
+#ifndef QUALITY_GOVERNOR_H_
+#define QUALITY_GOVERNOR_H_
+
+#include "drawproperties.h"
+
+#include <chrono>
+#include <optional>
+
+/// Holds frame time at a target by stepping rendering quality down a ladder
+/// of levels while frames are too slow, and back up while they are fast.
+///
+/// Each level lowers some of render scale, multisampling, shadow resolution,
+/// level of detail and ambient occlusion further than the level above it,
+/// cheapest losses first. Properties chosen in UI are the highest quality
+/// allowed, so that the governor never raises a setting above them.
+///
+/// Measured frame time is smoothed, and has to stay over the target for a
+/// while before quality is lowered, and well under it for longer before
+/// quality is raised. Raising quality that had to be lowered again right
+/// away doubles the wait before the next raise, so that the governor settles
+/// instead of oscillating between two levels. Measurements are ignored for
+/// a moment after every change, as GPU timer results arrive a few frames
+/// late.
+class QualityGovernor
+{
+public:
+    /// Quality chosen for the current level.
+    struct Decisions
+    {
+        /// Zero at full quality, higher levels being cheaper.
+        int level;
+        float maxResolutionScale;
+        /// Multisampling samples allowed, FXAA replaces multisampling below
+        /// two.
+        int maxSampleCount;
+        /// Shadow cascade size is divided by this.
+        int shadowMapSizeDivisor;
+        /// Level of detail error threshold is multiplied by this.
+        float lodErrorScale;
+        bool ambientOcclusionAllowed;
+    };
+
+    QualityGovernor();
+
+    /// Take frame time in milliseconds measured for the last frame, and step
+    /// quality level when it stayed off target long enough. Nothing changes
+    /// while the governor is disabled in properties.
+    void update(float frameTime, const DrawProperties& drawProps);
+    /// Forget timing of the previous update, so that a pause (e.g. idling)
+    /// does not count as time spent over or under the target.
+    void restart();
+
+    /// Properties with quality lowered by the current decisions. Returned
+    /// unchanged while the governor is disabled.
+    [[nodiscard]] DrawProperties apply(const DrawProperties& drawProps) const;
+
+    [[nodiscard]] const Decisions& decisions() const;
+    /// Smoothed frame time decisions are based on, zero before any update.
+    [[nodiscard]] float smoothedFrameTime() const
+    {
+        return smoothedFrameTime_;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void changeLevel(int level);
+
+    int level_;
+    float smoothedFrameTime_;
+    /// Seconds the smoothed frame time stayed over and under the target.
+    float overTargetTime_;
+    float underTargetTime_;
+    /// Seconds left before measurements are taken into account again.
+    float settleTime_;
+    /// Seconds frames have to stay under the target before raising quality,
+    /// and seconds since quality was last raised.
+    float raiseDelay_;
+    float timeSinceRaise_;
+    std::optional<Clock::time_point> previousUpdate_;
+};
+
+#endif
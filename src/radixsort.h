@@ -0,0 +1,68 @@
+#ifndef RADIX_SORT_H_
+#define RADIX_SORT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// Stable least significant digit radix sort of items by their 64-bit
+/// sortKey member, one byte per pass.
+///
+/// Runs in linear time, which beats comparison sorts for the thousands of
+/// draws sorted every frame. Passes over bytes that are equal in every key are
+/// skipped, so keys differing only in a few fields cost only a few passes.
+/// Scratch storage is resized to fit and can be reused between calls to avoid
+/// allocations.
+template <typename T>
+void radixSortByKey(std::vector<T>& items, std::vector<T>& scratch)
+{
+    constexpr size_t RADIX_BITS = 8;
+    constexpr size_t BUCKET_COUNT = size_t{1} << RADIX_BITS;
+    constexpr size_t PASS_COUNT = 64 / RADIX_BITS;
+
+    if (items.size() < 2)
+    {
+        return;
+    }
+    scratch.resize(items.size());
+
+    // Histograms of all passes are counted in a single pass over the items
+    std::array<std::array<size_t, BUCKET_COUNT>, PASS_COUNT> histograms{};
+    for (const T& item : items)
+    {
+        for (size_t pass = 0; pass < PASS_COUNT; ++pass)
+        {
+            ++histograms[pass][(item.sortKey >> (pass * RADIX_BITS))
+                               & (BUCKET_COUNT - 1)];
+        }
+    }
+
+    for (size_t pass = 0; pass < PASS_COUNT; ++pass)
+    {
+        std::array<size_t, BUCKET_COUNT>& histogram = histograms[pass];
+        const size_t shift = pass * RADIX_BITS;
+        const size_t firstBucket
+            = (items.front().sortKey >> shift) & (BUCKET_COUNT - 1);
+        if (histogram[firstBucket] == items.size())
+        {
+            continue;
+        }
+
+        // Bucket counts turn into first output position of each bucket
+        size_t offset = 0;
+        for (size_t& count : histogram)
+        {
+            offset += std::exchange(count, offset);
+        }
+        for (const T& item : items)
+        {
+            scratch[histogram[(item.sortKey >> shift) & (BUCKET_COUNT - 1)]++]
+                = item;
+        }
+        items.swap(scratch);
+    }
+}
+
+#endif
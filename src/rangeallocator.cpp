@@ -0,0 +1,104 @@
+#include "rangeallocator.h"
+
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator()
+    : capacity_{0}
+    , usedSize_{0}
+{
+}
+
+std::optional<size_t> RangeAllocator::allocate(size_t size)
+{
+    // Empty ranges take no space, even when no free range is left
+    if (size == 0)
+    {
+        return 0;
+    }
+    const auto it
+        = std::ranges::find_if(freeRanges_,
+                               [size](const AllocatedRange& freeRange)
+                               { return freeRange.size >= size; });
+    if (it == freeRanges_.end())
+    {
+        return std::nullopt;
+    }
+    const size_t offset = it->offset;
+    if (it->size == size)
+    {
+        freeRanges_.erase(it);
+    }
+    else
+    {
+        it->offset += size;
+        it->size -= size;
+    }
+    usedSize_ += size;
+    return offset;
+}
+
+void RangeAllocator::release(const AllocatedRange& range)
+{
+    if (range.size == 0)
+    {
+        return;
+    }
+    usedSize_ -= range.size;
+
+    // Merged with the free range ending where it begins and the one
+    // beginning where it ends
+    auto next = std::ranges::upper_bound(freeRanges_,
+                                         range.offset,
+                                         {},
+                                         &AllocatedRange::offset);
+    const bool joinsPrevious
+        = next != freeRanges_.begin()
+       && std::prev(next)->offset + std::prev(next)->size == range.offset;
+    const bool joinsNext = next != freeRanges_.end()
+                        && range.offset + range.size == next->offset;
+    if (joinsPrevious && joinsNext)
+    {
+        std::prev(next)->size += range.size + next->size;
+        freeRanges_.erase(next);
+    }
+    else if (joinsPrevious)
+    {
+        std::prev(next)->size += range.size;
+    }
+    else if (joinsNext)
+    {
+        next->offset = range.offset;
+        next->size += range.size;
+    }
+    else
+    {
+        freeRanges_.insert(next, range);
+    }
+}
+
+void RangeAllocator::grow(size_t capacity)
+{
+    if (capacity <= capacity_)
+    {
+        return;
+    }
+    const AllocatedRange addedRange{
+        .offset = capacity_,
+        .size = capacity - capacity_,
+    };
+    capacity_ = capacity;
+    // Counted as used until released into free ranges
+    usedSize_ += addedRange.size;
+    release(addedRange);
+}
+
+size_t RangeAllocator::largestFreeSize() const
+{
+    size_t largestSize = 0;
+    for (const AllocatedRange& freeRange : freeRanges_)
+    {
+        largestSize = std::max(largestSize, freeRange.size);
+    }
+    return largestSize;
+}
@@ -0,0 +1,47 @@
+#ifndef RANGE_ALLOCATOR_H_
+#define RANGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+/// Contiguous range of elements, like a part of a GPU buffer.
+struct AllocatedRange
+{
+    size_t offset;
+    size_t size;
+};
+
+/// First-fit sub-allocator handing out ranges of a linear space without
+/// touching the memory itself, so that the space can live in a GPU buffer.
+///
+/// Free ranges are kept sorted by offset and merged with neighboring free
+/// ranges on release, so that freed space is reused for ranges of any size
+/// instead of fragmenting into pieces too small to fit.
+class RangeAllocator
+{
+public:
+    RangeAllocator();
+
+    /// Allocate range of given size at the lowest offset it fits. Returns
+    /// nothing when no free range is large enough, in which case the space is
+    /// expected to grow.
+    [[nodiscard]] std::optional<size_t> allocate(size_t size);
+    /// Return range previously allocated for reuse.
+    void release(const AllocatedRange& range);
+    /// Extend space to capacity, adding the difference at the end as free.
+    void grow(size_t capacity);
+
+    [[nodiscard]] size_t capacity() const { return capacity_; }
+    /// Elements covered by allocated ranges.
+    [[nodiscard]] size_t usedSize() const { return usedSize_; }
+    /// Size of the largest range that fits without growing.
+    [[nodiscard]] size_t largestFreeSize() const;
+
+private:
+    std::vector<AllocatedRange> freeRanges_;
+    size_t capacity_;
+    size_t usedSize_;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "recording.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <type_traits>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'R', 'E', 'C', 'D'};
+// Increment on any change of Header, pose or property change layout.
+constexpr uint32_t FORMAT_VERSION = 1;
+
+struct Header
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    /// Size of draw properties, which change whenever a property is added.
+    uint32_t drawPropertiesSize;
+    uint32_t stepCount;
+    uint32_t propertyChangeCount;
+};
+
+// Arrays are written and read as laid out in memory
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(std::is_trivially_copyable_v<DrawProperties>);
+static_assert(std::is_trivially_copyable_v<Recording::Pose>);
+static_assert(std::is_trivially_copyable_v<Recording::PropertyChange>);
+static_assert(std::is_standard_layout_v<Recording::PropertyChange>);
+// Poses are packed without padding, so files of different compilers match
+static_assert(sizeof(Recording::Pose) == 5 * sizeof(float));
+
+/// Copy properties recorded for a step, keeping those affecting frame
+/// pacing.
+void applyProperties(const DrawProperties& recorded, DrawProperties& drawProps)
+{
+    DrawProperties applied = recorded;
+    applied.dynamicResolutionEnabled = drawProps.dynamicResolutionEnabled;
+    applied.resolutionScale = drawProps.resolutionScale;
+    applied.qualityGovernorEnabled = drawProps.qualityGovernorEnabled;
+    applied.targetFrameTime = drawProps.targetFrameTime;
+    applied.onDemandRenderingEnabled = drawProps.onDemandRenderingEnabled;
+    applied.vsyncModeIndex = drawProps.vsyncModeIndex;
+    applied.frameCapEnabled = drawProps.frameCapEnabled;
+    applied.frameCap = drawProps.frameCap;
+    applied.lowLatencyEnabled = drawProps.lowLatencyEnabled;
+    drawProps = applied;
+}
+}  // namespace
+
+std::optional<Recording> Recording::load(const fs::path& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file)
+    {
+        utils::showErrorMessage("unable to open recording ", filePath);
+        return std::nullopt;
+    }
+
+    Header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+    if (!file || header.magic != MAGIC || header.version != FORMAT_VERSION
+        || header.drawPropertiesSize != sizeof(DrawProperties)
+        || header.propertyChangeCount == 0)
+    {
+        utils::showErrorMessage("recording ",
+                                filePath,
+                                " is not supported by this build");
+        return std::nullopt;
+    }
+    Recording recording;
+    recording.poses_.resize(header.stepCount);
+    recording.propertyChanges_.resize(header.propertyChangeCount);
+    file.read(reinterpret_cast<char*>(recording.poses_.data()),
+              static_cast<std::streamsize>(recording.poses_.size()
+                                           * sizeof(Pose)));
+    file.read(reinterpret_cast<char*>(recording.propertyChanges_.data()),
+              static_cast<std::streamsize>(recording.propertyChanges_.size()
+                                           * sizeof(PropertyChange)));
+    if (!file)
+    {
+        utils::showErrorMessage("unable to read recording ", filePath);
+        return std::nullopt;
+    }
+    return recording;
+}
+
+Recording::Recording(const DrawProperties& initialDrawProps)
+{
+    changeProperties(initialDrawProps);
+}
+
+bool Recording::save(const fs::path& filePath) const
+{
+    const Header header{
+        .magic = MAGIC,
+        .version = FORMAT_VERSION,
+        .drawPropertiesSize = sizeof(DrawProperties),
+        .stepCount = static_cast<uint32_t>(poses_.size()),
+        .propertyChangeCount = static_cast<uint32_t>(propertyChanges_.size()),
+    };
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file.write(reinterpret_cast<const char*>(poses_.data()),
+               static_cast<std::streamsize>(poses_.size() * sizeof(Pose)));
+    file.write(reinterpret_cast<const char*>(propertyChanges_.data()),
+               static_cast<std::streamsize>(propertyChanges_.size()
+                                            * sizeof(PropertyChange)));
+    if (!file)
+    {
+        utils::showErrorMessage("unable to write recording ", filePath);
+        return false;
+    }
+    return true;
+}
+
+void Recording::appendStep(const Camera& camera)
+{
+    poses_.push_back(Pose{
+        .position = camera.position(),
+        .rotation = camera.rotation(),
+    });
+}
+
+void Recording::changeProperties(const DrawProperties& drawProps)
+{
+    const auto stepIndex = static_cast<std::uint32_t>(poses_.size());
+    // Several changes before the same step collapse into the latest one
+    if (!propertyChanges_.empty()
+        && propertyChanges_.back().stepIndex == stepIndex)
+    {
+        propertyChanges_.back().drawProps = drawProps;
+        return;
+    }
+    propertyChanges_.push_back(PropertyChange{
+        .stepIndex = stepIndex,
+        .drawProps = drawProps,
+    });
+}
+
+Replay::Replay(Recording recording)
+    : recording_{std::move(recording)}
+    , stepIndex_{0}
+    , changeIndex_{0}
+{
+}
+
+void Replay::nextStep(Camera& camera, DrawProperties& drawProps)
+{
+    const std::vector<Recording::PropertyChange>& changes
+        = recording_.propertyChanges();
+    while (changeIndex_ < changes.size()
+           && changes[changeIndex_].stepIndex <= stepIndex_)
+    {
+        applyProperties(changes[changeIndex_].drawProps, drawProps);
+        ++changeIndex_;
+    }
+
+    const std::vector<Recording::Pose>& poses = recording_.poses();
+    if (poses.empty())
+    {
+        return;
+    }
+    const Recording::Pose& pose
+        = poses[std::min(stepIndex_, poses.size() - 1)];
+    camera = Camera{pose.position, pose.rotation};
+    if (stepIndex_ < poses.size())
+    {
+        ++stepIndex_;
+    }
+}
+
+bool Replay::isFinished() const
+{
+    return stepIndex_ == recording_.poses().size();
+}
@@ -0,0 +1,95 @@
+#ifndef RECORDING_H_
+#define RECORDING_H_
+
+#include "camera.h"
+#include "drawproperties.h"
+
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+/// Camera pose of every simulation step and changes of draw properties made
+/// in between, for drawing the same workload with different builds.
+///
+/// Draw properties changed during a frame take effect from the next step.
+/// Steps are only run while something moves, so time spent idle is not part
+/// of the recording. Files consist of a fixed-size header followed by the
+/// array of poses and the array of property changes, stored as laid out in
+/// memory. Recordings made by builds with different draw properties are
+/// rejected.
+class Recording
+{
+public:
+    struct Pose
+    {
+        glm::vec3 position;
+        /// Yaw and pitch.
+        glm::vec2 rotation;
+    };
+
+    struct PropertyChange
+    {
+        /// Index of first step drawn with the properties.
+        std::uint32_t stepIndex;
+        DrawProperties drawProps;
+    };
+
+    /// Read recording saved by save(). Errors are reported.
+    static std::optional<Recording> load(const std::filesystem::path& filePath);
+
+    /// Empty recording starting with properties set up on launch.
+    explicit Recording(const DrawProperties& initialDrawProps);
+
+    /// Write recording into file. Errors are reported.
+    bool save(const std::filesystem::path& filePath) const;
+
+    /// Record result of the next step.
+    void appendStep(const Camera& camera);
+    /// Record properties that steps recorded from now on are drawn with.
+    void changeProperties(const DrawProperties& drawProps);
+
+    [[nodiscard]] const std::vector<Pose>& poses() const { return poses_; }
+    /// Sorted by step index, starting with properties of the first step.
+    [[nodiscard]] const std::vector<PropertyChange>& propertyChanges() const
+    {
+        return propertyChanges_;
+    }
+
+private:
+    Recording() = default;
+
+    std::vector<Pose> poses_;
+    std::vector<PropertyChange> propertyChanges_;
+};
+
+/// Playback of a recording advancing one step per frame, so that every run
+/// draws the same frames regardless of framerate.
+class Replay
+{
+public:
+    explicit Replay(Recording recording);
+
+    /// Move camera to the next step, applying properties recorded for the
+    /// step onto draw properties. Frame pacing is kept as set up for the run,
+    /// as it affects the frame times being compared. Once finished, the
+    /// camera stays at the last step.
+    void nextStep(Camera& camera, DrawProperties& drawProps);
+
+    [[nodiscard]] bool isFinished() const;
+    [[nodiscard]] size_t stepCount() const
+    {
+        return recording_.poses().size();
+    }
+
+private:
+    Recording recording_;
+    size_t stepIndex_;
+    size_t changeIndex_;
+};
+
+#endif
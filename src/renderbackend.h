@@ -0,0 +1,67 @@
+#ifndef RENDER_BACKEND_H_
+#define RENDER_BACKEND_H_
+
+#include "glm/mat4x4.hpp"
+
+#include <cstdint>
+#include <span>
+
+class Model;
+class PointCloud;
+class Skybox;
+class SpatialIndex;
+struct PointLight;
+
+/// Draw interface of a frame of the scene, independent of the graphics API
+/// drawing it. Scene is drawn between prepareDraw() and finishDraw(), draws in
+/// between are submitted or recorded as the backend sees fit.
+///
+/// Renderer is the OpenGL and OpenGL ES implementation, and documents the
+/// behavior of each draw in detail. Models, skyboxes and point clouds are
+/// still created as OpenGL objects, so another backend has to take over their
+/// creation as well. Draws specific to one API, like multi-draw indirect, stay
+/// on the backend offering them.
+class RenderBackend
+{
+public:
+    RenderBackend() = default;
+    RenderBackend(const RenderBackend&) = delete;
+    RenderBackend& operator=(const RenderBackend&) = delete;
+    RenderBackend(RenderBackend&&) = delete;
+    RenderBackend& operator=(RenderBackend&&) = delete;
+    virtual ~RenderBackend() = default;
+
+    /// Point and spot lights shading the next frame, in addition to the
+    /// directional light. Lights have to stay alive until prepareDraw().
+    virtual void setLights(std::span<const PointLight> lights) = 0;
+    /// Begin frame, clearing the scene drawn into.
+    virtual void prepareDraw() = 0;
+    /// Draw depth of copies of model into the shadow map, cached while the
+    /// caster generation stays the same.
+    virtual void drawShadowCasters(const Model& model,
+                                   std::span<const glm::mat4> worldMatrices,
+                                   std::uint64_t casterGeneration)
+        = 0;
+    /// Draw copies of model with separate draws, one per world matrix.
+    virtual void drawModel(const Model& model,
+                           std::span<const glm::mat4> worldMatrices,
+                           const SpatialIndex* spatialIndex = nullptr)
+        = 0;
+    /// Draw copies of model with a single draw per sub-mesh, one copy per
+    /// world matrix.
+    virtual void drawModelInstanced(const Model& model,
+                                    std::span<const glm::mat4> worldMatrices,
+                                    const SpatialIndex* spatialIndex = nullptr)
+        = 0;
+    /// Draw copies of point cloud, one per world matrix.
+    virtual void drawPointCloud(const PointCloud& pointCloud,
+                                std::span<const glm::mat4> worldMatrices)
+        = 0;
+    /// Draw skybox behind everything drawn into the scene.
+    virtual void drawSkybox(const Skybox& skybox) = 0;
+    /// Post-process scene drawn since prepareDraw() into the window, leaving
+    /// it bound for UI to be drawn on top.
+    virtual void finishDraw() = 0;
+};
+
+#endif
@@ -1,33 +1,296 @@
 #include "renderer.h"
 
 #include "camera.h"
+#include "clusterlod.h"
 #include "drawproperties.h"
+#include "frameallocator.h"
+#include "lod.h"
 #include "model.h"
+#include "pointcloud.h"
+#include "profiler.h"
+#include "radixsort.h"
 #include "shader.h"
 #include "skybox.h"
+#include "threadpool.h"
+#include "transformbatch.h"
 #include "utils.h"
+#include "vertexformat.h"
+#include "videomemory.h"
 
 #include "glm/glm.hpp"
-#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/matrix_transform.hpp"
 
 #ifdef __EMSCRIPTEN__
 #include "glad/gles2.h"
 
 #include <GLFW/glfw3.h>  // Use GLFW port from Emscripten
+#include <emscripten/html5.h>
 #else
+#include "editablemesh.h"
+
 #include "GLFW/glfw3.h"
 #include "glad/gl.h"
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <filesystem>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <span>
 
 namespace fs = std::filesystem;
 
-Renderer::Renderer(const DrawProperties& drawProps, const Camera& camera)
+namespace
+{
+/// First of the four attribute locations taken by the per-instance world
+/// matrix in the instanced model shader, following the vertex attributes.
+constexpr GLuint WORLD_MATRIX_LOCATION = VERTEX_ATTRIBUTE_COUNT;
+/// Attribute location of per-instance copy index in the instanced model
+/// shader, numbering instances as objects for picking.
+constexpr GLuint COPY_INDEX_LOCATION = WORLD_MATRIX_LOCATION + 4;
+/// Texture unit the shadow map is bound to while drawing models. Skybox takes
+/// the first one.
+constexpr GLuint SHADOW_MAP_TEXTURE_UNIT = 1;
+/// Texture unit the texture array of model materials is bound to while
+/// drawing models.
+constexpr GLuint MATERIAL_TEXTURE_UNIT = 5;
+/// Slope-scaled and constant depth offset of shadow casters, keeping lit
+/// surfaces from shadowing themselves.
+constexpr float SHADOW_SLOPE_BIAS = 2.0F;
+constexpr float SHADOW_CONSTANT_BIAS = 4.0F;
+/// Uniform buffer binding points of per-frame and per-object uniform blocks
+/// of model shaders.
+constexpr GLuint FRAME_DATA_BINDING = 0;
+constexpr GLuint OBJECT_DATA_BINDING = 1;
+/// Uniforms, instance transforms and draw commands written in a frame before
+/// the stream buffer has to grow.
+constexpr GLsizeiptr STREAM_BUFFER_CAPACITY = 1024 * 1024;
+/// Instances frustum tested by a single thread pool task. Smaller ranges cost
+/// more in scheduling than they gain in parallelism.
+constexpr size_t CULLING_BATCH_SIZE = 2048;
+/// Copies whose draws are recorded by a single thread pool task into a
+/// command buffer of their own.
+constexpr size_t RECORDING_BATCH_SIZE = 256;
+/// Clipping planes of the projection.
+constexpr float NEAR_PLANE = 0.1F;
+constexpr float FAR_PLANE = 100.0F;
+/// Smallest fraction of window resolution the scene is drawn at.
+constexpr float MIN_RESOLUTION_SCALE = 0.25F;
+/// Points drawn per covered pixel by distant copies of point clouds. More
+/// than one, as shuffled points do not cover pixels evenly.
+constexpr float POINTS_PER_PIXEL = 2.0F;
+/// Fewest points a visible copy of a point cloud is drawn with.
+constexpr GLsizei MIN_POINT_COUNT = 4096;
+/// Distance of orthographic views from the origin they look at, half of
+/// their depth range.
+constexpr float ORTHOGRAPHIC_DISTANCE = FAR_PLANE * 0.5F;
+/// Distance between eyes of stereo rendering, a typical interpupillary
+/// distance in meters.
+constexpr float EYE_SEPARATION = 0.064F;
+
+/// Samples per pixel of the scene framebuffer, and the post-processing pass
+/// smoothing edges instead.
+struct AntialiasingMode
+{
+    int sampleCount;
+    Renderer::AntialiasingFilter filter;
+};
+
+/// Antialiasing modes in the order of the UI.
+constexpr std::array ANTIALIASING_MODES{
+    AntialiasingMode{.sampleCount = 1,
+                     .filter = Renderer::AntialiasingFilter::None},
+    AntialiasingMode{.sampleCount = 1,
+                     .filter = Renderer::AntialiasingFilter::Fxaa},
+    AntialiasingMode{.sampleCount = 1,
+                     .filter = Renderer::AntialiasingFilter::Temporal},
+    AntialiasingMode{.sampleCount = 2,
+                     .filter = Renderer::AntialiasingFilter::None},
+    AntialiasingMode{.sampleCount = 4,
+                     .filter = Renderer::AntialiasingFilter::None},
+    AntialiasingMode{.sampleCount = 8,
+                     .filter = Renderer::AntialiasingFilter::None},
+};
+#ifndef __EMSCRIPTEN__
+/// Dynamic resolution scale is rounded to multiples of this, so that scene
+/// viewport and depth pyramid change size only occasionally.
+constexpr float RESOLUTION_SCALE_STEP = 0.05F;
+/// Weight of the latest frame in scene times compared between shading rates.
+constexpr float SHADING_RATE_TIME_WEIGHT = 0.05F;
+/// Fraction of the way dynamic resolution scale moves towards the scale
+/// estimated to meet target GPU time in a frame. Timer results lag a few
+/// frames behind, so approaching gradually avoids oscillation.
+constexpr float RESOLUTION_SCALE_RATE = 0.1F;
+#endif
+#ifndef __EMSCRIPTEN__
+/// Attribute location of per-draw data index in the indirect model shader.
+constexpr GLuint DRAW_ID_LOCATION = VERTEX_ATTRIBUTE_COUNT;
+/// Shader storage buffer binding of per-draw data in the indirect model
+/// shader.
+constexpr GLuint DRAW_DATA_BINDING = 0;
+/// Geometry shader inserted between every model shader and fragment shader
+/// of wireframe variants.
+constexpr const char* WIREFRAME_GEOMETRY_SHADER_PATH
+    = "assets/shaders/wireframe_gl4.geom.glsl";
+/// Copies whose transforms and visibility are computed by a single thread
+/// pool task.
+constexpr size_t TRANSFORM_BATCH_SIZE = 1024;
+/// Shader storage buffer binding of the material table of sub-meshes in the
+/// indirect model shader.
+constexpr GLuint MATERIAL_TABLE_BINDING = 6;
+#endif
+
+/// Whether all sub-meshes of model share the same material, so that the
+/// model is drawn with a single color, opacity and texture layer.
+bool hasUniformMaterial(const Model& model)
+{
+    return std::ranges::all_of(
+        model.submeshes,
+        [&](const Submesh& submesh)
+        {
+            const Submesh& first = model.submeshes.front();
+            return submesh.baseColor == first.baseColor
+                && submesh.opacity == first.opacity
+                && submesh.textureLayer == first.textureLayer;
+        });
+}
+
+/// Base color of a model of uniform material, white for models without
+/// sub-meshes.
+glm::vec3 getBaseColor(const Model& model)
+{
+    return model.submeshes.empty() ? glm::vec3{1.0F}
+                                   : model.submeshes.front().baseColor;
+}
+
+/// Opacity of a model of uniform material, opaque for models without
+/// sub-meshes.
+float getOpacity(const Model& model)
+{
+    return model.submeshes.empty() ? 1.0F : model.submeshes.front().opacity;
+}
+
+/// Texture layer of a model of uniform material, untextured for models
+/// without sub-meshes.
+std::int32_t getTextureLayer(const Model& model)
+{
+    return model.submeshes.empty() ? NO_TEXTURE_LAYER
+                                   : model.submeshes.front().textureLayer;
+}
+
+/// Radius in pixels of sphere projected by view projection into viewport of
+/// given height, unbounded for spheres behind the camera. Perspective and
+/// orthographic projections are handled alike through clip space w.
+float getScreenRadius(const BoundingSphere& sphere,
+                      const glm::mat4& viewProjection,
+                      int viewportHeight)
+{
+    const float w = viewProjection[0][3] * sphere.center.x
+                  + viewProjection[1][3] * sphere.center.y
+                  + viewProjection[2][3] * sphere.center.z
+                  + viewProjection[3][3];
+    if (w <= 0.0F)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+    // Vertical scale of the projection, as view matrices do not scale
+    const float scale = glm::length(glm::vec3{viewProjection[0][1],
+                                              viewProjection[1][1],
+                                              viewProjection[2][1]});
+    return sphere.radius * scale / w * static_cast<float>(viewportHeight)
+         * 0.5F;
+}
+
+/// Whether any sub-mesh of model has a transparent material.
+bool hasTransparentMaterial(const Model& model)
+{
+    return std::ranges::any_of(model.submeshes,
+                               [](const Submesh& submesh)
+                               { return submesh.opacity < 1.0F; });
+}
+}  // namespace
+
+Renderer::Renderer(const DrawProperties& drawProps,
+                   const Camera& camera,
+                   ThreadPool& threadPool,
+                   FrameAllocator& frameAllocator)
     : window_{nullptr}
+    , frameBufferWidth_{0}
+    , frameBufferHeight_{0}
+    , sceneWidth_{0}
+    , sceneHeight_{0}
+    , resolutionScale_{1.0F}
+#ifndef __EMSCRIPTEN__
+    , dynamicResolutionScale_{1.0F}
+    , shadingRateActive_{false}
+    , shadingRateTimes_{}
+#endif
+    , frameStatistics_{}
+    , frameStartStateChangeCount_{0}
+    , nextObjectId_{1}
+#ifndef __EMSCRIPTEN__
+    , pickedObjectId_{0}
+#endif
+    , transparencyActive_{false}
+    , multiviewSupported_{false}
+    , stereoActive_{false}
+    , stereoComposed_{false}
+    , antialiasingFilter_{AntialiasingFilter::None}
+    , previousViewProjection_{1.0F}
+    , temporalReprojection_{1.0F}
+    , maxSampleCount_{1}
+#ifndef __EMSCRIPTEN__
+    , maxIntegerSampleCount_{1}
+#endif
+    , frameUniforms_{}
+    , frameUniformsRange_{}
+    , projection_{1.0F}
+    , projectionDirty_{true}
+    , projectionFovGeneration_{0}
+    , projectionStereo_{false}
+    , frameView_{FrameView::create(camera, projection_)}
+    , viewProjection_{1.0F}
+    , frustum_{Frustum::fromMatrix(viewProjection_)}
+    , lodProjectionScale_{1.0F}
+    , views_{}
+    , viewCount_{1}
+    , commandBufferCount_{0}
+    , streamBuffer_{STREAM_BUFFER_CAPACITY}
+    , uniformBufferAlignment_{1}
+#ifndef __EMSCRIPTEN__
+    , clusterStreamer_{threadPool}
+    , storageBufferAlignment_{1}
+    , drawIdBuffer_{0}
+    , drawIdCount_{0}
+#endif
+    , emptyVertexArray_{0}
+    , whiteTextureArray_{0}
     , drawProps_(drawProps)
     , camera_(camera)
+    , threadPool_(threadPool)
+    , frameAllocator_(frameAllocator)
+{
+}
+
+Renderer::~Renderer()
 {
+#ifndef __EMSCRIPTEN__
+    videomemory::release(videomemory::Category::DrawData,
+                         static_cast<size_t>(drawIdCount_) * sizeof(GLuint));
+    glDeleteBuffers(1, &drawIdBuffer_);
+    for (GLsync fence : frameFences_)
+    {
+        glDeleteSync(fence);
+    }
+#endif
+    glDeleteVertexArrays(1, &emptyVertexArray_);
+    glDeleteTextures(1, &whiteTextureArray_);
 }
 
 bool Renderer::init(GLFWwindow* window)
@@ -42,178 +305,2993 @@ bool Renderer::init(GLFWwindow* window)
         utils::showErrorMessage("unable to load OpenGL extensions");
         return false;
     }
+    // Passes are left unmeasured without timer queries
+    gpuProfiler_.init();
+#ifdef __EMSCRIPTEN__
+    // Floating point color is renderable in WebGL 2 only with
+    // EXT_color_buffer_float, without which the scene is drawn in low dynamic
+    // range and only tonemapped
+    if (!emscripten_webgl_enable_extension(
+            emscripten_webgl_get_current_context(),
+            "EXT_color_buffer_float"))
+    {
+        sceneTarget_.setColorFormat(GL_RGBA8);
+    }
+    // Both eyes of stereo rendering are drawn in a single pass where
+    // available, stereo rendering is not offered otherwise
+    multiviewSupported_ = GLAD_GL_OVR_multiview2
+                       && emscripten_webgl_enable_extension(
+                           emscripten_webgl_get_current_context(),
+                           "OVR_multiview2");
+#else
+    multiviewSupported_ = GLAD_GL_OVR_multiview2 != 0;
+#endif
 
     // Load shaders
 #ifdef __EMSCRIPTEN__
     const fs::path modelVertexShaderPath(
         "assets/shaders/model_gles3.vert.glsl");
+    const fs::path instancedModelVertexShaderPath(
+        "assets/shaders/model_instanced_gles3.vert.glsl");
     const fs::path modelFragmentShaderPath(
         "assets/shaders/model_gles3.frag.glsl");
+    const fs::path depthFragmentShaderPath(
+        "assets/shaders/depth_gles3.frag.glsl");
     const fs::path skyboxVertexShaderPath(
         "assets/shaders/skybox_gles3.vert.glsl");
     const fs::path skyboxFragmentShaderPath(
         "assets/shaders/skybox_gles3.frag.glsl");
 #else
     const fs::path modelVertexShaderPath("assets/shaders/model_gl4.vert.glsl");
+    const fs::path instancedModelVertexShaderPath(
+        "assets/shaders/model_instanced_gl4.vert.glsl");
+    const fs::path indirectModelVertexShaderPath(
+        "assets/shaders/model_indirect_gl4.vert.glsl");
     const fs::path modelFragmentShaderPath(
         "assets/shaders/model_gl4.frag.glsl");
+    const fs::path depthFragmentShaderPath(
+        "assets/shaders/depth_gl4.frag.glsl");
     const fs::path skyboxVertexShaderPath(
         "assets/shaders/skybox_gl4.vert.glsl");
     const fs::path skyboxFragmentShaderPath(
         "assets/shaders/skybox_gl4.frag.glsl");
 #endif
-    std::optional<Shader> modelShader
-        = Shader::createFromFile(modelVertexShaderPath,
-                                 modelFragmentShaderPath);
-    if (!modelShader)
+    // Every program is submitted before any of them is waited on, so that
+    // drivers supporting parallel compilation compile them at once
+    Shader::enableParallelCompilation();
+    submitShader(skyboxVertexShaderPath, skyboxFragmentShaderPath);
+    // Instanced and indirect variants share fragment shader with regular
+    // model shader. Multiview variants are instanced ones drawing both eyes,
+    // compiled without the extension where it is missing, keeping their
+    // place in the shader list.
+    const std::array modelVertexShaderPaths{
+        modelVertexShaderPath,
+        instancedModelVertexShaderPath,
+        instancedModelVertexShaderPath,
+#ifndef __EMSCRIPTEN__
+        indirectModelVertexShaderPath,
+#endif
+    };
+    constexpr size_t multiviewShaderIndex
+        = static_cast<size_t>(ShaderInstance::MultiviewModelShader)
+        - static_cast<size_t>(ShaderInstance::ModelShader);
+    constexpr std::array<const char*, 1> multiviewDefines{
+        "MULTIVIEW_ENABLED"};
+    const auto getModelShaderDefines = [&](size_t modelShaderIndex)
     {
-        return false;
+        return modelShaderIndex == multiviewShaderIndex && multiviewSupported_
+                 ? std::span<const char* const>{multiviewDefines}
+                 : std::span<const char* const>{};
+    };
+    for (size_t i = 0; i < modelVertexShaderPaths.size(); ++i)
+    {
+#ifdef __EMSCRIPTEN__
+        constexpr bool wireframeSupported = true;
+#else
+        // Geometry shaders can not be combined with multiview
+        const bool wireframeSupported = i != multiviewShaderIndex;
+#endif
+        submitShadingVariants(modelVertexShaderPaths[i],
+                              modelFragmentShaderPath,
+                              getModelShaderDefines(i),
+                              wireframeSupported);
     }
-
-    std::optional<Shader> skyboxShader
-        = Shader::createFromFile(skyboxVertexShaderPath,
-                                 skyboxFragmentShaderPath);
-    if (!skyboxShader)
+    // Depth prepass programs pair the same vertex shaders with a fragment
+    // shader doing nothing
+    for (size_t i = 0; i < modelVertexShaderPaths.size(); ++i)
     {
-        return false;
+        submitShader(modelVertexShaderPaths[i],
+                     depthFragmentShaderPath,
+                     getModelShaderDefines(i));
     }
-    shaders_.reserve(2);
-    shaders_.emplace_back(std::move(modelShader.value()));
-    shaders_.emplace_back(std::move(skyboxShader.value()));
+    pendingAmbientOcclusionShaders_ = AmbientOcclusion::submitShaders();
+    pendingTemporalUpscalerShader_ = TemporalUpscaler::submitShader();
+    pendingBloomShaders_ = Bloom::submitShaders();
+    pendingTonemapperShaders_ = Tonemapper::submitShaders();
+    pendingUiOverlayShader_ = UiOverlay::submitShader();
+    pendingPointRendererShaders_ = PointRenderer::submitShaders();
+    pendingStereoShader_ = StereoTarget::submitShader();
+    pendingTransparencyShader_ = TransparencyTarget::submitShader();
+    pendingImpostorShaders_ = ImpostorRenderer::submitShaders();
+#ifndef __EMSCRIPTEN__
+    pendingCullerShaders_ = GpuCuller::submitShaders();
+    pendingInstanceBufferShader_ = InstanceBuffer::submitShader();
+    pendingLightClusterShader_ = LightClusters::submitShader();
+    pendingShadingRateShader_ = ShadingRateImage::submitShader();
+    pendingVirtualSkyboxShaders_ = VirtualSkybox::submitShaders();
+    pendingGeometryArenaShader_ = GeometryArena::submitShader();
+
+    glGenBuffers(1, &drawIdBuffer_);
+#endif
+    glGenVertexArrays(1, &emptyVertexArray_);
+    constexpr std::array<GLubyte, 4> WHITE_TEXEL{255, 255, 255, 255};
+    glGenTextures(1, &whiteTextureArray_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, whiteTextureArray_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_SRGB8_ALPHA8, 1, 1, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                    0,
+                    0,
+                    0,
+                    0,
+                    1,
+                    1,
+                    1,
+                    GL_RGBA,
+                    GL_UNSIGNED_BYTE,
+                    WHITE_TEXEL.data());
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     // Customize OpenGL capabilities
     glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+#ifndef __EMSCRIPTEN__
+    // Filtering across cube-map face edges, so that seams do not show on
+    // smaller mip levels of skybox. Always enabled in OpenGL ES 3.0.
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+#endif
+    // Opaque geometry is drawn without blending, paying no read of the
+    // framebuffer per fragment. Passes blending their output enable it
+    // themselves and disable it again when done.
+    glState_.setBlendEnabled(false);
 
     window_ = window;
+    // Later size changes are received through resize()
+    glfwGetFramebufferSize(window_, &frameBufferWidth_, &frameBufferHeight_);
 
     return true;
 }
 
-void Renderer::prepareDraw()
+void Renderer::submitShadingVariants(const fs::path& vertexShaderPath,
+                                     const fs::path& fragmentShaderPath,
+                                     std::span<const char* const> defines,
+                                     bool wireframeSupported)
 {
-    // Viewport setup
-    int frameBufferWidth, frameBufferHeight;
-    glfwGetFramebufferSize(window_, &frameBufferWidth, &frameBufferHeight);
-    glViewport(0, 0, frameBufferWidth, frameBufferHeight);
-    projection_ = glm::perspective(glm::radians(drawProps_.fov),
-                                   static_cast<float>(frameBufferWidth)
-                                       / static_cast<float>(frameBufferHeight),
-                                   0.1F,
-                                   100.0F);
-
-    // Clear screen
-    glClearColor(drawProps_.backgroundColor[0],
-                 drawProps_.backgroundColor[1],
-                 drawProps_.backgroundColor[2],
-                 1.0F);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Lighting terms and wireframe overlay are compiled in or out of each
+    // variant, instead of branching on them for every fragment. The overdraw
+    // variant shades nothing.
+    for (size_t variant = 0; variant < SHADING_VARIANT_COUNT; ++variant)
+    {
+        std::array<const char*, 4> variantDefines{};
+        size_t defineCount = 0;
+        for (const char* define : defines)
+        {
+            variantDefines[defineCount++] = define;
+        }
+        if (variant == OVERDRAW_VARIANT)
+        {
+            variantDefines[defineCount++] = "OVERDRAW_ENABLED";
+            submitShader(vertexShaderPath,
+                         fragmentShaderPath,
+                         std::span{variantDefines}.first(defineCount));
+            continue;
+        }
+        if (variant & 1U)
+        {
+            variantDefines[defineCount++] = "DIFFUSE_ENABLED";
+        }
+        if (variant & 2U)
+        {
+            variantDefines[defineCount++] = "SPECULAR_ENABLED";
+        }
+        const bool wireframe = wireframeSupported && (variant & 4U) != 0;
+        if (wireframe)
+        {
+            variantDefines[defineCount++] = "WIREFRAME_ENABLED";
+        }
+        submitShader(vertexShaderPath,
+                     fragmentShaderPath,
+                     std::span{variantDefines}.first(defineCount),
+                     wireframe);
+    }
 }
 
-void Renderer::drawModel(const Model& model)
+void Renderer::submitShader(const fs::path& vertexShaderPath,
+                            const fs::path& fragmentShaderPath,
+                            std::span<const char* const> defines,
+                            bool wireframe)
 {
-    // Set model draw shader
-    auto& shader
-        = shaders_[static_cast<std::uint8_t>(ShaderInstance::ModelShader)];
-    shader.use();
-    // Set vertex input
-    glBindVertexArray(model.vertexArray);
+#ifdef __EMSCRIPTEN__
+    // Barycentric coordinates come from vertex order of non-indexed draws
+    // instead of a geometry shader
+    (void)wireframe;
+    pendingShaders_.emplace_back(
+        Shader::submitFromFile(vertexShaderPath, fragmentShaderPath, defines));
+#else
+    ShaderSource source{
+        .vertexShaderPath = vertexShaderPath,
+        .geometryShaderPath = wireframe
+                                ? fs::path{WIREFRAME_GEOMETRY_SHADER_PATH}
+                                : fs::path{},
+        .fragmentShaderPath = fragmentShaderPath,
+        .defines = {defines.begin(), defines.end()},
+    };
+    pendingShaders_.emplace_back(submitShaderSource(source));
+    shaderSources_.push_back(std::move(source));
+#endif
+}
 
-    // Model transform
-    // Avoid Gimbal-lock by converting Euler angles to quaternions
-    const glm::quat quatX
-        = glm::angleAxis(glm::radians(drawProps_.modelRotation[0]),
-                         glm::vec3(1.0F, 0.0F, 0.0F));
-    const glm::quat quatY
-        = glm::angleAxis(glm::radians(drawProps_.modelRotation[1]),
-                         glm::vec3(0.0F, 1.0F, 0.0F));
-    const glm::quat quatZ
-        = glm::angleAxis(glm::radians(drawProps_.modelRotation[2]),
-                         glm::vec3(0.0F, 0.0F, 1.0F));
-    const glm::quat quat = quatZ * quatY * quatX;
-    const auto modelMatrix = glm::mat4_cast(quat);
+#ifndef __EMSCRIPTEN__
+PendingShader Renderer::submitShaderSource(const ShaderSource& source)
+{
+    if (source.geometryShaderPath.empty())
+    {
+        return Shader::submitFromFile(source.vertexShaderPath,
+                                      source.fragmentShaderPath,
+                                      source.defines);
+    }
+    return Shader::submitWithGeometryFromFile(source.vertexShaderPath,
+                                              source.geometryShaderPath,
+                                              source.fragmentShaderPath,
+                                              source.defines);
+}
+#endif
 
-    // Concat matrix transformations on CPU to avoid unnecessary multiplications
-    // in GLSL. Results would be the same for all vertices.
-    const glm::mat4 view = camera_.calculateViewMatrix();
-    const glm::mat4 mvp = projection_ * view * modelMatrix;
-    const glm::mat3 normalMatrix
-        = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
+bool Renderer::finishInit()
+{
+    // Shaders of failed compilation have their errors reported by finish()
+    shaders_.reserve(pendingShaders_.size());
+    for (PendingShader& pendingShader : pendingShaders_)
+    {
+        std::optional<Shader> shader = pendingShader.finish();
+        if (!shader)
+        {
+            return false;
+        }
+        shaders_.emplace_back(std::move(shader.value()));
+    }
+    pendingShaders_.clear();
+#ifndef __EMSCRIPTEN__
+    gpuCuller_ = GpuCuller::create(std::move(pendingCullerShaders_.value()));
+    pendingCullerShaders_.reset();
+    if (!gpuCuller_)
+    {
+        return false;
+    }
+    const bool instanceBufferReady = instanceBuffer_.init(
+        std::move(pendingInstanceBufferShader_.value()));
+    pendingInstanceBufferShader_.reset();
+    if (!instanceBufferReady)
+    {
+        return false;
+    }
+    const bool lightClustersReady
+        = lightClusters_.init(std::move(pendingLightClusterShader_.value()));
+    pendingLightClusterShader_.reset();
+    const bool virtualSkyboxReady = virtualSkybox_.init(
+        std::move(pendingVirtualSkyboxShaders_.value()));
+    pendingVirtualSkyboxShaders_.reset();
+    if (!virtualSkyboxReady)
+    {
+        return false;
+    }
+    const bool shadingRateImageReady = shadingRateImage_.init(
+        std::move(pendingShadingRateShader_.value()));
+    pendingShadingRateShader_.reset();
+    if (!shadingRateImageReady)
+    {
+        return false;
+    }
+    // Encoded geometry is still decoded on the CPU without the shader
+    if (!geometryArena_.init(std::move(pendingGeometryArenaShader_.value())))
+    {
+        utils::logWarning("geometry arena decodes meshes on the CPU");
+    }
+    pendingGeometryArenaShader_.reset();
+#else
+    const bool lightClustersReady = lightClusters_.init();
+#endif
+    if (!lightClustersReady)
+    {
+        return false;
+    }
+    const bool ambientOcclusionReady = ambientOcclusion_.init(
+        std::move(pendingAmbientOcclusionShaders_.value()));
+    pendingAmbientOcclusionShaders_.reset();
+    if (!ambientOcclusionReady)
+    {
+        return false;
+    }
+    const bool temporalUpscalerReady = temporalUpscaler_.init(
+        std::move(pendingTemporalUpscalerShader_.value()));
+    pendingTemporalUpscalerShader_.reset();
+    if (!temporalUpscalerReady)
+    {
+        return false;
+    }
+    const bool bloomReady
+        = bloom_.init(std::move(pendingBloomShaders_.value()));
+    pendingBloomShaders_.reset();
+    if (!bloomReady)
+    {
+        return false;
+    }
+    const bool tonemapperReady
+        = tonemapper_.init(std::move(pendingTonemapperShaders_));
+    pendingTonemapperShaders_.clear();
+    if (!tonemapperReady)
+    {
+        return false;
+    }
+    const bool uiOverlayReady
+        = uiOverlay_.init(std::move(pendingUiOverlayShader_.value()));
+    pendingUiOverlayShader_.reset();
+    if (!uiOverlayReady)
+    {
+        return false;
+    }
+    const bool pointRendererReady = pointRenderer_.init(
+        std::move(pendingPointRendererShaders_.value()));
+    pendingPointRendererShaders_.reset();
+    if (!pointRendererReady)
+    {
+        return false;
+    }
+    const bool stereoTargetReady
+        = stereoTarget_.init(std::move(pendingStereoShader_.value()));
+    pendingStereoShader_.reset();
+    if (!stereoTargetReady)
+    {
+        return false;
+    }
+    const bool transparencyTargetReady = transparencyTarget_.init(
+        std::move(pendingTransparencyShader_.value()));
+    pendingTransparencyShader_.reset();
+    if (!transparencyTargetReady)
+    {
+        return false;
+    }
+    const bool impostorRendererReady
+        = impostorRenderer_.init(std::move(pendingImpostorShaders_.value()),
+                                 FRAME_DATA_BINDING,
+                                 glState_);
+    pendingImpostorShaders_.reset();
+    if (!impostorRendererReady)
+    {
+        return false;
+    }
 
-    // Transfer uniforms
-    shader.setUniform("u_model", modelMatrix);
-    shader.setUniform("u_mvp", mvp);
-    shader.setUniform("u_normalMatrix", normalMatrix);
-    shader.setUniform("u_color", drawProps_.modelColor);
-    shader.setUniform("u_light.direction", drawProps_.lightDirection);
-    shader.setUniform("u_viewPos", camera_.position());
+    for (size_t i = 0; i < shaders_.size(); ++i)
+    {
+        setupShader(i);
+    }
+    // Ranges of the stream buffer bound as uniform blocks and storage
+    // buffers need to start at the alignment required by the driver
+    GLint uniformBufferAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
+    uniformBufferAlignment_ = static_cast<GLsizeiptr>(uniformBufferAlignment);
+#ifndef __EMSCRIPTEN__
+    GLint storageBufferAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT,
+                  &storageBufferAlignment);
+    storageBufferAlignment_ = static_cast<GLsizeiptr>(storageBufferAlignment);
+#endif
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSampleCount_);
+#ifndef __EMSCRIPTEN__
+    glGetIntegerv(GL_MAX_INTEGER_SAMPLES, &maxIntegerSampleCount_);
+#endif
+
+    return true;
+}
+
+void Renderer::setupShader(size_t shaderIndex)
+{
+    // Uniform locations are resolved once, uniform updates of the rendering
+    // loop go through handles
+    Shader& shader = shaders_[shaderIndex];
+    if (shaderIndex == 0)
+    {
+        skyboxInverseProjectionView_
+            = shader.getUniformHandle<glm::mat4>("u_inverseProjectionView");
+        skyboxTexture_ = shader.getUniformHandle<int>("u_skyboxTexture");
+    }
+    // Uniform blocks are shared by all model shaders. Block bindings of
+    // shaders without them are skipped.
+    shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    shader.bindUniformBlock("ObjectData", OBJECT_DATA_BINDING);
+    // Shadow map stays on its own texture unit, so the sampler is only set
+    // once
+    shader.use(glState_);
+    shader.setUniform(shader.getUniformHandle<int>("u_shadowMap"),
+                      static_cast<int>(SHADOW_MAP_TEXTURE_UNIT));
+    shader.setUniform(shader.getUniformHandle<int>("u_ambientOcclusion"),
+                      static_cast<int>(AmbientOcclusion::TEXTURE_UNIT));
+    shader.setUniform(shader.getUniformHandle<int>("u_materialTextures"),
+                      static_cast<int>(MATERIAL_TEXTURE_UNIT));
 #ifdef __EMSCRIPTEN__
-    // GLSL subroutines are not supported in OpenGL ES 3.0
-    shader.setUniform("u_adsProps.diffuseEnabled", drawProps_.diffuseEnabled);
-    shader.setUniform("u_adsProps.specularEnabled", drawProps_.specularEnabled);
-#else
-    shader.updateSubroutines(
-        GL_FRAGMENT_SHADER,
-        {drawProps_.diffuseEnabled ? "DiffuseEnabled" : "Disabled",
-         drawProps_.specularEnabled ? "SpecularEnabled" : "Disabled"});
-    // glPolygonMode is not supported in OpenGL ES 3.0
-    glPolygonMode(GL_FRONT_AND_BACK,
-                  drawProps_.wireframeModeEnabled ? GL_LINE : GL_FILL);
+    shader.setUniform(shader.getUniformHandle<int>("u_lights"),
+                      static_cast<int>(LightClusters::LIGHT_TEXTURE_UNIT));
+    shader.setUniform(shader.getUniformHandle<int>("u_clusterLights"),
+                      static_cast<int>(LightClusters::CLUSTER_TEXTURE_UNIT));
 #endif
+}
 
-    // Issue draw call
-    glDrawElements(GL_TRIANGLES,
-                   static_cast<GLsizei>(model.indices.size()),
-                   GL_UNSIGNED_INT,
-                   nullptr);
+#ifndef __EMSCRIPTEN__
+void Renderer::reloadShaders(std::span<const fs::path> changedFiles)
+{
+    PROFILE_SCOPE("Renderer::reloadShaders");
+    for (const fs::path& changedFile : changedFiles)
+    {
+        Shader::overrideEmbeddedSource(changedFile);
+        for (size_t i = 0; i < shaderSources_.size(); ++i)
+        {
+            const ShaderSource& source = shaderSources_[i];
+            if (changedFile != source.vertexShaderPath
+                && changedFile != source.geometryShaderPath
+                && changedFile != source.fragmentShaderPath)
+            {
+                continue;
+            }
+            // Recompilation still in progress is superseded by the newer
+            // sources
+            std::erase_if(reloadingShaders_,
+                          [i](const ReloadingShader& reloading)
+                          { return reloading.shaderIndex == i; });
+            reloadingShaders_.push_back(ReloadingShader{
+                .shaderIndex = i,
+                .pendingShader = submitShaderSource(source),
+            });
+        }
+    }
 
-    // Reset state
+    // Programs are polled instead of waited on, so that frames keep being
+    // drawn with the previous shaders while the driver compiles
+    std::erase_if(
+        reloadingShaders_,
+        [this](ReloadingShader& reloading)
+        {
+            if (!reloading.pendingShader.isReady())
+            {
+                return false;
+            }
+            // Errors are reported by finish()
+            std::optional<Shader> shader = reloading.pendingShader.finish();
+            if (shader)
+            {
+                shaders_[reloading.shaderIndex] = std::move(shader.value());
+                setupShader(reloading.shaderIndex);
+            }
+            return true;
+        });
+}
+#endif
+
+void Renderer::resize(int frameBufferWidth, int frameBufferHeight)
+{
+    frameBufferWidth_ = frameBufferWidth;
+    frameBufferHeight_ = frameBufferHeight;
+    projectionDirty_ = true;
+    // Transients of the previous size would keep being handed out while
+    // they fit. Bindings are invalidated when the next frame is prepared.
+    frameGraph_.releasePool();
+}
+
+void Renderer::prepareDraw()
+{
+    PROFILE_SCOPE("Renderer::prepareDraw");
+    // Created on first use, keeping its memory free while shadows are off
+    if (drawProps_.shadowsEnabled
+        && !shadowMap_.create(static_cast<GLsizei>(drawProps_.shadowMapSize)))
+    {
+        utils::logWarning("incomplete shadow map framebuffer");
+    }
+    // Sized like the scene framebuffer, and created on first use as well
+    if (drawProps_.ambientOcclusionEnabled
+        && !ambientOcclusion_.resize(frameBufferWidth_, frameBufferHeight_))
+    {
+        utils::logWarning("incomplete ambient occlusion framebuffer");
+    }
+#ifndef __EMSCRIPTEN__
+    // Feedback of virtual textured skyboxes is small enough to be kept
+    // whether such a skybox is loaded or not
+    if (!virtualSkybox_.resize(frameBufferWidth_, frameBufferHeight_))
+    {
+        utils::logWarning("incomplete virtual texture feedback framebuffer");
+    }
+    // Only a byte per tile of the window, kept whether used or not
+    shadingRateImage_.resize(frameBufferWidth_, frameBufferHeight_, glState_);
+#endif
+    // Textures of the frame graph left unused are deleted before bindings
+    // are invalidated, as their names may be reused
+    frameGraph_.beginFrame();
+    // Models and skybox loaded between frames and UI rendering bind objects
+    // without going through the state cache
+    glState_.invalidateBindings();
+    // Results of earlier frames are read back before choosing resolution
+    // scale from them
+    gpuProfiler_.setPipelineStatisticsEnabled(
+        drawProps_.pipelineStatisticsEnabled);
+    gpuProfiler_.beginFrame();
+    streamBuffer_.beginFrame();
+    frameStatistics_ = {};
+    frameStartStateChangeCount_ = glState_.issuedCallCount();
+    nextObjectId_ = 1;
+#ifndef __EMSCRIPTEN__
+    // Identifier picked in an earlier frame arrives with a frame of delay
+    if (const std::optional<std::uint32_t> objectId
+        = objectPicker_.takeFinished())
+    {
+        pickedObjectId_ = objectId.value();
+    }
+    if (!drawProps_.pickingEnabled)
+    {
+        pickedObjectId_ = 0;
+    }
+    const bool objectIdsEnabled = drawProps_.pickingEnabled;
+    // Pages requested by the previous frame start loading, pages read since
+    // then are drawn in this one
+    clusterStreamer_.update();
+#else
+    const bool objectIdsEnabled = false;
+#endif
+    // Modes asking for more samples than supported fall back to the most
+    // the driver allows
+    const AntialiasingMode& antialiasingMode
+        = ANTIALIASING_MODES[static_cast<size_t>(
+            drawProps_.antialiasingModeIndex)];
+    AntialiasingFilter antialiasingFilter = antialiasingMode.filter;
+    // Eyes are layers of half the window size each, created on first use.
+    // Stereo takes the place of multiple views.
+    stereoActive_ = drawProps_.stereoEnabled && multiviewSupported_;
+    stereoComposed_ = false;
+    if (stereoActive_
+        && !stereoTarget_.resize(std::max(frameBufferWidth_ / 2, 1),
+                                 frameBufferHeight_,
+                                 sceneTarget_.colorFormat()))
+    {
+        utils::logWarning("incomplete stereo framebuffer");
+        stereoActive_ = false;
+    }
+#ifndef __EMSCRIPTEN__
+    // Image covers a single layer, while eyes are layers of their own
+    shadingRateActive_ = drawProps_.shadingRateModeIndex != 0
+                      && shadingRateImage_.isSupported() && !stereoActive_;
+#endif
+    // History of temporal upscaling would be reprojected across views, and
+    // would blend counted layers of the overdraw view
+    const bool multiView = drawProps_.multiViewEnabled && !stereoActive_;
+    if ((multiView || stereoActive_ || drawProps_.overdrawViewEnabled)
+        && antialiasingFilter == AntialiasingFilter::Temporal)
+    {
+        antialiasingFilter = AntialiasingFilter::Fxaa;
+    }
+    if (antialiasingFilter == AntialiasingFilter::Temporal)
+    {
+        // History is sized like the window. Starting over after another
+        // filter, history and previous view are stale.
+        if (!temporalUpscaler_.resize(frameBufferWidth_,
+                                      frameBufferHeight_,
+                                      sceneTarget_.colorFormat()))
+        {
+            utils::logWarning("incomplete temporal upscaling framebuffer");
+        }
+        if (antialiasingFilter_ != AntialiasingFilter::Temporal)
+        {
+            temporalUpscaler_.invalidateHistory();
+        }
+    }
+    antialiasingFilter_ = antialiasingFilter;
+    int sampleCount = std::min(antialiasingMode.sampleCount, maxSampleCount_);
 #ifndef __EMSCRIPTEN__
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    if (objectIdsEnabled)
+    {
+        sampleCount = std::min(sampleCount, maxIntegerSampleCount_);
+    }
 #endif
-    glBindVertexArray(0);
+
+    // Viewport setup. Scene is drawn into a corner of the offscreen target, as
+    // large as the window.
+    updateResolutionScale();
+    const int sceneWidth = std::max(
+        static_cast<int>(std::lround(static_cast<float>(frameBufferWidth_)
+                                     * resolutionScale_)),
+        1);
+    const int sceneHeight = std::max(
+        static_cast<int>(std::lround(static_cast<float>(frameBufferHeight_)
+                                     * resolutionScale_)),
+        1);
+    if (!sceneTarget_.resize(frameBufferWidth_,
+                             frameBufferHeight_,
+                             std::max(sampleCount, 1),
+                             objectIdsEnabled))
+    {
+        utils::logWarning("incomplete scene framebuffer of size ",
+                          frameBufferWidth_,
+                          "x",
+                          frameBufferHeight_);
+    }
+    sceneTarget_.bind();
+    // Transparent surfaces are accumulated in half float, which may not be
+    // renderable where the scene is not either. Instanced draws into
+    // several views and the overdraw view draw them opaque.
+    transparencyActive_ = !multiView && !stereoActive_
+                       && !drawProps_.overdrawViewEnabled
+                       && sceneTarget_.colorFormat() == GL_RGBA16F;
+    transparentCommands_.clear();
+    // UI rendering restores the viewport it changes, so viewport is only set
+    // when scene size changes
+    if (sceneWidth != sceneWidth_ || sceneHeight != sceneHeight_)
+    {
+        sceneWidth_ = sceneWidth;
+        sceneHeight_ = sceneHeight;
+        glViewport(0, 0, sceneWidth_, sceneHeight_);
+    }
+    // Camera view takes the bottom-left quadrant of multiple views, so that
+    // light clusters are looked up from fragment coordinates the same way.
+    // Each eye takes the bottom-left half of its layer.
+    const int viewWidth
+        = multiView || stereoActive_ ? std::max(sceneWidth_ / 2, 1)
+                                     : sceneWidth_;
+    const int viewHeight
+        = multiView ? std::max(sceneHeight_ / 2, 1) : sceneHeight_;
+    // Aspect ratio is taken from the window, so that rounding scene size
+    // does not change projection. Eyes are half as wide.
+    const float aspectRatio = static_cast<float>(frameBufferWidth_)
+                            / static_cast<float>(frameBufferHeight_)
+                            * (stereoActive_ ? 0.5F : 1.0F);
+    if (projectionDirty_
+        || projectionFovGeneration_ != drawProps_.fovGeneration
+        || projectionStereo_ != stereoActive_)
+    {
+        projectionDirty_ = false;
+        projectionFovGeneration_ = drawProps_.fovGeneration;
+        projectionStereo_ = stereoActive_;
+        projection_ = glm::perspective(glm::radians(drawProps_.fov),
+                                       aspectRatio,
+                                       NEAR_PLANE,
+                                       FAR_PLANE);
+    }
+    // Camera does not move while the frame is drawn, so its view is shared by
+    // all passes, and kept across frames while neither camera nor projection
+    // change
+    if (!frameView_.isBuiltFrom(camera_, projection_))
+    {
+        frameView_ = FrameView::create(camera_, projection_);
+    }
+    const glm::mat4& view = frameView_.view;
+    viewProjection_ = frameView_.viewProjection;
+    frustum_ = frameView_.frustum;
+    // Eyes look parallel to the camera from either side of it. Copies are
+    // culled once for both against the frustum of the camera moved back
+    // until its frustum contains both eye frustums.
+    std::array<glm::mat4, 2> eyeViewProjections{viewProjection_,
+                                                viewProjection_};
+    if (stereoActive_)
+    {
+        for (size_t eye = 0; eye < eyeViewProjections.size(); ++eye)
+        {
+            const float eyeOffset
+                = (eye == 0 ? -0.5F : 0.5F) * EYE_SEPARATION;
+            eyeViewProjections[eye]
+                = projection_
+                * glm::translate(glm::mat4{1.0F},
+                                 glm::vec3{-eyeOffset, 0.0F, 0.0F})
+                * view;
+        }
+        const float cullingDistance
+            = 0.5F * EYE_SEPARATION * projection_[0][0];
+        frustum_ = Frustum::fromMatrix(
+            projection_
+            * glm::translate(glm::mat4{1.0F},
+                             glm::vec3{0.0F, 0.0F, -cullingDistance})
+            * view);
+    }
+    // Vertical scale of projection is the cotangent of half field of view,
+    // mapping unit length at unit distance onto half of viewport height
+    lodProjectionScale_
+        = projection_[1][1] * static_cast<float>(viewHeight) * 0.5F;
+    // Temporal upscaling offsets drawn geometry by subpixel jitter, while
+    // culling, level of detail and reprojection keep the unjittered view
+    glm::mat4 drawnProjection = projection_;
+    if (antialiasingFilter_ == AntialiasingFilter::Temporal)
+    {
+        temporalReprojection_
+            = previousViewProjection_ * frameView_.inverseViewProjection;
+        previousViewProjection_ = frameView_.viewProjection;
+        // Translation in clip space moves every vertex by the same distance
+        // in normalized device coordinates
+        const glm::vec2 jitter = temporalUpscaler_.nextJitter();
+        glm::mat4 jitterMatrix{1.0F};
+        jitterMatrix[3][0] = 2.0F * jitter.x / static_cast<float>(sceneWidth_);
+        jitterMatrix[3][1]
+            = 2.0F * jitter.y / static_cast<float>(sceneHeight_);
+        drawnProjection = jitterMatrix * projection_;
+        viewProjection_ = jitterMatrix * viewProjection_;
+    }
+
+    const glm::vec3 lightDirection{drawProps_.lightDirection[0],
+                                   drawProps_.lightDirection[1],
+                                   drawProps_.lightDirection[2]};
+    const bool shadowsEnabled
+        = drawProps_.shadowsEnabled && shadowMap_.isCreated();
+    if (shadowsEnabled)
+    {
+        shadowMap_.fitCascades(view,
+                               glm::radians(drawProps_.fov),
+                               aspectRatio,
+                               NEAR_PLANE,
+                               FAR_PLANE,
+                               lightDirection);
+        glState_.bindTexture(SHADOW_MAP_TEXTURE_UNIT,
+                             GL_TEXTURE_2D_ARRAY,
+                             shadowMap_.texture());
+    }
+
+    // Per-frame uniforms are uploaded once for all draws of the frame
+    frameUniforms_ = {
+        .projection = drawnProjection,
+        .view = view,
+        .viewProjection = viewProjection_,
+        .viewPosition = glm::vec4{frameView_.cameraPosition, 1.0F},
+        .lightDirection = glm::vec4{lightDirection, 0.0F},
+        .selectedObjectId
+        = objectIdsEnabled ? drawProps_.selectedObjectId : 0,
+        .shadowsEnabled = shadowsEnabled ? 1U : 0U,
+        .lightCount = static_cast<std::uint32_t>(
+            std::min(lights_.size(), LightClusters::MAX_LIGHT_COUNT)),
+        .ambientOcclusionEnabled = drawProps_.ambientOcclusionEnabled
+                                        && ambientOcclusion_.isCreated()
+                                        && !multiView && !stereoActive_
+                                     ? 1U
+                                     : 0U,
+        .lightViewProjections = shadowMap_.lightViewProjections(),
+        .shadowSplitDepths = shadowMap_.splitDepths(),
+        .clusterScale = LightClusters::fragmentScale(projection_,
+                                                     viewWidth,
+                                                     viewHeight),
+        .eyeViewProjections = eyeViewProjections,
+    };
+    frameUniformsRange_ = streamBuffer_.write(
+        std::as_bytes(std::span{&frameUniforms_, 1}),
+        uniformBufferAlignment_);
+    glBindBufferRange(GL_UNIFORM_BUFFER,
+                      FRAME_DATA_BINDING,
+                      frameUniformsRange_.buffer,
+                      frameUniformsRange_.offset,
+                      sizeof(FrameUniforms));
+    views_.front() = {
+        .viewProjection = viewProjection_,
+        .frustum = frustum_,
+        .viewport = glm::ivec4{0, 0, viewWidth, viewHeight},
+        .frameUniforms = frameUniformsRange_,
+    };
+    viewCount_ = 1;
+    if (multiView)
+    {
+        // Orthographic views look at the origin the instance grid is centered
+        // on, framing it like the camera does from its distance. Light
+        // clusters and shadow cascades are fitted to the camera view only.
+        const float halfHeight
+            = std::max(glm::length(frameView_.cameraPosition), 1.0F)
+            / projection_[1][1];
+        const float halfWidth = halfHeight * static_cast<float>(viewWidth)
+                              / static_cast<float>(viewHeight);
+        const glm::mat4 orthographicProjection
+            = glm::ortho(-halfWidth,
+                         halfWidth,
+                         -halfHeight,
+                         halfHeight,
+                         0.0F,
+                         2.0F * ORTHOGRAPHIC_DISTANCE);
+        // Front, top and side views looking from these directions, with the
+        // up direction of their viewports
+        const std::array<std::array<glm::vec3, 2>, MAX_VIEW_COUNT - 1>
+            directions{{
+                {glm::vec3{0.0F, 0.0F, 1.0F}, glm::vec3{0.0F, 1.0F, 0.0F}},
+                {glm::vec3{0.0F, 1.0F, 0.0F}, glm::vec3{0.0F, 0.0F, -1.0F}},
+                {glm::vec3{1.0F, 0.0F, 0.0F}, glm::vec3{0.0F, 1.0F, 0.0F}},
+            }};
+        for (const auto& [direction, up] : directions)
+        {
+            const glm::vec3 eye = direction * ORTHOGRAPHIC_DISTANCE;
+            const glm::mat4 orthographicView
+                = glm::lookAt(eye, glm::vec3{0.0F}, up);
+            FrameUniforms uniforms = frameUniforms_;
+            uniforms.projection = orthographicProjection;
+            uniforms.view = orthographicView;
+            uniforms.viewProjection
+                = orthographicProjection * orthographicView;
+            uniforms.viewPosition = glm::vec4{eye, 1.0F};
+            uniforms.shadowsEnabled = 0;
+            uniforms.lightCount = 0;
+            // Quadrants right of and above the camera view
+            views_[viewCount_] = {
+                .viewProjection = uniforms.viewProjection,
+                .frustum = Frustum::fromMatrix(uniforms.viewProjection),
+                .viewport = glm::ivec4{static_cast<int>(viewCount_ & 1U)
+                                           * viewWidth,
+                                       static_cast<int>(viewCount_ >> 1U)
+                                           * viewHeight,
+                                       viewWidth,
+                                       viewHeight},
+                .frameUniforms = streamBuffer_.write(
+                    std::as_bytes(std::span{&uniforms, 1}),
+                    uniformBufferAlignment_),
+            };
+            ++viewCount_;
+        }
+    }
+    // Lights are assigned to clusters of the view before any model is drawn
+    if (!lights_.empty())
+    {
+        gpuProfiler_.beginPass(GpuPass::LightAssignment);
+        lightClusters_.assign(lights_, view, projection_, glState_);
+        gpuProfiler_.endPass();
+    }
+
+    // Clear screen. Overdraw view counts layers from zero, adding up every
+    // fragment shaded.
+    if (drawProps_.overdrawViewEnabled)
+    {
+        glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
+        glState_.setBlendFunc(GL_ONE, GL_ONE);
+    }
+    else
+    {
+        glClearColor(drawProps_.backgroundColor[0],
+                     drawProps_.backgroundColor[1],
+                     drawProps_.backgroundColor[2],
+                     1.0F);
+    }
+    // Clearing is subject to write masks, which a depth prepass leaves
+    // disabled
+    glState_.setDepthWriteEnabled(true);
+    glState_.setColorWriteEnabled(true);
+    gpuProfiler_.beginPass(GpuPass::Clear);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (sceneTarget_.hasObjectIds())
+    {
+        // Integer attachment is not cleared by glClear() with a float color
+        constexpr std::array<GLuint, 4> backgroundId{0, 0, 0, 0};
+        glClearBufferuiv(GL_COLOR, 1, backgroundId.data());
+    }
+    if (stereoActive_)
+    {
+        stereoTarget_.bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    gpuProfiler_.endPass();
+    // Clearing ignores the viewport, draws start in the camera view
+    if (multiView || stereoActive_)
+    {
+        bindView(views_.front());
+    }
 }
 
-void Renderer::drawSkybox(const Skybox& skybox)
+void Renderer::bindView(const View& view)
 {
-    // Skybox needs to be drawn at the end of the rendering pipeline for
-    // efficiency, not the other way around before objects (like in Painter's
-    // Algorithm).
-    //
-    // Allow skybox pixel depths to pass depth test even when depth buffer is
-    // filled with maximum 1.0 depth values. Everything drawn before skybox
-    // will be displayed in front of skybox.
-    glDepthFunc(GL_LEQUAL);
-    // Set skybox shader
-    auto& shader
-        = shaders_[static_cast<std::uint8_t>(ShaderInstance::SkyboxShader)];
-    shader.use();
-    glBindVertexArray(skybox.vertexArray);
+    glViewport(view.viewport.x,
+               view.viewport.y,
+               view.viewport.z,
+               view.viewport.w);
+    glBindBufferRange(GL_UNIFORM_BUFFER,
+                      FRAME_DATA_BINDING,
+                      view.frameUniforms.buffer,
+                      view.frameUniforms.offset,
+                      sizeof(FrameUniforms));
+}
 
-    // Set skybox texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-
-    // Remove camera position transformations but keep rotation by recreating
-    // view matrix, then converting to mat3 and back. If you don't do this,
-    // skybox will be shown as a shrinked down cube around model.
-    const glm::mat4 normalizedView
-        = glm::mat4(glm::mat3(camera_.calculateViewMatrix()));
-    // Concat matrix transformations on CPU to avoid unnecessary
-    // multiplications
-    // in GLSL. Results would be the same for all vertices.
-    const glm::mat4 projectionView = projection_ * normalizedView;
+void Renderer::bindSceneTarget()
+{
+    if (stereoActive_ && !stereoComposed_)
+    {
+        stereoTarget_.bind();
+    }
+    else
+    {
+        sceneTarget_.bind();
+    }
+    bindView(views_.front());
+}
 
-    // Transfer uniforms
-    shader.setUniform("u_projectionView", projectionView);
-    constexpr int textureUnit = 0;
-    shader.setUniform("u_skyboxTexture", textureUnit);
+void Renderer::composeStereo()
+{
+    if (!stereoActive_ || stereoComposed_)
+    {
+        return;
+    }
+    stereoComposed_ = true;
+    gpuProfiler_.beginPass(GpuPass::Models);
+    sceneTarget_.bind();
+    glViewport(0, 0, sceneWidth_, sceneHeight_);
+    stereoTarget_.compose(views_.front().viewport.z,
+                          emptyVertexArray_,
+                          glState_);
+    ++frameStatistics_.drawCallCount;
+    ++frameStatistics_.triangleCount;
+    gpuProfiler_.endPass();
+}
+
+void Renderer::finishDraw()
+{
+    PROFILE_SCOPE("Renderer::finishDraw");
+    submitCommands();
+    composeStereo();
+    // Samples are resolved before anything reads the scene
+    if (sceneTarget_.isMultisampled())
+    {
+        gpuProfiler_.beginPass(GpuPass::Antialiasing);
+        sceneTarget_.resolve(sceneWidth_, sceneHeight_);
+        gpuProfiler_.endPass();
+    }
+#ifndef __EMSCRIPTEN__
+    // Queued behind the draws, read once the scene is complete. Picks are
+    // dropped while both buffers are still being read back. Transparent
+    // surfaces draw no identifiers, so they are read before them, while
+    // resolved identifiers are still bound for reading.
+    if (pickPosition_ && sceneTarget_.hasObjectIds()
+        && !objectPicker_.isFull())
+    {
+        objectPicker_.readObjectId(pickPosition_->x, pickPosition_->y);
+    }
+    pickPosition_.reset();
+#endif
+    // Post-processing is declared as a graph over the resolved scene.
+    // Passes whose results do not reach the window are culled, like bloom
+    // while disabled or temporal upscaling under other filters. Transients
+    // share the pool with those of ambient occlusion computed earlier.
+    const glm::ivec2 frameBufferSize{frameBufferWidth_, frameBufferHeight_};
+    struct PostProcessing
+    {
+        FrameGraph::Resource scene;
+        FrameGraph::Resource temporalDepth;
+        FrameGraph::Resource history;
+        std::array<FrameGraph::Resource, Bloom::LEVEL_COUNT> bloomLevels;
+        FrameGraph::Resource window;
+        /// Scene or history at window resolution bloomed and tonemapped.
+        TextureRegion upscaled;
+        std::optional<TextureRegion> bloom;
+    };
+    frameGraph_.reset();
+    PostProcessing post{
+        .scene = frameGraph_.importTexture("Scene",
+                                           sceneTarget_.colorTexture(),
+                                           frameBufferSize),
+        .temporalDepth = frameGraph_.createTexture(
+            "Temporal upscaling depth",
+            {.size = frameBufferSize,
+             .internalFormat = GL_DEPTH_COMPONENT24,
+             .filter = GL_NEAREST}),
+        .history = frameGraph_.importTexture(
+            "Temporal history",
+            temporalUpscaler_.nextHistoryTexture(),
+            frameBufferSize),
+        .bloomLevels = {},
+        .window = frameGraph_.importTexture("Window", 0, frameBufferSize),
+        .upscaled = {.texture = sceneTarget_.colorTexture(),
+                     .size = glm::ivec2{sceneWidth_, sceneHeight_},
+                     .textureSize = frameBufferSize},
+        .bloom = std::nullopt,
+    };
+    for (size_t i = 0; i < Bloom::LEVEL_COUNT; ++i)
+    {
+        post.bloomLevels[i] = frameGraph_.createTexture(
+            "Bloom level",
+            {.size = Bloom::getLevelSize(frameBufferSize, i),
+             .internalFormat = sceneTarget_.colorFormat(),
+             .filter = GL_LINEAR});
+    }
+    addScenePasses(post.scene);
 
-    // Issue draw call
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+    // Temporal upscaling accumulates the scene into history at window
+    // resolution, which is bloomed and tonemapped in place of the scene
+    frameGraph_.addPass(
+        "Temporal upscaling",
+        {post.scene},
+        {post.temporalDepth, post.history},
+        [this, &post](const FrameGraph& graph)
+        {
+            gpuProfiler_.beginPass(GpuPass::Antialiasing);
+            post.upscaled
+                = temporalUpscaler_.draw(post.upscaled.texture,
+                                         graph.target(post.temporalDepth),
+                                         post.upscaled.size,
+                                         temporalReprojection_,
+                                         emptyVertexArray_,
+                                         glState_);
+            gpuProfiler_.endPass();
+        });
+    const FrameGraph::Resource upscaled
+        = antialiasingFilter_ == AntialiasingFilter::Temporal ? post.history
+                                                               : post.scene;
+    frameGraph_.addPass(
+        "Bloom",
+        std::span{&upscaled, 1},
+        post.bloomLevels,
+        [this, &post](const FrameGraph& graph)
+        {
+            std::array<FrameGraph::Target, Bloom::LEVEL_COUNT> levels;
+            for (size_t i = 0; i < Bloom::LEVEL_COUNT; ++i)
+            {
+                levels[i] = graph.target(post.bloomLevels[i]);
+            }
+            gpuProfiler_.beginPass(GpuPass::Bloom);
+            post.bloom = bloom_.draw(post.upscaled,
+                                     levels,
+                                     emptyVertexArray_,
+                                     glState_);
+            gpuProfiler_.endPass();
+        });
 
-    // Reset state
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS);  // Reset depth testing to default
+    // Tonemapping upscales the scene into the window, smoothing edges along
+    // the way with FXAA
+    const bool bloomEnabled
+        = drawProps_.bloomEnabled && !drawProps_.overdrawViewEnabled;
+    const std::array tonemapReads{upscaled, post.bloomLevels[0]};
+    frameGraph_.addPass(
+        "Tonemapping",
+        std::span{tonemapReads}.first(bloomEnabled ? 2 : 1),
+        std::span{&post.window, 1},
+        [this, &post](const FrameGraph&)
+        {
+            gpuProfiler_.beginPass(GpuPass::Tonemap);
+            tonemapper_.draw(
+                post.upscaled,
+                post.bloom,
+                Tonemapper::Settings{
+                    .exposure = drawProps_.exposure,
+                    .bloomIntensity = drawProps_.bloomIntensity,
+                    .fxaaEnabled
+                    = antialiasingFilter_ == AntialiasingFilter::Fxaa,
+                    .heatmapEnabled = drawProps_.overdrawViewEnabled},
+                glm::ivec2{frameBufferWidth_, frameBufferHeight_},
+                emptyVertexArray_,
+                glState_);
+            gpuProfiler_.endPass();
+        });
+    frameGraph_.markOutput(post.window);
+    frameGraph_.execute(glState_);
+    // Commands of passes that did not run are dropped with the frame
+    transparentCommands_.clear();
+    glEnable(GL_DEPTH_TEST);
+    glViewport(0, 0, sceneWidth_, sceneHeight_);
+    finishFrameStatistics();
+}
+
+bool Renderer::beginUiOverlay()
+{
+    if (!uiOverlay_.resize(frameBufferWidth_, frameBufferHeight_))
+    {
+        utils::logWarning("incomplete UI overlay framebuffer");
+        return false;
+    }
+    uiOverlay_.beginCapture();
+    return true;
+}
+
+void Renderer::endUiOverlay()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // UI rendering binds objects without going through the state cache
+    glState_.invalidateBindings();
+}
+
+void Renderer::drawUiOverlay()
+{
+    uiOverlay_.draw(emptyVertexArray_, glState_);
+    glEnable(GL_DEPTH_TEST);
+    glViewport(0, 0, sceneWidth_, sceneHeight_);
+}
+
+#ifndef __EMSCRIPTEN__
+void Renderer::finishOffscreenDraw()
+{
+    PROFILE_SCOPE("Renderer::finishOffscreenDraw");
+    submitCommands();
+    composeStereo();
+    if (sceneTarget_.isMultisampled())
+    {
+        sceneTarget_.resolve(sceneWidth_, sceneHeight_);
+    }
+    frameGraph_.reset();
+    const FrameGraph::Resource scene = frameGraph_.importTexture(
+        "Scene",
+        sceneTarget_.colorTexture(),
+        glm::ivec2{frameBufferWidth_, frameBufferHeight_});
+    addScenePasses(scene);
+    frameGraph_.markOutput(scene);
+    frameGraph_.execute(glState_);
+    transparentCommands_.clear();
+    finishFrameStatistics();
+}
+
+void Renderer::requestPick(glm::ivec2 frameBufferPosition)
+{
+    if (!drawProps_.pickingEnabled)
+    {
+        return;
+    }
+    // Scene covers a corner of the target scaled down from the window
+    const auto toScene = [](int position, int frameBufferSize, int sceneSize)
+    {
+        const auto scenePosition = static_cast<int>(
+            static_cast<float>(position) * static_cast<float>(sceneSize)
+            / static_cast<float>(frameBufferSize));
+        return std::clamp(scenePosition, 0, sceneSize - 1);
+    };
+    pickPosition_ = glm::ivec2{
+        toScene(frameBufferPosition.x, frameBufferWidth_, sceneWidth_),
+        toScene(frameBufferPosition.y, frameBufferHeight_, sceneHeight_),
+    };
+}
+
+void Renderer::updateShadingRate()
+{
+    // Post-processing, UI and the next frame until its models are shaded run
+    // at full rate
+    shadingRateImage_.setEnabled(false);
+    if (!shadingRateActive_)
+    {
+        return;
+    }
+    gpuProfiler_.beginPass(GpuPass::Models);
+    shadingRateImage_.update(
+        static_cast<ShadingRateImage::Mode>(drawProps_.shadingRateModeIndex),
+        sceneTarget_.colorTexture(),
+        glm::ivec2{sceneWidth_, sceneHeight_},
+        views_.front().viewport,
+        glState_);
+    gpuProfiler_.endPass();
+}
+
+void Renderer::finishFrameStatistics()
+{
+    frameStatistics_.stateChangeCount = static_cast<std::uint32_t>(
+        glState_.issuedCallCount() - frameStartStateChangeCount_);
+    frameStatistics_.graphPassCount = frameGraph_.executedPassCount();
+    frameStatistics_.culledGraphPassCount = frameGraph_.culledPassCount();
+    frameStatistics_.transientRequestedSize = frameGraph_.requestedSize();
+    frameStatistics_.transientPoolSize = frameGraph_.poolSize();
+}
+
+void Renderer::fenceFrame()
+{
+    frameFences_.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void Renderer::limitFramesInFlight(size_t maxFramesInFlight)
+{
+    PROFILE_SCOPE("Renderer::limitFramesInFlight");
+    while (!frameFences_.empty() && frameFences_.size() > maxFramesInFlight)
+    {
+        glClientWaitSync(frameFences_.front(),
+                         GL_SYNC_FLUSH_COMMANDS_BIT,
+                         UINT64_MAX);
+        glDeleteSync(frameFences_.front());
+        frameFences_.pop_front();
+    }
+}
+
+void Renderer::updateEditableMesh(EditableMesh& mesh)
+{
+    mesh.update(streamBuffer_, threadPool_);
+}
+#endif
+
+void Renderer::drawModel(const Model& model,
+                         std::span<const glm::mat4> worldMatrices,
+                         const SpatialIndex* spatialIndex)
+{
+    PROFILE_SCOPE("Renderer::drawModel");
+    // Copies are drawn into multiple views and both eyes with instancing,
+    // reading the view projection of each view from its per-frame uniforms.
+    // Streamed models select clusters for the camera, and show in its view
+    // only, or not at all in stereo.
+#ifndef __EMSCRIPTEN__
+    if (stereoActive_ && model.streamedMesh)
+    {
+        return;
+    }
+    if ((viewCount_ > 1 || stereoActive_) && !model.streamedMesh)
+#else
+    if (viewCount_ > 1 || stereoActive_)
+#endif
+    {
+        drawModelInstanced(model, worldMatrices, spatialIndex);
+        return;
+    }
+    // Shader variant and color are resolved once, recording only reads them
+    const size_t shaderIndex = getShaderIndex(ShaderInstance::ModelShader);
+    const GLuint depthProgram
+        = getDepthShader(ShaderInstance::ModelShader).program();
+    const glm::vec3 color = getModelColor();
+    const std::uint32_t firstObjectId = allocateObjectIds(worldMatrices.size());
+    const bool occlusionTested
+        = renderOccluders(model, worldMatrices, viewProjection_, frustum_);
+    std::atomic<std::uint32_t> occludedCopyCount{0};
+    const std::pmr::vector<std::uint32_t> candidateCopies
+        = findCandidateCopies(spatialIndex,
+                              worldMatrices.size(),
+                              std::span{&frustum_, 1});
+
+    // Each range of copies is recorded by a single thread pool task into its
+    // own command buffer, after those of earlier calls not submitted yet
+    const size_t firstBuffer = commandBufferCount_;
+    commandBufferCount_ += (candidateCopies.size() + RECORDING_BATCH_SIZE - 1)
+                         / RECORDING_BATCH_SIZE;
+    if (commandBuffers_.size() < commandBufferCount_)
+    {
+        commandBuffers_.resize(commandBufferCount_);
+    }
+    threadPool_.parallelFor(
+        candidateCopies.size(),
+        RECORDING_BATCH_SIZE,
+        [&](size_t begin, size_t end)
+        {
+            PROFILE_SCOPE("Renderer::recordModels");
+            CommandBuffer& commands
+                = commandBuffers_[firstBuffer + begin / RECORDING_BATCH_SIZE];
+            commands.clear();
+            std::uint32_t batchOccludedCount = 0;
+            for (size_t candidate = begin; candidate < end; ++candidate)
+            {
+                const std::uint32_t i = candidateCopies[candidate];
+                if (occlusionTested
+                    && softwareCuller_.isOccluded(
+                        model.bounds,
+                        viewProjection_ * worldMatrices[i]))
+                {
+                    ++batchOccludedCount;
+                    continue;
+                }
+                recordModel(model,
+                            worldMatrices[i],
+                            shaderIndex,
+                            depthProgram,
+                            color,
+                            firstObjectId + i,
+                            commands);
+            }
+            occludedCopyCount += batchOccludedCount;
+        });
+    frameStatistics_.occludedCopyCount += occludedCopyCount;
+}
+
+std::pmr::vector<std::uint32_t> Renderer::findCandidateCopies(
+    const SpatialIndex* spatialIndex,
+    size_t copyCount,
+    std::span<const Frustum> frustums) const
+{
+    std::pmr::vector<std::uint32_t> copies(frameAllocator_.resource());
+    if (spatialIndex == nullptr || spatialIndex->size() != copyCount)
+    {
+        copies.resize(copyCount);
+        std::iota(copies.begin(), copies.end(), 0U);
+        return copies;
+    }
+    for (const Frustum& frustum : frustums)
+    {
+        spatialIndex->query(frustum, copies);
+    }
+    // Copies seen from several views are drawn once per view, but tested once
+    if (frustums.size() > 1)
+    {
+        std::sort(copies.begin(), copies.end());
+        copies.erase(std::unique(copies.begin(), copies.end()), copies.end());
+    }
+    return copies;
+}
+
+bool Renderer::renderOccluders(const Model& model,
+                               std::span<const glm::mat4> worldMatrices,
+                               const glm::mat4& viewProjection,
+                               const Frustum& frustum)
+{
+    if (!drawProps_.softwareOcclusionCullingEnabled || !model.occluder)
+    {
+        return false;
+    }
+    PROFILE_SCOPE("Renderer::renderOccluders");
+    softwareCuller_.render(model.occluder.value(),
+                           model.boundingSphere,
+                           worldMatrices,
+                           viewProjection,
+                           frustum,
+                           frameView_.cameraPosition,
+                           threadPool_,
+                           frameAllocator_.resource());
+    return true;
+}
+
+void Renderer::recordModel(const Model& model,
+                           const glm::mat4& worldMatrix,
+                           size_t shaderIndex,
+                           GLuint depthProgram,
+                           const glm::vec3& color,
+                           std::uint32_t objectId,
+                           CommandBuffer& commands) const
+{
+    // Rejected before recording anything
+    const BoundingSphere worldSphere
+        = transformSphere(model.boundingSphere, worldMatrix);
+    if (!frustum_.intersects(worldSphere))
+    {
+        return;
+    }
+
+    // Model transform
+    // Dequantization of packed vertex positions is folded into model matrix.
+    // Normals are not quantized relative to bounding box, so normal matrix is
+    // derived without it.
+    const glm::mat4 modelMatrix = worldMatrix * model.positionTransform;
+
+    // Concat matrix transformations on CPU to avoid unnecessary multiplications
+    // in GLSL. Results would be the same for all vertices.
+    glm::mat4 mvp;
+    glm::mat3 normalMatrix;
+    transformbatch::computeMvpMatrices(viewProjection_,
+                                       std::span{&modelMatrix, 1},
+                                       std::span{&mvp, 1});
+    transformbatch::computeNormalMatrices(std::span{&worldMatrix, 1},
+                                          std::span{&normalMatrix, 1});
+    // Transparent materials are drawn opaque while the transparency pass is
+    // not active
+    const auto getTransparency = [this](float opacity)
+    { return transparencyActive_ ? 1.0F - opacity : 0.0F; };
+    ObjectUniforms uniforms{
+        .model = modelMatrix,
+        .mvp = mvp,
+        .normalMatrix = glm::mat4{normalMatrix},
+        .color = color * getBaseColor(model),
+        .objectId = objectId,
+        .transparency = getTransparency(getOpacity(model)),
+        .textureLayer = getTextureLayer(model),
+        .padding = {},
+    };
+
+#ifdef __EMSCRIPTEN__
+    // Wireframe draws go through expanded vertices without indices, once the
+    // model has created them
+    const bool indexed
+        = !drawProps_.wireframeModeEnabled || model.wireframeVertexArray == 0;
+    const GLuint vertexArray
+        = indexed ? model.vertexArray : model.wireframeVertexArray;
+    const GLenum indexType = indexed ? model.indexType : GL_NONE;
+#else
+    const GLuint vertexArray = model.streamedMesh
+                                 ? clusterStreamer_.vertexArray()
+                                 : model.vertexArray;
+    const GLenum indexType = model.indexType;
+#endif
+    // Clip space W is the view space depth of the sphere center, nearest point
+    // of the sphere orders overlapping copies better than its center
+    const float depth
+        = (viewProjection_ * glm::vec4{worldSphere.center, 1.0F}).w
+        - worldSphere.radius;
+    const auto recordCommand = [&](std::uint32_t uniformOffset)
+    {
+        const RenderPass pass = uniforms.transparency > 0.0F
+                                  ? RenderPass::Transparent
+                                  : RenderPass::Opaque;
+        commands.record({
+            .sortKey = makeSortKey(pass,
+                                   static_cast<std::uint32_t>(shaderIndex),
+                                   vertexArray,
+                                   (depth - NEAR_PLANE)
+                                       / (FAR_PLANE - NEAR_PLANE)),
+            .program = shaders_[shaderIndex].program(),
+            .depthProgram = depthProgram,
+            .vertexArray = vertexArray,
+            .textureArray = model.textureArray,
+            .indexType = indexType,
+            .uniformOffset = uniformOffset,
+            .firstRange = 0,
+            .rangeCount = 0,
+        });
+    };
+
+    // Level of detail bounds are in model space before dequantization.
+    // Errors are compared in model space as well, which holds as long as
+    // world matrix does not scale.
+    const bool lodSelected = drawProps_.lodEnabled
+                          && (!model.meshlets.empty() || !model.lods.empty());
+    const glm::vec3 cameraPosition{glm::affineInverse(worldMatrix)
+                                   * glm::vec4{frameView_.cameraPosition,
+                                               1.0F}};
+    // Sub-meshes of different materials are separate commands with their own
+    // color and opacity, as draw parameters can not select per-range
+    // uniforms
+    if (!hasUniformMaterial(model)
+#ifndef __EMSCRIPTEN__
+        && !model.streamedMesh
+#endif
+    )
+    {
+        for (const Submesh& submesh : model.submeshes)
+        {
+            uniforms.color = color * submesh.baseColor;
+            uniforms.transparency = getTransparency(submesh.opacity);
+            uniforms.textureLayer = submesh.textureLayer;
+            const std::uint32_t uniformOffset = commands.writeData(uniforms);
+            if (lodSelected)
+            {
+                recordLevelsOfDetail(model,
+                                     std::span{&submesh, 1},
+                                     cameraPosition,
+                                     commands);
+            }
+            else
+            {
+                commands.appendRange({
+                    .firstIndex = submesh.firstIndex,
+                    .indexCount = submesh.indexCount,
+#ifdef __EMSCRIPTEN__
+                    .baseVertex = 0,
+#else
+                    .baseVertex = submesh.baseVertex,
+#endif
+                });
+            }
+            recordCommand(uniformOffset);
+        }
+        return;
+    }
+    const std::uint32_t uniformOffset = commands.writeData(uniforms);
+
+    // Drawn ranges
+#ifndef __EMSCRIPTEN__
+    if (model.streamedMesh)
+    {
+        // Full detail of streamed models is never resident as a whole, so
+        // resident clusters are selected even without level of detail
+        clusterStreamer_.recordClusters(
+            model.streamedMesh.value(),
+            {
+                .cameraPosition = cameraPosition,
+                .projectionScale = lodProjectionScale_,
+                .errorThreshold = drawProps_.lodEnabled
+                                    ? drawProps_.lodErrorThreshold
+                                    : 0.0F,
+            },
+            commands);
+    }
+    else
+#endif
+    if (lodSelected)
+    {
+        recordLevelsOfDetail(model, model.submeshes, cameraPosition, commands);
+    }
+    else
+    {
+#ifdef __EMSCRIPTEN__
+        // Sub-mesh indices are rebased on import, so a single range covers
+        // them all
+        commands.appendRange({
+            .firstIndex = 0,
+            .indexCount = static_cast<GLuint>(model.indexCount),
+            .baseVertex = 0,
+        });
+#else
+        for (const Submesh& submesh : model.submeshes)
+        {
+            commands.appendRange({
+                .firstIndex = submesh.firstIndex,
+                .indexCount = submesh.indexCount,
+                .baseVertex = submesh.baseVertex,
+            });
+        }
+#endif
+    }
+    recordCommand(uniformOffset);
+}
+
+void Renderer::submitCommands()
+{
+    PROFILE_SCOPE("Renderer::submitCommands");
+    const std::span<const CommandBuffer> commandBuffers
+        = std::span{commandBuffers_}.first(commandBufferCount_);
+    commandBufferCount_ = 0;
+
+    // Radix sort is stable, so commands with equal keys keep their recording
+    // order
+    sortedCommands_.clear();
+    for (size_t i = 0; i < commandBuffers.size(); ++i)
+    {
+        const std::span<const RenderCommand> commands
+            = commandBuffers[i].commands();
+        for (size_t j = 0; j < commands.size(); ++j)
+        {
+            sortedCommands_.push_back({
+                .sortKey = commands[j].sortKey,
+                .bufferIndex = static_cast<std::uint32_t>(i),
+                .commandIndex = static_cast<std::uint32_t>(j),
+            });
+        }
+    }
+    radixSortByKey(sortedCommands_, sortScratch_);
+
+    // Transparent commands sort last. They are copied out along with their
+    // data and ranges, as command buffers are recorded into again by the
+    // next draw.
+    const auto firstTransparent = std::ranges::find_if(
+        sortedCommands_,
+        [](const SortedCommand& sorted)
+        {
+            return sorted.sortKey
+                >= makeSortKey(RenderPass::Transparent, 0, 0, 0.0F);
+        });
+    for (auto it = firstTransparent; it != sortedCommands_.end(); ++it)
+    {
+        const CommandBuffer& commands = commandBuffers[it->bufferIndex];
+        RenderCommand command = commands.commands()[it->commandIndex];
+        command.uniformOffset = transparentCommands_.writeData(
+            commands.readData<ObjectUniforms>(command.uniformOffset));
+        for (const DrawRange& range : commands.ranges(command))
+        {
+            transparentCommands_.appendRange(range);
+        }
+        transparentCommands_.record(command);
+    }
+    sortedCommands_.erase(firstTransparent, sortedCommands_.end());
+    if (sortedCommands_.empty())
+    {
+        return;
+    }
+
+    // Front to back order within each state group is kept by the prepass,
+    // which is where early depth rejection pays off
+    gpuProfiler_.beginPass(GpuPass::Models);
+    if (isDepthPrepassEnabled())
+    {
+        setDepthPrepassState();
+        replaySortedCommands(commandBuffers, true);
+        computeAmbientOcclusion();
+    }
+    setShadingState();
+    replaySortedCommands(commandBuffers, false);
+    gpuProfiler_.endPass();
+}
+
+void Renderer::addScenePasses(FrameGraph::Resource scene)
+{
+    if (!transparentCommands_.commands().empty())
+    {
+        const glm::ivec2 frameBufferSize{frameBufferWidth_,
+                                         frameBufferHeight_};
+        const FrameGraph::Resource accumulation = frameGraph_.createTexture(
+            "Transparency accumulation",
+            {.size = frameBufferSize,
+             .internalFormat = TransparencyTarget::ACCUMULATION_FORMAT,
+             .filter = GL_NEAREST});
+        const FrameGraph::Resource weight = frameGraph_.createTexture(
+            "Transparency weight",
+            {.size = frameBufferSize,
+             .internalFormat = TransparencyTarget::WEIGHT_FORMAT,
+             .filter = GL_NEAREST});
+        frameGraph_.addPass(
+            "Transparency",
+            {scene},
+            {scene, accumulation, weight},
+            [this, accumulation, weight](const FrameGraph& graph)
+            {
+                drawTransparentCommands(graph.target(accumulation),
+                                        graph.target(weight));
+            });
+    }
+#ifndef __EMSCRIPTEN__
+    // Rates are read by the next frame, outside of the graph
+    const FrameGraph::Resource shadingRate
+        = frameGraph_.importTexture("Shading rate",
+                                    shadingRateImage_.texture(),
+                                    shadingRateImage_.size());
+    frameGraph_.addPass("Shading rate",
+                        {scene},
+                        {shadingRate},
+                        [this](const FrameGraph&) { updateShadingRate(); });
+    frameGraph_.markOutput(shadingRate);
+#endif
+}
+
+void Renderer::drawTransparentCommands(const FrameGraph::Target& accumulation,
+                                       const FrameGraph::Target& weight)
+{
+    const std::span<const RenderCommand> commands
+        = transparentCommands_.commands();
+    if (commands.empty())
+    {
+        return;
+    }
+    // Surfaces are tested against resolved depth, and the scene color they
+    // blend into is only complete once resolved
+    if (!transparencyTarget_.attach(accumulation.texture,
+                                    weight.texture,
+                                    frameGraph_.poolGeneration(),
+                                    sceneTarget_.colorTexture(),
+                                    sceneTarget_.resolvedDepthRenderbuffer()))
+    {
+        utils::logWarning("incomplete transparency framebuffer");
+        transparentCommands_.clear();
+        return;
+    }
+    // Accumulation is order-independent, commands stay in the order they
+    // were sorted into by each submission
+    sortedCommands_.clear();
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        sortedCommands_.push_back({
+            .sortKey = commands[i].sortKey,
+            .bufferIndex = 0,
+            .commandIndex = static_cast<std::uint32_t>(i),
+        });
+    }
+    const std::span<const CommandBuffer> commandBuffers{&transparentCommands_,
+                                                        1};
+    gpuProfiler_.beginPass(GpuPass::Models);
+    transparencyTarget_.begin(glState_);
+    glViewport(0, 0, sceneWidth_, sceneHeight_);
+#ifndef __EMSCRIPTEN__
+    shadingRateImage_.setEnabled(shadingRateActive_);
+#endif
+    replaySortedCommands(commandBuffers, false);
+#ifndef __EMSCRIPTEN__
+    shadingRateImage_.setEnabled(false);
+#endif
+    transparencyTarget_.composite(emptyVertexArray_, glState_);
+    gpuProfiler_.endPass();
+    transparentCommands_.clear();
+}
+
+void Renderer::replaySortedCommands(
+    std::span<const CommandBuffer> commandBuffers,
+    bool depthOnly)
+{
+    for (const SortedCommand& sorted : sortedCommands_)
+    {
+        const CommandBuffer& commands = commandBuffers[sorted.bufferIndex];
+        const RenderCommand& command
+            = commands.commands()[sorted.commandIndex];
+        // Redundant binds between draws sharing state are dropped by the
+        // cache
+        glState_.useProgram(depthOnly ? command.depthProgram
+                                      : command.program);
+        glState_.bindVertexArray(command.vertexArray);
+        if (!depthOnly)
+        {
+            bindMaterialTextures(command.textureArray);
+        }
+        bindObjectUniforms(
+            commands.readData<ObjectUniforms>(command.uniformOffset));
+
+        const size_t indexSize = command.indexType == GL_UNSIGNED_SHORT
+                                   ? sizeof(GLushort)
+                                   : sizeof(GLuint);
+        const std::span<const DrawRange> ranges = commands.ranges(command);
+#ifdef __EMSCRIPTEN__
+        // Multi-draw is an extension in WebGL 2, so ranges are drawn one by
+        // one
+        for (const DrawRange& range : ranges)
+        {
+            ++frameStatistics_.drawCallCount;
+            frameStatistics_.triangleCount += range.indexCount / 3;
+            if (command.indexType == GL_NONE)
+            {
+                glDrawArrays(GL_TRIANGLES,
+                             static_cast<GLint>(range.firstIndex),
+                             static_cast<GLsizei>(range.indexCount));
+                continue;
+            }
+            glDrawElements(GL_TRIANGLES,
+                           static_cast<GLsizei>(range.indexCount),
+                           command.indexType,
+                           // NOLINTNEXTLINE(performance-no-int-to-ptr)
+                           reinterpret_cast<const GLvoid*>(range.firstIndex
+                                                           * indexSize));
+        }
+#else
+        // Multi-draw takes ranges as separate arrays
+        rangeIndexCounts_.clear();
+        rangeIndexOffsets_.clear();
+        rangeBaseVertices_.clear();
+        for (const DrawRange& range : ranges)
+        {
+            rangeIndexCounts_.push_back(
+                static_cast<GLsizei>(range.indexCount));
+            rangeIndexOffsets_.push_back(
+                // NOLINTNEXTLINE(performance-no-int-to-ptr)
+                reinterpret_cast<const GLvoid*>(range.firstIndex * indexSize));
+            rangeBaseVertices_.push_back(range.baseVertex);
+            frameStatistics_.triangleCount += range.indexCount / 3;
+        }
+        ++frameStatistics_.drawCallCount;
+        glMultiDrawElementsBaseVertex(
+            GL_TRIANGLES,
+            rangeIndexCounts_.data(),
+            command.indexType,
+            rangeIndexOffsets_.data(),
+            static_cast<GLsizei>(rangeIndexCounts_.size()),
+            rangeBaseVertices_.data());
+#endif
+    }
+}
+
+void Renderer::drawModelInstanced(const Model& model,
+                                  std::span<const glm::mat4> worldMatrices,
+                                  const SpatialIndex* spatialIndex)
+{
+    PROFILE_SCOPE("Renderer::drawModelInstanced");
+#ifndef __EMSCRIPTEN__
+    // Streamed models select clusters per copy
+    if (model.streamedMesh)
+    {
+        drawModel(model, worldMatrices, spatialIndex);
+        return;
+    }
+#endif
+    // Transparent sub-meshes of the camera view go into the transparency
+    // pass through recorded commands. Indirect draws of such models fall
+    // back here as well.
+    if (transparencyActive_ && hasTransparentMaterial(model))
+    {
+        drawModel(model, worldMatrices, spatialIndex);
+        return;
+    }
+    // Earlier draws keep their order relative to this one
+    submitCommands();
+    // Culled copies are numbered as well, so that identifiers do not change
+    // as copies leave the view
+    const std::uint32_t firstObjectId = allocateObjectIds(worldMatrices.size());
+    // Impostors have no multiview or wireframe variant, and would hide the
+    // layers counted by the overdraw view
+    const bool impostorsActive
+        = drawProps_.impostorsEnabled && model.impostor.has_value()
+       && !stereoActive_ && !drawProps_.wireframeModeEnabled
+       && !drawProps_.overdrawViewEnabled;
+    const float impostorScreenRadius = drawProps_.impostorScreenSize * 0.5F;
+    // Candidate instances are tested in parallel, then compacted in order.
+    // Bounds of each instance are transformed once and tested against every
+    // view, keeping a bit per view. Visibility is kept in bytes instead of
+    // std::vector<bool>, whose elements can not be written from separate
+    // threads. Instances drawn as impostors in a view set the bit of the view
+    // above the first MAX_VIEW_COUNT bits instead.
+    static_assert(MAX_VIEW_COUNT * 2 <= 8);
+    const std::span<const View> views{views_.data(), viewCount_};
+    std::array<Frustum, MAX_VIEW_COUNT> viewFrustums{};
+    std::ranges::transform(views,
+                           viewFrustums.begin(),
+                           [](const View& view) { return view.frustum; });
+    const std::pmr::vector<std::uint32_t> candidateCopies
+        = findCandidateCopies(spatialIndex,
+                              worldMatrices.size(),
+                              std::span{viewFrustums.data(), views.size()});
+    std::pmr::vector<std::uint8_t> instanceViews(candidateCopies.size(),
+                                                 frameAllocator_.resource());
+    // Occluders are rasterized for the camera view alone
+    const bool occlusionTested = views.size() == 1 && !stereoActive_
+                              && renderOccluders(model,
+                                                 worldMatrices,
+                                                 views[0].viewProjection,
+                                                 views[0].frustum);
+    std::atomic<std::uint32_t> occludedCopyCount{0};
+    threadPool_.parallelFor(
+        candidateCopies.size(),
+        CULLING_BATCH_SIZE,
+        [&](size_t begin, size_t end)
+        {
+            PROFILE_SCOPE("Renderer::cullInstances");
+            std::uint32_t batchOccludedCount = 0;
+            for (size_t candidate = begin; candidate < end; ++candidate)
+            {
+                const std::uint32_t i = candidateCopies[candidate];
+                const BoundingSphere sphere
+                    = transformSphere(model.boundingSphere, worldMatrices[i]);
+                std::uint8_t viewMask = 0;
+                for (size_t view = 0; view < views.size(); ++view)
+                {
+                    if (!views[view].frustum.intersects(sphere))
+                    {
+                        continue;
+                    }
+                    if (occlusionTested
+                        && softwareCuller_.isOccluded(
+                            model.bounds,
+                            views[view].viewProjection * worldMatrices[i]))
+                    {
+                        ++batchOccludedCount;
+                        continue;
+                    }
+                    const bool impostor
+                        = impostorsActive
+                       && getScreenRadius(sphere,
+                                          views[view].viewProjection,
+                                          views[view].viewport.w)
+                              < impostorScreenRadius;
+                    viewMask |= static_cast<std::uint8_t>(
+                        1U << (impostor ? MAX_VIEW_COUNT + view : view));
+                }
+                instanceViews[candidate] = viewMask;
+            }
+            occludedCopyCount += batchOccludedCount;
+        });
+    frameStatistics_.occludedCopyCount += occludedCopyCount;
+    // Instances visible in each view are compacted into a range of their own,
+    // meshes of every view followed by impostors of every view, in view order
+    const size_t rangeCount = views.size() * (impostorsActive ? 2 : 1);
+    const auto getRangeBit = [&views](size_t range)
+    {
+        return static_cast<std::uint8_t>(
+            1U << (range < views.size()
+                       ? range
+                       : MAX_VIEW_COUNT + range - views.size()));
+    };
+    std::array<size_t, MAX_VIEW_COUNT * 2 + 1> viewFirstInstances{};
+    for (size_t range = 0; range < rangeCount; ++range)
+    {
+        const std::uint8_t rangeBit = getRangeBit(range);
+        viewFirstInstances[range + 1]
+            = viewFirstInstances[range]
+            + static_cast<size_t>(std::count_if(
+                instanceViews.begin(),
+                instanceViews.end(),
+                [rangeBit](std::uint8_t viewMask)
+                { return (viewMask & rangeBit) != 0; }));
+    }
+    const size_t visibleCount = viewFirstInstances[rangeCount];
+    if (visibleCount == 0)
+    {
+        return;
+    }
+
+    // Stereo draws each instance into both eyes at once
+    const ShaderInstance shaderInstance
+        = stereoActive_ ? ShaderInstance::MultiviewModelShader
+                        : ShaderInstance::InstancedModelShader;
+    auto& shader = getShader(shaderInstance);
+    shader.use(glState_);
+#ifdef __EMSCRIPTEN__
+    // Wireframe draws go through expanded vertices without indices, once the
+    // model has created them
+    const bool indexed
+        = !drawProps_.wireframeModeEnabled || model.wireframeVertexArray == 0;
+    const GLuint vertexArray
+        = indexed ? model.vertexArray : model.wireframeVertexArray;
+#else
+    // Wireframe is overlaid by the geometry shader on indexed draws
+    constexpr bool indexed = true;
+    const GLuint vertexArray = model.vertexArray;
+#endif
+    glState_.bindVertexArray(vertexArray);
+
+    // Model matrix of instanced draws only dequantizes positions, world
+    // matrices are per instance
+    const ObjectUniforms uniforms{
+        .model = model.positionTransform,
+        .mvp = glm::mat4{1.0F},
+        .normalMatrix = glm::mat4{1.0F},
+        .color = getModelColor(),
+        .objectId = firstObjectId,
+        .transparency = 0.0F,
+        .textureLayer = NO_TEXTURE_LAYER,
+        .padding = {},
+    };
+    const bool uniformMaterial = hasUniformMaterial(model);
+    if (uniformMaterial)
+    {
+        ObjectUniforms tinted = uniforms;
+        tinted.color *= getBaseColor(model);
+        tinted.textureLayer = getTextureLayer(model);
+        bindObjectUniforms(tinted);
+    }
+    bindMaterialTextures(model.textureArray);
+
+    // Transforms of visible instances are compacted straight into the stream
+    // buffer, without an intermediate copy. Their copy indices follow them,
+    // as compaction leaves instance numbers different from copy indices.
+    const size_t copyIndicesOffset = visibleCount * sizeof(glm::mat4);
+    const StreamBuffer::Range instanceRange = streamBuffer_.write(
+        static_cast<GLsizeiptr>(copyIndicesOffset
+                                + visibleCount * sizeof(GLuint)),
+        sizeof(glm::vec4),
+        [&](std::span<std::byte> memory)
+        {
+            auto* instanceMatrices
+                = reinterpret_cast<glm::mat4*>(memory.data());
+            auto* copyIndices = reinterpret_cast<GLuint*>(
+                memory.subspan(copyIndicesOffset).data());
+            for (size_t range = 0; range < rangeCount; ++range)
+            {
+                const std::uint8_t rangeBit = getRangeBit(range);
+                for (size_t candidate = 0; candidate < candidateCopies.size();
+                     ++candidate)
+                {
+                    if ((instanceViews[candidate] & rangeBit) != 0)
+                    {
+                        const std::uint32_t i = candidateCopies[candidate];
+                        *instanceMatrices++ = worldMatrices[i];
+                        *copyIndices++ = i;
+                    }
+                }
+            }
+        });
+    glEnableVertexAttribArray(COPY_INDEX_LOCATION);
+    glVertexAttribDivisor(COPY_INDEX_LOCATION, 1);
+
+    // Point instance attributes of the bound vertex array at the range of
+    // instances starting from given one
+    const auto bindInstanceRange = [&](size_t firstInstance)
+    {
+        bindInstanceMatrices(
+            instanceRange.buffer,
+            instanceRange.offset
+                + static_cast<GLintptr>(firstInstance * sizeof(glm::mat4)));
+        glVertexAttribIPointer(
+            COPY_INDEX_LOCATION,
+            1,
+            GL_UNSIGNED_INT,
+            sizeof(GLuint),
+            // NOLINTNEXTLINE(performance-no-int-to-ptr)
+            reinterpret_cast<const GLvoid*>(
+                static_cast<size_t>(instanceRange.offset) + copyIndicesOffset
+                + firstInstance * sizeof(GLuint)));
+    };
+
+    // Issue draw calls. Instances are drawn at full detail, because level of
+    // detail selection is per model, not per instance. Each view draws its
+    // range of instances with its viewport and per-frame uniforms, which
+    // hold the view projection of the instanced model shader.
+    const auto drawViews = [&]
+    {
+        for (size_t view = 0; view < views.size(); ++view)
+        {
+            const size_t firstInstance = viewFirstInstances[view];
+            const auto instanceCount = static_cast<GLsizei>(
+                viewFirstInstances[view + 1] - firstInstance);
+            if (instanceCount == 0)
+            {
+                continue;
+            }
+            if (views.size() > 1)
+            {
+                bindView(views[view]);
+            }
+            bindInstanceRange(firstInstance);
+            drawInstances(model,
+                          instanceCount,
+                          indexed,
+                          uniformMaterial ? nullptr : &uniforms);
+        }
+        if (views.size() > 1)
+        {
+            bindView(views.front());
+        }
+    };
+    // Impostors read the same instance attributes without vertex attributes
+    // of the model, leaving the empty vertex array without enabled attributes
+    // and the model vertex array bound again afterwards
+    const auto drawImpostorViews = [&]
+    {
+        const size_t meshCount = viewFirstInstances[views.size()];
+        if (!impostorsActive || viewFirstInstances[rangeCount] == meshCount)
+        {
+            return;
+        }
+        impostorRenderer_.use(model,
+                              model.impostor.value(),
+                              getModelColor(),
+                              firstObjectId,
+                              glState_);
+        glState_.bindVertexArray(emptyVertexArray_);
+        glEnableVertexAttribArray(COPY_INDEX_LOCATION);
+        glVertexAttribDivisor(COPY_INDEX_LOCATION, 1);
+        for (size_t view = 0; view < views.size(); ++view)
+        {
+            const size_t range = views.size() + view;
+            const size_t firstInstance = viewFirstInstances[range];
+            const auto instanceCount = static_cast<GLsizei>(
+                viewFirstInstances[range + 1] - firstInstance);
+            if (instanceCount == 0)
+            {
+                continue;
+            }
+            if (views.size() > 1)
+            {
+                bindView(views[view]);
+            }
+            bindInstanceRange(firstInstance);
+            ImpostorRenderer::draw(instanceCount);
+            ++frameStatistics_.drawCallCount;
+            frameStatistics_.triangleCount
+                += 2 * static_cast<std::uint64_t>(instanceCount);
+        }
+        if (views.size() > 1)
+        {
+            bindView(views.front());
+        }
+        for (GLuint column = 0; column < 4; ++column)
+        {
+            glDisableVertexAttribArray(WORLD_MATRIX_LOCATION + column);
+        }
+        glDisableVertexAttribArray(COPY_INDEX_LOCATION);
+        glState_.bindVertexArray(vertexArray);
+    };
+    gpuProfiler_.beginPass(GpuPass::Models);
+    if (isDepthPrepassEnabled())
+    {
+        getDepthShader(shaderInstance).use(glState_);
+        setDepthPrepassState();
+        drawViews();
+        drawImpostorViews();
+        computeAmbientOcclusion();
+        shader.use(glState_);
+        glState_.bindVertexArray(vertexArray);
+    }
+    setShadingState();
+    drawViews();
+    drawImpostorViews();
+    gpuProfiler_.endPass();
+
+    // Reset state. Instance attributes are disabled, so that the vertex array
+    // can be drawn without instancing again.
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        glDisableVertexAttribArray(WORLD_MATRIX_LOCATION + column);
+    }
+    glDisableVertexAttribArray(COPY_INDEX_LOCATION);
+}
+
+void Renderer::drawShadowCasters(const Model& model,
+                                 std::span<const glm::mat4> worldMatrices,
+                                 std::uint64_t casterGeneration)
+{
+    PROFILE_SCOPE("Renderer::drawShadowCasters");
+    if (!drawProps_.shadowsEnabled || !shadowMap_.isCreated())
+    {
+        return;
+    }
+#ifndef __EMSCRIPTEN__
+    // Geometry of streamed models is only resident for the camera view, so
+    // they leave the cascades empty
+    const size_t casterCount = model.streamedMesh ? 0 : worldMatrices.size();
+#else
+    const size_t casterCount = worldMatrices.size();
+#endif
+    std::array<bool, ShadowMap::CASCADE_COUNT> staleCascades{};
+    bool anyStale = false;
+    for (size_t cascade = 0; cascade < ShadowMap::CASCADE_COUNT; ++cascade)
+    {
+        staleCascades[cascade]
+            = shadowMap_.isStale(cascade, casterGeneration);
+        anyStale = anyStale || staleCascades[cascade];
+    }
+    if (!anyStale)
+    {
+        return;
+    }
+
+    // All copies are uploaded once and drawn into every stale cascade, left
+    // for the rasterizer to clip instead of culling them per cascade
+    if (casterCount > 0)
+    {
+        const StreamBuffer::Range instanceRange = streamBuffer_.write(
+            std::as_bytes(worldMatrices),
+            sizeof(glm::vec4));
+        getDepthShader(ShaderInstance::InstancedModelShader).use(glState_);
+        glState_.bindVertexArray(model.vertexArray);
+        bindInstanceMatrices(instanceRange.buffer, instanceRange.offset);
+        bindObjectUniforms({
+            .model = model.positionTransform,
+            .mvp = glm::mat4{1.0F},
+            .normalMatrix = glm::mat4{1.0F},
+            .color = glm::vec3{0.0F},
+            .objectId = 0,
+            .transparency = 0.0F,
+            .textureLayer = NO_TEXTURE_LAYER,
+            .padding = {},
+        });
+    }
+
+    gpuProfiler_.beginPass(GpuPass::Shadows);
+    setDepthPrepassState();
+    glViewport(0, 0, shadowMap_.size(), shadowMap_.size());
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
+    for (size_t cascade = 0; cascade < ShadowMap::CASCADE_COUNT; ++cascade)
+    {
+        if (!staleCascades[cascade])
+        {
+            continue;
+        }
+        // Instanced model shader transforms by the view projection of the
+        // frame, which is replaced by the one of the light
+        FrameUniforms cascadeUniforms = frameUniforms_;
+        cascadeUniforms.viewProjection
+            = shadowMap_.lightViewProjections()[cascade];
+        const StreamBuffer::Range cascadeUniformsRange = streamBuffer_.write(
+            std::as_bytes(std::span{&cascadeUniforms, 1}),
+            uniformBufferAlignment_);
+        glBindBufferRange(GL_UNIFORM_BUFFER,
+                          FRAME_DATA_BINDING,
+                          cascadeUniformsRange.buffer,
+                          cascadeUniformsRange.offset,
+                          sizeof(FrameUniforms));
+        shadowMap_.beginCascade(cascade, casterGeneration);
+        if (casterCount > 0)
+        {
+            drawInstances(model,
+                          static_cast<GLsizei>(casterCount),
+                          true,
+                          nullptr);
+        }
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    gpuProfiler_.endPass();
+
+    // Restore scene framebuffer and frame uniforms of the camera
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        glDisableVertexAttribArray(WORLD_MATRIX_LOCATION + column);
+    }
+    bindSceneTarget();
+}
+
+void Renderer::bindInstanceMatrices(GLuint buffer, GLintptr offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    // Matrix attribute is fed as one vec4 attribute per column, advanced once
+    // per instance instead of per vertex
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        const GLuint location = WORLD_MATRIX_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(
+            location,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(glm::mat4),
+            // NOLINTNEXTLINE(performance-no-int-to-ptr)
+            reinterpret_cast<const GLvoid*>(static_cast<size_t>(offset)
+                                            + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void Renderer::drawInstances(const Model& model,
+                             GLsizei instanceCount,
+                             bool indexed,
+                             const ObjectUniforms* materialUniforms)
+{
+    // Sub-meshes of different materials are drawn one by one with the color
+    // of their own
+    if (materialUniforms)
+    {
+        frameStatistics_.drawCallCount
+            += static_cast<std::uint32_t>(model.submeshes.size());
+        for (size_t i = 0; i < model.submeshes.size(); ++i)
+        {
+            ObjectUniforms tinted = *materialUniforms;
+            tinted.color *= model.submeshes[i].baseColor;
+            tinted.textureLayer = model.submeshes[i].textureLayer;
+            bindObjectUniforms(tinted);
+#ifdef __EMSCRIPTEN__
+            if (!indexed)
+            {
+                glDrawArraysInstanced(
+                    GL_TRIANGLES,
+                    static_cast<GLint>(model.submeshes[i].firstIndex),
+                    model.submeshIndexCounts[i],
+                    instanceCount);
+                continue;
+            }
+            glDrawElementsInstanced(GL_TRIANGLES,
+                                    model.submeshIndexCounts[i],
+                                    model.indexType,
+                                    model.submeshIndexOffsets[i],
+                                    instanceCount);
+#else
+            static_cast<void>(indexed);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                                              model.submeshIndexCounts[i],
+                                              model.indexType,
+                                              model.submeshIndexOffsets[i],
+                                              instanceCount,
+                                              model.submeshBaseVertices[i]);
+#endif
+        }
+        frameStatistics_.triangleCount
+            += static_cast<std::uint64_t>(model.indexCount / 3)
+             * static_cast<std::uint64_t>(instanceCount);
+        return;
+    }
+#ifdef __EMSCRIPTEN__
+    // Sub-mesh indices are rebased on import, so a single draw covers them
+    // all
+    ++frameStatistics_.drawCallCount;
+    if (indexed)
+    {
+        glDrawElementsInstanced(GL_TRIANGLES,
+                                model.indexCount,
+                                model.indexType,
+                                nullptr,
+                                instanceCount);
+    }
+    else
+    {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, model.indexCount, instanceCount);
+    }
+#else
+    // Wireframe draws are indexed as well on desktop
+    static_cast<void>(indexed);
+    // There is no multi-draw variant taking instance count in OpenGL 4.3, so
+    // each sub-mesh is drawn separately with all of its instances
+    frameStatistics_.drawCallCount
+        += static_cast<std::uint32_t>(model.submeshIndexCounts.size());
+    for (size_t i = 0; i < model.submeshIndexCounts.size(); ++i)
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                                          model.submeshIndexCounts[i],
+                                          model.indexType,
+                                          model.submeshIndexOffsets[i],
+                                          instanceCount,
+                                          model.submeshBaseVertices[i]);
+    }
+#endif
+    frameStatistics_.triangleCount
+        += static_cast<std::uint64_t>(model.indexCount / 3)
+         * static_cast<std::uint64_t>(instanceCount);
+}
+
+#ifndef __EMSCRIPTEN__
+void Renderer::drawModelIndirect(const Model& model,
+                                 std::span<const glm::mat4> worldMatrices,
+                                 const TransformChanges* transformChanges)
+{
+    PROFILE_SCOPE("Renderer::drawModelIndirect");
+    // Culling and indirect draws cover the camera view only
+    if (!model.arenaMesh || viewCount_ > 1 || stereoActive_)
+    {
+        drawModelInstanced(model, worldMatrices);
+        return;
+    }
+    // Earlier draws keep their order relative to this one
+    submitCommands();
+    // Draw identifiers are copy indices, numbering copies from the first one
+    const std::uint32_t firstObjectId = allocateObjectIds(worldMatrices.size());
+    const ArenaMesh& mesh = model.arenaMesh.value();
+    glState_.bindVertexArray(geometryArena_.vertexArray());
+
+    // Copies are culled on the CPU unless the culling compute pass is going to
+    // do it
+    const bool culled = drawProps_.gpuCullingEnabled && gpuCuller_;
+
+    // Resident transforms are view independent, and only uploaded for
+    // copies that moved since they were last drawn
+    const size_t objectCount = worldMatrices.size();
+    std::pmr::memory_resource* frameMemory = frameAllocator_.resource();
+    {
+        PROFILE_SCOPE("Renderer::updateInstanceBuffer");
+        instanceBuffer_.update(worldMatrices,
+                               mesh.positionTransform,
+                               transformChanges,
+                               streamBuffer_,
+                               storageBufferAlignment_,
+                               threadPool_,
+                               glState_);
+        frameStatistics_.transformUploadSize
+            += instanceBuffer_.lastUploadSize();
+    }
+    std::pmr::vector<std::uint8_t> visibility(objectCount, 1, frameMemory);
+    if (!culled)
+    {
+        threadPool_.parallelFor(
+            objectCount,
+            TRANSFORM_BATCH_SIZE,
+            [&](size_t begin, size_t end)
+            {
+                PROFILE_SCOPE("Renderer::cullCopies");
+                for (size_t i = begin; i < end; ++i)
+                {
+                    visibility[i] = frustum_.intersects(
+                        transformSphere(model.boundingSphere,
+                                        worldMatrices[i]));
+                }
+            });
+    }
+
+    // Every sub-mesh of every copy is a separate draw. Base instance numbers
+    // sub-meshes of each copy one after the other, from which the shaders
+    // find both the data of the copy and the material of the sub-mesh.
+    const size_t submeshCount = mesh.submeshes.size();
+    std::pmr::vector<DrawElementsIndirectCommand> drawCommands(frameMemory);
+    drawCommands.reserve(objectCount * submeshCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        if (!visibility[i])
+        {
+            continue;
+        }
+        for (size_t s = 0; s < submeshCount; ++s)
+        {
+            const Submesh& submesh = mesh.submeshes[s];
+            drawCommands.push_back({
+                .count = submesh.indexCount,
+                .instanceCount = 1,
+                .firstIndex = submesh.firstIndex,
+                .baseVertex = submesh.baseVertex,
+                .baseInstance = static_cast<GLuint>(i * submeshCount + s),
+            });
+        }
+    }
+    // Empty ranges can not be bound
+    if (drawCommands.empty())
+    {
+        return;
+    }
+
+    // Material table holds the sub-mesh count followed by the base color and
+    // texture layer of each sub-mesh, padded to the std430 alignment of its
+    // vec4 array
+    const auto materialTableSize = static_cast<GLsizeiptr>(
+        (1 + submeshCount) * sizeof(glm::vec4));
+    const StreamBuffer::Range materialTableRange = streamBuffer_.write(
+        materialTableSize,
+        storageBufferAlignment_,
+        [&](std::span<std::byte> memory)
+        {
+            const auto count = static_cast<GLuint>(submeshCount);
+            std::memcpy(memory.data(), &count, sizeof(count));
+            auto* materials
+                = reinterpret_cast<glm::vec4*>(memory.data()) + 1;
+            for (size_t s = 0; s < submeshCount; ++s)
+            {
+                materials[s] = glm::vec4{
+                    mesh.submeshes[s].baseColor,
+                    static_cast<float>(mesh.submeshes[s].textureLayer)};
+            }
+        });
+
+    // Draw identifiers only change when more draws are issued than before
+    const size_t drawIdCount = objectCount * submeshCount;
+    if (drawIdCount_ < static_cast<GLsizei>(drawIdCount))
+    {
+        videomemory::release(videomemory::Category::DrawData,
+                             static_cast<size_t>(drawIdCount_)
+                                 * sizeof(GLuint));
+        videomemory::allocate(videomemory::Category::DrawData,
+                              drawIdCount * sizeof(GLuint));
+        drawIdCount_ = static_cast<GLsizei>(drawIdCount);
+        std::pmr::vector<GLuint> drawIds(drawIdCount, frameMemory);
+        std::iota(drawIds.begin(), drawIds.end(), 0);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer_);
+        glBufferData(GL_ARRAY_BUFFER,
+                     static_cast<GLsizeiptr>(drawIds.size() * sizeof(GLuint)),
+                     drawIds.data(),
+                     GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer_);
+    glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    glVertexAttribIPointer(DRAW_ID_LOCATION,
+                           1,
+                           GL_UNSIGNED_INT,
+                           sizeof(GLuint),
+                           nullptr);
+    glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+
+    // Commands are only known after visibility, so they are copied into the
+    // stream buffer once complete. Culling binds them as a shader storage
+    // range, whose offset has to be aligned for it.
+    const StreamBuffer::Range drawCommandsRange = streamBuffer_.write(
+        std::as_bytes(std::span{drawCommands}),
+        std::max(storageBufferAlignment_, GLsizeiptr{sizeof(GLuint)}));
+    const auto drawCommandCount = static_cast<GLsizei>(drawCommands.size());
+
+    // Culling shader is dispatched before binding the model shader, which
+    // the draw call needs to be bound. Culling counts towards model time.
+    gpuProfiler_.beginPass(GpuPass::Models);
+    const GLsizeiptr drawDataSize = instanceBuffer_.size();
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                      DRAW_DATA_BINDING,
+                      instanceBuffer_.buffer(),
+                      0,
+                      drawDataSize);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                      MATERIAL_TABLE_BINDING,
+                      materialTableRange.buffer,
+                      materialTableRange.offset,
+                      materialTableSize);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandsRange.buffer);
+    if (culled)
+    {
+        gpuCuller_->cull(drawCommandsRange,
+                         drawCommandCount,
+                         instanceBuffer_.buffer(),
+                         drawDataSize,
+                         viewProjection_,
+                         static_cast<GLsizei>(submeshCount),
+                         drawProps_.occlusionCullingEnabled,
+                         glState_);
+    }
+    auto& shader = getShader(ShaderInstance::IndirectModelShader);
+    shader.use(glState_);
+    // Transforms and base colors are in shader storage, only color and
+    // identifier are read from the per-object uniforms
+    bindObjectUniforms({
+        .model = glm::mat4{1.0F},
+        .mvp = glm::mat4{1.0F},
+        .normalMatrix = glm::mat4{1.0F},
+        .color = getModelColor(),
+        .objectId = firstObjectId,
+        .transparency = 0.0F,
+        .textureLayer = NO_TEXTURE_LAYER,
+        .padding = {},
+    });
+    bindMaterialTextures(model.textureArray);
+
+    // Issue draw calls. Copies are drawn at full detail, because arena only
+    // holds full detail geometry.
+    std::uint64_t copyTriangleCount = 0;
+    for (const DrawElementsIndirectCommand& command : drawCommands)
+    {
+        copyTriangleCount += command.count / 3;
+    }
+    const auto drawCopies = [&]()
+    {
+        ++frameStatistics_.drawCallCount;
+        frameStatistics_.triangleCount += copyTriangleCount;
+        if (culled)
+        {
+            gpuCuller_->drawVisible();
+        }
+        else
+        {
+            glMultiDrawElementsIndirect(
+                GL_TRIANGLES,
+                GL_UNSIGNED_INT,
+                // NOLINTNEXTLINE(performance-no-int-to-ptr)
+                reinterpret_cast<const GLvoid*>(drawCommandsRange.offset),
+                drawCommandCount,
+                0);
+        }
+    };
+    if (isDepthPrepassEnabled())
+    {
+        getDepthShader(ShaderInstance::IndirectModelShader).use(glState_);
+        setDepthPrepassState();
+        drawCopies();
+        computeAmbientOcclusion();
+        shader.use(glState_);
+        glState_.bindVertexArray(geometryArena_.vertexArray());
+    }
+    setShadingState();
+    drawCopies();
+    if (culled)
+    {
+        // Depth of this frame occludes objects in the next one. Samples are
+        // resolved first, as multisampled depth can not be copied.
+        sceneTarget_.resolveDepth(sceneWidth_, sceneHeight_);
+        gpuCuller_->updateDepthPyramid(sceneWidth_, sceneHeight_, glState_);
+        sceneTarget_.bind();
+    }
+    gpuProfiler_.endPass();
+
+    // Reset state
+    glDisableVertexAttribArray(DRAW_ID_LOCATION);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+#endif
+
+void Renderer::bindMaterialTextures(GLuint textureArray)
+{
+    glState_.bindTexture(MATERIAL_TEXTURE_UNIT,
+                         GL_TEXTURE_2D_ARRAY,
+                         textureArray != 0 ? textureArray : whiteTextureArray_);
+}
+
+void Renderer::bindObjectUniforms(const ObjectUniforms& uniforms)
+{
+    const StreamBuffer::Range range = streamBuffer_.write(
+        std::as_bytes(std::span{&uniforms, 1}),
+        uniformBufferAlignment_);
+    glBindBufferRange(GL_UNIFORM_BUFFER,
+                      OBJECT_DATA_BINDING,
+                      range.buffer,
+                      range.offset,
+                      sizeof(ObjectUniforms));
+}
+
+glm::vec3 Renderer::getModelColor() const
+{
+    return {drawProps_.modelColor[0],
+            drawProps_.modelColor[1],
+            drawProps_.modelColor[2]};
+}
+
+std::uint32_t Renderer::allocateObjectIds(size_t objectCount)
+{
+    const std::uint32_t firstObjectId = nextObjectId_;
+    nextObjectId_ += static_cast<std::uint32_t>(objectCount);
+    return firstObjectId;
+}
+
+Shader& Renderer::getShader(ShaderInstance instance)
+{
+    return shaders_[getShaderIndex(instance)];
+}
+
+Shader& Renderer::getDepthShader(ShaderInstance instance)
+{
+    const size_t modelShaderIndex = static_cast<std::uint8_t>(instance)
+                                  - static_cast<std::uint8_t>(
+                                      ShaderInstance::ModelShader);
+    return shaders_[1 + MODEL_SHADER_COUNT * SHADING_VARIANT_COUNT
+                    + modelShaderIndex];
+}
+
+size_t Renderer::getShaderIndex(ShaderInstance instance) const
+{
+    if (instance == ShaderInstance::SkyboxShader)
+    {
+        return 0;
+    }
+    const size_t variant
+        = drawProps_.overdrawViewEnabled
+            ? OVERDRAW_VARIANT
+            : (drawProps_.diffuseEnabled ? 1U : 0U)
+                  | (drawProps_.specularEnabled ? 2U : 0U)
+                  | (drawProps_.wireframeModeEnabled ? 4U : 0U);
+    const size_t modelShaderIndex = static_cast<std::uint8_t>(instance)
+                                  - static_cast<std::uint8_t>(
+                                      ShaderInstance::ModelShader);
+    return 1 + modelShaderIndex * SHADING_VARIANT_COUNT + variant;
+}
+
+void Renderer::setShadingState()
+{
+    // Depth prepass already wrote the nearest depth of every pixel, so only
+    // fragments of the visible surface are shaded
+    if (isDepthPrepassEnabled())
+    {
+        glState_.setDepthFunc(GL_EQUAL);
+        glState_.setDepthWriteEnabled(false);
+    }
+    else
+    {
+        glState_.setDepthFunc(GL_LESS);
+        glState_.setDepthWriteEnabled(true);
+    }
+    glState_.setColorWriteEnabled(true);
+    // Only the overdraw view adds fragments up, opaque surfaces replace what
+    // is behind them
+    glState_.setBlendEnabled(drawProps_.overdrawViewEnabled);
+#ifndef __EMSCRIPTEN__
+    shadingRateImage_.setEnabled(shadingRateActive_);
+#endif
+}
+
+void Renderer::setDepthPrepassState()
+{
+    glState_.setDepthFunc(GL_LESS);
+    glState_.setDepthWriteEnabled(true);
+    glState_.setColorWriteEnabled(false);
+#ifndef __EMSCRIPTEN__
+    // Depth only passes shade nothing, and shadow maps are not covered by
+    // the image
+    shadingRateImage_.setEnabled(false);
+#endif
+}
+
+bool Renderer::isDepthPrepassEnabled() const
+{
+    return drawProps_.depthPrepassEnabled
+        || (drawProps_.ambientOcclusionEnabled
+            && ambientOcclusion_.isCreated());
+}
+
+void Renderer::computeAmbientOcclusion()
+{
+    // Occlusion of a single view is computed from the whole depth buffer of
+    // the scene framebuffer
+    if (!drawProps_.ambientOcclusionEnabled || !ambientOcclusion_.isCreated()
+        || viewCount_ > 1 || stereoActive_)
+    {
+        return;
+    }
+    gpuProfiler_.beginPass(GpuPass::AmbientOcclusion);
+    // Depth copy and half resolution occlusion only live within the passes.
+    // Vertical blur is drawn into a texture of its own, which takes the
+    // place of the noisy occlusion once the horizontal blur has read it.
+    const glm::ivec2 frameBufferSize{frameBufferWidth_, frameBufferHeight_};
+    const FrameGraph::TextureDesc occlusionDesc{
+        .size = AmbientOcclusion::getOcclusionSize(frameBufferSize),
+        .internalFormat = GL_R8,
+        .filter = GL_NEAREST};
+    struct Resources
+    {
+        FrameGraph::Resource depth;
+        FrameGraph::Resource occlusion;
+        FrameGraph::Resource horizontalBlur;
+        FrameGraph::Resource blur;
+        FrameGraph::Resource result;
+    };
+    frameGraph_.reset();
+    const Resources resources{
+        .depth = frameGraph_.createTexture(
+            "Ambient occlusion depth",
+            {.size = frameBufferSize,
+             .internalFormat = GL_DEPTH_COMPONENT24,
+             .filter = GL_NEAREST}),
+        .occlusion
+        = frameGraph_.createTexture("Ambient occlusion", occlusionDesc),
+        .horizontalBlur = frameGraph_.createTexture(
+            "Ambient occlusion horizontal blur",
+            occlusionDesc),
+        .blur = frameGraph_.createTexture("Ambient occlusion blur",
+                                          occlusionDesc),
+        .result = frameGraph_.importTexture("Ambient occlusion result",
+                                            ambientOcclusion_.texture(),
+                                            frameBufferSize),
+    };
+    frameGraph_.addPass(
+        "Ambient occlusion depth copy",
+        {},
+        {resources.depth},
+        [this, &resources](const FrameGraph& graph)
+        {
+            ambientOcclusion_.copyDepth(graph.target(resources.depth),
+                                        glm::ivec2{sceneWidth_, sceneHeight_});
+        });
+    frameGraph_.addPass(
+        "Ambient occlusion",
+        {resources.depth},
+        {resources.occlusion},
+        [this, &resources](const FrameGraph& graph)
+        {
+            ambientOcclusion_.drawOcclusion(
+                graph.target(resources.depth).texture,
+                graph.target(resources.occlusion),
+                glm::ivec2{sceneWidth_, sceneHeight_},
+                emptyVertexArray_,
+                glState_);
+        });
+    frameGraph_.addPass(
+        "Ambient occlusion horizontal blur",
+        {resources.depth, resources.occlusion},
+        {resources.horizontalBlur},
+        [this, &resources](const FrameGraph& graph)
+        {
+            ambientOcclusion_.blur(graph.target(resources.depth).texture,
+                                   graph.target(resources.occlusion).texture,
+                                   graph.target(resources.horizontalBlur),
+                                   true,
+                                   glm::ivec2{sceneWidth_, sceneHeight_},
+                                   emptyVertexArray_,
+                                   glState_);
+        });
+    frameGraph_.addPass(
+        "Ambient occlusion vertical blur",
+        {resources.depth, resources.horizontalBlur},
+        {resources.blur},
+        [this, &resources](const FrameGraph& graph)
+        {
+            ambientOcclusion_.blur(
+                graph.target(resources.depth).texture,
+                graph.target(resources.horizontalBlur).texture,
+                graph.target(resources.blur),
+                false,
+                glm::ivec2{sceneWidth_, sceneHeight_},
+                emptyVertexArray_,
+                glState_);
+        });
+    frameGraph_.addPass(
+        "Ambient occlusion upsampling",
+        {resources.depth, resources.blur},
+        {resources.result},
+        [this, &resources](const FrameGraph& graph)
+        {
+            ambientOcclusion_.upsample(graph.target(resources.depth).texture,
+                                       graph.target(resources.blur).texture,
+                                       glm::ivec2{sceneWidth_, sceneHeight_},
+                                       emptyVertexArray_,
+                                       glState_);
+        });
+    // Result is sampled by models for the rest of the frame
+    frameGraph_.markOutput(resources.result);
+    frameGraph_.execute(glState_);
+    sceneTarget_.bind();
+    glViewport(0, 0, sceneWidth_, sceneHeight_);
+    gpuProfiler_.beginPass(GpuPass::Models);
+}
+
+void Renderer::updateResolutionScale()
+{
+    PROFILE_SCOPE("Renderer::updateResolutionScale");
+#ifndef __EMSCRIPTEN__
+    // Results are taken even while unused, so that stale ones are not used
+    // after enabling dynamic resolution. Shadow cascades, light assignment,
+    // antialiasing, bloom, tonemapping and UI are left out of scene time, as
+    // their cost barely depends on resolution scale.
+    std::optional<float> elapsedMilliseconds;
+    if (const std::optional<GpuProfiler::PassTimes> passTimes
+        = gpuProfiler_.takeLatestFrame())
+    {
+        elapsedMilliseconds
+            = (*passTimes)[static_cast<size_t>(GpuPass::Clear)]
+            + (*passTimes)[static_cast<size_t>(GpuPass::AmbientOcclusion)]
+            + (*passTimes)[static_cast<size_t>(GpuPass::Models)]
+            + (*passTimes)[static_cast<size_t>(GpuPass::Skybox)];
+        // Frames are measured a few frames late, which mixes up the kinds of
+        // a few frames after switching shading rates
+        float& shadingRateTime = shadingRateActive_
+                                   ? shadingRateTimes_.variableRate
+                                   : shadingRateTimes_.fullRate;
+        shadingRateTime
+            = shadingRateTime > 0.0F
+                ? std::lerp(shadingRateTime,
+                            elapsedMilliseconds.value(),
+                            SHADING_RATE_TIME_WEIGHT)
+                : elapsedMilliseconds.value();
+    }
+    if (drawProps_.dynamicResolutionEnabled)
+    {
+        if (elapsedMilliseconds && elapsedMilliseconds.value() > 0.0F)
+        {
+            // Fragment cost grows with pixel count, which is the square of
+            // the scale
+            const float estimatedScale
+                = dynamicResolutionScale_
+                * std::sqrt(drawProps_.targetGpuTime
+                            / elapsedMilliseconds.value());
+            dynamicResolutionScale_
+                = std::clamp(std::lerp(dynamicResolutionScale_,
+                                       estimatedScale,
+                                       RESOLUTION_SCALE_RATE),
+                             MIN_RESOLUTION_SCALE,
+                             1.0F);
+        }
+        resolutionScale_
+            = std::max(std::round(dynamicResolutionScale_
+                                  / RESOLUTION_SCALE_STEP)
+                           * RESOLUTION_SCALE_STEP,
+                       MIN_RESOLUTION_SCALE);
+        return;
+    }
+#endif
+    resolutionScale_
+        = std::clamp(drawProps_.resolutionScale, MIN_RESOLUTION_SCALE, 1.0F);
+#ifndef __EMSCRIPTEN__
+    // Dynamic resolution continues from the scale chosen manually
+    dynamicResolutionScale_ = resolutionScale_;
+#endif
+}
+
+void Renderer::recordLevelsOfDetail(const Model& model,
+                                    std::span<const Submesh> submeshes,
+                                    const glm::vec3& cameraPosition,
+                                    CommandBuffer& commands) const
+{
+    const lod::View view{
+        .cameraPosition = cameraPosition,
+        .projectionScale = lodProjectionScale_,
+        .errorThreshold = drawProps_.lodErrorThreshold,
+    };
+
+    // Selected meshlets adjacent in the index buffer are merged into a single
+    // range by the command buffer, which is common for full detail meshlets
+    // of the near parts
+    for (const Submesh& submesh : submeshes)
+    {
+        if (submesh.meshletCount == 0)
+        {
+            const std::span<const SubmeshLod> chain
+                = std::span{model.lods}.subspan(submesh.firstLod,
+                                                submesh.lodCount);
+            const std::optional<size_t> level
+                = lod::selectChainLevel(chain, view);
+            if (level)
+            {
+                commands.appendRange({
+                    .firstIndex = chain[*level].firstIndex,
+                    .indexCount = chain[*level].indexCount,
+                    .baseVertex = submesh.baseVertex,
+                });
+            }
+            else
+            {
+                commands.appendRange({
+                    .firstIndex = submesh.firstIndex,
+                    .indexCount = submesh.indexCount,
+                    .baseVertex = submesh.baseVertex,
+                });
+            }
+            continue;
+        }
+        for (const Meshlet& meshlet : std::span{model.meshlets}.subspan(
+                 submesh.firstMeshlet,
+                 submesh.meshletCount))
+        {
+            if (clusterlod::isSelected(meshlet, view))
+            {
+                commands.appendRange({
+                    .firstIndex = meshlet.firstIndex,
+                    .indexCount = meshlet.indexCount,
+                    .baseVertex = submesh.baseVertex,
+                });
+            }
+        }
+    }
+}
+
+void Renderer::drawPointCloud(const PointCloud& pointCloud,
+                              std::span<const glm::mat4> worldMatrices)
+{
+    PROFILE_SCOPE("Renderer::drawPointCloud");
+    // Points are rasterized into a single view
+    if (stereoActive_)
+    {
+        return;
+    }
+    // Earlier draws keep their order relative to this one
+    submitCommands();
+    const glm::vec3 cameraPosition = frameView_.cameraPosition;
+    std::pmr::vector<PointRenderer::Copy> copies{frameAllocator_.resource()};
+    copies.reserve(worldMatrices.size());
+    for (const glm::mat4& worldMatrix : worldMatrices)
+    {
+        const BoundingSphere sphere
+            = transformSphere(pointCloud.boundingSphere, worldMatrix);
+        if (!frustum_.intersects(sphere))
+        {
+            continue;
+        }
+        // Points are shuffled, so that a prefix of them covers the projected
+        // area of the copy as evenly as all of them
+        GLsizei pointCount = pointCloud.pointCount;
+        const float distance = glm::distance(cameraPosition, sphere.center);
+        if (drawProps_.lodEnabled && distance > sphere.radius)
+        {
+            const float projectedRadius
+                = sphere.radius * lodProjectionScale_ / distance;
+            const float coveredPixels
+                = glm::pi<float>() * projectedRadius * projectedRadius;
+            pointCount = static_cast<GLsizei>(std::clamp(
+                coveredPixels * POINTS_PER_PIXEL,
+                static_cast<float>(MIN_POINT_COUNT),
+                static_cast<float>(pointCloud.pointCount)));
+        }
+        copies.push_back({
+            .modelViewProjection = viewProjection_ * worldMatrix
+                                 * pointCloud.positionTransform,
+            .pointCount = pointCount,
+        });
+    }
+    if (copies.empty())
+    {
+        return;
+    }
+
+    // Points are rasterized into the camera view, the bottom-left rectangle
+    // of the scene, whose pixel buffer is created on first use
+    const glm::ivec4& viewport = views_.front().viewport;
+    pointRenderer_.resize(viewport.z, viewport.w);
+    glState_.setDepthFunc(GL_LESS);
+    glState_.setDepthWriteEnabled(true);
+    glState_.setColorWriteEnabled(true);
+    glState_.setBlendEnabled(drawProps_.overdrawViewEnabled);
+    gpuProfiler_.beginPass(GpuPass::Models);
+    frameStatistics_.drawCallCount += pointRenderer_.isComputeRasterized()
+                                        ? 1U
+                                        : static_cast<std::uint32_t>(
+                                              copies.size());
+    pointRenderer_.draw(pointCloud,
+                        copies,
+                        viewport.z,
+                        viewport.w,
+                        emptyVertexArray_,
+                        glState_);
+    gpuProfiler_.endPass();
+}
+
+void Renderer::drawSkybox(const Skybox& skybox)
+{
+    PROFILE_SCOPE("Renderer::drawSkybox");
+    // Overdraw view only counts layers of models
+    if (drawProps_.overdrawViewEnabled)
+    {
+        return;
+    }
+    // Skybox needs to be drawn at the end of the rendering pipeline for
+    // efficiency, not the other way around before objects (like in Painter's
+    // Algorithm).
+    submitCommands();
+    // Skybox has no multiview shader, it is drawn into each eye composed
+    // into the scene instead. Both eyes see it the same, as it does not move
+    // with the camera.
+    composeStereo();
+    const int eyeCount = stereoActive_ ? 2 : 1;
+    const glm::ivec4& viewport = views_.front().viewport;
+    const auto bindEye = [&](int eye)
+    {
+        if (stereoActive_)
+        {
+            glViewport(viewport.x + eye * viewport.z,
+                       viewport.y,
+                       viewport.z,
+                       viewport.w);
+        }
+    };
+    //
+    // Allow skybox pixel depths to pass depth test even when depth buffer is
+    // filled with maximum 1.0 depth values. Everything drawn before skybox
+    // will be displayed in front of skybox.
+    glState_.setDepthFunc(GL_LEQUAL);
+    // Remove camera position transformations but keep rotation by converting
+    // view matrix to mat3 and back. If you don't do this, skybox will be
+    // shown as a shrinked down cube around model.
+    const glm::mat4 normalizedView = glm::mat4(glm::mat3(frameView_.view));
+    // Inverted once on CPU, unprojecting screen corners into view rays in GLSL
+    const glm::mat4 inverseProjectionView
+        = glm::inverse(projection_ * normalizedView);
+#ifndef __EMSCRIPTEN__
+    if (skybox.virtualTexture)
+    {
+        gpuProfiler_.beginPass(GpuPass::Skybox);
+        for (int eye = 0; eye < eyeCount; ++eye)
+        {
+            ++frameStatistics_.drawCallCount;
+            ++frameStatistics_.triangleCount;
+            bindSceneTarget();
+            bindEye(eye);
+            virtualSkybox_.draw(*skybox.virtualTexture,
+                                inverseProjectionView,
+                                sceneWidth_,
+                                sceneHeight_,
+                                emptyVertexArray_,
+                                glState_);
+        }
+        gpuProfiler_.endPass();
+        bindSceneTarget();
+        return;
+    }
+#endif
+    // Set skybox shader
+    auto& shader = getShader(ShaderInstance::SkyboxShader);
+    shader.use(glState_);
+    glState_.bindVertexArray(emptyVertexArray_);
+
+    // Set skybox texture
+    glState_.bindTexture(0, GL_TEXTURE_CUBE_MAP, skybox.textureID);
+
+    // Transfer uniforms
+    shader.setUniform(skyboxInverseProjectionView_, inverseProjectionView);
+    constexpr int textureUnit = 0;
+    shader.setUniform(skyboxTexture_, textureUnit);
+
+    // Issue draw call of a single triangle covering the viewport. Fragments
+    // behind models are rejected by early depth test before shading.
+    gpuProfiler_.beginPass(GpuPass::Skybox);
+    for (int eye = 0; eye < eyeCount; ++eye)
+    {
+        ++frameStatistics_.drawCallCount;
+        ++frameStatistics_.triangleCount;
+        bindEye(eye);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    gpuProfiler_.endPass();
+    if (stereoActive_)
+    {
+        bindView(views_.front());
+    }
+}
+
+void Renderer::bakeImpostor(Model& model)
+{
+    PROFILE_SCOPE("Renderer::bakeImpostor");
+    model.impostor = impostorRenderer_.bake(model, glState_);
 }
@@ -1,49 +1,793 @@
 #ifndef RENDERER_H_
 #define RENDERER_H_
 
+#include "ambientocclusion.h"
+#include "bloom.h"
+#include "commandbuffer.h"
+#include "framegraph.h"
+#include "frameview.h"
+#include "frustum.h"
+#include "glstatecache.h"
+#include "gpuprofiler.h"
+#include "impostor.h"
+#include "lightclusters.h"
+#include "pointrenderer.h"
+#include "renderbackend.h"
+#include "rendertarget.h"
 #include "shader.h"
+#include "shadowmap.h"
+#include "softwareculler.h"
+#include "spatialindex.h"
+#include "stereotarget.h"
+#include "streambuffer.h"
+#include "temporalupscaler.h"
+#include "tonemapper.h"
+#include "transparencytarget.h"
+#include "uioverlay.h"
 
+#ifndef __EMSCRIPTEN__
+#include "clusterstreamer.h"
+#include "geometryarena.h"
+#include "gpuculler.h"
+#include "instancebuffer.h"
+#include "objectpicker.h"
+#include "pixeluploadbuffer.h"
+#include "shadingrateimage.h"
+#include "virtualskybox.h"
+#endif
+#include "glm/mat3x3.hpp"
 #include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
 
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <vector>
 
 class Camera;
+class EditableMesh;
+class FrameAllocator;
+class PointCloud;
 class Skybox;
+class ThreadPool;
 class Model;
 struct DrawProperties;
 struct GLFWwindow;
 
-/// Separation of graphics API-dependent rendering mechanisms.
-class Renderer
+/// Separation of graphics API-dependent rendering mechanisms. Implements the
+/// render backend with OpenGL and OpenGL ES, along with draws and facilities
+/// specific to them.
+class Renderer final : public RenderBackend
 {
 public:
-    Renderer(const DrawProperties& drawProps, const Camera& camera);
+    /// Work submitted to OpenGL by the renderer during a frame. Counted as
+    /// draws are issued, so that collection costs a few additions per draw.
+    struct FrameStatistics
+    {
+        std::uint32_t drawCallCount;
+        /// Triangles submitted by draw calls, including those of depth
+        /// prepass and those culled on the GPU.
+        std::uint64_t triangleCount;
+        /// State changes passed on to OpenGL by the state cache.
+        std::uint32_t stateChangeCount;
+        /// Copies inside the view frustum left out by software occlusion
+        /// culling.
+        std::uint32_t occludedCopyCount;
+        /// Bytes of copy transforms uploaded for indirect draws.
+        std::uint64_t transformUploadSize;
+        /// Passes of frame graphs run and culled.
+        std::uint32_t graphPassCount;
+        std::uint32_t culledGraphPassCount;
+        /// Bytes transient textures would take on their own, and bytes of
+        /// the pool they share instead.
+        std::uint64_t transientRequestedSize;
+        std::uint64_t transientPoolSize;
+    };
+
+#ifndef __EMSCRIPTEN__
+    /// Scene GPU time in milliseconds averaged separately over frames shaded
+    /// at full rate and at variable rate, zero until a frame of the kind was
+    /// measured. Their difference is the time saved by variable rate shading.
+    struct ShadingRateTimes
+    {
+        float fullRate;
+        float variableRate;
+    };
+#endif
+
+    /// Post-processing antialiasing the scene. FXAA is applied while
+    /// tonemapping, temporal upscaling before it.
+    enum class AntialiasingFilter : std::uint8_t
+    {
+        None,
+        Fxaa,
+        Temporal,
+    };
+
+    /// Per-object work of large draws is spread over the thread pool.
+    /// Temporary per-draw data is allocated from the frame allocator.
+    Renderer(const DrawProperties& drawProps,
+             const Camera& camera,
+             ThreadPool& threadPool,
+             FrameAllocator& frameAllocator);
     Renderer(const Renderer&) = delete;
     Renderer& operator=(const Renderer&) = delete;
     Renderer(Renderer&&) noexcept = delete;
     Renderer& operator=(Renderer&&) noexcept = delete;
+    ~Renderer() override;
 
-    /// Load OpenGL function addresses, required shaders and set OpenGL
-    /// capabilities.
+    /// Load OpenGL function addresses, submit required shaders for
+    /// compilation and set OpenGL capabilities.
     bool init(GLFWwindow* window);
-    /// Setup viewport and clear screen
-    void prepareDraw();
-    void drawModel(const Model& model);
-    void drawSkybox(const Skybox& skybox);
+    /// Wait for shader compilation submitted by init() and finish setting up
+    /// shaders. Other initialization work is meant to be done in between, so
+    /// that it overlaps with compilation in the driver.
+    bool finishInit();
+    /// Resize drawing surface to window framebuffer of given size. Meant to be
+    /// called from framebuffer size callback of window.
+    void resize(int frameBufferWidth, int frameBufferHeight);
+    /// Minimized windows have an empty framebuffer, which can not be drawn
+    /// into.
+    [[nodiscard]] bool hasDrawingSurface() const
+    {
+        return frameBufferWidth_ > 0 && frameBufferHeight_ > 0;
+    }
+    /// Point and spot lights shading the next frame, in addition to the
+    /// directional light. Lights are assigned to clusters of the view by
+    /// prepareDraw(), and have to stay alive until then. Lights beyond
+    /// LightClusters::MAX_LIGHT_COUNT are ignored.
+    void setLights(std::span<const PointLight> lights) override
+    {
+        lights_ = lights;
+    }
+    /// Choose resolution scale, bind offscreen scene framebuffer, setup
+    /// viewport and clear screen.
+    void prepareDraw() override;
+    /// Antialias, add bloom to, tonemap and upscale scene drawn since
+    /// prepareDraw() into the default framebuffer, leaving it bound for UI to
+    /// be drawn on top.
+    void finishDraw() override;
+    /// Bind cached UI overlay at window size, cleared for UI to be drawn
+    /// into after finishDraw(). Returns false when the overlay can not be
+    /// created, leaving UI to be drawn into the window directly.
+    bool beginUiOverlay();
+    /// Rebind the window once UI is drawn into the overlay.
+    void endUiOverlay();
+    /// Composite UI drawn into the overlay by this or an earlier frame over
+    /// the window.
+    void drawUiOverlay();
+#ifndef __EMSCRIPTEN__
+    /// Submit scene drawn since prepareDraw() without presenting it, leaving
+    /// the offscreen scene framebuffer bound for reading back its pixels,
+    /// resolved first when multisampled. Pixels are neither tonemapped nor
+    /// bloomed, and are clamped to displayable range when read back.
+    void finishOffscreenDraw();
+    /// Fence GPU work issued so far, marking the end of a presented frame.
+    void fenceFrame();
+    /// Wait for the GPU to finish frames fenced earlier until at most given
+    /// count are left in flight. Drivers otherwise queue up frames
+    /// ahead of the GPU, each adding a frame of latency between input and
+    /// display.
+    void limitFramesInFlight(size_t maxFramesInFlight);
+    /// Upload edits of mesh through the stream buffer of the current frame.
+    /// Called between prepareDraw() and drawing the model of the mesh.
+    void updateEditableMesh(EditableMesh& mesh);
+#endif
+    /// Fraction of window resolution the scene is drawn at along each axis.
+    [[nodiscard]] float resolutionScale() const { return resolutionScale_; }
+    /// Whether both eyes of stereo rendering can be drawn in a single pass,
+    /// which stereo rendering is only offered with.
+    [[nodiscard]] bool isStereoSupported() const
+    {
+        return multiviewSupported_;
+    }
+#ifndef __EMSCRIPTEN__
+    /// Read back identifier of the object drawn at given position of the
+    /// window framebuffer, with origin at the bottom-left corner, when the
+    /// frame is finished. Result is available from pickedObjectId() a frame
+    /// later. Ignored while picking is disabled.
+    void requestPick(glm::ivec2 frameBufferPosition);
+    /// Identifier of the object found at the most recently picked position.
+    /// Zero for background, or while picking is disabled.
+    [[nodiscard]] std::uint32_t pickedObjectId() const
+    {
+        return pickedObjectId_;
+    }
+    /// Whether the GPU supports shading rate images, which variable rate
+    /// shading is only offered with.
+    [[nodiscard]] bool isVariableRateShadingSupported() const
+    {
+        return shadingRateImage_.isSupported();
+    }
+    [[nodiscard]] const ShadingRateTimes& shadingRateTimes() const
+    {
+        return shadingRateTimes_;
+    }
+#endif
+    /// Draw depth of copies of model, one per world matrix, into cascades of
+    /// the shadow map whose projection changed, or all of them when the
+    /// caster generation differs from the one they were drawn with. Meant to
+    /// be called after prepareDraw() and before drawing the scene, with a
+    /// generation changed by the caller whenever copies move or the model is
+    /// replaced. Cascades stay cached while neither happens. Ignored while
+    /// shadows are disabled.
+    ///
+    /// Streamed models cast no shadows, their clusters are selected for the
+    /// camera only.
+    void drawShadowCasters(const Model& model,
+                           std::span<const glm::mat4> worldMatrices,
+                           std::uint64_t casterGeneration) override;
+    /// Draw copies of model with separate draws, one per world matrix. Copies
+    /// are culled, transformed and their level of detail selected on the
+    /// thread pool, recording render commands. Commands of consecutive calls
+    /// are submitted together sorted by sort key before the next draw of
+    /// another kind or finishDraw(). Copies outside of the view frustum are
+    /// left out.
+    ///
+    /// Every draw call numbers its copies as objects for picking in world
+    /// matrix order, continuing from earlier draw calls of the frame.
+    ///
+    /// Given spatial index over the copies narrows them down to those near
+    /// the view frustum before testing them one by one. An index over a
+    /// different number of copies is ignored.
+    void drawModel(const Model& model,
+                   std::span<const glm::mat4> worldMatrices,
+                   const SpatialIndex* spatialIndex = nullptr) override;
+    /// Draw copies of model with a single draw call per sub-mesh, one per
+    /// world matrix. World matrices are expected to consist of rotation,
+    /// translation and uniform scale only. Copies outside of the view frustum
+    /// are left out, and copies covering fewer pixels than the impostor
+    /// screen size are drawn as impostors when the model has one baked.
+    /// Spatial index is used like in drawModel().
+    void drawModelInstanced(
+        const Model& model,
+        std::span<const glm::mat4> worldMatrices,
+        const SpatialIndex* spatialIndex = nullptr) override;
+    /// Draw copies of point cloud, one per world matrix. Copies outside of
+    /// the view frustum are left out, and distant ones are drawn with a
+    /// prefix of their shuffled points matching the pixels they cover while
+    /// level of detail is enabled.
+    ///
+    /// Point clouds can not be picked, and are not shaded by lights, shadows
+    /// or ambient occlusion.
+    void drawPointCloud(const PointCloud& pointCloud,
+                        std::span<const glm::mat4> worldMatrices) override;
+#ifndef __EMSCRIPTEN__
+    /// Draw copies of model from the geometry arena with a single multi-draw
+    /// indirect call covering every sub-mesh of every copy, one copy per world
+    /// matrix. Models not in the arena are drawn with instancing instead.
+    ///
+    /// Transforms of copies stay resident between draws. When changes are
+    /// given relative to the previous draw, only transforms of changed copies
+    /// are uploaded, otherwise every copy is.
+    ///
+    /// Indirect draws are not available in OpenGL ES 3.0.
+    void drawModelIndirect(
+        const Model& model,
+        std::span<const glm::mat4> worldMatrices,
+        const TransformChanges* transformChanges = nullptr);
+
+    /// Shared buffers indirect draws read geometry from.
+    GeometryArena& geometryArena() { return geometryArena_; }
+
+    /// Pool of cluster pages streamed models are drawn from.
+    ClusterStreamer& clusterStreamer() { return clusterStreamer_; }
+    [[nodiscard]] const ClusterStreamer& clusterStreamer() const
+    {
+        return clusterStreamer_;
+    }
+
+    /// Staging memory shared by texture uploads.
+    PixelUploadBuffer& pixelUploadBuffer() { return pixelUploadBuffer_; }
+#endif
+    void drawSkybox(const Skybox& skybox) override;
+
+    /// Bake impostor atlas of model, drawn by drawModelInstanced() in place
+    /// of distant copies. Meant to be called between frames, once after the
+    /// model is created. Streamed models are left without impostor.
+    void bakeImpostor(Model& model);
+
+#ifndef __EMSCRIPTEN__
+    /// Recompile shaders built from any of the changed source files, and swap
+    /// in recompiled shaders the driver finished with. Meant to be called
+    /// between frames. Shaders failing to compile are kept as they were.
+    ///
+    /// Compute shaders of GPU culling are not reloaded.
+    void reloadShaders(std::span<const std::filesystem::path> changedFiles);
+
+    /// Whether recompiled shaders are still waiting for the driver.
+    [[nodiscard]] bool isReloadingShaders() const
+    {
+        return !reloadingShaders_.empty();
+    }
+#endif
+
+    /// Timer of render passes. Passes drawn outside of the renderer, like UI,
+    /// are measured through it as well, until the frame is ended after them.
+    GpuProfiler& gpuProfiler() { return gpuProfiler_; }
+    [[nodiscard]] const GpuProfiler& gpuProfiler() const
+    {
+        return gpuProfiler_;
+    }
+
+    /// Statistics of the frame drawn since the last prepareDraw(), complete
+    /// once finishDraw() returned.
+    [[nodiscard]] const FrameStatistics& frameStatistics() const
+    {
+        return frameStatistics_;
+    }
+
+    /// Number of redundant OpenGL state changes dropped so far.
+    [[nodiscard]] std::uint64_t skippedStateChangeCount() const
+    {
+        return glState_.skippedCallCount();
+    }
 
     // Screen update and buffer swap is responsibility of window
 
 private:
+    /// Position of a recorded command in sorted replay order.
+    struct SortedCommand
+    {
+        std::uint64_t sortKey;
+        std::uint32_t bufferIndex;
+        std::uint32_t commandIndex;
+    };
+
     enum class ShaderInstance : uint8_t
     {
-        ModelShader,
         SkyboxShader,
+        ModelShader,
+        InstancedModelShader,
+        /// Instanced model shader drawing both eyes of stereo rendering.
+        MultiviewModelShader,
+        IndirectModelShader,
     };
 
+    /// Lighting and wireframe permutations compiled for each model shader,
+    /// indexed by diffuse bit, specular bit and wireframe bit, followed by
+    /// the overdraw view counting shaded fragments.
+    static constexpr size_t SHADING_VARIANT_COUNT = 9;
+    static constexpr size_t OVERDRAW_VARIANT = 8;
+    /// Model shaders of shader instances, each having shading variants and a
+    /// depth prepass program.
+#ifdef __EMSCRIPTEN__
+    static constexpr size_t MODEL_SHADER_COUNT = 3;
+#else
+    static constexpr size_t MODEL_SHADER_COUNT = 4;
+#endif
+
+    /// Per-frame data of FrameData uniform block in std140 layout. Three
+    /// component vectors are padded to four, and the block to a multiple of
+    /// four components.
+    struct FrameUniforms
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::mat4 viewProjection;
+        glm::vec4 viewPosition;
+        glm::vec4 lightDirection;
+        /// Highlighted object, zero for none.
+        std::uint32_t selectedObjectId;
+        /// Whether shading samples the shadow map.
+        std::uint32_t shadowsEnabled;
+        /// Point and spot lights assigned to clusters.
+        std::uint32_t lightCount;
+        /// Whether shading samples ambient occlusion.
+        std::uint32_t ambientOcclusionEnabled;
+        std::array<glm::mat4, ShadowMap::CASCADE_COUNT> lightViewProjections;
+        /// View space depth at which each shadow cascade ends.
+        glm::vec4 shadowSplitDepths;
+        /// Scale and bias turning fragment coordinates and view depth into
+        /// light cluster coordinates.
+        glm::vec4 clusterScale;
+        /// View projection of each eye in stereo, both holding the one of the
+        /// camera otherwise.
+        std::array<glm::mat4, 2> eyeViewProjections;
+    };
+
+    /// Per-object data of ObjectData uniform block in std140 layout. Columns
+    /// of normal matrix are padded to four components. Object identifier
+    /// takes the place of the fourth color component.
+    struct ObjectUniforms
+    {
+        glm::mat4 model;
+        glm::mat4 mvp;
+        glm::mat4 normalMatrix;
+        glm::vec3 color;
+        /// Identifier of the object, or of the first copy of instanced and
+        /// indirect draws, which shaders offset by copy index.
+        std::uint32_t objectId;
+        /// Fraction of light passing through sub-meshes of transparent
+        /// materials drawn by the transparency pass, zero for opaque ones.
+        float transparency;
+        /// Layer of the base color texture in the texture array of the
+        /// model, NO_TEXTURE_LAYER for untextured materials.
+        std::int32_t textureLayer;
+        /// Size of std140 blocks is rounded up to a multiple of vec4, and
+        /// bound ranges have to cover it.
+        std::array<float, 2> padding;
+    };
+
+    /// View drawn into a rectangle of the scene framebuffer. The camera view
+    /// comes first, followed by orthographic top, front and side views while
+    /// multiple views are enabled, each taking a quadrant of the scene.
+    struct View
+    {
+        /// Jittered under temporal upscaling for the camera view.
+        glm::mat4 viewProjection;
+        Frustum frustum;
+        /// Origin and size within the scene framebuffer.
+        glm::ivec4 viewport;
+        /// Per-frame uniforms drawn with, selected by binding their range.
+        StreamBuffer::Range frameUniforms;
+    };
+
+    static constexpr size_t MAX_VIEW_COUNT = 4;
+
+    /// Set viewport and per-frame uniforms of view for the draws following.
+    void bindView(const View& view);
+    /// Bind the framebuffer scene draws go into, the stereo target until its
+    /// eyes are composed, and the camera view.
+    void bindSceneTarget();
+    /// Compose eyes drawn so far side by side into the scene framebuffer,
+    /// once per frame. Does nothing outside of stereo.
+    void composeStereo();
+    /// Write object uniforms into the stream buffer and bind them to the
+    /// per-object uniform block.
+    void bindObjectUniforms(const ObjectUniforms& uniforms);
+    /// Bind texture array of model materials, or the white one for zero.
+    void bindMaterialTextures(GLuint textureArray);
+    [[nodiscard]] glm::vec3 getModelColor() const;
+    /// Reserve identifiers of given number of objects drawn by a draw call,
+    /// returning the first.
+    std::uint32_t allocateObjectIds(size_t objectCount);
+
+#ifndef __EMSCRIPTEN__
+    /// Source files and defines a shader was built from, for recompiling it
+    /// when sources change.
+    struct ShaderSource
+    {
+        std::filesystem::path vertexShaderPath;
+        /// Empty for programs without geometry shader.
+        std::filesystem::path geometryShaderPath;
+        std::filesystem::path fragmentShaderPath;
+        std::vector<const char*> defines;
+    };
+
+    /// Recompiled shader waiting for the driver.
+    struct ReloadingShader
+    {
+        size_t shaderIndex;
+        PendingShader pendingShader;
+    };
+#endif
+
+    /// Submit shader for compilation, keeping its sources for reloading.
+    /// Wireframe variants get barycentric coordinates from a geometry shader
+    /// on desktop, and from non-indexed vertex order in OpenGL ES 3.0.
+    void submitShader(const std::filesystem::path& vertexShaderPath,
+                      const std::filesystem::path& fragmentShaderPath,
+                      std::span<const char* const> defines = {},
+                      bool wireframe = false);
+#ifndef __EMSCRIPTEN__
+    /// Submit shader built from kept sources, with or without geometry
+    /// shader.
+    static PendingShader submitShaderSource(const ShaderSource& source);
+#endif
+
+    /// Submit every shading variant of a model shader for compilation, with
+    /// given defines added to each. Without wireframe support, wireframe
+    /// variants repeat the shaded ones.
+    void submitShadingVariants(
+        const std::filesystem::path& vertexShaderPath,
+        const std::filesystem::path& fragmentShaderPath,
+        std::span<const char* const> defines = {},
+        bool wireframeSupported = true);
+
+    /// Assign uniform block bindings and resolve uniform handles of a newly
+    /// created shader.
+    void setupShader(size_t shaderIndex);
+
+    /// Variant of shader matching current shading options. Skybox shader has
+    /// a single variant.
+    [[nodiscard]] Shader& getShader(ShaderInstance instance);
+    /// Depth prepass program of model shader.
+    [[nodiscard]] Shader& getDepthShader(ShaderInstance instance);
+    /// Position of shader variant in shader list, identifying it in sort
+    /// keys.
+    [[nodiscard]] size_t getShaderIndex(ShaderInstance instance) const;
+
+    /// Set rasterization state shared by all model shaders. After a depth
+    /// prepass, depth is only tested for equality without being written.
+    void setShadingState();
+    /// Set state of depth prepass, writing depth without color.
+    void setDepthPrepassState();
+    /// Depth prepass is forced by ambient occlusion, which is computed from
+    /// the depth of the prepass before shading.
+    [[nodiscard]] bool isDepthPrepassEnabled() const;
+    /// Compute ambient occlusion from the depth drawn so far, when enabled.
+    /// Meant to be called between depth prepass and shading, interrupting
+    /// the models pass of the profiler and restoring the scene framebuffer.
+    void computeAmbientOcclusion();
+
+    /// Feed per-instance world matrices of the instanced model shader from
+    /// given offset of a buffer.
+    static void bindInstanceMatrices(GLuint buffer, GLintptr offset);
+    /// Issue instanced draws of every sub-mesh of model, indexed or from
+    /// expanded wireframe vertices. When given, object uniforms are rebound
+    /// before each sub-mesh with their color tinted by its base color,
+    /// otherwise bound uniforms are kept for all of them.
+    void drawInstances(const Model& model,
+                       GLsizei instanceCount,
+                       bool indexed,
+                       const ObjectUniforms* materialUniforms);
+
+    /// Follow resolution scale from UI, or adapt it to GPU time of previous
+    /// frames when dynamic resolution is enabled.
+    void updateResolutionScale();
+#ifndef __EMSCRIPTEN__
+    /// Return to full rate shading, and choose shading rates of the next
+    /// frame from the finished scene when variable rate shading is active.
+    void updateShadingRate();
+#endif
+
+    /// Copies that may be visible in any of given frustums, found through
+    /// spatial index when given one over the same number of copies, otherwise
+    /// every copy in order. Copies are listed once each.
+    std::pmr::vector<std::uint32_t> findCandidateCopies(
+        const SpatialIndex* spatialIndex,
+        size_t copyCount,
+        std::span<const Frustum> frustums) const;
+
+    /// Rasterize occluder of the nearest copies of model on the CPU for
+    /// testing the copies against, when software occlusion culling is
+    /// enabled and model has an occluder. Returns whether copies are to be
+    /// tested.
+    bool renderOccluders(const Model& model,
+                         std::span<const glm::mat4> worldMatrices,
+                         const glm::mat4& viewProjection,
+                         const Frustum& frustum);
+
+    /// Record draw of a single copy of model into command buffer, unless it
+    /// is outside of the view frustum. Touches no graphics state, so that
+    /// copies can be recorded on separate threads.
+    void recordModel(const Model& model,
+                     const glm::mat4& worldMatrix,
+                     size_t shaderIndex,
+                     GLuint depthProgram,
+                     const glm::vec3& color,
+                     std::uint32_t objectId,
+                     CommandBuffer& commands) const;
+
+    /// Append meshlets of cluster level of detail hierarchies and levels of
+    /// discrete level of detail chains of given sub-meshes selected for
+    /// camera position given in model space as ranges of the next command.
+    /// Sub-meshes without either are drawn at full detail.
+    void recordLevelsOfDetail(const Model& model,
+                              std::span<const Submesh> submeshes,
+                              const glm::vec3& cameraPosition,
+                              CommandBuffer& commands) const;
+
+    /// Issue commands recorded since the last submission in ascending sort
+    /// key order. Commands of the transparency pass are kept for
+    /// drawTransparentCommands() instead, as they go after every opaque draw.
+    void submitCommands();
+    /// Declare passes finishing the resolved scene in the frame graph:
+    /// transparent surfaces blended over it when any were recorded, then
+    /// shading rates of the next frame chosen from it.
+    void addScenePasses(FrameGraph::Resource scene);
+    /// Accumulate commands of the transparency pass kept since the start of
+    /// the frame into given transient textures, and blend them over the
+    /// resolved scene. Meant to be called after resolving, leaving a
+    /// framebuffer of resolved scene color bound.
+    void drawTransparentCommands(const FrameGraph::Target& accumulation,
+                                 const FrameGraph::Target& weight);
+    /// Fill frame statistics gathered by state cache and frame graph once
+    /// the frame is finished.
+    void finishFrameStatistics();
+    /// Issue sorted commands with their depth prepass or color pass program.
+    void replaySortedCommands(std::span<const CommandBuffer> commandBuffers,
+                              bool depthOnly);
+
     GLFWwindow* window_;
+    /// Every state change of draws goes through the cache.
+    GlStateCache glState_;
+    /// Size of window framebuffer, which the scene is upscaled to.
+    int frameBufferWidth_;
+    int frameBufferHeight_;
+    /// Scene is drawn offscreen at resolution scale of the window size.
+    RenderTarget sceneTarget_;
+    int sceneWidth_;
+    int sceneHeight_;
+    float resolutionScale_;
+#ifndef __EMSCRIPTEN__
+    /// Unquantized scale, adjusted gradually towards target GPU time.
+    float dynamicResolutionScale_;
+    /// Shading rates of the scene, chosen at the end of each frame for the
+    /// next one.
+    ShadingRateImage shadingRateImage_;
+    /// Whether models of the frame are shaded at rates of the image.
+    bool shadingRateActive_;
+    ShadingRateTimes shadingRateTimes_;
+#endif
+    /// GPU time of each pass of recent frames, including scene draws
+    /// driving dynamic resolution.
+    GpuProfiler gpuProfiler_;
+    FrameStatistics frameStatistics_;
+    /// Issued state changes of the cache when the frame was prepared.
+    std::uint64_t frameStartStateChangeCount_;
+    /// Identifier of the next object drawn in the frame. Objects are numbered
+    /// from one, zero is left for background.
+    std::uint32_t nextObjectId_;
+#ifndef __EMSCRIPTEN__
+    ObjectPicker objectPicker_;
+    /// Position in scene framebuffer to read back when the frame is
+    /// finished.
+    std::optional<glm::ivec2> pickPosition_;
+    std::uint32_t pickedObjectId_;
+#endif
+    /// Cascades of the directional light, drawn by drawShadowCasters().
+    ShadowMap shadowMap_;
+    LightClusters lightClusters_;
+    /// Passes of ambient occlusion and post-processing, declared anew each
+    /// frame, with the transient textures they share.
+    FrameGraph frameGraph_;
+    AmbientOcclusion ambientOcclusion_;
+    TemporalUpscaler temporalUpscaler_;
+    Bloom bloom_;
+    Tonemapper tonemapper_;
+    UiOverlay uiOverlay_;
+    PointRenderer pointRenderer_;
+    /// Both eyes of stereo rendering, created on first use.
+    StereoTarget stereoTarget_;
+    /// Accumulation of transparent surfaces, created on first use.
+    TransparencyTarget transparencyTarget_;
+    ImpostorRenderer impostorRenderer_;
+    SoftwareCuller softwareCuller_;
+    /// Whether sub-meshes of transparent materials are recorded into the
+    /// transparency pass, chosen by prepareDraw(). Otherwise they are drawn
+    /// opaque.
+    bool transparencyActive_;
+    /// Whether OVR_multiview2 is available, without which the multiview
+    /// model shader is compiled as a copy of the instanced one.
+    bool multiviewSupported_;
+    /// Whether the frame is drawn in stereo, chosen by prepareDraw(), and
+    /// whether its eyes were composed into the scene already.
+    bool stereoActive_;
+    bool stereoComposed_;
+    /// Filter chosen for the frame by prepareDraw().
+    AntialiasingFilter antialiasingFilter_;
+    /// View projection of the previous frame without jitter, and the
+    /// transform of clip space of the current frame into it, reprojecting
+    /// temporal history.
+    glm::mat4 previousViewProjection_;
+    glm::mat4 temporalReprojection_;
+    /// Most samples per pixel of multisampled renderbuffers supported by the
+    /// driver, limiting sample count of antialiasing modes.
+    int maxSampleCount_;
+#ifndef __EMSCRIPTEN__
+    /// Most samples per pixel of integer renderbuffers, limiting sample count
+    /// while object identifiers are drawn.
+    int maxIntegerSampleCount_;
+#endif
+    /// Point and spot lights of the frame, set by setLights().
+    std::span<const PointLight> lights_;
+    /// Frame uniforms of the camera, bound again after drawing shadow
+    /// cascades with their own.
+    FrameUniforms frameUniforms_;
+    StreamBuffer::Range frameUniformsRange_;
+    /// Rebuilt only when window is resized or field of view changes.
     glm::mat4 projection_;
+    bool projectionDirty_;
+    /// Field of view generation of DrawProperties the projection was built
+    /// with.
+    std::uint32_t projectionFovGeneration_;
+    /// Whether the projection was built for the aspect ratio of an eye.
+    bool projectionStereo_;
+    /// Camera view shared by passes, rebuilt when camera or projection
+    /// changed.
+    FrameView frameView_;
+    /// Camera view projection draws are made with, jittered under temporal
+    /// upscaling.
+    glm::mat4 viewProjection_;
+    /// World space view frustum of the frame, for skipping draws of
+    /// off-screen objects. Encloses both eyes in stereo.
+    Frustum frustum_;
+    /// Pixels covered by unit length at unit distance from camera, for
+    /// projecting geometric error of meshlets onto screen.
+    float lodProjectionScale_;
+    /// Views of the frame, the camera view first. Copies drawn with
+    /// instancing are culled against all of them in a single pass, then drawn
+    /// into each view from their own range of one upload. Other draws only
+    /// show in the camera view.
+    std::array<View, MAX_VIEW_COUNT> views_;
+    size_t viewCount_;
+    /// Render commands recorded by each thread pool task of a draw, reused
+    /// between frames to avoid allocations. Only the first ones are recorded
+    /// since the last submission.
+    std::vector<CommandBuffer> commandBuffers_;
+    size_t commandBufferCount_;
+    /// Commands of the transparency pass moved out of submitted command
+    /// buffers, drawn once the opaque scene is complete.
+    CommandBuffer transparentCommands_;
+    std::vector<SortedCommand> sortedCommands_;
+    std::vector<SortedCommand> sortScratch_;
+#ifndef __EMSCRIPTEN__
+    /// Ranges of a replayed command in the layout taken by multi-draw.
+    std::vector<GLsizei> rangeIndexCounts_;
+    std::vector<const GLvoid*> rangeIndexOffsets_;
+    std::vector<GLint> rangeBaseVertices_;
+#endif
+    /// Frame and object uniforms, instance transforms, per-draw data and
+    /// draw commands, rewritten every frame.
+    StreamBuffer streamBuffer_;
+    /// Offset alignment of uniform block ranges required by the driver.
+    GLsizeiptr uniformBufferAlignment_;
+#ifndef __EMSCRIPTEN__
+    GeometryArena geometryArena_;
+    ClusterStreamer clusterStreamer_;
+    PixelUploadBuffer pixelUploadBuffer_;
+    /// Draws skyboxes of virtual textured faces.
+    VirtualSkybox virtualSkybox_;
+    /// Empty until initialized.
+    std::optional<GpuCuller> gpuCuller_;
+    /// Transforms of copies drawn indirectly.
+    InstanceBuffer instanceBuffer_;
+    /// Offset alignment of shader storage ranges required by the driver.
+    GLsizeiptr storageBufferAlignment_;
+    /// Fences of presented frames the GPU may still be working on, oldest
+    /// first.
+    std::deque<GLsync> frameFences_;
+    /// Consecutive integers fetched by base instance of draw commands, grown
+    /// to the largest draw count so far.
+    GLuint drawIdBuffer_;
+    GLsizei drawIdCount_;
+#endif
+    /// Skybox shader followed by every shading variant of each model shader,
+    /// in shader instance order.
     std::vector<Shader> shaders_;
+    /// Shaders submitted by init() in the same order, empty once finished.
+    std::vector<PendingShader> pendingShaders_;
+    std::optional<AmbientOcclusion::PendingShaders>
+        pendingAmbientOcclusionShaders_;
+    std::optional<PendingShader> pendingTemporalUpscalerShader_;
+    std::optional<Bloom::PendingShaders> pendingBloomShaders_;
+    std::vector<PendingShader> pendingTonemapperShaders_;
+    std::optional<PendingShader> pendingUiOverlayShader_;
+    std::optional<PointRenderer::PendingShaders> pendingPointRendererShaders_;
+    std::optional<PendingShader> pendingStereoShader_;
+    std::optional<PendingShader> pendingTransparencyShader_;
+    std::optional<ImpostorRenderer::PendingShaders> pendingImpostorShaders_;
+#ifndef __EMSCRIPTEN__
+    std::optional<GpuCuller::PendingShaders> pendingCullerShaders_;
+    std::optional<PendingShader> pendingInstanceBufferShader_;
+    std::optional<PendingShader> pendingLightClusterShader_;
+    std::optional<PendingShader> pendingShadingRateShader_;
+    std::optional<VirtualSkybox::PendingShaders> pendingVirtualSkyboxShaders_;
+    std::optional<PendingShader> pendingGeometryArenaShader_;
+    /// Sources of shaders in the same order.
+    std::vector<ShaderSource> shaderSources_;
+    std::vector<ReloadingShader> reloadingShaders_;
+#endif
+    /// Vertex array without attributes for drawing vertices generated in
+    /// shaders, as core profile draws need a vertex array bound.
+    GLuint emptyVertexArray_;
+    /// Texture array of a single white layer, bound in place of the texture
+    /// array of models without textured materials, so that model shaders
+    /// always sample a complete texture.
+    GLuint whiteTextureArray_;
+    UniformHandle<glm::mat4> skyboxInverseProjectionView_;
+    UniformHandle<int> skyboxTexture_;
     const DrawProperties& drawProps_;
     const Camera& camera_;
+    ThreadPool& threadPool_;
+    FrameAllocator& frameAllocator_;
 };
 #endif
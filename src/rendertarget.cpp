@@ -0,0 +1,340 @@
+#include "rendertarget.h"
+
+#include "videomemory.h"
+
+#include <array>
+
+namespace
+{
+/// Bytes per pixel of 24-bit depth attachments, assuming depth is padded to
+/// 32 bits.
+constexpr size_t DEPTH_PIXEL_SIZE = 4;
+/// Bytes per pixel of R32UI object identifier attachment.
+constexpr size_t OBJECT_ID_PIXEL_SIZE = 4;
+/// Draw buffers of the resolve framebuffer outside of resolving object
+/// identifiers.
+constexpr std::array<GLenum, 1> COLOR_DRAW_BUFFERS{GL_COLOR_ATTACHMENT0};
+
+/// Allocate storage of renderbuffer, multisampled when sample count is
+/// greater than one.
+void allocateRenderbuffer(GLuint renderbuffer,
+                          GLenum internalFormat,
+                          int sampleCount,
+                          int width,
+                          int height)
+{
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER,
+                                     sampleCount > 1 ? sampleCount : 0,
+                                     internalFormat,
+                                     width,
+                                     height);
+}
+
+/// Create renderbuffer when it is needed but missing, or delete it when it
+/// is present but no longer needed.
+void updateRenderbuffer(GLuint& renderbuffer, bool needed)
+{
+    if (needed && !renderbuffer)
+    {
+        glGenRenderbuffers(1, &renderbuffer);
+    }
+    else if (!needed && renderbuffer)
+    {
+        glDeleteRenderbuffers(1, &renderbuffer);
+        renderbuffer = 0;
+    }
+}
+
+/// Attach color, depth and object identifier attachments to the bound
+/// framebuffer, and tell whether the driver accepts it. Color is a texture
+/// when color renderbuffer is zero. Object identifier attachment is detached
+/// when zero.
+bool attach(GLuint colorTexture,
+            GLuint colorRenderbuffer,
+            GLuint depthRenderbuffer,
+            GLuint objectIdRenderbuffer)
+{
+    if (colorRenderbuffer)
+    {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                                  GL_COLOR_ATTACHMENT0,
+                                  GL_RENDERBUFFER,
+                                  colorRenderbuffer);
+    }
+    else
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D,
+                               colorTexture,
+                               0);
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER,
+                              depthRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_COLOR_ATTACHMENT1,
+                              GL_RENDERBUFFER,
+                              objectIdRenderbuffer);
+    // Draw buffers are framebuffer state, so they are only set here
+    const std::array<GLenum, 2> drawBuffers{GL_COLOR_ATTACHMENT0,
+                                            GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(objectIdRenderbuffer ? 2 : 1, drawBuffers.data());
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+}  // namespace
+
+RenderTarget::RenderTarget()
+    : framebuffer_{0}
+    , colorTexture_{0}
+    , colorRenderbuffer_{0}
+    , depthRenderbuffer_{0}
+    , objectIdRenderbuffer_{0}
+    , resolveFramebuffer_{0}
+    , resolveDepthRenderbuffer_{0}
+    , resolveObjectIdRenderbuffer_{0}
+    , colorFormat_{GL_RGBA16F}
+    , width_{0}
+    , height_{0}
+    , sampleCount_{1}
+{
+}
+
+RenderTarget::~RenderTarget()
+{
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &colorTexture_);
+    glDeleteRenderbuffers(1, &colorRenderbuffer_);
+    glDeleteRenderbuffers(1, &depthRenderbuffer_);
+    glDeleteRenderbuffers(1, &objectIdRenderbuffer_);
+    glDeleteFramebuffers(1, &resolveFramebuffer_);
+    glDeleteRenderbuffers(1, &resolveDepthRenderbuffer_);
+    glDeleteRenderbuffers(1, &resolveObjectIdRenderbuffer_);
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+}
+
+size_t RenderTarget::colorPixelSize(GLenum internalFormat)
+{
+    return internalFormat == GL_RGBA16F ? 8 : 4;
+}
+
+void RenderTarget::allocateColorTexture(GLuint texture,
+                                        GLenum internalFormat,
+                                        int width,
+                                        int height)
+{
+    // OpenGL ES 3.0 only accepts half float format with half float or float
+    // pixel types, even without pixels to upload
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 static_cast<GLint>(internalFormat),
+                 width,
+                 height,
+                 0,
+                 GL_RGBA,
+                 internalFormat == GL_RGBA16F ? GL_HALF_FLOAT
+                                              : GL_UNSIGNED_BYTE,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool RenderTarget::resize(int width,
+                          int height,
+                          int sampleCount,
+                          bool objectIdsEnabled)
+{
+    if (width == width_ && height == height_ && sampleCount == sampleCount_
+        && objectIdsEnabled == hasObjectIds())
+    {
+        return true;
+    }
+    const bool multisampled = sampleCount > 1;
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    if (!framebuffer_)
+    {
+        glGenFramebuffers(1, &framebuffer_);
+        glGenTextures(1, &colorTexture_);
+        glGenRenderbuffers(1, &depthRenderbuffer_);
+    }
+    // Identifier attachment and resolve framebuffer are dropped while
+    // unused, so that they take neither memory nor bandwidth
+    updateRenderbuffer(objectIdRenderbuffer_, objectIdsEnabled);
+    updateRenderbuffer(colorRenderbuffer_, multisampled);
+    if (multisampled && !resolveFramebuffer_)
+    {
+        glGenFramebuffers(1, &resolveFramebuffer_);
+    }
+    else if (!multisampled && resolveFramebuffer_)
+    {
+        glDeleteFramebuffers(1, &resolveFramebuffer_);
+        resolveFramebuffer_ = 0;
+    }
+    updateRenderbuffer(resolveDepthRenderbuffer_, multisampled);
+    updateRenderbuffer(resolveObjectIdRenderbuffer_,
+                       multisampled && objectIdsEnabled);
+    width_ = width;
+    height_ = height;
+    sampleCount_ = sampleCount;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize());
+
+    // Renderbuffer and texture storage is mutable, so attachments are
+    // resized in place. Post-processing passes filter color while
+    // upscaling, and clamp samples to the edge of the scene.
+    allocateColorTexture(colorTexture_, colorFormat_, width, height);
+    if (colorRenderbuffer_)
+    {
+        allocateRenderbuffer(colorRenderbuffer_,
+                             colorFormat_,
+                             sampleCount,
+                             width,
+                             height);
+    }
+    allocateRenderbuffer(depthRenderbuffer_,
+                         GL_DEPTH_COMPONENT24,
+                         sampleCount,
+                         width,
+                         height);
+    if (objectIdRenderbuffer_)
+    {
+        allocateRenderbuffer(objectIdRenderbuffer_,
+                             GL_R32UI,
+                             sampleCount,
+                             width,
+                             height);
+    }
+    if (resolveDepthRenderbuffer_)
+    {
+        allocateRenderbuffer(resolveDepthRenderbuffer_,
+                             GL_DEPTH_COMPONENT24,
+                             1,
+                             width,
+                             height);
+    }
+    if (resolveObjectIdRenderbuffer_)
+    {
+        allocateRenderbuffer(resolveObjectIdRenderbuffer_,
+                             GL_R32UI,
+                             1,
+                             width,
+                             height);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    bool complete = attach(colorTexture_,
+                           colorRenderbuffer_,
+                           depthRenderbuffer_,
+                           objectIdRenderbuffer_);
+    if (resolveFramebuffer_)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer_);
+        complete = attach(colorTexture_,
+                          0,
+                          resolveDepthRenderbuffer_,
+                          resolveObjectIdRenderbuffer_)
+                && complete;
+        // Blitting color writes into every draw buffer, which would convert
+        // color into object identifiers. Identifiers are resolved with their
+        // own draw buffers instead.
+        glDrawBuffers(1, COLOR_DRAW_BUFFERS.data());
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+size_t RenderTarget::videoMemorySize() const
+{
+    const size_t pixelCount
+        = static_cast<size_t>(width_) * static_cast<size_t>(height_);
+    const size_t objectIdPixelSize
+        = objectIdRenderbuffer_ ? OBJECT_ID_PIXEL_SIZE : 0;
+    const size_t drawnPixelSize
+        = colorPixelSize(colorFormat_) + DEPTH_PIXEL_SIZE + objectIdPixelSize;
+    size_t pixelSize = static_cast<size_t>(sampleCount_) * drawnPixelSize;
+    if (isMultisampled())
+    {
+        pixelSize += drawnPixelSize;
+    }
+    return pixelCount * pixelSize;
+}
+
+void RenderTarget::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+}
+
+void RenderTarget::resolve(int width, int height)
+{
+    if (!isMultisampled())
+    {
+        return;
+    }
+    // Multisampled blits resolve samples, and need rectangles of equal size
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer_);
+    glBlitFramebuffer(0,
+                      0,
+                      width,
+                      height,
+                      0,
+                      0,
+                      width,
+                      height,
+                      GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                      GL_NEAREST);
+    if (resolveObjectIdRenderbuffer_)
+    {
+        // Integer samples are resolved by taking one of them, never blending
+        // identifiers
+        const std::array<GLenum, 2> objectIdDrawBuffers{GL_NONE,
+                                                        GL_COLOR_ATTACHMENT1};
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glDrawBuffers(2, objectIdDrawBuffers.data());
+        glBlitFramebuffer(0,
+                          0,
+                          width,
+                          height,
+                          0,
+                          0,
+                          width,
+                          height,
+                          GL_COLOR_BUFFER_BIT,
+                          GL_NEAREST);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glDrawBuffers(1, COLOR_DRAW_BUFFERS.data());
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+}
+
+void RenderTarget::resolveDepth(int width, int height)
+{
+    if (!isMultisampled())
+    {
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer_);
+    glBlitFramebuffer(0,
+                      0,
+                      width,
+                      height,
+                      0,
+                      0,
+                      width,
+                      height,
+                      GL_DEPTH_BUFFER_BIT,
+                      GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+}
@@ -0,0 +1,141 @@
+#ifndef RENDER_TARGET_H_
+#define RENDER_TARGET_H_
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/vec2.hpp"
+
+#include <cstddef>
+
+/// Rectangle at the bottom-left corner of a texture sampled by
+/// post-processing passes, as their textures are allocated at full window
+/// size while the scene may cover only part of them.
+struct TextureRegion
+{
+    GLuint texture;
+    glm::ivec2 size;
+    glm::ivec2 textureSize;
+};
+
+/// Offscreen framebuffer the scene is drawn into, so that it can be rendered
+/// at lower resolution than the window and upscaled afterwards.
+///
+/// Storage is allocated at full window size and the scene is drawn into a
+/// rectangle at its bottom-left corner, so changing resolution scale does not
+/// reallocate attachments. Color is drawn straight into a texture sampled by
+/// post-processing passes. Depth is stored in a renderbuffer, as it is only
+/// blitted and copied, never sampled.
+///
+/// Color is stored in half float format for high dynamic range rendering,
+/// keeping light brighter than white until it is tonemapped for display.
+///
+/// For picking, identifiers of drawn objects can be written into an extra
+/// 32-bit unsigned integer attachment, attached only while enabled.
+///
+/// For antialiasing, attachments can be multisampled. Multisampled
+/// attachments can neither be sampled, read back nor blitted with scaling,
+/// so they are renderbuffers whose samples are resolved into the color
+/// texture of a single-sampled framebuffer first.
+///
+/// Framebuffer is created on first resize. Non-copyable, non-movable.
+class RenderTarget
+{
+public:
+    RenderTarget();
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+    RenderTarget(RenderTarget&&) = delete;
+    RenderTarget& operator=(RenderTarget&&) = delete;
+    ~RenderTarget();
+
+    /// Bytes per pixel of color format.
+    [[nodiscard]] static size_t colorPixelSize(GLenum internalFormat);
+
+    /// Allocate mutable storage of texture of given color format, filtered
+    /// bilinearly and clamped to the edge, as post-processing passes expect.
+    /// Leaves no texture bound.
+    static void allocateColorTexture(GLuint texture,
+                                     GLenum internalFormat,
+                                     int width,
+                                     int height);
+
+    /// Set internal format of color attachments, GL_RGBA16F by default, or
+    /// GL_RGBA8 where floating point color is not renderable. Has to be
+    /// called before the first resize.
+    void setColorFormat(GLenum internalFormat)
+    {
+        colorFormat_ = internalFormat;
+    }
+
+    [[nodiscard]] GLenum colorFormat() const { return colorFormat_; }
+
+    /// Recreate attachments when their size or sample count changes, and
+    /// attach or detach object identifier attachment. Sample count of one
+    /// disables multisampling. Returns false when the driver rejects one of
+    /// the framebuffers.
+    bool resize(int width,
+                int height,
+                int sampleCount,
+                bool objectIdsEnabled);
+
+    /// Whether object identifiers are drawn into the second color attachment.
+    [[nodiscard]] bool hasObjectIds() const
+    {
+        return objectIdRenderbuffer_ != 0;
+    }
+
+    [[nodiscard]] bool isMultisampled() const { return sampleCount_ > 1; }
+
+    /// Single-sampled color, drawn into directly or filled by resolve()
+    /// when multisampled.
+    [[nodiscard]] GLuint colorTexture() const { return colorTexture_; }
+
+    /// Single-sampled depth, drawn into directly or filled by resolve()
+    /// when multisampled.
+    [[nodiscard]] GLuint resolvedDepthRenderbuffer() const
+    {
+        return isMultisampled() ? resolveDepthRenderbuffer_
+                                : depthRenderbuffer_;
+    }
+
+    /// Bind framebuffer for drawing and reading.
+    void bind();
+
+    /// Resolve samples of rectangle of given size at the bottom-left corner
+    /// into the color texture, along with depth and object identifiers, and
+    /// leave the resolve framebuffer bound for reading. Does nothing when not
+    /// multisampled, as the scene is single-sampled already.
+    void resolve(int width, int height);
+
+    /// Resolve only depth of rectangle of given size when multisampled,
+    /// leaving the resolve framebuffer bound for reading, so that depth can
+    /// be copied into textures. Does nothing when not multisampled.
+    void resolveDepth(int width, int height);
+
+private:
+    /// Video memory taken by attachments in bytes.
+    [[nodiscard]] size_t videoMemorySize() const;
+
+    GLuint framebuffer_;
+    GLuint colorTexture_;
+    /// Zero while not multisampled, as color is drawn into the texture then.
+    GLuint colorRenderbuffer_;
+    GLuint depthRenderbuffer_;
+    /// Zero while object identifiers are disabled.
+    GLuint objectIdRenderbuffer_;
+    /// Zero while not multisampled, as depth and object identifiers are
+    /// read from the drawn framebuffer then.
+    GLuint resolveFramebuffer_;
+    GLuint resolveDepthRenderbuffer_;
+    GLuint resolveObjectIdRenderbuffer_;
+    GLenum colorFormat_;
+    int width_;
+    int height_;
+    int sampleCount_;
+};
+
+#endif
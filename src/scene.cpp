@@ -0,0 +1,100 @@
+#include "scene.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+Scene::Scene()
+    : generation_{0}
+{
+}
+
+EntityId Scene::createEntity(EntityId parent)
+{
+    assert(parent == NO_PARENT || parent < size());
+    const auto entity = static_cast<EntityId>(size());
+    parents_.push_back(parent);
+    positions_.emplace_back(0.0F);
+    rotations_.emplace_back(1.0F, 0.0F, 0.0F, 0.0F);
+    scales_.emplace_back(1.0F);
+    worldMatrices_.emplace_back(1.0F);
+    dirty_.push_back(1);
+    return entity;
+}
+
+void Scene::clear()
+{
+    parents_.clear();
+    positions_.clear();
+    rotations_.clear();
+    scales_.clear();
+    worldMatrices_.clear();
+    dirty_.clear();
+    changedEntities_.clear();
+    ++generation_;
+}
+
+void Scene::setPosition(EntityId entity, const glm::vec3& position)
+{
+    // Setting an unchanged value keeps the subtree clean, allowing callers to
+    // apply their state every frame
+    if (positions_[entity] != position)
+    {
+        positions_[entity] = position;
+        dirty_[entity] = 1;
+    }
+}
+
+void Scene::setRotation(EntityId entity, const glm::quat& rotation)
+{
+    if (rotations_[entity] != rotation)
+    {
+        rotations_[entity] = rotation;
+        dirty_[entity] = 1;
+    }
+}
+
+void Scene::setScale(EntityId entity, const glm::vec3& scale)
+{
+    if (scales_[entity] != scale)
+    {
+        scales_[entity] = scale;
+        dirty_[entity] = 1;
+    }
+}
+
+void Scene::updateWorldMatrices()
+{
+    // Parents precede their children, so dirtiness of a parent is already
+    // final when its children are visited
+    changedEntities_.clear();
+    for (size_t i = 0; i < size(); ++i)
+    {
+        const EntityId parent = parents_[i];
+        if (parent != NO_PARENT && dirty_[parent])
+        {
+            dirty_[i] = 1;
+        }
+        if (!dirty_[i])
+        {
+            continue;
+        }
+
+        const glm::mat4 local
+            = glm::scale(glm::translate(glm::mat4{1.0F}, positions_[i])
+                             * glm::mat4_cast(rotations_[i]),
+                         scales_[i]);
+        worldMatrices_[i]
+            = parent != NO_PARENT ? worldMatrices_[parent] * local : local;
+        changedEntities_.push_back(static_cast<EntityId>(i));
+    }
+    if (!changedEntities_.empty())
+    {
+        ++generation_;
+    }
+
+    // Cleared in a separate pass, because children compare against dirtiness
+    // of their parent during the first one
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+}
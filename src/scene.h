@@ -0,0 +1,81 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "glm/gtc/quaternion.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+/// Index of an entity in the scene.
+using EntityId = uint32_t;
+
+/// Hierarchy of entities placed by local transforms relative to their parent.
+///
+/// Transform components are stored as structure of arrays, so that updating
+/// world matrices walks contiguous arrays instead of chasing pointers between
+/// scattered nodes. Entities are stored in creation order, and parents have to
+/// be created before their children, which makes a single forward pass enough
+/// to propagate changes from parents to their whole subtree.
+///
+/// Changing a local transform marks the entity dirty, and only world matrices
+/// of dirty entities and their descendants are recomputed on update.
+class Scene
+{
+public:
+    static constexpr EntityId NO_PARENT = std::numeric_limits<EntityId>::max();
+
+    Scene();
+
+    /// Add entity with identity local transform. Parent has to exist already.
+    EntityId createEntity(EntityId parent = NO_PARENT);
+    /// Remove all entities.
+    void clear();
+
+    void setPosition(EntityId entity, const glm::vec3& position);
+    void setRotation(EntityId entity, const glm::quat& rotation);
+    void setScale(EntityId entity, const glm::vec3& scale);
+
+    /// Recompute world matrices of entities whose local transform or any
+    /// ancestor changed since last update.
+    void updateWorldMatrices();
+
+    [[nodiscard]] size_t size() const { return parents_.size(); }
+    [[nodiscard]] EntityId parent(EntityId entity) const
+    {
+        return parents_[entity];
+    }
+    /// Incremented by every update that changed any world matrix, and by
+    /// removing entities, so that results derived from world matrices can be
+    /// kept until it changes.
+    [[nodiscard]] std::uint32_t generation() const { return generation_; }
+    /// Entities whose world matrix was recomputed by the last update, in
+    /// ascending order.
+    [[nodiscard]] std::span<const EntityId> changedEntities() const
+    {
+        return changedEntities_;
+    }
+    /// World matrices indexed by entity. Only valid after update.
+    [[nodiscard]] std::span<const glm::mat4> worldMatrices() const
+    {
+        return worldMatrices_;
+    }
+
+private:
+    std::vector<EntityId> parents_;
+    std::vector<glm::vec3> positions_;
+    std::vector<glm::quat> rotations_;
+    std::vector<glm::vec3> scales_;
+    std::vector<glm::mat4> worldMatrices_;
+    // Not std::vector<bool>, which packs bits and makes every access a
+    // read-modify-write
+    std::vector<uint8_t> dirty_;
+    std::vector<EntityId> changedEntities_;
+    std::uint32_t generation_;
+};
+
+#endif
@@ -1,13 +1,19 @@
 #include "shader.h"
 
+#include "assetfs.h"
+#include "embeddedshaders.h"
 #include "utils.h"
+#ifndef __EMSCRIPTEN__
+#include "programcache.h"
+#endif
 
 #include "glm/gtc/type_ptr.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cstdio>
-#include <fstream>
-#include <ios>
 #include <utility>
+#include <vector>
 
 #ifndef NDEBUG
 #define ASSERT_UNIFORM(name) assertUniform((name))
@@ -17,39 +23,134 @@
 
 namespace fs = std::filesystem;
 
+namespace
+{
+/// Sources edited while running, read from their files instead of the
+/// embedded copies. Only accessed from the thread shaders are submitted from.
+std::vector<fs::path> overriddenEmbeddedPaths;
+}  // namespace
+
 std::optional<Shader> Shader::createFromFile(const fs::path& vertexShaderPath,
                                              const fs::path& fragmentShaderPath)
 {
-    // Compile vertex shader
-    const auto vertexShader = compile(vertexShaderPath, GL_VERTEX_SHADER);
-    if (!vertexShader)
-    {
-        return std::nullopt;
-    }
+    return submitFromFile(vertexShaderPath, fragmentShaderPath).finish();
+}
+
+#ifndef __EMSCRIPTEN__
+std::optional<Shader> Shader::createComputeFromFile(
+    const fs::path& computeShaderPath)
+{
+    return submitComputeFromFile(computeShaderPath).finish();
+}
+#endif
+
+PendingShader Shader::submitFromFile(const fs::path& vertexShaderPath,
+                                     const fs::path& fragmentShaderPath,
+                                     std::span<const char* const> defines)
+{
+    const std::array<StageSource, 2> sources{
+        addDefines(readFile(vertexShaderPath), defines),
+        addDefines(readFile(fragmentShaderPath), defines)};
+    constexpr std::array<GLenum, 2> shaderTypes{GL_VERTEX_SHADER,
+                                                GL_FRAGMENT_SHADER};
+    return submitSources(sources, shaderTypes);
+}
 
-    // Compile fragment shader
-    const auto fragmentShader = compile(fragmentShaderPath, GL_FRAGMENT_SHADER);
-    if (!fragmentShader)
+#ifndef __EMSCRIPTEN__
+PendingShader Shader::submitWithGeometryFromFile(
+    const fs::path& vertexShaderPath,
+    const fs::path& geometryShaderPath,
+    const fs::path& fragmentShaderPath,
+    std::span<const char* const> defines)
+{
+    const std::array<StageSource, 3> sources{
+        addDefines(readFile(vertexShaderPath), defines),
+        addDefines(readFile(geometryShaderPath), defines),
+        addDefines(readFile(fragmentShaderPath), defines)};
+    constexpr std::array<GLenum, 3> shaderTypes{GL_VERTEX_SHADER,
+                                                GL_GEOMETRY_SHADER,
+                                                GL_FRAGMENT_SHADER};
+    return submitSources(sources, shaderTypes);
+}
+
+PendingShader Shader::submitComputeFromFile(const fs::path& computeShaderPath)
+{
+    const std::array<StageSource, 1> sources{readFile(computeShaderPath)};
+    constexpr std::array<GLenum, 1> shaderTypes{GL_COMPUTE_SHADER};
+    return submitSources(sources, shaderTypes);
+}
+#endif
+
+PendingShader Shader::submitSources(std::span<const StageSource> sources,
+                                    std::span<const GLenum> shaderTypes)
+{
+    assert(sources.size() == shaderTypes.size()
+           && sources.size() <= PendingShader::MAX_STAGE_COUNT);
+    std::array<GLenum, PendingShader::MAX_STAGE_COUNT> stageTypes{};
+    std::copy(shaderTypes.begin(), shaderTypes.end(), stageTypes.begin());
+#ifndef __EMSCRIPTEN__
+    // Skip compilation when the driver accepts program binary from previous
+    // launch
+    std::array<std::uint64_t, PendingShader::MAX_STAGE_COUNT> sourceHashes{};
+    std::ranges::transform(sources,
+                           sourceHashes.begin(),
+                           &StageSource::hash);
+    const uint64_t cacheKey = programcache::computeKey(
+        std::span{sourceHashes.data(), sources.size()});
+    if (const std::optional<GLuint> cachedProgram
+        = programcache::load(cacheKey))
     {
-        glDeleteShader(vertexShader.value());
-        return std::nullopt;
+        return PendingShader{cachedProgram.value(), {}, stageTypes};
     }
+#endif
 
-    // Link shader program
+    // Link right away without checking compile status, so that the driver
+    // can carry on with linking in the background. Failed compilation makes
+    // linking fail.
+    std::array<GLuint, PendingShader::MAX_STAGE_COUNT> shaders{};
     GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader.value());
-    glAttachShader(shaderProgram, fragmentShader.value());
+#ifndef __EMSCRIPTEN__
+    glProgramParameteri(shaderProgram,
+                        GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+#endif
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        shaders[i] = compile(sources[i].text, shaderTypes[i]);
+        glAttachShader(shaderProgram, shaders[i]);
+    }
     glLinkProgram(shaderProgram);
-    // Vertex and fragment shader not needed anymore after linked as part for
-    // program.
-    glDeleteShader(vertexShader.value());
-    glDeleteShader(fragmentShader.value());
-    if (!checkLinkerErrors(shaderProgram))
+
+    PendingShader pendingShader{shaderProgram, shaders, stageTypes};
+#ifndef __EMSCRIPTEN__
+    pendingShader.cacheKey_ = cacheKey;
+#endif
+    return pendingShader;
+}
+
+void Shader::enableParallelCompilation()
+{
+    // Maximum value leaves thread count up to the driver
+    constexpr GLuint driverChosenThreadCount = 0xFFFFFFFF;
+    if (GLAD_GL_KHR_parallel_shader_compile)
     {
-        return std::nullopt;
+        glMaxShaderCompilerThreadsKHR(driverChosenThreadCount);
+    }
+#ifndef __EMSCRIPTEN__
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(driverChosenThreadCount);
     }
+#endif
+}
 
-    return Shader{shaderProgram};
+void Shader::overrideEmbeddedSource(const fs::path& path)
+{
+    if (std::ranges::find(overriddenEmbeddedPaths, path)
+        == overriddenEmbeddedPaths.end())
+    {
+        overriddenEmbeddedPaths.push_back(path);
+    }
 }
 
 Shader::Shader()
@@ -68,15 +169,12 @@ Shader::Shader(const GLuint shaderProgram)
 
 Shader::~Shader()
 {
-    glDeleteShader(shaderProgram_);
+    glDeleteProgram(shaderProgram_);
 }
 
 Shader::Shader(Shader&& other) noexcept
     : shaderProgram_{std::exchange(other.shaderProgram_, 0)}
     , uniformCache_{std::move(other.uniformCache_)}
-#ifndef __EMSCRIPTEN__
-    , subroutineIndices_{std::move(other.subroutineIndices_)}
-#endif
 {
 }
 
@@ -84,80 +182,129 @@ Shader& Shader::operator=(Shader&& other) noexcept
 {
     std::swap(shaderProgram_, other.shaderProgram_);
     uniformCache_ = std::move(other.uniformCache_);
-#ifndef __EMSCRIPTEN__
-    subroutineIndices_ = std::move(other.subroutineIndices_);
-#endif
     return *this;
 }
 
-void Shader::use() const
+void Shader::use(GlStateCache& glState) const
+{
+    glState.useProgram(shaderProgram_);
+}
+
+void Shader::bindUniformBlock(const char* name, GLuint binding)
+{
+    const GLuint blockIndex = glGetUniformBlockIndex(shaderProgram_, name);
+    if (blockIndex != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(shaderProgram_, blockIndex, binding);
+    }
+}
+
+void Shader::setUniform(UniformHandle<int> handle, int v)
+{
+    glUniform1i(handle.location, v);
+}
+
+void Shader::setUniform(UniformHandle<bool> handle, bool v)
+{
+    glUniform1i(handle.location, v);
+}
+
+void Shader::setUniform(UniformHandle<float> handle, float v)
 {
-    glUseProgram(shaderProgram_);
+    glUniform1f(handle.location, v);
 }
 
-template <>
-void Shader::setUniform(const std::string& name, const int& v)
+void Shader::setUniform(UniformHandle<std::array<float, 3>> handle,
+                        const std::array<float, 3>& v)
 {
-    ASSERT_UNIFORM(name);
-    glUniform1i(uniformCache_.at(name), v);
+    glUniform3fv(handle.location, 1, v.data());
 }
 
-template <>
-void Shader::setUniform(const std::string& name, const bool& v)
+void Shader::setUniform(UniformHandle<glm::vec2> handle, const glm::vec2& v)
 {
-    ASSERT_UNIFORM(name);
-    glUniform1i(uniformCache_.at(name), v);
+    glUniform2fv(handle.location, 1, glm::value_ptr(v));
 }
 
-template <>
-void Shader::setUniform(const std::string& name, const std::array<float, 3>& v)
+void Shader::setUniform(UniformHandle<glm::vec3> handle, const glm::vec3& v)
 {
-    ASSERT_UNIFORM(name);
-    glUniform3fv(uniformCache_.at(name), 1, v.data());
+    glUniform3fv(handle.location, 1, glm::value_ptr(v));
 }
 
-template <>
-void Shader::setUniform(const std::string& name, const glm::vec3& v)
+void Shader::setUniform(UniformHandle<glm::vec4> handle, const glm::vec4& v)
 {
-    ASSERT_UNIFORM(name);
-    glUniform3fv(uniformCache_.at(name), 1, glm::value_ptr(v));
+    glUniform4fv(handle.location, 1, glm::value_ptr(v));
 }
 
-template <>
-void Shader::setUniform(const std::string& name, const glm::mat3& v)
+void Shader::setUniform(UniformHandle<glm::mat3> handle, const glm::mat3& v)
 {
-    ASSERT_UNIFORM(name);
-    glUniformMatrix3fv(uniformCache_.at(name), 1, GL_FALSE, glm::value_ptr(v));
+    glUniformMatrix3fv(handle.location, 1, GL_FALSE, glm::value_ptr(v));
 }
 
-template <>
-void Shader::setUniform(const std::string& name, const glm::mat4& v)
+void Shader::setUniform(UniformHandle<glm::mat4> handle, const glm::mat4& v)
 {
-    ASSERT_UNIFORM(name);
-    glUniformMatrix4fv(uniformCache_.at(name), 1, GL_FALSE, glm::value_ptr(v));
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(v));
 }
 
-std::optional<GLuint> Shader::compile(const fs::path& shaderPath,
-                                      const GLenum shaderTpye)
+GLuint Shader::compile(const std::string& shaderSrc, const GLenum shaderTpye)
 {
-    const std::string shaderSrc = readFile(shaderPath);
     const GLchar* shaderGlSrc = shaderSrc.c_str();
     const GLuint shader = glCreateShader(shaderTpye);
     glShaderSource(shader, 1, &shaderGlSrc, nullptr);
     glCompileShader(shader);
-    return checkCompileErrors(shader, shaderTpye)
-             ? std::optional<GLuint>{shader}
-             : std::nullopt;
+    return shader;
+}
+
+Shader::StageSource Shader::readFile(const fs::path& shaderPath)
+{
+    if (std::ranges::find(overriddenEmbeddedPaths, shaderPath)
+        == overriddenEmbeddedPaths.end())
+    {
+        if (const embeddedshaders::Source* source
+            = embeddedshaders::find(shaderPath))
+        {
+            return StageSource{
+                .text = std::string{source->text},
+                .hash = source->hash,
+            };
+        }
+    }
+    // Missing source fails to compile, which is reported with the stage
+    const std::optional<AssetData> data = assetfs::readFile(shaderPath);
+    const std::string_view text = data ? data->text() : std::string_view{};
+    return StageSource{
+        .text = std::string{text},
+        .hash = embeddedshaders::hashBytes(text),
+    };
 }
 
-std::string Shader::readFile(const fs::path& shaderPath)
+Shader::StageSource Shader::addDefines(StageSource source,
+                                       std::span<const char* const> defines)
 {
-    std::ifstream file(shaderPath, std::ios::binary | std::ios::ate);
-    std::streamsize fileSize(file.tellg());
-    file.seekg(0);
-    std::string shaderSrc(fileSize, '\0');
-    file.read(shaderSrc.data(), fileSize);
-    return shaderSrc;
+    if (defines.empty())
+    {
+        return source;
+    }
+
+    // Version directive has to stay the first line of GLSL source
+    std::string defineLines;
+    for (const char* define : defines)
+    {
+        defineLines += "#define ";
+        defineLines += define;
+        defineLines += '\n';
+    }
+    size_t insertPosition = 0;
+    if (source.text.starts_with("#version"))
+    {
+        const size_t lineEnd = source.text.find('\n');
+        insertPosition
+            = lineEnd == std::string::npos ? source.text.size() : lineEnd + 1;
+    }
+    source.text.insert(insertPosition, defineLines);
+    // Hash of the file contents is carried on instead of hashing the whole
+    // source again
+    source.hash = embeddedshaders::hashBytes(defineLines, source.hash);
+    return source;
 }
 
 bool Shader::checkCompileErrors(const GLuint shaderID, const GLenum shaderType)
@@ -172,10 +319,24 @@ bool Shader::checkCompileErrors(const GLuint shaderID, const GLenum shaderType)
         char* message
             = static_cast<char*>(alloca(messageLength * sizeof(char)));
         glGetShaderInfoLog(shaderID, messageLength, nullptr, message);
-        utils::showErrorMessage(
-            shaderType == GL_VERTEX_SHADER ? "vertex" : "fragment",
-            " shader compile error: ",
-            message);
+        const char* shaderTypeName = "fragment";
+        if (shaderType == GL_VERTEX_SHADER)
+        {
+            shaderTypeName = "vertex";
+        }
+#ifndef __EMSCRIPTEN__
+        else if (shaderType == GL_GEOMETRY_SHADER)
+        {
+            shaderTypeName = "geometry";
+        }
+        else if (shaderType == GL_COMPUTE_SHADER)
+        {
+            shaderTypeName = "compute";
+        }
+#endif
+        utils::showErrorMessage(shaderTypeName,
+                                " shader compile error: ",
+                                message);
     }
 
     return success;
@@ -199,23 +360,6 @@ bool Shader::checkLinkerErrors(const GLuint shaderID)
     return success;
 }
 
-#ifndef __EMSCRIPTEN__
-void Shader::updateSubroutines(const GLenum shaderType,
-                               const std::vector<std::string>& names)
-{
-    // TODO: Clearing subroutine indices on every frame update is slow
-    subroutineIndices_.clear();
-    for (const std::string& name : names)
-    {
-        subroutineIndices_.push_back(
-            glGetSubroutineIndex(shaderProgram_, shaderType, name.c_str()));
-    }
-    glUniformSubroutinesuiv(GL_FRAGMENT_SHADER,
-                            static_cast<GLsizei>(subroutineIndices_.size()),
-                            subroutineIndices_.data());
-}
-#endif
-
 void Shader::cacheActiveUniforms()
 {
     GLint uniformCount = 0;
@@ -243,22 +387,129 @@ void Shader::cacheActiveUniforms()
                            uniformNameBuffer.data());
         const GLint uniformLocation
             = glGetUniformLocation(shaderProgram_, uniformNameBuffer.data());
-        uniformCache_.emplace(std::string(uniformNameBuffer.data(), bufferSize),
-                              uniformLocation);
+        uniformCache_.push_back(CachedUniform{
+            .hash = hashUniformName(
+                std::string_view{uniformNameBuffer.data(),
+                                 static_cast<size_t>(bufferSize)}),
+            .location = uniformLocation,
+        });
+    }
+    std::sort(uniformCache_.begin(),
+              uniformCache_.end(),
+              [](const CachedUniform& a, const CachedUniform& b)
+              { return a.hash < b.hash; });
+}
+
+GLint Shader::getUniformLocation(UniformName name) const
+{
+    const auto it = std::lower_bound(
+        uniformCache_.begin(),
+        uniformCache_.end(),
+        name.hash,
+        [](const CachedUniform& uniform, std::uint32_t hash)
+        { return uniform.hash < hash; });
+    if (it == uniformCache_.end() || it->hash != name.hash)
+    {
+        ASSERT_UNIFORM(name);
+        return -1;
     }
+    return it->location;
 }
 
 #ifndef NDEBUG
-void Shader::assertUniform(const std::string& name)
+void Shader::assertUniform(UniformName name)
+{
+    std::cerr << "uniform is not present in compiled shader code. Either "
+                 "does not exists in original GLSL source code or the uniform "
+                 "is not active and was optimized out by shader compiler: "
+              << name.name << '\n';
+    assert(false);
+}
+#endif
+
+PendingShader::PendingShader(
+    GLuint program,
+    const std::array<GLuint, MAX_STAGE_COUNT>& shaders,
+    const std::array<GLenum, MAX_STAGE_COUNT>& shaderTypes)
+    : program_{program}
+    , shaders_{shaders}
+    , shaderTypes_{shaderTypes}
+{
+}
+
+PendingShader::PendingShader(PendingShader&& other) noexcept
+    : program_{std::exchange(other.program_, 0)}
+    , shaders_{std::exchange(other.shaders_, {})}
+    , shaderTypes_{other.shaderTypes_}
+#ifndef __EMSCRIPTEN__
+    , cacheKey_{std::exchange(other.cacheKey_, std::nullopt)}
+#endif
+{
+}
+
+PendingShader& PendingShader::operator=(PendingShader&& other) noexcept
+{
+    std::swap(program_, other.program_);
+    std::swap(shaders_, other.shaders_);
+    std::swap(shaderTypes_, other.shaderTypes_);
+#ifndef __EMSCRIPTEN__
+    std::swap(cacheKey_, other.cacheKey_);
+#endif
+    return *this;
+}
+
+PendingShader::~PendingShader()
+{
+    for (const GLuint shader : shaders_)
+    {
+        glDeleteShader(shader);
+    }
+    glDeleteProgram(program_);
+}
+
+bool PendingShader::isReady() const
 {
-    if (!uniformCache_.contains(name))
+    bool parallelCompilation = GLAD_GL_KHR_parallel_shader_compile;
+#ifndef __EMSCRIPTEN__
+    parallelCompilation
+        = parallelCompilation || GLAD_GL_ARB_parallel_shader_compile;
+#endif
+    if (!parallelCompilation)
     {
-        std::cerr
-            << "uniform is not present in compiled shader code. Either "
-               "does not exists in original GLSL source code or the uniform is "
-               "not active and was optimized out by shader compiler: "
-            << name << '\n';
-        assert(false);
+        return true;
     }
+    GLint completed = GL_FALSE;
+    glGetProgramiv(program_, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed;
 }
+
+std::optional<Shader> PendingShader::finish()
+{
+    const GLuint program = std::exchange(program_, 0);
+    // Compile errors explain the link error they cause, so they are reported
+    // first. Shaders are not needed anymore after linked as part of program.
+    bool compiled = true;
+    for (size_t i = 0; i < MAX_STAGE_COUNT; ++i)
+    {
+        const GLuint shader = std::exchange(shaders_[i], 0);
+        if (shader)
+        {
+            compiled = Shader::checkCompileErrors(shader, shaderTypes_[i])
+                    && compiled;
+            glDeleteShader(shader);
+        }
+    }
+    if (!compiled || !Shader::checkLinkerErrors(program))
+    {
+        glDeleteProgram(program);
+        return std::nullopt;
+    }
+#ifndef __EMSCRIPTEN__
+    if (cacheKey_)
+    {
+        programcache::store(cacheKey_.value(), program);
+    }
 #endif
+
+    return Shader{program};
+}
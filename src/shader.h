@@ -1,6 +1,8 @@
 #ifndef SHADER_H_
 #define SHADER_H_
 
+#include "glstatecache.h"
+
 #ifdef __EMSCRIPTEN__
 #include "glad/gles2.h"
 #else
@@ -8,16 +10,60 @@
 #endif
 #include "glm/mat4x3.hpp"
 #include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
 
 #include <array>
+#include <cstdint>
 #include <filesystem>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
 #include <vector>
 
+/// 32-bit FNV-1a hash of uniform name, identifying uniforms in the location
+/// cache of shaders.
+constexpr std::uint32_t hashUniformName(std::string_view name)
+{
+    std::uint32_t hash = 2166136261U;
+    for (const char c : name)
+    {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/// Uniform name hashed at compile time, so that resolving uniform locations
+/// does not construct or hash strings at runtime.
+struct UniformName
+{
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    consteval UniformName(const char* uniformName)
+        : name{uniformName}
+        , hash{hashUniformName(uniformName)}
+    {
+    }
+
+    const char* name;
+    std::uint32_t hash;
+};
+
+/// Location of a uniform of type T resolved once after shader link. Setting a
+/// value through a handle does no lookup at all.
+///
+/// Default handle refers to location -1, for which OpenGL silently ignores
+/// uniform updates.
+template <typename T>
+struct UniformHandle
+{
+    GLint location = -1;
+};
+
+class PendingShader;
+
 /// Wrapper around shader with helper operations
 /// for loading, compiling, binding, uniform value update.
 ///
@@ -28,9 +74,56 @@ class Shader
 {
 public:
     /// Factory method compiling vertex and fragment shaders from GLSL files.
+    /// On desktop, linked program is loaded from program binary cache when
+    /// GLSL sources and graphics driver are unchanged since it was stored.
     static std::optional<Shader> createFromFile(
         const std::filesystem::path& vertexShaderPath,
         const std::filesystem::path& fragmentShaderPath);
+#ifndef __EMSCRIPTEN__
+    /// Factory method compiling compute shader from GLSL file.
+    ///
+    /// Compute shaders are only supported from OpenGL 4.3+ and are not
+    /// available in OpenGL ES 3.0.
+    static std::optional<Shader> createComputeFromFile(
+        const std::filesystem::path& computeShaderPath);
+#endif
+
+    /// Submit vertex and fragment shaders from GLSL files for compilation and
+    /// linking without waiting for the driver to finish, so that several
+    /// programs compile at once while other work is done in the meantime.
+    ///
+    /// Each define is prepended to both sources as "#define <define>" after
+    /// the version directive, specializing the shader into a variant.
+    static PendingShader submitFromFile(
+        const std::filesystem::path& vertexShaderPath,
+        const std::filesystem::path& fragmentShaderPath,
+        std::span<const char* const> defines = {});
+#ifndef __EMSCRIPTEN__
+    /// Submit vertex, geometry and fragment shaders from GLSL files for
+    /// compilation and linking, with defines prepended to every stage.
+    ///
+    /// Geometry shaders are not available in OpenGL ES 3.0.
+    static PendingShader submitWithGeometryFromFile(
+        const std::filesystem::path& vertexShaderPath,
+        const std::filesystem::path& geometryShaderPath,
+        const std::filesystem::path& fragmentShaderPath,
+        std::span<const char* const> defines = {});
+    /// Submit compute shader from GLSL file for compilation and linking
+    /// without waiting for the driver to finish.
+    static PendingShader submitComputeFromFile(
+        const std::filesystem::path& computeShaderPath);
+#endif
+
+    /// Let the driver compile and link shaders on as many background threads
+    /// as it sees fit. Takes effect only with KHR_parallel_shader_compile,
+    /// otherwise the driver may still compile in the background, but is not
+    /// required to.
+    static void enableParallelCompilation();
+
+    /// Read source at path from its file from now on instead of the copy
+    /// embedded into the executable, so that edited sources are picked up
+    /// when reloaded.
+    static void overrideEmbeddedSource(const std::filesystem::path& path);
 
     Shader(const Shader& other) = delete;
     Shader& operator=(const Shader& other) = delete;
@@ -39,29 +132,64 @@ public:
 
     ~Shader();
 
-    /// Bind shader to graphics pipeline to use for draw calls.
-    void use() const;
+    /// Bind shader to graphics pipeline to use for draw calls. Binding is
+    /// skipped when the shader is already in use.
+    void use(GlStateCache& glState) const;
+
+    /// Program object, for binding through the state cache from recorded
+    /// render commands.
+    [[nodiscard]] GLuint program() const { return shaderProgram_; }
 
+    /// Resolve location of active uniform. Meant to be called once after
+    /// shader creation, keeping the handle for uniform updates in the
+    /// rendering loop.
     template <typename T>
-    void setUniform(const std::string& name, const T& v);
+    [[nodiscard]] UniformHandle<T> getUniformHandle(UniformName name) const
+    {
+        return UniformHandle<T>{.location = getUniformLocation(name)};
+    }
+
+    // Shader has to be in use when updating uniform
+    void setUniform(UniformHandle<int> handle, int v);
+    void setUniform(UniformHandle<bool> handle, bool v);
+    void setUniform(UniformHandle<float> handle, float v);
+    void setUniform(UniformHandle<std::array<float, 3>> handle,
+                    const std::array<float, 3>& v);
+    void setUniform(UniformHandle<glm::vec2> handle, const glm::vec2& v);
+    void setUniform(UniformHandle<glm::vec3> handle, const glm::vec3& v);
+    void setUniform(UniformHandle<glm::vec4> handle, const glm::vec4& v);
+    void setUniform(UniformHandle<glm::mat3> handle, const glm::mat3& v);
+    void setUniform(UniformHandle<glm::mat4> handle, const glm::mat4& v);
+
+    /// Assign uniform block to buffer binding point. Done on CPU side, because
+    /// OpenGL ES 3.0 can not assign bindings in GLSL source. Blocks missing
+    /// from the shader are ignored.
+    void bindUniformBlock(const char* name, GLuint binding);
 
-#ifndef __EMSCRIPTEN__
-    /// Change subroutines to use in shader based on list of subroutine names.
-    ///
-    /// Subroutines are analogous to C function pointers and is an efficient way
-    /// to customize parts of the shader program to execute.
-    ///
-    /// Shader subroutines are only supported from OpenGL 4.0+ and are not
-    /// available in OpenGL ES 3.0.
-    void updateSubroutines(const GLenum shaderType,
-                           const std::vector<std::string>& names);
-#endif
 
 private:
-    static std::optional<GLuint> compile(
-        const std::filesystem::path& shaderPath,
-        const GLenum shaderTpye);
-    static std::string readFile(const std::filesystem::path& shaderPath);
+    friend class PendingShader;
+
+    /// GLSL source of a program stage, with hash of its text identifying it
+    /// for the program binary cache.
+    struct StageSource
+    {
+        std::string text;
+        std::uint64_t hash;
+    };
+
+    /// Submit sources of program stages for compilation and linking, or load
+    /// the program from program binary cache.
+    static PendingShader submitSources(std::span<const StageSource> sources,
+                                       std::span<const GLenum> shaderTypes);
+    /// Submit shader source for compilation. Status is checked when the
+    /// program it is linked into is finished.
+    static GLuint compile(const std::string& shaderSrc,
+                          const GLenum shaderTpye);
+    /// Embedded source hashed at compile time, unless overridden by its file.
+    static StageSource readFile(const std::filesystem::path& shaderPath);
+    static StageSource addDefines(StageSource source,
+                                  std::span<const char* const> defines);
     static bool checkCompileErrors(const GLuint shaderID,
                                    const GLenum shaderType);
     static bool checkLinkerErrors(const GLuint shaderID);
@@ -69,12 +197,17 @@ private:
     Shader();
     explicit Shader(const GLuint shaderProgram);
 
-    GLuint shaderProgram_;
-    std::unordered_map<std::string, GLint> uniformCache_;
+    /// Location of active uniform identified by hash of its name.
+    struct CachedUniform
+    {
+        std::uint32_t hash;
+        GLint location;
+    };
 
-#ifndef __EMSCRIPTEN__
-    std::vector<GLuint> subroutineIndices_;
-#endif
+    GLuint shaderProgram_;
+    /// Sorted by hash. Programs have only a handful of uniforms, so a
+    /// contiguous array searched by bisection beats a node-based hash map.
+    std::vector<CachedUniform> uniformCache_;
 
     /// Query all active uniforms on shader creation and cache uniform locations
     /// for access by name. This is done to avoid repeated calls to
@@ -86,25 +219,58 @@ private:
     /// only active uniforms are compiled into the shader program and unused
     /// uniforms are discarded.
     void cacheActiveUniforms();
+    [[nodiscard]] GLint getUniformLocation(UniformName name) const;
 #ifndef NDEBUG
-    /// Catch non-existent active uniform
-    /// errors during development in debug build (disabled release build to
-    /// avoid overhead of uniform existence checks).
-    void assertUniform(const std::string& name);
+    /// Catch non-existent active uniform errors during development in debug
+    /// build, once lookup did not find the uniform (disabled in release build
+    /// to avoid overhead of reporting).
+    static void assertUniform(UniformName name);
 #endif
 };
 
-template <>
-void Shader::setUniform(const std::string& name, const int& v);
-template <>
-void Shader::setUniform(const std::string& name, const bool& v);
-template <>
-void Shader::setUniform(const std::string& name, const std::array<float, 3>& v);
-template <>
-void Shader::setUniform(const std::string& name, const glm::vec3& v);
-template <>
-void Shader::setUniform(const std::string& name, const glm::mat3& v);
-template <>
-void Shader::setUniform(const std::string& name, const glm::mat4& v);
+/// Shader program submitted for compilation and linking, whose status is not
+/// checked yet. Querying status right after submission would stall until the
+/// driver finishes, so it is deferred until the program is needed.
+///
+/// Non-copyable, move-only. Program is deleted on destruction unless finished.
+class PendingShader
+{
+public:
+    PendingShader(const PendingShader& other) = delete;
+    PendingShader& operator=(const PendingShader& other) = delete;
+    PendingShader(PendingShader&& other) noexcept;
+    PendingShader& operator=(PendingShader&& other) noexcept;
+
+    ~PendingShader();
+
+    /// Poll whether compilation and linking finished, without blocking. Always
+    /// reported as finished without KHR_parallel_shader_compile, in which case
+    /// finish() blocks instead.
+    [[nodiscard]] bool isReady() const;
+
+    /// Check compile and link status, waiting for the driver to finish when
+    /// needed. Pending shader is left empty afterwards.
+    std::optional<Shader> finish();
+
+private:
+    friend class Shader;
+
+    /// Shader stages of a program, vertex, geometry and fragment or compute
+    /// only.
+    static constexpr size_t MAX_STAGE_COUNT = 3;
+
+    PendingShader(GLuint program,
+                  const std::array<GLuint, MAX_STAGE_COUNT>& shaders,
+                  const std::array<GLenum, MAX_STAGE_COUNT>& shaderTypes);
+
+    GLuint program_;
+    /// Zero for unused stages and for programs loaded from program cache.
+    std::array<GLuint, MAX_STAGE_COUNT> shaders_;
+    std::array<GLenum, MAX_STAGE_COUNT> shaderTypes_;
+#ifndef __EMSCRIPTEN__
+    /// Program binary is stored once linked, unless it was loaded from cache.
+    std::optional<std::uint64_t> cacheKey_;
+#endif
+};
 
 #endif
@@ -0,0 +1,205 @@
+#include "shadingrateimage.h"
+
+#include "videomemory.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Work group size declared by the compute shader.
+constexpr GLuint GROUP_SIZE = 8;
+
+/// Rates selected by palette indices written by the compute shader.
+constexpr std::array<GLenum, 3> PALETTE{
+    GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+    GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV,
+    GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV,
+};
+
+GLuint getGroupCount(int invocationCount)
+{
+    return (static_cast<GLuint>(invocationCount) + GROUP_SIZE - 1)
+         / GROUP_SIZE;
+}
+}  // namespace
+
+ShadingRateImage::ShadingRateImage()
+    : sceneUniform_{}
+    , sceneWidthUniform_{}
+    , sceneHeightUniform_{}
+    , tileWidthUniform_{}
+    , tileHeightUniform_{}
+    , modeUniform_{}
+    , focusUniform_{}
+    , focusRadiusUniform_{}
+    , texture_{0}
+    , tileSize_{0}
+    , size_{0}
+    , videoMemorySize_{0}
+    , enabled_{false}
+{
+}
+
+ShadingRateImage::~ShadingRateImage()
+{
+    glDeleteTextures(1, &texture_);
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize_);
+}
+
+PendingShader ShadingRateImage::submitShader()
+{
+    return Shader::submitComputeFromFile(
+        fs::path{"assets/shaders/shading_rate_gl4.comp.glsl"});
+}
+
+bool ShadingRateImage::init(PendingShader&& shader)
+{
+    // Compilation is still finished, so that the driver does not keep
+    // working on it in the background
+    std::optional<Shader> finishedShader = shader.finish();
+    if (!finishedShader)
+    {
+        return false;
+    }
+    if (!GLAD_GL_NV_shading_rate_image)
+    {
+        return true;
+    }
+    shader_ = std::move(finishedShader);
+    sceneUniform_ = shader_->getUniformHandle<int>("u_scene");
+    sceneWidthUniform_ = shader_->getUniformHandle<int>("u_sceneWidth");
+    sceneHeightUniform_ = shader_->getUniformHandle<int>("u_sceneHeight");
+    tileWidthUniform_ = shader_->getUniformHandle<int>("u_tileWidth");
+    tileHeightUniform_ = shader_->getUniformHandle<int>("u_tileHeight");
+    modeUniform_ = shader_->getUniformHandle<int>("u_mode");
+    focusUniform_ = shader_->getUniformHandle<glm::vec2>("u_focus");
+    focusRadiusUniform_ = shader_->getUniformHandle<float>("u_focusRadius");
+
+    glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &tileSize_.x);
+    glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &tileSize_.y);
+    tileSize_ = glm::max(tileSize_, glm::ivec2{1});
+    // Scene is drawn into the first viewport only
+    glShadingRateImagePaletteNV(0,
+                                0,
+                                static_cast<GLsizei>(PALETTE.size()),
+                                PALETTE.data());
+    return true;
+}
+
+void ShadingRateImage::resize(int width, int height, GlStateCache& glState)
+{
+    if (!isSupported())
+    {
+        return;
+    }
+    const glm::ivec2 size = (glm::ivec2{width, height} + tileSize_ - 1)
+                          / tileSize_;
+    if (size == size_)
+    {
+        return;
+    }
+    size_ = size;
+
+    // Immutable storage can not be resized, so the image is recreated.
+    // Unbound first, because the new texture may reuse the name of the
+    // deleted one still tracked as bound.
+    constexpr int textureUnit = 0;
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, 0);
+    glBindShadingRateImageNV(0);
+    glDeleteTextures(1, &texture_);
+    glGenTextures(1, &texture_);
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, texture_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, size_.x, size_.y);
+    // Palette index of full rate. Resizes are rare enough for the zeros to be
+    // allocated each time.
+    const std::vector<GLubyte> fullRates(static_cast<size_t>(size_.x)
+                                         * static_cast<size_t>(size_.y));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    0,
+                    0,
+                    size_.x,
+                    size_.y,
+                    GL_RED_INTEGER,
+                    GL_UNSIGNED_BYTE,
+                    fullRates.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindShadingRateImageNV(texture_);
+
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize_);
+    videoMemorySize_ = static_cast<size_t>(size_.x)
+                     * static_cast<size_t>(size_.y);
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize_);
+}
+
+void ShadingRateImage::update(Mode mode,
+                              GLuint sceneTexture,
+                              glm::ivec2 sceneSize,
+                              const glm::ivec4& focusViewport,
+                              GlStateCache& glState)
+{
+    if (!isSupported() || mode == Mode::Off || !texture_)
+    {
+        return;
+    }
+    shader_->use(glState);
+    constexpr int textureUnit = 0;
+    glState.bindTexture(textureUnit, GL_TEXTURE_2D, sceneTexture);
+    shader_->setUniform(sceneUniform_, textureUnit);
+    shader_->setUniform(sceneWidthUniform_, sceneSize.x);
+    shader_->setUniform(sceneHeightUniform_, sceneSize.y);
+    shader_->setUniform(tileWidthUniform_, tileSize_.x);
+    shader_->setUniform(tileHeightUniform_, tileSize_.y);
+    shader_->setUniform(modeUniform_, static_cast<int>(mode));
+    const glm::vec2 halfViewportSize
+        = glm::vec2{static_cast<float>(focusViewport.z),
+                    static_cast<float>(focusViewport.w)}
+        * 0.5F;
+    shader_->setUniform(focusUniform_,
+                        glm::vec2{static_cast<float>(focusViewport.x),
+                                  static_cast<float>(focusViewport.y)}
+                            + halfViewportSize);
+    shader_->setUniform(focusRadiusUniform_,
+                        std::max(glm::length(halfViewportSize), 1.0F));
+    glBindImageTexture(0,
+                       texture_,
+                       0,
+                       GL_FALSE,
+                       0,
+                       GL_WRITE_ONLY,
+                       GL_R8UI);
+    glDispatchCompute(getGroupCount(size_.x), getGroupCount(size_.y), 1);
+    // Rates are read by the rasterizer of following draws, not by shaders
+    glShadingRateImageBarrierNV(GL_TRUE);
+}
+
+void ShadingRateImage::setEnabled(bool enabled)
+{
+    enabled = enabled && texture_ != 0;
+    if (enabled == enabled_)
+    {
+        return;
+    }
+    enabled_ = enabled;
+    if (enabled_)
+    {
+        glEnable(GL_SHADING_RATE_IMAGE_NV);
+    }
+    else
+    {
+        glDisable(GL_SHADING_RATE_IMAGE_NV);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef SHADING_RATE_IMAGE_H_
+#define SHADING_RATE_IMAGE_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#include "glad/gl.h"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <optional>
+
+/// Variable rate shading through NV_shading_rate_image, shading flat and
+/// peripheral regions of the scene once per 2x2 or 4x4 pixels.
+///
+/// Each texel of the image selects the shading rate of a tile of the
+/// framebuffer, usually 16x16 pixels, from a palette of full, 2x2 and 4x4
+/// rates. Foveated rates get coarser with distance from the center of the
+/// camera view. Content adaptive rates are chosen from luminance contrast of
+/// the previous frame, so regions revealed by camera movement may be shaded
+/// at a stale rate for a frame. Depth and coverage are still rasterized per
+/// sample, keeping geometry edges sharp.
+///
+/// Like the scene framebuffer, image covers the full window size and the
+/// scene is drawn at its bottom-left corner. Non-copyable, non-movable.
+/// Shading rate images are only provided by NVIDIA Turing GPUs and later, and
+/// are not available in OpenGL ES 3.0.
+class ShadingRateImage
+{
+public:
+    /// Source of shading rates, in the order of the UI.
+    enum class Mode : std::uint8_t
+    {
+        Off,
+        Foveated,
+        ContentAdaptive,
+    };
+
+    ShadingRateImage();
+    ShadingRateImage(const ShadingRateImage&) = delete;
+    ShadingRateImage& operator=(const ShadingRateImage&) = delete;
+    ShadingRateImage(ShadingRateImage&&) = delete;
+    ShadingRateImage& operator=(ShadingRateImage&&) = delete;
+    ~ShadingRateImage();
+
+    /// Submit compute shader filling the image for compilation without
+    /// waiting for the driver to finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted shader when the driver supports
+    /// shading rate images, leaving variable rate shading unsupported
+    /// otherwise. Returns false only when compilation fails.
+    bool init(PendingShader&& shader);
+
+    [[nodiscard]] bool isSupported() const { return shader_.has_value(); }
+    [[nodiscard]] GLuint texture() const { return texture_; }
+    /// Texels of the image, one per tile.
+    [[nodiscard]] glm::ivec2 size() const { return size_; }
+
+    /// Recreate image when window framebuffer size changes, shading every
+    /// tile at full rate until the next update.
+    void resize(int width, int height, GlStateCache& glState);
+
+    /// Fill image with rates of given mode for the scene in the bottom-left
+    /// rectangle of scene texture, focused on the center of given viewport.
+    /// Content adaptive rates are chosen from the contents of the scene
+    /// texture, meant to be the finished frame before the one they are used
+    /// for. Leaves the compute shader bound.
+    void update(Mode mode,
+                GLuint sceneTexture,
+                glm::ivec2 sceneSize,
+                const glm::ivec4& focusViewport,
+                GlStateCache& glState);
+
+    /// Shade following draws at rates of the image, or all of them at full
+    /// rate.
+    void setEnabled(bool enabled);
+
+private:
+    std::optional<Shader> shader_;
+    UniformHandle<int> sceneUniform_;
+    UniformHandle<int> sceneWidthUniform_;
+    UniformHandle<int> sceneHeightUniform_;
+    UniformHandle<int> tileWidthUniform_;
+    UniformHandle<int> tileHeightUniform_;
+    UniformHandle<int> modeUniform_;
+    UniformHandle<glm::vec2> focusUniform_;
+    UniformHandle<float> focusRadiusUniform_;
+    GLuint texture_;
+    /// Framebuffer pixels covered by each texel.
+    glm::ivec2 tileSize_;
+    glm::ivec2 size_;
+    /// Video memory taken by the image in bytes.
+    size_t videoMemorySize_;
+    bool enabled_;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "shadowmap.h"
+
+#include "videomemory.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <cmath>
+
+namespace
+{
+/// Bytes per texel of 24-bit depth, assuming it is padded to 32 bits.
+constexpr size_t TEXEL_SIZE = 4;
+/// Blend between logarithmic and uniform split of view depth. Logarithmic
+/// splits match texel density to perspective, uniform ones keep near cascades
+/// from getting too small.
+constexpr float SPLIT_BLEND = 0.75F;
+/// Distance towards the light covered by each cascade beyond its slice, so
+/// that objects outside of the view still cast shadows into it.
+constexpr float CASTER_DISTANCE = 100.0F;
+/// Cascade radii are rounded up to multiples of this, so that rounding
+/// errors of fitting do not change their projection.
+constexpr float RADIUS_GRANULARITY = 1.0F / 16.0F;
+}  // namespace
+
+ShadowMap::ShadowMap()
+    : framebuffer_{0}
+    , texture_{0}
+    , size_{DEFAULT_SIZE}
+    , lightViewProjections_{}
+    , splitDepths_{0.0F}
+    , drawnCascades_{}
+{
+}
+
+ShadowMap::~ShadowMap()
+{
+    destroy();
+}
+
+bool ShadowMap::create(GLsizei size)
+{
+    if (texture_ && size == size_)
+    {
+        return true;
+    }
+    // Texture storage is immutable, so resizing takes a new texture. Depth
+    // of cascades is lost with the old one.
+    destroy();
+    drawnCascades_ = {};
+    size_ = size;
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY,
+                   1,
+                   GL_DEPTH_COMPONENT24,
+                   size_,
+                   size_,
+                   static_cast<GLsizei>(CASCADE_COUNT));
+    // Comparison against the reference depth happens in the texture unit,
+    // and linear filtering blends the results of the four nearest texels,
+    // giving percentage-closer filtering in a single fetch
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,
+                    GL_TEXTURE_COMPARE_MODE,
+                    GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize());
+
+    // Depth only, without color attachments to draw into or read from
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER,
+                              GL_DEPTH_ATTACHMENT,
+                              texture_,
+                              0,
+                              0);
+    const GLenum noDrawBuffer = GL_NONE;
+    glDrawBuffers(1, &noDrawBuffer);
+    glReadBuffer(GL_NONE);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER)
+                       == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Incomplete map is not kept, or the next call would take it as created
+    if (!complete)
+    {
+        destroy();
+    }
+    return complete;
+}
+
+void ShadowMap::fitCascades(const glm::mat4& view,
+                            float verticalFov,
+                            float aspectRatio,
+                            float nearPlane,
+                            float farPlane,
+                            const glm::vec3& lightDirection)
+{
+    const glm::mat4 inverseView = glm::inverse(view);
+    const glm::vec3 cameraPosition{inverseView[3]};
+    const glm::vec3 cameraForward = -glm::vec3{inverseView[2]};
+    // Squared slope of frustum corners from the view axis
+    const float tanHalfFov = std::tan(verticalFov * 0.5F);
+    const float cornerSlopeSquared
+        = tanHalfFov * tanHalfFov * (1.0F + aspectRatio * aspectRatio);
+
+    // Light looks along its direction from the world origin. Zero direction
+    // set from UI falls back to light from above.
+    const glm::vec3 direction = glm::length(lightDirection) > 0.0F
+                                  ? glm::normalize(lightDirection)
+                                  : glm::vec3{0.0F, -1.0F, 0.0F};
+    const glm::vec3 up = std::abs(direction.y) > 0.99F
+                           ? glm::vec3{0.0F, 0.0F, 1.0F}
+                           : glm::vec3{0.0F, 1.0F, 0.0F};
+    const glm::mat4 lightView
+        = glm::lookAt(glm::vec3{0.0F}, direction, up);
+
+    float sliceNear = nearPlane;
+    for (size_t i = 0; i < CASCADE_COUNT; ++i)
+    {
+        const float fraction
+            = static_cast<float>(i + 1) / static_cast<float>(CASCADE_COUNT);
+        const float logarithmicSplit
+            = nearPlane * std::pow(farPlane / nearPlane, fraction);
+        const float uniformSplit
+            = nearPlane + (farPlane - nearPlane) * fraction;
+        const float sliceFar = glm::mix(uniformSplit,
+                                        logarithmicSplit,
+                                        SPLIT_BLEND);
+        splitDepths_[static_cast<int>(i)] = sliceFar;
+
+        // Slice is symmetric around the view axis, so the center of its
+        // smallest enclosing sphere lies on the axis, equally far from near
+        // and far corners unless the far corners alone decide the radius.
+        // Radius only depends on projection, not on camera orientation.
+        const float centerDepth
+            = std::min((sliceFar + sliceNear) * (1.0F + cornerSlopeSquared)
+                           * 0.5F,
+                       sliceFar);
+        const float farOffset = sliceFar - centerDepth;
+        float radius = std::sqrt(farOffset * farOffset
+                                 + cornerSlopeSquared * sliceFar * sliceFar);
+        radius = std::ceil(radius / RADIUS_GRANULARITY) * RADIUS_GRANULARITY;
+        sliceNear = sliceFar;
+
+        // Cascade is larger than the sphere by the snapping step, so that the
+        // sphere stays covered wherever it is within a grid cell. Step is a
+        // whole number of texels, so that redrawn cascades sample the scene
+        // at the same positions and edges of shadows do not shimmer.
+        const float halfExtent = radius * 1.5F;
+        const float texelSize = 2.0F * halfExtent / static_cast<float>(size_);
+        const float step
+            = std::floor(radius * 0.5F / texelSize) * texelSize;
+        const glm::vec3 center = cameraPosition + cameraForward * centerDepth;
+        const glm::vec3 lightSpaceCenter
+            = glm::round(glm::vec3{lightView * glm::vec4{center, 1.0F}} / step)
+            * step;
+        // View space of the light looks down its negative z-axis
+        const glm::mat4 projection
+            = glm::ortho(lightSpaceCenter.x - halfExtent,
+                         lightSpaceCenter.x + halfExtent,
+                         lightSpaceCenter.y - halfExtent,
+                         lightSpaceCenter.y + halfExtent,
+                         -lightSpaceCenter.z - halfExtent - CASTER_DISTANCE,
+                         -lightSpaceCenter.z + halfExtent);
+        lightViewProjections_[i] = projection * lightView;
+    }
+}
+
+bool ShadowMap::isStale(size_t cascade, std::uint64_t casterGeneration) const
+{
+    const DrawnCascade& drawn = drawnCascades_[cascade];
+    return !drawn.valid || drawn.casterGeneration != casterGeneration
+        || drawn.lightViewProjection != lightViewProjections_[cascade];
+}
+
+void ShadowMap::beginCascade(size_t cascade, std::uint64_t casterGeneration)
+{
+    drawnCascades_[cascade] = {
+        .lightViewProjection = lightViewProjections_[cascade],
+        .casterGeneration = casterGeneration,
+        .valid = true,
+    };
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER,
+                              GL_DEPTH_ATTACHMENT,
+                              texture_,
+                              0,
+                              static_cast<GLint>(cascade));
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+size_t ShadowMap::videoMemorySize() const
+{
+    return static_cast<size_t>(size_) * static_cast<size_t>(size_)
+         * CASCADE_COUNT * TEXEL_SIZE;
+}
+
+void ShadowMap::destroy()
+{
+    if (texture_)
+    {
+        videomemory::release(videomemory::Category::RenderTarget,
+                             videoMemorySize());
+    }
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &texture_);
+    framebuffer_ = 0;
+    texture_ = 0;
+}
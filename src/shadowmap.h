@@ -0,0 +1,109 @@
+#ifndef SHADOW_MAP_H_
+#define SHADOW_MAP_H_
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// Cascaded shadow map of the directional light, stored as layers of a depth
+/// texture array sampled with hardware depth comparison.
+///
+/// View frustum is split into slices along view depth, each covered by an
+/// orthographic cascade of the light. Cascades are fitted to bounding spheres
+/// of their slices, whose size does not change as the camera turns, and their
+/// centers are snapped to a coarse grid in light space. Cascades therefore
+/// keep the same projection while the camera moves within a grid cell, so
+/// that their depth is only drawn again when their projection, the light or
+/// the shadow casters change, and reused from earlier frames otherwise.
+///
+/// Texture is created on first use, and created again when its size changes.
+/// Non-copyable, non-movable.
+class ShadowMap
+{
+public:
+    static constexpr size_t CASCADE_COUNT = 4;
+    /// Width and height of each cascade in texels by default.
+    static constexpr GLsizei DEFAULT_SIZE = 1024;
+
+    ShadowMap();
+    ShadowMap(const ShadowMap&) = delete;
+    ShadowMap& operator=(const ShadowMap&) = delete;
+    ShadowMap(ShadowMap&&) = delete;
+    ShadowMap& operator=(ShadowMap&&) = delete;
+    ~ShadowMap();
+
+    /// Create depth texture and framebuffer with cascades of given width and
+    /// height, unless already created with that size. Every cascade is drawn
+    /// again after resizing. Returns false when the driver rejects the
+    /// framebuffer.
+    bool create(GLsizei size);
+
+    [[nodiscard]] bool isCreated() const { return texture_ != 0; }
+    /// Width and height of each cascade in texels.
+    [[nodiscard]] GLsizei size() const { return size_; }
+
+    /// Fit cascades to slices of the view frustum between near and far
+    /// planes of the camera projection, with light shining along given
+    /// direction.
+    void fitCascades(const glm::mat4& view,
+                     float verticalFov,
+                     float aspectRatio,
+                     float nearPlane,
+                     float farPlane,
+                     const glm::vec3& lightDirection);
+
+    /// Transformations from world space into clip space of each cascade.
+    [[nodiscard]] const std::array<glm::mat4, CASCADE_COUNT>&
+    lightViewProjections() const
+    {
+        return lightViewProjections_;
+    }
+
+    /// View space depth at which each cascade ends.
+    [[nodiscard]] const glm::vec4& splitDepths() const { return splitDepths_; }
+
+    /// Whether depth of cascade was drawn with a different projection or
+    /// other shadow casters than the current ones. Casters are identified by
+    /// a generation changed by the caller whenever they move or are replaced.
+    [[nodiscard]] bool isStale(size_t cascade,
+                               std::uint64_t casterGeneration) const;
+
+    /// Bind framebuffer with layer of cascade attached and clear its depth,
+    /// recording it as drawn for given caster generation. Viewport has to be
+    /// set to the size of the shadow map by the caller.
+    void beginCascade(size_t cascade, std::uint64_t casterGeneration);
+
+    [[nodiscard]] GLuint texture() const { return texture_; }
+
+private:
+    /// Projection and casters a cascade was last drawn with.
+    struct DrawnCascade
+    {
+        glm::mat4 lightViewProjection;
+        std::uint64_t casterGeneration;
+        bool valid;
+    };
+
+    /// Video memory taken by the texture in bytes.
+    [[nodiscard]] size_t videoMemorySize() const;
+    void destroy();
+
+    GLuint framebuffer_;
+    GLuint texture_;
+    GLsizei size_;
+    std::array<glm::mat4, CASCADE_COUNT> lightViewProjections_;
+    glm::vec4 splitDepths_;
+    std::array<DrawnCascade, CASCADE_COUNT> drawnCascades_;
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include "simulation.h"
+
+#include "glm/common.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+// This is the granularity of how often to update logic and not to be confused
+// with framerate limiting or 60 frames per second, because logic is updated
+// with a fixed timestep independent of framerate.
+//
+// 60 logic updates per second is a common value used in games.
+// - Higher update rate (120) can lead to smoother gameplay, more precise
+// control, at the cost of CPU load. Keep mobile devices in mind.
+// - Lower update rate (30) reduces CPU load, runs game logic less frequently,
+// but can make game less responsive.
+constexpr float MAX_LOGIC_UPDATE_PER_SECOND = 60.0F;
+constexpr float FIXED_UPDATE_TIMESTEP = 1.0F / MAX_LOGIC_UPDATE_PER_SECOND;
+const auto FIXED_UPDATE_DURATION
+    = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float>(FIXED_UPDATE_TIMESTEP));
+}  // namespace
+
+bool Simulation::Input::isActive() const
+{
+    return forward || backward || left || right || up || down
+        || lookOffset != glm::vec2{0.0F};
+}
+
+Simulation::Simulation(const Camera& camera)
+    : camera_{camera}
+    , snapshots_{Snapshot{.previousCamera = camera,
+                          .camera = camera,
+                          .stepTime = Clock::now()}}
+    , heldInput_{.forward = false,
+                 .backward = false,
+                 .left = false,
+                 .right = false,
+                 .up = false,
+                 .down = false,
+                 .lookOffset = glm::vec2{0.0F}}
+    , stopping_{false}
+    , recording_{false}
+    , updateTime_{Clock::now()}
+{
+}
+
+Simulation::~Simulation()
+{
+    {
+        const std::lock_guard lock(inputMutex_);
+        stopping_ = true;
+    }
+    inputChanged_.notify_one();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void Simulation::start()
+{
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    thread_ = std::thread(&Simulation::run, this);
+#endif
+}
+
+void Simulation::enableRecording()
+{
+    const std::lock_guard lock(inputMutex_);
+    recording_ = true;
+}
+
+std::vector<Camera> Simulation::takeRecordedSteps()
+{
+    const std::lock_guard lock(inputMutex_);
+    return std::exchange(recordedSteps_, {});
+}
+
+void Simulation::submitInput(std::span<const InputEvent> events)
+{
+    if (events.empty())
+    {
+        return;
+    }
+    {
+        const std::lock_guard lock(inputMutex_);
+        pendingEvents_.insert(pendingEvents_.end(),
+                              events.begin(),
+                              events.end());
+    }
+    inputChanged_.notify_one();
+}
+
+void Simulation::update()
+{
+    if (thread_.joinable())
+    {
+        return;
+    }
+    // Steps missed by more than a few are given up on instead of catching up
+    // with all of them, e.g. after the browser tab was in the background
+    const Clock::time_point now = Clock::now();
+    updateTime_ = std::max(updateTime_, now - FIXED_UPDATE_DURATION * 4);
+    while (updateTime_ + FIXED_UPDATE_DURATION <= now)
+    {
+        updateTime_ += FIXED_UPDATE_DURATION;
+        step(takeInput(updateTime_), updateTime_);
+    }
+}
+
+Simulation::Interpolation Simulation::interpolate()
+{
+    const Snapshot& snapshot = snapshots_.read();
+    const float alpha = std::clamp(
+        std::chrono::duration<float>(Clock::now() - snapshot.stepTime).count()
+            / FIXED_UPDATE_TIMESTEP,
+        0.0F,
+        1.0F);
+
+    const glm::vec3 position = glm::mix(snapshot.previousCamera.position(),
+                                        snapshot.camera.position(),
+                                        alpha);
+    // Yaw is wrapped around, so it is blended along the shorter way
+    const glm::vec2 previousRotation = snapshot.previousCamera.rotation();
+    glm::vec2 rotationChange = snapshot.camera.rotation() - previousRotation;
+    if (rotationChange.x > 180.0F)
+    {
+        rotationChange.x -= 360.0F;
+    }
+    else if (rotationChange.x < -180.0F)
+    {
+        rotationChange.x += 360.0F;
+    }
+    glm::vec2 rotation = previousRotation + rotationChange * alpha;
+    if (rotation.x < 0.0F)
+    {
+        rotation.x += 360.0F;
+    }
+    else if (rotation.x >= 360.0F)
+    {
+        rotation.x -= 360.0F;
+    }
+
+    return Interpolation{
+        .camera = Camera(position, rotation),
+        .settled = alpha >= 1.0F
+                && snapshot.previousCamera.position()
+                       == snapshot.camera.position()
+                && previousRotation == snapshot.camera.rotation(),
+    };
+}
+
+Camera Simulation::latchLook(const Camera& camera, glm::vec2 lookOffset)
+{
+    // Offsets taken by a step not published yet are missed for a frame,
+    // which is less noticeable than applying them twice
+    Camera latest = snapshots_.read().camera;
+    {
+        const std::lock_guard lock(inputMutex_);
+        for (const InputEvent& event : pendingEvents_)
+        {
+            lookOffset += event.input.lookOffset;
+        }
+    }
+    latest.look(lookOffset.x, lookOffset.y);
+    return Camera(camera.position(), latest.rotation());
+}
+
+void Simulation::run()
+{
+    Clock::time_point stepTime = Clock::now();
+    // Latest step changed something, so another one is needed to publish a
+    // settled state before sleeping
+    bool changed = true;
+    std::unique_lock lock(inputMutex_);
+    while (!stopping_)
+    {
+        if (!changed && pendingEvents_.empty() && !heldInput_.isActive())
+        {
+            inputChanged_.wait(
+                lock,
+                [this]() { return stopping_ || !pendingEvents_.empty(); });
+            // Time spent sleeping is not caught up with
+            stepTime = Clock::now();
+            continue;
+        }
+        lock.unlock();
+        changed = step(takeInput(stepTime), stepTime);
+        stepTime += FIXED_UPDATE_DURATION;
+        std::this_thread::sleep_until(stepTime);
+        lock.lock();
+    }
+}
+
+bool Simulation::step(const Input& input, Clock::time_point stepTime)
+{
+    const Camera previousCamera = camera_;
+    if (input.lookOffset != glm::vec2{0.0F})
+    {
+        camera_.look(input.lookOffset.x, input.lookOffset.y);
+    }
+    if (input.forward)
+    {
+        camera_.moveForward(FIXED_UPDATE_TIMESTEP);
+    }
+    if (input.backward)
+    {
+        camera_.moveBackward(FIXED_UPDATE_TIMESTEP);
+    }
+    if (input.left)
+    {
+        camera_.strafeLeft(FIXED_UPDATE_TIMESTEP);
+    }
+    if (input.right)
+    {
+        camera_.strafeRight(FIXED_UPDATE_TIMESTEP);
+    }
+    if (input.up)
+    {
+        camera_.ascend(FIXED_UPDATE_TIMESTEP);
+    }
+    if (input.down)
+    {
+        camera_.descend(FIXED_UPDATE_TIMESTEP);
+    }
+
+    snapshots_.writeBuffer() = Snapshot{
+        .previousCamera = previousCamera,
+        .camera = camera_,
+        .stepTime = stepTime,
+    };
+    snapshots_.publish();
+    {
+        const std::lock_guard lock(inputMutex_);
+        if (recording_)
+        {
+            recordedSteps_.push_back(camera_);
+        }
+    }
+    return camera_.position() != previousCamera.position()
+        || camera_.rotation() != previousCamera.rotation();
+}
+
+Simulation::Input Simulation::takeInput(Clock::time_point stepTime)
+{
+    const std::lock_guard lock(inputMutex_);
+    Input input = heldInput_;
+    while (!pendingEvents_.empty()
+           && pendingEvents_.front().time <= stepTime)
+    {
+        const Input& event = pendingEvents_.front().input;
+        input.forward = input.forward || event.forward;
+        input.backward = input.backward || event.backward;
+        input.left = input.left || event.left;
+        input.right = input.right || event.right;
+        input.up = input.up || event.up;
+        input.down = input.down || event.down;
+        input.lookOffset += event.lookOffset;
+        heldInput_ = event;
+        heldInput_.lookOffset = glm::vec2{0.0F};
+        pendingEvents_.pop_front();
+    }
+    return input;
+}
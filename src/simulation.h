@@ -0,0 +1,149 @@
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include "camera.h"
+#include "triplebuffer.h"
+
+#include "glm/vec2.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+/// Application logic updated with a fixed timestep, independent of
+/// framerate.
+///
+/// Steps run on a separate thread, so that they overlap with rendering on the
+/// main thread. Each step publishes a snapshot of its result through a triple
+/// buffer, and rendering interpolates between the last two steps. Rendered
+/// state trails simulation by one step in exchange for smooth motion at any
+/// framerate. The thread sleeps while no input changes anything.
+///
+/// Input is handed over as events stamped with the time they were sampled,
+/// and each step applies the events sampled up to its step time. Steps run
+/// late, like those caught up with after a long frame, still move by the
+/// input held at their own time instead of the latest one.
+///
+/// When threads are not available (WebAssembly build without pthreads
+/// support), steps are run on the main thread by update() instead.
+///
+/// Non-copyable, non-movable, the simulation thread refers to the instance.
+class Simulation
+{
+public:
+    /// User input sampled on the main thread, as window input can only be
+    /// polled there.
+    struct Input
+    {
+        bool forward;
+        bool backward;
+        bool left;
+        bool right;
+        bool up;
+        bool down;
+        /// Mouse cursor movement since the previous input.
+        glm::vec2 lookOffset;
+
+        /// Whether stepping with this input changes anything.
+        [[nodiscard]] bool isActive() const;
+    };
+
+    /// Input as of a change of held keys or a mouse movement.
+    struct InputEvent
+    {
+        /// Held keys after the change, and mouse movement since the previous
+        /// event.
+        Input input;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    /// State to render the current frame with.
+    struct Interpolation
+    {
+        Camera camera;
+        /// Latest step did not move anything and its state is reached, so
+        /// further frames would look the same.
+        bool settled;
+    };
+
+    explicit Simulation(const Camera& camera);
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    Simulation(Simulation&&) = delete;
+    Simulation& operator=(Simulation&&) = delete;
+
+    /// Stop and join simulation thread.
+    ~Simulation();
+
+    /// Start stepping on simulation thread, when threads are available.
+    void start();
+
+    /// Keep camera of every step from now on, for recording the path taken.
+    void enableRecording();
+    /// Take cameras of steps run since the previous call, in step order.
+    [[nodiscard]] std::vector<Camera> takeRecordedSteps();
+
+    /// Hand over input events for upcoming steps, in sampling order. A step
+    /// moves by keys held at any point since the previous step, so that taps
+    /// shorter than a step are not lost, and turns by the look offsets of all
+    /// events up to its step time.
+    void submitInput(std::span<const InputEvent> events);
+
+    /// Run steps due since the previous call on the calling thread when
+    /// threads are not available, does nothing otherwise.
+    void update();
+
+    /// State between the last two steps for the current time. Must be called
+    /// from a single thread.
+    [[nodiscard]] Interpolation interpolate();
+
+    /// Camera at position of given camera, turned as far as the latest step
+    /// and look offsets no step applied yet, including lookOffset that is not
+    /// submitted yet. Rendering with it shows mouse look without waiting for
+    /// steps and interpolation. Must be called from the thread calling
+    /// interpolate().
+    [[nodiscard]] Camera latchLook(const Camera& camera, glm::vec2 lookOffset);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// Result of a step.
+    struct Snapshot
+    {
+        Camera previousCamera;
+        Camera camera;
+        Clock::time_point stepTime;
+    };
+
+    void run();
+    /// Advance by a fixed timestep and publish result. Returns whether
+    /// anything changed.
+    bool step(const Input& input, Clock::time_point stepTime);
+    /// Take input events sampled up to step time, combined into the input of
+    /// the step. Held keys of the latest event taken stay in place for
+    /// further steps.
+    Input takeInput(Clock::time_point stepTime);
+
+    /// Only accessed by the stepping thread.
+    Camera camera_;
+    TripleBuffer<Snapshot> snapshots_;
+    /// Guards input, recorded steps and stopping flag.
+    std::mutex inputMutex_;
+    std::condition_variable inputChanged_;
+    /// Events not applied by a step yet, in sampling order.
+    std::deque<InputEvent> pendingEvents_;
+    /// Keys held as of the latest event applied.
+    Input heldInput_;
+    bool stopping_;
+    bool recording_;
+    std::vector<Camera> recordedSteps_;
+    std::thread thread_;
+    /// Time of the latest step run by update().
+    Clock::time_point updateTime_;
+};
+
+#endif
@@ -1,49 +1,717 @@
 #include "skybox.h"
 
+#include "allocationtracker.h"
+#include "assetfs.h"
+
+#ifndef __EMSCRIPTEN__
+#include "pixeluploadbuffer.h"
+#include "texturecache.h"
+#endif
+#include "profiler.h"
+#include "threadpool.h"
 #include "utils.h"
+#include "videomemory.h"
 
-// clang-format off
-#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-// clang-format on
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <optional>
+#include <span>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+namespace
+{
+int mipLevelCount(int width, int height)
+{
+    int levelCount = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+    {
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+/// Average each 2x2 block of RGB texels into a texel of the next mip level.
+/// Last row or column of odd sized images is averaged with itself. Texels
+/// are either 8-bit or floating point.
+template <typename T>
+std::vector<T> downsample(const T* pixels, int width, int height)
+{
+    constexpr int channelCount = 3;
+    constexpr bool floatingPoint = std::is_floating_point_v<T>;
+    using Sum = std::conditional_t<floatingPoint, T, int>;
+    const int levelWidth = std::max(width / 2, 1);
+    const int levelHeight = std::max(height / 2, 1);
+    std::vector<T> level(
+        static_cast<size_t>(levelWidth * levelHeight * channelCount));
+    for (int y = 0; y < levelHeight; ++y)
+    {
+        const std::array rows{std::min(y * 2, height - 1),
+                              std::min(y * 2 + 1, height - 1)};
+        for (int x = 0; x < levelWidth; ++x)
+        {
+            const std::array columns{std::min(x * 2, width - 1),
+                                     std::min(x * 2 + 1, width - 1)};
+            for (int c = 0; c < channelCount; ++c)
+            {
+                // Integers are rounded to nearest
+                Sum sum = floatingPoint ? 0 : 2;
+                for (const int row : rows)
+                {
+                    for (const int column : columns)
+                    {
+                        sum += pixels[(row * width + column) * channelCount
+                                      + c];
+                    }
+                }
+                level[(y * levelWidth + x) * channelCount + c]
+                    = static_cast<T>(sum / 4);
+            }
+        }
+    }
+    return level;
+}
+
+/// Levels following level 0 of given pixels, each filtered down from the
+/// previous one.
+template <typename T>
+std::vector<std::vector<T>> generateMipLevels(const T* pixels,
+                                              int width,
+                                              int height)
+{
+    const int levelCount = mipLevelCount(width, height);
+    std::vector<std::vector<T>> levels;
+    levels.reserve(static_cast<size_t>(levelCount - 1));
+    const T* previousLevel = pixels;
+    for (int level = 1; level < levelCount; ++level)
+    {
+        levels.emplace_back(downsample(previousLevel, width, height));
+        previousLevel = levels.back().data();
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return levels;
+}
+
+GLenum faceTarget(size_t faceIndex)
+{
+    return static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + faceIndex);
+}
+
+// Texture calls below go through direct state access when supported, leaving
+// texture bindings untouched. Otherwise they edit the cube-map bound to the
+// active texture unit, which is expected to be the texture.
+
+GLuint createCubeMap()
+{
+    GLuint texture = 0;
+#ifndef __EMSCRIPTEN__
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &texture);
+        return texture;
+    }
+#endif
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    return texture;
+}
+
+void allocateCubeMapStorage([[maybe_unused]] GLuint texture,
+                            GLsizei levelCount,
+                            GLenum internalFormat,
+                            GLsizei size)
+{
+#ifndef __EMSCRIPTEN__
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        glTextureStorage2D(texture, levelCount, internalFormat, size, size);
+        return;
+    }
+#endif
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, levelCount, internalFormat, size, size);
+}
+
+void setCubeMapParameter([[maybe_unused]] GLuint texture,
+                         GLenum name,
+                         GLint value)
+{
+#ifndef __EMSCRIPTEN__
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        glTextureParameteri(texture, name, value);
+        return;
+    }
+#endif
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, name, value);
+}
+
+/// Cube-map faces are layers of the texture for direct state access. Pixels
+/// are RGB of given component type.
+void uploadFaceLevel([[maybe_unused]] GLuint texture,
+                     size_t faceIndex,
+                     GLint level,
+                     GLsizei size,
+                     GLenum type,
+                     const void* pixels)
+{
+#ifndef __EMSCRIPTEN__
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        glTextureSubImage3D(texture,
+                            level,
+                            0,
+                            0,
+                            static_cast<GLint>(faceIndex),
+                            size,
+                            size,
+                            1,
+                            GL_RGB,
+                            type,
+                            pixels);
+        return;
+    }
+#endif
+    glTexSubImage2D(faceTarget(faceIndex),
+                    level,
+                    0,
+                    0,
+                    size,
+                    size,
+                    GL_RGB,
+                    type,
+                    pixels);
+}
+
+#ifndef __EMSCRIPTEN__
+void uploadCompressedFaceLevel(GLuint texture,
+                               size_t faceIndex,
+                               GLint level,
+                               GLsizei width,
+                               GLsizei height,
+                               GLenum internalFormat,
+                               GLsizei dataSize,
+                               const void* data)
+{
+    if (GLAD_GL_ARB_direct_state_access)
+    {
+        glCompressedTextureSubImage3D(texture,
+                                      level,
+                                      0,
+                                      0,
+                                      static_cast<GLint>(faceIndex),
+                                      width,
+                                      height,
+                                      1,
+                                      internalFormat,
+                                      dataSize,
+                                      data);
+        return;
+    }
+    glCompressedTexSubImage2D(faceTarget(faceIndex),
+                              level,
+                              0,
+                              0,
+                              width,
+                              height,
+                              internalFormat,
+                              dataSize,
+                              data);
+}
+#endif
+
+/// Video memory of mip chain of a face stored in internal format, assuming
+/// that drivers pad RGB texels to four bytes.
+size_t estimateFaceSize(GLenum internalFormat, int size, int levelCount)
+{
+    const bool uncompressed
+        = internalFormat == GL_RGB8 || internalFormat == GL_RGB9_E5;
+#ifndef __EMSCRIPTEN__
+    // 4x4 blocks of 16 bytes for BC6H, and of 8 bytes for BC1
+    const size_t blockSize
+        = internalFormat == GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT ? 16 : 8;
+#else
+    const size_t blockSize = 8;
+#endif
+    size_t faceSize = 0;
+    for (int level = 0; level < levelCount; ++level)
+    {
+        const auto levelSize = static_cast<size_t>(std::max(size >> level, 1));
+        faceSize += uncompressed
+                      ? levelSize * levelSize * 4
+                      : (levelSize + 3) / 4 * ((levelSize + 3) / 4) * blockSize;
+    }
+    return faceSize;
+}
+}  // namespace
+
 Skybox::Skybox()
     : textureID{0}
-    , vertexArray{0}
-    , vertexBuffer_{0}
-    , indexBuffer_{0}
+    , videoMemorySize{0}
 {
 }
 
 Skybox::Skybox(Skybox&& other) noexcept
     : textureID{std::exchange(other.textureID, 0)}
-    , vertexArray{std::exchange(other.vertexArray, 0)}
-    , vertexBuffer_{std::exchange(other.vertexBuffer_, 0)}
-    , indexBuffer_{std::exchange(other.indexBuffer_, 0)}
+#ifndef __EMSCRIPTEN__
+    , virtualTexture{std::move(other.virtualTexture)}
+#endif
+    , videoMemorySize{std::exchange(other.videoMemorySize, 0)}
 {
 }
 
 Skybox& Skybox::operator=(Skybox&& other) noexcept
 {
     std::swap(textureID, other.textureID);
-    std::swap(vertexArray, other.vertexArray);
-    std::swap(vertexBuffer_, other.vertexBuffer_);
-    std::swap(indexBuffer_, other.indexBuffer_);
+#ifndef __EMSCRIPTEN__
+    std::swap(virtualTexture, other.virtualTexture);
+#endif
+    std::swap(videoMemorySize, other.videoMemorySize);
     return *this;
 }
 
 Skybox::~Skybox()
 {
     glDeleteTextures(1, &textureID);
-    glDeleteVertexArrays(1, &vertexArray);
-    glDeleteBuffers(1, &indexBuffer_);
-    glDeleteBuffers(1, &vertexBuffer_);
+    videomemory::release(videomemory::Category::Texture, videoMemorySize);
+}
+
+PendingSkybox::PendingSkybox(
+    const std::array<fs::path, FACE_COUNT>& facePaths,
+    PixelUploadBuffer* uploadBuffer,
+    ThreadPool& threadPool)
+    : facePaths_{facePaths}
+    , uploadBuffer_{uploadBuffer}
+#ifndef __EMSCRIPTEN__
+    , threadPool_{&threadPool}
+    , tiles_{virtualtexture::map(facePaths_)}
+#endif
+{
+#ifndef __EMSCRIPTEN__
+    if (tiles_)
+    {
+        return;
+    }
+    // Compressed faces from previous launch skip image decoding, and take a
+    // fraction of the video memory of uncompressed ones. Storage of every
+    // face is allocated at once, so cached faces are only used when all of
+    // them are present and match.
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        cachedFaces_[i] = texturecache::map(facePaths_[i]);
+        const std::optional<texturecache::CachedImage>& face = cachedFaces_[i];
+        const std::optional<texturecache::CachedImage>& firstFace
+            = cachedFaces_[0];
+        if (!face || face->internalFormat != firstFace->internalFormat
+            || face->width != firstFace->width
+            || face->height != firstFace->height
+            || face->levelCount != firstFace->levelCount)
+        {
+            cachedFaces_ = {};
+            break;
+        }
+    }
+    if (cachedFaces_[0])
+    {
+        return;
+    }
+#endif
+
+    // Faces do not depend on each other, so all of them are decoded at once
+    // on worker threads, leaving only uploads to the thread of the graphics
+    // context
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        decodes_[i] = threadPool.submit([path = facePaths_[i]]()
+                                        { return decodeFace(path); });
+    }
+}
+
+PendingSkybox::PendingSkybox(PendingSkybox&& other) noexcept
+    : facePaths_{std::move(other.facePaths_)}
+    , uploadBuffer_{other.uploadBuffer_}
+#ifndef __EMSCRIPTEN__
+    , threadPool_{other.threadPool_}
+    , tiles_{std::exchange(other.tiles_, std::nullopt)}
+    , cachedFaces_{std::exchange(other.cachedFaces_, {})}
+#endif
+    , decodes_{std::move(other.decodes_)}
+{
+}
+
+PendingSkybox& PendingSkybox::operator=(PendingSkybox&& other) noexcept
+{
+    std::swap(facePaths_, other.facePaths_);
+    std::swap(uploadBuffer_, other.uploadBuffer_);
+#ifndef __EMSCRIPTEN__
+    std::swap(threadPool_, other.threadPool_);
+    std::swap(tiles_, other.tiles_);
+    std::swap(cachedFaces_, other.cachedFaces_);
+#endif
+    std::swap(decodes_, other.decodes_);
+    return *this;
+}
+
+PendingSkybox::~PendingSkybox()
+{
+    // Decoded pixels are owned by the futures until taken out of them
+    for (std::future<DecodedFace>& decode : decodes_)
+    {
+        if (decode.valid())
+        {
+            stbi_image_free(decode.get().data);
+        }
+    }
+}
+
+bool PendingSkybox::isReady() const
+{
+    return std::all_of(decodes_.begin(),
+                       decodes_.end(),
+                       [](const std::future<DecodedFace>& decode)
+                       {
+                           return !decode.valid()
+                               || decode.wait_for(std::chrono::seconds{0})
+                                      == std::future_status::ready;
+                       });
+}
+
+std::optional<Skybox> PendingSkybox::finish()
+{
+    PROFILE_SCOPE("PendingSkybox::finish");
+    Skybox skybox;
+#ifndef __EMSCRIPTEN__
+    if (cachedFaces_[0])
+    {
+        skybox.textureID = createCubeMap();
+        skybox.videoMemorySize = uploadCachedFaces(skybox.textureID);
+        cachedFaces_ = {};
+    }
+    else if (!tiles_)
+#endif
+    {
+        std::optional<std::array<DecodedFace, FACE_COUNT>> faces
+            = takeDecodedFaces();
+        if (!faces)
+        {
+            return std::nullopt;
+        }
+#ifndef __EMSCRIPTEN__
+        const bool virtualSize
+            = virtualtexture::isVirtualSize(faces->front().width);
+        if (virtualSize)
+        {
+            tiles_ = bakeDecodedFaces(faces.value());
+        }
+        else
+#endif
+        {
+            skybox.textureID = createCubeMap();
+            skybox.videoMemorySize
+                = uploadDecodedFaces(skybox.textureID, faces.value());
+        }
+        for (const DecodedFace& face : faces.value())
+        {
+            stbi_image_free(face.data);
+        }
+#ifndef __EMSCRIPTEN__
+        if (virtualSize && !tiles_)
+        {
+            return std::nullopt;
+        }
+#endif
+    }
+#ifndef __EMSCRIPTEN__
+    if (tiles_)
+    {
+        skybox.virtualTexture = std::make_unique<VirtualTexture>(
+            std::exchange(tiles_, std::nullopt).value(),
+            *threadPool_);
+        skybox.videoMemorySize = skybox.virtualTexture->videoMemorySize();
+        videomemory::allocate(videomemory::Category::Texture,
+                              skybox.videoMemorySize);
+        return skybox;
+    }
+#endif
+    videomemory::allocate(videomemory::Category::Texture,
+                          skybox.videoMemorySize);
+
+    // Immutable storage with a full mip chain keeps high field of view from
+    // aliasing, and spares the driver from validating texture completeness
+    setCubeMapParameter(skybox.textureID,
+                        GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+    setCubeMapParameter(skybox.textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    for (const GLenum wrap :
+         {GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R})
+    {
+        setCubeMapParameter(skybox.textureID, wrap, GL_CLAMP_TO_EDGE);
+    }
+
+    return skybox;
+}
+
+PendingSkybox::DecodedFace PendingSkybox::decodeFace(const fs::path& path)
+{
+    PROFILE_SCOPE("PendingSkybox::decodeFace");
+    ALLOCATION_SCOPE(Loader);
+    DecodedFace face{.data = nullptr,
+                     .hdr = false,
+                     .width = 0,
+                     .height = 0,
+                     .mipLevels = {},
+                     .hdrMipLevels = {}};
+    // Faces failing to read are reported as failing to decode
+    const std::optional<AssetData> file = assetfs::readFile(path);
+    if (!file)
+    {
+        return face;
+    }
+    const auto* fileData
+        = reinterpret_cast<const stbi_uc*>(file->bytes().data());
+    const auto fileSize = static_cast<int>(file->bytes().size());
+    // Radiance RGBE images are decoded into floating point, keeping light
+    // brighter than white
+    int channelCount;
+    face.hdr = stbi_is_hdr_from_memory(fileData, fileSize) != 0;
+    if (face.hdr)
+    {
+        float* pixels = stbi_loadf_from_memory(fileData,
+                                               fileSize,
+                                               &face.width,
+                                               &face.height,
+                                               &channelCount,
+                                               STBI_rgb);
+        face.data = pixels;
+        if (pixels)
+        {
+            face.hdrMipLevels = generateMipLevels(pixels,
+                                                  face.width,
+                                                  face.height);
+        }
+        return face;
+    }
+    stbi_uc* pixels = stbi_load_from_memory(fileData,
+                                            fileSize,
+                                            &face.width,
+                                            &face.height,
+                                            &channelCount,
+                                            STBI_rgb);
+    face.data = pixels;
+    if (pixels)
+    {
+        face.mipLevels = generateMipLevels(pixels, face.width, face.height);
+    }
+    return face;
+}
+
+#ifndef __EMSCRIPTEN__
+size_t PendingSkybox::uploadCachedFaces(GLuint texture)
+{
+    const texturecache::CachedImage& firstFace = cachedFaces_[0].value();
+    allocateCubeMapStorage(texture,
+                           firstFace.levelCount,
+                           firstFace.internalFormat,
+                           firstFace.width);
+    size_t videoMemorySize = 0;
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        for (GLsizei level = 0; level < firstFace.levelCount; ++level)
+        {
+            const std::span<const std::byte> levelData
+                = cachedFaces_[i]->levels[level];
+            const GLsizei levelWidth = std::max(firstFace.width >> level, 1);
+            const GLsizei levelHeight = std::max(firstFace.height >> level, 1);
+            videoMemorySize += levelData.size();
+            const auto uploadLevel = [&](const void* data)
+            {
+                uploadCompressedFaceLevel(
+                    texture,
+                    i,
+                    level,
+                    levelWidth,
+                    levelHeight,
+                    firstFace.internalFormat,
+                    static_cast<GLsizei>(levelData.size()),
+                    data);
+            };
+            if (uploadBuffer_)
+            {
+                uploadBuffer_->upload(levelData, uploadLevel);
+            }
+            else
+            {
+                uploadLevel(levelData.data());
+            }
+        }
+    }
+    return videoMemorySize;
+}
+#endif
+
+std::optional<std::array<PendingSkybox::DecodedFace, PendingSkybox::FACE_COUNT>>
+PendingSkybox::takeDecodedFaces()
+{
+    std::array<DecodedFace, FACE_COUNT> faces;
+    bool decoded = true;
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        faces[i] = decodes_[i].get();
+        if (!faces[i].data)
+        {
+            utils::showErrorMessage("unable to load skybox texture from",
+                                    facePaths_[i]);
+            decoded = false;
+        }
+    }
+    const int size = faces[0].width;
+    const bool hdr = faces[0].hdr;
+    for (const DecodedFace& face : faces)
+    {
+        if (decoded && (face.width != size || face.height != size))
+        {
+            utils::showErrorMessage(
+                "skybox faces must be square and the same size");
+            decoded = false;
+        }
+        if (decoded && face.hdr != hdr)
+        {
+            utils::showErrorMessage(
+                "skybox faces must be all high dynamic range or none");
+            decoded = false;
+        }
+    }
+    if (!decoded)
+    {
+        for (const DecodedFace& face : faces)
+        {
+            stbi_image_free(face.data);
+        }
+        return std::nullopt;
+    }
+    return faces;
+}
+
+size_t PendingSkybox::uploadDecodedFaces(
+    GLuint texture,
+    const std::array<DecodedFace, FACE_COUNT>& faces)
+{
+    const int size = faces[0].width;
+    const bool hdr = faces[0].hdr;
+    const int levelCount = mipLevelCount(size, size);
+    // High dynamic range faces are stored with a shared exponent when not
+    // compressed, taking as much memory as 8-bit ones
+#ifndef __EMSCRIPTEN__
+    // Driver compresses uncompressed pixels uploaded into compressed storage
+    const GLenum internalFormat
+        = hdr ? texturecache::compressedHdrFormat().value_or(GL_RGB9_E5)
+              : texturecache::compressedRgbFormat().value_or(GL_RGB8);
+#else
+    // WebGL 2 does not compress uploads, and support of compressed formats
+    // varies by browser
+    const GLenum internalFormat = hdr ? GL_RGB9_E5 : GL_RGB8;
+#endif
+    const GLenum pixelType = hdr ? GL_FLOAT : GL_UNSIGNED_BYTE;
+#ifndef __EMSCRIPTEN__
+    const size_t texelSize = hdr ? 3 * sizeof(float) : 3;
+#endif
+    allocateCubeMapStorage(texture, levelCount, internalFormat, size);
+    // Rows of the smallest levels are not padded to four bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        for (int level = 0; level < levelCount; ++level)
+        {
+            const int levelSize = std::max(size >> level, 1);
+            const void* levelData = faces[i].data;
+            if (level > 0)
+            {
+                const auto levelIndex = static_cast<size_t>(level - 1);
+                levelData = hdr ? static_cast<const void*>(
+                                      faces[i].hdrMipLevels[levelIndex].data())
+                                : faces[i].mipLevels[levelIndex].data();
+            }
+#ifndef __EMSCRIPTEN__
+            if (uploadBuffer_)
+            {
+                uploadBuffer_->upload(
+                    std::span{static_cast<const std::byte*>(levelData),
+                              static_cast<size_t>(levelSize * levelSize)
+                                  * texelSize},
+                    [&](const void* pixels)
+                    {
+                        uploadFaceLevel(texture,
+                                        i,
+                                        level,
+                                        levelSize,
+                                        pixelType,
+                                        pixels);
+                    });
+                continue;
+            }
+#endif
+            uploadFaceLevel(texture,
+                            i,
+                            level,
+                            levelSize,
+                            pixelType,
+                            levelData);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+#ifndef __EMSCRIPTEN__
+    // Compressed images are read back through the binding, which is a one-off
+    // on cache misses
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        texturecache::store(faceTarget(i), levelCount, facePaths_[i]);
+    }
+#endif
+    return FACE_COUNT * estimateFaceSize(internalFormat, size, levelCount);
+}
+
+#ifndef __EMSCRIPTEN__
+std::optional<virtualtexture::Tiles> PendingSkybox::bakeDecodedFaces(
+    const std::array<DecodedFace, FACE_COUNT>& faces)
+{
+    PROFILE_SCOPE("PendingSkybox::bakeDecodedFaces");
+    std::array<std::vector<const void*>, FACE_COUNT> faceLevels;
+    for (size_t i = 0; i < FACE_COUNT; ++i)
+    {
+        const DecodedFace& face = faces[i];
+        faceLevels[i].push_back(face.data);
+        if (face.hdr)
+        {
+            for (const std::vector<float>& level : face.hdrMipLevels)
+            {
+                faceLevels[i].push_back(level.data());
+            }
+            continue;
+        }
+        for (const std::vector<unsigned char>& level : face.mipLevels)
+        {
+            faceLevels[i].push_back(level.data());
+        }
+    }
+    return virtualtexture::bake(facePaths_,
+                                faces[0].width,
+                                faces[0].hdr,
+                                faceLevels);
+}
+#endif
+
+SkyboxBuilder::SkyboxBuilder()
+    : uploadBuffer_{nullptr}
+{
 }
 
 SkyboxBuilder& SkyboxBuilder::setRight(const fs::path& rightFacePath)
@@ -82,118 +750,28 @@ SkyboxBuilder& SkyboxBuilder::setBack(const fs::path& backFacePath)
     return *this;
 }
 
-std::optional<Skybox> SkyboxBuilder::build()
+#ifndef __EMSCRIPTEN__
+SkyboxBuilder& SkyboxBuilder::setUploadBuffer(PixelUploadBuffer& uploadBuffer)
 {
-    // Load textures
-    const std::array textureFacePaths{rightFacePath_,
-                                      leftFacePath_,
-                                      topFacePath_,
-                                      bottomFacePath_,
-                                      frontFacePath_,
-                                      backFacePath_};
-
-    Skybox skybox;
-    glGenTextures(1, &skybox.textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-
-    for (size_t i = 0; i < textureFacePaths.size(); ++i)
-    {
-        int width, height, channelCount;
-        uint8_t* imageData = stbi_load(textureFacePaths[i].string().c_str(),
-                                       &width,
-                                       &height,
-                                       &channelCount,
-                                       0);
-        if (!imageData)
-        {
-            utils::showErrorMessage("unable to load skybox texture from",
-                                    textureFacePaths[i]);
-            return std::nullopt;
-        }
-
-        glTexImage2D(static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i),
-                     0,
-                     GL_RGB,
-                     width,
-                     height,
-                     0,
-                     GL_RGB,
-                     GL_UNSIGNED_BYTE,
-                     imageData);
-        stbi_image_free(imageData);
-    }
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    // Create buffers
-
-    // clang-format off
-    const std::array skyboxVertices{
-        -1.0F,  1.0F, -1.0F,
-        -1.0F, -1.0F, -1.0F,
-         1.0F, -1.0F, -1.0F,
-         1.0F,  1.0F, -1.0F,
-        -1.0F,  1.0F,  1.0F,
-        -1.0F, -1.0F,  1.0F,
-         1.0F, -1.0F,  1.0F,
-         1.0F,  1.0F,  1.0F
-    };
-
-    const std::array skyboxIndices{
-        // Front face
-        0, 1, 2,
-        2, 3, 0,
-        // Back face
-        4, 5, 6,
-        6, 7, 4,
-        // Left face
-        4, 5, 1,
-        1, 0, 4,
-        // Right face
-        3, 2, 6,
-        6, 7, 3,
-        // Top face
-        4, 0, 3,
-        3, 7, 4,
-        // Bottom face
-        1, 5, 6,
-        6, 2, 1
-    };
-    // clang-format on
-
-    // Create vertex array
-    glGenVertexArrays(1, &skybox.vertexArray);
-    glBindVertexArray(skybox.vertexArray);
-
-    // Create vertex buffer
-    glGenBuffers(1, &skybox.vertexBuffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, skybox.vertexBuffer_);
-    glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(skyboxVertices),
-                 skyboxVertices.data(),
-                 GL_STATIC_DRAW);
-
-    // Create index buffer
-    glGenBuffers(1, &skybox.indexBuffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skybox.indexBuffer_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 sizeof(skyboxIndices),
-                 skyboxIndices.data(),
-                 GL_STATIC_DRAW);
-
-    // Setup vertex array layout (just vertex positions)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          3 * sizeof(float),
-                          reinterpret_cast<GLvoid*>(0));
+    uploadBuffer_ = &uploadBuffer;
+    return *this;
+}
+#endif
 
-    return skybox;
+PendingSkybox SkyboxBuilder::submit(ThreadPool& threadPool) const
+{
+    return PendingSkybox{{rightFacePath_,
+                          leftFacePath_,
+                          topFacePath_,
+                          bottomFacePath_,
+                          frontFacePath_,
+                          backFacePath_},
+                         uploadBuffer_,
+                         threadPool};
 }
 
+std::optional<Skybox> SkyboxBuilder::build(ThreadPool& threadPool) const
+{
+    PROFILE_SCOPE("SkyboxBuilder::build");
+    return submit(threadPool).finish();
+}
@@ -1,30 +1,46 @@
 #ifndef SKYBOX_H_
 #define SKYBOX_H_
 
+#ifndef __EMSCRIPTEN__
+#include "texturecache.h"
+#include "virtualtexture.h"
+#endif
+
 #ifdef __EMSCRIPTEN__
 #include "glad/gles2.h"
 #else
 #include "glad/gl.h"
 #endif
 
+#include <array>
+#include <cstddef>
 #include <filesystem>
+#include <future>
+#include <memory>
 #include <optional>
+#include <vector>
 
-/// Skybox containing cube-mapped texture and vertex positions for skybox
-/// cube.
+class PixelUploadBuffer;
+class ThreadPool;
+
+/// Skybox containing cube-mapped texture.
 ///
 /// Cube-map is represented by six subtextures that must be square and the same
 /// size. Sampling from cube-map is done as direction from origin. Skybox is an
 /// application of cube-mapping where entire scene is wrapped in a large cube
-/// surrounding the viewer and model. A unit cube is rendered centered
-/// at the origin and uses the object space position as a texture coordinate
-/// from which to sample the cube map texture.
+/// surrounding the viewer and model. Drawn as a fullscreen triangle on the far
+/// plane, sampling the cube map along the view ray of each pixel, so no vertex
+/// data is needed.
+///
+/// Faces too large to fit in video memory next to everything else are drawn
+/// through a virtual texture instead of a cube-map, streaming the pages in
+/// view from a page file baked on first load (desktop only).
 ///
-/// Non-copyable. Move-only. Texture and vertex data are stored in GPU memory.
+/// Non-copyable. Move-only. Texture data is stored in GPU memory.
 class Skybox
 {
 public:
-    friend class SkyboxBuilder;
+    friend class PendingSkybox;
 
     Skybox();  // HACK: Allowing as member variable in App without
                // std::unique_ptr
@@ -37,12 +53,104 @@ public:
 
     // (Exposed as public variables instead of getters due to performance
     // concerns)
+    /// Zero for virtual textured skyboxes.
     GLuint textureID;
-    GLuint vertexArray;
+#ifndef __EMSCRIPTEN__
+    /// Null unless faces are drawn through virtual texturing.
+    std::unique_ptr<VirtualTexture> virtualTexture;
+#endif
+    /// Estimated video memory taken by cube-map texture in bytes.
+    size_t videoMemorySize;
+};
+
+/// Skybox whose faces are decoded on worker threads, waiting to be uploaded.
+///
+/// Non-copyable, move-only. Decoded faces are released on destruction unless
+/// finished.
+class PendingSkybox
+{
+public:
+    PendingSkybox(const PendingSkybox&) = delete;
+    PendingSkybox& operator=(const PendingSkybox&) = delete;
+    PendingSkybox(PendingSkybox&& other) noexcept;
+    PendingSkybox& operator=(PendingSkybox&& other) noexcept;
+
+    ~PendingSkybox();
+
+    /// Poll whether every face finished decoding, without blocking.
+    [[nodiscard]] bool isReady() const;
+
+    /// Upload faces and generate vertex and index buffers, waiting for faces
+    /// to finish decoding when needed. Large faces are baked into a page file
+    /// instead. Must be called on the thread the graphics context is current
+    /// on. Pending skybox is left empty afterwards.
+    std::optional<Skybox> finish();
 
 private:
-    GLuint vertexBuffer_;
-    GLuint indexBuffer_;
+    friend class SkyboxBuilder;
+
+    static constexpr size_t FACE_COUNT = 6;
+
+    /// RGB mip chain of decoded face. Level 0 is allocated by stb_image,
+    /// following levels are filtered down from the previous one.
+    struct DecodedFace
+    {
+        /// Null when decoding failed. Points to 8-bit pixels, or to
+        /// floating point pixels of high dynamic range images.
+        void* data;
+        bool hdr;
+        int width;
+        int height;
+        /// Following levels of 8-bit images.
+        std::vector<std::vector<unsigned char>> mipLevels;
+        /// Following levels of high dynamic range images.
+        std::vector<std::vector<float>> hdrMipLevels;
+    };
+
+    /// Decode image file into 8-bit RGB pixels, or floating point RGB pixels
+    /// for Radiance RGBE images, and generate its mip chain. Safe to call
+    /// from worker threads.
+    static DecodedFace decodeFace(const std::filesystem::path& path);
+
+    PendingSkybox(
+        const std::array<std::filesystem::path, FACE_COUNT>& facePaths,
+        PixelUploadBuffer* uploadBuffer,
+        ThreadPool& threadPool);
+
+    /// Wait for faces to finish decoding. Returns nothing when any of them
+    /// failed to decode or the faces do not match, releasing all of them.
+    std::optional<std::array<DecodedFace, FACE_COUNT>> takeDecodedFaces();
+
+    /// Allocate storage of cube-map texture and upload faces into it,
+    /// returning estimated size of texture in video memory.
+#ifndef __EMSCRIPTEN__
+    size_t uploadCachedFaces(GLuint texture);
+#endif
+    size_t uploadDecodedFaces(
+        GLuint texture,
+        const std::array<DecodedFace, FACE_COUNT>& faces);
+
+#ifndef __EMSCRIPTEN__
+    /// Cut decoded faces into pages of the page file of a virtual texture.
+    std::optional<virtualtexture::Tiles> bakeDecodedFaces(
+        const std::array<DecodedFace, FACE_COUNT>& faces);
+#endif
+
+    std::array<std::filesystem::path, FACE_COUNT> facePaths_;
+    PixelUploadBuffer* uploadBuffer_;
+#ifndef __EMSCRIPTEN__
+    /// Reads pages of virtual textures.
+    ThreadPool* threadPool_;
+    /// Page file of previous launch, in which case faces are neither decoded
+    /// nor taken from texture cache.
+    std::optional<virtualtexture::Tiles> tiles_;
+    /// Compressed faces of previous launch, empty unless every face was found
+    /// in texture cache.
+    std::array<std::optional<texturecache::CachedImage>, FACE_COUNT>
+        cachedFaces_;
+#endif
+    /// Empty for faces taken from texture cache and once finished.
+    std::array<std::future<DecodedFace>, FACE_COUNT> decodes_;
 };
 
 /// Builder pattern for skybox creation, avoiding mistakes from specifying
@@ -50,15 +158,28 @@ private:
 class SkyboxBuilder
 {
 public:
+    SkyboxBuilder();
+
     SkyboxBuilder& setRight(const std::filesystem::path& rightFacePath);
     SkyboxBuilder& setLeft(const std::filesystem::path& leftFacePath);
     SkyboxBuilder& setTop(const std::filesystem::path& topFacePath);
     SkyboxBuilder& setBottom(const std::filesystem::path& bottomFacePath);
     SkyboxBuilder& setFront(const std::filesystem::path& frontFacePath);
     SkyboxBuilder& setBack(const std::filesystem::path& backFacePath);
+#ifndef __EMSCRIPTEN__
+    /// Stage face uploads through pixel upload buffer instead of uploading
+    /// from client memory.
+    SkyboxBuilder& setUploadBuffer(PixelUploadBuffer& uploadBuffer);
+#endif
+
+    /// Start decoding texture faces in parallel on the thread pool, without
+    /// waiting for them to finish. Faces found in texture cache are not
+    /// decoded at all.
+    PendingSkybox submit(ThreadPool& threadPool) const;
 
-    /// Load texture faces and generate vertex and index buffers.
-    std::optional<Skybox> build();
+    /// Load texture faces and generate vertex and index buffers. Faces are
+    /// decoded in parallel on the thread pool.
+    std::optional<Skybox> build(ThreadPool& threadPool) const;
 
 private:
     std::filesystem::path rightFacePath_;
@@ -67,5 +188,7 @@ private:
     std::filesystem::path bottomFacePath_;
     std::filesystem::path frontFacePath_;
     std::filesystem::path backFacePath_;
+    /// Null when uploading from client memory.
+    PixelUploadBuffer* uploadBuffer_;
 };
 #endif
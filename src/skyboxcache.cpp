@@ -0,0 +1,54 @@
+#include "skyboxcache.h"
+
+#include <algorithm>
+#include <utility>
+
+SkyboxCache::SkyboxCache(size_t videoMemoryBudget)
+    : videoMemoryBudget_{videoMemoryBudget}
+    , residentVideoMemory_{0}
+{
+}
+
+const Skybox* SkyboxCache::find(size_t id)
+{
+    const auto it = std::find_if(entries_.begin(),
+                                 entries_.end(),
+                                 [id](const Entry& entry)
+                                 { return entry.id == id; });
+    if (it == entries_.end())
+    {
+        return nullptr;
+    }
+    std::rotate(entries_.begin(), it, it + 1);
+    return &entries_.front().skybox;
+}
+
+void SkyboxCache::insert(size_t id, Skybox&& skybox)
+{
+    // Replaced skybox is released right away instead of counting against the
+    // budget
+    if (find(id))
+    {
+        residentVideoMemory_ -= entries_.front().skybox.videoMemorySize;
+        entries_.erase(entries_.begin());
+    }
+    residentVideoMemory_ += skybox.videoMemorySize;
+    entries_.insert(entries_.begin(),
+                    Entry{.id = id, .skybox = std::move(skybox)});
+    evict();
+}
+
+void SkyboxCache::setVideoMemoryBudget(size_t videoMemoryBudget)
+{
+    videoMemoryBudget_ = videoMemoryBudget;
+    evict();
+}
+
+void SkyboxCache::evict()
+{
+    while (entries_.size() > 1 && residentVideoMemory_ > videoMemoryBudget_)
+    {
+        residentVideoMemory_ -= entries_.back().skybox.videoMemorySize;
+        entries_.pop_back();
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SKYBOX_CACHE_H_
+#define SKYBOX_CACHE_H_
+
+#include "skybox.h"
+
+#include <cstddef>
+#include <vector>
+
+/// Skyboxes kept resident in video memory after they were last displayed, so
+/// that switching back to any of them is instant.
+///
+/// Least recently used skyboxes are released once their combined video memory
+/// exceeds the budget. The most recently used skybox is always kept, even
+/// when it alone exceeds the budget.
+///
+/// Non-copyable, non-movable, handed out skyboxes are referred to by pointer.
+class SkyboxCache
+{
+public:
+    explicit SkyboxCache(size_t videoMemoryBudget);
+    SkyboxCache(const SkyboxCache&) = delete;
+    SkyboxCache& operator=(const SkyboxCache&) = delete;
+    SkyboxCache(SkyboxCache&&) = delete;
+    SkyboxCache& operator=(SkyboxCache&&) = delete;
+    ~SkyboxCache() = default;
+
+    /// Resident skybox of identifier, marked as most recently used. Null when
+    /// not resident. Pointer is valid until the next insertion or budget
+    /// change.
+    const Skybox* find(size_t id);
+
+    /// Keep skybox resident as most recently used, releasing least recently
+    /// used skyboxes over budget.
+    void insert(size_t id, Skybox&& skybox);
+
+    /// Change budget, releasing least recently used skyboxes over it.
+    void setVideoMemoryBudget(size_t videoMemoryBudget);
+
+    [[nodiscard]] size_t residentVideoMemory() const
+    {
+        return residentVideoMemory_;
+    }
+
+private:
+    struct Entry
+    {
+        size_t id;
+        Skybox skybox;
+    };
+
+    void evict();
+
+    /// Most recently used first. Only a handful of skyboxes fit in the budget,
+    /// so a flat array is searched and reordered faster than a linked list.
+    std::vector<Entry> entries_;
+    size_t videoMemoryBudget_;
+    size_t residentVideoMemory_;
+};
+
+#endif
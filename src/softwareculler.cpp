@@ -0,0 +1,501 @@
+#include "softwareculler.h"
+
+#include "model.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace
+{
+/// Pixels along each side of a tile, which is also the height of the band of
+/// rows each task rasterizes.
+constexpr int TILE_SIZE = 8;
+constexpr int TILE_COLUMN_COUNT = SoftwareCuller::WIDTH / TILE_SIZE;
+constexpr int BAND_COUNT = SoftwareCuller::HEIGHT / TILE_SIZE;
+static_assert(SoftwareCuller::WIDTH % TILE_SIZE == 0
+              && SoftwareCuller::HEIGHT % TILE_SIZE == 0);
+/// Copies nearest to the camera whose occluders are rasterized. Farther ones
+/// cover little of the buffer and hide little in addition.
+constexpr size_t MAX_OCCLUDER_COPY_COUNT = 32;
+/// Depth of cleared pixels, the far plane in normalized device coordinates.
+constexpr float CLEAR_DEPTH = 1.0F;
+/// Clip space W below which vertices are treated as behind the camera.
+/// Triangles with such a vertex are not rasterized instead of being clipped,
+/// which only leaves occluders out.
+constexpr float MIN_W = 1e-3F;
+/// Triangles covering less area in pixels are not rasterized.
+constexpr float MIN_AREA = 1e-6F;
+
+// Four pixels of a row are processed at once. Masks are held in the same
+// type as values under SIMD.
+#if defined(__wasm_simd128__)
+using Float4 = v128_t;
+using Mask4 = v128_t;
+
+Float4 splat(float value) { return wasm_f32x4_splat(value); }
+Float4 load(const float* values) { return wasm_v128_load(values); }
+void store(float* values, Float4 value) { wasm_v128_store(values, value); }
+Float4 add(Float4 left, Float4 right) { return wasm_f32x4_add(left, right); }
+Float4 multiply(Float4 left, Float4 right)
+{
+    return wasm_f32x4_mul(left, right);
+}
+Float4 minimum(Float4 left, Float4 right)
+{
+    return wasm_f32x4_pmin(left, right);
+}
+Mask4 isNonNegative(Float4 value)
+{
+    return wasm_f32x4_ge(value, wasm_f32x4_splat(0.0F));
+}
+Mask4 bothTrue(Mask4 left, Mask4 right) { return wasm_v128_and(left, right); }
+bool anyTrue(Mask4 mask) { return wasm_v128_any_true(mask); }
+Float4 select(Mask4 mask, Float4 ifTrue, Float4 ifFalse)
+{
+    return wasm_v128_bitselect(ifTrue, ifFalse, mask);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+using Float4 = __m128;
+using Mask4 = __m128;
+
+Float4 splat(float value) { return _mm_set1_ps(value); }
+// Rows of the depth buffer are not guaranteed to be 16 byte aligned
+Float4 load(const float* values) { return _mm_loadu_ps(values); }
+void store(float* values, Float4 value) { _mm_storeu_ps(values, value); }
+Float4 add(Float4 left, Float4 right) { return _mm_add_ps(left, right); }
+Float4 multiply(Float4 left, Float4 right) { return _mm_mul_ps(left, right); }
+Float4 minimum(Float4 left, Float4 right) { return _mm_min_ps(left, right); }
+Mask4 isNonNegative(Float4 value)
+{
+    return _mm_cmpge_ps(value, _mm_setzero_ps());
+}
+Mask4 bothTrue(Mask4 left, Mask4 right) { return _mm_and_ps(left, right); }
+bool anyTrue(Mask4 mask) { return _mm_movemask_ps(mask) != 0; }
+Float4 select(Mask4 mask, Float4 ifTrue, Float4 ifFalse)
+{
+    return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+#else
+struct Float4
+{
+    std::array<float, 4> lanes;
+};
+struct Mask4
+{
+    std::array<bool, 4> lanes;
+};
+
+template <typename Result, typename Function>
+Result perLane(Function&& function)
+{
+    Result result{};
+    for (size_t lane = 0; lane < 4; ++lane)
+    {
+        result.lanes[lane] = function(lane);
+    }
+    return result;
+}
+
+Float4 splat(float value) { return Float4{{value, value, value, value}}; }
+Float4 load(const float* values)
+{
+    return Float4{{values[0], values[1], values[2], values[3]}};
+}
+void store(float* values, Float4 value)
+{
+    std::copy(value.lanes.begin(), value.lanes.end(), values);
+}
+Float4 add(Float4 left, Float4 right)
+{
+    return perLane<Float4>([&](size_t lane)
+                           { return left.lanes[lane] + right.lanes[lane]; });
+}
+Float4 multiply(Float4 left, Float4 right)
+{
+    return perLane<Float4>([&](size_t lane)
+                           { return left.lanes[lane] * right.lanes[lane]; });
+}
+Float4 minimum(Float4 left, Float4 right)
+{
+    return perLane<Float4>(
+        [&](size_t lane)
+        { return std::min(left.lanes[lane], right.lanes[lane]); });
+}
+Mask4 isNonNegative(Float4 value)
+{
+    return perLane<Mask4>([&](size_t lane)
+                          { return value.lanes[lane] >= 0.0F; });
+}
+Mask4 bothTrue(Mask4 left, Mask4 right)
+{
+    return perLane<Mask4>([&](size_t lane)
+                          { return left.lanes[lane] && right.lanes[lane]; });
+}
+bool anyTrue(Mask4 mask)
+{
+    return mask.lanes[0] || mask.lanes[1] || mask.lanes[2] || mask.lanes[3];
+}
+Float4 select(Mask4 mask, Float4 ifTrue, Float4 ifFalse)
+{
+    return perLane<Float4>(
+        [&](size_t lane)
+        {
+            return mask.lanes[lane] ? ifTrue.lanes[lane]
+                                    : ifFalse.lanes[lane];
+        });
+}
+#endif
+
+/// Offsets of the centers of four neighboring pixels from the left edge of
+/// the first one.
+Float4 pixelCenterOffsets()
+{
+    alignas(16) constexpr std::array<float, 4> offsets{0.5F, 1.5F, 2.5F, 3.5F};
+    return load(offsets.data());
+}
+
+/// Position of clip space vertex in depth buffer pixels, with normalized
+/// device depth in z.
+glm::vec3 toScreen(const glm::vec4& clipPosition)
+{
+    const glm::vec3 ndc = glm::vec3{clipPosition} / clipPosition.w;
+    return {(ndc.x * 0.5F + 0.5F) * static_cast<float>(SoftwareCuller::WIDTH),
+            (ndc.y * 0.5F + 0.5F) * static_cast<float>(SoftwareCuller::HEIGHT),
+            ndc.z};
+}
+
+/// Edge function of edge from one vertex to the next, non-negative on the
+/// left side of counter-clockwise triangles. Coefficients of x, y and the
+/// constant term.
+glm::vec3 edgeFunction(const glm::vec3& from, const glm::vec3& to)
+{
+    const float a = from.y - to.y;
+    const float b = to.x - from.x;
+    return {a, b, -a * from.x - b * from.y};
+}
+}  // namespace
+
+SoftwareCuller::SoftwareCuller()
+    : depth_(static_cast<size_t>(WIDTH) * static_cast<size_t>(HEIGHT),
+             CLEAR_DEPTH)
+    , tileMaxDepth_(static_cast<size_t>(TILE_COLUMN_COUNT)
+                        * static_cast<size_t>(BAND_COUNT),
+                    CLEAR_DEPTH)
+    , empty_{true}
+{
+}
+
+void SoftwareCuller::render(const OccluderMesh& occluder,
+                            const BoundingSphere& boundingSphere,
+                            std::span<const glm::mat4> worldMatrices,
+                            const glm::mat4& viewProjection,
+                            const Frustum& frustum,
+                            const glm::vec3& cameraPosition,
+                            ThreadPool& threadPool,
+                            std::pmr::memory_resource* memoryResource)
+{
+    PROFILE_SCOPE("SoftwareCuller::render");
+    std::fill(depth_.begin(), depth_.end(), CLEAR_DEPTH);
+    std::fill(tileMaxDepth_.begin(), tileMaxDepth_.end(), CLEAR_DEPTH);
+    empty_ = true;
+
+    // Nearest copies cover the most of the view, and hide the most behind
+    // them
+    struct Candidate
+    {
+        float distance;
+        size_t copy;
+    };
+    std::pmr::vector<Candidate> candidates{memoryResource};
+    for (size_t i = 0; i < worldMatrices.size(); ++i)
+    {
+        const BoundingSphere sphere
+            = transformSphere(boundingSphere, worldMatrices[i]);
+        if (frustum.intersects(sphere))
+        {
+            candidates.push_back(
+                {glm::distance(cameraPosition, sphere.center), i});
+        }
+    }
+    const size_t copyCount
+        = std::min(candidates.size(), MAX_OCCLUDER_COPY_COUNT);
+    if (copyCount == 0 || occluder.indices.empty())
+    {
+        return;
+    }
+    std::partial_sort(candidates.begin(),
+                      candidates.begin() + static_cast<ptrdiff_t>(copyCount),
+                      candidates.end(),
+                      [](const Candidate& left, const Candidate& right)
+                      { return left.distance < right.distance; });
+
+    // Vertices of each copy are transformed once and shared by its
+    // triangles. Every copy fills its own slots of both arrays.
+    const size_t vertexCount = occluder.positions.size();
+    const size_t triangleCount = occluder.indices.size() / 3;
+    std::pmr::vector<glm::vec4> clipPositions(copyCount * vertexCount,
+                                              memoryResource);
+    std::pmr::vector<ScreenTriangle> triangles(copyCount * triangleCount,
+                                               memoryResource);
+    threadPool.parallelFor(
+        copyCount,
+        1,
+        [&](size_t begin, size_t end)
+        {
+            PROFILE_SCOPE("SoftwareCuller::setupTriangles");
+            for (size_t copy = begin; copy < end; ++copy)
+            {
+                const glm::mat4 modelViewProjection
+                    = viewProjection
+                    * worldMatrices[candidates[copy].copy];
+                glm::vec4* copyPositions
+                    = clipPositions.data() + copy * vertexCount;
+                for (size_t i = 0; i < vertexCount; ++i)
+                {
+                    copyPositions[i] = modelViewProjection
+                                     * glm::vec4{occluder.positions[i], 1.0F};
+                }
+                ScreenTriangle* copyTriangles
+                    = triangles.data() + copy * triangleCount;
+                for (size_t i = 0; i < triangleCount; ++i)
+                {
+                    ScreenTriangle& triangle = copyTriangles[i];
+                    // Empty rectangle unless set up below
+                    triangle.minX = 0;
+                    triangle.maxX = -1;
+                    triangle.minY = 0;
+                    triangle.maxY = -1;
+                    const glm::vec4& clip0
+                        = copyPositions[occluder.indices[i * 3]];
+                    const glm::vec4& clip1
+                        = copyPositions[occluder.indices[i * 3 + 1]];
+                    const glm::vec4& clip2
+                        = copyPositions[occluder.indices[i * 3 + 2]];
+                    if (clip0.w < MIN_W || clip1.w < MIN_W || clip2.w < MIN_W)
+                    {
+                        continue;
+                    }
+                    const glm::vec3 v0 = toScreen(clip0);
+                    glm::vec3 v1 = toScreen(clip1);
+                    glm::vec3 v2 = toScreen(clip2);
+                    float area = (v1.x - v0.x) * (v2.y - v0.y)
+                               - (v1.y - v0.y) * (v2.x - v0.x);
+                    // Occluders hide from both sides, so clockwise triangles
+                    // are turned around instead of culled
+                    if (area < 0.0F)
+                    {
+                        std::swap(v1, v2);
+                        area = -area;
+                    }
+                    if (area < MIN_AREA)
+                    {
+                        continue;
+                    }
+                    const glm::vec3 minimum = glm::min(v0, glm::min(v1, v2));
+                    const glm::vec3 maximum = glm::max(v0, glm::max(v1, v2));
+                    triangle.minX = std::max(
+                        static_cast<int>(std::floor(minimum.x)), 0);
+                    triangle.minY = std::max(
+                        static_cast<int>(std::floor(minimum.y)), 0);
+                    triangle.maxX = std::min(
+                        static_cast<int>(std::ceil(maximum.x)), WIDTH - 1);
+                    triangle.maxY = std::min(
+                        static_cast<int>(std::ceil(maximum.y)), HEIGHT - 1);
+                    triangle.edges = {edgeFunction(v0, v1),
+                                      edgeFunction(v1, v2),
+                                      edgeFunction(v2, v0)};
+                    // Normalized device depth is linear in screen space
+                    const float a = ((v1.z - v0.z) * (v2.y - v0.y)
+                                     - (v2.z - v0.z) * (v1.y - v0.y))
+                                  / area;
+                    const float b = ((v2.z - v0.z) * (v1.x - v0.x)
+                                     - (v1.z - v0.z) * (v2.x - v0.x))
+                                  / area;
+                    triangle.depthPlane = {a, b, v0.z - a * v0.x - b * v0.y};
+                }
+            }
+        });
+
+    // Bands of rows are written by separate tasks without synchronization
+    threadPool.parallelFor(
+        static_cast<size_t>(BAND_COUNT),
+        1,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t band = begin; band < end; ++band)
+            {
+                rasterizeBand(static_cast<int>(band), triangles);
+            }
+        });
+    empty_ = false;
+}
+
+void SoftwareCuller::rasterizeBand(int band,
+                                   std::span<const ScreenTriangle> triangles)
+{
+    PROFILE_SCOPE("SoftwareCuller::rasterizeBand");
+    const int bandMinY = band * TILE_SIZE;
+    const int bandMaxY = bandMinY + TILE_SIZE - 1;
+    const Float4 centerOffsets = pixelCenterOffsets();
+    for (const ScreenTriangle& triangle : triangles)
+    {
+        const int minY = std::max(triangle.minY, bandMinY);
+        const int maxY = std::min(triangle.maxY, bandMaxY);
+        if (minY > maxY || triangle.minX > triangle.maxX)
+        {
+            continue;
+        }
+        // Spans start at a multiple of four pixels, and rows are a multiple
+        // of four pixels wide, so no span runs past the end of its row
+        const int minX = triangle.minX & ~3;
+        // Functions are evaluated at the first four pixel centers of each
+        // row, then advanced by four pixels at a time
+        // Edge functions and depth are planes over pixel coordinates alike.
+        // Vector types are kept in separate variables, as their alignment
+        // attributes are dropped as template arguments of std::array.
+        const Float4 xs = add(splat(static_cast<float>(minX)), centerOffsets);
+        const auto startRow = [&xs](const glm::vec3& plane, float centerY)
+        {
+            return add(multiply(splat(plane.x), xs),
+                       splat(plane.y * centerY + plane.z));
+        };
+        const Float4 edgeStep0 = splat(triangle.edges[0].x * 4.0F);
+        const Float4 edgeStep1 = splat(triangle.edges[1].x * 4.0F);
+        const Float4 edgeStep2 = splat(triangle.edges[2].x * 4.0F);
+        const Float4 depthStep = splat(triangle.depthPlane.x * 4.0F);
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float centerY = static_cast<float>(y) + 0.5F;
+            Float4 edgeValues0 = startRow(triangle.edges[0], centerY);
+            Float4 edgeValues1 = startRow(triangle.edges[1], centerY);
+            Float4 edgeValues2 = startRow(triangle.edges[2], centerY);
+            Float4 depths = startRow(triangle.depthPlane, centerY);
+            float* row = depth_.data() + static_cast<ptrdiff_t>(y) * WIDTH;
+            for (int x = minX; x <= triangle.maxX; x += 4)
+            {
+                const Mask4 inside
+                    = bothTrue(bothTrue(isNonNegative(edgeValues0),
+                                        isNonNegative(edgeValues1)),
+                               isNonNegative(edgeValues2));
+                if (anyTrue(inside))
+                {
+                    const Float4 stored = load(row + x);
+                    store(row + x,
+                          select(inside, minimum(stored, depths), stored));
+                }
+                edgeValues0 = add(edgeValues0, edgeStep0);
+                edgeValues1 = add(edgeValues1, edgeStep1);
+                edgeValues2 = add(edgeValues2, edgeStep2);
+                depths = add(depths, depthStep);
+            }
+        }
+    }
+
+    // Tiles of the band are finished, as no other task writes its rows
+    for (int tileX = 0; tileX < TILE_COLUMN_COUNT; ++tileX)
+    {
+        float maxDepth = -CLEAR_DEPTH;
+        for (int y = bandMinY; y <= bandMaxY; ++y)
+        {
+            const float* row = depth_.data()
+                             + static_cast<ptrdiff_t>(y) * WIDTH
+                             + static_cast<ptrdiff_t>(tileX) * TILE_SIZE;
+            maxDepth = std::max(maxDepth,
+                                *std::max_element(row, row + TILE_SIZE));
+        }
+        tileMaxDepth_[static_cast<size_t>(band * TILE_COLUMN_COUNT + tileX)]
+            = maxDepth;
+    }
+}
+
+bool SoftwareCuller::isOccluded(const Bounds& bounds,
+                                const glm::mat4& modelViewProjection) const
+{
+    if (empty_)
+    {
+        return false;
+    }
+    // Screen rectangle and nearest depth of the box corners
+    glm::vec2 minimum{std::numeric_limits<float>::max()};
+    glm::vec2 maximum{std::numeric_limits<float>::lowest()};
+    float nearestDepth = std::numeric_limits<float>::max();
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 position{
+            (corner & 1) != 0 ? bounds.maximum.x : bounds.minimum.x,
+            (corner & 2) != 0 ? bounds.maximum.y : bounds.minimum.y,
+            (corner & 4) != 0 ? bounds.maximum.z : bounds.minimum.z,
+        };
+        const glm::vec4 clipPosition
+            = modelViewProjection * glm::vec4{position, 1.0F};
+        if (clipPosition.w < MIN_W)
+        {
+            return false;
+        }
+        const glm::vec3 screen = toScreen(clipPosition);
+        minimum = glm::min(minimum, glm::vec2{screen});
+        maximum = glm::max(maximum, glm::vec2{screen});
+        nearestDepth = std::min(nearestDepth, screen.z);
+    }
+    // Every pixel the rectangle touches is tested, whether its center is
+    // covered or not
+    const int minX = std::max(static_cast<int>(std::floor(minimum.x)), 0);
+    const int minY = std::max(static_cast<int>(std::floor(minimum.y)), 0);
+    const int maxX
+        = std::min(static_cast<int>(std::floor(maximum.x)), WIDTH - 1);
+    const int maxY
+        = std::min(static_cast<int>(std::floor(maximum.y)), HEIGHT - 1);
+    if (minX > maxX || minY > maxY)
+    {
+        return false;
+    }
+
+    for (int tileY = minY / TILE_SIZE; tileY <= maxY / TILE_SIZE; ++tileY)
+    {
+        for (int tileX = minX / TILE_SIZE; tileX <= maxX / TILE_SIZE; ++tileX)
+        {
+            // Whole tile is nearer than the box
+            if (tileMaxDepth_[static_cast<size_t>(tileY * TILE_COLUMN_COUNT
+                                                  + tileX)]
+                < nearestDepth)
+            {
+                continue;
+            }
+            const int tileMinX = std::max(minX, tileX * TILE_SIZE);
+            const int tileMaxX
+                = std::min(maxX, tileX * TILE_SIZE + TILE_SIZE - 1);
+            const int tileMinY = std::max(minY, tileY * TILE_SIZE);
+            const int tileMaxY
+                = std::min(maxY, tileY * TILE_SIZE + TILE_SIZE - 1);
+            for (int y = tileMinY; y <= tileMaxY; ++y)
+            {
+                const float* row
+                    = depth_.data() + static_cast<ptrdiff_t>(y) * WIDTH;
+                for (int x = tileMinX; x <= tileMaxX; ++x)
+                {
+                    if (row[x] >= nearestDepth)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef SOFTWARE_CULLER_H_
+#define SOFTWARE_CULLER_H_
+
+#include "frustum.h"
+#include "mesh.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+struct OccluderMesh;
+class ThreadPool;
+
+/// Occlusion culling on the CPU, for targets without compute shaders or
+/// occlusion queries whose results can be read back without stalling, like
+/// WebGL 2.
+///
+/// Low-polygon occluder meshes of the copies nearest to the camera are
+/// rasterized into a small depth buffer on the thread pool, each task owning
+/// a band of rows, four pixels at a time with SSE on x86-64 and with 128-bit
+/// SIMD on WebAssembly. Bounding boxes of copies are then tested against the
+/// farthest depth of each tile they cover before falling back to pixels, so
+/// that copies hidden behind nearer ones are left out before recording any
+/// draw.
+///
+/// Pixels are covered when their center is, so occluders may hide copies
+/// peeking out by less than a pixel of the buffer. Occluders are built from
+/// simplified geometry, which may deviate from the drawn surface by the error
+/// of its simplification. Non-copyable, non-movable.
+class SoftwareCuller
+{
+public:
+    /// Depth buffer resolution, stretched over the viewport.
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 128;
+
+    SoftwareCuller();
+    SoftwareCuller(const SoftwareCuller&) = delete;
+    SoftwareCuller& operator=(const SoftwareCuller&) = delete;
+    SoftwareCuller(SoftwareCuller&&) = delete;
+    SoftwareCuller& operator=(SoftwareCuller&&) = delete;
+    ~SoftwareCuller() = default;
+
+    /// Clear depth buffer and rasterize occluder of the copies nearest to the
+    /// camera among those intersecting the frustum, one copy per world
+    /// matrix. Copies are bounded by model space bounding sphere. Temporary
+    /// arrays are allocated from given memory resource.
+    void render(const OccluderMesh& occluder,
+                const BoundingSphere& boundingSphere,
+                std::span<const glm::mat4> worldMatrices,
+                const glm::mat4& viewProjection,
+                const Frustum& frustum,
+                const glm::vec3& cameraPosition,
+                ThreadPool& threadPool,
+                std::pmr::memory_resource* memoryResource);
+
+    /// Whether box in model space transformed by model-view-projection matrix
+    /// is entirely behind rendered occluders. Boxes crossing the near plane
+    /// are never occluded. Can be called from several threads at once.
+    [[nodiscard]] bool isOccluded(const Bounds& bounds,
+                                  const glm::mat4& modelViewProjection) const;
+
+private:
+    /// Triangle in depth buffer pixels, set up for rasterization. Edge
+    /// functions are non-negative inside, and depth is a plane over pixel
+    /// coordinates.
+    struct ScreenTriangle
+    {
+        std::array<glm::vec3, 3> edges;
+        glm::vec3 depthPlane;
+        /// Pixel rectangle covered, empty for triangles not rasterized.
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    /// Rasterize triangles overlapping rows of band into depth buffer, and
+    /// update farthest depth of the tiles of the band.
+    void rasterizeBand(int band, std::span<const ScreenTriangle> triangles);
+
+    /// Normalized device depth of each pixel, row by row.
+    std::vector<float> depth_;
+    /// Farthest depth of each tile of pixels.
+    std::vector<float> tileMaxDepth_;
+    /// Whether anything was rendered since the depth buffer was cleared.
+    bool empty_;
+};
+
+#endif
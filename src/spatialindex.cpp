@@ -0,0 +1,429 @@
+#include "spatialindex.h"
+
+#include "radixsort.h"
+#include "threadpool.h"
+
+#include "glm/common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iterator>
+#include <limits>
+
+namespace
+{
+constexpr std::uint32_t NO_NODE = std::numeric_limits<std::uint32_t>::max();
+/// Copies per leaf, tested one by one when the leaf is partially inside.
+constexpr std::uint32_t MAX_LEAF_COPY_COUNT = 4;
+/// Loose boxes reach past tight boxes by this fraction of their size on
+/// every side.
+constexpr float LOOSENESS = 0.25F;
+/// Refit hierarchies costing this many times their cost after building are
+/// rebuilt.
+constexpr double REBUILD_COST_RATIO = 1.5;
+/// Copies handled by a single thread pool task.
+constexpr size_t BATCH_SIZE = 1024;
+/// Levels of nodes laid out before handing subtrees to separate tasks, up to
+/// 32 subtrees.
+constexpr int PARALLEL_BUILD_DEPTH = 5;
+/// Deeper than any hierarchy of 32-bit copy indices can be.
+constexpr size_t MAX_QUERY_STACK_SIZE = 64;
+
+Bounds merge(const Bounds& first, const Bounds& second)
+{
+    return {
+        .minimum = glm::min(first.minimum, second.minimum),
+        .maximum = glm::max(first.maximum, second.maximum),
+    };
+}
+
+bool contains(const Bounds& outer, const Bounds& inner)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (inner.minimum[axis] < outer.minimum[axis]
+            || inner.maximum[axis] > outer.maximum[axis])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+double surfaceArea(const Bounds& bounds)
+{
+    const glm::vec3 size = bounds.maximum - bounds.minimum;
+    return 2.0 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+/// Loose box of copy placed by world matrix.
+Bounds loosen(const Bounds& bounds, const glm::mat4& worldMatrix)
+{
+    const Bounds tight = transformBounds(bounds, worldMatrix);
+    const glm::vec3 margin = (tight.maximum - tight.minimum) * LOOSENESS;
+    return {
+        .minimum = tight.minimum - margin,
+        .maximum = tight.maximum + margin,
+    };
+}
+
+/// Spread lower 10 bits of value to every third bit.
+std::uint32_t expandBits(std::uint32_t value)
+{
+    value = (value * 0x00010001U) & 0xFF0000FFU;
+    value = (value * 0x00000101U) & 0x0F00F00FU;
+    value = (value * 0x00000011U) & 0xC30C30C3U;
+    value = (value * 0x00000005U) & 0x49249249U;
+    return value;
+}
+
+/// 30-bit Morton code of position normalized to [0, 1] range.
+std::uint32_t mortonCode(const glm::vec3& position)
+{
+    const glm::vec3 quantized
+        = glm::clamp(position * 1024.0F, glm::vec3{0.0F}, glm::vec3{1023.0F});
+    return (expandBits(static_cast<std::uint32_t>(quantized.x)) << 2U)
+         | (expandBits(static_cast<std::uint32_t>(quantized.y)) << 1U)
+         | expandBits(static_cast<std::uint32_t>(quantized.z));
+}
+
+/// Copy index in the lower half of the key, ordered by Morton code in the
+/// upper half.
+struct MortonKey
+{
+    std::uint64_t sortKey;
+};
+}  // namespace
+
+SpatialIndex::SpatialIndex()
+    : bounds_{}
+    , refitGeneration_{0}
+    , nodeAreaSum_{0.0}
+    , builtCost_{0.0}
+    , rebuildCount_{0}
+{
+}
+
+void SpatialIndex::update(const Bounds& bounds,
+                          std::span<const glm::mat4> worldMatrices,
+                          std::span<const std::uint32_t> changedCopies,
+                          ThreadPool& threadPool)
+{
+    if (worldMatrices.size() != looseBounds_.size()
+        || bounds.minimum != bounds_.minimum
+        || bounds.maximum != bounds_.maximum)
+    {
+        bounds_ = bounds;
+        looseBounds_.resize(worldMatrices.size());
+        copyLeaves_.resize(worldMatrices.size());
+        threadPool.parallelFor(worldMatrices.size(),
+                               BATCH_SIZE,
+                               [&](size_t begin, size_t end)
+                               {
+                                   for (size_t i = begin; i < end; ++i)
+                                   {
+                                       looseBounds_[i]
+                                           = loosen(bounds, worldMatrices[i]);
+                                   }
+                               });
+        rebuild(threadPool);
+        return;
+    }
+
+    // Copies still within their loose box are left where they are
+    movedCopies_.assign(changedCopies.size(), 0);
+    threadPool.parallelFor(
+        changedCopies.size(),
+        BATCH_SIZE,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const std::uint32_t copy = changedCopies[i];
+                const Bounds tight
+                    = transformBounds(bounds_, worldMatrices[copy]);
+                if (!contains(looseBounds_[copy], tight))
+                {
+                    looseBounds_[copy] = loosen(bounds_, worldMatrices[copy]);
+                    movedCopies_[i] = 1;
+                }
+            }
+        });
+
+    // Nodes above moved copies are gathered once even when shared, and
+    // refit children first. Children come after their parent in the node
+    // array.
+    ++refitGeneration_;
+    refitNodes_.clear();
+    for (size_t i = 0; i < changedCopies.size(); ++i)
+    {
+        if (!movedCopies_[i])
+        {
+            continue;
+        }
+        for (std::uint32_t node = copyLeaves_[changedCopies[i]];
+             node != NO_NODE && refitMarks_[node] != refitGeneration_;
+             node = nodes_[node].parent)
+        {
+            refitMarks_[node] = refitGeneration_;
+            refitNodes_.push_back(node);
+        }
+    }
+    if (refitNodes_.empty())
+    {
+        return;
+    }
+    std::sort(refitNodes_.begin(), refitNodes_.end(), std::greater<>{});
+    for (const std::uint32_t node : refitNodes_)
+    {
+        nodeAreaSum_ -= surfaceArea(nodes_[node].bounds);
+        refitNode(node);
+        nodeAreaSum_ += surfaceArea(nodes_[node].bounds);
+    }
+    if (getCost() > builtCost_ * REBUILD_COST_RATIO)
+    {
+        rebuild(threadPool);
+    }
+}
+
+void SpatialIndex::query(const Frustum& frustum,
+                         std::pmr::vector<std::uint32_t>& outCopies) const
+{
+    if (nodes_.empty())
+    {
+        return;
+    }
+    std::array<std::uint32_t, MAX_QUERY_STACK_SIZE> stack{};
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const std::uint32_t index = stack[--stackSize];
+        const Node& node = nodes_[index];
+        const Frustum::Overlap overlap = frustum.classify(node.bounds);
+        if (overlap == Frustum::Overlap::Outside)
+        {
+            continue;
+        }
+        const auto firstCopy = copyOrder_.begin() + node.firstCopy;
+        if (overlap == Frustum::Overlap::Inside)
+        {
+            outCopies.insert(outCopies.end(),
+                             firstCopy,
+                             firstCopy + node.copyCount);
+        }
+        else if (node.rightChild == NO_NODE)
+        {
+            std::copy_if(firstCopy,
+                         firstCopy + node.copyCount,
+                         std::back_inserter(outCopies),
+                         [&](std::uint32_t copy)
+                         {
+                             return frustum.classify(looseBounds_[copy])
+                                 != Frustum::Overlap::Outside;
+                         });
+        }
+        else
+        {
+            // Left child is visited first to keep copies in order
+            stack[stackSize++] = node.rightChild;
+            stack[stackSize++] = index + 1;
+        }
+    }
+}
+
+void SpatialIndex::rebuild(ThreadPool& threadPool)
+{
+    ++rebuildCount_;
+    const size_t copyCount = looseBounds_.size();
+    nodes_.clear();
+    copyOrder_.resize(copyCount);
+    if (copyCount == 0)
+    {
+        nodeAreaSum_ = 0.0;
+        builtCost_ = 0.0;
+        return;
+    }
+
+    // Box centers are sorted along a Morton curve over the box around all of
+    // them
+    glm::vec3 centerMinimum{std::numeric_limits<float>::max()};
+    glm::vec3 centerMaximum{std::numeric_limits<float>::lowest()};
+    for (const Bounds& bounds : looseBounds_)
+    {
+        const glm::vec3 center = (bounds.minimum + bounds.maximum) * 0.5F;
+        centerMinimum = glm::min(centerMinimum, center);
+        centerMaximum = glm::max(centerMaximum, center);
+    }
+    const glm::vec3 inverseExtent
+        = 1.0F
+        / glm::max(centerMaximum - centerMinimum,
+                   glm::vec3{std::numeric_limits<float>::min()});
+    std::vector<MortonKey> keys(copyCount);
+    threadPool.parallelFor(
+        copyCount,
+        BATCH_SIZE,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const Bounds& bounds = looseBounds_[i];
+                const glm::vec3 center
+                    = (bounds.minimum + bounds.maximum) * 0.5F;
+                keys[i].sortKey
+                    = (std::uint64_t{mortonCode((center - centerMinimum)
+                                                * inverseExtent)}
+                       << 32U)
+                    | i;
+            }
+        });
+    std::vector<MortonKey> scratch;
+    radixSortByKey(keys, scratch);
+    for (size_t i = 0; i < copyCount; ++i)
+    {
+        copyOrder_[i] = static_cast<std::uint32_t>(keys[i].sortKey);
+    }
+
+    // Leaves are full except for the last one, and halving leaf ranges gives
+    // a subtree over n leaves 2n - 1 nodes, so that each subtree knows where
+    // its nodes go without waiting for others. Top levels are laid out here,
+    // subtrees below them by separate tasks.
+    const auto leafCount = static_cast<std::uint32_t>(
+        (copyCount + MAX_LEAF_COPY_COUNT - 1) / MAX_LEAF_COPY_COUNT);
+    nodes_.resize(size_t{leafCount} * 2 - 1);
+    struct Subtree
+    {
+        std::uint32_t node;
+        std::uint32_t parent;
+        std::uint32_t firstLeaf;
+        std::uint32_t leafCount;
+        int depth;
+    };
+    std::vector<Subtree> pending{{0, NO_NODE, 0, leafCount, 0}};
+    std::vector<Subtree> subtrees;
+    std::vector<std::uint32_t> topNodes;
+    while (!pending.empty())
+    {
+        const Subtree subtree = pending.back();
+        pending.pop_back();
+        if (subtree.depth == PARALLEL_BUILD_DEPTH || subtree.leafCount == 1)
+        {
+            subtrees.push_back(subtree);
+            continue;
+        }
+        initNode(subtree.node,
+                 subtree.parent,
+                 subtree.firstLeaf,
+                 subtree.leafCount);
+        topNodes.push_back(subtree.node);
+        const std::uint32_t leftLeafCount = subtree.leafCount / 2;
+        pending.push_back({
+            .node = subtree.node + 2 * leftLeafCount,
+            .parent = subtree.node,
+            .firstLeaf = subtree.firstLeaf + leftLeafCount,
+            .leafCount = subtree.leafCount - leftLeafCount,
+            .depth = subtree.depth + 1,
+        });
+        pending.push_back({
+            .node = subtree.node + 1,
+            .parent = subtree.node,
+            .firstLeaf = subtree.firstLeaf,
+            .leafCount = leftLeafCount,
+            .depth = subtree.depth + 1,
+        });
+    }
+    threadPool.parallelFor(subtrees.size(),
+                           1,
+                           [&](size_t begin, size_t end)
+                           {
+                               for (size_t i = begin; i < end; ++i)
+                               {
+                                   const Subtree& subtree = subtrees[i];
+                                   buildSubtree(subtree.node,
+                                                subtree.parent,
+                                                subtree.firstLeaf,
+                                                subtree.leafCount);
+                               }
+                           });
+    // Top nodes were laid out parents first
+    for (auto node = topNodes.rbegin(); node != topNodes.rend(); ++node)
+    {
+        refitNode(*node);
+    }
+
+    refitMarks_.assign(nodes_.size(), 0);
+    refitGeneration_ = 0;
+    nodeAreaSum_ = 0.0;
+    for (const Node& node : nodes_)
+    {
+        nodeAreaSum_ += surfaceArea(node.bounds);
+    }
+    builtCost_ = getCost();
+}
+
+void SpatialIndex::buildSubtree(std::uint32_t node,
+                                std::uint32_t parent,
+                                std::uint32_t firstLeaf,
+                                std::uint32_t leafCount)
+{
+    initNode(node, parent, firstLeaf, leafCount);
+    if (leafCount > 1)
+    {
+        const std::uint32_t leftLeafCount = leafCount / 2;
+        buildSubtree(node + 1, node, firstLeaf, leftLeafCount);
+        buildSubtree(node + 2 * leftLeafCount,
+                     node,
+                     firstLeaf + leftLeafCount,
+                     leafCount - leftLeafCount);
+    }
+    refitNode(node);
+}
+
+void SpatialIndex::initNode(std::uint32_t node,
+                            std::uint32_t parent,
+                            std::uint32_t firstLeaf,
+                            std::uint32_t leafCount)
+{
+    const std::uint32_t firstCopy = firstLeaf * MAX_LEAF_COPY_COUNT;
+    const std::uint32_t endCopy
+        = std::min(static_cast<std::uint32_t>(copyOrder_.size()),
+                   (firstLeaf + leafCount) * MAX_LEAF_COPY_COUNT);
+    nodes_[node] = {
+        .bounds = {},
+        .firstCopy = firstCopy,
+        .copyCount = endCopy - firstCopy,
+        .parent = parent,
+        .rightChild = leafCount > 1 ? node + 2 * (leafCount / 2) : NO_NODE,
+    };
+    if (leafCount == 1)
+    {
+        for (std::uint32_t i = firstCopy; i < endCopy; ++i)
+        {
+            copyLeaves_[copyOrder_[i]] = node;
+        }
+    }
+}
+
+void SpatialIndex::refitNode(std::uint32_t node)
+{
+    Node& refit = nodes_[node];
+    if (refit.rightChild != NO_NODE)
+    {
+        refit.bounds
+            = merge(nodes_[node + 1].bounds, nodes_[refit.rightChild].bounds);
+        return;
+    }
+    refit.bounds = looseBounds_[copyOrder_[refit.firstCopy]];
+    for (std::uint32_t i = 1; i < refit.copyCount; ++i)
+    {
+        refit.bounds = merge(refit.bounds,
+                             looseBounds_[copyOrder_[refit.firstCopy + i]]);
+    }
+}
+
+double SpatialIndex::getCost() const
+{
+    const double rootArea = surfaceArea(nodes_.front().bounds);
+    return rootArea > 0.0 ? nodeAreaSum_ / rootArea : 0.0;
+}
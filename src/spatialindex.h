@@ -0,0 +1,107 @@
+#ifndef SPATIAL_INDEX_H_
+#define SPATIAL_INDEX_H_
+
+#include "frustum.h"
+#include "mesh.h"
+
+#include "glm/mat4x4.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+/// Bounding volume hierarchy over world space boxes of the copies of an
+/// object, kept up to date as copies move, for finding copies in a frustum
+/// without testing every one of them.
+///
+/// Copies are bounded by loose boxes reaching past their tight box, so that
+/// copies moving within their loose box leave the hierarchy untouched. Copies
+/// leaving it get a new loose box, and nodes above them are refit together
+/// once per update. Refitting lets nodes grow and overlap, so the hierarchy
+/// is rebuilt when its surface area cost grows too far past the cost right
+/// after the last build.
+///
+/// Building sorts copies along a Morton curve and splits them in halves down
+/// to leaves of a few copies each, subtrees built in parallel on the thread
+/// pool. Every subtree covers a contiguous range of the copy order, so queries
+/// append whole subtrees entirely inside the frustum without visiting their
+/// nodes, and return neighboring copies next to each other.
+class SpatialIndex
+{
+public:
+    SpatialIndex();
+
+    /// Place copies of object bounded by model space box at world matrices.
+    /// Only copies listed as changed since the previous update are moved.
+    /// Hierarchy is rebuilt from scratch when the number of copies or the
+    /// box differ from the previous update.
+    void update(const Bounds& bounds,
+                std::span<const glm::mat4> worldMatrices,
+                std::span<const std::uint32_t> changedCopies,
+                ThreadPool& threadPool);
+
+    /// Append indices of copies whose loose box may intersect frustum, in
+    /// Morton order. Copies still need their own visibility test, as loose
+    /// boxes enclose them generously.
+    void query(const Frustum& frustum,
+               std::pmr::vector<std::uint32_t>& outCopies) const;
+
+    /// Number of copies indexed.
+    [[nodiscard]] size_t size() const { return looseBounds_.size(); }
+    /// Number of times the hierarchy was rebuilt so far, including the
+    /// builds of new sets of copies.
+    [[nodiscard]] std::uint32_t rebuildCount() const { return rebuildCount_; }
+
+private:
+    struct Node
+    {
+        Bounds bounds;
+        /// Copies of the subtree as a range of the copy order.
+        std::uint32_t firstCopy;
+        std::uint32_t copyCount;
+        std::uint32_t parent;
+        /// Left child follows its parent. No right child in leaves.
+        std::uint32_t rightChild;
+    };
+
+    /// Sort copies along a Morton curve and build hierarchy over them.
+    void rebuild(ThreadPool& threadPool);
+    /// Build nodes of subtree over range of leaves, root at given node.
+    void buildSubtree(std::uint32_t node,
+                      std::uint32_t parent,
+                      std::uint32_t firstLeaf,
+                      std::uint32_t leafCount);
+    /// Set range of copies and children of node, without its bounds.
+    void initNode(std::uint32_t node,
+                  std::uint32_t parent,
+                  std::uint32_t firstLeaf,
+                  std::uint32_t leafCount);
+    /// Recompute bounds of node from its children or copies.
+    void refitNode(std::uint32_t node);
+    /// Sum of node surface areas relative to root surface area, the expected
+    /// number of nodes a random ray through the root visits.
+    [[nodiscard]] double getCost() const;
+
+    Bounds bounds_;
+    std::vector<Node> nodes_;
+    /// Copy indices in the order of the hierarchy.
+    std::vector<std::uint32_t> copyOrder_;
+    /// Indexed by copy.
+    std::vector<Bounds> looseBounds_;
+    std::vector<std::uint32_t> copyLeaves_;
+    /// Scratch arrays of updates, kept to avoid allocations.
+    std::vector<std::uint8_t> movedCopies_;
+    std::vector<std::uint32_t> refitNodes_;
+    std::vector<std::uint32_t> refitMarks_;
+    std::uint32_t refitGeneration_;
+    /// Kept up to date by refits, instead of summing every node.
+    double nodeAreaSum_;
+    double builtCost_;
+    std::uint32_t rebuildCount_;
+};
+
+#endif
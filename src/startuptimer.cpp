@@ -0,0 +1,61 @@
+#include "startuptimer.h"
+
+#include "utils.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+float toMilliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<float, std::milli>(duration).count();
+}
+}  // namespace
+
+StartupTimer::StartupTimer()
+    : startTime_{Clock::now()}
+    , phaseBegin_{startTime_}
+    , phaseTimes_{}
+{
+}
+
+void StartupTimer::finishPhase(StartupPhase phase)
+{
+    const Clock::time_point now = Clock::now();
+    phaseTimes_[static_cast<size_t>(phase)]
+        = toMilliseconds(now - phaseBegin_);
+    phaseBegin_ = now;
+}
+
+void StartupTimer::finishFirstFrame()
+{
+    if (timeToFirstFrame_)
+    {
+        return;
+    }
+    timeToFirstFrame_ = toMilliseconds(Clock::now() - startTime_);
+
+    std::ostringstream phaseStream;
+    phaseStream << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        phaseStream << PHASE_NAMES[i] << ' ' << phaseTimes_[i] << " ms, ";
+    }
+    utils::logInfo("startup phases: ",
+                   phaseStream.str(),
+                   "first frame after ",
+                   timeToFirstFrame_.value(),
+                   " ms");
+}
+
+void StartupTimer::finishModelLoading()
+{
+    if (modelLoadTime_)
+    {
+        return;
+    }
+    modelLoadTime_ = toMilliseconds(Clock::now() - startTime_);
+    utils::logInfo("models loaded after ", modelLoadTime_.value(), " ms");
+}
+
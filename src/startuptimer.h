@@ -0,0 +1,77 @@
+#ifndef STARTUP_TIMER_H_
+#define STARTUP_TIMER_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/// Phases of application initialization, in the order they run.
+enum class StartupPhase : std::uint8_t
+{
+    WindowingSystem,
+    Window,
+    Gui,
+    /// Loading graphics API functions and submitting shaders for compilation.
+    Renderer,
+    Skybox,
+    /// Requesting model loads and waiting for shader compilation to finish.
+    Shaders,
+};
+
+/// Duration of each phase of cold start, the baseline for making the first
+/// frame show up sooner.
+///
+/// Phases are measured back to back from construction, each lasting until
+/// the next one finishes. Models are loaded in the background while frames
+/// are drawn, so time until the first frame and until every model arrived are
+/// measured from construction instead. Results are logged once known.
+class StartupTimer
+{
+public:
+    static constexpr size_t PHASE_COUNT = 6;
+    // Order matches startup phases
+    static constexpr std::array<const char*, PHASE_COUNT> PHASE_NAMES{
+        "Windowing system",
+        "Window",
+        "UI",
+        "Renderer",
+        "Skybox",
+        "Shaders"};
+
+    /// Milliseconds spent in each phase.
+    using PhaseTimes = std::array<float, PHASE_COUNT>;
+
+    StartupTimer();
+
+    /// Record that phase finished, after the previous one.
+    void finishPhase(StartupPhase phase);
+    /// Record that the first frame was presented. Later calls are ignored.
+    void finishFirstFrame();
+    /// Record that every model finished loading. Later calls are ignored.
+    void finishModelLoading();
+
+    [[nodiscard]] const PhaseTimes& phaseTimes() const { return phaseTimes_; }
+    /// Milliseconds from start until the first frame was presented.
+    [[nodiscard]] std::optional<float> timeToFirstFrame() const
+    {
+        return timeToFirstFrame_;
+    }
+    /// Milliseconds from start until every model finished loading.
+    [[nodiscard]] std::optional<float> modelLoadTime() const
+    {
+        return modelLoadTime_;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point startTime_;
+    Clock::time_point phaseBegin_;
+    PhaseTimes phaseTimes_;
+    std::optional<float> timeToFirstFrame_;
+    std::optional<float> modelLoadTime_;
+};
+
+#endif
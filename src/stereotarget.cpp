@@ -0,0 +1,181 @@
+#include "stereotarget.h"
+
+#include "rendertarget.h"
+#include "videomemory.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture units of eye color and depth while composing. Skybox takes the
+/// first unit again afterwards, and the sixth is left free by model shaders.
+constexpr GLuint COLOR_TEXTURE_UNIT = 0;
+constexpr GLuint DEPTH_TEXTURE_UNIT = 6;
+/// Bytes per texel of 24-bit depth, assuming it is padded to 32 bits.
+constexpr size_t DEPTH_TEXEL_SIZE = 4;
+
+/// Allocate mutable storage of layers of a texture array, fetched exactly
+/// by composition.
+void allocateLayers(GLuint texture,
+                    GLenum internalFormat,
+                    GLenum format,
+                    GLenum type,
+                    int width,
+                    int height,
+                    int layerCount)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY,
+                 0,
+                 static_cast<GLint>(internalFormat),
+                 width,
+                 height,
+                 layerCount,
+                 0,
+                 format,
+                 type,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+}  // namespace
+
+StereoTarget::StereoTarget()
+    : colorTexture_{0}
+    , depthTexture_{0}
+    , framebuffer_{0}
+    , colorFormat_{GL_RGBA16F}
+    , width_{0}
+    , height_{0}
+{
+}
+
+StereoTarget::~StereoTarget()
+{
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &depthTexture_);
+    glDeleteTextures(1, &colorTexture_);
+}
+
+PendingShader StereoTarget::submitShader()
+{
+#ifdef __EMSCRIPTEN__
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gles3.vert.glsl"},
+        fs::path{"assets/shaders/stereo_compose_gles3.frag.glsl"});
+#else
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gl4.vert.glsl"},
+        fs::path{"assets/shaders/stereo_compose_gl4.frag.glsl"});
+#endif
+}
+
+bool StereoTarget::init(PendingShader&& shader)
+{
+    shader_ = shader.finish();
+    if (!shader_)
+    {
+        return false;
+    }
+    colorUniform_ = shader_->getUniformHandle<int>("u_color");
+    depthUniform_ = shader_->getUniformHandle<int>("u_depth");
+    eyeWidthUniform_ = shader_->getUniformHandle<int>("u_eyeWidth");
+    return true;
+}
+
+bool StereoTarget::resize(int width, int height, GLenum colorFormat)
+{
+    if (width == width_ && height == height_ && colorFormat == colorFormat_)
+    {
+        return true;
+    }
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    width_ = width;
+    height_ = height;
+    colorFormat_ = colorFormat;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize());
+
+    if (!framebuffer_)
+    {
+        glGenTextures(1, &colorTexture_);
+        glGenTextures(1, &depthTexture_);
+        glGenFramebuffers(1, &framebuffer_);
+    }
+    // OpenGL ES 3.0 only accepts half float format with half float or float
+    // pixel types, even without pixels to upload
+    allocateLayers(colorTexture_,
+                   colorFormat,
+                   GL_RGBA,
+                   colorFormat == GL_RGBA16F ? GL_HALF_FLOAT
+                                             : GL_UNSIGNED_BYTE,
+                   width,
+                   height,
+                   VIEW_COUNT);
+    allocateLayers(depthTexture_,
+                   GL_DEPTH_COMPONENT24,
+                   GL_DEPTH_COMPONENT,
+                   GL_UNSIGNED_INT,
+                   width,
+                   height,
+                   VIEW_COUNT);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER,
+                                     GL_COLOR_ATTACHMENT0,
+                                     colorTexture_,
+                                     0,
+                                     0,
+                                     VIEW_COUNT);
+    glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER,
+                                     GL_DEPTH_ATTACHMENT,
+                                     depthTexture_,
+                                     0,
+                                     0,
+                                     VIEW_COUNT);
+    const bool complete
+        = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void StereoTarget::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+}
+
+void StereoTarget::compose(int eyeWidth,
+                           GLuint emptyVertexArray,
+                           GlStateCache& glState)
+{
+    // Every pixel of the scene is covered by an eye, replacing whatever the
+    // scene was cleared to, without blending into it
+    glState.setBlendEnabled(false);
+    glState.setDepthFunc(GL_ALWAYS);
+    glState.setDepthWriteEnabled(true);
+    glState.setColorWriteEnabled(true);
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(COLOR_TEXTURE_UNIT,
+                        GL_TEXTURE_2D_ARRAY,
+                        colorTexture_);
+    glState.bindTexture(DEPTH_TEXTURE_UNIT,
+                        GL_TEXTURE_2D_ARRAY,
+                        depthTexture_);
+    shader_->use(glState);
+    shader_->setUniform(colorUniform_, static_cast<int>(COLOR_TEXTURE_UNIT));
+    shader_->setUniform(depthUniform_, static_cast<int>(DEPTH_TEXTURE_UNIT));
+    shader_->setUniform(eyeWidthUniform_, eyeWidth);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+size_t StereoTarget::videoMemorySize() const
+{
+    return static_cast<size_t>(width_) * static_cast<size_t>(height_)
+         * static_cast<size_t>(VIEW_COUNT)
+         * (RenderTarget::colorPixelSize(colorFormat_) + DEPTH_TEXEL_SIZE);
+}
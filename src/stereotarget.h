@@ -0,0 +1,79 @@
+#ifndef STEREO_TARGET_H_
+#define STEREO_TARGET_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <cstddef>
+#include <optional>
+
+/// Layered framebuffer both eyes of stereo rendering are drawn into at once,
+/// composed side by side into the scene afterwards.
+///
+/// Drawing each eye separately submits every draw twice. With
+/// OVR_multiview2, each draw is instead broadcast into both layers of the
+/// target by the driver, with vertex shaders selecting the view projection of
+/// the layer by view index, halving draw submission.
+///
+/// Like the scene framebuffer, layers are allocated for half the window size
+/// and each eye is drawn into a rectangle at their bottom-left corner.
+/// Depth is a texture, as it is sampled by composition to keep depth testing
+/// of draws following it.
+///
+/// Framebuffer is created on first resize. Non-copyable, non-movable.
+class StereoTarget
+{
+public:
+    StereoTarget();
+    StereoTarget(const StereoTarget&) = delete;
+    StereoTarget& operator=(const StereoTarget&) = delete;
+    StereoTarget(StereoTarget&&) = delete;
+    StereoTarget& operator=(StereoTarget&&) = delete;
+    ~StereoTarget();
+
+    /// Submit shader for compilation without waiting for the driver to
+    /// finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted shader.
+    bool init(PendingShader&& shader);
+
+    /// Recreate layers when the window framebuffer size or scene color
+    /// format changes, taking the size of a single eye. Returns false when
+    /// the driver rejects the framebuffer.
+    bool resize(int width, int height, GLenum colorFormat);
+
+    /// Bind framebuffer for drawing both eyes.
+    void bind() const;
+
+    /// Draw eyes of given size side by side into the bound framebuffer,
+    /// writing their depth as well. Viewport is expected to cover both eyes.
+    /// Depth state is left changed for the caller to restore.
+    void compose(int eyeWidth, GLuint emptyVertexArray, GlStateCache& glState);
+
+private:
+    /// Eyes drawn at once, one per layer.
+    static constexpr int VIEW_COUNT = 2;
+
+    /// Video memory taken by layers in bytes.
+    [[nodiscard]] size_t videoMemorySize() const;
+
+    std::optional<Shader> shader_;
+    UniformHandle<int> colorUniform_;
+    UniformHandle<int> depthUniform_;
+    UniformHandle<int> eyeWidthUniform_;
+    GLuint colorTexture_;
+    GLuint depthTexture_;
+    GLuint framebuffer_;
+    GLenum colorFormat_;
+    int width_;
+    int height_;
+};
+
+#endif
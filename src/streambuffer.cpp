@@ -0,0 +1,202 @@
+#include "streambuffer.h"
+
+#include "utils.h"
+#include "videomemory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+/// Largest offset alignment drivers may require for uniform and storage
+/// buffer ranges, so that every region starts aligned.
+constexpr GLsizeiptr REGION_ALIGNMENT = 256;
+
+void deleteBuffer(GLuint buffer, size_t size)
+{
+    // Mapping is released along with the buffer, while the driver keeps
+    // storage alive for draws still reading it
+    glDeleteBuffers(1, &buffer);
+    videomemory::release(videomemory::Category::DrawData, size);
+}
+}  // namespace
+
+StreamBuffer::StreamBuffer(GLsizeiptr frameCapacity)
+    : buffer_{0}
+    , frameCapacity_{frameCapacity}
+    , mappedData_{nullptr}
+    , currentRegion_{0}
+    , head_{0}
+    , regionFences_{}
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync fence : regionFences_)
+    {
+        glDeleteSync(fence);
+    }
+    for (const RetiredBuffer& retired : retiredBuffers_)
+    {
+        deleteBuffer(retired.buffer, retired.size);
+    }
+    if (buffer_)
+    {
+        deleteBuffer(buffer_, bufferSize());
+    }
+}
+
+void StreamBuffer::beginFrame()
+{
+    for (const RetiredBuffer& retired : retiredBuffers_)
+    {
+        deleteBuffer(retired.buffer, retired.size);
+    }
+    retiredBuffers_.clear();
+    head_ = 0;
+    if (!buffer_)
+    {
+        createBuffer(frameCapacity_);
+        return;
+    }
+
+    if (!mappedData_)
+    {
+        // Orphaning hands previous storage over to the driver until draws of
+        // earlier frames finish, instead of waiting for them
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        glBufferData(GL_COPY_WRITE_BUFFER,
+                     frameCapacity_,
+                     nullptr,
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return;
+    }
+
+    // Fence is inserted after every draw of the previous frame was issued
+    regionFences_[currentRegion_]
+        = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    currentRegion_ = (currentRegion_ + 1) % FRAME_REGION_COUNT;
+    GLsync& fence = regionFences_[currentRegion_];
+    if (fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+StreamBuffer::Range StreamBuffer::write(std::span<const std::byte> data,
+                                        GLsizeiptr alignment)
+{
+    return write(static_cast<GLsizeiptr>(data.size()),
+                 alignment,
+                 [&](std::span<std::byte> memory)
+                 {
+                     std::memcpy(memory.data(), data.data(), data.size());
+                 });
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size,
+                                                GLsizeiptr alignment)
+{
+    GLintptr begin = (head_ + alignment - 1) / alignment * alignment;
+    if (begin + size > frameCapacity_)
+    {
+        createBuffer(std::max(frameCapacity_ * 2, size));
+        begin = 0;
+    }
+    head_ = begin + size;
+
+    if (!mappedData_)
+    {
+        return {
+            .range = {.buffer = buffer_, .offset = begin},
+            .memory = std::span{staging_}.subspan(static_cast<size_t>(begin),
+                                                  static_cast<size_t>(size)),
+        };
+    }
+    const GLintptr offset
+        = static_cast<GLintptr>(currentRegion_) * frameCapacity_ + begin;
+    return {
+        .range = {.buffer = buffer_, .offset = offset},
+        .memory = {mappedData_ + offset, static_cast<size_t>(size)},
+    };
+}
+
+void StreamBuffer::finishWrite(const Range& range, GLsizeiptr size)
+{
+    if (mappedData_)
+    {
+        return;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, range.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    range.offset,
+                    size,
+                    staging_.data() + range.offset);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::createBuffer(GLsizeiptr frameCapacity)
+{
+    if (buffer_)
+    {
+        // Ranges written earlier in the frame are still to be drawn from the
+        // replaced buffer. Its fences guard regions the new buffer does not
+        // share.
+        retiredBuffers_.push_back({.buffer = buffer_, .size = bufferSize()});
+        for (GLsync& fence : regionFences_)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        mappedData_ = nullptr;
+    }
+
+    frameCapacity_ = (frameCapacity + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT
+                   * REGION_ALIGNMENT;
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+#ifndef __EMSCRIPTEN__
+    if (GLAD_GL_ARB_buffer_storage)
+    {
+        // Coherent mapping makes writes visible to the GPU without explicit
+        // flushes, ordering is ensured by fences instead
+        constexpr GLbitfield mapFlags
+            = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr size
+            = frameCapacity_ * static_cast<GLsizeiptr>(FRAME_REGION_COUNT);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, mapFlags);
+        mappedData_ = static_cast<std::byte*>(
+            glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, mapFlags));
+        if (mappedData_)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            videomemory::allocate(videomemory::Category::DrawData,
+                                  bufferSize());
+            return;
+        }
+        // Storage of the buffer is immutable, so it is created again for
+        // orphaning
+        utils::logWarning("unable to map stream buffer persistently, "
+                          "uploading through orphaning instead");
+        glDeleteBuffers(1, &buffer_);
+        glGenBuffers(1, &buffer_);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    }
+#endif
+    glBufferData(GL_COPY_WRITE_BUFFER, frameCapacity_, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    staging_.resize(static_cast<size_t>(frameCapacity_));
+    videomemory::allocate(videomemory::Category::DrawData, bufferSize());
+}
+
+size_t StreamBuffer::bufferSize() const
+{
+    const auto frameCapacity = static_cast<size_t>(frameCapacity_);
+    return mappedData_ ? frameCapacity * FRAME_REGION_COUNT : frameCapacity;
+}
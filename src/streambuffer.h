@@ -0,0 +1,123 @@
+#ifndef STREAM_BUFFER_H_
+#define STREAM_BUFFER_H_
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/// Buffer for data rewritten every frame, like uniforms, instance transforms
+/// and indirect draw commands. Ranges written during a frame are bound as
+/// uniform, storage, vertex or indirect buffer by their offset.
+///
+/// With ARB_buffer_storage (core in OpenGL 4.4), storage is split into one
+/// region per frame in flight and persistently mapped, so data is written
+/// straight into memory read by the GPU. Each region is fenced at the end of
+/// its frame and only waited for when it comes around again, three frames
+/// later. Otherwise storage is orphaned at the start of every frame and each
+/// range is uploaded from a CPU copy, which the driver does not need to
+/// synchronize with draws of previous frames either.
+///
+/// A frame writing more than fits continues in a larger buffer, which takes
+/// the place of the current one from the next frame on. Ranges written
+/// earlier in the frame stay in the replaced buffer until then, so each range
+/// is bound by the buffer it was written to.
+///
+/// Buffer is created on the first frame. Non-copyable, non-movable, pending
+/// draws refer to the buffer.
+class StreamBuffer
+{
+public:
+    /// Number of frames the CPU may write ahead of the GPU.
+    static constexpr size_t FRAME_REGION_COUNT = 3;
+
+    /// Written data, to be bound by buffer and offset.
+    struct Range
+    {
+        GLuint buffer;
+        GLintptr offset;
+    };
+
+    explicit StreamBuffer(GLsizeiptr frameCapacity);
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    StreamBuffer(StreamBuffer&&) = delete;
+    StreamBuffer& operator=(StreamBuffer&&) = delete;
+    ~StreamBuffer();
+
+    /// Fence the region written by the previous frame and switch to the next
+    /// one, waiting for the GPU to finish reading it if still in use.
+    void beginFrame();
+
+    /// Reserve size bytes at given alignment in the region of the current
+    /// frame, and let fill write them through the span it receives.
+    ///
+    /// Span stays writable only until fill returns, which may spread the work
+    /// over threads in the meantime.
+    template <typename Fill>
+    Range write(GLsizeiptr size, GLsizeiptr alignment, Fill&& fill);
+
+    /// Copy data into the region of the current frame.
+    Range write(std::span<const std::byte> data, GLsizeiptr alignment);
+
+private:
+    /// Reserved range of the current frame.
+    struct Allocation
+    {
+        Range range;
+        /// Mapped storage or CPU copy to write the range into.
+        std::span<std::byte> memory;
+    };
+
+    /// Buffer replaced during the current frame, deleted at the start of the
+    /// next one.
+    struct RetiredBuffer
+    {
+        GLuint buffer;
+        size_t size;
+    };
+
+    /// Reserve range of the current frame, growing the buffer if it does not
+    /// fit.
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment);
+    /// Upload range written into the CPU copy, when storage is not mapped.
+    void finishWrite(const Range& range, GLsizeiptr size);
+    /// Create buffer fitting given size per frame, retiring the current one.
+    void createBuffer(GLsizeiptr frameCapacity);
+    /// Video memory of the current buffer in bytes.
+    [[nodiscard]] size_t bufferSize() const;
+
+    GLuint buffer_;
+    GLsizeiptr frameCapacity_;
+    /// Persistently mapped storage of all regions, null when orphaning
+    /// instead.
+    std::byte* mappedData_;
+    /// CPU copy of the current frame, when orphaning.
+    std::vector<std::byte> staging_;
+    size_t currentRegion_;
+    /// Offset into the region of the current frame.
+    GLintptr head_;
+    /// Signalled when the GPU finished reading each region, null when no
+    /// draws are pending.
+    std::array<GLsync, FRAME_REGION_COUNT> regionFences_;
+    std::vector<RetiredBuffer> retiredBuffers_;
+};
+
+template <typename Fill>
+StreamBuffer::Range StreamBuffer::write(GLsizeiptr size,
+                                        GLsizeiptr alignment,
+                                        Fill&& fill)
+{
+    const Allocation allocation = allocate(size, alignment);
+    fill(allocation.memory);
+    finishWrite(allocation.range, size);
+    return allocation.range;
+}
+
+#endif
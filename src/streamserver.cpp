@@ -0,0 +1,387 @@
+#include "streamserver.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#endif
+
+namespace
+{
+/// Readbacks in flight. Frames are usually read back a frame or two after
+/// being drawn, a third buffer covers frames the GPU is late with.
+constexpr size_t READBACK_BUFFER_COUNT = 3;
+/// Frames waiting for the writer thread before further ones are dropped.
+/// Kept short, as every queued frame adds a frame of latency.
+constexpr size_t MAX_QUEUED_FRAME_COUNT = 2;
+/// Bytes of input read at once, holding many lines of input.
+constexpr size_t INPUT_BUFFER_SIZE = 4096;
+
+float toMilliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<float, std::milli>(duration).count();
+}
+}  // namespace
+
+StreamServer::StreamServer(Options options)
+    : options_{std::move(options)}
+    , pixelReadback_(READBACK_BUFFER_COUNT)
+    , frameIndex_{0}
+    , droppedFrameCount_{0}
+    , finished_{false}
+    , inputDescriptor_{-1}
+    , stopPipe_{-1, -1}
+    , pendingInput_{}
+    , frameDescriptor_{-1}
+    , writtenFrameCount_{0}
+    , latencySampleCount_{0}
+    , totalLatency_{0}
+    , maxLatency_{0}
+    , stopping_{false}
+{
+}
+
+StreamServer::~StreamServer()
+{
+    {
+        const std::lock_guard lock(frameMutex_);
+        stopping_ = true;
+    }
+    frameQueued_.notify_one();
+    if (writerThread_.joinable())
+    {
+        writerThread_.join();
+    }
+#ifndef _WIN32
+    if (inputThread_.joinable())
+    {
+        const char wakeUp = 0;
+        [[maybe_unused]] const ssize_t written
+            = write(stopPipe_[1], &wakeUp, sizeof(wakeUp));
+        inputThread_.join();
+    }
+    for (const int descriptor :
+         {inputDescriptor_, stopPipe_[0], stopPipe_[1], frameDescriptor_})
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+    }
+#endif
+}
+
+bool StreamServer::start()
+{
+#ifdef _WIN32
+    utils::showErrorMessage("streaming is not supported on Windows");
+    return false;
+#else
+    // Writes into a pipe closed by the gateway fail with EPIPE instead
+    std::signal(SIGPIPE, SIG_IGN);
+    // Opening a named pipe blocks until the other end is opened
+    utils::logInfo("waiting for stream gateway to open ",
+                   options_.frameOutputPath,
+                   " and ",
+                   options_.inputPath);
+    frameDescriptor_
+        = open(options_.frameOutputPath.c_str(), O_WRONLY | O_CLOEXEC);
+    if (frameDescriptor_ < 0)
+    {
+        utils::showErrorMessage("unable to open stream frame output ",
+                                options_.frameOutputPath);
+        return false;
+    }
+    inputDescriptor_ = open(options_.inputPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (inputDescriptor_ < 0)
+    {
+        utils::showErrorMessage("unable to open stream input ",
+                                options_.inputPath);
+        return false;
+    }
+    if (pipe(stopPipe_.data()) < 0)
+    {
+        utils::showErrorMessage("unable to create stream input stop pipe");
+        return false;
+    }
+    utils::logInfo("streaming frames");
+    inputThread_ = std::thread(&StreamServer::readInputLoop, this);
+    writerThread_ = std::thread(&StreamServer::writeLoop, this);
+    return true;
+#endif
+}
+
+Simulation::Input StreamServer::takeInput()
+{
+    const std::lock_guard lock(inputMutex_);
+    const Simulation::Input input = pendingInput_;
+    // Held keys stay held until the client releases them
+    pendingInput_.lookOffset = glm::vec2{0.0F};
+    if (!frameInputTime_)
+    {
+        frameInputTime_ = pendingInputTime_;
+    }
+    pendingInputTime_.reset();
+    return input;
+}
+
+void StreamServer::captureFrame(int width, int height)
+{
+    // Finished readbacks are taken first, freeing their buffers for this
+    // frame
+    while (std::optional<PixelReadback::Pixels> pixels
+           = pixelReadback_.takeFinished())
+    {
+        submit(std::move(pixels.value()));
+    }
+
+    bool queueFull = false;
+    {
+        const std::lock_guard lock(frameMutex_);
+        queueFull = frames_.size() >= MAX_QUEUED_FRAME_COUNT;
+    }
+    if (pixelReadback_.isFull() || queueFull)
+    {
+        // Input taken for a dropped frame is first shown by the next one
+        ++droppedFrameCount_;
+        return;
+    }
+    readbackInputTimes_.push_back(std::exchange(frameInputTime_, {}));
+    pixelReadback_.readPixels(frameIndex_++, width, height);
+}
+
+void StreamServer::finish()
+{
+    while (pixelReadback_.hasPending())
+    {
+        submit(pixelReadback_.takeOldest());
+    }
+    const std::lock_guard lock(frameMutex_);
+    utils::logInfo("stream ended, ",
+                   writtenFrameCount_,
+                   " frames written, ",
+                   droppedFrameCount_,
+                   " dropped");
+    if (latencySampleCount_ > 0)
+    {
+        utils::logInfo(
+            "input to frame output latency: average ",
+            toMilliseconds(totalLatency_
+                           / static_cast<Clock::rep>(latencySampleCount_)),
+            " ms, max ",
+            toMilliseconds(maxLatency_),
+            " ms");
+    }
+}
+
+void StreamServer::readInputLoop()
+{
+#ifndef _WIN32
+    std::array<pollfd, 2> descriptors{{
+        {.fd = inputDescriptor_, .events = POLLIN, .revents = 0},
+        {.fd = stopPipe_[0], .events = POLLIN, .revents = 0},
+    }};
+    std::array<char, INPUT_BUFFER_SIZE> buffer;
+    // Bytes of the line not ended yet by the reads so far
+    std::string line;
+    while (true)
+    {
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (descriptors[1].revents != 0)
+        {
+            return;
+        }
+        const ssize_t length
+            = read(inputDescriptor_, buffer.data(), buffer.size());
+        if (length < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        // Gateway closed the input
+        if (length <= 0)
+        {
+            break;
+        }
+        bool quit = false;
+        for (const char character :
+             std::span{buffer.data(), static_cast<size_t>(length)})
+        {
+            if (character != '\n')
+            {
+                line.push_back(character);
+                continue;
+            }
+            if (!handleInputLine(line))
+            {
+                quit = true;
+                break;
+            }
+            line.clear();
+        }
+        if (quit)
+        {
+            break;
+        }
+    }
+    finished_.store(true, std::memory_order_release);
+#endif
+}
+
+bool StreamServer::handleInputLine(const std::string& line)
+{
+    std::istringstream stream{line};
+    std::string command;
+    stream >> command;
+    if (command == "quit")
+    {
+        return false;
+    }
+    const Clock::time_point arrivalTime = Clock::now();
+    const std::lock_guard lock(inputMutex_);
+    if (command == "look")
+    {
+        glm::vec2 offset{0.0F};
+        if (!(stream >> offset.x >> offset.y))
+        {
+            utils::logWarning("malformed stream input: ", line);
+            return true;
+        }
+        pendingInput_.lookOffset += offset;
+    }
+    else if (command == "move")
+    {
+        std::array<int, 6> keys{};
+        for (int& key : keys)
+        {
+            stream >> key;
+        }
+        if (!stream)
+        {
+            utils::logWarning("malformed stream input: ", line);
+            return true;
+        }
+        pendingInput_.forward = keys[0] != 0;
+        pendingInput_.backward = keys[1] != 0;
+        pendingInput_.left = keys[2] != 0;
+        pendingInput_.right = keys[3] != 0;
+        pendingInput_.up = keys[4] != 0;
+        pendingInput_.down = keys[5] != 0;
+    }
+    else
+    {
+        utils::logWarning("unknown stream input: ", line);
+        return true;
+    }
+    if (!pendingInputTime_)
+    {
+        pendingInputTime_ = arrivalTime;
+    }
+    return true;
+}
+
+void StreamServer::submit(PixelReadback::Pixels&& pixels)
+{
+    const std::optional<Clock::time_point> inputTime
+        = readbackInputTimes_.front();
+    readbackInputTimes_.pop_front();
+    if (pixels.data.empty())
+    {
+        utils::logWarning("unable to read back streamed frame");
+        return;
+    }
+    {
+        const std::lock_guard lock(frameMutex_);
+        frames_.push_back(Frame{
+            .inputTime = inputTime,
+            .pixels = std::move(pixels),
+        });
+    }
+    frameQueued_.notify_one();
+}
+
+void StreamServer::writeLoop()
+{
+    std::unique_lock lock(frameMutex_);
+    while (true)
+    {
+        frameQueued_.wait(lock,
+                          [this]() { return stopping_ || !frames_.empty(); });
+        // Frames queued before stopping are still written
+        if (frames_.empty())
+        {
+            return;
+        }
+        Frame frame = std::move(frames_.front());
+        frames_.pop_front();
+        lock.unlock();
+        // Written unbuffered, so that the gateway receives the frame without
+        // waiting for the next one
+        if (!writeFrame(frame.pixels.data))
+        {
+            // Frames handed over later are left in the queue, which drops
+            // further frames once full
+            finished_.store(true, std::memory_order_release);
+            return;
+        }
+        const Clock::time_point writeTime = Clock::now();
+        lock.lock();
+        ++writtenFrameCount_;
+        if (frame.inputTime)
+        {
+            const Clock::duration latency = writeTime - frame.inputTime.value();
+            totalLatency_ += latency;
+            maxLatency_ = std::max(maxLatency_, latency);
+            ++latencySampleCount_;
+        }
+    }
+}
+
+bool StreamServer::writeFrame(std::span<const std::uint8_t> data)
+{
+#ifdef _WIN32
+    return false;
+#else
+    while (!data.empty())
+    {
+        const ssize_t written
+            = write(frameDescriptor_, data.data(), data.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EPIPE)
+            {
+                utils::logWarning("stream gateway closed frame output ",
+                                  options_.frameOutputPath);
+            }
+            else
+            {
+                utils::logWarning("unable to write stream frame output ",
+                                  options_.frameOutputPath);
+            }
+            return false;
+        }
+        data = data.subspan(static_cast<size_t>(written));
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,156 @@
+#ifndef STREAM_SERVER_H_
+#define STREAM_SERVER_H_
+
+#include "pixelreadback.h"
+#include "simulation.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+
+/// Server mode streaming rendered frames to a remote client, and moving the
+/// camera by input received from it, without a visible window.
+///
+/// Frames are drawn into the offscreen scene target without bloom and
+/// tonemapping, read back asynchronously into system memory and written as
+/// raw RGBA frames of the window size, with rows ordered from bottom to top,
+/// into the frame output.
+/// The output is meant to be a named pipe read by a gateway process, which
+/// encodes frames with a hardware video encoder like FFmpeg with NVENC or
+/// VAAPI and sends them to the client over WebRTC or WebSocket. Frames pass
+/// through system memory instead of being shared with the encoder on the GPU,
+/// which would tie the renderer to the interop API of one vendor. Frames are
+/// dropped instead of waiting when readbacks or the gateway fall behind.
+///
+/// Input is read from another named pipe, written by the gateway as lines of
+/// text:
+///
+///     look <x> <y>      mouse look movement in pixels
+///     move <forward> <backward> <left> <right> <up> <down>
+///                       held movement keys, each 0 or 1
+///     quit              end streaming
+///
+/// Streaming ends when the input ends as well, or when the gateway closes the
+/// frame output. Latency from input arriving to the first frame drawn after
+/// it being written out is measured, and reported when streaming ends.
+///
+/// Named pipes are opened as POSIX file descriptors, so streaming is not
+/// supported on Windows.
+///
+/// Non-copyable, non-movable, the threads refer to the instance.
+class StreamServer
+{
+public:
+    struct Options
+    {
+        std::filesystem::path frameOutputPath;
+        std::filesystem::path inputPath;
+    };
+
+    explicit StreamServer(Options options);
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+    StreamServer(StreamServer&&) = delete;
+    StreamServer& operator=(StreamServer&&) = delete;
+    /// Write frames already handed to the writer thread, wake the input
+    /// thread up from waiting for input and join threads.
+    ~StreamServer();
+
+    /// Open frame output and input, waiting for the gateway to open the
+    /// other end of named pipes, and start threads. Broken pipes are
+    /// reported as write errors instead of signals for the whole process.
+    /// Errors are reported.
+    bool start();
+
+    /// Input ended, the client asked to quit or the gateway stopped reading
+    /// frames.
+    [[nodiscard]] bool isFinished() const
+    {
+        return finished_.load(std::memory_order_acquire);
+    }
+
+    /// Held movement keys and look movement received since the previous
+    /// call, for the frame being drawn.
+    Simulation::Input takeInput();
+
+    /// Read back the bound read framebuffer of given size, and hand frames
+    /// read back earlier over to the writer thread. Meant to be called right
+    /// after Renderer::finishOffscreenDraw(), which leaves the scene target
+    /// bound for reading.
+    void captureFrame(int width, int height);
+    /// Wait for frames still being read back, hand them over to the writer
+    /// thread and report latency. Meant to be called before the graphics
+    /// context is destroyed.
+    void finish();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// Frame read back or written, with the arrival time of the earliest
+    /// input first shown by it.
+    struct Frame
+    {
+        std::optional<Clock::time_point> inputTime;
+        PixelReadback::Pixels pixels;
+    };
+
+    void readInputLoop();
+    /// Apply input line to pending input. Returns false when the client
+    /// asked to quit.
+    bool handleInputLine(const std::string& line);
+    void writeLoop();
+    /// Write all of data into the frame output, retrying interrupted and
+    /// partial writes. Returns false when the output is broken.
+    bool writeFrame(std::span<const std::uint8_t> data);
+    void submit(PixelReadback::Pixels&& pixels);
+
+    Options options_;
+    PixelReadback pixelReadback_;
+    /// Input arrival times of frames being read back, in readback order.
+    std::deque<std::optional<Clock::time_point>> readbackInputTimes_;
+    /// Arrival of the earliest input taken for frames not read back yet.
+    std::optional<Clock::time_point> frameInputTime_;
+    size_t frameIndex_;
+    size_t droppedFrameCount_;
+    std::atomic<bool> finished_;
+
+    // Only accessed by the input thread after start()
+    int inputDescriptor_;
+    /// Written on destruction to wake the input thread up from waiting, which
+    /// polls the read end along with the input.
+    std::array<int, 2> stopPipe_;
+
+    /// Guards input received and not taken yet.
+    std::mutex inputMutex_;
+    Simulation::Input pendingInput_;
+    /// Arrival of the earliest input not taken yet.
+    std::optional<Clock::time_point> pendingInputTime_;
+
+    // Only accessed by the writer thread after start()
+    int frameDescriptor_;
+
+    /// Guards frames, latency totals and stopping flag.
+    std::mutex frameMutex_;
+    std::condition_variable frameQueued_;
+    std::deque<Frame> frames_;
+    size_t writtenFrameCount_;
+    size_t latencySampleCount_;
+    Clock::duration totalLatency_;
+    Clock::duration maxLatency_;
+    bool stopping_;
+
+    std::thread inputThread_;
+    std::thread writerThread_;
+};
+
+#endif
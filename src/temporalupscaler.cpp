@@ -0,0 +1,207 @@
+#include "temporalupscaler.h"
+
+#include "videomemory.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture units of the pass. Units of model shaders are bound again every
+/// frame, so they are free to be taken once the scene is drawn.
+constexpr GLuint SCENE_TEXTURE_UNIT = 0;
+constexpr GLuint DEPTH_TEXTURE_UNIT = 1;
+constexpr GLuint HISTORY_TEXTURE_UNIT = 2;
+
+/// Element of the Halton low-discrepancy sequence of given base, in [0, 1).
+float getHalton(std::uint32_t index, std::uint32_t base)
+{
+    float result = 0.0F;
+    float fraction = 1.0F;
+    while (index > 0)
+    {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+    return result;
+}
+}  // namespace
+
+TemporalUpscaler::TemporalUpscaler()
+    : histories_{}
+    , currentHistory_{0}
+    , historyValid_{false}
+    , jitterIndex_{0}
+    , jitter_{0.0F}
+    , colorFormat_{GL_RGBA16F}
+    , width_{0}
+    , height_{0}
+{
+}
+
+TemporalUpscaler::~TemporalUpscaler()
+{
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    for (const History& history : histories_)
+    {
+        glDeleteFramebuffers(1, &history.framebuffer);
+        glDeleteTextures(1, &history.texture);
+    }
+}
+
+PendingShader TemporalUpscaler::submitShader()
+{
+#ifdef __EMSCRIPTEN__
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gles3.vert.glsl"},
+        fs::path{"assets/shaders/temporal_upscale_gles3.frag.glsl"});
+#else
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gl4.vert.glsl"},
+        fs::path{"assets/shaders/temporal_upscale_gl4.frag.glsl"});
+#endif
+}
+
+bool TemporalUpscaler::init(PendingShader&& shader)
+{
+    shader_ = shader.finish();
+    if (!shader_)
+    {
+        return false;
+    }
+    sceneUniform_ = shader_->getUniformHandle<int>("u_scene");
+    depthUniform_ = shader_->getUniformHandle<int>("u_depth");
+    historyUniform_ = shader_->getUniformHandle<int>("u_history");
+    sceneSizeUniform_ = shader_->getUniformHandle<glm::vec2>("u_sceneSize");
+    sceneScaleUniform_
+        = shader_->getUniformHandle<glm::vec2>("u_sceneScale");
+    jitterUniform_ = shader_->getUniformHandle<glm::vec2>("u_jitter");
+    reprojectionUniform_
+        = shader_->getUniformHandle<glm::mat4>("u_reprojection");
+    historyValidUniform_
+        = shader_->getUniformHandle<bool>("u_historyValid");
+    return true;
+}
+
+bool TemporalUpscaler::resize(int width, int height, GLenum colorFormat)
+{
+    if (width == width_ && height == height_ && colorFormat == colorFormat_)
+    {
+        return true;
+    }
+    videomemory::release(videomemory::Category::RenderTarget,
+                         videoMemorySize());
+    width_ = width;
+    height_ = height;
+    colorFormat_ = colorFormat;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          videoMemorySize());
+    historyValid_ = false;
+
+    // Texture storage is mutable, so textures are resized in place.
+    // History is filtered when reprojected between pixels, and keeps the
+    // dynamic range of the scene, as it is tonemapped afterwards.
+    if (!histories_[0].texture)
+    {
+        for (History& history : histories_)
+        {
+            glGenTextures(1, &history.texture);
+            glGenFramebuffers(1, &history.framebuffer);
+        }
+    }
+    bool complete = true;
+    for (const History& history : histories_)
+    {
+        RenderTarget::allocateColorTexture(history.texture,
+                                           colorFormat,
+                                           width,
+                                           height);
+        glBindFramebuffer(GL_FRAMEBUFFER, history.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D,
+                               history.texture,
+                               0);
+        complete = glCheckFramebufferStatus(GL_FRAMEBUFFER)
+                        == GL_FRAMEBUFFER_COMPLETE
+                && complete;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+glm::vec2 TemporalUpscaler::nextJitter()
+{
+    // Halton sequence of bases 2 and 3 covers the pixel evenly with any
+    // number of consecutive frames. First element is skipped, as it is zero
+    // in both dimensions.
+    jitterIndex_ = jitterIndex_ % JITTER_PHASE_COUNT + 1;
+    jitter_ = glm::vec2{getHalton(jitterIndex_, 2) - 0.5F,
+                        getHalton(jitterIndex_, 3) - 0.5F};
+    return jitter_;
+}
+
+TextureRegion TemporalUpscaler::draw(GLuint colorTexture,
+                                     const FrameGraph::Target& depth,
+                                     glm::ivec2 sceneSize,
+                                     const glm::mat4& reprojection,
+                                     GLuint emptyVertexArray,
+                                     GlStateCache& glState)
+{
+    // Depth renderbuffer of the scene can not be sampled, so it is copied
+    // into a depth texture first, like for ambient occlusion
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth.framebuffer);
+    glBlitFramebuffer(0,
+                      0,
+                      sceneSize.x,
+                      sceneSize.y,
+                      0,
+                      0,
+                      sceneSize.x,
+                      sceneSize.y,
+                      GL_DEPTH_BUFFER_BIT,
+                      GL_NEAREST);
+
+    // Every pixel of the history is replaced
+    const History& previous = histories_[currentHistory_];
+    currentHistory_ = 1 - currentHistory_;
+    const History& current = histories_[currentHistory_];
+    glBindFramebuffer(GL_FRAMEBUFFER, current.framebuffer);
+    glViewport(0, 0, width_, height_);
+    glDisable(GL_DEPTH_TEST);
+    glState.setColorWriteEnabled(true);
+    glState.setBlendEnabled(false);
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(SCENE_TEXTURE_UNIT, GL_TEXTURE_2D, colorTexture);
+    glState.bindTexture(DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, depth.texture);
+    glState.bindTexture(HISTORY_TEXTURE_UNIT,
+                        GL_TEXTURE_2D,
+                        previous.texture);
+
+    shader_->use(glState);
+    shader_->setUniform(sceneUniform_, static_cast<int>(SCENE_TEXTURE_UNIT));
+    shader_->setUniform(depthUniform_, static_cast<int>(DEPTH_TEXTURE_UNIT));
+    shader_->setUniform(historyUniform_,
+                        static_cast<int>(HISTORY_TEXTURE_UNIT));
+    shader_->setUniform(sceneSizeUniform_, glm::vec2{sceneSize});
+    shader_->setUniform(sceneScaleUniform_,
+                        glm::vec2{sceneSize}
+                            / glm::vec2{glm::ivec2{width_, height_}});
+    shader_->setUniform(jitterUniform_, jitter_);
+    shader_->setUniform(reprojectionUniform_, reprojection);
+    shader_->setUniform(historyValidUniform_, historyValid_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    historyValid_ = true;
+    return TextureRegion{.texture = current.texture,
+                         .size = glm::ivec2{width_, height_},
+                         .textureSize = glm::ivec2{width_, height_}};
+}
+
+size_t TemporalUpscaler::videoMemorySize() const
+{
+    return static_cast<size_t>(width_) * static_cast<size_t>(height_)
+         * histories_.size() * RenderTarget::colorPixelSize(colorFormat_);
+}
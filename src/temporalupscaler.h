@@ -0,0 +1,133 @@
+#ifndef TEMPORAL_UPSCALER_H_
+#define TEMPORAL_UPSCALER_H_
+
+#include "framegraph.h"
+#include "glstatecache.h"
+#include "rendertarget.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/// Temporal upscaling, reconstructing a window resolution image from scenes
+/// drawn at lower resolution over several frames.
+///
+/// Projection of each frame is offset by a different subpixel jitter, so
+/// that scene pixels sample different points of the window pixels over
+/// time. Samples of the current frame are accumulated into a history at
+/// window resolution, weighed by how close they fall to the center of each
+/// window pixel.
+///
+/// History is reprojected onto the current view with motion vectors derived
+/// from scene depth and the view projection of the current and previous
+/// frames. Models do not move between frames, so camera motion is all that
+/// moves them on screen. Reprojected history is clamped to the color range
+/// of the neighborhood of the current sample, rejecting history of surfaces
+/// that got disoccluded or changed.
+///
+/// The pass is a fullscreen fragment shader, supported in OpenGL ES 3.0 as
+/// well. History is kept between frames, while the depth copy read by the
+/// pass is a transient texture of the frame graph. History is created on
+/// first resize. Non-copyable, non-movable.
+class TemporalUpscaler
+{
+public:
+    TemporalUpscaler();
+    TemporalUpscaler(const TemporalUpscaler&) = delete;
+    TemporalUpscaler& operator=(const TemporalUpscaler&) = delete;
+    TemporalUpscaler(TemporalUpscaler&&) = delete;
+    TemporalUpscaler& operator=(TemporalUpscaler&&) = delete;
+    ~TemporalUpscaler();
+
+    /// Submit shader for compilation without waiting for the driver to
+    /// finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted shader.
+    bool init(PendingShader&& shader);
+
+    /// Recreate history when window framebuffer size or color format of the
+    /// scene changes, discarding it. Returns false when the driver rejects
+    /// one of the framebuffers.
+    bool resize(int width, int height, GLenum colorFormat);
+
+    [[nodiscard]] bool isCreated() const
+    {
+        return histories_[0].texture != 0;
+    }
+    /// History written by the next draw.
+    [[nodiscard]] GLuint nextHistoryTexture() const
+    {
+        return histories_[1 - currentHistory_].texture;
+    }
+
+    /// Discard history, so that the next frame starts accumulating anew.
+    void invalidateHistory() { historyValid_ = false; }
+
+    /// Advance to the subpixel offset of the next frame, in scene pixels
+    /// within half a pixel of the pixel center.
+    glm::vec2 nextJitter();
+
+    /// Accumulate scene of given size drawn with the current jitter into
+    /// history, returning the history at window resolution for tonemapping.
+    /// Color of the scene is read from given texture, and depth from the
+    /// scene framebuffer bound for reading, copied into given depth texture
+    /// first. Reprojection transforms clip space positions of the current
+    /// view into those of the previous one, both without jitter.
+    /// Framebuffer, viewport, depth test and blending are left changed for
+    /// the caller to restore.
+    TextureRegion draw(GLuint colorTexture,
+                       const FrameGraph::Target& depth,
+                       glm::ivec2 sceneSize,
+                       const glm::mat4& reprojection,
+                       GLuint emptyVertexArray,
+                       GlStateCache& glState);
+
+private:
+    /// Accumulated color at window resolution, with its framebuffer.
+    struct History
+    {
+        GLuint texture;
+        GLuint framebuffer;
+    };
+
+    /// Frames jitter cycles through, enough for scenes drawn at half
+    /// resolution along each axis to cover every window pixel a few times.
+    static constexpr size_t JITTER_PHASE_COUNT = 16;
+
+    /// Video memory taken by textures in bytes.
+    [[nodiscard]] size_t videoMemorySize() const;
+
+    std::optional<Shader> shader_;
+    UniformHandle<int> sceneUniform_;
+    UniformHandle<int> depthUniform_;
+    UniformHandle<int> historyUniform_;
+    UniformHandle<glm::vec2> sceneSizeUniform_;
+    UniformHandle<glm::vec2> sceneScaleUniform_;
+    UniformHandle<glm::vec2> jitterUniform_;
+    UniformHandle<glm::mat4> reprojectionUniform_;
+    UniformHandle<bool> historyValidUniform_;
+    /// Ping-ponged between frames, one read as history while the other is
+    /// written.
+    std::array<History, 2> histories_;
+    size_t currentHistory_;
+    bool historyValid_;
+    std::uint32_t jitterIndex_;
+    glm::vec2 jitter_;
+    GLenum colorFormat_;
+    int width_;
+    int height_;
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "texturecache.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'T', 'E', 'X', 'C'};
+// Increment on any change of Header or payload layout.
+constexpr uint32_t FORMAT_VERSION = 2;
+
+struct Header
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t sourceFileSize;
+    int64_t sourceModifiedTime;
+    uint32_t internalFormat;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    /// Compressed size of each level, levels are stored consecutively after
+    /// the header.
+    std::array<uint32_t, texturecache::MAX_LEVEL_COUNT> levelSizes;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+
+/// Identity of source image file revision used for cache invalidation.
+struct SourceStamp
+{
+    uint64_t fileSize;
+    int64_t modifiedTime;
+};
+
+std::optional<SourceStamp> querySourceStamp(const fs::path& sourcePath)
+{
+    std::error_code error;
+    const uintmax_t fileSize = fs::file_size(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+    const fs::file_time_type modifiedTime
+        = fs::last_write_time(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+
+    return SourceStamp{
+        .fileSize = static_cast<uint64_t>(fileSize),
+        .modifiedTime
+        = static_cast<int64_t>(modifiedTime.time_since_epoch().count()),
+    };
+}
+
+fs::path cachePath(const fs::path& sourcePath)
+{
+    fs::path path = sourcePath;
+    path += ".texcache";
+    return path;
+}
+
+/// Cache entry written on another GPU may hold a format this driver does not
+/// accept.
+bool isSupportedFormat(GLenum internalFormat)
+{
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formatCount);
+    if (formatCount <= 0)
+    {
+        return false;
+    }
+    std::vector<GLint> formats(static_cast<size_t>(formatCount));
+    glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+    return std::find(formats.begin(),
+                     formats.end(),
+                     static_cast<GLint>(internalFormat))
+        != formats.end();
+}
+}  // namespace
+
+namespace texturecache
+{
+std::optional<GLenum> compressedRgbFormat()
+{
+    // BC1 halves 8-bit RGB to 4 bits per texel, and is supported by every
+    // desktop GPU, even if the extension is not part of the core profile
+    if (GLAD_GL_EXT_texture_compression_s3tc)
+    {
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    return std::nullopt;
+}
+
+std::optional<GLenum> compressedHdrFormat()
+{
+    // BC6H keeps half float range at 8 bits per texel, and is core since
+    // OpenGL 4.2. Its encoder is costly, so drivers list it among general
+    // purpose formats only when they compress uploads into it.
+    if (isSupportedFormat(GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT))
+    {
+        return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+    }
+    return std::nullopt;
+}
+
+std::optional<CachedImage> map(const fs::path& sourcePath)
+{
+    const std::optional<SourceStamp> stamp = querySourceStamp(sourcePath);
+    if (!stamp)
+    {
+        return std::nullopt;
+    }
+
+    std::optional<MappedFile> file = MappedFile::open(cachePath(sourcePath));
+    if (!file || file->size() < sizeof(Header))
+    {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(Header));
+    if (header.magic != MAGIC || header.version != FORMAT_VERSION
+        || header.sourceFileSize != stamp->fileSize
+        || header.sourceModifiedTime != stamp->modifiedTime
+        || header.levelCount == 0 || header.levelCount > MAX_LEVEL_COUNT
+        || !isSupportedFormat(header.internalFormat))
+    {
+        return std::nullopt;
+    }
+
+    // Reject truncated files before trusting sizes stored in header
+    std::array<std::span<const std::byte>, MAX_LEVEL_COUNT> levels;
+    size_t offset = sizeof(Header);
+    for (size_t level = 0; level < header.levelCount; ++level)
+    {
+        const size_t levelSize = header.levelSizes[level];
+        if (levelSize == 0 || file->size() - offset < levelSize)
+        {
+            return std::nullopt;
+        }
+        levels[level] = std::span{file->data() + offset, levelSize};
+        offset += levelSize;
+    }
+    if (offset != file->size())
+    {
+        return std::nullopt;
+    }
+
+    return CachedImage{
+        .file = std::move(file.value()),
+        .internalFormat = header.internalFormat,
+        .width = static_cast<GLsizei>(header.width),
+        .height = static_cast<GLsizei>(header.height),
+        .levelCount = static_cast<GLsizei>(header.levelCount),
+        .levels = levels,
+    };
+}
+
+bool store(GLenum target, GLsizei levelCount, const fs::path& sourcePath)
+{
+    GLint compressed = GL_FALSE;
+    glGetTexLevelParameteriv(target, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    if (!compressed || levelCount <= 0
+        || static_cast<size_t>(levelCount) > MAX_LEVEL_COUNT)
+    {
+        return false;
+    }
+    const std::optional<SourceStamp> stamp = querySourceStamp(sourcePath);
+    if (!stamp)
+    {
+        return false;
+    }
+    GLint internalFormat = 0;
+    GLint width = 0;
+    GLint height = 0;
+    glGetTexLevelParameteriv(target,
+                             0,
+                             GL_TEXTURE_INTERNAL_FORMAT,
+                             &internalFormat);
+    glGetTexLevelParameteriv(target, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(target, 0, GL_TEXTURE_HEIGHT, &height);
+
+    Header header{
+        .magic = MAGIC,
+        .version = FORMAT_VERSION,
+        .sourceFileSize = stamp->fileSize,
+        .sourceModifiedTime = stamp->modifiedTime,
+        .internalFormat = static_cast<uint32_t>(internalFormat),
+        .width = static_cast<uint32_t>(width),
+        .height = static_cast<uint32_t>(height),
+        .levelCount = static_cast<uint32_t>(levelCount),
+        .levelSizes = {},
+    };
+    std::vector<char> levels;
+    for (GLint level = 0; level < levelCount; ++level)
+    {
+        GLint levelSize = 0;
+        glGetTexLevelParameteriv(target,
+                                 level,
+                                 GL_TEXTURE_COMPRESSED_IMAGE_SIZE,
+                                 &levelSize);
+        if (levelSize <= 0)
+        {
+            return false;
+        }
+        header.levelSizes[level] = static_cast<uint32_t>(levelSize);
+        const size_t offset = levels.size();
+        levels.resize(offset + static_cast<size_t>(levelSize));
+        glGetCompressedTexImage(target, level, levels.data() + offset);
+    }
+
+    // Write into temporary file first and rename afterwards, so that an
+    // interrupted write never leaves a half-written cache entry behind.
+    const fs::path path = cachePath(sourcePath);
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(levels.data(), static_cast<std::streamsize>(levels.size()));
+        if (!file)
+        {
+            utils::logWarning("unable to write texture cache ", temporaryPath);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temporaryPath, path, error);
+    if (error)
+    {
+        utils::logWarning("unable to write texture cache ",
+                          path,
+                          ": ",
+                          error.message());
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+
+    return true;
+}
+}  // namespace texturecache
@@ -0,0 +1,68 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include "mappedfile.h"
+
+#include "glad/gl.h"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+/// Persistent cache of GPU-compressed mip chains to avoid decoding image files,
+/// generating mip levels and compressing them in the driver on every
+/// application launch.
+///
+/// Textures are uploaded uncompressed into compressed storage, leaving block
+/// compression to the driver, and the compressed levels are read back once.
+/// Cache file is placed next to the source image file and contains a
+/// fixed-size header followed by the compressed levels, which are uploaded
+/// from the file mapping as-is. A cache entry is considered stale when the
+/// size or modification time of the source file differs from what is
+/// recorded in the header, or when the driver does not support the stored
+/// compression format.
+///
+/// Reading back compressed images is not available in OpenGL ES 3.0.
+namespace texturecache
+{
+/// Upper bound of mip levels stored for an image, enough for 32768 texels
+/// wide images.
+constexpr size_t MAX_LEVEL_COUNT = 16;
+
+/// Compressed mip chain of a source image, pointing into the cache file
+/// mapping.
+struct CachedImage
+{
+    MappedFile file;
+    GLenum internalFormat;
+    GLsizei width;
+    GLsizei height;
+    GLsizei levelCount;
+    std::array<std::span<const std::byte>, MAX_LEVEL_COUNT> levels;
+};
+
+/// Block compression format for RGB images supported by the driver, or
+/// nothing when images are meant to be stored uncompressed.
+std::optional<GLenum> compressedRgbFormat();
+
+/// Block compression format for high dynamic range RGB images supported by
+/// the driver, or nothing when they are meant to be stored uncompressed.
+std::optional<GLenum> compressedHdrFormat();
+
+/// Map previously compressed mip chain of source image. Returns nothing when
+/// cache entry is missing, stale or corrupted, in which case the caller is
+/// expected to upload the decoded source image and store the result.
+std::optional<CachedImage> map(const std::filesystem::path& sourcePath);
+
+/// Persist compressed mip levels of texture target (e.g. a cube-map face) of
+/// the bound texture for subsequent launches. Nothing is stored when the
+/// texture is uncompressed. Failure to write the cache is not fatal, the
+/// image is decoded again on next launch.
+bool store(GLenum target,
+           GLsizei levelCount,
+           const std::filesystem::path& sourcePath);
+}  // namespace texturecache
+
+#endif
@@ -0,0 +1,168 @@
+#include "threadpool.h"
+
+#include <utility>
+
+namespace
+{
+/// Owning pool and queue index of the worker running on the current thread,
+/// null outside of workers.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentWorkerIndex = 0;
+}  // namespace
+
+ThreadPool::ThreadPool([[maybe_unused]] size_t threadCount)
+    : queuedTaskCount_{0}
+    , nextQueueIndex_{0}
+    , stopping_{false}
+{
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    if (threadCount == 0)
+    {
+        // hardware_concurrency() is allowed to report 0 when unknown
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+    // Queues have to exist before any worker starts stealing from them
+    queues_ = std::make_unique<WorkerQueue[]>(threadCount);
+    workers_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        const std::lock_guard lock(sleepMutex_);
+        stopping_ = true;
+    }
+    taskAvailable_.notify_all();
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::wait(const TaskCounter& counter)
+{
+    while (!counter.isDone())
+    {
+        if (!runPendingTask())
+        {
+            // Remaining tasks of the group are running on other workers
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ThreadPool::submitToMainThread(std::function<void()> task)
+{
+    const std::lock_guard lock(mainThreadMutex_);
+    mainThreadTasks_.emplace_back(std::move(task));
+}
+
+void ThreadPool::runMainThreadTasks()
+{
+    // Tasks are run outside of the lock, so that they can submit further
+    // main thread tasks for the next call
+    std::vector<Task> tasks;
+    {
+        const std::lock_guard lock(mainThreadMutex_);
+        tasks.swap(mainThreadTasks_);
+    }
+    for (Task& task : tasks)
+    {
+        task();
+    }
+}
+
+void ThreadPool::enqueue(Task&& task)
+{
+    const size_t queueIndex
+        = currentPool == this
+              ? currentWorkerIndex
+              : nextQueueIndex_.fetch_add(1, std::memory_order_relaxed)
+                    % workers_.size();
+    {
+        WorkerQueue& queue = queues_[queueIndex];
+        const std::lock_guard lock(queue.mutex);
+        queue.tasks.emplace_back(std::move(task));
+        queuedTaskCount_.fetch_add(1, std::memory_order_release);
+    }
+
+    // Taking the lock orders the wake-up after a worker that checked for tasks
+    // started waiting, so that the notification is not lost
+    {
+        const std::lock_guard lock(sleepMutex_);
+    }
+    taskAvailable_.notify_one();
+}
+
+bool ThreadPool::runPendingTask()
+{
+    if (queuedTaskCount_.load(std::memory_order_acquire) == 0)
+    {
+        return false;
+    }
+
+    // Own queue is taken from the back and others from the front, so that
+    // the owner and thieves rarely want the same task
+    const size_t queueCount = workers_.size();
+    const bool isWorker = currentPool == this;
+    const size_t firstIndex = isWorker ? currentWorkerIndex : 0;
+    for (size_t offset = 0; offset < queueCount; ++offset)
+    {
+        WorkerQueue& queue = queues_[(firstIndex + offset) % queueCount];
+        Task task;
+        {
+            const std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+            if (isWorker && offset == 0)
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            queuedTaskCount_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        task();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t workerIndex)
+{
+    currentPool = this;
+    currentWorkerIndex = workerIndex;
+    while (true)
+    {
+        if (runPendingTask())
+        {
+            continue;
+        }
+
+        std::unique_lock lock(sleepMutex_);
+        taskAvailable_.wait(
+            lock,
+            [this]()
+            {
+                return stopping_
+                       || queuedTaskCount_.load(std::memory_order_acquire) > 0;
+            });
+        // Drain remaining tasks before exiting so no future is left without
+        // result.
+        if (stopping_ && queuedTaskCount_.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+    }
+}
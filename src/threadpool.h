@@ -0,0 +1,199 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Number of tasks of a group that are still running, waited for by
+/// ThreadPool::wait().
+///
+/// Non-copyable, non-movable, tasks in flight refer to the instance.
+class TaskCounter
+{
+public:
+    TaskCounter()
+        : count_{0}
+    {
+    }
+    TaskCounter(const TaskCounter&) = delete;
+    TaskCounter& operator=(const TaskCounter&) = delete;
+    TaskCounter(TaskCounter&&) = delete;
+    TaskCounter& operator=(TaskCounter&&) = delete;
+    ~TaskCounter() = default;
+
+    [[nodiscard]] bool isDone() const
+    {
+        return count_.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class ThreadPool;
+
+    std::atomic<size_t> count_;
+};
+
+/// Fixed-size pool of worker threads executing CPU-bound tasks, shared by
+/// asset loading and frame preparation.
+///
+/// Each worker owns a task queue. Tasks submitted from a worker are pushed to
+/// its own queue and taken back in last-in first-out order while they are
+/// still in cache, tasks submitted from other threads are spread over the
+/// workers. Workers running out of tasks steal the oldest tasks from the
+/// others, which tend to be the largest pieces of work left.
+///
+/// Tasks must not issue graphics API calls, because the OpenGL context is only
+/// current on the main thread. Work needing the context is handed over to the
+/// main thread with submitToMainThread() instead.
+///
+/// When threads are not available (WebAssembly build without pthreads
+/// support), tasks are executed immediately on the submitting thread instead.
+class ThreadPool
+{
+public:
+    /// Start worker threads. Zero thread count means using one worker per
+    /// hardware thread.
+    explicit ThreadPool(size_t threadCount = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    /// Wait for already submitted tasks to finish and join worker threads.
+    /// Tasks handed over to the main thread and not yet run are dropped.
+    ~ThreadPool();
+
+    /// Enqueue task for asynchronous execution. Result or completion can be
+    /// waited for through the returned future.
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task);
+
+    /// Enqueue task for asynchronous execution as part of a group, whose
+    /// completion is waited for through the counter.
+    template <typename F>
+    void submit(TaskCounter& counter, F&& task);
+
+    /// Wait until every task of the group finished. Pending tasks are run on
+    /// the calling thread in the meantime instead of blocking it, so waiting
+    /// from inside a task does not deadlock.
+    void wait(const TaskCounter& counter);
+
+    /// Call body with consecutive index ranges covering [0, count), each at
+    /// most grain size long, spread over the workers. Returns when every range
+    /// is done. The calling thread takes part in the work.
+    template <typename F>
+    void parallelFor(size_t count, size_t grainSize, F&& body);
+
+    /// Enqueue task to be run by the next runMainThreadTasks() call. Can be
+    /// called from any thread.
+    void submitToMainThread(std::function<void()> task);
+
+    /// Run tasks handed over to the main thread, in submission order. Must be
+    /// called on the thread the graphics context is current on.
+    void runMainThreadTasks();
+
+    [[nodiscard]] size_t threadCount() const { return workers_.size(); }
+
+private:
+    using Task = std::function<void()>;
+
+    /// Padded to separate cache lines, so that workers taking tasks from their
+    /// own queue do not contend with each other.
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<WorkerQueue[]> queues_;
+    /// Tasks queued over all workers, for idle workers to know whether there
+    /// is anything to steal.
+    std::atomic<size_t> queuedTaskCount_;
+    /// Round-robin queue selection of tasks submitted from outside the pool.
+    std::atomic<size_t> nextQueueIndex_;
+    std::mutex sleepMutex_;
+    std::condition_variable taskAvailable_;
+    bool stopping_;
+    std::mutex mainThreadMutex_;
+    std::vector<Task> mainThreadTasks_;
+
+    void enqueue(Task&& task);
+    /// Take a task from the own queue of the calling worker, or steal one from
+    /// the other workers. Returns false when every queue is empty.
+    bool runPendingTask();
+    void workerLoop(size_t workerIndex);
+};
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::submit(F&& task)
+{
+    using Result = std::invoke_result_t<F>;
+    // std::function requires copyable callables, so share the move-only
+    // packaged task instead.
+    auto packagedTask
+        = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> result = packagedTask->get_future();
+    if (workers_.empty())
+    {
+        (*packagedTask)();
+        return result;
+    }
+
+    enqueue([packagedTask]() { (*packagedTask)(); });
+    return result;
+}
+
+template <typename F>
+void ThreadPool::submit(TaskCounter& counter, F&& task)
+{
+    if (workers_.empty())
+    {
+        std::forward<F>(task)();
+        return;
+    }
+
+    counter.count_.fetch_add(1, std::memory_order_relaxed);
+    enqueue(
+        [&counter, task = std::forward<F>(task)]() mutable
+        {
+            task();
+            counter.count_.fetch_sub(1, std::memory_order_release);
+        });
+}
+
+template <typename F>
+void ThreadPool::parallelFor(size_t count, size_t grainSize, F&& body)
+{
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (workers_.empty() || count <= grainSize)
+    {
+        if (count > 0)
+        {
+            body(size_t{0}, count);
+        }
+        return;
+    }
+
+    // First range is left for the calling thread, which would only wait
+    // otherwise
+    TaskCounter counter;
+    for (size_t begin = grainSize; begin < count; begin += grainSize)
+    {
+        const size_t end = std::min(begin + grainSize, count);
+        submit(counter, [&body, begin, end]() { body(begin, end); });
+    }
+    body(size_t{0}, grainSize);
+    wait(counter);
+}
+
+#endif
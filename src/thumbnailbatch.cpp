@@ -0,0 +1,292 @@
+#include "thumbnailbatch.h"
+
+#include "pngwriter.h"
+#include "utils.h"
+
+#include "assimp/Importer.hpp"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr int DEFAULT_SIZE = 256;
+constexpr int MAX_SIZE = 4096;
+/// Readbacks in flight before drawing waits for the GPU. A few frames are
+/// enough to hide the latency of the copy without holding back memory.
+constexpr size_t READBACK_BUFFER_COUNT = 4;
+/// Model files imported at once per worker thread, keeping each worker busy
+/// while the main thread draws the models that arrived.
+constexpr size_t IMPORTS_PER_THREAD = 2;
+/// Same view direction as the initial camera of the application.
+constexpr glm::vec2 CAMERA_ROTATION{240.0F, -15.0F};
+/// Unit sphere is fit into the view with a margin around it.
+constexpr float FIT_MARGIN = 1.1F;
+
+bool parseInt(std::string_view text, int& value)
+{
+    const auto [end, error]
+        = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size();
+}
+
+/// Model file formats are the ones the importer recognizes by extension,
+/// which leaves out mesh cache files stored next to models.
+bool isModelFile(const fs::directory_entry& entry,
+                 const Assimp::Importer& importer)
+{
+    std::error_code error;
+    if (!entry.is_regular_file(error))
+    {
+        return false;
+    }
+    const std::string extension = entry.path().extension().string();
+    return !extension.empty() && importer.IsExtensionSupported(extension);
+}
+}  // namespace
+
+std::optional<ThumbnailBatch::Options> ThumbnailBatch::parseArguments(
+    std::span<const char* const> arguments)
+{
+    Options options{
+        .inputDirectory = "assets/meshes",
+        .outputDirectory = "thumbnails",
+        .size = DEFAULT_SIZE,
+    };
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        const std::string_view argument{arguments[i]};
+        if (i + 1 == arguments.size())
+        {
+            utils::showErrorMessage("missing value of thumbnail argument ",
+                                    argument);
+            return std::nullopt;
+        }
+        const std::string_view value{arguments[++i]};
+        if (argument == "--input")
+        {
+            options.inputDirectory = value;
+        }
+        else if (argument == "--output")
+        {
+            options.outputDirectory = value;
+        }
+        else if (argument == "--size")
+        {
+            if (!parseInt(value, options.size) || options.size <= 0
+                || options.size > MAX_SIZE)
+            {
+                utils::showErrorMessage("invalid value of thumbnail argument ",
+                                        argument,
+                                        ": ",
+                                        value);
+                return std::nullopt;
+            }
+        }
+        else
+        {
+            utils::showErrorMessage("unknown thumbnail argument ", argument);
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+Camera ThumbnailBatch::createCamera(float fov)
+{
+    const glm::vec3 direction{
+        std::cos(glm::radians(CAMERA_ROTATION.x))
+            * std::cos(glm::radians(CAMERA_ROTATION.y)),
+        std::sin(glm::radians(CAMERA_ROTATION.y)),
+        std::sin(glm::radians(CAMERA_ROTATION.x))
+            * std::cos(glm::radians(CAMERA_ROTATION.y)),
+    };
+    // Sphere touches the view frustum where the tangent from the camera
+    // meets it at half field of view
+    const float distance = FIT_MARGIN / std::sin(glm::radians(fov) * 0.5F);
+    return Camera{-direction * distance, CAMERA_ROTATION};
+}
+
+glm::mat4 ThumbnailBatch::createWorldMatrix(
+    const BoundingSphere& boundingSphere)
+{
+    const float scale
+        = boundingSphere.radius > 0.0F ? 1.0F / boundingSphere.radius : 1.0F;
+    return glm::translate(glm::scale(glm::mat4{1.0F}, glm::vec3{scale}),
+                          -boundingSphere.center);
+}
+
+ThumbnailBatch::ThumbnailBatch(Options options, ThreadPool& threadPool)
+    : options_{std::move(options)}
+    , threadPool_{threadPool}
+    // Meshes are drawn once, so index optimization and level of detail
+    // generation would cost more import time than they save
+    , modelLoader_(threadPool,
+                   ImportOptions{
+                       .optimizeMesh = false,
+                       .packVertices = true,
+                       .buildClusterLod = false,
+                       .buildLodChain = false,
+                       .buildBvh = false,
+                       .smoothNormals = true,
+                   })
+    , requestedModelCount_{0}
+    , finishedModelCount_{0}
+    , pixelReadback_(READBACK_BUFFER_COUNT)
+    , writtenCount_{0}
+    , failedCount_{0}
+{
+}
+
+ThumbnailBatch::~ThumbnailBatch()
+{
+    threadPool_.wait(encodingTasks_);
+}
+
+bool ThumbnailBatch::start()
+{
+    std::error_code error;
+    fs::directory_iterator directory{options_.inputDirectory, error};
+    if (error)
+    {
+        utils::showErrorMessage("unable to open thumbnail input directory ",
+                                options_.inputDirectory,
+                                ": ",
+                                error.message());
+        return false;
+    }
+    const Assimp::Importer importer;
+    for (const fs::directory_entry& entry : directory)
+    {
+        if (isModelFile(entry, importer))
+        {
+            modelPaths_.push_back(entry.path());
+        }
+    }
+    // Directory order is unspecified, sorting makes runs repeatable
+    std::ranges::sort(modelPaths_);
+
+    fs::create_directories(options_.outputDirectory, error);
+    if (error)
+    {
+        utils::showErrorMessage("unable to create thumbnail output directory ",
+                                options_.outputDirectory,
+                                ": ",
+                                error.message());
+        return false;
+    }
+
+    utils::logInfo("rendering thumbnails of ",
+                   modelPaths_.size(),
+                   " model files from ",
+                   options_.inputDirectory);
+    return true;
+}
+
+std::optional<ModelLoader::Result> ThumbnailBatch::pollModel()
+{
+    const size_t maxImportCount
+        = std::max<size_t>(threadPool_.threadCount(), 1) * IMPORTS_PER_THREAD;
+    while (requestedModelCount_ < modelPaths_.size()
+           && requestedModelCount_ - finishedModelCount_ < maxImportCount)
+    {
+        modelLoader_.request(requestedModelCount_,
+                             modelPaths_[requestedModelCount_]);
+        ++requestedModelCount_;
+    }
+
+    while (std::optional<ModelLoader::Result> result = modelLoader_.poll())
+    {
+        if (result->model)
+        {
+            return result;
+        }
+        utils::showErrorMessage("unable to create model from path ",
+                                result->path);
+        failedCount_.fetch_add(1, std::memory_order_relaxed);
+        ++finishedModelCount_;
+    }
+    return std::nullopt;
+}
+
+void ThumbnailBatch::readBack(size_t modelId)
+{
+    if (pixelReadback_.isFull())
+    {
+        encode(pixelReadback_.takeOldest());
+    }
+    pixelReadback_.readPixels(modelId, options_.size, options_.size);
+    ++finishedModelCount_;
+}
+
+void ThumbnailBatch::collectReadbacks()
+{
+    while (std::optional<PixelReadback::Pixels> pixels
+           = pixelReadback_.takeFinished())
+    {
+        encode(std::move(pixels.value()));
+    }
+}
+
+bool ThumbnailBatch::isFinished() const
+{
+    return finishedModelCount_ == modelPaths_.size()
+        && !pixelReadback_.hasPending() && encodingTasks_.isDone();
+}
+
+bool ThumbnailBatch::reportResults() const
+{
+    const size_t failedCount = failedCount_.load(std::memory_order_relaxed);
+    utils::logInfo("wrote ",
+                   writtenCount_.load(std::memory_order_relaxed),
+                   " thumbnails into ",
+                   options_.outputDirectory,
+                   ", ",
+                   failedCount,
+                   " failed");
+    return failedCount == 0;
+}
+
+void ThumbnailBatch::encode(PixelReadback::Pixels&& pixels)
+{
+    fs::path outputPath
+        = options_.outputDirectory / modelPaths_[pixels.id].filename();
+    outputPath += ".png";
+    if (pixels.data.empty())
+    {
+        utils::showErrorMessage("unable to read back thumbnail ", outputPath);
+        failedCount_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    threadPool_.submit(
+        encodingTasks_,
+        [this,
+         pixels = std::move(pixels),
+         outputPath = std::move(outputPath)]()
+        {
+            if (!pngwriter::writeFramebuffer(
+                    outputPath,
+                    static_cast<std::uint32_t>(pixels.width),
+                    static_cast<std::uint32_t>(pixels.height),
+                    pixels.data))
+            {
+                utils::showErrorMessage("unable to write thumbnail ",
+                                        outputPath);
+                failedCount_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            writtenCount_.fetch_add(1, std::memory_order_relaxed);
+        });
+}
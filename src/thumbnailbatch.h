@@ -0,0 +1,109 @@
+#ifndef THUMBNAIL_BATCH_H_
+#define THUMBNAIL_BATCH_H_
+
+#include "camera.h"
+#include "mesh.h"
+#include "modelloader.h"
+#include "pixelreadback.h"
+#include "threadpool.h"
+
+#include "glm/mat4x4.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Headless batch run drawing a preview image of every model file in a
+/// directory, for building catalogs of large model collections.
+///
+/// Models are imported in parallel on the thread pool, with a bounded number
+/// in flight so that memory use does not grow with the size of the directory.
+/// Each model is drawn as soon as it arrives, scaled to fit the view. Pixels
+/// are read back into pixel pack buffers asynchronously and fenced. Once the
+/// GPU finished writing them, they are copied out and encoded into PNG files
+/// by thread pool tasks, so that drawing never waits for encoding. Drawing
+/// only waits for the GPU when every pixel pack buffer is in flight.
+///
+/// Non-copyable, non-movable, encoding tasks in flight refer to the instance.
+class ThumbnailBatch
+{
+public:
+    struct Options
+    {
+        std::filesystem::path inputDirectory;
+        std::filesystem::path outputDirectory;
+        /// Width and height of thumbnails in pixels.
+        int size;
+    };
+
+    /// Parse options from command line arguments following "--thumbnails".
+    /// Unknown and malformed arguments are reported.
+    static std::optional<Options> parseArguments(
+        std::span<const char* const> arguments);
+
+    /// Camera looking at the origin from a distance, where the unit sphere
+    /// fits into the view of given vertical field of view in degrees.
+    static Camera createCamera(float fov);
+    /// World matrix moving and scaling bounding sphere of a model onto the
+    /// unit sphere at the origin.
+    static glm::mat4 createWorldMatrix(const BoundingSphere& boundingSphere);
+
+    ThumbnailBatch(Options options, ThreadPool& threadPool);
+    ThumbnailBatch(const ThumbnailBatch&) = delete;
+    ThumbnailBatch& operator=(const ThumbnailBatch&) = delete;
+    ThumbnailBatch(ThumbnailBatch&&) = delete;
+    ThumbnailBatch& operator=(ThumbnailBatch&&) = delete;
+    /// Wait for encoding tasks in flight.
+    ~ThumbnailBatch();
+
+    [[nodiscard]] const Options& options() const { return options_; }
+
+    /// Find model files in the input directory, and create the output
+    /// directory. Returns false when the directories can not be accessed.
+    bool start();
+
+    /// Next model that finished loading, requesting more to keep imports in
+    /// flight. Models failing to load are reported and skipped. Must be
+    /// called on the thread the graphics context is current on, after running
+    /// main thread tasks of the thread pool.
+    std::optional<ModelLoader::Result> pollModel();
+
+    /// Read back thumbnail of model with given identifier from the result of
+    /// pollModel(), drawn into the bottom-left corner of the framebuffer bound
+    /// for reading. Waits for the oldest readback when every pixel pack
+    /// buffer is in flight.
+    void readBack(size_t modelId);
+
+    /// Hand over readbacks finished by the GPU to encoding tasks.
+    void collectReadbacks();
+
+    /// Every model was read back or failed to load, and every thumbnail was
+    /// written.
+    [[nodiscard]] bool isFinished() const;
+
+    /// Log thumbnails written and models failed. Returns whether every model
+    /// got a thumbnail.
+    [[nodiscard]] bool reportResults() const;
+
+private:
+    /// Submit encoding of pixels read back into a PNG file.
+    void encode(PixelReadback::Pixels&& pixels);
+
+    Options options_;
+    ThreadPool& threadPool_;
+    ModelLoader modelLoader_;
+    std::vector<std::filesystem::path> modelPaths_;
+    size_t requestedModelCount_;
+    /// Models read back or failed to load.
+    size_t finishedModelCount_;
+    PixelReadback pixelReadback_;
+    TaskCounter encodingTasks_;
+    std::atomic<size_t> writtenCount_;
+    /// Models failed to load or thumbnails failed to be written.
+    std::atomic<size_t> failedCount_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "tonemapper.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture units of scene and bloom while drawing the pass.
+constexpr GLuint SCENE_TEXTURE_UNIT = 0;
+constexpr GLuint BLOOM_TEXTURE_UNIT = 1;
+}  // namespace
+
+std::vector<PendingShader> Tonemapper::submitShaders()
+{
+#ifdef __EMSCRIPTEN__
+    const fs::path vertexShaderPath{
+        "assets/shaders/fullscreen_gles3.vert.glsl"};
+    const fs::path fragmentShaderPath{"assets/shaders/tonemap_gles3.frag.glsl"};
+#else
+    const fs::path vertexShaderPath{"assets/shaders/fullscreen_gl4.vert.glsl"};
+    const fs::path fragmentShaderPath{"assets/shaders/tonemap_gl4.frag.glsl"};
+#endif
+    std::vector<PendingShader> shaders;
+    shaders.reserve(VARIANT_COUNT);
+    for (size_t variant = 0; variant < VARIANT_COUNT; ++variant)
+    {
+        std::array<const char*, 2> defines{};
+        size_t defineCount = 0;
+        if (variant & 1U)
+        {
+            defines[defineCount++] = "BLOOM_ENABLED";
+        }
+        if (variant & 2U)
+        {
+            defines[defineCount++] = "FXAA_ENABLED";
+        }
+        if (variant == HEATMAP_VARIANT)
+        {
+            defines[defineCount++] = "HEATMAP_ENABLED";
+        }
+        shaders.emplace_back(
+            Shader::submitFromFile(vertexShaderPath,
+                                   fragmentShaderPath,
+                                   std::span{defines}.first(defineCount)));
+    }
+    return shaders;
+}
+
+bool Tonemapper::init(std::vector<PendingShader>&& shaders)
+{
+    for (size_t i = 0; i < VARIANT_COUNT; ++i)
+    {
+        Variant& variant = variants_[i];
+        variant.shader = shaders[i].finish();
+        if (!variant.shader)
+        {
+            return false;
+        }
+        const Shader& shader = variant.shader.value();
+        variant.sceneUniform = shader.getUniformHandle<int>("u_scene");
+        variant.texCoordScaleUniform
+            = shader.getUniformHandle<glm::vec2>("u_texCoordScale");
+        variant.maxTexCoordUniform
+            = shader.getUniformHandle<glm::vec2>("u_maxTexCoord");
+        variant.exposureUniform
+            = shader.getUniformHandle<float>("u_exposure");
+        // Uniforms of compiled out effects are missing from the variant
+        if (i & 2U)
+        {
+            variant.texelSizeUniform
+                = shader.getUniformHandle<glm::vec2>("u_texelSize");
+        }
+        if (i & 1U)
+        {
+            variant.bloomUniform = shader.getUniformHandle<int>("u_bloom");
+            variant.bloomTexCoordScaleUniform
+                = shader.getUniformHandle<glm::vec2>("u_bloomTexCoordScale");
+            variant.bloomMaxTexCoordUniform
+                = shader.getUniformHandle<glm::vec2>("u_bloomMaxTexCoord");
+            variant.bloomIntensityUniform
+                = shader.getUniformHandle<float>("u_bloomIntensity");
+        }
+    }
+    return true;
+}
+
+void Tonemapper::draw(const TextureRegion& scene,
+                      const std::optional<TextureRegion>& bloom,
+                      const Settings& settings,
+                      glm::ivec2 destinationSize,
+                      GLuint emptyVertexArray,
+                      GlStateCache& glState)
+{
+    // Every pixel of the window is replaced, regardless of the depth left
+    // in the default framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, destinationSize.x, destinationSize.y);
+    glDisable(GL_DEPTH_TEST);
+    glState.setColorWriteEnabled(true);
+    glState.setBlendEnabled(false);
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(SCENE_TEXTURE_UNIT, GL_TEXTURE_2D, scene.texture);
+
+    const size_t variantIndex
+        = settings.heatmapEnabled
+            ? HEATMAP_VARIANT
+            : (bloom ? 1U : 0U) | (settings.fxaaEnabled ? 2U : 0U);
+    Variant& variant = variants_[variantIndex];
+    Shader& shader = variant.shader.value();
+    // Fragment coordinates of the window map onto the scene rectangle, and
+    // samples are kept half a texel inside of it, so that filtering never
+    // reads pixels left over from larger scene sizes
+    const glm::vec2 sceneSize{scene.size};
+    const glm::vec2 texelSize = 1.0F / glm::vec2{scene.textureSize};
+    shader.use(glState);
+    shader.setUniform(variant.sceneUniform,
+                      static_cast<int>(SCENE_TEXTURE_UNIT));
+    shader.setUniform(variant.texCoordScaleUniform,
+                      sceneSize * texelSize / glm::vec2{destinationSize});
+    shader.setUniform(variant.texelSizeUniform, texelSize);
+    shader.setUniform(variant.maxTexCoordUniform,
+                      (sceneSize - 0.5F) * texelSize);
+    shader.setUniform(variant.exposureUniform, settings.exposure);
+    if (bloom)
+    {
+        // Bloom covers the scene rectangle at its own size
+        glState.bindTexture(BLOOM_TEXTURE_UNIT, GL_TEXTURE_2D, bloom->texture);
+        const glm::vec2 bloomTexelSize = 1.0F / glm::vec2{bloom->textureSize};
+        shader.setUniform(variant.bloomUniform,
+                          static_cast<int>(BLOOM_TEXTURE_UNIT));
+        shader.setUniform(variant.bloomTexCoordScaleUniform,
+                          glm::vec2{scene.textureSize} / sceneSize
+                              * glm::vec2{bloom->size} * bloomTexelSize);
+        shader.setUniform(variant.bloomMaxTexCoordUniform,
+                          (glm::vec2{bloom->size} - 0.5F) * bloomTexelSize);
+        shader.setUniform(variant.bloomIntensityUniform,
+                          settings.bloomIntensity);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
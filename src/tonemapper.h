@@ -0,0 +1,90 @@
+#ifndef TONEMAPPER_H_
+#define TONEMAPPER_H_
+
+#include "glstatecache.h"
+#include "rendertarget.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include "glm/vec2.hpp"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+/// Final pass of the frame, turning the high dynamic range scene into
+/// displayable color while upscaling it into the window.
+///
+/// Bloom is mixed into the scene, which is scaled by exposure and tonemapped
+/// with a fitted ACES filmic curve. Optionally, fast approximate
+/// antialiasing is applied along the way: edges are detected from luma
+/// contrast of tonemapped neighboring pixels, and pixels on them are blended
+/// with samples taken along the edge.
+///
+/// Everything happens in a single fullscreen pass writing the window once,
+/// instead of a pass per effect reading and writing the whole image. Bloom
+/// and antialiasing are compiled in or out of shader variants. A variant of
+/// its own shows layers counted by the overdraw view as a heatmap instead.
+class Tonemapper
+{
+public:
+    /// Settings of the pass in a frame.
+    struct Settings
+    {
+        /// Multiplier of scene color before tonemapping.
+        float exposure;
+        /// Fraction of light replaced by its bloom.
+        float bloomIntensity;
+        bool fxaaEnabled;
+        /// Show scene as overdraw heatmap, ignoring bloom and FXAA.
+        bool heatmapEnabled;
+    };
+
+    /// Submit shader variants for compilation without waiting for the
+    /// driver to finish.
+    static std::vector<PendingShader> submitShaders();
+
+    /// Finish compilation of submitted shader variants.
+    bool init(std::vector<PendingShader>&& shaders);
+
+    /// Draw scene into the whole default framebuffer of given size, along
+    /// with bloom of the scene unless missing. Viewport, depth test and
+    /// blending are left changed for the caller to restore.
+    void draw(const TextureRegion& scene,
+              const std::optional<TextureRegion>& bloom,
+              const Settings& settings,
+              glm::ivec2 destinationSize,
+              GLuint emptyVertexArray,
+              GlStateCache& glState);
+
+private:
+    /// Variants with and without bloom, and with and without FXAA, followed
+    /// by the heatmap variant.
+    static constexpr size_t VARIANT_COUNT = 5;
+    static constexpr size_t HEATMAP_VARIANT = 4;
+
+    /// Shader variant with its uniforms.
+    struct Variant
+    {
+        std::optional<Shader> shader;
+        UniformHandle<int> sceneUniform;
+        UniformHandle<glm::vec2> texCoordScaleUniform;
+        UniformHandle<glm::vec2> texelSizeUniform;
+        UniformHandle<glm::vec2> maxTexCoordUniform;
+        UniformHandle<float> exposureUniform;
+        UniformHandle<int> bloomUniform;
+        UniformHandle<glm::vec2> bloomTexCoordScaleUniform;
+        UniformHandle<glm::vec2> bloomMaxTexCoordUniform;
+        UniformHandle<float> bloomIntensityUniform;
+    };
+
+    std::array<Variant, VARIANT_COUNT> variants_;
+};
+
+#endif
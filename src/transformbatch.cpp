@@ -0,0 +1,121 @@
+#include "transformbatch.h"
+
+#include "glm/glm.hpp"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+namespace
+{
+/// Relative tolerance of detecting orthogonal columns of equal length, loose
+/// enough to accept rotations accumulated in single precision.
+constexpr float UNIFORM_SCALE_TOLERANCE = 1e-4F;
+
+/// Product of left and right matrix. Each column of the product is the linear
+/// combination of the columns of left matrix, weighted by the components of
+/// the same column of right matrix.
+void multiply(const float* left, const float* right, float* outProduct)
+{
+#if defined(__wasm_simd128__)
+    const v128_t left0 = wasm_v128_load(left);
+    const v128_t left1 = wasm_v128_load(left + 4);
+    const v128_t left2 = wasm_v128_load(left + 8);
+    const v128_t left3 = wasm_v128_load(left + 12);
+    for (size_t column = 0; column < 4; ++column)
+    {
+        const float* weights = right + column * 4;
+        v128_t sum = wasm_f32x4_mul(left0, wasm_f32x4_splat(weights[0]));
+        sum = wasm_f32x4_add(
+            sum, wasm_f32x4_mul(left1, wasm_f32x4_splat(weights[1])));
+        sum = wasm_f32x4_add(
+            sum, wasm_f32x4_mul(left2, wasm_f32x4_splat(weights[2])));
+        sum = wasm_f32x4_add(
+            sum, wasm_f32x4_mul(left3, wasm_f32x4_splat(weights[3])));
+        wasm_v128_store(outProduct + column * 4, sum);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    // glm matrices are not guaranteed to be 16 byte aligned without
+    // GLM_FORCE_DEFAULT_ALIGNED_GENTYPES, so unaligned loads are used
+    const __m128 left0 = _mm_loadu_ps(left);
+    const __m128 left1 = _mm_loadu_ps(left + 4);
+    const __m128 left2 = _mm_loadu_ps(left + 8);
+    const __m128 left3 = _mm_loadu_ps(left + 12);
+    for (size_t column = 0; column < 4; ++column)
+    {
+        const float* weights = right + column * 4;
+        __m128 sum = _mm_mul_ps(left0, _mm_set1_ps(weights[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(left1, _mm_set1_ps(weights[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(left2, _mm_set1_ps(weights[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(left3, _mm_set1_ps(weights[3])));
+        _mm_storeu_ps(outProduct + column * 4, sum);
+    }
+#else
+    for (size_t column = 0; column < 4; ++column)
+    {
+        for (size_t row = 0; row < 4; ++row)
+        {
+            float sum = 0.0F;
+            for (size_t k = 0; k < 4; ++k)
+            {
+                sum += left[k * 4 + row] * right[column * 4 + k];
+            }
+            outProduct[column * 4 + row] = sum;
+        }
+    }
+#endif
+}
+}  // namespace
+
+namespace transformbatch
+{
+void computeMvpMatrices(const glm::mat4& viewProjection,
+                        std::span<const glm::mat4> modelMatrices,
+                        std::span<glm::mat4> outMvps)
+{
+    assert(outMvps.size() == modelMatrices.size());
+    const float* left = &viewProjection[0][0];
+    for (size_t i = 0; i < modelMatrices.size(); ++i)
+    {
+        multiply(left, &modelMatrices[i][0][0], &outMvps[i][0][0]);
+    }
+}
+
+void computeNormalMatrices(std::span<const glm::mat4> worldMatrices,
+                           std::span<glm::mat3> outNormalMatrices)
+{
+    assert(outNormalMatrices.size() == worldMatrices.size());
+    for (size_t i = 0; i < worldMatrices.size(); ++i)
+    {
+        // Translation does not affect normals, and inverse of rotation and
+        // scale part of an affine matrix is the rotation and scale part of its
+        // inverse
+        const glm::mat3 linear{worldMatrices[i]};
+        const float lengthSquared = glm::dot(linear[0], linear[0]);
+        const float tolerance = UNIFORM_SCALE_TOLERANCE * lengthSquared;
+        const bool uniformScale
+            = std::abs(glm::dot(linear[1], linear[1]) - lengthSquared)
+                  <= tolerance
+           && std::abs(glm::dot(linear[2], linear[2]) - lengthSquared)
+                  <= tolerance
+           && std::abs(glm::dot(linear[0], linear[1])) <= tolerance
+           && std::abs(glm::dot(linear[0], linear[2])) <= tolerance
+           && std::abs(glm::dot(linear[1], linear[2])) <= tolerance;
+        if (uniformScale && lengthSquared > 0.0F)
+        {
+            // (sR)^-T = s^-1 * R = sR / s^2 for rotation R
+            outNormalMatrices[i] = linear * (1.0F / lengthSquared);
+        }
+        else
+        {
+            outNormalMatrices[i] = glm::transpose(glm::inverse(linear));
+        }
+    }
+}
+}  // namespace transformbatch
@@ -0,0 +1,34 @@
+#ifndef TRANSFORM_BATCH_H_
+#define TRANSFORM_BATCH_H_
+
+#include "glm/mat3x3.hpp"
+#include "glm/mat4x4.hpp"
+
+#include <span>
+
+/// Per-object matrix math of draw submission done over arrays of objects at
+/// once.
+///
+/// Matrix products are computed four floats at a time with SSE on x86-64 and
+/// with 128-bit SIMD on WebAssembly, matching the column layout of glm
+/// matrices. Other targets fall back to glm.
+namespace transformbatch
+{
+/// Model-view-projection matrix of each model matrix. Output is expected to
+/// be as long as input.
+void computeMvpMatrices(const glm::mat4& viewProjection,
+                        std::span<const glm::mat4> modelMatrices,
+                        std::span<glm::mat4> outMvps);
+
+/// Matrix transforming normals of each world matrix, which is the transposed
+/// inverse of its rotation and scale part. Output is expected to be as long as
+/// input.
+///
+/// Rotation combined with uniform scale is detected and handled without
+/// inverting, since the transposed inverse of such a matrix is the matrix
+/// itself divided by the square of the scale.
+void computeNormalMatrices(std::span<const glm::mat4> worldMatrices,
+                           std::span<glm::mat3> outNormalMatrices);
+}  // namespace transformbatch
+
+#endif
@@ -0,0 +1,162 @@
+#include "transparencytarget.h"
+
+#include <array>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture units of accumulated color and weights while compositing.
+constexpr GLuint ACCUMULATION_TEXTURE_UNIT = 0;
+constexpr GLuint WEIGHT_TEXTURE_UNIT = 1;
+/// Weights are written by model shaders to location 2, leaving location 1 to
+/// object identifiers, which are not drawn by the transparency pass.
+constexpr std::array<GLenum, 3> DRAW_BUFFERS{GL_COLOR_ATTACHMENT0,
+                                             GL_NONE,
+                                             GL_COLOR_ATTACHMENT2};
+/// Nothing accumulated and the whole background revealed.
+constexpr std::array<GLfloat, 4> CLEAR_ACCUMULATION{0.0F, 0.0F, 0.0F, 1.0F};
+constexpr std::array<GLfloat, 4> CLEAR_WEIGHT{0.0F, 0.0F, 0.0F, 0.0F};
+}  // namespace
+
+TransparencyTarget::TransparencyTarget()
+    : accumulationTexture_{0}
+    , weightTexture_{0}
+    , textureGeneration_{0}
+    , framebuffer_{0}
+    , compositeFramebuffer_{0}
+    , sceneColorTexture_{0}
+    , sceneDepthRenderbuffer_{0}
+{
+}
+
+TransparencyTarget::~TransparencyTarget()
+{
+    glDeleteFramebuffers(1, &compositeFramebuffer_);
+    glDeleteFramebuffers(1, &framebuffer_);
+}
+
+PendingShader TransparencyTarget::submitShader()
+{
+#ifdef __EMSCRIPTEN__
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gles3.vert.glsl"},
+        fs::path{"assets/shaders/transparency_composite_gles3.frag.glsl"});
+#else
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gl4.vert.glsl"},
+        fs::path{"assets/shaders/transparency_composite_gl4.frag.glsl"});
+#endif
+}
+
+bool TransparencyTarget::init(PendingShader&& shader)
+{
+    shader_ = shader.finish();
+    if (!shader_)
+    {
+        return false;
+    }
+    accumulationUniform_ = shader_->getUniformHandle<int>("u_accumulation");
+    weightUniform_ = shader_->getUniformHandle<int>("u_weight");
+    return true;
+}
+
+bool TransparencyTarget::attach(GLuint accumulationTexture,
+                                GLuint weightTexture,
+                                std::uint32_t textureGeneration,
+                                GLuint sceneColorTexture,
+                                GLuint sceneDepthRenderbuffer)
+{
+    if (accumulationTexture == accumulationTexture_
+        && weightTexture == weightTexture_
+        && textureGeneration == textureGeneration_
+        && sceneColorTexture == sceneColorTexture_
+        && sceneDepthRenderbuffer == sceneDepthRenderbuffer_)
+    {
+        return true;
+    }
+    accumulationTexture_ = accumulationTexture;
+    weightTexture_ = weightTexture;
+    textureGeneration_ = textureGeneration;
+    sceneColorTexture_ = sceneColorTexture;
+    sceneDepthRenderbuffer_ = sceneDepthRenderbuffer;
+
+    if (!framebuffer_)
+    {
+        glGenFramebuffers(1, &framebuffer_);
+        glGenFramebuffers(1, &compositeFramebuffer_);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           accumulationTexture,
+                           0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT2,
+                           GL_TEXTURE_2D,
+                           weightTexture,
+                           0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER,
+                              sceneDepthRenderbuffer);
+    glDrawBuffers(static_cast<GLsizei>(DRAW_BUFFERS.size()),
+                  DRAW_BUFFERS.data());
+    bool complete
+        = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, compositeFramebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           sceneColorTexture,
+                           0);
+    complete = glCheckFramebufferStatus(GL_FRAMEBUFFER)
+                == GL_FRAMEBUFFER_COMPLETE
+            && complete;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void TransparencyTarget::begin(GlStateCache& glState)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    // Clearing is subject to write masks
+    glState.setColorWriteEnabled(true);
+    glClearBufferfv(GL_COLOR, 0, CLEAR_ACCUMULATION.data());
+    glClearBufferfv(GL_COLOR, 2, CLEAR_WEIGHT.data());
+    // Color and weights add up, while alpha is multiplied by the
+    // transparency of each surface. Weight attachment has no alpha.
+    glState.setBlendEnabled(true);
+    glState.setBlendFuncSeparate(GL_ONE,
+                                 GL_ONE,
+                                 GL_ZERO,
+                                 GL_ONE_MINUS_SRC_ALPHA);
+    // Surfaces behind opaque ones are rejected, while those behind other
+    // transparent ones still add up
+    glState.setDepthFunc(GL_LESS);
+    glState.setDepthWriteEnabled(false);
+}
+
+void TransparencyTarget::composite(GLuint emptyVertexArray,
+                                   GlStateCache& glState)
+{
+    // Composite framebuffer has no depth attachment, so depth test passes
+    // everywhere
+    glBindFramebuffer(GL_FRAMEBUFFER, compositeFramebuffer_);
+    glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(ACCUMULATION_TEXTURE_UNIT,
+                        GL_TEXTURE_2D,
+                        accumulationTexture_);
+    glState.bindTexture(WEIGHT_TEXTURE_UNIT, GL_TEXTURE_2D, weightTexture_);
+    shader_->use(glState);
+    shader_->setUniform(accumulationUniform_,
+                        static_cast<int>(ACCUMULATION_TEXTURE_UNIT));
+    shader_->setUniform(weightUniform_,
+                        static_cast<int>(WEIGHT_TEXTURE_UNIT));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glState.setBlendEnabled(false);
+}
@@ -0,0 +1,93 @@
+#ifndef TRANSPARENCY_TARGET_H_
+#define TRANSPARENCY_TARGET_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <cstdint>
+#include <optional>
+
+/// Framebuffer transparent surfaces are accumulated into by weighted blended
+/// order-independent transparency, blended over the scene afterwards.
+///
+/// Each fragment adds its color, weighted by opacity and depth, to a sum, and
+/// multiplies the fraction of the background still revealed by its
+/// transparency. Both operations are commutative, so transparent surfaces
+/// need no sorting by depth, at the cost of approximating the order of
+/// overlapping surfaces. Color sum and revealed fraction share a half float
+/// attachment, while weights are summed into a second one, so that a single
+/// blend function covers both and no per-attachment blending is needed.
+///
+/// Surfaces are depth tested against the single-sampled depth of the scene
+/// without writing it. Accumulation and weights only live while transparent
+/// surfaces are drawn, and are transient textures of the frame graph
+/// attached each frame. Like the scene framebuffer, they are allocated at
+/// full window size and the scene is drawn into a rectangle at their
+/// bottom-left corner.
+///
+/// Framebuffers are created on first attachment. Non-copyable, non-movable.
+class TransparencyTarget
+{
+public:
+    /// Formats of accumulated color with revealed fraction, and of weights.
+    /// Both are fetched exactly by composition.
+    static constexpr GLenum ACCUMULATION_FORMAT = GL_RGBA16F;
+    static constexpr GLenum WEIGHT_FORMAT = GL_R16F;
+
+    TransparencyTarget();
+    TransparencyTarget(const TransparencyTarget&) = delete;
+    TransparencyTarget& operator=(const TransparencyTarget&) = delete;
+    TransparencyTarget(TransparencyTarget&&) = delete;
+    TransparencyTarget& operator=(TransparencyTarget&&) = delete;
+    ~TransparencyTarget();
+
+    /// Submit composition shader for compilation without waiting for the
+    /// driver to finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted shader.
+    bool init(PendingShader&& shader);
+
+    /// Attach given accumulation and weight textures, along with scene depth
+    /// to test against and scene color to blend into. Attachments are only
+    /// changed when they or the generation of texture names differ from
+    /// those of the previous frame, as names of deleted textures are reused.
+    /// Returns false when the driver rejects one of the framebuffers.
+    bool attach(GLuint accumulationTexture,
+                GLuint weightTexture,
+                std::uint32_t textureGeneration,
+                GLuint sceneColorTexture,
+                GLuint sceneDepthRenderbuffer);
+
+    /// Bind and clear accumulation framebuffer, and set state of
+    /// accumulating transparent surfaces. Depth is tested without being
+    /// written.
+    void begin(GlStateCache& glState);
+
+    /// Blend accumulated surfaces over the scene color, leaving the scene
+    /// color framebuffer bound and blending disabled. Viewport is expected to
+    /// cover the scene.
+    void composite(GLuint emptyVertexArray, GlStateCache& glState);
+
+private:
+    std::optional<Shader> shader_;
+    UniformHandle<int> accumulationUniform_;
+    UniformHandle<int> weightUniform_;
+    GLuint accumulationTexture_;
+    GLuint weightTexture_;
+    std::uint32_t textureGeneration_;
+    GLuint framebuffer_;
+    /// Scene color as the only attachment, so that composition leaves
+    /// object identifiers of the scene untouched.
+    GLuint compositeFramebuffer_;
+    GLuint sceneColorTexture_;
+    GLuint sceneDepthRenderbuffer_;
+};
+
+#endif
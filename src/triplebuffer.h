@@ -0,0 +1,77 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+
+/// Lock-free handoff of the latest value from a single producer thread to a
+/// single consumer thread.
+///
+/// Producer fills its own slot and publishes it by swapping it with the slot
+/// holding the latest value. Consumer swaps that slot with its own when a
+/// newer value was published. Neither side ever waits for the other, and the
+/// consumer always sees the newest value. Values published while the consumer
+/// did not read are dropped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    explicit TripleBuffer(const T& initialValue);
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+    TripleBuffer(TripleBuffer&&) = delete;
+    TripleBuffer& operator=(TripleBuffer&&) = delete;
+    ~TripleBuffer() = default;
+
+    /// Slot owned by the producer, to be filled before publish().
+    T& writeBuffer() { return buffers_[writeIndex_]; }
+    /// Make value of write buffer the latest one. Write buffer is replaced by
+    /// another slot with unspecified contents.
+    void publish();
+    /// Latest published value, owned by the consumer until the next read.
+    const T& read();
+
+private:
+    /// Set in latest slot index while its value has not been read yet.
+    static constexpr unsigned FRESH_BIT = 4;
+    static constexpr unsigned INDEX_MASK = 3;
+
+    std::array<T, 3> buffers_;
+    std::atomic<unsigned> latest_;
+    /// Only accessed by the producer.
+    unsigned writeIndex_;
+    /// Only accessed by the consumer.
+    unsigned readIndex_;
+};
+
+template <typename T>
+TripleBuffer<T>::TripleBuffer(const T& initialValue)
+    : buffers_{initialValue, initialValue, initialValue}
+    , latest_{1}
+    , writeIndex_{0}
+    , readIndex_{2}
+{
+}
+
+template <typename T>
+void TripleBuffer<T>::publish()
+{
+    // Release makes the written value visible to the consumer acquiring it
+    const unsigned previous
+        = latest_.exchange(writeIndex_ | FRESH_BIT, std::memory_order_acq_rel);
+    writeIndex_ = previous & INDEX_MASK;
+}
+
+template <typename T>
+const T& TripleBuffer<T>::read()
+{
+    if (latest_.load(std::memory_order_relaxed) & FRESH_BIT)
+    {
+        const unsigned previous
+            = latest_.exchange(readIndex_, std::memory_order_acq_rel);
+        readIndex_ = previous & INDEX_MASK;
+    }
+    return buffers_[readIndex_];
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include "uioverlay.h"
+
+#include "rendertarget.h"
+#include "videomemory.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture unit of the overlay while compositing.
+constexpr GLuint OVERLAY_TEXTURE_UNIT = 0;
+/// UI has no dynamic range beyond what the window displays.
+constexpr GLenum OVERLAY_COLOR_FORMAT = GL_RGBA8;
+}  // namespace
+
+UiOverlay::UiOverlay()
+    : texture_{0}
+    , framebuffer_{0}
+    , width_{0}
+    , height_{0}
+{
+}
+
+UiOverlay::~UiOverlay()
+{
+    videomemory::release(
+        videomemory::Category::RenderTarget,
+        static_cast<size_t>(width_) * static_cast<size_t>(height_)
+            * RenderTarget::colorPixelSize(OVERLAY_COLOR_FORMAT));
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &texture_);
+}
+
+PendingShader UiOverlay::submitShader()
+{
+#ifdef __EMSCRIPTEN__
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gles3.vert.glsl"},
+        fs::path{"assets/shaders/ui_overlay_gles3.frag.glsl"});
+#else
+    return Shader::submitFromFile(
+        fs::path{"assets/shaders/fullscreen_gl4.vert.glsl"},
+        fs::path{"assets/shaders/ui_overlay_gl4.frag.glsl"});
+#endif
+}
+
+bool UiOverlay::init(PendingShader&& shader)
+{
+    shader_ = shader.finish();
+    if (!shader_)
+    {
+        return false;
+    }
+    overlayUniform_ = shader_->getUniformHandle<int>("u_overlay");
+    return true;
+}
+
+bool UiOverlay::resize(int width, int height)
+{
+    if (width == width_ && height == height_)
+    {
+        return true;
+    }
+    const size_t pixelSize
+        = RenderTarget::colorPixelSize(OVERLAY_COLOR_FORMAT);
+    videomemory::release(videomemory::Category::RenderTarget,
+                         static_cast<size_t>(width_)
+                             * static_cast<size_t>(height_) * pixelSize);
+    width_ = width;
+    height_ = height;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          static_cast<size_t>(width_)
+                              * static_cast<size_t>(height_) * pixelSize);
+
+    if (!texture_)
+    {
+        glGenTextures(1, &texture_);
+        glGenFramebuffers(1, &framebuffer_);
+    }
+    RenderTarget::allocateColorTexture(texture_,
+                                       OVERLAY_COLOR_FORMAT,
+                                       width,
+                                       height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           texture_,
+                           0);
+    const bool complete
+        = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void UiOverlay::beginCapture() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glClearColor(0.0F, 0.0F, 0.0F, 0.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void UiOverlay::draw(GLuint emptyVertexArray, GlStateCache& glState)
+{
+    glViewport(0, 0, width_, height_);
+    glDisable(GL_DEPTH_TEST);
+    glState.setColorWriteEnabled(true);
+    // UI blends its color over the transparent overlay, leaving it
+    // premultiplied by alpha
+    glState.setBlendEnabled(true);
+    glState.setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(OVERLAY_TEXTURE_UNIT, GL_TEXTURE_2D, texture_);
+    shader_->use(glState);
+    shader_->setUniform(overlayUniform_,
+                        static_cast<int>(OVERLAY_TEXTURE_UNIT));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Scene is drawn without blending
+    glState.setBlendEnabled(false);
+}
@@ -0,0 +1,63 @@
+#ifndef UI_OVERLAY_H_
+#define UI_OVERLAY_H_
+
+#include "glstatecache.h"
+#include "shader.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+
+#include <cstddef>
+#include <optional>
+
+/// UI drawn into a texture the size of the window, composited over the
+/// scene in frames where the UI itself did not change.
+///
+/// Building and drawing the widgets of the UI costs more than the scene in
+/// simple views, especially in WebGL, where every call of the UI backend
+/// crosses into JavaScript. Drawing a cached overlay takes a single
+/// fullscreen pass instead.
+///
+/// Texture is created on first resize. Non-copyable, non-movable.
+class UiOverlay
+{
+public:
+    UiOverlay();
+    UiOverlay(const UiOverlay&) = delete;
+    UiOverlay& operator=(const UiOverlay&) = delete;
+    UiOverlay(UiOverlay&&) = delete;
+    UiOverlay& operator=(UiOverlay&&) = delete;
+    ~UiOverlay();
+
+    /// Submit shader for compilation without waiting for the driver to
+    /// finish.
+    static PendingShader submitShader();
+
+    /// Finish compilation of submitted shader.
+    bool init(PendingShader&& shader);
+
+    /// Recreate texture when window framebuffer size changes. Returns false
+    /// when the driver rejects the framebuffer.
+    bool resize(int width, int height);
+
+    /// Bind framebuffer of the overlay and clear it to transparent, for UI
+    /// to be drawn into it instead of the window.
+    void beginCapture() const;
+
+    /// Blend overlay over the bound framebuffer of window size. Viewport and
+    /// depth test are left changed for the caller to restore.
+    void draw(GLuint emptyVertexArray, GlStateCache& glState);
+
+private:
+    std::optional<Shader> shader_;
+    UniformHandle<int> overlayUniform_;
+    GLuint texture_;
+    GLuint framebuffer_;
+    int width_;
+    int height_;
+};
+
+#endif
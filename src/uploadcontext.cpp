@@ -0,0 +1,127 @@
+#include "uploadcontext.h"
+
+#include "profiler.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include "GLFW/glfw3.h"
+
+#include <utility>
+
+UploadContext::UploadContext(ThreadPool& threadPool)
+    : threadPool_(threadPool)
+    , window_{nullptr}
+    , running_{false}
+{
+}
+
+UploadContext::~UploadContext()
+{
+    stop();
+}
+
+bool UploadContext::start(GLFWwindow* sharedWindow)
+{
+    // Context hints of the shared window are still set, so the context is
+    // created with the same version and profile
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    window_ = glfwCreateWindow(1, 1, "", nullptr, sharedWindow);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+    if (!window_)
+    {
+        utils::logWarning(
+            "unable to create upload context, uploading on main thread");
+        return false;
+    }
+    {
+        const std::lock_guard lock(mutex_);
+        running_ = true;
+    }
+    thread_ = std::thread(&UploadContext::run, this);
+    return true;
+}
+
+void UploadContext::stop()
+{
+    {
+        const std::lock_guard lock(mutex_);
+        running_ = false;
+        uploads_.clear();
+    }
+    uploadQueued_.notify_one();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    if (window_)
+    {
+        glfwDestroyWindow(window_);
+        window_ = nullptr;
+    }
+}
+
+bool UploadContext::submit(std::function<void()> upload,
+                           std::function<void()> completion)
+{
+    {
+        const std::lock_guard lock(mutex_);
+        if (!running_)
+        {
+            return false;
+        }
+        uploads_.push_back(Upload{
+            .upload = std::move(upload),
+            .completion = std::move(completion),
+        });
+    }
+    uploadQueued_.notify_one();
+    return true;
+}
+
+void UploadContext::run()
+{
+    glfwMakeContextCurrent(window_);
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        uploadQueued_.wait(lock,
+                           [this]() { return !running_ || !uploads_.empty(); });
+        if (!running_)
+        {
+            break;
+        }
+        Upload upload = std::move(uploads_.front());
+        uploads_.pop_front();
+        lock.unlock();
+        {
+            PROFILE_SCOPE("UploadContext::upload");
+            upload.upload();
+        }
+        // Flushed, so that the fence is reached without waiting for further
+        // commands of this context
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        completeWhenSignaled(threadPool_, fence, std::move(upload.completion));
+        lock.lock();
+    }
+    lock.unlock();
+    glfwMakeContextCurrent(nullptr);
+}
+
+void UploadContext::completeWhenSignaled(ThreadPool& threadPool,
+                                         GLsync fence,
+                                         std::function<void()> completion)
+{
+    threadPool.submitToMainThread(
+        [&threadPool, fence, completion = std::move(completion)]()
+        {
+            // Polled without waiting, frames keep coming meanwhile
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                completeWhenSignaled(threadPool, fence, completion);
+                return;
+            }
+            glDeleteSync(fence);
+            completion();
+        });
+}
@@ -0,0 +1,79 @@
+#ifndef UPLOAD_CONTEXT_H_
+#define UPLOAD_CONTEXT_H_
+
+#include "glad/gl.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct GLFWwindow;
+class ThreadPool;
+
+/// Secondary graphics context sharing objects with the context of the window,
+/// current on a thread of its own, so that large buffers are uploaded without
+/// stalling frames drawn on the main thread.
+///
+/// Uploads run one after another in submission order. Each is followed by a
+/// fence, and its completion runs as main thread task of the thread pool once
+/// the GPU signaled the fence, so that the main context only uses objects
+/// after they were filled. Container objects like vertex arrays are not
+/// shared between contexts, and have to be created by completions.
+///
+/// Non-copyable, non-movable, the upload thread refers to the instance.
+class UploadContext
+{
+public:
+    explicit UploadContext(ThreadPool& threadPool);
+    UploadContext(const UploadContext&) = delete;
+    UploadContext& operator=(const UploadContext&) = delete;
+    UploadContext(UploadContext&&) = delete;
+    UploadContext& operator=(UploadContext&&) = delete;
+    ~UploadContext();
+
+    /// Create hidden window with context sharing objects with the context of
+    /// given window, and start upload thread. Must be called on the main
+    /// thread after OpenGL functions were loaded, as windows are only created
+    /// there. Returns false when context could not be created, in which case
+    /// uploads are left to the main thread.
+    bool start(GLFWwindow* sharedWindow);
+    /// Drop uploads not started yet, wait for the running one and destroy the
+    /// context. Must be called on the main thread before the shared window is
+    /// destroyed. Uploads submitted afterwards are refused.
+    void stop();
+
+    /// Run upload on the upload thread, then completion on the main thread
+    /// once the GPU finished the commands of the upload. Safe to call from any
+    /// thread. Returns false without running either when the context is not
+    /// started or already stopped, leaving the upload to the caller.
+    [[nodiscard]] bool submit(std::function<void()> upload,
+                              std::function<void()> completion);
+
+private:
+    struct Upload
+    {
+        std::function<void()> upload;
+        std::function<void()> completion;
+    };
+
+    void run();
+    /// Run completion once fence is signaled, checking it again with the
+    /// main thread tasks of each frame until then.
+    static void completeWhenSignaled(ThreadPool& threadPool,
+                                     GLsync fence,
+                                     std::function<void()> completion);
+
+    ThreadPool& threadPool_;
+    GLFWwindow* window_;
+    /// Guards uploads and running flag.
+    std::mutex mutex_;
+    std::condition_variable uploadQueued_;
+    std::deque<Upload> uploads_;
+    /// Set while the upload thread accepts uploads, from start until stop.
+    bool running_;
+    std::thread thread_;
+};
+
+#endif
@@ -27,12 +27,34 @@ inline void showErrorMessage(Args... args)
 #ifdef _WIN32
     MessageBox(nullptr, errorMessage.c_str(), "ERROR", MB_ICONERROR);
 #elif __EMSCRIPTEN__
-    std::ostringstream alertStream;
-    alertStream << "alert('" << errorMessage << "');";
-    emscripten_run_script(alertStream.str().c_str());
+    // Alerts are only available on the browser main thread, which is not the
+    // one rendering when the canvas is driven from a worker
+    MAIN_THREAD_EM_ASM({ alert(UTF8ToString($0)); }, errorMessage.c_str());
 #endif
 }
 
+/// Log a formatted warning message to console about a recoverable problem
+/// that does not need the user's attention.
+template <typename... Args>
+inline void logWarning(Args... args)
+{
+    std::ostringstream messageStream;
+    messageStream << "WARNING: ";
+    (messageStream << ... << args);
+    std::cerr << messageStream.str() << '\n';
+}
+
+/// Log a formatted informational message to console, like measurements
+/// worth keeping track of.
+template <typename... Args>
+inline void logInfo(Args... args)
+{
+    std::ostringstream messageStream;
+    messageStream << "INFO: ";
+    (messageStream << ... << args);
+    std::cerr << messageStream.str() << '\n';
+}
+
 /// Wrap around value to min if overflows max and to max if underflows min.
 template <typename T>
 inline void wrap(T& v, const T min, const T max)
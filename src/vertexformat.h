@@ -0,0 +1,271 @@
+#ifndef VERTEX_FORMAT_H_
+#define VERTEX_FORMAT_H_
+
+#include "mesh.h"
+#include "meshprocessing.h"
+
+#ifdef __EMSCRIPTEN__
+#include "glad/gles2.h"
+#else
+#include "glad/gl.h"
+#endif
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+#include <cstddef>
+#include <span>
+
+/// Format of a vertex attribute read from an interleaved vertex buffer.
+struct VertexAttribute
+{
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;
+};
+
+/// Attribute locations read by model shaders in every vertex format.
+constexpr GLuint POSITION_LOCATION = 0;
+constexpr GLuint NORMAL_LOCATION = 1;
+constexpr GLuint TEXCOORD_LOCATION = 2;
+/// Locations are numbered from zero without gaps.
+constexpr GLuint VERTEX_ATTRIBUTE_COUNT = 3;
+
+/// Compile-time description of a vertex layout, specialized for each vertex
+/// type. Attribute setup of vertex arrays, decoding of positions on the CPU
+/// and the transform of decoded positions in shaders are generated from it,
+/// so that adding a vertex format means adding a struct and a specialization.
+///
+/// Normalized integer attributes are converted to floating point by vertex
+/// fetch, so shaders receive the same input types in every format and are
+/// shared by all of them. Quantization relative to the bounding box is undone
+/// by the position transform folded into the model matrix instead of by
+/// shader variants.
+template <typename VertexType>
+struct VertexFormatDescriptor;
+
+template <>
+struct VertexFormatDescriptor<Vertex>
+{
+    static constexpr VertexFormat FORMAT = VertexFormat::Float;
+    static constexpr std::array<VertexAttribute, VERTEX_ATTRIBUTE_COUNT>
+        ATTRIBUTES{
+            VertexAttribute{POSITION_LOCATION,
+                            3,
+                            GL_FLOAT,
+                            GL_FALSE,
+                            offsetof(Vertex, position)},
+            VertexAttribute{NORMAL_LOCATION,
+                            3,
+                            GL_FLOAT,
+                            GL_FALSE,
+                            offsetof(Vertex, normal)},
+            VertexAttribute{TEXCOORD_LOCATION,
+                            2,
+                            GL_FLOAT,
+                            GL_FALSE,
+                            offsetof(Vertex, texCoord)},
+        };
+
+    static glm::vec3 position(const Vertex& vertex, const Bounds& /*bounds*/)
+    {
+        return vertex.position;
+    }
+
+    static glm::mat4 positionTransform(const Bounds& /*bounds*/)
+    {
+        return glm::mat4{1.0F};
+    }
+};
+
+template <>
+struct VertexFormatDescriptor<PackedVertex>
+{
+    static constexpr VertexFormat FORMAT = VertexFormat::Packed;
+    static constexpr std::array<VertexAttribute, VERTEX_ATTRIBUTE_COUNT>
+        ATTRIBUTES{
+            VertexAttribute{POSITION_LOCATION,
+                            3,
+                            GL_UNSIGNED_SHORT,
+                            GL_TRUE,
+                            offsetof(PackedVertex, position)},
+            VertexAttribute{NORMAL_LOCATION,
+                            4,
+                            GL_INT_2_10_10_10_REV,
+                            GL_TRUE,
+                            offsetof(PackedVertex, normal)},
+            VertexAttribute{TEXCOORD_LOCATION,
+                            2,
+                            GL_HALF_FLOAT,
+                            GL_FALSE,
+                            offsetof(PackedVertex, texCoord)},
+        };
+
+    static glm::vec3 position(const PackedVertex& vertex, const Bounds& bounds)
+    {
+        return meshprocessing::unpackPosition(vertex, bounds);
+    }
+
+    /// Positions arrive in [0, 1] range of the bounding box.
+    static glm::mat4 positionTransform(const Bounds& bounds)
+    {
+        return glm::scale(glm::translate(glm::mat4{1.0F}, bounds.minimum),
+                          bounds.maximum - bounds.minimum);
+    }
+};
+
+namespace vertexformat
+{
+/// Bytes read by vertex fetch for attribute, zero for unknown types.
+constexpr GLuint attributeByteSize(const VertexAttribute& attribute)
+{
+    const auto size = static_cast<GLuint>(attribute.size);
+    switch (attribute.type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return size;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return size * 2;
+    case GL_FLOAT:
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+        return size * 4;
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/// Whether attributes of vertex type have known types, lie within the vertex
+/// and provide every location read by model shaders exactly once.
+template <typename VertexType>
+constexpr bool isValid()
+{
+    std::array<bool, VERTEX_ATTRIBUTE_COUNT> hasLocations{};
+    for (const VertexAttribute& attribute :
+         VertexFormatDescriptor<VertexType>::ATTRIBUTES)
+    {
+        const GLuint byteSize = attributeByteSize(attribute);
+        if (byteSize == 0 || attribute.offset + byteSize > sizeof(VertexType)
+            || attribute.location >= VERTEX_ATTRIBUTE_COUNT
+            || hasLocations[attribute.location])
+        {
+            return false;
+        }
+        hasLocations[attribute.location] = true;
+    }
+    // Every attribute is provided once, so all locations have been seen
+    return true;
+}
+
+/// Call templated function with the vertex type of format, so that code
+/// written once for all formats branches on the format only here.
+template <typename Function>
+decltype(auto) visit(VertexFormat format, Function&& function)
+{
+    if (format == VertexFormat::Packed)
+    {
+        return function.template operator()<PackedVertex>();
+    }
+    return function.template operator()<Vertex>();
+}
+
+/// Call templated function with vertices of mesh data in their stored format.
+template <typename Function>
+decltype(auto) visitVertices(const MeshData& meshData, Function&& function)
+{
+    if (meshData.vertexFormat() == VertexFormat::Packed)
+    {
+        return function(meshData.packedVertices());
+    }
+    return function(meshData.vertices());
+}
+
+/// Enable attributes of vertex type on the bound vertex array, reading them
+/// from the bound array buffer.
+template <typename VertexType>
+void setupAttributes()
+{
+    static_assert(isValid<VertexType>());
+    for (const VertexAttribute& attribute :
+         VertexFormatDescriptor<VertexType>::ATTRIBUTES)
+    {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location,
+                              attribute.size,
+                              attribute.type,
+                              attribute.normalized,
+                              sizeof(VertexType),
+                              // NOLINTNEXTLINE(performance-no-int-to-ptr)
+                              reinterpret_cast<GLvoid*>(attribute.offset));
+    }
+}
+
+#ifndef __EMSCRIPTEN__
+/// Enable attributes of vertex type on vertex array without binding it,
+/// fetching all of them through vertex buffer binding 0.
+template <typename VertexType>
+void setupAttributes(GLuint vertexArray)
+{
+    static_assert(isValid<VertexType>());
+    for (const VertexAttribute& attribute :
+         VertexFormatDescriptor<VertexType>::ATTRIBUTES)
+    {
+        glEnableVertexArrayAttrib(vertexArray, attribute.location);
+        glVertexArrayAttribFormat(vertexArray,
+                                  attribute.location,
+                                  attribute.size,
+                                  attribute.type,
+                                  attribute.normalized,
+                                  attribute.offset);
+        glVertexArrayAttribBinding(vertexArray, attribute.location, 0);
+    }
+}
+#endif
+
+/// Distance between vertices of format in bytes.
+inline GLsizei stride(VertexFormat format)
+{
+    return visit(format,
+                 []<typename VertexType>()
+                 { return static_cast<GLsizei>(sizeof(VertexType)); });
+}
+
+/// Enable attributes of format on the bound vertex array, for call sites
+/// receiving vertices of either format.
+inline void setupAttributes(VertexFormat format)
+{
+    visit(format,
+          []<typename VertexType>() { setupAttributes<VertexType>(); });
+}
+
+#ifndef __EMSCRIPTEN__
+inline void setupAttributes(GLuint vertexArray, VertexFormat format)
+{
+    visit(format,
+          [vertexArray]<typename VertexType>()
+          { setupAttributes<VertexType>(vertexArray); });
+}
+#endif
+
+/// Transform of positions decoded by vertex fetch into model space.
+inline glm::mat4 positionTransform(VertexFormat format, const Bounds& bounds)
+{
+    return visit(format,
+                 [&bounds]<typename VertexType>()
+                 {
+                     return VertexFormatDescriptor<
+                         VertexType>::positionTransform(bounds);
+                 });
+}
+}  // namespace vertexformat
+
+#endif
@@ -0,0 +1,114 @@
+#include "videomemory.h"
+
+#include "utils.h"
+
+#ifndef __EMSCRIPTEN__
+#include "glad/gl.h"
+#endif
+
+namespace
+{
+constexpr size_t KIBIBYTE = 1024;
+constexpr size_t MEBIBYTE = 1024 * 1024;
+
+/// Order matches categories of video memory
+std::array<size_t, videomemory::CATEGORY_COUNT> usedSizes{};
+size_t budget = SIZE_MAX;
+/// Exceeding budget is warned about once until usage drops within it.
+bool overBudget = false;
+
+void checkBudget()
+{
+    const size_t used = videomemory::totalUsed();
+    if (used <= budget)
+    {
+        overBudget = false;
+        return;
+    }
+    if (!overBudget)
+    {
+        utils::logWarning("video memory use of ",
+                          used / MEBIBYTE,
+                          " MiB exceeds budget of ",
+                          budget / MEBIBYTE,
+                          " MiB");
+        overBudget = true;
+    }
+}
+}  // namespace
+
+namespace videomemory
+{
+void allocate(Category category, size_t size)
+{
+    usedSizes[static_cast<size_t>(category)] += size;
+    checkBudget();
+}
+
+void release(Category category, size_t size)
+{
+    usedSizes[static_cast<size_t>(category)] -= size;
+    checkBudget();
+}
+
+size_t used(Category category)
+{
+    return usedSizes[static_cast<size_t>(category)];
+}
+
+size_t totalUsed()
+{
+    size_t total = 0;
+    for (const size_t size : usedSizes)
+    {
+        total += size;
+    }
+    return total;
+}
+
+void setBudget(size_t size)
+{
+    if (budget != size)
+    {
+        budget = size;
+        checkBudget();
+    }
+}
+
+bool isOverBudget()
+{
+    return overBudget;
+}
+
+std::optional<DeviceMemory> queryDevice()
+{
+#ifndef __EMSCRIPTEN__
+    // Both report sizes in KiB
+    if (GLAD_GL_NVX_gpu_memory_info)
+    {
+        GLint dedicatedSize = 0;
+        GLint availableSize = 0;
+        glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicatedSize);
+        glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX,
+                      &availableSize);
+        return DeviceMemory{
+            .dedicatedSize = static_cast<size_t>(dedicatedSize) * KIBIBYTE,
+            .availableSize = static_cast<size_t>(availableSize) * KIBIBYTE,
+        };
+    }
+    if (GLAD_GL_ATI_meminfo)
+    {
+        // Free memory of the texture pool comes first, followed by the
+        // largest free block and the same for auxiliary memory
+        std::array<GLint, 4> textureFreeMemory{};
+        glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, textureFreeMemory.data());
+        return DeviceMemory{
+            .dedicatedSize = std::nullopt,
+            .availableSize
+            = static_cast<size_t>(textureFreeMemory[0]) * KIBIBYTE,
+        };
+    }
+#endif
+    return std::nullopt;
+}
+}  // namespace videomemory
@@ -0,0 +1,68 @@
+#ifndef VIDEO_MEMORY_H_
+#define VIDEO_MEMORY_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/// Registry of video memory taken by resources of the application, as OpenGL
+/// does not report usage per resource.
+///
+/// Resources are tracked where their storage is allocated and released, by
+/// the size of their contents. Streaming buffers whose size follows the
+/// objects drawn each frame are not tracked. A warning is logged whenever
+/// tracked usage grows over the budget. Only accessed from the thread the
+/// graphics context is current on.
+namespace videomemory
+{
+enum class Category : std::uint8_t
+{
+    /// Vertex and index buffers of models and the geometry arena.
+    Geometry,
+    /// Skybox cube-maps and impostor atlases.
+    Texture,
+    /// Offscreen scene targets and the depth pyramid of occlusion culling.
+    RenderTarget,
+    /// Staging buffers of texture uploads.
+    Upload,
+    /// Uniform and draw identifier buffers of the renderer.
+    DrawData,
+};
+constexpr size_t CATEGORY_COUNT = 5;
+// Order matches categories
+constexpr std::array<const char*, CATEGORY_COUNT> CATEGORY_NAMES{
+    "Geometry",
+    "Textures",
+    "Render targets",
+    "Upload",
+    "Draw data"};
+
+/// Video memory of the device as reported by the driver.
+struct DeviceMemory
+{
+    /// Bytes of dedicated video memory. Not reported by every driver.
+    std::optional<size_t> dedicatedSize;
+    /// Bytes currently available to allocate, including memory used by
+    /// other applications.
+    size_t availableSize;
+};
+
+void allocate(Category category, size_t size);
+void release(Category category, size_t size);
+
+/// Bytes of tracked resources currently allocated.
+[[nodiscard]] size_t used(Category category);
+[[nodiscard]] size_t totalUsed();
+
+/// Bytes tracked resources are expected to stay within, for sharing the
+/// device with other applications.
+void setBudget(size_t size);
+[[nodiscard]] bool isOverBudget();
+
+/// Query device memory through GL_NVX_gpu_memory_info or GL_ATI_meminfo.
+/// Returns nothing when neither is supported, as always in WebGL.
+[[nodiscard]] std::optional<DeviceMemory> queryDevice();
+}  // namespace videomemory
+
+#endif
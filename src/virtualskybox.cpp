@@ -0,0 +1,204 @@
+#include "virtualskybox.h"
+
+#include "profiler.h"
+#include "rendertarget.h"
+#include "videomemory.h"
+#include "virtualtexture.h"
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+/// Texture units of physical page cache and page table while drawing.
+constexpr GLuint PHYSICAL_PAGES_TEXTURE_UNIT = 0;
+constexpr GLuint PAGE_TABLE_TEXTURE_UNIT = 5;
+/// Scene resolution divided by feedback resolution along each axis. Pages
+/// span many pixels, so sparse feedback still sees every page in view.
+constexpr int FEEDBACK_SCALE = 8;
+/// Feedback read backs in flight. Frames are skipped while all of them are
+/// pending.
+constexpr size_t FEEDBACK_BUFFER_COUNT = 3;
+constexpr GLenum FEEDBACK_COLOR_FORMAT = GL_RGBA8;
+
+int feedbackSize(int size)
+{
+    return std::max(size / FEEDBACK_SCALE, 1);
+}
+}  // namespace
+
+VirtualSkybox::VirtualSkybox()
+    : readback_{FEEDBACK_BUFFER_COUNT}
+    , feedbackTexture_{0}
+    , feedbackFramebuffer_{0}
+    , feedbackWidth_{0}
+    , feedbackHeight_{0}
+{
+}
+
+VirtualSkybox::~VirtualSkybox()
+{
+    videomemory::release(
+        videomemory::Category::RenderTarget,
+        static_cast<size_t>(feedbackWidth_)
+            * static_cast<size_t>(feedbackHeight_)
+            * RenderTarget::colorPixelSize(FEEDBACK_COLOR_FORMAT));
+    glDeleteFramebuffers(1, &feedbackFramebuffer_);
+    glDeleteTextures(1, &feedbackTexture_);
+}
+
+VirtualSkybox::PendingShaders VirtualSkybox::submitShaders()
+{
+    const fs::path vertexShaderPath{"assets/shaders/skybox_gl4.vert.glsl"};
+    return PendingShaders{
+        .skyboxShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/skybox_virtual_gl4.frag.glsl"}),
+        .feedbackShader = Shader::submitFromFile(
+            vertexShaderPath,
+            fs::path{"assets/shaders/skybox_feedback_gl4.frag.glsl"}),
+    };
+}
+
+bool VirtualSkybox::init(PendingShaders&& shaders)
+{
+    skyboxShader_ = shaders.skyboxShader.finish();
+    feedbackShader_ = shaders.feedbackShader.finish();
+    if (!skyboxShader_ || !feedbackShader_)
+    {
+        return false;
+    }
+    skyboxInverseProjectionViewUniform_
+        = skyboxShader_->getUniformHandle<glm::mat4>(
+            "u_inverseProjectionView");
+    pageTableUniform_ = skyboxShader_->getUniformHandle<int>("u_pageTable");
+    physicalPagesUniform_
+        = skyboxShader_->getUniformHandle<int>("u_physicalPages");
+    skyboxFaceSizeUniform_ = skyboxShader_->getUniformHandle<int>("u_faceSize");
+    skyboxLevelCountUniform_
+        = skyboxShader_->getUniformHandle<int>("u_levelCount");
+    feedbackInverseProjectionViewUniform_
+        = feedbackShader_->getUniformHandle<glm::mat4>(
+            "u_inverseProjectionView");
+    feedbackFaceSizeUniform_
+        = feedbackShader_->getUniformHandle<int>("u_faceSize");
+    feedbackLevelCountUniform_
+        = feedbackShader_->getUniformHandle<int>("u_levelCount");
+    lodBiasUniform_ = feedbackShader_->getUniformHandle<float>("u_lodBias");
+    return true;
+}
+
+bool VirtualSkybox::resize(int width, int height)
+{
+    width = feedbackSize(width);
+    height = feedbackSize(height);
+    if (width == feedbackWidth_ && height == feedbackHeight_)
+    {
+        return true;
+    }
+    const size_t pixelSize
+        = RenderTarget::colorPixelSize(FEEDBACK_COLOR_FORMAT);
+    videomemory::release(videomemory::Category::RenderTarget,
+                         static_cast<size_t>(feedbackWidth_)
+                             * static_cast<size_t>(feedbackHeight_)
+                             * pixelSize);
+    feedbackWidth_ = width;
+    feedbackHeight_ = height;
+    videomemory::allocate(videomemory::Category::RenderTarget,
+                          static_cast<size_t>(feedbackWidth_)
+                              * static_cast<size_t>(feedbackHeight_)
+                              * pixelSize);
+
+    if (!feedbackTexture_)
+    {
+        glGenTextures(1, &feedbackTexture_);
+        glGenFramebuffers(1, &feedbackFramebuffer_);
+    }
+    RenderTarget::allocateColorTexture(feedbackTexture_,
+                                       FEEDBACK_COLOR_FORMAT,
+                                       width,
+                                       height);
+    glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           feedbackTexture_,
+                           0);
+    const bool complete
+        = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void VirtualSkybox::draw(VirtualTexture& virtualTexture,
+                         const glm::mat4& inverseProjectionView,
+                         int sceneWidth,
+                         int sceneHeight,
+                         GLuint emptyVertexArray,
+                         GlStateCache& glState)
+{
+    PROFILE_SCOPE("VirtualSkybox::draw");
+    // Feedback is identified by the generation of the texture it was drawn
+    // for, ignoring feedback of skyboxes switched away from
+    while (std::optional<PixelReadback::Pixels> feedback
+           = readback_.takeFinished())
+    {
+        if (feedback->id == virtualTexture.generation())
+        {
+            virtualTexture.requestPages(feedback->data);
+        }
+    }
+    virtualTexture.update(glState);
+
+    glState.bindVertexArray(emptyVertexArray);
+    glState.bindTexture(PHYSICAL_PAGES_TEXTURE_UNIT,
+                        GL_TEXTURE_2D,
+                        virtualTexture.physicalTexture());
+    glState.bindTexture(PAGE_TABLE_TEXTURE_UNIT,
+                        GL_TEXTURE_2D_ARRAY,
+                        virtualTexture.pageTable());
+    skyboxShader_->use(glState);
+    skyboxShader_->setUniform(skyboxInverseProjectionViewUniform_,
+                              inverseProjectionView);
+    skyboxShader_->setUniform(physicalPagesUniform_,
+                              static_cast<int>(PHYSICAL_PAGES_TEXTURE_UNIT));
+    skyboxShader_->setUniform(pageTableUniform_,
+                              static_cast<int>(PAGE_TABLE_TEXTURE_UNIT));
+    skyboxShader_->setUniform(skyboxFaceSizeUniform_,
+                              virtualTexture.faceSize());
+    skyboxShader_->setUniform(skyboxLevelCountUniform_,
+                              virtualTexture.levelCount());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    if (!feedbackTexture_ || readback_.isFull())
+    {
+        return;
+    }
+    // Feedback target has no depth buffer, and blending would mix the
+    // channels holding page coordinates
+    const int width = std::min(feedbackSize(sceneWidth), feedbackWidth_);
+    const int height = std::min(feedbackSize(sceneHeight), feedbackHeight_);
+    glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer_);
+    glViewport(0, 0, width, height);
+    const bool blendEnabled = glState.blendEnabled();
+    glState.setBlendEnabled(false);
+    glClearColor(0.0F, 0.0F, 0.0F, 0.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+    feedbackShader_->use(glState);
+    feedbackShader_->setUniform(feedbackInverseProjectionViewUniform_,
+                                inverseProjectionView);
+    feedbackShader_->setUniform(feedbackFaceSizeUniform_,
+                                virtualTexture.faceSize());
+    feedbackShader_->setUniform(feedbackLevelCountUniform_,
+                                virtualTexture.levelCount());
+    feedbackShader_->setUniform(
+        lodBiasUniform_,
+        -static_cast<float>(std::countr_zero(
+            static_cast<unsigned>(FEEDBACK_SCALE))));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    readback_.readPixels(virtualTexture.generation(), width, height);
+    glState.setBlendEnabled(blendEnabled);
+}
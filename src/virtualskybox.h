@@ -0,0 +1,87 @@
+#ifndef VIRTUAL_SKYBOX_H_
+#define VIRTUAL_SKYBOX_H_
+
+#include "glstatecache.h"
+#include "pixelreadback.h"
+#include "shader.h"
+
+#include "glad/gl.h"
+#include "glm/mat4x4.hpp"
+
+#include <optional>
+
+class VirtualTexture;
+
+/// Drawing of skyboxes whose faces are virtual textures, along with the
+/// feedback pass reporting the pages they need.
+///
+/// Feedback is drawn at a fraction of the scene resolution into a texture of
+/// its own, writing the page seen by each pixel at the level matching scene
+/// resolution, and read back asynchronously a few frames later, so that the
+/// pipeline never stalls on it. Feedback is drawn without depth test, also
+/// requesting pages hidden behind models, which are about to be seen as the
+/// camera moves.
+///
+/// Like the scene framebuffer, feedback is allocated for the full window size
+/// and drawn into at its bottom-left corner. Framebuffer is created on first
+/// resize. Non-copyable, non-movable, pending read backs refer to its
+/// buffers.
+class VirtualSkybox
+{
+public:
+    /// Shaders of skybox and feedback pass submitted for compilation.
+    struct PendingShaders
+    {
+        PendingShader skyboxShader;
+        PendingShader feedbackShader;
+    };
+
+    VirtualSkybox();
+    VirtualSkybox(const VirtualSkybox&) = delete;
+    VirtualSkybox& operator=(const VirtualSkybox&) = delete;
+    VirtualSkybox(VirtualSkybox&&) = delete;
+    VirtualSkybox& operator=(VirtualSkybox&&) = delete;
+    ~VirtualSkybox();
+
+    /// Submit shaders for compilation without waiting for the driver to
+    /// finish.
+    static PendingShaders submitShaders();
+
+    /// Finish compilation of submitted shaders.
+    bool init(PendingShaders&& shaders);
+
+    /// Recreate feedback texture when window framebuffer size changes.
+    /// Returns false when the driver rejects the framebuffer.
+    bool resize(int width, int height);
+
+    /// Request pages of feedback read back since the previous frame, update
+    /// residency of virtual texture and draw skybox with it into the bound
+    /// framebuffer, then draw feedback of scene of given size. Framebuffer
+    /// and viewport are left changed for the caller to restore.
+    void draw(VirtualTexture& virtualTexture,
+              const glm::mat4& inverseProjectionView,
+              int sceneWidth,
+              int sceneHeight,
+              GLuint emptyVertexArray,
+              GlStateCache& glState);
+
+private:
+    std::optional<Shader> skyboxShader_;
+    std::optional<Shader> feedbackShader_;
+    UniformHandle<glm::mat4> skyboxInverseProjectionViewUniform_;
+    UniformHandle<int> pageTableUniform_;
+    UniformHandle<int> physicalPagesUniform_;
+    UniformHandle<int> skyboxFaceSizeUniform_;
+    UniformHandle<int> skyboxLevelCountUniform_;
+    UniformHandle<glm::mat4> feedbackInverseProjectionViewUniform_;
+    UniformHandle<int> feedbackFaceSizeUniform_;
+    UniformHandle<int> feedbackLevelCountUniform_;
+    UniformHandle<float> lodBiasUniform_;
+    PixelReadback readback_;
+    GLuint feedbackTexture_;
+    GLuint feedbackFramebuffer_;
+    int feedbackWidth_;
+    int feedbackHeight_;
+};
+
+#endif
@@ -0,0 +1,649 @@
+#include "virtualtexture.h"
+
+#include "profiler.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'V', 'T', 'E', 'X'};
+// Increment on any change of Header or page layout.
+constexpr std::uint32_t FORMAT_VERSION = 1;
+/// Page reads in flight at most, so that a sudden camera turn does not queue
+/// up reads whose pages are no longer seen by the time they finish.
+constexpr size_t MAX_PENDING_READS = 32;
+/// Pages uploaded in a frame at most, spreading the uploads of a sudden
+/// camera turn over several frames.
+constexpr size_t MAX_UPLOADS_PER_FRAME = 16;
+/// Generation of the next texture created. Textures are only created on the
+/// thread the graphics context is current on.
+size_t nextGeneration = 1;
+
+/// Identity of source image file revision used for invalidation.
+struct SourceStamp
+{
+    std::uint64_t fileSize;
+    std::int64_t modifiedTime;
+
+    bool operator==(const SourceStamp&) const = default;
+};
+
+struct Header
+{
+    std::array<char, 4> magic;
+    std::uint32_t version;
+    std::uint32_t faceSize;
+    std::uint32_t levelCount;
+    std::uint32_t hdr;
+    std::uint32_t padding;
+    std::array<SourceStamp, virtualtexture::FACE_COUNT> sourceStamps;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+
+std::optional<SourceStamp> querySourceStamp(const fs::path& sourcePath)
+{
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+    const fs::file_time_type modifiedTime
+        = fs::last_write_time(sourcePath, error);
+    if (error)
+    {
+        return std::nullopt;
+    }
+
+    return SourceStamp{
+        .fileSize = static_cast<std::uint64_t>(fileSize),
+        .modifiedTime
+        = static_cast<std::int64_t>(modifiedTime.time_since_epoch().count()),
+    };
+}
+
+std::optional<std::array<SourceStamp, virtualtexture::FACE_COUNT>>
+querySourceStamps(std::span<const fs::path, virtualtexture::FACE_COUNT> paths)
+{
+    std::array<SourceStamp, virtualtexture::FACE_COUNT> stamps{};
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        const std::optional<SourceStamp> stamp = querySourceStamp(paths[i]);
+        if (!stamp)
+        {
+            return std::nullopt;
+        }
+        stamps[i] = stamp.value();
+    }
+    return stamps;
+}
+
+fs::path tilesPath(const fs::path& firstFacePath)
+{
+    fs::path path = firstFacePath;
+    path += ".vtex";
+    return path;
+}
+
+/// Levels from full size down to a single page per face.
+int levelCount(int faceSize)
+{
+    return std::countr_zero(
+               static_cast<unsigned>(faceSize / virtualtexture::PAGE_SIZE))
+         + 1;
+}
+
+size_t pageCount(int faceSize)
+{
+    size_t count = 0;
+    for (int level = 0; level < levelCount(faceSize); ++level)
+    {
+        const auto side
+            = static_cast<size_t>((faceSize / virtualtexture::PAGE_SIZE)
+                                  >> level);
+        count += virtualtexture::FACE_COUNT * side * side;
+    }
+    return count;
+}
+
+/// Copy page with its border out of RGB level of given size into RGBA
+/// texels, clamping at the edges of the level.
+template <typename Source, typename Texel>
+void cutPage(const Source* level,
+             int levelSize,
+             int pageX,
+             int pageY,
+             std::vector<Texel>& page,
+             Texel alpha,
+             Texel (*convert)(Source))
+{
+    using virtualtexture::PAGE_BORDER;
+    using virtualtexture::PAGE_SIZE;
+    using virtualtexture::SLOT_SIZE;
+    for (int y = 0; y < SLOT_SIZE; ++y)
+    {
+        const int sourceY
+            = std::clamp(pageY * PAGE_SIZE - PAGE_BORDER + y, 0, levelSize - 1);
+        for (int x = 0; x < SLOT_SIZE; ++x)
+        {
+            const int sourceX = std::clamp(pageX * PAGE_SIZE - PAGE_BORDER + x,
+                                           0,
+                                           levelSize - 1);
+            const Source* source
+                = level + (static_cast<size_t>(sourceY) * levelSize + sourceX)
+                              * 3;
+            Texel* texel
+                = page.data() + (static_cast<size_t>(y) * SLOT_SIZE + x) * 4;
+            for (int c = 0; c < 3; ++c)
+            {
+                texel[c] = convert(source[c]);
+            }
+            texel[3] = alpha;
+        }
+    }
+}
+
+std::uint8_t keepByte(unsigned char value)
+{
+    return value;
+}
+
+std::uint16_t toHalf(float value)
+{
+    return static_cast<std::uint16_t>(glm::packHalf1x16(value));
+}
+}  // namespace
+
+namespace virtualtexture
+{
+bool isVirtualSize(int faceSize)
+{
+    return faceSize >= MIN_FACE_SIZE && std::has_single_bit(
+               static_cast<unsigned>(faceSize));
+}
+
+std::optional<Tiles> map(std::span<const fs::path, FACE_COUNT> facePaths)
+{
+    const std::optional<std::array<SourceStamp, FACE_COUNT>> stamps
+        = querySourceStamps(facePaths);
+    if (!stamps)
+    {
+        return std::nullopt;
+    }
+
+    std::optional<MappedFile> file = MappedFile::open(tilesPath(facePaths[0]));
+    if (!file || file->size() < sizeof(Header))
+    {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(Header));
+    const auto faceSize = static_cast<int>(header.faceSize);
+    if (header.magic != MAGIC || header.version != FORMAT_VERSION
+        || header.sourceStamps != stamps.value() || !isVirtualSize(faceSize)
+        || static_cast<int>(header.levelCount) != levelCount(faceSize))
+    {
+        return std::nullopt;
+    }
+
+    Tiles tiles{
+        .file = std::move(file.value()),
+        .faceSize = faceSize,
+        .levelCount = static_cast<int>(header.levelCount),
+        .hdr = header.hdr != 0,
+        .pages = {},
+    };
+    // Reject truncated files before reading pages from them
+    const size_t pagesSize = pageCount(faceSize) * tiles.pageDataSize();
+    if (tiles.file.size() != sizeof(Header) + pagesSize)
+    {
+        return std::nullopt;
+    }
+    tiles.pages = std::span{tiles.file.data() + sizeof(Header), pagesSize};
+    return tiles;
+}
+
+std::optional<Tiles> bake(
+    std::span<const fs::path, FACE_COUNT> facePaths,
+    int faceSize,
+    bool hdr,
+    std::span<const std::vector<const void*>, FACE_COUNT> faceLevels)
+{
+    PROFILE_SCOPE("virtualtexture::bake");
+    const std::optional<std::array<SourceStamp, FACE_COUNT>> stamps
+        = querySourceStamps(facePaths);
+    if (!stamps || !isVirtualSize(faceSize))
+    {
+        return std::nullopt;
+    }
+    const int levels = levelCount(faceSize);
+    const Header header{
+        .magic = MAGIC,
+        .version = FORMAT_VERSION,
+        .faceSize = static_cast<std::uint32_t>(faceSize),
+        .levelCount = static_cast<std::uint32_t>(levels),
+        .hdr = hdr ? 1U : 0U,
+        .padding = 0,
+        .sourceStamps = stamps.value(),
+    };
+
+    // Write into temporary file first and rename afterwards, so that an
+    // interrupted bake never leaves a half-written page file behind. Pages
+    // are cut and written one at a time, as the whole page file may not fit
+    // in memory.
+    const fs::path path = tilesPath(facePaths[0]);
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        std::vector<std::uint8_t> page;
+        std::vector<std::uint16_t> hdrPage;
+        for (int level = 0; level < levels; ++level)
+        {
+            const int levelSize = faceSize >> level;
+            const int side = (faceSize / PAGE_SIZE) >> level;
+            for (size_t face = 0; face < FACE_COUNT; ++face)
+            {
+                const void* levelData
+                    = faceLevels[face][static_cast<size_t>(level)];
+                for (int y = 0; y < side; ++y)
+                {
+                    for (int x = 0; x < side; ++x)
+                    {
+                        if (hdr)
+                        {
+                            hdrPage.resize(
+                                static_cast<size_t>(SLOT_SIZE * SLOT_SIZE * 4));
+                            cutPage(static_cast<const float*>(levelData),
+                                    levelSize,
+                                    x,
+                                    y,
+                                    hdrPage,
+                                    toHalf(1.0F),
+                                    &toHalf);
+                            file.write(
+                                reinterpret_cast<const char*>(hdrPage.data()),
+                                static_cast<std::streamsize>(
+                                    hdrPage.size() * sizeof(std::uint16_t)));
+                            continue;
+                        }
+                        page.resize(
+                            static_cast<size_t>(SLOT_SIZE * SLOT_SIZE * 4));
+                        cutPage(static_cast<const unsigned char*>(levelData),
+                                levelSize,
+                                x,
+                                y,
+                                page,
+                                std::uint8_t{255},
+                                &keepByte);
+                        file.write(reinterpret_cast<const char*>(page.data()),
+                                   static_cast<std::streamsize>(page.size()));
+                    }
+                }
+            }
+        }
+        if (!file)
+        {
+            utils::showErrorMessage("unable to write virtual texture pages ",
+                                    temporaryPath);
+            return std::nullopt;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temporaryPath, path, error);
+    if (error)
+    {
+        utils::showErrorMessage("unable to write virtual texture pages ",
+                                path,
+                                ": ",
+                                error.message());
+        fs::remove(temporaryPath, error);
+        return std::nullopt;
+    }
+    return map(facePaths);
+}
+}  // namespace virtualtexture
+
+VirtualTexture::VirtualTexture(virtualtexture::Tiles&& tiles,
+                               ThreadPool& threadPool)
+    : threadPool_{threadPool}
+    , pages_{tiles.pages}
+    , faceSize_{tiles.faceSize}
+    , levelCount_{tiles.levelCount}
+    , hdr_{tiles.hdr}
+    , pageDataSize_{tiles.pageDataSize()}
+    , slotPages_(static_cast<size_t>(SLOTS_PER_SIDE * SLOTS_PER_SIDE), NO_PAGE)
+    , slotFrames_(slotPages_.size(), 0)
+    , readQueue_{std::make_shared<ReadQueue>()}
+    , pendingReadCount_{0}
+    , residentPageCount_{0}
+    // Pages are never seen in frame zero
+    , frame_{1}
+    , pageTableOutdated_{true}
+    , pageTable_{0}
+    , physicalTexture_{0}
+    , generation_{nextGeneration++}
+{
+    // Span of pages stays valid, as moving the mapping keeps its address
+    file_ = std::make_shared<const MappedFile>(std::move(tiles.file));
+
+    std::uint32_t pageCount = 0;
+    for (int level = 0; level < levelCount_; ++level)
+    {
+        levelFirstPages_.push_back(pageCount);
+        const auto side = static_cast<std::uint32_t>(pagesPerSide(level));
+        pageCount += static_cast<std::uint32_t>(virtualtexture::FACE_COUNT)
+                   * side * side;
+    }
+    pageSlots_.assign(pageCount, NO_SLOT);
+    pagesReading_.assign(pageCount, 0);
+    pageRequestFrames_.assign(pageCount, 0);
+
+    // Entries are fetched without filtering, one mip level per page level
+    glGenTextures(1, &pageTable_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pageTable_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY,
+                   levelCount_,
+                   GL_RGBA8,
+                   pagesPerSide(0),
+                   pagesPerSide(0),
+                   static_cast<GLsizei>(virtualtexture::FACE_COUNT));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Pages are filtered bilinearly within their border
+    constexpr GLsizei physicalSize = SLOTS_PER_SIDE * virtualtexture::SLOT_SIZE;
+    glGenTextures(1, &physicalTexture_);
+    glBindTexture(GL_TEXTURE_2D, physicalTexture_);
+    glTexStorage2D(GL_TEXTURE_2D,
+                   1,
+                   hdr_ ? GL_RGBA16F : GL_RGBA8,
+                   physicalSize,
+                   physicalSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Coarsest level is the fallback of every other page, read right away
+    // into the first slots, which are never evicted. Textures are bound
+    // without going through the state cache, like other loaded textures.
+    const int coarsestLevel = levelCount_ - 1;
+    for (int face = 0; face < static_cast<int>(virtualtexture::FACE_COUNT);
+         ++face)
+    {
+        const std::uint32_t page = pageIndex(coarsestLevel, face, 0, 0);
+        upload(page,
+               face,
+               pages_.subspan(static_cast<size_t>(page) * pageDataSize_,
+                              pageDataSize_));
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pageTable_);
+    updatePageTable();
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    glDeleteTextures(1, &pageTable_);
+    glDeleteTextures(1, &physicalTexture_);
+}
+
+void VirtualTexture::requestPages(std::span<const std::uint8_t> feedback)
+{
+    PROFILE_SCOPE("VirtualTexture::requestPages");
+    for (size_t i = 0; i + 3 < feedback.size(); i += 4)
+    {
+        const int level = feedback[i + 3] - 1;
+        const int face = feedback[i + 2];
+        int x = feedback[i];
+        int y = feedback[i + 1];
+        if (level < 0 || level >= levelCount_
+            || face >= static_cast<int>(virtualtexture::FACE_COUNT)
+            || x >= pagesPerSide(level) || y >= pagesPerSide(level))
+        {
+            continue;
+        }
+        // Ancestors are seen along with the page, keeping its fallback from
+        // being evicted, and are requested first when missing
+        for (int ancestor = level; ancestor < levelCount_; ++ancestor)
+        {
+            const std::uint32_t page = pageIndex(ancestor, face, x, y);
+            if (pageRequestFrames_[page] == frame_)
+            {
+                break;
+            }
+            pageRequestFrames_[page] = frame_;
+            const std::int32_t slot = pageSlots_[page];
+            if (slot != NO_SLOT)
+            {
+                slotFrames_[static_cast<size_t>(slot)] = frame_;
+            }
+            else if (!pagesReading_[page])
+            {
+                requests_.push_back(page);
+            }
+            x /= 2;
+            y /= 2;
+        }
+    }
+}
+
+void VirtualTexture::update(GlStateCache& glState)
+{
+    PROFILE_SCOPE("VirtualTexture::update");
+    std::vector<ReadPage> readPages;
+    {
+        const std::lock_guard lock{readQueue_->mutex};
+        const size_t uploadCount
+            = std::min(readQueue_->pages.size(), MAX_UPLOADS_PER_FRAME);
+        const auto uploadEnd = readQueue_->pages.begin()
+                             + static_cast<std::ptrdiff_t>(uploadCount);
+        readPages.assign(std::make_move_iterator(readQueue_->pages.begin()),
+                         std::make_move_iterator(uploadEnd));
+        readQueue_->pages.erase(readQueue_->pages.begin(), uploadEnd);
+    }
+    pendingReadCount_ -= readPages.size();
+    if (!readPages.empty())
+    {
+        glState.bindTexture(0, GL_TEXTURE_2D, physicalTexture_);
+    }
+    for (const ReadPage& readPage : readPages)
+    {
+        pagesReading_[readPage.page] = 0;
+        // Pages are dropped when every slot holds a page seen in this frame,
+        // they are requested again while still seen
+        const std::int32_t slot = allocateSlot();
+        if (slot != NO_SLOT)
+        {
+            upload(readPage.page, slot, readPage.data);
+        }
+    }
+
+    // Coarser pages come first, as they are the fallback of the finer ones
+    // and cover more of the view
+    std::sort(requests_.begin(), requests_.end(), std::greater{});
+    const size_t readCount
+        = std::min(requests_.size(), MAX_PENDING_READS - pendingReadCount_);
+    for (const std::uint32_t page : std::span{requests_}.first(readCount))
+    {
+        pagesReading_[page] = 1;
+        ++pendingReadCount_;
+        // Reading touches the mapping, paging the data in from disk on the
+        // worker instead of stalling the main thread on upload. Future is not
+        // needed, the page is handed over through the read queue.
+        threadPool_.submit(
+            [page,
+             data = pages_.subspan(static_cast<size_t>(page) * pageDataSize_,
+                                   pageDataSize_),
+             file = file_,
+             readQueue = readQueue_]()
+            {
+                ReadPage readPage{
+                    .page = page,
+                    .data = std::vector<std::byte>(data.begin(), data.end()),
+                };
+                const std::lock_guard lock{readQueue->mutex};
+                readQueue->pages.push_back(std::move(readPage));
+            });
+    }
+    requests_.clear();
+
+    if (pageTableOutdated_)
+    {
+        glState.bindTexture(0, GL_TEXTURE_2D_ARRAY, pageTable_);
+        updatePageTable();
+    }
+    ++frame_;
+}
+
+size_t VirtualTexture::videoMemorySize() const
+{
+    constexpr auto physicalSize
+        = static_cast<size_t>(SLOTS_PER_SIDE * virtualtexture::SLOT_SIZE);
+    return physicalSize * physicalSize * (hdr_ ? 8 : 4)
+         + pageSlots_.size() * 4;
+}
+
+VirtualTexture::Statistics VirtualTexture::statistics() const
+{
+    return Statistics{
+        .residentPageCount = residentPageCount_,
+        .slotCount = slotPages_.size(),
+        .pendingReadCount = pendingReadCount_,
+    };
+}
+
+std::uint32_t VirtualTexture::pageIndex(int level, int face, int x, int y) const
+{
+    const auto side = static_cast<std::uint32_t>(pagesPerSide(level));
+    return levelFirstPages_[static_cast<size_t>(level)]
+         + (static_cast<std::uint32_t>(face) * side
+            + static_cast<std::uint32_t>(y))
+               * side
+         + static_cast<std::uint32_t>(x);
+}
+
+void VirtualTexture::upload(std::uint32_t page,
+                            std::int32_t slot,
+                            std::span<const std::byte> data)
+{
+    const std::uint32_t evictedPage = slotPages_[static_cast<size_t>(slot)];
+    if (evictedPage != NO_PAGE)
+    {
+        pageSlots_[evictedPage] = NO_SLOT;
+        --residentPageCount_;
+    }
+    slotPages_[static_cast<size_t>(slot)] = page;
+    slotFrames_[static_cast<size_t>(slot)] = frame_;
+    pageSlots_[page] = slot;
+    ++residentPageCount_;
+    pageTableOutdated_ = true;
+
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    slot % SLOTS_PER_SIDE * virtualtexture::SLOT_SIZE,
+                    slot / SLOTS_PER_SIDE * virtualtexture::SLOT_SIZE,
+                    virtualtexture::SLOT_SIZE,
+                    virtualtexture::SLOT_SIZE,
+                    GL_RGBA,
+                    hdr_ ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE,
+                    data.data());
+}
+
+std::int32_t VirtualTexture::allocateSlot()
+{
+    // Slots of the coarsest level are skipped
+    std::int32_t leastRecentSlot = NO_SLOT;
+    for (auto slot = static_cast<std::int32_t>(virtualtexture::FACE_COUNT);
+         slot < static_cast<std::int32_t>(slotPages_.size());
+         ++slot)
+    {
+        const auto i = static_cast<size_t>(slot);
+        if (slotPages_[i] == NO_PAGE)
+        {
+            return slot;
+        }
+        if (slotFrames_[i] < frame_
+            && (leastRecentSlot == NO_SLOT
+                || slotFrames_[i]
+                       < slotFrames_[static_cast<size_t>(leastRecentSlot)]))
+        {
+            leastRecentSlot = slot;
+        }
+    }
+    return leastRecentSlot;
+}
+
+void VirtualTexture::updatePageTable()
+{
+    PROFILE_SCOPE("VirtualTexture::updatePageTable");
+    pageTableOutdated_ = false;
+    // Levels are filled from the coarsest, so that entries of missing pages
+    // copy the entry of their parent
+    std::vector<std::array<std::uint8_t, 4>> entries;
+    std::vector<std::array<std::uint8_t, 4>> parentEntries;
+    for (int level = levelCount_ - 1; level >= 0; --level)
+    {
+        const int side = pagesPerSide(level);
+        entries.resize(virtualtexture::FACE_COUNT
+                       * static_cast<size_t>(side * side));
+        for (int face = 0; face < static_cast<int>(virtualtexture::FACE_COUNT);
+             ++face)
+        {
+            for (int y = 0; y < side; ++y)
+            {
+                for (int x = 0; x < side; ++x)
+                {
+                    const size_t entry
+                        = (static_cast<size_t>(face) * side + y) * side + x;
+                    const std::int32_t slot
+                        = pageSlots_[pageIndex(level, face, x, y)];
+                    if (slot != NO_SLOT)
+                    {
+                        entries[entry] = {
+                            static_cast<std::uint8_t>(slot % SLOTS_PER_SIDE),
+                            static_cast<std::uint8_t>(slot / SLOTS_PER_SIDE),
+                            static_cast<std::uint8_t>(level),
+                            255,
+                        };
+                        continue;
+                    }
+                    const int parentSide = side / 2;
+                    entries[entry] = parentEntries[(static_cast<size_t>(face)
+                                                        * parentSide
+                                                    + y / 2)
+                                                       * parentSide
+                                                   + x / 2];
+                }
+            }
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                        level,
+                        0,
+                        0,
+                        0,
+                        side,
+                        side,
+                        static_cast<GLsizei>(virtualtexture::FACE_COUNT),
+                        GL_RGBA,
+                        GL_UNSIGNED_BYTE,
+                        entries.data());
+        std::swap(entries, parentEntries);
+    }
+}
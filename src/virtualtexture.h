@@ -0,0 +1,224 @@
+#ifndef VIRTUAL_TEXTURE_H_
+#define VIRTUAL_TEXTURE_H_
+
+#include "glstatecache.h"
+#include "mappedfile.h"
+
+#include "glad/gl.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+/// Tiled page file of cube-map faces too large to be resident in video
+/// memory as a whole.
+///
+/// Every mip level of every face is cut into square pages, down to the level
+/// where a face fits into a single page. Each page is stored with a border of
+/// texels copied from its neighbors, clamped at face edges, so that bilinear
+/// filtering inside a page never reads another page. Pages follow a
+/// fixed-size header ordered by level, face, row and column, as RGBA texels
+/// of 8 bits per channel, or of half floats for high dynamic range faces.
+///
+/// Page file is placed next to the first face image and considered stale
+/// when the size or modification time of any face differs from what is
+/// recorded in the header.
+namespace virtualtexture
+{
+inline constexpr size_t FACE_COUNT = 6;
+/// Texels of a page along each side, excluding its border.
+inline constexpr int PAGE_SIZE = 128;
+inline constexpr int PAGE_BORDER = 4;
+/// Texels of a page along each side in the page file and in the physical
+/// page cache.
+inline constexpr int SLOT_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+/// Faces from this size up are drawn through virtual texturing.
+inline constexpr int MIN_FACE_SIZE = 8192;
+
+/// Page file mapped for reading pages.
+struct Tiles
+{
+    /// Size of a page in bytes.
+    [[nodiscard]] size_t pageDataSize() const
+    {
+        return static_cast<size_t>(SLOT_SIZE * SLOT_SIZE)
+             * (hdr ? 4 * sizeof(std::uint16_t) : 4);
+    }
+
+    MappedFile file;
+    int faceSize;
+    /// Mip levels cut into pages, the last one holding a single page per
+    /// face.
+    int levelCount;
+    bool hdr;
+    std::span<const std::byte> pages;
+};
+
+/// Whether faces of given size are drawn through virtual texturing. Page
+/// sizes require faces to be powers of two.
+bool isVirtualSize(int faceSize);
+
+/// Map page file of faces baked on a previous launch. Returns nothing when
+/// the page file is missing, stale or truncated, in which case the faces are
+/// expected to be decoded and baked.
+std::optional<Tiles> map(
+    std::span<const std::filesystem::path, FACE_COUNT> facePaths);
+
+/// Cut mip chains of decoded faces into pages and write them into the page
+/// file, returning its mapping. Levels of each face start from level 0 of
+/// RGB texels of 8 bits per channel, or of floats for high dynamic range
+/// faces. Failure to write the page file is reported to the user.
+std::optional<Tiles> bake(
+    std::span<const std::filesystem::path, FACE_COUNT> facePaths,
+    int faceSize,
+    bool hdr,
+    std::span<const std::vector<const void*>, FACE_COUNT> faceLevels);
+}  // namespace virtualtexture
+
+/// Sparse virtual texture of cube-map faces, keeping a fixed-size cache of
+/// pages in video memory however large the faces are.
+///
+/// Pages seen by the camera are reported by a feedback pass drawn at low
+/// resolution and read back asynchronously. Missing pages are requested
+/// coarse levels first, read from the mapped page file on the thread pool,
+/// and uploaded into a free slot of the physical page cache texture on a
+/// later update, evicting the page seen least recently while the cache is
+/// full. The single page of the coarsest level of each face is always
+/// resident.
+///
+/// An indirection table holds an entry for every page of every level, as a
+/// mip level of a texture array with one layer per face. Entries point to the
+/// slot of the page when resident, or to the slot of its closest resident
+/// ancestor otherwise, along with the level of that ancestor, so that
+/// sampling always finds coarser fallback while finer pages stream in.
+///
+/// Non-copyable, non-movable, page reads in flight refer to the instance
+/// through shared state.
+class VirtualTexture
+{
+public:
+    /// Residency of the page cache for display.
+    struct Statistics
+    {
+        size_t residentPageCount;
+        size_t slotCount;
+        size_t pendingReadCount;
+    };
+
+    /// Slots of the physical page cache along each side.
+    static constexpr int SLOTS_PER_SIDE = 16;
+
+    /// Create page table and physical page cache, and upload always resident
+    /// pages. Must be called on the thread the graphics context is current
+    /// on.
+    VirtualTexture(virtualtexture::Tiles&& tiles, ThreadPool& threadPool);
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+    VirtualTexture(VirtualTexture&&) = delete;
+    VirtualTexture& operator=(VirtualTexture&&) = delete;
+    ~VirtualTexture();
+
+    /// Request pages reported by feedback pixels, each holding page column,
+    /// row, face and level plus one in its channels. Pixels of level zero
+    /// request nothing.
+    void requestPages(std::span<const std::uint8_t> feedback);
+
+    /// Upload pages read since the previous update, start reading pages
+    /// requested since then, and update the page table. Called once per
+    /// frame before drawing, leaving the first texture unit changed.
+    void update(GlStateCache& glState);
+
+    [[nodiscard]] GLuint pageTable() const { return pageTable_; }
+    [[nodiscard]] GLuint physicalTexture() const { return physicalTexture_; }
+    /// Distinct for every texture created, unlike texture names, which are
+    /// reused after deletion.
+    [[nodiscard]] size_t generation() const { return generation_; }
+    [[nodiscard]] int faceSize() const { return faceSize_; }
+    [[nodiscard]] int levelCount() const { return levelCount_; }
+    /// Video memory of page table and physical page cache in bytes,
+    /// independent of the size of the faces apart from the small page table.
+    [[nodiscard]] size_t videoMemorySize() const;
+    [[nodiscard]] Statistics statistics() const;
+
+private:
+    static constexpr std::uint32_t NO_PAGE
+        = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::int32_t NO_SLOT = -1;
+
+    /// Page read from the page file, waiting for upload.
+    struct ReadPage
+    {
+        std::uint32_t page;
+        std::vector<std::byte> data;
+    };
+
+    /// Finished reads, shared with reads in flight so that a read finishing
+    /// after destruction never pushes into a destroyed queue.
+    struct ReadQueue
+    {
+        std::mutex mutex;
+        std::vector<ReadPage> pages;
+    };
+
+    /// Pages of a face along each side at level.
+    [[nodiscard]] int pagesPerSide(int level) const
+    {
+        return (faceSize_ / virtualtexture::PAGE_SIZE) >> level;
+    }
+    [[nodiscard]] std::uint32_t pageIndex(int level,
+                                          int face,
+                                          int x,
+                                          int y) const;
+
+    /// Upload page into given slot of the physical page cache, which has to
+    /// be bound.
+    void upload(std::uint32_t page,
+                std::int32_t slot,
+                std::span<const std::byte> data);
+    /// Free slot, or the slot of the page seen least recently and not seen
+    /// in the current frame. No slot when every page is in use.
+    std::int32_t allocateSlot();
+    /// Rewrite every entry of the page table from residency. Page table has
+    /// to be bound.
+    void updatePageTable();
+
+    ThreadPool& threadPool_;
+    /// Shared with page reads in flight, which may outlive the texture.
+    std::shared_ptr<const MappedFile> file_;
+    std::span<const std::byte> pages_;
+    int faceSize_;
+    int levelCount_;
+    bool hdr_;
+    size_t pageDataSize_;
+    /// Index of the first page of each level.
+    std::vector<std::uint32_t> levelFirstPages_;
+    /// Slot of each page, no slot when not resident.
+    std::vector<std::int32_t> pageSlots_;
+    std::vector<std::uint8_t> pagesReading_;
+    /// Frame each page was last requested in, so that the same page reported
+    /// by many feedback pixels is only requested once.
+    std::vector<std::uint64_t> pageRequestFrames_;
+    /// Page held by each slot, and frame it was last seen in.
+    std::vector<std::uint32_t> slotPages_;
+    std::vector<std::uint64_t> slotFrames_;
+    /// Pages requested since the previous update, not resident or reading.
+    std::vector<std::uint32_t> requests_;
+    std::shared_ptr<ReadQueue> readQueue_;
+    size_t pendingReadCount_;
+    size_t residentPageCount_;
+    std::uint64_t frame_;
+    bool pageTableOutdated_;
+    GLuint pageTable_;
+    GLuint physicalTexture_;
+    size_t generation_;
+};
+
+#endif
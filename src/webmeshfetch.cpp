@@ -0,0 +1,367 @@
+#include "webmeshfetch.h"
+
+#include "model.h"
+#include "progressivemesh.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <emscripten.h>
+#include <emscripten/fetch.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr const char* CACHE_DATABASE = "3d-renderer-meshes";
+constexpr unsigned short HTTP_OK = 200;
+constexpr unsigned short HTTP_PARTIAL_CONTENT = 206;
+
+/// Fetch in flight, owned by the callbacks of the browser until finished.
+struct FetchState
+{
+    fs::path sourcePath;
+    ImportOptions options;
+    ThreadPool* threadPool;
+    webmeshfetch::Callback callback;
+    std::string url;
+    /// Range request header, which has to outlive the request.
+    std::string range;
+    std::array<const char*, 3> requestHeaders;
+    progressivemesh::Header header;
+    std::optional<progressivemesh::Builder> builder;
+    /// Whole file, when the server answered a range request with it.
+    std::vector<std::byte> wholeFile;
+    /// IndexedDB key of the level being loaded.
+    std::string cacheKey;
+};
+
+void finish(FetchState* state, std::optional<MeshData>&& meshData)
+{
+    const std::unique_ptr<FetchState> ownedState{state};
+    ownedState->callback(std::move(meshData), true);
+}
+
+void fetchRange(FetchState* state,
+                std::uint64_t offset,
+                std::uint64_t size,
+                void (*onSuccess)(emscripten_fetch_t*),
+                void (*onError)(emscripten_fetch_t*))
+{
+    state->range = "bytes=" + std::to_string(offset) + "-"
+                 + std::to_string(offset + size - 1);
+    state->requestHeaders = {"Range", state->range.c_str(), nullptr};
+    emscripten_fetch_attr_t attributes;
+    emscripten_fetch_attr_init(&attributes);
+    std::strcpy(attributes.requestMethod, "GET");
+    attributes.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY;
+    attributes.requestHeaders = state->requestHeaders.data();
+    attributes.userData = state;
+    attributes.onsuccess = onSuccess;
+    attributes.onerror = onError;
+    emscripten_fetch(&attributes, state->url.c_str());
+}
+
+/// Requested range of a response, keeping the whole file when the server
+/// ignored the range. Returns nothing when response is too short.
+std::optional<std::vector<std::byte>> takeRange(emscripten_fetch_t* fetch,
+                                                std::uint64_t offset,
+                                                std::uint64_t size)
+{
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    const std::span<const std::byte> data{
+        reinterpret_cast<const std::byte*>(fetch->data),
+        static_cast<size_t>(fetch->numBytes)};
+    std::optional<std::vector<std::byte>> range;
+    if (fetch->status == HTTP_PARTIAL_CONTENT && data.size() == size)
+    {
+        range.emplace(data.begin(), data.end());
+    }
+    else if (fetch->status == HTTP_OK && data.size() >= offset + size)
+    {
+        state->wholeFile.assign(data.begin(), data.end());
+        const std::span<const std::byte> requested = data.subspan(offset, size);
+        range.emplace(requested.begin(), requested.end());
+    }
+    emscripten_fetch_close(fetch);
+    return range;
+}
+
+/// Size of the whole file a response is part of, taken from the
+/// Content-Range header of partial responses. Returns nothing when the
+/// server does not tell.
+std::optional<std::uint64_t> getFileSize(emscripten_fetch_t* fetch)
+{
+    if (fetch->status == HTTP_OK)
+    {
+        return fetch->numBytes;
+    }
+    std::string headers(emscripten_fetch_get_response_headers_length(fetch),
+                        '\0');
+    emscripten_fetch_get_response_headers(fetch,
+                                          headers.data(),
+                                          headers.size() + 1);
+    std::ranges::transform(headers,
+                           headers.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+    // Content-Range: bytes <first>-<last>/<size>
+    const size_t field = headers.find("content-range:");
+    if (field == std::string::npos)
+    {
+        return std::nullopt;
+    }
+    const size_t separator = headers.find('/', field);
+    const size_t lineEnd = headers.find('\r', field);
+    if (separator == std::string::npos || separator > lineEnd)
+    {
+        return std::nullopt;
+    }
+    std::uint64_t size = 0;
+    const char* first = headers.data() + separator + 1;
+    const char* last = headers.data() + std::min(lineEnd, headers.size());
+    const auto [end, error] = std::from_chars(first, last, size);
+    if (error != std::errc{} || end == first)
+    {
+        return std::nullopt;
+    }
+    return size;
+}
+
+void loadNextLevel(FetchState* state);
+
+/// Append level and hand over the refined mesh.
+void deliverLevel(FetchState* state, std::span<const std::byte> chunk)
+{
+    if (!state->builder->appendLevel(chunk))
+    {
+        utils::logWarning("corrupted progressive mesh file of ",
+                          state->sourcePath);
+        finish(state, std::nullopt);
+        return;
+    }
+    if (state->builder->isComplete())
+    {
+        finish(state, state->builder->meshData());
+        return;
+    }
+    state->callback(state->builder->meshData(), false);
+    loadNextLevel(state);
+}
+
+void onLevelFetched(emscripten_fetch_t* fetch)
+{
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    const progressivemesh::Level& level
+        = state->header.levels[state->builder->levelCount()];
+    const std::optional<std::vector<std::byte>> chunk
+        = takeRange(fetch, level.offset, level.size);
+    if (!chunk)
+    {
+        finish(state, std::nullopt);
+        return;
+    }
+    // Store copies the data before returning, failing to cache is harmless
+    emscripten_idb_async_store(CACHE_DATABASE,
+                               state->cacheKey.c_str(),
+                               const_cast<std::byte*>(chunk->data()),
+                               static_cast<int>(chunk->size()),
+                               nullptr,
+                               nullptr,
+                               nullptr);
+    deliverLevel(state, chunk.value());
+}
+
+void onLevelFailed(emscripten_fetch_t* fetch)
+{
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    utils::logWarning("unable to fetch level of ",
+                      state->url,
+                      ", HTTP status ",
+                      fetch->status);
+    emscripten_fetch_close(fetch);
+    finish(state, std::nullopt);
+}
+
+void onLevelNotCached(void* arg)
+{
+    auto* state = static_cast<FetchState*>(arg);
+    const progressivemesh::Level& level
+        = state->header.levels[state->builder->levelCount()];
+    fetchRange(state, level.offset, level.size, onLevelFetched, onLevelFailed);
+}
+
+void onLevelCached(void* arg, void* buffer, int size)
+{
+    auto* state = static_cast<FetchState*>(arg);
+    // Buffer is freed after returning, levels are copied by the builder
+    const std::span<const std::byte> chunk{static_cast<std::byte*>(buffer),
+                                           static_cast<size_t>(size)};
+    if (chunk.size()
+        != state->header.levels[state->builder->levelCount()].size)
+    {
+        onLevelNotCached(arg);
+        return;
+    }
+    deliverLevel(state, chunk);
+}
+
+void loadNextLevel(FetchState* state)
+{
+    if (!state->wholeFile.empty())
+    {
+        // Remaining levels are already here, only the finest is handed over
+        while (!state->builder->isComplete())
+        {
+            const progressivemesh::Level& level
+                = state->header.levels[state->builder->levelCount()];
+            if (state->wholeFile.size() < level.offset + level.size
+                || !state->builder->appendLevel(
+                    std::span{state->wholeFile}.subspan(level.offset,
+                                                        level.size)))
+            {
+                finish(state, std::nullopt);
+                return;
+            }
+        }
+        finish(state, state->builder->meshData());
+        return;
+    }
+
+    // Range requests of the same URL would overwrite each other in the cache
+    // of the Fetch API, so levels are cached separately
+    state->cacheKey = state->url + "#"
+                    + std::to_string(state->header.contentHash) + "#"
+                    + std::to_string(state->builder->levelCount());
+    emscripten_idb_async_load(CACHE_DATABASE,
+                              state->cacheKey.c_str(),
+                              state,
+                              onLevelCached,
+                              onLevelNotCached);
+}
+
+void onSourceFetched(emscripten_fetch_t* fetch)
+{
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    // Written into the in-memory file system where preloaded files used to
+    // be, and imported like them
+    std::error_code error;
+    fs::create_directories(state->sourcePath.parent_path(), error);
+    std::ofstream file(state->sourcePath, std::ios::binary | std::ios::trunc);
+    file.write(fetch->data, static_cast<std::streamsize>(fetch->numBytes));
+    file.close();
+    emscripten_fetch_close(fetch);
+    if (!file)
+    {
+        finish(state, std::nullopt);
+        return;
+    }
+    // Import is run by a worker when the build has threads, keeping the
+    // browser responsive
+    if (state->threadPool->threadCount() > 0)
+    {
+        // Future is not needed, result is handed over through the callback
+        state->threadPool->submit(
+            [state]()
+            {
+                finish(state,
+                       Model::loadMeshData(state->sourcePath,
+                                           state->options,
+                                           state->threadPool));
+            });
+        return;
+    }
+    finish(state, Model::loadMeshData(state->sourcePath, state->options));
+}
+
+void onSourceFailed(emscripten_fetch_t* fetch)
+{
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    utils::logWarning("unable to fetch ",
+                      state->url,
+                      ", HTTP status ",
+                      fetch->status);
+    emscripten_fetch_close(fetch);
+    finish(state, std::nullopt);
+}
+
+/// Fetch source file whole, cached in IndexedDB by the Fetch API.
+void fetchSource(FetchState* state)
+{
+    state->url = state->sourcePath.generic_string();
+    emscripten_fetch_attr_t attributes;
+    emscripten_fetch_attr_init(&attributes);
+    std::strcpy(attributes.requestMethod, "GET");
+    attributes.attributes
+        = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY | EMSCRIPTEN_FETCH_PERSIST_FILE;
+    attributes.userData = state;
+    attributes.onsuccess = onSourceFetched;
+    attributes.onerror = onSourceFailed;
+    emscripten_fetch(&attributes, state->url.c_str());
+}
+
+void onHeaderFetched(emscripten_fetch_t* fetch)
+{
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    const std::optional<std::uint64_t> fileSize = getFileSize(fetch);
+    const std::optional<std::vector<std::byte>> data
+        = takeRange(fetch, 0, sizeof(progressivemesh::Header));
+    const std::optional<progressivemesh::Header> header
+        = data && fileSize
+            ? progressivemesh::readHeader(data.value(), fileSize.value())
+            : std::nullopt;
+    if (!header)
+    {
+        utils::logWarning("invalid progressive mesh file at ",
+                          state->url,
+                          ", fetching source file");
+        state->wholeFile.clear();
+        fetchSource(state);
+        return;
+    }
+    state->header = header.value();
+    state->builder.emplace(state->header);
+    loadNextLevel(state);
+}
+
+void onHeaderFailed(emscripten_fetch_t* fetch)
+{
+    // Missing progressive file is expected for models not converted
+    auto* state = static_cast<FetchState*>(fetch->userData);
+    emscripten_fetch_close(fetch);
+    fetchSource(state);
+}
+}  // namespace
+
+namespace webmeshfetch
+{
+void fetch(const fs::path& sourcePath,
+           const ImportOptions& options,
+           ThreadPool& threadPool,
+           Callback callback)
+{
+    auto state = std::make_unique<FetchState>();
+    state->sourcePath = sourcePath;
+    state->options = options;
+    state->threadPool = &threadPool;
+    state->callback = std::move(callback);
+    state->url = progressivemesh::progressivePath(sourcePath).generic_string();
+    // Header holds the whole level table, so a single small request tells
+    // where every level is
+    FetchState* ownedByBrowser = state.release();
+    fetchRange(ownedByBrowser,
+               0,
+               sizeof(progressivemesh::Header),
+               onHeaderFetched,
+               onHeaderFailed);
+}
+}  // namespace webmeshfetch
@@ -0,0 +1,38 @@
+#ifndef WEB_MESH_FETCH_H_
+#define WEB_MESH_FETCH_H_
+
+#include "mesh.h"
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+class ThreadPool;
+
+/// On-demand fetching of model files in the browser, instead of preloading
+/// every asset before the application starts.
+///
+/// The progressive file of a model is fetched level by level with HTTP range
+/// requests, coarsest first, so that a coarse version is drawn after the first
+/// few kilobytes while refinements stream in. Fetched levels are cached in
+/// IndexedDB, keyed by the hash of the file so that updated files are fetched
+/// again. Models without progressive file are fetched whole and imported from
+/// the source file instead, cached by the Fetch API itself.
+namespace webmeshfetch
+{
+/// Receives mesh of each fetched level, coarsest first. Complete is set for
+/// the last call, which has no mesh when fetching or importing failed.
+using Callback
+    = std::function<void(std::optional<MeshData>&& meshData, bool complete)>;
+
+/// Begin fetching model. Callback is called from the browser event loop on
+/// the main thread, except for imports of source files, which are run on a
+/// worker of the thread pool when there are workers. Import options only apply
+/// to source files, progressive files are imported when written.
+void fetch(const std::filesystem::path& sourcePath,
+           const ImportOptions& options,
+           ThreadPool& threadPool,
+           Callback callback);
+}  // namespace webmeshfetch
+
+#endif